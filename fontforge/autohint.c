@@ -2217,7 +2217,9 @@ void SCClearHintMasks(SplineChar *sc,int layer,int counterstoo) {
 	_SCClearHintMasks(sc,layer,counterstoo);
     else {
 	for ( i=0; i<mm->instance_count; ++i ) {
-	    if ( sc->orig_pos<mm->instances[i]->glyphcnt )
+	    /* Instance glyphs we haven't made yet have no masks */
+	    if ( sc->orig_pos<mm->instances[i]->glyphcnt &&
+		    mm->instances[i]->glyphs[sc->orig_pos]!=NULL )
 		_SCClearHintMasks(mm->instances[i]->glyphs[sc->orig_pos],layer,counterstoo);
 	}
 	if ( sc->orig_pos<mm->normal->glyphcnt )
@@ -2975,7 +2977,8 @@ static void __SplineCharAutoHint( SplineChar *sc, int layer, BlueData *bd, int g
 	_SplineCharAutoHint(sc,layer,bd,NULL,gen_undoes);
     else {
 	for ( i=0; i<mm->instance_count; ++i )
-	    if ( sc->orig_pos < mm->instances[i]->glyphcnt )
+	    if ( sc->orig_pos < mm->instances[i]->glyphcnt &&
+		    mm->instances[i]->glyphs[sc->orig_pos]!=NULL )
 		_SplineCharAutoHint(mm->instances[i]->glyphs[sc->orig_pos],layer,NULL,NULL,gen_undoes);
 	if ( sc->orig_pos < mm->normal->glyphcnt )
 	    _SplineCharAutoHint(mm->normal->glyphs[sc->orig_pos],layer,NULL,NULL,gen_undoes);
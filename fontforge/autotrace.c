@@ -34,8 +34,10 @@
 #include "fontforgevw.h"
 #include "fvimportbdf.h"
 #include "gfile.h"
+#include "parallel.h"
 #include "psread.h"
 #include "sd.h"
+#include "splinefit.h"
 #include "splineorder2.h"
 #include "splinestroke.h"
 #include "splineutil.h"
@@ -225,6 +227,398 @@ return( NULL );
 #endif
 
 
+/* FontForge's own tracer. The outline of the dark pixels is followed along */
+/*  the pixel edges, corners are found where the outline turns sharply, and */
+/*  curves are fitted to the (smoothed) outline between corners. Distances  */
+/*  are in pixels, with the origin at the bottom left of the image. */
+#define TRACE_SPAN	4	/* How far along the outline to look for corners */
+#define TRACE_CORNER	(-0.766)	/* cos(140 degrees), blunter turns are not corners */
+#define TRACE_TANSPAN	3	/* How far along the outline to look for tangents */
+#define TRACE_TOLER	0.6	/* How far a curve may stray from the outline */
+#define TRACE_TURD	2	/* Outlines enclosing at most this many pixels are noise */
+#define TRACE_MAXFIT	60	/* Most outline points to fit a curve to */
+#define TRACE_BATCH	64	/* Glyphs traced between progress updates */
+
+enum tracedir { td_east=1, td_north=2, td_west=4, td_south=8 };
+
+static const int tracedx[4] = { 1, 0, -1, 0 }, tracedy[4] = { 0, 1, 0, -1 };
+
+struct tracepath {
+    BasePoint *pts;		/* Outline points, a unit step apart */
+    int *corner;
+    int cnt;
+};
+
+struct tracefit {
+    BasePoint *pts;		/* Smoothed outline */
+    int cnt, start, len;
+    int fixstart, fixend;	/* Ends at corners, tangents must not look past */
+};
+
+static uint8_t *TraceInkMap(GImage *image, struct _GImage *ib) {
+    int width = ib->width, height = ib->height;
+    uint8_t *ink = malloc(width*height);
+    int x, y, lum, alpha;
+    Color col;
+
+    for ( y=0; y<height; ++y ) for ( x=0; x<width; ++x ) {
+	col = GImageGetPixelRGBA(image,x,y);
+	alpha = (col>>24)&0xff;
+	if ( ib->trans!=(Color)-1 ) {
+	    /* Background images are drawn in one colour on a transparent one */
+	    ink[(height-1-y)*width+x] = alpha>=128;
+    continue;
+	}
+	lum = (COLOR_RED(col)*299 + COLOR_GREEN(col)*587 + COLOR_BLUE(col)*114)/1000;
+	/* As though drawn over white */
+	lum = (lum*alpha + 255*(255-alpha))/255;
+	ink[(height-1-y)*width+x] = lum<128;
+    }
+return( ink );
+}
+
+static int TraceOutlines(GImage *image, struct _GImage *ib, struct tracepath **_paths) {
+    int width = ib->width, height = ib->height;
+    uint8_t *ink = TraceInkMap(image,ib);
+    uint8_t *out = calloc((width+1)*(height+1),1);
+    struct tracepath *paths = NULL;
+    int pcnt = 0, pmax = 0, max = 0;
+    int x, y, v, d, d0, next, cnt, X, Y, start, choose;
+    bigreal area;
+    BasePoint *pts = NULL;
+
+#define INK(x,y)	((x)>=0 && (x)<width && (y)>=0 && (y)<height && ink[(y)*width+(x)])
+    /* Each pixel edge with ink on one side only, directed so the ink is on */
+    /*  its right. Outer outlines come out clockwise and counters counter */
+    /*  clockwise, as FontForge wants them. */
+    for ( y=0; y<=height; ++y ) for ( x=0; x<width; ++x ) {
+	if ( INK(x,y) && !INK(x,y-1) )
+	    out[y*(width+1)+x+1] |= td_west;
+	else if ( !INK(x,y) && INK(x,y-1) )
+	    out[y*(width+1)+x] |= td_east;
+    }
+    for ( x=0; x<=width; ++x ) for ( y=0; y<height; ++y ) {
+	if ( INK(x,y) && !INK(x-1,y) )
+	    out[y*(width+1)+x] |= td_north;
+	else if ( !INK(x,y) && INK(x-1,y) )
+	    out[(y+1)*(width+1)+x] |= td_south;
+    }
+#undef INK
+    free(ink);
+
+    for ( start=0; start<(width+1)*(height+1); ++start ) while ( out[start]!=0 ) {
+	for ( d0=0; !(out[start]&(1<<d0)); ++d0 );
+	v = start; d = d0; cnt = 0;
+	X = start%(width+1); Y = start/(width+1);
+	for (;;) {
+	    if ( cnt>=max )
+		pts = realloc(pts,(max += 1000)*sizeof(BasePoint));
+	    pts[cnt].x = X; pts[cnt++].y = Y;
+	    out[v] &= ~(1<<d);
+	    X += tracedx[d]; Y += tracedy[d];
+	    v = Y*(width+1)+X;
+	    /* Where two outlines touch at a corner prefer the left turn, which */
+	    /*  keeps diagonally touching pixels together */
+	    choose = out[v] | (v==start ? 1<<d0 : 0);
+	    if ( choose&(1<<((d+1)&3)) ) next = (d+1)&3;
+	    else if ( choose&(1<<d) ) next = d;
+	    else next = (d+3)&3;
+	    if ( v==start && next==d0 )
+	break;
+	    d = next;
+	}
+	/* Shoelace, negative for clockwise */
+	for ( area=0, x=0; x<cnt; ++x )
+	    area += pts[x].x*pts[(x+1)%cnt].y - pts[(x+1)%cnt].x*pts[x].y;
+	if ( fabs(area/2)<=TRACE_TURD )
+    continue;
+	if ( pcnt>=pmax )
+	    paths = realloc(paths,(pmax += 20)*sizeof(struct tracepath));
+	paths[pcnt].pts = malloc(cnt*sizeof(BasePoint));
+	memcpy(paths[pcnt].pts,pts,cnt*sizeof(BasePoint));
+	paths[pcnt].corner = NULL;
+	paths[pcnt++].cnt = cnt;
+    }
+    free(pts);
+    free(out);
+    *_paths = paths;
+return( pcnt );
+}
+
+static void TraceFindCorners(struct tracepath *path) {
+    int cnt = path->cnt, i, j, best, span;
+    BasePoint *pts = path->pts;
+    bigreal *sharp = malloc(cnt*sizeof(bigreal));
+    bigreal ax, ay, bx, by, len, s;
+
+    path->corner = calloc(cnt,sizeof(int));
+    if ( cnt<8*TRACE_SPAN ) {
+	/* Too small to have curves worth fitting, every turn is a corner */
+	for ( i=0; i<cnt; ++i ) {
+	    BasePoint *p = &pts[(i+cnt-1)%cnt], *n = &pts[(i+1)%cnt];
+	    path->corner[i] = (p->x-pts[i].x)*(n->y-pts[i].y) != (p->y-pts[i].y)*(n->x-pts[i].x);
+	}
+	free(sharp);
+return;
+    }
+    /* A turn must be sharp seen from near and from twice as far, turns */
+    /*  which are only sharp close up are just the outline of a curve */
+    for ( i=0; i<cnt; ++i ) for ( span=TRACE_SPAN; span<=2*TRACE_SPAN; span += TRACE_SPAN ) {
+	ax = pts[(i+cnt-span)%cnt].x - pts[i].x; ay = pts[(i+cnt-span)%cnt].y - pts[i].y;
+	bx = pts[(i+span)%cnt].x - pts[i].x; by = pts[(i+span)%cnt].y - pts[i].y;
+	len = sqrt((ax*ax+ay*ay)*(bx*bx+by*by));
+	s = len==0 ? 1 : (ax*bx+ay*by)/len;
+	if ( span==TRACE_SPAN || s<sharp[i] )
+	    sharp[i] = s;
+    }
+    /* Only the sharpest turn nearby is a corner */
+    for ( i=0; i<cnt; ++i ) if ( sharp[i]>TRACE_CORNER ) {
+	best = true;
+	for ( j=-TRACE_SPAN; j<=TRACE_SPAN && best; ++j ) {
+	    s = sharp[(i+j+cnt)%cnt];
+	    if ( s>sharp[i] || (s==sharp[i] && j<0) )
+		best = false;
+	}
+	path->corner[i] = best;
+    }
+    free(sharp);
+}
+
+static BasePoint TraceFitPos(struct tracefit *tf, bigreal t) {
+    int i = floor(t);
+    bigreal f = t-i;
+    BasePoint *p0 = &tf->pts[((tf->start+i)%tf->cnt+tf->cnt)%tf->cnt];
+    BasePoint *p1 = &tf->pts[((tf->start+i+1)%tf->cnt+tf->cnt)%tf->cnt];
+    BasePoint ret;
+
+    ret.x = p0->x + f*(p1->x-p0->x);
+    ret.y = p0->y + f*(p1->y-p0->y);
+return( ret );
+}
+
+static void TraceFitPoint(struct tracefit *tf, bigreal t, FitPoint *fp) {
+    bigreal t0 = t-TRACE_TANSPAN, t1 = t+TRACE_TANSPAN, len;
+    BasePoint p0, p1;
+
+    if ( tf->fixstart && t0<0 ) t0 = 0;
+    if ( tf->fixend && t1>tf->len ) t1 = tf->len;
+    p0 = TraceFitPos(tf,t0); p1 = TraceFitPos(tf,t1);
+    len = sqrt((p1.x-p0.x)*(p1.x-p0.x)+(p1.y-p0.y)*(p1.y-p0.y));
+    fp->t = t;
+    fp->p = TraceFitPos(tf,t);
+    fp->ut.x = len==0 ? 1 : (p1.x-p0.x)/len;
+    fp->ut.y = len==0 ? 0 : (p1.y-p0.y)/len;
+}
+
+static int TraceGenPoints(void *vinfo, bigreal t_fm, bigreal t_to, FitPoint **fpp) {
+    struct tracefit *tf = vinfo;
+    int cnt = 0, step;
+    bigreal t;
+    FitPoint *fp;
+
+    /* The outline points in between, thinned out on long stretches */
+    step = t_to-t_fm>TRACE_MAXFIT ? ceil((t_to-t_fm)/TRACE_MAXFIT) : 1;
+    fp = calloc((t_to-t_fm)/step+3,sizeof(FitPoint));
+    TraceFitPoint(tf,t_fm,&fp[cnt++]);
+    if ( t_to-t_fm<2 )
+	TraceFitPoint(tf,(t_fm+t_to)/2,&fp[cnt++]);
+    else for ( t=floor(t_fm)+step; t<t_to; t+=step )
+	TraceFitPoint(tf,t,&fp[cnt++]);
+    TraceFitPoint(tf,t_to,&fp[cnt++]);
+    *fpp = fp;
+return( cnt );
+}
+
+static int TraceIsStraight(struct tracefit *tf) {
+    BasePoint s = TraceFitPos(tf,0), e = TraceFitPos(tf,tf->len), p;
+    bigreal len = sqrt((e.x-s.x)*(e.x-s.x)+(e.y-s.y)*(e.y-s.y));
+    int i;
+
+    if ( len==0 )
+return( false );
+    for ( i=1; i<tf->len; ++i ) {
+	p = TraceFitPos(tf,i);
+	if ( fabs((p.x-s.x)*(e.y-s.y)-(p.y-s.y)*(e.x-s.x))/len > TRACE_TOLER/2 )
+return( false );
+    }
+return( true );
+}
+
+/* The outline is a staircase, but the true edge passes close to the middle */
+/*  of each step. So the outline is replaced by the polygon through those */
+/*  middles (and the corners), taken at each of the original points */
+static BasePoint *TraceSmooth(struct tracepath *path) {
+    int cnt = path->cnt, i, j, k, kcnt, first;
+    BasePoint *pts = path->pts, *smooth = malloc(cnt*sizeof(BasePoint));
+    BasePoint *kp = malloc(2*cnt*sizeof(BasePoint));
+    bigreal *kt = malloc(2*cnt*sizeof(bigreal)), f;
+
+#define TURNS(i)	((pts[((i)+cnt-1)%cnt].x-pts[(i)%cnt].x)*(pts[((i)+1)%cnt].y-pts[(i)%cnt].y) != \
+			 (pts[((i)+cnt-1)%cnt].y-pts[(i)%cnt].y)*(pts[((i)+1)%cnt].x-pts[(i)%cnt].x))
+    for ( first=0; !TURNS(first); ++first );
+    kcnt = 0;
+    for ( i=first; i<first+cnt; i=j ) {
+	for ( j=i+1; j<first+cnt && !TURNS(j); ++j );
+	if ( path->corner[i%cnt] ) {
+	    kt[kcnt] = i;
+	    kp[kcnt++] = pts[i%cnt];
+	}
+	kt[kcnt] = (i+j)/2.0;
+	kp[kcnt].x = (pts[i%cnt].x+pts[j%cnt].x)/2;
+	kp[kcnt++].y = (pts[i%cnt].y+pts[j%cnt].y)/2;
+    }
+#undef TURNS
+    /* Close the polygon */
+    kt[kcnt] = kt[0]+cnt;
+    kp[kcnt] = kp[0];
+    for ( i=first, k=0; i<first+cnt; ++i ) {
+	while ( kt[k+1]<i ) ++k;
+	if ( kt[k]>i ) {
+	    /* Before the first knot, on the way round from the last */
+	    f = (i+cnt-kt[kcnt-1])/(kt[kcnt]-kt[kcnt-1]);
+	    smooth[i%cnt].x = kp[kcnt-1].x + f*(kp[kcnt].x-kp[kcnt-1].x);
+	    smooth[i%cnt].y = kp[kcnt-1].y + f*(kp[kcnt].y-kp[kcnt-1].y);
+	} else {
+	    f = (i-kt[k])/(kt[k+1]-kt[k]);
+	    smooth[i%cnt].x = kp[k].x + f*(kp[k+1].x-kp[k].x);
+	    smooth[i%cnt].y = kp[k].y + f*(kp[k+1].y-kp[k].y);
+	}
+    }
+    free(kp);
+    free(kt);
+return( smooth );
+}
+
+static SplineSet *TracePathToSplines(struct tracepath *path) {
+    int cnt = path->cnt, i, j, ccnt, next, *corners;
+    BasePoint *smooth;
+    struct tracefit tf;
+    SplinePoint *first, *sp, *to, *end;
+    SplineSet *ss;
+
+    TraceFindCorners(path);
+    smooth = TraceSmooth(path);
+    corners = malloc((cnt+2)*sizeof(int));
+    for ( i=ccnt=0; i<cnt; ++i )
+	if ( path->corner[i] )
+	    corners[ccnt++] = i;
+    tf.pts = smooth;
+    tf.cnt = cnt;
+    /* A closed curve needs at least two pieces */
+    if ( ccnt==0 )
+	corners[ccnt++] = 0;
+    if ( ccnt==1 )
+	corners[ccnt++] = (corners[0]+cnt/2)%cnt;
+    if ( ccnt==2 && corners[1]<corners[0] ) {
+	i = corners[0]; corners[0] = corners[1]; corners[1] = i;
+    }
+
+    first = sp = SplinePointCreate(smooth[corners[0]].x,smooth[corners[0]].y);
+    for ( j=0; j<ccnt; ++j ) {
+	next = j==ccnt-1 ? corners[0] : corners[j+1];
+	tf.start = corners[j];
+	tf.len = (next-corners[j]+cnt-1)%cnt+1;
+	tf.fixstart = path->corner[corners[j]];
+	tf.fixend = path->corner[next];
+	to = j==ccnt-1 ? first : SplinePointCreate(smooth[next].x,smooth[next].y);
+	end = NULL;
+	if ( !TraceIsStraight(&tf) )
+	    end = ApproximateSplineSetFromGen(sp,to,0,tf.len,TRACE_TOLER,false,
+		    TraceGenPoints,&tf,false);
+	if ( end==NULL ) {
+	    sp->nextcp = sp->me; sp->nonextcp = true;
+	    to->prevcp = to->me; to->noprevcp = true;
+	    SplineMake3(sp,to);
+	}
+	sp = to;
+    }
+    ss = chunkalloc(sizeof(SplineSet));
+    ss->first = ss->last = first;
+    SPLCategorizePoints(ss);
+    free(smooth);
+    free(corners);
+return( ss );
+}
+
+/* Traces the first image of an image list. Needs nothing but the image, so */
+/*  several may be traced at once */
+static SplineSet *ImageTrace(ImageList *images, int order2) {
+    struct _GImage *ib = images->image->list_len==0 ? images->image->u.image : images->image->u.images[0];
+    struct tracepath *paths;
+    SplineSet *head = NULL, *last = NULL, *ss;
+    real transform[6];
+    int i, cnt;
+
+    if ( ib->width==0 || ib->height==0 )
+return( NULL );
+    cnt = TraceOutlines(images->image,ib,&paths);
+    for ( i=0; i<cnt; ++i ) {
+	ss = TracePathToSplines(&paths[i]);
+	if ( head==NULL )
+	    head = ss;
+	else
+	    last->next = ss;
+	last = ss;
+	free(paths[i].pts);
+	free(paths[i].corner);
+    }
+    free(paths);
+    transform[0] = images->xscale; transform[3] = images->yscale;
+    transform[1] = transform[2] = 0;
+    transform[4] = images->xoff;
+    transform[5] = images->yoff - images->yscale*ib->height;
+    head = SplinePointListTransform(head,transform,tpt_AllPoints);
+    if ( order2 ) {
+	SplineSet *o2 = SplineSetsTTFApprox(head);
+	SplinePointListsFree(head);
+	head = o2;
+    }
+return( head );
+}
+
+static SplineSet *SCImagesTrace(SplineChar *sc, int layer) {
+    ImageList *images;
+    SplineSet *head = NULL, *new, *last;
+
+    /* Each image's outlines go before the previous ones, as they always have */
+    for ( images = sc->layers[ly_back].images; images!=NULL; images=images->next ) {
+	new = ImageTrace(images,sc->layers[layer].order2);
+	if ( new!=NULL ) {
+	    for ( last=new; last->next!=NULL; last=last->next );
+	    last->next = head;
+	    head = new;
+	}
+    }
+return( head );
+}
+
+static void SCAddTraced(SplineChar *sc, int layer, SplineSet *new) {
+    SplineSet *last;
+
+    if ( new==NULL )
+return;
+    sc->parent->onlybitmaps = false;
+    SCPreserveLayer(sc,layer,false);
+    for ( last=new; last->next!=NULL; last=last->next );
+    last->next = sc->layers[layer].splines;
+    sc->layers[layer].splines = new;
+    SCCharChangedUpdate(sc,layer);
+}
+
+struct tracejob {
+    SplineChar *sc;
+    int layer;
+    SplineSet *traced;
+};
+
+static void TraceRange(void *data, int start, int end) {
+    struct tracejob *jobs = data;
+    int i;
+
+    for ( i=start; i<end; ++i )
+	jobs[i].traced = SCImagesTrace(jobs[i].sc,jobs[i].layer);
+}
+
 #if defined(__MINGW32__) || defined(_MSC_VER)
 static char* add_arg(char* buffer, const char* s)
 {
@@ -232,7 +626,7 @@ static char* add_arg(char* buffer, const char* s)
     *buffer = '\0';
     return buffer;
 }
-void _SCAutoTrace(SplineChar *sc, int layer, char **args) {
+static void SCAutoTraceExternal(SplineChar *sc, int layer, char **args) {
     ImageList *images;
     SplineSet *new, *last;
     struct _GImage *ib;
@@ -326,7 +720,7 @@ void _SCAutoTrace(SplineChar *sc, int layer, char **args) {
 
 }
 #else
-void _SCAutoTrace(SplineChar *sc, int layer, char **args) {
+static void SCAutoTraceExternal(SplineChar *sc, int layer, char **args) {
     ImageList *images;
     const char *prog;
     char *pt;
@@ -443,6 +837,15 @@ return;
 }
 #endif
 
+void _SCAutoTrace(SplineChar *sc, int layer, char **args) {
+    if ( sc->layers[ly_back].images==NULL )
+return;
+    if ( FindAutoTraceName()!=NULL )
+	SCAutoTraceExternal(sc,layer,args);
+    else
+	SCAddTraced(sc,layer,SCImagesTrace(sc,layer));
+}
+
 static char **makevector(const char *str) {
     char **vector;
     const char *start, *pt;
@@ -538,53 +941,69 @@ return( args );
 }
 
 void FVAutoTrace(FontViewBase *fv,int ask) {
-    char **args;
-    int i,cnt,gid;
+    char **args = NULL;
+    int i,cnt,gid,done,bcnt;
+    int external = FindAutoTraceName()!=NULL;
+    struct tracejob *jobs;
+    SplineChar *sc;
 
-    if ( FindAutoTraceName()==NULL ) {
-	ff_post_error(_("Can't find autotrace"),_("Can't find autotrace program (set AUTOTRACE environment variable) or download from:\n  http://sf.net/projects/autotrace/"));
+    if ( external ) {
+	args = AutoTraceArgs(ask);
+	if ( args==(char **) -1 )
 return;
     }
-
-    args = AutoTraceArgs(ask);
-    if ( args==(char **) -1 )
-return;
+    SFUntickAll(fv->sf);
+    jobs = malloc(fv->map->enccount*sizeof(struct tracejob));
     for ( i=cnt=0; i<fv->map->enccount; ++i )
 	if ( fv->selected[i] && (gid=fv->map->map[i])!=-1 &&
-		fv->sf->glyphs[gid]!=NULL &&
-		fv->sf->glyphs[gid]->layers[ly_back].images )
-	    ++cnt;
+		(sc = fv->sf->glyphs[gid])!=NULL &&
+		sc->layers[ly_back].images && !sc->ticked ) {
+	    sc->ticked = true;
+	    jobs[cnt].sc = sc;
+	    jobs[cnt].layer = fv->active_layer;
+	    jobs[cnt++].traced = NULL;
+	}
 
     ff_progress_start_indicator(10,_("Autotracing..."),_("Autotracing..."),0,cnt,1);
 
-    SFUntickAll(fv->sf);
-    for ( i=cnt=0; i<fv->map->enccount; ++i ) {
-	if ( fv->selected[i] && (gid=fv->map->map[i])!=-1 &&
-		fv->sf->glyphs[gid]!=NULL &&
-		fv->sf->glyphs[gid]->layers[ly_back].images &&
-		!fv->sf->glyphs[gid]->ticked ) {
-	    _SCAutoTrace(fv->sf->glyphs[gid], fv->active_layer, args);
+    /* The glyphs are traced in parallel a batch at a time, and added to the */
+    /*  font (with undoes and updates) in between so progress can be shown */
+    for ( done=0; done<cnt; done+=bcnt ) {
+	bcnt = cnt-done<TRACE_BATCH ? cnt-done : TRACE_BATCH;
+	if ( !external )
+	    ParallelFor(bcnt,TraceRange,jobs+done);
+	for ( i=done; i<done+bcnt; ++i ) {
+	    if ( external )
+		SCAutoTraceExternal(jobs[i].sc,jobs[i].layer,args);
+	    else
+		SCAddTraced(jobs[i].sc,jobs[i].layer,jobs[i].traced);
+	    jobs[i].traced = NULL;
 	    if ( !ff_progress_next())
+	break;
+	}
+	if ( i<done+bcnt ) {
+	    for ( ; i<done+bcnt; ++i )
+		SplinePointListsFree(jobs[i].traced);
     break;
 	}
     }
     ff_progress_end_indicator();
+    free(jobs);
 }
 
 void SCAutoTrace(SplineChar *sc,int layer, int ask) {
-    char **args;
+    char **args = NULL;
 
     if ( sc->layers[ly_back].images==NULL ) {
 	ff_post_error(_("Nothing to trace"),_("Nothing to trace"));
-return;
-    } else if ( FindAutoTraceName()==NULL ) {
-	ff_post_error(_("Can't find autotrace"),_("Can't find autotrace program (set AUTOTRACE environment variable) or download from:\n  http://sf.net/projects/autotrace/"));
 return;
     }
 
-    args = AutoTraceArgs(ask);
-    if ( args==(char **) -1 )
+    if ( FindAutoTraceName()!=NULL ) {
+	args = AutoTraceArgs(ask);
+	if ( args==(char **) -1 )
 return;
+    }
     _SCAutoTrace(sc, layer, args);
 }
 
@@ -616,35 +1035,16 @@ return( buffer );
 return( NULL );
 }
 
+/* An external tracer is only used when one is named in the environment, */
+/*  otherwise we trace ourselves */
 const char *FindAutoTraceName(void) {
-    static int searched=0;
-    static int waspotracepreferred;
-    static const char *name = NULL;
-    char buffer[1025];
+    const char *name;
 
-    if ( searched && waspotracepreferred==preferpotrace )
-return( name );
-
-    searched = true;
-    waspotracepreferred = preferpotrace;
-    if ( preferpotrace ) {
-	if (( name = getenv("POTRACE"))!=NULL )
+    if ( preferpotrace && (name = getenv("POTRACE"))!=NULL )
 return( name );
-    }
     if (( name = getenv("AUTOTRACE"))!=NULL )
 return( name );
-    if (( name = getenv("POTRACE"))!=NULL )
-return( name );
-
-    if ( preferpotrace ) {
-	if ( ProgramExists("potrace",buffer)!=NULL )
-	    name = "potrace";
-    }
-    if ( name==NULL && ProgramExists("autotrace",buffer)!=NULL )
-	name = "autotrace";
-    if ( name==NULL && ProgramExists("potrace",buffer)!=NULL )
-	name = "potrace";
-return( name );
+return( getenv("POTRACE") );
 }
 
 const char *FindMFName(void) {
@@ -753,12 +1153,10 @@ return (NULL);
 
     if ( FindMFName()==NULL ) {
 	ff_post_error(_("Can't find mf"),_("Can't find mf program -- metafont (set MF environment variable) or download from:\n  http://www.tug.org/\n  http://www.ctan.org/\nIt's part of the TeX distribution"));
-return( NULL );
-    } else if ( FindAutoTraceName()==NULL ) {
-	ff_post_error(_("Can't find autotrace"),_("Can't find autotrace program (set AUTOTRACE environment variable) or download from:\n  http://sf.net/projects/autotrace/"));
 return( NULL );
     }
-    if ( MfArgs()==(char *) -1 || AutoTraceArgs(false)==(char **) -1 )
+    if ( MfArgs()==(char *) -1 ||
+	    (FindAutoTraceName()!=NULL && AutoTraceArgs(false)==(char **) -1) )
 return( NULL );
 
     /* I don't know how to tell mf to put its files where I want them. */
@@ -1371,6 +1371,7 @@ return;
 	if ( any1 && any2 ) {
 	    vkc = chunkalloc(sizeof(KernClass));
 	    *vkc = *kc;
+	    vkc->map = NULL;
 	    vkc->subtable = VSubtableFromH(&lookupmap,kc->subtable);
 	    vkc->subtable->kc = vkc;
 	    vkc->next = sf->vkerns;
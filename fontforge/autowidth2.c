@@ -33,6 +33,8 @@
 #include "edgelist2.h"
 #include "fontforgevw.h"
 #include "fvfonts.h"
+#include "lookups.h"
+#include "parallel.h"
 #include "splineoverlap.h"
 #include "splineutil.h"
 #include "tottfgpos.h"
@@ -43,11 +45,61 @@
 
 #define DENOM_FACTOR_OF_EMSIZE	50.0
 
+/* The two kernels below do all the per-pair work of autowidth and autokern */
+/*  (there are |left|*|right| pairs, and only |left|+|right| glyphs), so */
+/*  they are written to be vectorizable: no data dependent branches, and */
+/*  the weighted sums are split into independent lanes */
+#define AW2_LANES	4
+
+static real aw2_average_gap(const short *left, const short *right, int n,
+	real denom) {
+    real tot[AW2_LANES], cnt[AW2_LANES], t, c;
+    int j, k;
+
+    for ( k=0; k<AW2_LANES; ++k )
+	tot[k] = cnt[k] = 0;
+    for ( j=0; j+AW2_LANES<=n; j+=AW2_LANES ) {
+	for ( k=0; k<AW2_LANES; ++k ) {
+	    /* beware of gaps such as those in "i" or "aaccute" */
+	    real valid = left[j+k] < 32767 && right[j+k] > -32767;
+	    real sep = left[j+k] - right[j+k];
+	    real weight = 1.0/(sep + denom);
+	    weight *= weight*valid;
+	    tot[k] += weight*sep;
+	    cnt[k] += weight;
+	}
+    }
+    for ( k=0; j<n; ++j, ++k ) {
+	real valid = left[j] < 32767 && right[j] > -32767;
+	real sep = left[j] - right[j];
+	real weight = 1.0/(sep + denom);
+	weight *= weight*valid;
+	tot[k] += weight*sep;
+	cnt[k] += weight;
+    }
+    t = c = 0;
+    for ( k=0; k<AW2_LANES; ++k ) {
+	t += tot[k];
+	c += cnt[k];
+    }
+    if ( c!=0 )
+	t /= c;
+return( t );
+}
+
+/* Returns 0x7fff if the profiles only overlap in gaps */
+static int aw2_closest_gap(const short *left, const short *right, int n) {
+    int j, smallest = 0x7fff;
+
+    for ( j=0; j<n; ++j ) {
+	int sep = left[j] - right[j];
+	smallest = sep<smallest ? sep : smallest;
+    }
+return( smallest );
+}
+
 static int aw2_bbox_separation(AW_Glyph *g1, AW_Glyph *g2, AW_Data *all) {
-    int j;
     int imin_y, imax_y;
-    real tot, cnt;
-    real denom;
     /* the goal is to give a weighted average that expresses the visual */
     /*  separation between two glyphs when they are placed so their bounding */
     /*  boxes are adjacent. The separation between two rectangles would be 0 */
@@ -65,22 +117,19 @@ return( PyFF_GlyphSeparation(g1,g2,all) );
     imax_y = g2->imax_y < g1->imax_y ? g2->imax_y : g1->imax_y;
     if ( imax_y < imin_y )		/* no overlap. ie grave and "a" */
 return( 0 );
-    denom = all->denom;
-    tot = cnt = 0;
-    for ( j=imin_y ; j<imax_y; ++j ) {
-	if ( g2->left[j-g2->imin_y] < 32767 && g1->right[j-g1->imin_y] > -32767 ) {
-	    /* beware of gaps such as those in "i" or "aaccute" */
-	    real sep = g2->left[j-g2->imin_y] - g1->right[j-g1->imin_y];
-	    real weight = 1.0/(sep + denom);
-	    weight *= weight;
+return( rint( aw2_average_gap(g2->left+(imin_y-g2->imin_y),
+	g1->right+(imin_y-g1->imin_y), imax_y-imin_y, all->denom)) );
+}
 
-	    tot += weight*sep;
-	    cnt += weight;
-	}
+static void aw2_parallel(int cnt, ParallelFunc func, void *data) {
+#if !defined(_NO_PYTHON)
+    /* The python separation hook may only be called from this thread */
+    if ( PyFF_GlyphSeparationHook!=NULL ) {
+	(func)(data,0,cnt);
+return;
     }
-    if ( cnt!=0 )
-	tot /= cnt;
-return( rint( tot ) );
+#endif
+    ParallelFor(cnt,func,data);
 }
 
 static void aw2_figure_lsb(int right_index, AW_Data *all) {
@@ -129,9 +178,21 @@ static void aw2_figure_rsb(int left_index, AW_Data *all) {
     me->nrsb = rsb;
 }
 
+static void aw2_figure_separations(void *data, int start, int end) {
+    AW_Data *all = data;
+    int i,j;
+
+    for ( i=start; i<end; ++i ) {
+	int *vpt = all->visual_separation + i*all->gcnt;
+	AW_Glyph *me = &all->glyphs[i];
+	for ( j=0; j<all->gcnt; ++j )
+	    vpt[j] = aw2_bbox_separation(me,&all->glyphs[j],all);
+    }
+}
+
 static void aw2_figure_all_sidebearing(AW_Data *all) {
     int i,j;
-    AW_Glyph *me, *other;
+    AW_Glyph *me;
     real transform[6], half;
     int width, changed;
     uint8_t *rsel = calloc(all->fv->map->enccount,sizeof(uint8_t));
@@ -140,14 +201,7 @@ static void aw2_figure_all_sidebearing(AW_Data *all) {
 
     all->denom = denom;
     all->visual_separation = malloc(all->gcnt*all->gcnt*sizeof(int));
-    for ( i=0; i<all->gcnt; ++i ) {
-	int *vpt = all->visual_separation + i*all->gcnt;
-	me = &all->glyphs[i];
-	for ( j=0; j<all->gcnt; ++j ) {
-	    other = &all->glyphs[j];
-	    vpt[j] = aw2_bbox_separation(me,other,all);
-	}
-    }
+    aw2_parallel(all->gcnt,aw2_figure_separations,all);
 
     half = all->desired_separation/2;
     for ( i=0; i<all->gcnt; ++i ) {
@@ -214,20 +268,15 @@ return( all->desired_separation - sep );
 }
 
 static int ak2_figure_touch(AW_Glyph *g1, AW_Glyph *g2, AW_Data *all) {
-    int j;
     int imin_y, imax_y;
-    real smallest, tot;
+    real smallest;
 
     imin_y = g2->imin_y > g1->imin_y ? g2->imin_y : g1->imin_y;
     imax_y = g2->imax_y < g1->imax_y ? g2->imax_y : g1->imax_y;
     if ( imax_y < imin_y )		/* no overlap. ie grave and "a" */
 return( - (g2->bb.minx + g1->sc->width - g1->bb.maxx) );
-    smallest = 0x7fff;
-    for ( j=imin_y ; j<imax_y; ++j ) {
-	tot = g2->left[j-g2->imin_y] - g1->right[j-g1->imin_y];
-	if ( tot<smallest )
-	    smallest = tot;
-    }
+    smallest = aw2_closest_gap(g2->left+(imin_y-g2->imin_y),
+	    g1->right+(imin_y-g1->imin_y), imax_y-imin_y);
     if ( smallest == 0x7fff )	/* Overlaps only in gaps, "i" and something between the base and the dot */
 return( - (g2->bb.minx + g1->sc->width - g1->bb.maxx) );
 
@@ -258,9 +307,9 @@ return( all->desired_separation - tot );
 }
 
 static int ak2_figure_touchclass(int *class1, int *class2, AW_Data *all) {
-    int h,i,j;
+    int h,i;
     int imin_y, imax_y;
-    real smallest, smaller, tot;
+    real smallest, smaller;
 
     smallest = 0x7fff;
     for ( h=0; class1[h]!=-1; ++h ) {
@@ -274,12 +323,8 @@ static int ak2_figure_touchclass(int *class1, int *class2, AW_Data *all) {
 		    smallest = - (g2->bb.minx + g1->sc->width - g1->bb.maxx);
 	continue;
 	    }
-	    smaller = 0x7fff;
-	    for ( j=imin_y ; j<imax_y; ++j ) {
-		tot = g2->left[j-g2->imin_y] - g1->right[j-g1->imin_y];
-		if ( tot<smaller )
-		    smaller = tot;
-	    }
+	    smaller = aw2_closest_gap(g2->left+(imin_y-g2->imin_y),
+		    g1->right+(imin_y-g1->imin_y), imax_y-imin_y);
 	    if ( smaller == 0x7fff ) {
 		if ( smallest < - (g2->bb.minx + g1->sc->width - g1->bb.maxx) )
 		    smallest = - (g2->bb.minx + g1->sc->width - g1->bb.maxx);
@@ -319,10 +364,12 @@ static void aw2_findedges(AW_Glyph *me, AW_Data *all) {
     Spline1D *msp;
     SplineSet *base;
 
-    me->imin_y = floor(me->bb.miny/all->sub_height);
-    me->imax_y = ceil (me->bb.maxy/all->sub_height);
-    me->left = malloc((me->imax_y-me->imin_y+1)*sizeof(short));
-    me->right = malloc((me->imax_y-me->imin_y+1)*sizeof(short));
+    if ( me->left==NULL ) {
+	me->imin_y = floor(me->bb.miny/all->sub_height);
+	me->imax_y = ceil (me->bb.maxy/all->sub_height);
+	me->left = malloc((me->imax_y-me->imin_y+1)*sizeof(short));
+	me->right = malloc((me->imax_y-me->imin_y+1)*sizeof(short));
+    }
 
     base = LayerAllSplines(&me->sc->layers[all->layer]);
     ms = SSsToMContours(base,over_remove);	/* over_remove is an arcane way of saying: Look at all contours, not just selected ones */
@@ -372,6 +419,39 @@ static void aw2_findedges(AW_Glyph *me, AW_Data *all) {
     FreeMonotonics(ms);
 }
 
+/* Sample the edges of all glyphs in all->glyphs. The profiles are packed */
+/*  into a single block (all->edges) so that the pair loops walk memory */
+/*  sequentially rather than chasing one allocation per glyph */
+static void aw2_findalledges(AW_Data *all) {
+    int i, tot;
+    short *pt;
+    AW_Glyph *me;
+
+    for ( i=tot=0; i<all->gcnt; ++i ) {
+	me = &all->glyphs[i];
+	me->imin_y = floor(me->bb.miny/all->sub_height);
+	me->imax_y = ceil (me->bb.maxy/all->sub_height);
+	tot += 2*(me->imax_y-me->imin_y+1);
+    }
+    all->edges = pt = malloc((tot+1)*sizeof(short));
+    for ( i=0; i<all->gcnt; ++i ) {
+	me = &all->glyphs[i];
+	me->left = pt; pt += me->imax_y-me->imin_y+1;
+	me->right = pt; pt += me->imax_y-me->imin_y+1;
+	aw2_findedges(me,all);
+    }
+}
+
+static void aw2_freealledges(AW_Data *all) {
+#if !defined(_NO_PYTHON)
+    int i;
+
+    for ( i=0; i<all->gcnt; ++i )
+	FFPy_AWGlyphFree(&all->glyphs[i]);
+#endif
+    free(all->edges); all->edges = NULL;
+}
+
 static void aw2_dummyedges(AW_Glyph *flat,AW_Data *all) {
     int i;
     int imin_y = 32000, imax_y = -32000;
@@ -584,6 +664,37 @@ void GuessOpticalOffset(SplineChar *sc,int layer,real *_loff, real *_roff,
 #endif		/* PYTHON */
 }
 
+struct ak2_pairs {
+    AW_Data *all;
+    AW_Glyph **left, **right;	/* Glyphs, or NULL when classes are used */
+    int **lclass, **rclass;	/* -1 terminated arrays of glyph indices */
+    int lcnt, rcnt;
+    int from_closest_approach;
+    int *kerns;			/* [lcnt*rcnt], row per left glyph/class */
+};
+
+static void ak2_figure_pairs(void *data, int start, int end) {
+    struct ak2_pairs *pairs = data;
+    int i, k, *kpt;
+
+    for ( i=start; i<end; ++i ) {
+	kpt = pairs->kerns + i*pairs->rcnt;
+	for ( k=0; k<pairs->rcnt; ++k ) {
+	    if ( pairs->left!=NULL ) {
+		if ( pairs->from_closest_approach )
+		    kpt[k] = rint( ak2_figure_touch(pairs->left[i],pairs->right[k],pairs->all));
+		else
+		    kpt[k] = rint( ak2_figure_kern(pairs->left[i],pairs->right[k],pairs->all));
+	    } else {
+		if ( pairs->from_closest_approach )
+		    kpt[k] = rint( ak2_figure_touchclass(pairs->lclass[i],pairs->rclass[k],pairs->all));
+		else
+		    kpt[k] = rint( ak2_figure_kernclass(pairs->lclass[i],pairs->rclass[k],pairs->all));
+	    }
+	}
+    }
+}
+
 void AutoKern2(SplineFont *sf, int layer,SplineChar **left,SplineChar **right,
 	struct lookup_subtable *into,
 	int separation, int min_kern, int from_closest_approach, int only_closer,
@@ -595,6 +706,7 @@ void AutoKern2(SplineFont *sf, int layer,SplineChar **left,SplineChar **right,
     int i,cnt,k, kern;
     SplineChar *sc;
     KernPair *last, *kp, *next;
+    struct ak2_pairs pairs;
     int is_l2r = !(into->lookup->lookup_flags & pst_r2l);
     /* Normally, kerning is based on some sort of average distance between */
     /*  two glyphs, but sometimes it is useful to kern so much that the glyphs*/
@@ -641,12 +753,13 @@ void AutoKern2(SplineFont *sf, int layer,SplineChar **left,SplineChar **right,
 	    if ( glyphs[cnt].bb.minx<-16000 || glyphs[cnt].bb.maxx>16000 ||
 		    glyphs[cnt].bb.miny<-16000 || glyphs[cnt].bb.maxy>16000 )
 		ff_post_notice(_("Glyph too big"),_("%s has a bounding box which is too big for this algorithm to work. Ignored."),sc->name);
-	    else {
-		glyphs[cnt].sc = sc;
-		aw2_findedges(&glyphs[cnt++], &all);
-	    }
+	    else
+		glyphs[cnt++].sc = sc;
 	}
     }
+    all.glyphs = glyphs;
+    all.gcnt = cnt;
+    aw2_findalledges(&all);
 
     /* remove all current kern pairs in this subtable which include the specified glyphs */
     if ( addkp==NULL ) {
@@ -666,23 +779,28 @@ void AutoKern2(SplineFont *sf, int layer,SplineChar **left,SplineChar **right,
 	}
     }
 
-    all.glyphs = glyphs;
-    all.gcnt = cnt;
+    /* Figure all pairs first (in parallel), then add them in a fixed order */
+    memset(&pairs,0,sizeof(pairs));
+    pairs.all = &all;
+    pairs.from_closest_approach = from_closest_approach;
+    pairs.left = malloc((cnt+1)*sizeof(AW_Glyph *));
+    pairs.right = malloc((cnt+1)*sizeof(AW_Glyph *));
     for ( i=0; i<cnt; ++i ) {
-	AW_Glyph *g1 = &glyphs[i];
-	if ( !g1->sc->ticked )
-    continue;
-	for ( k=0; k<cnt; ++k ) {
-	    AW_Glyph *g2 = &glyphs[k];
-	    if ( !g2->sc->ticked2 )
-	continue;
-	    if ( from_closest_approach )
-		kern = rint( ak2_figure_touch(g1,g2,&all));
-	    else {
-		kern = rint( ak2_figure_kern(g1,g2,&all));
-		if ( kern<min_kern && kern>-min_kern )
-		    kern = 0;
-	    }
+	if ( glyphs[i].sc->ticked )
+	    pairs.left[pairs.lcnt++] = &glyphs[i];
+	if ( glyphs[i].sc->ticked2 )
+	    pairs.right[pairs.rcnt++] = &glyphs[i];
+    }
+    pairs.kerns = malloc((pairs.lcnt*pairs.rcnt+1)*sizeof(int));
+    aw2_parallel(pairs.lcnt,ak2_figure_pairs,&pairs);
+
+    for ( i=0; i<pairs.lcnt; ++i ) {
+	AW_Glyph *g1 = pairs.left[i];
+	for ( k=0; k<pairs.rcnt; ++k ) {
+	    AW_Glyph *g2 = pairs.right[k];
+	    kern = pairs.kerns[i*pairs.rcnt+k];
+	    if ( !from_closest_approach && kern<min_kern && kern>-min_kern )
+		kern = 0;
 	    if ( only_closer && kern>0 )
 		kern=0;
 	    if ( kern!=0 ) {
@@ -704,8 +822,10 @@ void AutoKern2(SplineFont *sf, int layer,SplineChar **left,SplineChar **right,
 	    }
 	}
     }
-    for ( i=0; i<cnt; ++i )
-	AWGlyphFree( &glyphs[i] );
+    free(pairs.kerns);
+    free(pairs.left);
+    free(pairs.right);
+    aw2_freealledges(&all);
     free(glyphs);
 #if !defined(_NO_PYTHON)
     FFPy_AWDataFree(&all);
@@ -725,6 +845,7 @@ void AutoKern2NewClass(SplineFont *sf,int layer,char **leftnames, char **rightna
     int **ileft = malloc(lcnt*sizeof(int*));
     int **iright = malloc(rcnt*sizeof(int*));
     SplineChar **class, *sc;
+    struct ak2_pairs pairs;
 
     if ( chunk_height <= 0 )
 	chunk_height = (sf->ascent + sf->descent)/200;
@@ -761,11 +882,13 @@ void AutoKern2NewClass(SplineFont *sf,int layer,char **leftnames, char **rightna
 		sc->ticked = sc->ticked2 = false;
 	    } else {
 		glyphs[cnt].sc = sc;
-		sc->ttf_glyph = cnt;
-		aw2_findedges(&glyphs[cnt++], &all);
+		sc->ttf_glyph = cnt++;
 	    }
 	}
     }
+    all.glyphs = glyphs;
+    all.gcnt = cnt;
+    aw2_findalledges(&all);
 
     for ( i=0; i<lcnt; ++i ) {
 	for ( class = left[i], k=0; (sc = class[k])!=NULL; ++k );
@@ -782,22 +905,25 @@ void AutoKern2NewClass(SplineFont *sf,int layer,char **leftnames, char **rightna
 	iright[i][k] = -1;
     }
 
-    all.glyphs = glyphs;
-    all.gcnt = cnt;
+    memset(&pairs,0,sizeof(pairs));
+    pairs.all = &all;
+    pairs.from_closest_approach = from_closest_approach;
+    pairs.lclass = ileft; pairs.lcnt = lcnt;
+    pairs.rclass = iright; pairs.rcnt = rcnt;
+    pairs.kerns = malloc((lcnt*rcnt+1)*sizeof(int));
+    aw2_parallel(lcnt,ak2_figure_pairs,&pairs);
+
     for ( i=0; i<lcnt; ++i ) {
 	for ( k=0; k<rcnt; ++k ) {
-	    if ( from_closest_approach )
-		kern = rint( ak2_figure_touchclass(ileft[i],iright[k],&all));
-	    else {
-		kern = rint( ak2_figure_kernclass(ileft[i],iright[k],&all));
-		if ( kern<min_kern && kern>-min_kern )
-		    kern = 0;
-	    }
+	    kern = pairs.kerns[i*rcnt+k];
+	    if ( !from_closest_approach && kern<min_kern && kern>-min_kern )
+		kern = 0;
 	    if ( kern>0 && only_closer )
 		kern = 0;
 	    (*kcAddOffset)(data,i, k, kern);
 	}
     }
+    free(pairs.kerns);
 
     for ( i=0; i<lcnt; ++i ) {
 	free(ileft[i]);
@@ -809,7 +935,11 @@ void AutoKern2NewClass(SplineFont *sf,int layer,char **leftnames, char **rightna
 	free(right[i]);
     }
     free(iright); free(right);
+    aw2_freealledges(&all);
     free(glyphs);
+#if !defined(_NO_PYTHON)
+    FFPy_AWDataFree(&all);
+#endif		/* PYTHON */
 }
 
 static void kc2AddOffset(void *data,int left_index, int right_index,int offset) {
@@ -821,6 +951,37 @@ static void kc2AddOffset(void *data,int left_index, int right_index,int offset)
 	kc->offsets[left_index*kc->second_cnt+right_index] = offset;
 }
 
+struct ak2_separations {
+    AW_Data *all;
+    SplineChar **leftglyphs, **rightglyphs;
+    int lcnt, rcnt;
+    int *visual_separation;	/* [lcnt*rcnt] */
+};
+
+static void ak2_figure_separations(void *data, int start, int end) {
+    struct ak2_separations *seps = data;
+    AW_Glyph *me;
+    int i, j;
+
+    for ( i=start; i<end; ++i ) {
+	int *vpt = seps->visual_separation + i*seps->rcnt;
+	SplineChar *lsc = seps->leftglyphs[i];
+	if ( lsc->ticked ) {
+	    me = &seps->all->glyphs[lsc->ttf_glyph];
+	    for ( j=0; j<seps->rcnt; ++j ) {
+		SplineChar *rsc = seps->rightglyphs[j];
+		if ( rsc->ticked2 )
+		    vpt[j] = aw2_bbox_separation(me,&seps->all->glyphs[rsc->ttf_glyph],seps->all);
+		else
+		    vpt[j] = 0;
+	    }
+	} else {
+	    for ( j=0; j<seps->rcnt; ++j )
+		vpt[j] = 0;
+	}
+    }
+}
+
 void AutoKern2BuildClasses(SplineFont *sf,int layer,
 	SplineChar **leftglyphs,SplineChar **rightglyphs,
 	struct lookup_subtable *sub,
@@ -828,7 +989,8 @@ void AutoKern2BuildClasses(SplineFont *sf,int layer,
 	int autokern,
 	real good_enough) {
     AW_Data all;
-    AW_Glyph *glyphs, *me, *other;
+    AW_Glyph *glyphs;
+    struct ak2_separations seps;
     int chunk_height;
     int i,j,k,cnt,lcnt,rcnt, lclasscnt,rclasscnt;
     int len;
@@ -840,6 +1002,7 @@ void AutoKern2BuildClasses(SplineFont *sf,int layer,
 
     if ( kc==NULL )
 return;
+    KernClassMapFree(kc);
     // free(kc->firsts); free(kc->seconds); // I think that this forgets to free the contained strings.
     if (kc->firsts != NULL) {
       int tmppos;
@@ -930,39 +1093,26 @@ return;
 		sc->ticked = sc->ticked2 = false;
 	    } else {
 		glyphs[cnt].sc = sc;
-		sc->ttf_glyph = cnt;
-		aw2_findedges(&glyphs[cnt++], &all);
+		sc->ttf_glyph = cnt++;
 	    }
 	}
     }
 
     all.glyphs = glyphs;
     all.gcnt = cnt;
-    visual_separation = malloc(lcnt*rcnt*sizeof(int));
-    for ( i=0; i<lcnt; ++i ) {
-	int *vpt = visual_separation + i*rcnt;
-	SplineChar *lsc = leftglyphs[i];
-	if ( lsc->ticked ) {
-	    me = &all.glyphs[lsc->ttf_glyph];
-	    for ( j=0; j<rcnt; ++j ) {
-		SplineChar *rsc = rightglyphs[j];
-		if ( rsc->ticked2 ) {
-		    other = &all.glyphs[rsc->ttf_glyph];
-		    vpt[j] = aw2_bbox_separation(me,other,&all);
-		} else
-		    vpt[j] = 0;
-	    }
-	} else {
-	    for ( j=0; j<rcnt; ++j )
-		vpt[j] = 0;
-	}
-    }
-    for ( i=0; i<cnt; ++i )
-	AWGlyphFree( &glyphs[i] );
+    aw2_findalledges(&all);
+    visual_separation = malloc((lcnt*rcnt+1)*sizeof(int));
+    memset(&seps,0,sizeof(seps));
+    seps.all = &all;
+    seps.leftglyphs = leftglyphs; seps.lcnt = lcnt;
+    seps.rightglyphs = rightglyphs; seps.rcnt = rcnt;
+    seps.visual_separation = visual_separation;
+    aw2_parallel(lcnt,ak2_figure_separations,&seps);
+    aw2_freealledges(&all);
 #if !defined(_NO_PYTHON)
     FFPy_AWDataFree(&all);
-    free(glyphs); glyphs = all.glyphs = NULL;
 #endif		/* PYTHON */
+    free(glyphs);
     glyphs = all.glyphs = NULL;
 
     good_enough *= good_enough;
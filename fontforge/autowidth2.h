@@ -77,6 +77,8 @@ typedef struct aw_data {
     int min_sidebearing, max_sidebearing;
     unsigned int normalize: 1;
     real denom;
+    short *edges;		/* Single block holding the left/right arrays */
+				/*  of all glyphs, when they were found together */
 #if !defined(_NO_PYTHON)
     void *python_data;
 #endif
@@ -75,15 +75,22 @@ int export_clipboard = 1;
 /* ********************************* Undoes ********************************* */
 
 int maxundoes = 120;		/* -1 is infinite */
+int maxundomemory = 512;	/* Megabytes for all undoes together, 0 is infinite */
 int preserve_hint_undoes = true;
 
+static size_t undo_memory;	/* Bytes held by the undoes on undo lists */
+static size_t undo_trim_at;	/* Don't look for undoes to drop again until here */
+static unsigned int undo_serial;
+
 static uint8_t *bmpcopy(uint8_t *bitmap,int bytes_per_line, int lines) {
     uint8_t *ret = malloc(bytes_per_line*lines);
     memcpy(ret,bitmap,bytes_per_line*lines);
 return( ret );
 }
 
-RefChar *RefCharsCopyState(SplineChar *sc,int layer) {
+/* Without outlines the references are bare, as they are read from sfd */
+/*  files, and FixupRefChars builds the outlines again if they are put back */
+RefChar *RefCharsCopyState(SplineChar *sc,int layer,int outlines) {
     RefChar *head=NULL, *last=NULL, *new, *crefs;
 
     if ( layer<0 || sc->layers[layer].refs==NULL )
@@ -93,10 +100,12 @@ return( NULL );
 	free(new->layers);
 	*new = *crefs;
 	new->layers = calloc(new->layer_cnt,sizeof(struct reflayer));
-	for ( layer=0; layer<new->layer_cnt; ++layer ) {
-	    new->layers[layer] = crefs->layers[layer];
-	    new->layers[layer].splines = SplinePointListCopy(crefs->layers[layer].splines);
-	    new->layers[layer].images = NULL;
+	if ( outlines ) {
+	    for ( layer=0; layer<new->layer_cnt; ++layer ) {
+		new->layers[layer] = crefs->layers[layer];
+		new->layers[layer].splines = SplinePointListCopy(crefs->layers[layer].splines);
+		new->layers[layer].images = NULL;
+	    }
 	}
 	new->next = NULL;
 	if ( last==NULL )
@@ -573,11 +582,220 @@ void UndoesFree(Undoes *undo) {
 	    IError( "Unknown undo type in UndoesFree: %d", undo->undotype );
 	  break;
 	}
+	undo_memory -= undo->bytes;
 	chunkfree(undo,sizeof(Undoes));
 	undo = unext;
     }
 }
 
+static size_t SplinePointListsBytes(SplinePointList *spl) {
+    size_t bytes = 0;
+    SplinePoint *sp;
+
+    for ( ; spl!=NULL; spl=spl->next ) {
+	bytes += sizeof(SplinePointList) + spl->spiro_max*sizeof(spiro_cp);
+	if ( spl->contour_name!=NULL )
+	    bytes += strlen(spl->contour_name)+1;
+	for ( sp=spl->first; sp!=NULL; ) {
+	    bytes += sizeof(SplinePoint);
+	    if ( sp->hintmask!=NULL )
+		bytes += sizeof(HintMask);
+	    if ( sp->next==NULL )
+	break;
+	    bytes += sizeof(Spline);
+	    sp = sp->next->to;
+	    if ( sp==spl->first )
+	break;
+	}
+    }
+return( bytes );
+}
+
+/* Roughly the memory an undo and the undoes it contains use */
+size_t UndoesBytes(Undoes *undo) {
+    size_t bytes = sizeof(Undoes);
+    RefChar *ref;
+    ImageList *img;
+    AnchorPoint *ap;
+    StemInfo *h;
+    PST *pst;
+    int i;
+
+    switch ( undo->undotype ) {
+      case ut_state: case ut_tstate: case ut_statehint: case ut_statename:
+      case ut_hints: case ut_anchors: case ut_statelookup:
+	bytes += SplinePointListsBytes(undo->u.state.splines);
+	for ( ref=undo->u.state.refs; ref!=NULL; ref=ref->next ) {
+	    bytes += sizeof(RefChar) + ref->layer_cnt*sizeof(struct reflayer);
+	    for ( i=0; i<ref->layer_cnt; ++i )
+		bytes += SplinePointListsBytes(ref->layers[i].splines);
+	}
+	for ( img=undo->u.state.images; img!=NULL; img=img->next )
+	    bytes += sizeof(ImageList);		/* The images themselves are shared */
+	for ( ap=undo->u.state.anchor; ap!=NULL; ap=ap->next )
+	    bytes += sizeof(AnchorPoint);
+	for ( h=undo->u.state.hints; h!=NULL; h=h->next ) {
+	    if ( h->hinttype==ht_d ) {
+		for ( h=(StemInfo *) ((DStemInfo *) h)->next; h!=NULL; h=(StemInfo *) ((DStemInfo *) h)->next )
+		    bytes += sizeof(DStemInfo);
+		bytes += sizeof(DStemInfo);
+	break;
+	    }
+	    bytes += sizeof(StemInfo);
+	}
+	bytes += undo->u.state.instrs_len;
+	if ( undo->undotype==ut_statename ) {
+	    if ( undo->u.state.charname!=NULL )
+		bytes += strlen(undo->u.state.charname)+1;
+	    if ( undo->u.state.comment!=NULL )
+		bytes += strlen(undo->u.state.comment)+1;
+	    for ( pst=undo->u.state.possub; pst!=NULL; pst=pst->next )
+		bytes += sizeof(PST);
+	}
+      break;
+      case ut_bitmap:
+	bytes += undo->u.bmpstate.bytes_per_line *
+		(undo->u.bmpstate.ymax-undo->u.bmpstate.ymin+1);
+      break;
+      case ut_multiple: case ut_layers:
+	for ( undo=undo->u.multiple.mult; undo!=NULL; undo=undo->next )
+	    bytes += UndoesBytes(undo);
+      break;
+      case ut_composit:
+	if ( undo->u.composit.state!=NULL )
+	    bytes += UndoesBytes(undo->u.composit.state);
+	for ( undo=undo->u.composit.bitmaps; undo!=NULL; undo=undo->next )
+	    bytes += UndoesBytes(undo);
+      break;
+      default:
+      break;
+    }
+return( bytes );
+}
+
+static void UndoRecount(Undoes *undo) {
+    undo_memory -= undo->bytes;
+    undo->bytes = UndoesBytes(undo);
+    undo_memory += undo->bytes;
+}
+
+size_t UndoMemory(void) {
+return( undo_memory );
+}
+
+struct undoage {
+    unsigned int serial;
+    size_t bytes;
+};
+
+struct undotrim {
+    struct undoage *ages;	/* NULL once a threshold has been picked */
+    int cnt, max;
+    unsigned int threshold;
+};
+
+static void UndoTrimList(struct undotrim *ut,Undoes *undo) {
+    Undoes *prev;
+
+    if ( undo==NULL )
+return;
+    for ( prev=undo, undo=undo->next; undo!=NULL; prev=undo, undo=undo->next ) {
+	if ( ut->ages==NULL ) {
+	    /* Down an undo list serials decrease, so all after this are */
+	    /*  older and would go too. Down a redo list they increase, but */
+	    /*  each redo needs those above it done first, so once this one */
+	    /*  goes none of those after it could be used anyway */
+	    if ( undo->serial<=ut->threshold ) {
+		prev->next = NULL;
+		UndoesFree(undo);
+return;
+	    }
+	} else {
+	    if ( ut->cnt>=ut->max ) {
+		ut->max += 1000;
+		ut->ages = realloc(ut->ages,ut->max*sizeof(struct undoage));
+	    }
+	    ut->ages[ut->cnt].serial = undo->serial;
+	    ut->ages[ut->cnt++].bytes = undo->bytes;
+	}
+    }
+}
+
+static void UndoTrimFont(struct undotrim *ut,SplineFont *sf) {
+    SplineChar *sc;
+    BDFFont *bdf;
+    int gid, layer;
+
+    UndoTrimList(ut,sf->grid.undoes);
+    UndoTrimList(ut,sf->grid.redoes);
+    for ( gid=0; gid<sf->glyphcnt; ++gid ) if ( (sc=sf->glyphs[gid])!=NULL ) {
+	for ( layer=0; layer<sc->layer_cnt; ++layer ) {
+	    UndoTrimList(ut,sc->layers[layer].undoes);
+	    UndoTrimList(ut,sc->layers[layer].redoes);
+	}
+    }
+    for ( bdf=sf->bitmaps; bdf!=NULL; bdf=bdf->next )
+	for ( gid=0; gid<bdf->glyphcnt; ++gid ) if ( bdf->glyphs[gid]!=NULL ) {
+	    UndoTrimList(ut,bdf->glyphs[gid]->undoes);
+	    UndoTrimList(ut,bdf->glyphs[gid]->redoes);
+	}
+}
+
+static void UndoTrimFonts(struct undotrim *ut) {
+    FontViewBase *fv, *test;
+    SplineFont *sf;
+    int i;
+
+    for ( fv=FontViewFirst(); fv!=NULL; fv=fv->next ) {
+	sf = fv->cidmaster!=NULL ? fv->cidmaster : fv->sf;
+	for ( test=FontViewFirst(); test!=fv; test=test->next )
+	    if ( (test->cidmaster!=NULL ? test->cidmaster : test->sf)==sf )
+	break;
+	if ( test!=fv )
+    continue;
+	if ( sf->subfontcnt==0 )
+	    UndoTrimFont(ut,sf);
+	for ( i=0; i<sf->subfontcnt; ++i )
+	    UndoTrimFont(ut,sf->subfonts[i]);
+    }
+}
+
+static int undoage_cmp(const void *_a1, const void *_a2) {
+    const struct undoage *a1 = _a1, *a2 = _a2;
+
+return( a1->serial<a2->serial ? -1 : a1->serial>a2->serial );
+}
+
+/* When the undoes take more than maxundomemory, the oldest ones are */
+/*  dropped, whichever glyphs they belong to, until they take three */
+/*  quarters of it. The last undo of each list is always kept so that */
+/*  whatever was done last can be undone */
+static void UndoTrim(void) {
+    struct undotrim ut;
+    size_t budget = (size_t) maxundomemory*1024*1024, freed = 0;
+    int i;
+
+    memset(&ut,0,sizeof(ut));
+    ut.max = 1000;
+    ut.ages = malloc(ut.max*sizeof(struct undoage));
+    UndoTrimFonts(&ut);
+    if ( ut.cnt!=0 ) {
+	qsort(ut.ages,ut.cnt,sizeof(struct undoage),undoage_cmp);
+	for ( i=0; i<ut.cnt; ++i ) {
+	    ut.threshold = ut.ages[i].serial;
+	    freed += ut.ages[i].bytes;
+	    if ( undo_memory-freed<=budget/4*3 )
+	break;
+	}
+	free(ut.ages); ut.ages = NULL;
+	UndoTrimFonts(&ut);
+    }
+    free(ut.ages);
+    /* Undoes which can't be dropped shouldn't make us look again at every */
+    /*  change, so wait until another quarter of the budget has been used */
+    undo_trim_at = undo_memory>budget/4*3 ? undo_memory+budget/4 : budget;
+}
+
 static Undoes *AddUndo(Undoes *undo,Undoes **uhead,Undoes **rhead) {
     int ucnt;
     Undoes *u, *prev;
@@ -601,8 +819,18 @@ static Undoes *AddUndo(Undoes *undo,Undoes **uhead,Undoes **rhead) {
 		*uhead = NULL;
 	}
     }
+    /* The undo which was at the head may have been changed since it was */
+    /*  added (CVPreserveTState, bitmap selections), so count it again */
+    if ( *uhead!=NULL )
+	UndoRecount(*uhead);
+    undo->serial = ++undo_serial;
+    undo->bytes = 0;
+    UndoRecount(undo);
     undo->next = *uhead;
     *uhead = undo;
+    if ( maxundomemory>0 && undo_memory>=undo_trim_at &&
+	    undo_memory>(size_t) maxundomemory*1024*1024 )
+	UndoTrim();
 
     return( undo );
 }
@@ -640,7 +868,7 @@ return(NULL);
     undo->u.state.width = cv->sc->width;
     undo->u.state.vwidth = cv->sc->vwidth;
     undo->u.state.splines = SplinePointListCopy(cv->layerheads[cv->drawmode]->splines);
-    undo->u.state.refs = RefCharsCopyState(cv->sc,layer);
+    undo->u.state.refs = RefCharsCopyState(cv->sc,layer,true);
     if ( layer==ly_fore ) {
 	undo->u.state.anchor = AnchorPointsCopy(cv->sc->anchor);
     }
@@ -707,7 +935,7 @@ return(NULL);
     undo->u.state.width = sc->width;
     undo->u.state.vwidth = sc->vwidth;
     undo->u.state.splines = SplinePointListCopy(sc->layers[layer].splines);
-    undo->u.state.refs = RefCharsCopyState(sc,layer);
+    undo->u.state.refs = RefCharsCopyState(sc,layer,false);
     if ( layer==ly_fore ) {
 	undo->u.state.anchor = AnchorPointsCopy(sc->anchor);
     }
@@ -965,7 +1193,7 @@ static void SCUndoAct(SplineChar *sc,int layer, Undoes *undo) {
 	    undo->u.state.anchor = ap;
 	}
 	if ( layer!=ly_grid && !RefCharsMatch(undo->u.state.refs,head->refs)) {
-	    RefChar *refs = RefCharsCopyState(sc,layer);
+	    RefChar *refs = RefCharsCopyState(sc,layer,true);
 	    FixupRefChars(sc,undo->u.state.refs,layer);
 	    undo->u.state.refs = refs;
 	}
@@ -1023,6 +1251,7 @@ void CVDoUndo(CharViewBase *cv) {
     undo->next = NULL;
 
     SCUndoAct(cv->sc,CVLayer(cv),undo);
+    UndoRecount(undo);
     undo->next = cv->layerheads[cv->drawmode]->redoes;
     cv->layerheads[cv->drawmode]->redoes = undo;
 
@@ -1038,6 +1267,7 @@ void CVDoRedo(CharViewBase *cv) {
     undo->next = NULL;
 
     SCUndoAct(cv->sc,CVLayer(cv),undo);
+    UndoRecount(undo);
     undo->next = cv->layerheads[cv->drawmode]->undoes;
     cv->layerheads[cv->drawmode]->undoes = undo;
     CVCharChangedUpdate(cv);
@@ -1051,6 +1281,7 @@ return;
     sc->layers[layer].undoes = undo->next;
     undo->next = NULL;
     SCUndoAct(sc,layer,undo);
+    UndoRecount(undo);
     undo->next = sc->layers[layer].redoes;
     sc->layers[layer].redoes = undo;
     _SCCharChangedUpdate(sc,layer,undo->was_modified);
@@ -1065,6 +1296,7 @@ return;
     sc->layers[layer].redoes = undo->next;
     undo->next = NULL;
     SCUndoAct(sc,layer,undo);
+    UndoRecount(undo);
     undo->next = sc->layers[layer].undoes;
     sc->layers[layer].undoes = undo;
     SCCharChangedUpdate(sc,layer);
@@ -1179,6 +1411,7 @@ return;
     bc->undoes = undo->next;
     undo->next = NULL;
     BCUndoAct(bc,undo);
+    UndoRecount(undo);
     undo->next = bc->redoes;
     bc->redoes = undo;
     BCCharChangedUpdate(bc);
@@ -1193,6 +1426,7 @@ return;
     bc->redoes = undo->next;
     undo->next = NULL;
     BCUndoAct(bc,undo);
+    UndoRecount(undo);
     undo->next = bc->undoes;
     bc->undoes = undo;
     BCCharChangedUpdate(bc);
@@ -1906,7 +2140,7 @@ static Undoes *SCCopyAllLayer(SplineChar *sc,enum fvcopy_type full,int layer) {
 	    if ( full==ct_unlinkrefs )
 		cur->u.state.splines = RefCharsCopyUnlinked(cur->u.state.splines,sc,layer);
 	    else
-		cur->u.state.refs = RefCharsCopyState(sc,layer);
+		cur->u.state.refs = RefCharsCopyState(sc,layer,true);
 	    cur->u.state.anchor = AnchorPointsCopy(sc->anchor);
 	    cur->u.state.hints = UHintCopy(sc,true);
 	    if ( copyttfinstr ) {
@@ -8,7 +8,7 @@
 extern "C" {
 #endif
 
-extern int no_windowing_ui, maxundoes;
+extern int no_windowing_ui, maxundoes, maxundomemory;
 
 /**
  * Serialize and undo into a string.
@@ -26,7 +26,7 @@ extern int getAdobeEnc(const char *name);
 extern int SCDependsOnSC(SplineChar *parent, SplineChar *child);
 extern int SCWasEmpty(SplineChar *sc, int skip_this_layer);
 extern RefChar *CopyContainsRef(SplineFont *sf);
-extern RefChar *RefCharsCopyState(SplineChar *sc, int layer);
+extern RefChar *RefCharsCopyState(SplineChar *sc, int layer, int outlines);
 extern SplineSet *ClipBoardToSplineSet(void);
 extern Undoes *BCPreserveState(BDFChar *bc);
 extern Undoes *CVPreserveState(CharViewBase *cv);
@@ -85,6 +85,8 @@ extern void SCDoUndo(SplineChar *sc, int layer);
 extern void SCUndoSetLBearingChange(SplineChar *sc, int lbc);
 extern void *UHintCopy(SplineChar *sc, int docopy);
 extern void UndoesFreeButRetainFirstN(Undoes** undopp, int retainAmount);
+extern size_t UndoesBytes(Undoes *undo);
+extern size_t UndoMemory(void);
 
 #ifdef __cplusplus
 }
@@ -37,6 +37,7 @@
 #include "fontforgevw.h"
 #include "fvfonts.h"
 #include "gfile.h"
+#include "mm.h"
 #include "namelist.h"
 #include "psfont.h"
 #include "psread.h"
@@ -1980,6 +1981,7 @@ int SFForceEncoding(SplineFont *sf,EncMap *old, Encoding *new_enc) {
     if ( sf->mm!=NULL ) {
 	MMSet *mm = sf->mm;
 	int i;
+	MMMaterialize(mm);
 	for ( i=0; i<mm->instance_count; ++i )
 	    _SFForceEncoding(mm->instances[i],old,new_enc);
 	_SFForceEncoding(mm->normal,old,new_enc);
@@ -2524,6 +2526,7 @@ void MMMatchGlyphs(MMSet *mm) {
     SplineFont *sf, *base = NULL;
     SplineChar *sc, *scnew, *sc2;
 
+    MMMaterialize(mm);
     for ( i = 0; i<mm->instance_count; ++i ) if ( mm->instances[i]!=NULL ) {
 	base = mm->instances[i];
     break;
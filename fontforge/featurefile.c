@@ -7454,6 +7454,8 @@ static void fea_NameLookups(struct parseState *tok) {
         }
     }
 
+    SFClearLookupClasses(sf);
+
     /* attach any new gdef mark classes */
     if ( tok->gm_pos[0]>sf->mark_class_cnt ) {
 	int i;
@@ -73,6 +73,8 @@ typedef struct freetypecontext {
 			        /*  times */
     int isttf;
     int em;			/* Em size in the spline font, not ppem */
+    FT_Library library;		/* Owned by this context, which may be used on */
+				/*  another thread, if not NULL */
 } FTC;
 
 extern void *__FreeTypeFontContext(FT_Library context,
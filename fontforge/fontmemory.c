@@ -0,0 +1,356 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fontforge-config.h>
+
+#include "fontmemory.h"
+
+#include "cvundoes.h"
+#include "gimage.h"
+#include "lookups.h"
+#include "splinefont.h"
+
+#include <string.h>
+
+const char *fontmemory_names[fm_max] = {
+    "glyphs", "splines", "points", "references", "hints", "instructions",
+    "undoes", "bitmaps", "images", "pst", "kerns", "lookups", "ttf_tables",
+    "persistent"
+};
+
+static size_t StrBytes(const char *str) {
+    if ( str==NULL )
+return( 0 );
+return( strlen(str)+1 );
+}
+
+static size_t DeviceTableBytes(DeviceTable *dt) {
+    if ( dt==NULL || dt->corrections==NULL )
+return( 0 );
+return( dt->last_pixel_size-dt->first_pixel_size+1 );
+}
+
+/* Contours go in splines and points, unless they are the copies references */
+/*  keep of what they refer to, which go in the references */
+static void ContoursUsage(struct fontmemory *fm,SplineSet *spl,int ref) {
+    SplinePoint *sp;
+    LinearApprox *la;
+    LineList *ll;
+    int spline_type = ref ? fm_refs : fm_splines;
+    int point_type = ref ? fm_refs : fm_points;
+
+    for ( ; spl!=NULL; spl=spl->next ) {
+	fm->bytes[spline_type] += sizeof(SplineSet) + spl->spiro_max*sizeof(spiro_cp) +
+		StrBytes(spl->contour_name);
+	for ( sp=spl->first; sp!=NULL; ) {
+	    fm->bytes[point_type] += sizeof(SplinePoint);
+	    if ( sp->hintmask!=NULL )
+		fm->bytes[point_type] += sizeof(HintMask);
+	    if ( !ref )
+		++fm->count[fm_points];
+	    if ( sp->next==NULL )
+	break;
+	    fm->bytes[spline_type] += sizeof(Spline);
+	    for ( la=sp->next->approx; la!=NULL; la=la->next ) {
+		fm->bytes[spline_type] += sizeof(LinearApprox);
+		for ( ll=la->lines; ll!=NULL; ll=ll->next )
+		    fm->bytes[spline_type] += sizeof(LineList);
+	    }
+	    if ( !ref )
+		++fm->count[fm_splines];
+	    sp = sp->next->to;
+	    if ( sp==spl->first )
+	break;
+	}
+    }
+}
+
+static void ImagesUsage(struct fontmemory *fm,ImageList *img) {
+    struct _GImage *base;
+    int i, cnt;
+
+    for ( ; img!=NULL; img=img->next ) {
+	fm->bytes[fm_images] += sizeof(ImageList);
+	++fm->count[fm_images];
+	if ( img->image==NULL )
+    continue;
+	fm->bytes[fm_images] += sizeof(GImage);
+	cnt = img->image->list_len==0 ? 1 : img->image->list_len;
+	for ( i=0; i<cnt; ++i ) {
+	    base = img->image->list_len==0 ? img->image->u.image : img->image->u.images[i];
+	    fm->bytes[fm_images] += sizeof(struct _GImage) +
+		    (size_t) base->bytes_per_line*base->height;
+	    if ( base->clut!=NULL )
+		fm->bytes[fm_images] += sizeof(GClut);
+	}
+    }
+}
+
+static void UndoesUsage(struct fontmemory *fm,Undoes *undo) {
+    for ( ; undo!=NULL; undo=undo->next ) {
+	fm->bytes[fm_undoes] += UndoesBytes(undo);
+	++fm->count[fm_undoes];
+    }
+}
+
+static size_t HintInstancesBytes(HintInstance *hi) {
+    size_t bytes = 0;
+
+    for ( ; hi!=NULL; hi=hi->next )
+	bytes += sizeof(HintInstance);
+return( bytes );
+}
+
+static void HintsUsage(struct fontmemory *fm,SplineChar *sc) {
+    StemInfo *h;
+    DStemInfo *d;
+    MinimumDistance *md;
+    int i;
+
+    for ( i=0; i<2; ++i ) {
+	for ( h = i ? sc->vstem : sc->hstem; h!=NULL; h=h->next ) {
+	    fm->bytes[fm_hints] += sizeof(StemInfo) + HintInstancesBytes(h->where);
+	    ++fm->count[fm_hints];
+	}
+    }
+    for ( d=sc->dstem; d!=NULL; d=d->next ) {
+	fm->bytes[fm_hints] += sizeof(DStemInfo) + HintInstancesBytes(d->where);
+	++fm->count[fm_hints];
+    }
+    for ( md=sc->md; md!=NULL; md=md->next )
+	fm->bytes[fm_hints] += sizeof(MinimumDistance);
+    fm->bytes[fm_hints] += sc->countermask_cnt*sizeof(HintMask);
+}
+
+static void PSTUsage(struct fontmemory *fm,SplineChar *sc) {
+    PST *pst;
+    AnchorPoint *ap;
+
+    for ( pst=sc->possub; pst!=NULL; pst=pst->next ) {
+	fm->bytes[fm_pst] += sizeof(PST);
+	switch ( pst->type ) {
+	  case pst_pair:
+	    fm->bytes[fm_pst] += StrBytes(pst->u.pair.paired) + 2*sizeof(struct vr);
+	  break;
+	  case pst_substitution:
+	    fm->bytes[fm_pst] += StrBytes(pst->u.subs.variant);
+	  break;
+	  case pst_alternate: case pst_multiple: case pst_ligature:
+	    fm->bytes[fm_pst] += StrBytes(pst->u.mult.components);
+	  break;
+	  case pst_lcaret:
+	    fm->bytes[fm_pst] += pst->u.lcaret.cnt*sizeof(int16_t);
+	  break;
+	  default:
+	  break;
+	}
+	++fm->count[fm_pst];
+    }
+    for ( ap=sc->anchor; ap!=NULL; ap=ap->next ) {
+	fm->bytes[fm_pst] += sizeof(AnchorPoint);
+	++fm->count[fm_pst];
+    }
+}
+
+static void KernPairsUsage(struct fontmemory *fm,KernPair *kp) {
+    for ( ; kp!=NULL; kp=kp->next ) {
+	fm->bytes[fm_kerns] += sizeof(KernPair);
+	if ( kp->adjust!=NULL )
+	    fm->bytes[fm_kerns] += sizeof(DeviceTable) + DeviceTableBytes(kp->adjust);
+	++fm->count[fm_kerns];
+    }
+}
+
+static size_t ClassesBytes(char **classes,char **names,int *flags,int cnt) {
+    size_t bytes = 0;
+    int i;
+
+    if ( classes!=NULL ) {
+	bytes += cnt*sizeof(char *);
+	for ( i=0; i<cnt; ++i )
+	    bytes += StrBytes(classes[i]);
+    }
+    if ( names!=NULL ) {
+	bytes += cnt*sizeof(char *);
+	for ( i=0; i<cnt; ++i )
+	    bytes += StrBytes(names[i]);
+    }
+    if ( flags!=NULL )
+	bytes += cnt*sizeof(int);
+return( bytes );
+}
+
+static void KernClassesUsage(struct fontmemory *fm,KernClass *kc) {
+    int i, cnt;
+
+    for ( ; kc!=NULL; kc=kc->next ) {
+	cnt = kc->first_cnt*kc->second_cnt;
+	fm->bytes[fm_kerns] += sizeof(KernClass) +
+		ClassesBytes(kc->firsts,kc->firsts_names,kc->firsts_flags,kc->first_cnt) +
+		ClassesBytes(kc->seconds,kc->seconds_names,kc->seconds_flags,kc->second_cnt) +
+		cnt*sizeof(int16_t);
+	if ( kc->offsets_flags!=NULL )
+	    fm->bytes[fm_kerns] += cnt*sizeof(int);
+	if ( kc->adjusts!=NULL ) {
+	    fm->bytes[fm_kerns] += cnt*sizeof(DeviceTable);
+	    for ( i=0; i<cnt; ++i )
+		fm->bytes[fm_kerns] += DeviceTableBytes(&kc->adjusts[i]);
+	}
+	if ( kc->map!=NULL )
+	    fm->bytes[fm_kerns] += sizeof(struct kernclassmap) +
+		    kc->map->glyphcnt*(sizeof(SplineChar *)+2*sizeof(uint16_t));
+	++fm->count[fm_kerns];
+    }
+}
+
+static void LookupsUsage(struct fontmemory *fm,OTLookup *otl) {
+    struct lookup_subtable *sub;
+
+    for ( ; otl!=NULL; otl=otl->next ) {
+	fm->bytes[fm_lookups] += sizeof(OTLookup) + StrBytes(otl->lookup_name);
+	for ( sub=otl->subtables; sub!=NULL; sub=sub->next )
+	    fm->bytes[fm_lookups] += sizeof(struct lookup_subtable) +
+		    StrBytes(sub->subtable_name) + StrBytes(sub->suffix);
+	++fm->count[fm_lookups];
+    }
+}
+
+static void PersistentUsage(struct fontmemory *fm,void *persistent) {
+    if ( persistent==NULL )
+return;
+#ifndef _NO_PYTHON
+    fm->bytes[fm_persistent] += PyFF_PersistentBytes(persistent);
+#else
+    fm->bytes[fm_persistent] += StrBytes((char *) persistent);	/* Still pickled */
+#endif
+    ++fm->count[fm_persistent];
+}
+
+static void BitmapsUsage(struct fontmemory *fm,BDFFont *bdf) {
+    BDFChar *bc;
+    BDFRefChar *ref;
+    int i;
+
+    for ( ; bdf!=NULL; bdf=bdf->next ) {
+	fm->bytes[fm_bitmaps] += sizeof(BDFFont) + bdf->glyphmax*sizeof(BDFChar *) +
+		bdf->prop_max*sizeof(BDFProperties);
+	if ( bdf->clut!=NULL )
+	    fm->bytes[fm_bitmaps] += sizeof(GClut);
+	for ( i=0; i<bdf->glyphcnt; ++i ) if ( (bc = bdf->glyphs[i])!=NULL ) {
+	    fm->bytes[fm_bitmaps] += sizeof(BDFChar) +
+		    (size_t) bc->bytes_per_line*(bc->ymax-bc->ymin+1);
+	    for ( ref=bc->refs; ref!=NULL; ref=ref->next )
+		fm->bytes[fm_bitmaps] += sizeof(BDFRefChar);
+	    if ( bc->selection!=NULL )
+		fm->bytes[fm_bitmaps] += sizeof(BDFFloat) +
+			(size_t) bc->selection->bytes_per_line*(bc->selection->ymax-bc->selection->ymin+1);
+	    ++fm->count[fm_bitmaps];
+	    UndoesUsage(fm,bc->undoes);
+	    UndoesUsage(fm,bc->redoes);
+	}
+    }
+}
+
+static void LayerUsage(struct fontmemory *fm,Layer *layer) {
+    RefChar *ref;
+    int i;
+
+    ContoursUsage(fm,layer->splines,false);
+    for ( ref=layer->refs; ref!=NULL; ref=ref->next ) {
+	fm->bytes[fm_refs] += sizeof(RefChar) + ref->layer_cnt*sizeof(struct reflayer);
+	for ( i=0; i<ref->layer_cnt; ++i )
+	    ContoursUsage(fm,ref->layers[i].splines,true);
+	++fm->count[fm_refs];
+    }
+    ImagesUsage(fm,layer->images);
+    UndoesUsage(fm,layer->undoes);
+    UndoesUsage(fm,layer->redoes);
+    PersistentUsage(fm,layer->python_persistent);
+}
+
+static void GlyphUsage(struct fontmemory *fm,SplineChar *sc) {
+    struct altuni *alt;
+    struct splinecharlist *dep;
+    int layer;
+
+    fm->bytes[fm_glyphs] += sizeof(SplineChar) + sc->layer_cnt*sizeof(Layer) +
+	    StrBytes(sc->name) + StrBytes(sc->comment) + StrBytes(sc->glif_name);
+    for ( alt=sc->altuni; alt!=NULL; alt=alt->next )
+	fm->bytes[fm_glyphs] += sizeof(struct altuni);
+    for ( dep=sc->dependents; dep!=NULL; dep=dep->next )
+	fm->bytes[fm_glyphs] += sizeof(struct splinecharlist);
+    ++fm->count[fm_glyphs];
+
+    for ( layer=0; layer<sc->layer_cnt; ++layer )
+	LayerUsage(fm,&sc->layers[layer]);
+    HintsUsage(fm,sc);
+    if ( sc->ttf_instrs_len>0 ) {
+	fm->bytes[fm_instrs] += sc->ttf_instrs_len;
+	++fm->count[fm_instrs];
+    }
+    PSTUsage(fm,sc);
+    KernPairsUsage(fm,sc->kerns);
+    KernPairsUsage(fm,sc->vkerns);
+}
+
+static void TablesUsage(struct fontmemory *fm,struct ttf_table *tab) {
+    for ( ; tab!=NULL; tab=tab->next ) {
+	fm->bytes[fm_ttftables] += sizeof(struct ttf_table) + tab->maxlen;
+	++fm->count[fm_ttftables];
+    }
+}
+
+void SFMemoryUsage(SplineFont *sf,struct fontmemory *fm) {
+    SplineFont *sub;
+    FPST *fpst;
+    int i, k;
+
+    memset(fm,0,sizeof(*fm));
+    if ( sf->cidmaster!=NULL )
+	sf = sf->cidmaster;
+
+    k = 0;
+    do {
+	sub = sf->subfontcnt==0 ? sf : sf->subfonts[k];
+	fm->bytes[fm_glyphs] += sub->glyphmax*sizeof(SplineChar *);
+	for ( i=0; i<sub->glyphcnt; ++i ) if ( sub->glyphs[i]!=NULL )
+	    GlyphUsage(fm,sub->glyphs[i]);
+	++k;
+    } while ( k<sf->subfontcnt );
+
+    LayerUsage(fm,&sf->grid);
+    BitmapsUsage(fm,sf->bitmaps);
+    KernClassesUsage(fm,sf->kerns);
+    KernClassesUsage(fm,sf->vkerns);
+    LookupsUsage(fm,sf->gpos_lookups);
+    LookupsUsage(fm,sf->gsub_lookups);
+    for ( fpst=sf->possub; fpst!=NULL; fpst=fpst->next )
+	fm->bytes[fm_lookups] += sizeof(FPST) + fpst->rule_cnt*sizeof(struct fpst_rule);
+    TablesUsage(fm,sf->ttf_tables);
+    TablesUsage(fm,sf->ttf_tab_saved);
+    PersistentUsage(fm,sf->python_persistent);
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FONTFORGE_FONTMEMORY_H
+#define FONTFORGE_FONTMEMORY_H
+
+#include "splinefont.h"
+
+/*
+ * Roughly how much memory a font takes, by what it is taken by. The walk
+ * counts the structures fontforge allocates for each thing and the arrays
+ * and strings they own, not what malloc adds to each block, so the totals
+ * are a little low but comparable from one call to the next. It touches
+ * every point in the font once and allocates nothing, so it may be called
+ * often.
+ *
+ * Outlines which references keep of what they refer to are counted with
+ * the references, not with the splines and points. Images shared by undoes
+ * and the layers they came from are counted once, with the images.
+ */
+
+enum fontmemory_type {
+    fm_glyphs,		/* SplineChars and their layers, names and encodings */
+    fm_splines,		/* Contours and the splines between points */
+    fm_points,		/* SplinePoints */
+    fm_refs,		/* References and the outlines they copy */
+    fm_hints,		/* Stem hints and counter masks */
+    fm_instrs,		/* TrueType instructions of glyphs */
+    fm_undoes,		/* Undo and redo lists of outlines and bitmaps */
+    fm_bitmaps,		/* Bitmap strikes and the glyphs in them */
+    fm_images,		/* Background and type3 images */
+    fm_pst,		/* Positionings, substitutions, carets and anchors */
+    fm_kerns,		/* Kerning pairs and classes */
+    fm_lookups,		/* Lookups, subtables and contextual rules */
+    fm_ttftables,	/* TrueType tables kept as they were read */
+    fm_persistent,	/* Python data saved with the font and its glyphs */
+    fm_max
+};
+
+struct fontmemory {
+    size_t bytes[fm_max];
+    size_t count[fm_max];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const char *fontmemory_names[fm_max];
+
+extern void SFMemoryUsage(SplineFont *sf, struct fontmemory *fm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FONTFORGE_FONTMEMORY_H */
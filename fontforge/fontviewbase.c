@@ -252,7 +252,8 @@ void FVUndo(FontViewBase *fv) {
 			SCDoUndo(sc,layer);
 			if ( was_blended ) {
 			    for ( j=0; j<mm->instance_count; ++j )
-				SCDoUndo(mm->instances[j]->glyphs[gid],layer);
+				if ( mm->instances[j]->glyphs[gid]!=NULL )
+				    SCDoUndo(mm->instances[j]->glyphs[gid],layer);
 			}
 		    }
 		}
@@ -292,7 +293,8 @@ void FVRedo(FontViewBase *fv) {
 			SCDoRedo(sc,layer);
 			if ( was_blended ) {
 			    for ( j=0; j<mm->instance_count; ++j )
-				SCDoRedo(mm->instances[j]->glyphs[gid],layer);
+				if ( mm->instances[j]->glyphs[gid]!=NULL )
+				    SCDoRedo(mm->instances[j]->glyphs[gid],layer);
 			}
 		    }
 		}
@@ -145,8 +145,12 @@ return;
 
     if ( ftc->face!=NULL )
 	FT_Done_Face(ftc->face);
-    if ( ftc->shared_ftc )
+    if ( ftc->library!=NULL )
+	FT_Done_FreeType(ftc->library);
+    if ( ftc->shared_ftc ) {
+	free(ftc);
 return;
+    }
     if ( ftc->mappedfile )
 #if defined(__MINGW32__) || defined(_MSC_VER)
 		UnmapViewOfFile(ftc->mappedfile);
@@ -354,6 +358,31 @@ return( ftc );
 return( NULL );
 }
 
+/* Another face on the font already loaded by shared_ftc, through a library */
+/*  of its own, so that the two may be used on different threads. Unlike */
+/*  __FreeTypeFontContext this doesn't touch the SplineFont */
+void *FreeTypeThreadContext(void *shared_ftc) {
+    FTC *ftc = calloc(1,sizeof(FTC));
+
+    if ( ftc==NULL )
+return( NULL );
+    *ftc = *(FTC *) shared_ftc;
+    ftc->face = NULL;
+    ftc->library = NULL;
+    ftc->shared_ftc = shared_ftc;
+    if ( FT_Init_FreeType(&ftc->library) ) {
+	ftc->library = NULL;
+	FreeTypeFreeContext(ftc);
+return( NULL );
+    }
+    if ( FT_New_Memory_Face(ftc->library,ftc->mappedfile,ftc->len,0,&ftc->face)) {
+	ftc->face = NULL;
+	FreeTypeFreeContext(ftc);
+return( NULL );
+    }
+return( ftc );
+}
+
 void *_FreeTypeFontContext(SplineFont *sf,SplineChar *sc,FontViewBase *fv,
 	int layer, enum fontformat ff,int flags,void *shared_ftc) {
 
@@ -30,6 +30,7 @@
 #include "delta.h"
 #include "fffreetype.h"
 #include "fontforgevw.h"
+#include "parallel.h"
 #include "splineutil.h"
 
 #include <math.h>
@@ -158,20 +159,66 @@ static void SCFindQuestionablePoints(struct qg_data *data) {
     SplinePointListsFree(gridfit);
 }
 
-void TopFindQuestionablePoints(struct qg_data *data) {
-    char *pt, *end;
-    int low, high;
+/* Each glyph at each size is looked at separately (Duplicate() only looks */
+/*  at what was found for the current glyph), so the glyph x size grid is */
+/*  split between threads. Each chunk gets a face of its own on the font */
+/*  compiled for the whole search and a private copy of the qg_data to */
+/*  collect into; the results are merged in grid order afterwards */
+struct qg_job {
+    SplineChar *sc;
+    int size;
+    QuestionableGrid *qg;
+    int cnt;
+    int unchecked;		/* No FreeType context could be made for it */
+};
 
-    if ( data->fv!=NULL )
-	data->freetype_context = _FreeTypeFontContext(data->fv->sf,NULL,data->fv,data->layer,
-	    ff_ttf,0,NULL);
-    else
-	data->freetype_context = _FreeTypeFontContext(data->sc->parent,data->sc,NULL,data->layer,
-	    ff_ttf,0,NULL);
-    if ( data->freetype_context==NULL ) {
-	data->error = qg_nofont;
+struct qg_work {
+    struct qg_data *data;
+    struct qg_job *jobs;
+    int first;
+};
+
+static void QGFindJob(struct qg_data *local,struct qg_job *job) {
+    local->sc = job->sc;
+    local->cur_size = job->size;
+    local->cur = 0;
+    SCFindQuestionablePoints(local);
+    if ( local->cur!=0 ) {
+	job->qg = malloc(local->cur*sizeof(QuestionableGrid));
+	memcpy(job->qg,local->qg,local->cur*sizeof(QuestionableGrid));
+	job->cnt = local->cur;
+    }
+}
+
+static void QGFindChunk(void *_work,int start,int end) {
+    struct qg_work *work = _work;
+    struct qg_data local = *work->data;
+    int i;
+
+    local.freetype_context = FreeTypeThreadContext(work->data->freetype_context);
+    if ( local.freetype_context==NULL ) {
+	/* Leave these for TopFindQuestionablePoints to do on the shared context */
+	for ( i=work->first+start; i<work->first+end; ++i )
+	    work->jobs[i].unchecked = true;
 return;
     }
+    local.qg = NULL;
+    local.cur = local.max = 0;
+    for ( i=work->first+start; i<work->first+end; ++i )
+	QGFindJob(&local,&work->jobs[i]);
+    free(local.qg);
+    FreeTypeFreeContext(local.freetype_context);
+}
+
+void TopFindQuestionablePoints(struct qg_data *data) {
+    char *pt, *end;
+    int low, high, size;
+    int *sizes = NULL, scnt = 0, smax = 0;
+    SplineChar **glyphs;
+    int gcnt = 0, i, j, cnt;
+    struct qg_work work;
+    struct qg_data local;
+
     data->qg = NULL;
     data->cur = data->max = 0;
     data->error = qg_ok;
@@ -180,7 +227,7 @@ return;
 	low = strtol(pt,&end,10);
 	if ( pt==end ) {
 	    data->error = qg_notnumber;
-return;
+	    break;
 	}
 	while ( *end==' ' ) ++end;
 	if ( *end=='-' ) {
@@ -188,33 +235,90 @@ return;
 	    high = strtol(pt,&end,10);
 	    if ( pt==end ) {
 		data->error = qg_notnumber;
-return;
+		break;
 	    }
 	    if ( high<low ) {
 		data->error = qg_badrange;
-return;
+		break;
 	    }
 	} else
 	    high = low;
 	if ( low<2 || low>4096 || high<2 || high>4096 ) {
 	    data->error = qg_badnumber;
-return;
+	    break;
 	}
 	while ( *end==' ' ) ++end;
 	if ( *end==',' ) ++end;
-	for ( data->cur_size = low; data->cur_size <= high; ++ data->cur_size ) {
-	    if ( data->fv!=NULL ) {
-		int enc, gid;
-		for ( enc=0; enc<data->fv->map->enccount; ++enc ) {
-		    if ( data->fv->selected[enc] && (gid = data->fv->map->map[enc])!=-1 &&
-			    (data->sc = data->fv->sf->glyphs[gid])!=NULL )
-			SCFindQuestionablePoints(data);
-		}
-	    } else {
-		SCFindQuestionablePoints(data);
-	    }
+	for ( size = low; size <= high; ++size ) {
+	    if ( scnt>=smax )
+		sizes = realloc(sizes,(smax += 100)*sizeof(int));
+	    sizes[scnt++] = size;
 	}
     }
+    if ( data->error!=qg_ok ) {
+	free(sizes);
+return;
+    }
+
+    if ( data->fv!=NULL ) {
+	int enc, gid;
+	glyphs = malloc((data->fv->map->enccount+1)*sizeof(SplineChar *));
+	for ( enc=0; enc<data->fv->map->enccount; ++enc ) {
+	    if ( data->fv->selected[enc] && (gid = data->fv->map->map[enc])!=-1 &&
+		    data->fv->sf->glyphs[gid]!=NULL )
+		glyphs[gcnt++] = data->fv->sf->glyphs[gid];
+	}
+	data->freetype_context = _FreeTypeFontContext(data->fv->sf,NULL,data->fv,data->layer,
+	    ff_ttf,0,NULL);
+    } else {
+	glyphs = malloc(sizeof(SplineChar *));
+	glyphs[gcnt++] = data->sc;
+	data->freetype_context = _FreeTypeFontContext(data->sc->parent,data->sc,NULL,data->layer,
+	    ff_ttf,0,NULL);
+    }
+    if ( data->freetype_context==NULL ) {
+	data->error = qg_nofont;
+	free(sizes);
+	free(glyphs);
+return;
+    }
+
+    cnt = scnt*gcnt;
+    work.data = data;
+    work.jobs = calloc(cnt,sizeof(struct qg_job));
+    for ( i=0; i<scnt; ++i ) for ( j=0; j<gcnt; ++j ) {
+	work.jobs[i*gcnt+j].size = sizes[i];
+	work.jobs[i*gcnt+j].sc = glyphs[j];
+    }
+    /* The first glyph is done here, so that FreeType_GridFitChar's check */
+    /*  for a bytecode interpreter happens before the threads start */
+    work.first = 0;
+    if ( cnt>0 ) {
+	QGFindChunk(&work,0,1);
+	work.first = 1;
+	ParallelFor(cnt-1,QGFindChunk,&work);
+    }
+    /* Once the threads are done the shared context is free for any chunk */
+    /*  which could not get one of its own */
+    local = *data;
+    local.qg = NULL;
+    local.cur = local.max = 0;
+    for ( i=0; i<cnt; ++i ) if ( work.jobs[i].unchecked )
+	QGFindJob(&local,&work.jobs[i]);
+    free(local.qg);
+
+    for ( i=0; i<cnt; ++i )
+	data->max += work.jobs[i].cnt;
+    if ( data->max!=0 )
+	data->qg = malloc(data->max*sizeof(QuestionableGrid));
+    for ( i=0; i<cnt; ++i ) if ( work.jobs[i].cnt!=0 ) {
+	memcpy(data->qg+data->cur,work.jobs[i].qg,work.jobs[i].cnt*sizeof(QuestionableGrid));
+	data->cur += work.jobs[i].cnt;
+	free(work.jobs[i].qg);
+    }
+    free(work.jobs);
+    free(sizes);
+    free(glyphs);
     FreeTypeFreeContext(data->freetype_context);
     data->freetype_context = NULL;
 }
@@ -648,6 +648,8 @@ void GlyphHashFree(SplineFont *sf) {
     _GlyphHashFree(sf);
     if ( sf->cidmaster )
 	_GlyphHashFree(sf->cidmaster);
+    /* Glyph names have changed, so kerning classes may refer to others */
+    SFKernClassMapsFree(sf);
 }
 
 static void GlyphHashCreate(SplineFont *sf) {
@@ -684,6 +686,7 @@ void SFHashGlyph(SplineFont *sf,SplineChar *sc) {
     unsigned int hash;
     struct glyphnamebucket *new;
 
+    SFKernClassMapsFree(sf);	/* A kerning class may name the new glyph */
     if ( sf->glyphnames==NULL )
 return;		/* No hash table, nothing to update */
 
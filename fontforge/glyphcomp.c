@@ -34,6 +34,8 @@
 #include "cvundoes.h"
 #include "fontforgevw.h"
 #include "fvfonts.h"
+#include "gfile.h"
+#include "parallel.h"
 #include "scriptfuncs.h"
 #include "splinefill.h"
 #include "splineorder2.h"
@@ -939,20 +941,28 @@ struct font_diff {
     struct lookup_subtable **s2match1, **s1match2;
     int is_gpos;
     struct lookup_subtable *cur_sub1, *cur_sub2;
+    uint8_t *same;		/* By gid1, which hashes agree with the match's */
 };
 
-static void GlyphDiffSCError(struct font_diff *fd, SplineChar *sc, char *format, ... ) {
-    va_list ap;
+enum { fds_outlines=1, fds_lookups=2 };
 
+static void GlyphDiffHeader(struct font_diff *fd) {
     if ( !fd->top_diff ) {
 	fprintf( fd->diffs, "%s", _("Outline Glyphs\n") );
-	fd->top_diff = fd->diff = true;
+	fd->top_diff = true;
     }
     if ( !fd->local_diff ) {
 	putc(' ',fd->diffs);
 	fprintf( fd->diffs, "%s", _("Glyph Differences\n") );
-	fd->local_diff = fd->diff = true;
+	fd->local_diff = true;
     }
+}
+
+static void GlyphDiffSCError(struct font_diff *fd, SplineChar *sc, char *format, ... ) {
+    va_list ap;
+
+    GlyphDiffHeader(fd);
+    fd->diff = true;
     va_start(ap,format);
     if ( fd->last_sc==sc ) {
 	if ( fd->held[0] ) {
@@ -1087,10 +1097,12 @@ static void SCAddBackgrounds(SplineChar *sc1,SplineChar *sc2) {
     SCCharChangedUpdate(sc1,ly_back);
 }
 
-static void SCCompare(SplineChar *sc1,SplineChar *sc2,struct font_diff *fd) {
+/* Returns true if the outlines differ */
+static int SCCompare(SplineChar *sc1,SplineChar *sc2,struct font_diff *fd) {
     int layer, last;
     int val;
     SplinePoint *hmfail;
+    int outlines;
 
     if ( sc1->parent->multilayer && sc1->layer_cnt!=sc2->layer_cnt )
 	GlyphDiffSCError(fd,sc1,U_("Glyph “%s” has a different number of layers\n"),
@@ -1146,8 +1158,7 @@ static void SCCompare(SplineChar *sc1,SplineChar *sc2,struct font_diff *fd) {
 	    }
 	}
     }
-    if ( fd->last_sc==sc1 && (fd->flags&fcf_adddiff2sf1))
-	SCAddBackgrounds(sc1,sc2);
+    outlines = fd->last_sc==sc1;
 
     if ( sc1->width!=sc2->width )
 	GlyphDiffSCError(fd,sc1,U_("Glyph “%s” has advance width %d in %s but %d in %s\n"),
@@ -1176,6 +1187,7 @@ static void SCCompare(SplineChar *sc1,SplineChar *sc2,struct font_diff *fd) {
 		    sc1->name );
     }
     GlyphDiffSCFinish(fd);
+return( outlines );
 }
 
 static void FDAddMissingGlyph(struct font_diff *fd,SplineChar *sc2) {
@@ -1195,10 +1207,232 @@ static void FDAddMissingGlyph(struct font_diff *fd,SplineChar *sc2) {
     SCAddBackgrounds(sc,sc2);
 }
 
+/* Hashes of what SCCompare looks at in a glyph and of the glyph's part in */
+/*  the lookups compared by comparesubtable. A glyph which hashes like its */
+/*  match would be found to be the same, so the two needn't be compared */
+static uint64_t GlyphDiffHashBytes(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *pt = data;
+
+    while ( len-->0 ) {
+	hash ^= *pt++;
+	hash *= UINT64_C(0x100000001b3);
+    }
+return( hash );
+}
+
+static uint64_t GlyphDiffHashInt(uint64_t hash, int val) {
+return( GlyphDiffHashBytes(hash,&val,sizeof(val)) );
+}
+
+static uint64_t GlyphDiffHashReal(uint64_t hash, bigreal val) {
+return( GlyphDiffHashBytes(hash,&val,sizeof(val)) );
+}
+
+static uint64_t GlyphDiffHashStr(uint64_t hash, const char *str) {
+    if ( str==NULL )
+return( GlyphDiffHashInt(hash,-1) );
+return( GlyphDiffHashBytes(hash,str,strlen(str)+1) );
+}
+
+static uint64_t GlyphDiffHashSplines(uint64_t hash, SplineSet *ss) {
+    SplinePoint *sp;
+
+    for ( ; ss!=NULL; ss=ss->next ) {
+	hash = GlyphDiffHashInt(hash,'c');
+	for ( sp=ss->first; ; ) {
+	    hash = GlyphDiffHashReal(hash,sp->me.x);
+	    hash = GlyphDiffHashReal(hash,sp->me.y);
+	    hash = GlyphDiffHashReal(hash,sp->nextcp.x);
+	    hash = GlyphDiffHashReal(hash,sp->nextcp.y);
+	    hash = GlyphDiffHashReal(hash,sp->prevcp.x);
+	    hash = GlyphDiffHashReal(hash,sp->prevcp.y);
+	    if ( sp->hintmask!=NULL )
+		hash = GlyphDiffHashBytes(hash,*sp->hintmask,sizeof(HintMask));
+	    else
+		hash = GlyphDiffHashInt(hash,'n');
+	    if ( sp->next==NULL ) {
+		hash = GlyphDiffHashInt(hash,'o');
+	break;
+	    }
+	    sp = sp->next->to;
+	    if ( sp==ss->first )
+	break;
+	}
+    }
+return( GlyphDiffHashInt(hash,'e') );
+}
+
+static uint64_t SCOutlineHash(SplineChar *sc) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    int layer, last, i;
+    RefChar *r;
+    StemInfo *h;
+
+    last = ly_fore;
+    if ( sc->parent->multilayer ) {
+	last = sc->layer_cnt-1;
+	hash = GlyphDiffHashInt(hash,sc->layer_cnt);
+    }
+    for ( layer=ly_fore; layer<=last; ++layer ) {
+	hash = GlyphDiffHashInt(hash,sc->layers[layer].dofill | (sc->layers[layer].dostroke<<1));
+	hash = GlyphDiffHashSplines(hash,sc->layers[layer].splines);
+	for ( r=sc->layers[layer].refs; r!=NULL; r=r->next ) {
+	    hash = GlyphDiffHashStr(hash,r->sc->name);
+	    hash = GlyphDiffHashInt(hash,r->sc->unicodeenc);
+	    for ( i=0; i<6; ++i )
+		hash = GlyphDiffHashReal(hash,r->transform[i]);
+	    hash = GlyphDiffHashInt(hash,r->point_match);
+	    if ( r->point_match ) {
+		hash = GlyphDiffHashInt(hash,r->match_pt_base);
+		hash = GlyphDiffHashInt(hash,r->match_pt_ref);
+	    }
+	}
+	hash = GlyphDiffHashInt(hash,'r');
+    }
+    hash = GlyphDiffHashInt(hash,sc->width);
+    hash = GlyphDiffHashInt(hash,sc->vwidth);
+    for ( h=sc->hstem; h!=NULL; h=h->next ) {
+	hash = GlyphDiffHashReal(hash,h->start);
+	hash = GlyphDiffHashReal(hash,h->width);
+    }
+    hash = GlyphDiffHashInt(hash,'h');
+    for ( h=sc->vstem; h!=NULL; h=h->next ) {
+	hash = GlyphDiffHashReal(hash,h->start);
+	hash = GlyphDiffHashReal(hash,h->width);
+    }
+    hash = GlyphDiffHashInt(hash,sc->ttf_instrs_len);
+    if ( sc->ttf_instrs_len!=0 )
+	hash = GlyphDiffHashBytes(hash,sc->ttf_instrs,sc->ttf_instrs_len);
+return( hash );
+}
+
+static uint64_t GlyphDiffHashVR(uint64_t hash, struct vr *vr) {
+    hash = GlyphDiffHashInt(hash,vr->xoff);
+    hash = GlyphDiffHashInt(hash,vr->yoff);
+    hash = GlyphDiffHashInt(hash,vr->h_adv_off);
+return( GlyphDiffHashInt(hash,vr->v_adv_off) );
+}
+
+/* comparelookupsubtable compares kerning partners by which glyph of sf2 */
+/*  they are (glyphs are matched by unicode before name), while */
+/*  comparesubtable reports them by name. Hash both, so glyphs which */
+/*  hash alike are the same to either */
+static uint64_t SCLookupHash(SplineChar *sc, struct font_diff *fd, int in_sf1) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    PST *pst;
+    AnchorPoint *ap;
+    KernPair *kp;
+    SplineChar *partner;
+    int isv;
+
+    for ( pst=sc->possub; pst!=NULL; pst=pst->next ) if ( pst->subtable!=NULL ) {
+	hash = GlyphDiffHashStr(hash,pst->subtable->subtable_name);
+	hash = GlyphDiffHashInt(hash,pst->type);
+	if ( pst->type==pst_position )
+	    hash = GlyphDiffHashVR(hash,&pst->u.pos);
+	else if ( pst->type==pst_pair ) {
+	    hash = GlyphDiffHashStr(hash,pst->u.pair.paired);
+	    hash = GlyphDiffHashVR(hash,&pst->u.pair.vr[0]);
+	    hash = GlyphDiffHashVR(hash,&pst->u.pair.vr[1]);
+	} else if ( pst->type==pst_substitution || pst->type==pst_alternate ||
+		pst->type==pst_multiple || pst->type==pst_ligature )
+	    hash = GlyphDiffHashStr(hash,pst->u.subs.variant);
+    }
+    hash = GlyphDiffHashInt(hash,'p');
+    for ( ap=sc->anchor; ap!=NULL; ap=ap->next ) {
+	hash = GlyphDiffHashStr(hash,ap->anchor->subtable!=NULL ? ap->anchor->subtable->subtable_name : NULL);
+	hash = GlyphDiffHashStr(hash,ap->anchor->name);
+	hash = GlyphDiffHashInt(hash,ap->type);
+	hash = GlyphDiffHashReal(hash,ap->me.x);
+	hash = GlyphDiffHashReal(hash,ap->me.y);
+	hash = GlyphDiffHashInt(hash,ap->lig_index);
+	hash = GlyphDiffHashInt(hash,ap->has_ttf_pt ? ap->ttf_pt_index : -1);
+    }
+    for ( isv=0; isv<2; ++isv ) {
+	hash = GlyphDiffHashInt(hash,'k');
+	for ( kp = isv ? sc->vkerns : sc->kerns; kp!=NULL; kp=kp->next ) {
+	    hash = GlyphDiffHashStr(hash,kp->subtable!=NULL ? kp->subtable->subtable_name : NULL);
+	    hash = GlyphDiffHashStr(hash,kp->sc->name);
+	    partner = in_sf1 ? fd->matches[kp->sc->orig_pos] : kp->sc;
+	    hash = GlyphDiffHashInt(hash,partner!=NULL ? partner->orig_pos : -1);
+	    hash = GlyphDiffHashInt(hash,kp->off);
+	}
+    }
+return( hash );
+}
+
+static void GlyphDiffHashRange(void *_fd,int start,int end) {
+    struct font_diff *fd = _fd;
+    SplineChar *sc1, *sc2;
+    int gid1;
+
+    for ( gid1=start; gid1<end; ++gid1 ) {
+	fd->same[gid1] = 0;
+	if ( (sc1=fd->sf1->glyphs[gid1])==NULL || (sc2=fd->matches[gid1])==NULL )
+    continue;
+	if ( (fd->flags&fcf_outlines) && SCOutlineHash(sc1)==SCOutlineHash(sc2) )
+	    fd->same[gid1] |= fds_outlines;
+	if ( (fd->flags&(fcf_gpos|fcf_gsub)) && SCLookupHash(sc1,fd,true)==SCLookupHash(sc2,fd,false) )
+	    fd->same[gid1] |= fds_lookups;
+    }
+}
+
+/* The glyph pairs which hash differently are compared in parallel. Each */
+/*  chunk writes its reports to a file of its own, and those are copied */
+/*  into the diffs in glyph order afterwards */
+struct glyphdiffjob {
+    SplineChar *sc1, *sc2;
+    char *out;			/* What SCCompare wrote, NULL if nothing */
+    unsigned int done: 1;
+    unsigned int diff: 1;
+    unsigned int outlines: 1;	/* SCCompare found the outlines differ */
+    unsigned int serial: 1;	/* sc2 is the match of another glyph too */
+};
+
+struct glyphdiffwork {
+    struct font_diff *fd;
+    struct glyphdiffjob *jobs;
+};
+
+static void GlyphDiffRange(void *_work,int start,int end) {
+    struct glyphdiffwork *work = _work;
+    struct font_diff local = *work->fd;
+    struct glyphdiffjob *job;
+    long len;
+    int i;
+
+    local.diffs = GFileTmpfile();
+    if ( local.diffs==NULL )
+return;			/* Left for the serial pass */
+    /* Headers are written as the reports are merged */
+    local.top_diff = local.local_diff = true;
+    for ( i=start; i<end; ++i ) {
+	job = &work->jobs[i];
+	if ( job->serial )
+    continue;
+	rewind(local.diffs);
+	local.diff = false;
+	local.last_sc = NULL;
+	local.held[0] = '\0';
+	job->outlines = SCCompare(job->sc1,job->sc2,&local);
+	job->diff = local.diff;
+	if ( (len = ftell(local.diffs))>0 ) {
+	    job->out = malloc(len+1);
+	    rewind(local.diffs);
+	    len = fread(job->out,1,len,local.diffs);
+	    job->out[len] = '\0';
+	}
+	job->done = true;
+    }
+    fclose(local.diffs);
+}
+
 static void comparefontglyphs(struct font_diff *fd) {
-    int gid1, gid2;
+    int gid1, gid2, i, cnt;
     SplineChar *sc, *sc2;
     SplineFont *sf1 = fd->sf1, *sf2=fd->sf2;
+    struct glyphdiffwork work;
+    struct glyphdiffjob *job;
 
     fd->top_diff = fd->local_diff = false;
     for ( gid1=0; gid1<fd->sf1_glyphcnt; ++gid1 ) {
@@ -1243,10 +1477,45 @@ return;
     }
 
     fd->local_diff = false;
-    for ( gid1=0; gid1<fd->sf1_glyphcnt; ++gid1 ) {
-	if ( (sc=sf1->glyphs[gid1])!=NULL && (sc2=fd->matches[gid1])!=NULL )
-	    SCCompare(sc,sc2,fd);
+    for ( gid2=0; gid2<sf2->glyphcnt; ++gid2 )
+	if ( (sc=sf2->glyphs[gid2])!=NULL )
+	    sc->ticked = false;
+    work.fd = fd;
+    work.jobs = malloc(fd->sf1_glyphcnt*sizeof(struct glyphdiffjob));
+    for ( gid1=cnt=0; gid1<fd->sf1_glyphcnt; ++gid1 ) {
+	if ( (sc=sf1->glyphs[gid1])!=NULL && (sc2=fd->matches[gid1])!=NULL &&
+		!(fd->same[gid1]&fds_outlines) ) {
+	    memset(&work.jobs[cnt],0,sizeof(struct glyphdiffjob));
+	    work.jobs[cnt].sc1 = sc;
+	    work.jobs[cnt].sc2 = sc2;
+	    /* fdRefCheck marks sc2's references, so sc2 may only be looked */
+	    /*  at by one thread */
+	    for ( i=0; i<cnt && sc2->ticked; ++i )
+		if ( work.jobs[i].sc2==sc2 )
+		    work.jobs[i].serial = work.jobs[cnt].serial = true;
+	    sc2->ticked = true;
+	    ++cnt;
+	}
+    }
+    ParallelFor(cnt,GlyphDiffRange,&work);
+
+    for ( i=0; i<cnt; ++i ) {
+	job = &work.jobs[i];
+	if ( !job->done )
+	    job->outlines = SCCompare(job->sc1,job->sc2,fd);
+	else {
+	    if ( job->out!=NULL ) {
+		GlyphDiffHeader(fd);
+		fputs(job->out,fd->diffs);
+		free(job->out);
+	    }
+	    if ( job->diff )
+		fd->diff = true;
+	}
+	if ( job->outlines && (fd->flags&fcf_adddiff2sf1))
+	    SCAddBackgrounds(job->sc1,job->sc2);
     }
+    free(work.jobs);
 }
 
 static void comparebitmapglyphs(struct font_diff *fd, BDFFont *bdf1, BDFFont *bdf2) {
@@ -1794,7 +2063,7 @@ static int comparelookupsubtable(struct font_diff *fd,struct lookup_subtable *su
     PST *pst1, *pst2;
     AnchorPoint *ap1, *ap2;
     int test_anchors, test_psts, test_kerns;
-    int lookup_type;
+    int lookup_type, same_names;
     int isv;
     KernPair *kp1, *kp2;
 
@@ -1817,7 +2086,10 @@ return( false );
     if ( !test_anchors && !test_kerns && !test_psts )
 return( false );
 
+    same_names = strcmp(sub1->subtable_name,sub2->subtable_name)==0;
     for ( gid1=0; gid1<fd->sf1_glyphcnt; ++gid1 ) if ( (sc2=fd->matches[gid1])!=NULL && (sc1=fd->sf1->glyphs[gid1])!=NULL ) {
+	if ( same_names && (fd->same[gid1]&fds_lookups) )
+    continue;
 	if ( test_psts ) {
 	    for ( pst1=sc1->possub; pst1!=NULL; pst1=pst1->next ) if ( pst1->subtable==sub1 ) {
 		for ( pst2=sc2->possub; pst2!=NULL; pst2=pst2->next ) if ( pst2->subtable==sub2 ) {
@@ -2064,7 +2336,7 @@ static void comparesubtable(struct font_diff *fd) {
     int isv;
     KernPair *kp1, *kp2;
     int test_anchors, test_psts, test_kerns;
-    int lookup_type;
+    int lookup_type, same_names;
 
     fd->last_sc = NULL;
 
@@ -2097,7 +2369,12 @@ static void comparesubtable(struct font_diff *fd) {
 return;
     }
 
+    /* Glyphs whose lookup hashes agree can only differ here if the */
+    /*  subtables were matched to ones of another name */
+    same_names = strcmp(fd->cur_sub1->subtable_name,fd->cur_sub2->subtable_name)==0;
     for ( gid1=0; gid1<fd->sf1_glyphcnt; ++gid1 ) if ( (sc2=fd->matches[gid1])!=NULL && (sc1=fd->sf1->glyphs[gid1])!=NULL ) {
+	if ( same_names && (fd->same[gid1]&fds_lookups) )
+    continue;
 	if ( test_psts ) {
 	    for ( pst1=sc1->possub; pst1!=NULL; pst1=pst1->next ) if ( pst1->subtable==fd->cur_sub1 ) {
 		for ( pst2=sc2->possub; pst2!=NULL; pst2=pst2->next ) if ( pst2->subtable==fd->cur_sub2 ) {
@@ -2332,6 +2609,10 @@ int CompareFonts(SplineFont *sf1, EncMap *map1, SplineFont *sf2, FILE *diffs,
 	}
     }
 
+    fd.same = calloc(sf1->glyphcnt+1,sizeof(uint8_t));
+    if ( flags&(fcf_outlines|fcf_gpos|fcf_gsub) )
+	ParallelFor(sf1->glyphcnt,GlyphDiffHashRange,&fd);
+
     if ( flags&fcf_names )
 	comparefontnames(&fd);
     if ( flags&fcf_outlines )
@@ -2344,6 +2625,7 @@ int CompareFonts(SplineFont *sf1, EncMap *map1, SplineFont *sf2, FILE *diffs,
 	comparegsub(&fd);
 
     free(fd.matches);
+    free(fd.same);
 
     if ( sf1->subfontcnt!=0 && sf2->subfontcnt!=0 ) {
 	free(sf1->glyphs); sf1->glyphs = NULL;
@@ -1161,6 +1161,7 @@ void SFRemoveLookupSubTable(SplineFont *sf,struct lookup_subtable *sub, int remo
     struct lookup_subtable *subprev, *subtest;
 
     if ( sf->cidmaster!=NULL ) sf = sf->cidmaster;
+    SFClearLookupClasses(sf);
 
     if ( sub->sm!=NULL ) {
 	ASM *prev = NULL, *test;
@@ -2183,6 +2184,7 @@ static KernClass *SF_AddKernClass(struct sfmergecontext *mc,KernClass *kc,
     newkc = chunkalloc(sizeof(KernClass));
     *newkc = *kc;
     newkc->subtable = sub;
+    newkc->map = NULL;
     if ( sub->vertical_kerning ) {
 	newkc->next = mc->sf_to->vkerns;
 	mc->sf_to->vkerns = newkc;
@@ -2792,6 +2794,8 @@ struct lookup_data {
 				/*  NULL terminated */
     int pixelsize;
     double scale;
+    struct lookup_classes *classes;
+    int ctx_end;		/* context_pos is -1 from here on */
 };
 
 static int ApplyLookupAtPos(uint32_t tag, OTLookup *otl,struct lookup_data *data,int pos);
@@ -2808,6 +2812,279 @@ return( true );
 return( false );
 }
 
+/* Searching a class string by name for every glyph at every position made */
+/*  big contextual lookups very slow on long strings. So each class we use */
+/*  is compiled into a bitmap indexed by glyph id and kept with the font. */
+/*  The compiled classes are found by the address of the class string, and */
+/*  the first use in each call to ApplyTickedFeatures compares the string */
+/*  with what we compiled, so a class edited behind our back is recompiled */
+/*  rather than used stale. The glyph set is checked the same way. Editing */
+/*  lookups or mark classes throws the whole thing away */
+#define LC_HASH		257
+
+struct classbits {
+    const char *str;		/* The class string this was made from */
+    size_t len;
+    uint32_t hash;
+    int checked;		/* Serial of the last call which looked at str */
+    int stamp;			/* Changes each time the bits are recompiled */
+    uint8_t *bits;		/* One bit per glyph id */
+    struct classbits *next;
+};
+
+struct classids {		/* Which of a list of classes a glyph is in */
+    char **classes;
+    int cnt, first, dflt;
+    int checked;
+    int *stamps;		/* [cnt] of the classbits the ids were made from */
+    uint16_t *ids;		/* [glyph id], the last class containing it */
+    struct classids *next;
+};
+
+struct lookup_classes {
+    int gcnt;
+    SplineChar **glyphs;	/* The glyphs as they were when we compiled */
+    char **names;
+    uint32_t namehash;		/* Of all the glyph names together */
+    int hsize;
+    int *byname;		/* Open hash of glyph ids by name, -1 if empty */
+    int serial, stamps;
+    struct classbits *bits[LC_HASH];
+    struct classids *ids;
+};
+
+static uint32_t LCHashStr(uint32_t hash,const char *str,size_t len) {
+    /* FNV-1a */
+    while ( len-->0 ) {
+	hash ^= (uint8_t) *str++;
+	hash *= 16777619;
+    }
+return( hash );
+}
+
+static int LCGlyphCnt(SplineFont *sf) {
+    int k, cnt;
+
+    if ( sf->subfontcnt==0 )
+return( sf->glyphcnt );
+    for ( k=cnt=0; k<sf->subfontcnt; ++k )
+	if ( sf->subfonts[k]->glyphcnt>cnt )
+	    cnt = sf->subfonts[k]->glyphcnt;
+return( cnt );
+}
+
+static SplineChar *LCGlyph(SplineFont *sf,int gid) {
+    int k;
+
+    if ( sf->subfontcnt==0 )
+return( sf->glyphs[gid] );
+    for ( k=0; k<sf->subfontcnt; ++k )
+	if ( gid<sf->subfonts[k]->glyphcnt && sf->subfonts[k]->glyphs[gid]!=NULL )
+return( sf->subfonts[k]->glyphs[gid] );
+return( NULL );
+}
+
+static uint32_t LCNameHash(SplineFont *sf) {
+    uint32_t hash = 2166136261u;
+    SplineChar *sc;
+    int gid, gcnt = LCGlyphCnt(sf);
+
+    for ( gid=0; gid<gcnt; ++gid ) if ( (sc=LCGlyph(sf,gid))!=NULL )
+	hash = LCHashStr(hash,sc->name,strlen(sc->name)+1);
+return( hash );
+}
+
+static void LookupClassesFree(struct lookup_classes *lc) {
+    struct classbits *cb, *cbnext;
+    struct classids *ci, *cinext;
+    int i;
+
+    if ( lc==NULL )
+return;
+    for ( i=0; i<LC_HASH; ++i ) {
+	for ( cb=lc->bits[i]; cb!=NULL; cb=cbnext ) {
+	    cbnext = cb->next;
+	    free(cb->bits);
+	    free(cb);
+	}
+    }
+    for ( ci=lc->ids; ci!=NULL; ci=cinext ) {
+	cinext = ci->next;
+	free(ci->stamps);
+	free(ci->ids);
+	free(ci);
+    }
+    free(lc->glyphs);
+    free(lc->names);
+    free(lc->byname);
+    free(lc);
+}
+
+void SFClearLookupClasses(SplineFont *sf) {
+    if ( sf==NULL )
+return;
+    if ( sf->cidmaster!=NULL )
+	sf = sf->cidmaster;
+    LookupClassesFree(sf->lookup_classes);
+    sf->lookup_classes = NULL;
+}
+
+static struct lookup_classes *LookupClassesNew(SplineFont *sf) {
+    struct lookup_classes *lc = calloc(1,sizeof(struct lookup_classes));
+    SplineChar *sc;
+    int gid, h;
+
+    lc->gcnt = LCGlyphCnt(sf);
+    lc->glyphs = calloc(lc->gcnt+1,sizeof(SplineChar *));
+    lc->names = calloc(lc->gcnt+1,sizeof(char *));
+    for ( lc->hsize=64; lc->hsize<2*lc->gcnt; lc->hsize<<=1 );
+    lc->byname = malloc(lc->hsize*sizeof(int));
+    memset(lc->byname,-1,lc->hsize*sizeof(int));
+    for ( gid=0; gid<lc->gcnt; ++gid ) if ( (sc=LCGlyph(sf,gid))!=NULL ) {
+	lc->glyphs[gid] = sc;
+	lc->names[gid] = sc->name;
+	h = LCHashStr(2166136261u,sc->name,strlen(sc->name)) & (lc->hsize-1);
+	while ( lc->byname[h]!=-1 )
+	    h = (h+1) & (lc->hsize-1);
+	lc->byname[h] = gid;
+    }
+    lc->namehash = LCNameHash(sf);
+return( lc );
+}
+
+/* Makes sure the font's compiled classes still describe its glyphs, and */
+/*  starts a new round of checks on the class strings */
+static struct lookup_classes *LookupClassesCheck(SplineFont *sf) {
+    struct lookup_classes *lc = sf->lookup_classes;
+    int gid;
+
+    if ( lc!=NULL ) {
+	if ( lc->gcnt!=LCGlyphCnt(sf) )
+	    gid = -1;
+	else {
+	    for ( gid=0; gid<lc->gcnt; ++gid ) {
+		SplineChar *sc = LCGlyph(sf,gid);
+		if ( sc!=lc->glyphs[gid] || (sc!=NULL && sc->name!=lc->names[gid]) )
+	    break;
+	    }
+	}
+	if ( gid!=lc->gcnt || lc->namehash!=LCNameHash(sf) ) {
+	    LookupClassesFree(lc);
+	    lc = NULL;
+	}
+    }
+    if ( lc==NULL )
+	lc = sf->lookup_classes = LookupClassesNew(sf);
+    ++lc->serial;
+return( lc );
+}
+
+static void ClassBitsCompile(struct lookup_classes *lc,struct classbits *cb) {
+    const char *pt, *start;
+    int h, gid;
+
+    memset(cb->bits,0,(lc->gcnt+7)>>3);
+    for ( pt=cb->str; *pt; ) {
+	while ( *pt==' ' ) ++pt;
+	if ( *pt=='\0' )
+    break;
+	for ( start=pt; *pt!=' ' && *pt!='\0'; ++pt );
+	/* Several glyphs may share a name, and all of them are in the class */
+	h = LCHashStr(2166136261u,start,pt-start) & (lc->hsize-1);
+	for ( ; (gid=lc->byname[h])!=-1; h = (h+1) & (lc->hsize-1) ) {
+	    if ( strncmp(lc->names[gid],start,pt-start)==0 && lc->names[gid][pt-start]=='\0' )
+		cb->bits[gid>>3] |= 1<<(gid&7);
+	}
+    }
+    cb->stamp = ++lc->stamps;
+}
+
+static struct classbits *ClassBits(struct lookup_classes *lc,const char *class) {
+    struct classbits *cb;
+    int h = ((uintptr_t) class>>3) % LC_HASH;
+    size_t len;
+    uint32_t hash;
+
+    for ( cb=lc->bits[h]; cb!=NULL && cb->str!=class; cb=cb->next );
+    if ( cb!=NULL && cb->checked==lc->serial )
+return( cb );
+    len = strlen(class);
+    hash = LCHashStr(2166136261u,class,len);
+    if ( cb==NULL ) {
+	cb = calloc(1,sizeof(struct classbits));
+	cb->str = class;
+	cb->bits = malloc((lc->gcnt+7)>>3);
+	cb->next = lc->bits[h];
+	lc->bits[h] = cb;
+    } else if ( cb->len==len && cb->hash==hash ) {
+	cb->checked = lc->serial;
+return( cb );
+    }
+    cb->len = len;
+    cb->hash = hash;
+    cb->checked = lc->serial;
+    ClassBitsCompile(lc,cb);
+return( cb );
+}
+
+static int GlyphInClass(struct lookup_data *data,SplineChar *sc,const char *class) {
+    struct lookup_classes *lc = data->classes;
+    int gid = sc->orig_pos;
+    struct classbits *cb;
+
+    if ( class==NULL )
+return( false );
+    if ( lc==NULL || gid<0 || gid>=lc->gcnt || lc->glyphs[gid]!=sc )
+return( GlyphNameInClass(sc->name,class) );
+    cb = ClassBits(lc,class);
+return( (cb->bits[gid>>3]>>(gid&7))&1 );
+}
+
+/* For a list of classes (classes[first] to classes[cnt-1]) returns an array */
+/*  giving, for each glyph id, the last class which contains it, or dflt */
+static uint16_t *ClassIds(struct lookup_classes *lc,char **classes,int cnt,
+	int first,int dflt) {
+    struct classids *ci;
+    struct classbits *cb;
+    int c, gid, changed;
+
+    for ( ci=lc->ids; ci!=NULL; ci=ci->next )
+	if ( ci->classes==classes && ci->cnt==cnt && ci->first==first && ci->dflt==dflt )
+    break;
+    if ( ci!=NULL && ci->checked==lc->serial )
+return( ci->ids );
+    if ( ci==NULL ) {
+	ci = calloc(1,sizeof(struct classids));
+	ci->classes = classes;
+	ci->cnt = cnt; ci->first = first; ci->dflt = dflt;
+	ci->stamps = calloc(cnt,sizeof(int));
+	ci->ids = malloc(lc->gcnt*sizeof(uint16_t));
+	ci->next = lc->ids;
+	lc->ids = ci;
+	changed = true;
+    } else
+	changed = false;
+    for ( c=first; c<cnt; ++c ) {
+	int stamp = classes[c]==NULL ? 0 : ClassBits(lc,classes[c])->stamp;
+	if ( stamp!=ci->stamps[c] ) {
+	    ci->stamps[c] = stamp;
+	    changed = true;
+	}
+    }
+    if ( changed ) {
+	for ( gid=0; gid<lc->gcnt; ++gid )
+	    ci->ids[gid] = dflt;
+	for ( c=first; c<cnt; ++c ) if ( classes[c]!=NULL ) {
+	    cb = ClassBits(lc,classes[c]);
+	    for ( gid=0; gid<lc->gcnt; ++gid )
+		if ( (cb->bits[gid>>3]>>(gid&7))&1 )
+		    ci->ids[gid] = c;
+	}
+    }
+    ci->checked = lc->serial;
+return( ci->ids );
+}
+
 /* ************************************************************************** */
 /* ************************ Apply Apple State Machines ********************** */
 /* ************************************************************************** */
@@ -2819,6 +3096,8 @@ static void ApplyMacIndicRearrangement(struct lookup_data *data,int verb,
 
     if ( first_pos==-1 || last_pos==-1 || last_pos <= first_pos )
 return;
+    if ( data->ctx_end<=last_pos )
+	data->ctx_end = last_pos+1;
     switch ( verb ) {
       case 1: /* Ax => xA */
 	temp = data->str[first_pos];
@@ -2984,13 +3263,15 @@ return( 0 );
 	data->str[ipos+i].sc = inserts[i];
 	data->str[ipos+i].orig_index = orig_index;
     }
+    data->ctx_end = data->cnt+cnt;
 return( cnt );
 }
 
 static void ApplyAppleStateMachine(OTLookup *otl,struct lookup_data *data) {
     struct lookup_subtable *sub;
-    int state, class, pos, mark_pos, markend_pos, i;
+    int state, class, pos, mark_pos, markend_pos, i, gid;
     ASM *sm;
+    uint16_t *ids;
     int cnt_cur, cnt_mark;
     struct asm_state *entry;
     int kern_stack[8], kcnt;		/* Kerning state machines handle at most 8 glyphs */
@@ -3007,12 +3288,17 @@ static void ApplyAppleStateMachine(OTLookup *otl,struct lookup_data *data) {
     /*  So if there are multiple subtables, just process them all */
     for ( sub=otl->subtables; sub!=NULL; sub=sub->next ) {
 	sm = sub->sm;
+	ids = data->classes!=NULL && sm->class_cnt>=4 ?
+		ClassIds(data->classes,sm->classes,sm->class_cnt,4,1) : NULL;
 
 	state = 0;
 	mark_pos = markend_pos = -1;
 	for ( pos = 0; pos<=data->cnt; ) {
 	    if ( pos==data->cnt )
 		class = 0;
+	    else if ( ids!=NULL && (gid=data->str[pos].sc->orig_pos)>=0 &&
+		    gid<data->classes->gcnt && data->classes->glyphs[gid]==data->str[pos].sc )
+		class = ids[gid];
 	    else {
 		for ( class = sm->class_cnt-1; class>3; --class )
 		    if ( GlyphNameInClass(data->str[pos].sc->name,sm->classes[class]) )
@@ -3157,9 +3443,9 @@ return( pos );
 		(glyph_class==2 && (lookup_flags&pst_ignoreligatures)) ||
 		(glyph_class==3 && (lookup_flags&pst_ignorecombiningmarks)) ||
 		(glyph_class==3 && mc!=0 &&
-			!GlyphNameInClass(data->str[pos].sc->name,data->sf->mark_classes[mc])) ||
+			!GlyphInClass(data,data->str[pos].sc,data->sf->mark_classes[mc])) ||
 		(ms>=0 &&
-			!GlyphNameInClass(data->str[pos].sc->name,data->sf->mark_sets[ms])) ) {
+			!GlyphInClass(data,data->str[pos].sc,data->sf->mark_sets[ms])) ) {
 	    ++pos;
 	} else
     break;
@@ -3187,9 +3473,9 @@ static int bskipmarkglyphs(int lookup_flags, struct lookup_data *data, int pos)
 		(glyph_class==2 && (lookup_flags&pst_ignoreligatures)) ||
 		(glyph_class==3 && (lookup_flags&pst_ignorecombiningmarks)) ||
 		(glyph_class==3 && mc!=0 &&
-			!GlyphNameInClass(data->str[pos].sc->name,data->sf->mark_classes[mc])) ||
+			!GlyphInClass(data,data->str[pos].sc,data->sf->mark_classes[mc])) ||
 		(ms>=0 &&
-			!GlyphNameInClass(data->str[pos].sc->name,data->sf->mark_sets[ms])) ) {
+			!GlyphInClass(data,data->str[pos].sc,data->sf->mark_sets[ms])) ) {
 	    --pos;
 	} else
     break;
@@ -3217,9 +3503,9 @@ return( pos );
 		(glyph_class==2 && (lookup_flags&pst_ignoreligatures)) ||
 		(glyph_class==3 && (lookup_flags&pst_ignorecombiningmarks)) ||
 		(glyph_class==3 && mc!=0 &&
-			!GlyphNameInClass(data->str[pos].sc->name,data->sf->mark_classes[mc])) ||
+			!GlyphInClass(data,data->str[pos].sc,data->sf->mark_classes[mc])) ||
 		(ms>=0 &&
-			!GlyphNameInClass(data->str[pos].sc->name,data->sf->mark_sets[ms])) ) {
+			!GlyphInClass(data,data->str[pos].sc,data->sf->mark_sets[ms])) ) {
 	    --pos;
 	} else
     break;
@@ -3227,6 +3513,19 @@ return( pos );
 return( pos );
 }
 
+static int GlyphInClassZero(struct lookup_data *data,FPST *fpst,SplineChar *sc) {
+    struct lookup_classes *lc = data->classes;
+    int gid = sc->orig_pos, c;
+
+    /* To match class 0 we must fail to match all other classes */
+    if ( lc!=NULL && gid>=0 && gid<lc->gcnt && lc->glyphs[gid]==sc )
+return( ClassIds(lc,fpst->nclass,fpst->nccnt,1,0)[gid]==0 );
+    for ( c=1; c<fpst->nccnt; ++c )
+	if ( GlyphNameInClass(sc->name,fpst->nclass[c]) )
+return( false );
+return( true );
+}
+
 static int ContextualMatch(struct lookup_subtable *sub,struct lookup_data *data,
 	int pos, struct fpst_rule **_rule) {
     int i, cpos, retpos, r;
@@ -3243,8 +3542,11 @@ return( 0 );
 
     for ( r=0; r<fpst->rule_cnt; ++r ) {
 	struct fpst_rule *rule = &fpst->rules[r];
-	for ( i=pos; i<data->cnt; ++i )
+	/* Nothing at or after ctx_end has been marked since it was cleared */
+	for ( i=pos; i<data->ctx_end && i<data->cnt; ++i )
 	    data->str[i].context_pos = -1;
+	if ( data->ctx_end>pos )
+	    data->ctx_end = pos;
 
 /* Handle backtrack (backtrace in the rule is stored in reverse textual order) */
 	if ( fpst->type == pst_chainpos || fpst->type == pst_chainsub ) {
@@ -3262,7 +3564,7 @@ return( 0 );
     continue;		/* didn't match */
 	    } else if ( fpst->format==pst_class ) {
 		for ( i=bskipglyphs(lookup_flags,data,pos-1), cpos=0; i>=0 && cpos<rule->u.fpc_class.bcnt; i = bskipglyphs(lookup_flags,data,i-1)) {
-		    if ( !GlyphNameInClass(data->str[i].sc->name,fpst->bclass[rule->u.fpc_class.bclasses[cpos]]) )
+		    if ( !GlyphInClass(data,data->str[i].sc,fpst->bclass[rule->u.fpc_class.bclasses[cpos]]) )
 		break;
 		    ++cpos;
 		}
@@ -3270,7 +3572,7 @@ return( 0 );
     continue;		/* didn't match */
 	    } else if ( fpst->format==pst_coverage ) {
 		for ( i=bskipglyphs(lookup_flags,data,pos-1), cpos=0; i>=0 && cpos<rule->u.coverage.bcnt; i = bskipglyphs(lookup_flags,data,i-1)) {
-		    if ( !GlyphNameInClass(data->str[i].sc->name,rule->u.coverage.bcovers[cpos]) )
+		    if ( !GlyphInClass(data,data->str[i].sc,rule->u.coverage.bcovers[cpos]) )
 		break;
 		    ++cpos;
 		}
@@ -3287,6 +3589,7 @@ return( 0 );
 		if ( strncmp(name,pt,len)!=0 || (pt[len]!='\0' && pt[len]!=' '))
 	    break;
 		data->str[i].context_pos = cpos++;
+		data->ctx_end = i+1;
 		pt += len;
 		while ( *pt==' ' ) ++pt;
 	    }
@@ -3296,26 +3599,21 @@ return( 0 );
 	    for ( i=pos, cpos=0; i<data->cnt && cpos<rule->u.fpc_class.ncnt; i = skipglyphs(lookup_flags,data,i+1)) {
 		int classnum = rule->u.fpc_class.nclasses[cpos];
 		if ( classnum!=0 ) {
-		    if ( !GlyphNameInClass(data->str[i].sc->name,fpst->nclass[classnum]) )
+		    if ( !GlyphInClass(data,data->str[i].sc,fpst->nclass[classnum]) )
 	    break;
-		} else {
-		    int c;
-		    /* Ok, to match class 0 we must fail to match all other classes */
-		    for ( c=1; c<fpst->nccnt; ++c )
-			if ( !GlyphNameInClass(data->str[i].sc->name,fpst->nclass[c]) )
-		    break;
-		    if ( c!=fpst->nccnt )
+		} else if ( !GlyphInClassZero(data,fpst,data->str[i].sc) )
 	    break;		/* It matched another class => not in class 0 */
-		}
 		data->str[i].context_pos = cpos++;
+		data->ctx_end = i+1;
 	    }
 	    if ( cpos<rule->u.fpc_class.ncnt )
     continue;		/* didn't match */
 	} else if ( fpst->format==pst_coverage ) {
 	    for ( i=pos, cpos=0; i<data->cnt && cpos<rule->u.coverage.ncnt; i = skipglyphs(lookup_flags,data,i+1)) {
-		if ( !GlyphNameInClass(data->str[i].sc->name,rule->u.coverage.ncovers[cpos]) )
+		if ( !GlyphInClass(data,data->str[i].sc,rule->u.coverage.ncovers[cpos]) )
 	    break;
 		data->str[i].context_pos = cpos++;
+		data->ctx_end = i+1;
 	    }
 	    if ( cpos<rule->u.coverage.ncnt )
     continue;		/* didn't match */
@@ -3339,7 +3637,7 @@ return( 0 );		/* Not ready to deal with reverse chainging */
     continue;		/* didn't match */
 	    } else if ( fpst->format==pst_class ) {
 		for ( i=retpos, cpos=0; i<data->cnt && cpos<rule->u.fpc_class.fcnt; i = skipglyphs(lookup_flags,data,i+1)) {
-		    if ( !GlyphNameInClass(data->str[i].sc->name,fpst->fclass[rule->u.fpc_class.fclasses[cpos]]) )
+		    if ( !GlyphInClass(data,data->str[i].sc,fpst->fclass[rule->u.fpc_class.fclasses[cpos]]) )
 		break;
 		    cpos++;
 		}
@@ -3347,7 +3645,7 @@ return( 0 );		/* Not ready to deal with reverse chainging */
     continue;		/* didn't match */
 	    } else if ( fpst->format==pst_coverage ) {
 		for ( i=retpos, cpos=0; i<data->cnt && cpos<rule->u.coverage.fcnt; i = skipglyphs(lookup_flags,data,i+1)) {
-		    if ( !GlyphNameInClass(data->str[i].sc->name,rule->u.coverage.fcovers[cpos]) )
+		    if ( !GlyphInClass(data,data->str[i].sc,rule->u.coverage.fcovers[cpos]) )
 		break;
 		    cpos++;
 		}
@@ -3430,6 +3728,7 @@ return( pos+1 );
 	    data->str[pos+i].orig_index = data->str[pos].orig_index;
 	}
 	data->cnt += (mcnt-1);
+	data->ctx_end = data->cnt;
 return( pos+mcnt );
     }
 }
@@ -3569,8 +3868,8 @@ static int ApplyPairPosAtPos(struct lookup_subtable *sub,struct lookup_data *dat
 return( 0 );
     if ( sub->kc!=NULL ) {
 	kcspecd = sub->kc->firsts[0] != NULL;
-	f = KCFindName(data->str[pos].sc->name ,sub->kc->firsts ,sub->kc->first_cnt ,allow_class0);
-	l = KCFindName(data->str[npos].sc->name,sub->kc->seconds,sub->kc->second_cnt,allow_class0);
+	f = KCFindGlyph(data->sf,sub->kc,data->str[pos].sc ,true ,allow_class0);
+	l = KCFindGlyph(data->sf,sub->kc,data->str[npos].sc,false,allow_class0);
 	if ( f==-1 || l==-1 || ( !kcspecd && f==0 && l==0 ) )
 return( 0 );
 	data->str[pos].kc_index = within = f*sub->kc->second_cnt+l;
@@ -3877,6 +4176,8 @@ struct opentype_str *ApplyTickedFeatures(SplineFont *sf,uint32_t *flist, uint32_
     }
     if ( sf->cidmaster!=NULL ) sf=sf->cidmaster;
     data.sf = sf;
+    data.classes = LookupClassesCheck(sf);
+    SFKernClassMapsBuild(sf);
     data.pixelsize = pixelsize;
     data.scale = pixelsize/(double) (sf->ascent+sf->descent);
 
@@ -4146,6 +4447,7 @@ void SFGlyphRenameFixup(SplineFont *sf, const char *old, const char *new, int re
 		if ( rplstr(&kc->seconds[i],old,new,false))
 	    break;
 	    }
+	    KernClassMapFree(kc);
 	}
     }
 }
@@ -4705,6 +5007,187 @@ return( i );
 return( classnames[0]!=NULL || !allow_class0 ? -1 : 0 );
 }
 
+/* Finding a glyph's class by searching the class strings for its name is */
+/*  slow when done for every pair (as the metrics view and the pair */
+/*  positioning code do), so each kerning class keeps a map from glyph id */
+/*  (orig_pos) to class. It is thrown away when the classes or the glyphs */
+/*  change, and rebuilt when next wanted. We also remember which glyph had */
+/*  each id, so glyphs which have been moved about are noticed */
+static int KCMapGlyphCnt(SplineFont *sf) {
+    int k, cnt = sf->glyphcnt;
+
+    for ( k=0; k<sf->subfontcnt; ++k )
+	if ( sf->subfonts[k]->glyphcnt>cnt )
+	    cnt = sf->subfonts[k]->glyphcnt;
+return( cnt );
+}
+
+static uint16_t *KCMapClasses(SplineFont *sf, char **classnames, int cnt, int glyphcnt) {
+    uint16_t *class = malloc(glyphcnt*sizeof(uint16_t));
+    char *pt, *end, ch;
+    SplineChar *sc;
+    int i;
+
+    for ( i=0; i<glyphcnt; ++i )
+	class[i] = KC_NO_CLASS;
+    for ( i=0; i<cnt; ++i ) {
+	if ( classnames[i]==NULL )
+    continue;
+	for ( pt = classnames[i]; *pt; pt = end+1 ) {
+	    while ( *pt==' ' ) ++pt;
+	    if ( *pt=='\0' )
+	break;
+	    end = strchr(pt,' ');
+	    if ( end==NULL )
+		end = pt+strlen(pt);
+	    ch = *end;
+	    *end = '\0';
+	    sc = SFGetChar(sf,-1,pt);
+	    /* As with KCFindName the first class to contain a glyph wins */
+	    if ( sc!=NULL && sc->orig_pos<glyphcnt && class[sc->orig_pos]==KC_NO_CLASS )
+		class[sc->orig_pos] = i;
+	    *end = ch;
+	    if ( ch=='\0' )
+	break;
+	}
+    }
+return( class );
+}
+
+void KernClassMapFree(KernClass *kc) {
+    if ( kc->map==NULL )
+return;
+    free(kc->map->glyphs);
+    free(kc->map->first);
+    free(kc->map->second);
+    chunkfree(kc->map,sizeof(struct kernclassmap));
+    kc->map = NULL;
+}
+
+/* This gets called while fonts are being freed, so it doesn't look at */
+/*  the other subfonts of a cid keyed font */
+void SFKernClassMapsFree(SplineFont *sf) {
+    KernClass *kc;
+    int isv;
+
+    for ( isv=0; isv<2; ++isv ) {
+	for ( kc = isv ? sf->vkerns : sf->kerns; kc!=NULL; kc=kc->next )
+	    KernClassMapFree(kc);
+	if ( sf->cidmaster!=NULL )
+	    for ( kc = isv ? sf->cidmaster->vkerns : sf->cidmaster->kerns; kc!=NULL; kc=kc->next )
+		KernClassMapFree(kc);
+    }
+}
+
+struct kernclassmap *KernClassMap(SplineFont *sf, KernClass *kc) {
+    struct kernclassmap *map = kc->map;
+    int glyphcnt = KCMapGlyphCnt(sf);
+    int i, k;
+
+    /* Most edits replace the class lists, so check those too in case */
+    /*  someone forgot to tell us */
+    if ( map!=NULL && (map->sf!=sf || map->glyphcnt!=glyphcnt ||
+	    map->firsts!=kc->firsts || map->seconds!=kc->seconds ||
+	    map->first_cnt!=kc->first_cnt || map->second_cnt!=kc->second_cnt ))
+	KernClassMapFree(kc);
+    if ( kc->map==NULL ) {
+	kc->map = map = chunkalloc(sizeof(struct kernclassmap));
+	map->sf = sf;
+	map->glyphcnt = glyphcnt;
+	map->firsts = kc->firsts; map->first_cnt = kc->first_cnt;
+	map->seconds = kc->seconds; map->second_cnt = kc->second_cnt;
+	map->glyphs = calloc(glyphcnt,sizeof(SplineChar *));
+	k = 0;
+	do {
+	    SplineFont *ssf = sf->subfontcnt==0 ? sf : sf->subfonts[k];
+	    for ( i=0; i<ssf->glyphcnt; ++i )
+		if ( ssf->glyphs[i]!=NULL )
+		    map->glyphs[i] = ssf->glyphs[i];
+	    ++k;
+	} while ( k<sf->subfontcnt );
+	map->first = KCMapClasses(sf,kc->firsts,kc->first_cnt,glyphcnt);
+	map->second = KCMapClasses(sf,kc->seconds,kc->second_cnt,glyphcnt);
+    }
+return( map );
+}
+
+/* As above, but make sure every glyph is where it was when the map was */
+/*  built. This is for output, which may be working on a subset of a font */
+struct kernclassmap *KernClassMapVerified(SplineFont *sf, KernClass *kc) {
+    struct kernclassmap *map = KernClassMap(sf,kc);
+    int i, k = 0;
+
+    do {
+	SplineFont *ssf = sf->subfontcnt==0 ? sf : sf->subfonts[k];
+	for ( i=0; i<ssf->glyphcnt; ++i )
+	    if ( ssf->glyphs[i]!=NULL && map->glyphs[i]!=ssf->glyphs[i] ) {
+		KernClassMapFree(kc);
+return( KernClassMap(sf,kc));
+	    }
+	++k;
+    } while ( k<sf->subfontcnt );
+return( map );
+}
+
+/* Builds the maps of all the font's kerning classes now, so that looking */
+/*  glyphs up in them afterwards changes nothing (as long as the glyphs */
+/*  stay put). Do this before looking up classes on several threads */
+void SFKernClassMapsBuild(SplineFont *sf) {
+    KernClass *kc;
+    int isv;
+
+    if ( sf->cidmaster!=NULL )
+	sf = sf->cidmaster;
+    for ( isv=0; isv<2; ++isv )
+	for ( kc = isv ? sf->vkerns : sf->kerns; kc!=NULL; kc=kc->next )
+	    KernClassMap(sf,kc);
+}
+
+static int KCOwnGlyph(SplineFont *sf, SplineChar *sc) {
+    SplineFont *parent = sc->parent;
+
+    if ( parent==NULL )
+return( false );
+    if ( parent->cidmaster!=NULL )
+	parent = parent->cidmaster;
+    if ( sf->cidmaster!=NULL )
+	sf = sf->cidmaster;
+return( parent==sf );
+}
+
+/* The same answer as KCFindName(sc->name,...) without looking at the names */
+/*  for glyphs of sf. Glyphs of other fonts are in no class */
+int KCFindGlyph(SplineFont *sf, KernClass *kc, SplineChar *sc, int isfirst, int allow_class0) {
+    struct kernclassmap *map = KernClassMap(sf,kc);
+    uint16_t *class;
+    char **classnames = isfirst ? kc->firsts : kc->seconds;
+
+    if ( sc->orig_pos<0 || sc->orig_pos>=map->glyphcnt )
+return( classnames[0]!=NULL || !allow_class0 ? -1 : 0 );
+    if ( map->glyphs[sc->orig_pos]!=sc ) {
+	if ( !KCOwnGlyph(sf,sc) )
+return( classnames[0]!=NULL || !allow_class0 ? -1 : 0 );
+	/* One of ours which has moved since the map was built */
+	KernClassMapFree(kc);
+	map = KernClassMap(sf,kc);
+    }
+    class = isfirst ? map->first : map->second;
+    if ( class[sc->orig_pos]!=KC_NO_CLASS )
+return( class[sc->orig_pos] );
+return( classnames[0]!=NULL || !allow_class0 ? -1 : 0 );
+}
+
+/* The kerning offset between two glyphs, or 0 if the classes don't have one */
+/*  (the same pairs as ApplyPairPosAtPos kerns) */
+int KernClassPairOffset(SplineFont *sf, KernClass *kc, SplineChar *first, SplineChar *second) {
+    int f = KCFindGlyph(sf,kc,first,true,true);
+    int l = KCFindGlyph(sf,kc,second,false,true);
+
+    if ( f==-1 || l==-1 || ( kc->firsts[0]==NULL && f==0 && l==0 ))
+return( 0 );
+return( kc->offsets[f*kc->second_cnt+l] );
+}
+
 /* Routines to generate human readable forms of FPST rules */
 static void GrowBufferAddLookup(GrowBuf *gb,struct fpst_rule *rule, int seq) {
     int i;
@@ -10,6 +10,19 @@ extern "C" {
 
 typedef struct cpp_SubtableMap cpp_SubtableMap;
 
+#define KC_NO_CLASS	0xffff
+
+/* Which class each glyph is in, by glyph id, for a KernClass. Glyphs in no */
+/*  class (so in class 0 if that is unspecified) have KC_NO_CLASS */
+struct kernclassmap {
+    SplineFont *sf;		/* The font whose glyph ids these are */
+    int glyphcnt;
+    SplineChar **glyphs;	/* The glyph with each id when this was built */
+    char **firsts, **seconds;	/* The class lists this was built from */
+    int first_cnt, second_cnt;
+    uint16_t *first, *second;
+};
+
 struct sllk {
 	uint32_t script;
 	int cnt;
@@ -64,6 +77,8 @@ extern int FeatureScriptTagInFeatureScriptList(uint32_t feature, uint32_t script
 extern int GlyphNameCnt(const char *pt);
 extern int IsAnchorClassUsed(SplineChar *sc, AnchorClass *an);
 extern int KCFindName(const char *name, char **classnames, int cnt, int allow_class0);
+extern int KCFindGlyph(SplineFont *sf, KernClass *kc, SplineChar *sc, int isfirst, int allow_class0);
+extern int KernClassPairOffset(SplineFont *sf, KernClass *kc, SplineChar *first, SplineChar *second);
 extern int KernClassContains(KernClass *kc, const char *name1, const char *name2, int ordered);
 extern int LookupUsedNested(SplineFont *sf, OTLookup *checkme);
 extern int PSTContains(const char *components, const char *name);
@@ -77,6 +92,11 @@ extern SplineChar **SFGlyphsWithLigatureinLookup(SplineFont *sf, struct lookup_s
 extern void SFCollectSubtableMap(SplineFont *sf, cpp_SubtableMap *map);
 extern SplineChar **SFGlyphsWithPSTinSubtable(SplineFont *sf, struct lookup_subtable *subtable, cpp_SubtableMap *map);
 extern struct lookup_subtable *SFFindLookupSubtableAndFreeName(SplineFont *sf, char *name);
+extern struct kernclassmap *KernClassMap(SplineFont *sf, KernClass *kc);
+extern struct kernclassmap *KernClassMapVerified(SplineFont *sf, KernClass *kc);
+extern void KernClassMapFree(KernClass *kc);
+extern void SFKernClassMapsBuild(SplineFont *sf);
+extern void SFKernClassMapsFree(SplineFont *sf);
 extern struct lookup_subtable *SFSubTableFindOrMake(SplineFont *sf, uint32_t tag, uint32_t script, int lookup_type);
 extern struct lookup_subtable *SFSubTableMake(SplineFont *sf, uint32_t tag, uint32_t script, int lookup_type);
 extern struct opentype_str *ApplyTickedFeatures(SplineFont *sf, uint32_t *flist, uint32_t script, uint32_t lang, bool gpos_only, int pixelsize, SplineChar **glyphs);
@@ -98,6 +118,7 @@ extern void OTLookupsCopyInto(SplineFont *into_sf, SplineFont *from_sf, OTLookup
 extern void SFFindClearUnusedLookupBits(SplineFont *sf);
 extern void SFFindUnusedLookups(SplineFont *sf);
 extern void SFGlyphRenameFixup(SplineFont *sf, const char *old, const char *new_name, int rename_related_glyphs);
+extern void SFClearLookupClasses(SplineFont *sf);
 extern void SFRemoveLookup(SplineFont *sf, OTLookup *otl, int remove_acs);
 extern void SFRemoveLookupSubTable(SplineFont *sf, struct lookup_subtable *sub, int remove_acs);
 extern void SFRemoveUnusedLookupSubTables(SplineFont *sf, int remove_incomplete_anchorclasses, int remove_unused_lookups);
@@ -29,10 +29,13 @@
 
 #include "mm.h"
 
+#include "cvundoes.h"
 #include "dumppfa.h"
 #include "fontforgevw.h"
+#include "fvfonts.h"
 #include "lookups.h"
 #include "macenc.h"
+#include "parsettf.h"
 #include "splinesaveafm.h"
 #include "splineutil.h"
 #include "splineutil2.h"
@@ -1039,6 +1042,8 @@ return( false );
     }
 
     for ( i=0; i<sf->glyphcnt; ++i ) {
+	if ( mm->apple && MMGlyphStillDeltas(mm,i) )
+    continue;		/* Untouched since we read it, so it's fine */
 	for ( j=mm->apple?0:1; j<mm->instance_count; ++j ) {
 	    if ( SCWorthOutputting(sf->glyphs[i])!=SCWorthOutputting(mm->instances[j]->glyphs[i]) ) {
 		if ( complain ) {
@@ -1194,3 +1199,366 @@ return( false );
 	ff_post_notice(_("OK"),_("No problems detected"));
 return( true );
 }
+
+/* ************************************************************************** */
+/* Apple distortable fonts read from a 'gvar' table don't get their instance  */
+/*  glyphs built when the font is loaded. Instead we keep a compact copy of   */
+/*  each default glyph as it was read and the deltas each tuple adds to it.   */
+/*  An instance glyph is made when something asks for it, and a glyph that    */
+/*  nobody has edited is written back out straight from its deltas           */
+/* ************************************************************************** */
+
+#define _On_Curve	1		/* As in the glyf table */
+
+struct mmdeltas *MMDeltasNew(int gcnt, int tuple_count, int axis_count) {
+    struct mmdeltas *md = calloc(1,sizeof(struct mmdeltas));
+    int i;
+
+    md->gcnt = gcnt;
+    md->tuple_count = tuple_count;
+    md->axis_count = axis_count;
+    md->coords = calloc(tuple_count*axis_count,sizeof(real));
+    md->pcnt = calloc(gcnt,sizeof(int));
+    md->base = calloc(gcnt,sizeof(struct mmglyphbase *));
+    md->deltas = malloc(tuple_count*sizeof(int16_t **));
+    for ( i=0; i<tuple_count; ++i )
+	md->deltas[i] = calloc(gcnt,sizeof(int16_t *));
+return( md );
+}
+
+static void MMGlyphBaseFree(struct mmglyphbase *base) {
+    if ( base==NULL )
+return;
+    free(base->endpt);
+    free(base->flags);
+    free(base->xy);
+    free(base->refs);
+    free(base);
+}
+
+void MMDeltasFree(struct mmdeltas *md) {
+    int i,j;
+
+    if ( md==NULL )
+return;
+    for ( i=0; i<md->tuple_count; ++i ) {
+	for ( j=0; j<md->gcnt; ++j )
+	    free(md->deltas[i][j]);
+	free(md->deltas[i]);
+    }
+    free(md->deltas);
+    for ( j=0; j<md->gcnt; ++j )
+	MMGlyphBaseFree(md->base[j]);
+    free(md->base);
+    free(md->pcnt);
+    free(md->coords);
+    free(md);
+}
+
+static struct mmglyphbase *MMGlyphBaseNew(SplineChar *sc,int pcnt) {
+    struct mmglyphbase *base = calloc(1,sizeof(struct mmglyphbase));
+    SplineSet *ss;
+    SplinePoint *sp;
+    RefChar *r;
+    int i, last;
+
+    base->width = sc->width;
+    base->vwidth = sc->vwidth;
+    if ( sc->layers[ly_fore].refs!=NULL ) {
+	for ( r=sc->layers[ly_fore].refs; r!=NULL; r=r->next )
+	    ++base->refcnt;
+	base->refs = calloc(base->refcnt,sizeof(struct mmbaseref));
+	for ( i=0, r=sc->layers[ly_fore].refs; r!=NULL; ++i, r=r->next ) {
+	    base->refs[i].gid = r->sc->orig_pos;
+	    memcpy(base->refs[i].transform,r->transform,sizeof(r->transform));
+	    base->refs[i].use_my_metrics = r->use_my_metrics;
+	    base->refs[i].round_translation_to_grid = r->round_translation_to_grid;
+	    base->refs[i].point_match = r->point_match;
+	    base->refs[i].match_pt_base = r->match_pt_base;
+	    base->refs[i].match_pt_ref = r->match_pt_ref;
+	}
+return( base );
+    }
+
+    for ( ss=sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next )
+	++base->path_cnt;
+    base->endpt = malloc((base->path_cnt+1)*sizeof(uint16_t));
+    base->flags = calloc(pcnt+1,1);
+    base->xy = calloc(2*pcnt+1,sizeof(int16_t));
+    for ( i=0, ss=sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
+	last = -1;
+	for ( sp=ss->first; ; ) {
+	    if ( sp->ttfindex<pcnt ) {
+		base->flags[sp->ttfindex] = _On_Curve;
+		base->xy[2*sp->ttfindex] = rint(sp->me.x);
+		base->xy[2*sp->ttfindex+1] = rint(sp->me.y);
+		if ( sp->ttfindex>last ) last = sp->ttfindex;
+	    }
+	    if ( sp->nextcpindex<pcnt ) {
+		base->xy[2*sp->nextcpindex] = rint(sp->nextcp.x);
+		base->xy[2*sp->nextcpindex+1] = rint(sp->nextcp.y);
+		if ( sp->nextcpindex>last ) last = sp->nextcpindex;
+	    }
+	    if ( sp->next==NULL )
+	break;
+	    sp = sp->next->to;
+	    if ( sp==ss->first )
+	break;
+	}
+	if ( last!=-1 )
+	    base->endpt[i++] = last;
+    }
+    base->path_cnt = i;
+return( base );
+}
+
+void MMDeltasSnapshot(struct mmdeltas *md, SplineChar **glyphs, int gcnt) {
+    /* Called once the default glyphs are complete (references resolved) */
+    int gid;
+
+    for ( gid=0; gid<md->gcnt && gid<gcnt; ++gid ) if ( glyphs[gid]!=NULL )
+	md->base[gid] = MMGlyphBaseNew(glyphs[gid],md->pcnt[gid]);
+}
+
+static int MMTupleApplies(MMSet *mm, int instance, int tuple) {
+    /* variations for [0,1] make up part of design [1,1], but not the other */
+    /* way round */
+    struct mmdeltas *md = mm->deltas;
+    real *pos = &mm->positions[instance*mm->axis_count];
+    real *tc = &md->coords[tuple*md->axis_count];
+    int j;
+
+    for ( j=0; j<md->axis_count; ++j ) {
+	if ( tc[j]!=0 && tc[j]!=pos[j] )
+return( false );
+    }
+return( true );
+}
+
+static void MMSumDeltas(MMSet *mm, int instance, int gid, int *dx, int *dy) {
+    struct mmdeltas *md = mm->deltas;
+    int pcnt = md->pcnt[gid]+4;
+    int t, k;
+    int16_t *d;
+
+    memset(dx,0,pcnt*sizeof(int));
+    memset(dy,0,pcnt*sizeof(int));
+    for ( t=0; t<md->tuple_count; ++t ) {
+	if ( (d = md->deltas[t][gid])==NULL || !MMTupleApplies(mm,instance,t) )
+    continue;
+	for ( k=0; k<pcnt; ++k ) {
+	    dx[k] += d[k];
+	    dy[k] += d[pcnt+k];
+	}
+    }
+}
+
+static int MMGlyphPending(MMSet *mm, int instance, int gid) {
+    struct mmdeltas *md = mm->deltas;
+
+return( md!=NULL && gid<md->gcnt && md->base[gid]!=NULL &&
+	gid<mm->instances[instance]->glyphcnt &&
+	mm->instances[instance]->glyphs[gid]==NULL &&
+	gid<mm->normal->glyphcnt && mm->normal->glyphs[gid]!=NULL );
+}
+
+SplineChar *MMInstanceGlyph(MMSet *mm, int instance, int gid) {
+    /* Returns the glyph in an instance font, making it if we haven't yet */
+    SplineFont *sf = mm->instances[instance];
+    struct mmglyphbase *base;
+    SplineChar *sc;
+    RefChar *r, *last;
+    BasePoint *pts;
+    int *dx, *dy;
+    int pcnt, k;
+
+    if ( gid<0 || gid>=sf->glyphcnt )
+return( NULL );
+    if ( !MMGlyphPending(mm,instance,gid) )
+return( sf->glyphs[gid] );
+
+    base = mm->deltas->base[gid];
+    pcnt = mm->deltas->pcnt[gid];
+    sc = SplineCharCopy(mm->normal->glyphs[gid],NULL,NULL);
+    free(sc->ttf_instrs); sc->ttf_instrs = NULL;
+    sc->ttf_instrs_len = 0;
+    PSTFree(sc->possub); sc->possub = NULL;
+    SplinePointListsFree(sc->layers[ly_fore].splines);
+    sc->layers[ly_fore].splines = NULL;
+    RefCharsFree(sc->layers[ly_fore].refs);
+    sc->layers[ly_fore].refs = NULL;
+    sc->orig_pos = gid;
+    sc->parent = sf;
+    sc->layers[ly_fore].order2 = sc->layers[ly_back].order2 = true;
+    sc->changed = false;
+    sc->ticked = false;
+    /* In place before we look at references, in case they loop back */
+    sf->glyphs[gid] = sc;
+
+    dx = malloc(2*(pcnt+4)*sizeof(int));
+    dy = dx+pcnt+4;
+    MMSumDeltas(mm,instance,gid,dx,dy);
+    /* Moving the left side-bearing (or top) phantom point shifts */
+    /*  everything over */
+    if ( base->refs==NULL ) {
+	pts = malloc((pcnt+1)*sizeof(BasePoint));
+	for ( k=0; k<pcnt; ++k ) {
+	    pts[k].x = base->xy[2*k] + dx[k] - dx[pcnt];
+	    pts[k].y = base->xy[2*k+1] + dy[k] - dy[pcnt+2];
+	}
+	sc->layers[ly_fore].splines = ttfbuildcontours(base->path_cnt,base->endpt,
+		base->flags,pts,true);
+	SCCategorizePoints(sc);
+	free(pts);
+    } else {
+	last = NULL;
+	for ( k=0; k<base->refcnt; ++k ) {
+	    SplineChar *rsc = MMInstanceGlyph(mm,instance,base->refs[k].gid);
+	    if ( rsc==NULL )
+	continue;
+	    r = RefCharCreate();
+	    memcpy(r->transform,base->refs[k].transform,sizeof(r->transform));
+	    if ( k<pcnt ) {
+		r->transform[4] += dx[k] - dx[pcnt];
+		r->transform[5] += dy[k] - dy[pcnt+2];
+	    }
+	    r->use_my_metrics = base->refs[k].use_my_metrics;
+	    r->round_translation_to_grid = base->refs[k].round_translation_to_grid;
+	    r->point_match = base->refs[k].point_match;
+	    r->match_pt_base = base->refs[k].match_pt_base;
+	    r->match_pt_ref = base->refs[k].match_pt_ref;
+	    r->orig_pos = rsc->orig_pos;
+	    r->sc = rsc;
+	    r->adobe_enc = getAdobeEnc(rsc->name);
+	    if ( last==NULL )
+		sc->layers[ly_fore].refs = r;
+	    else
+		last->next = r;
+	    last = r;
+	    SCReinstanciateRefChar(sc,r,ly_fore);
+	    SCMakeDependent(sc,rsc);
+	}
+    }
+    sc->width = base->width + dx[pcnt+1];
+    sc->vwidth = base->vwidth + dy[pcnt+3];
+    free(dx);
+return( sc );
+}
+
+void MMInstanceDeltas(MMSet *mm, int instance, int gid, int16_t *dx, int16_t *dy) {
+    /* The difference between the instance glyph and the default, as */
+    /*  SCFindDeltas would measure it were the instance glyph made */
+    int pcnt = mm->deltas->pcnt[gid];
+    int *sx = malloc(2*(pcnt+4)*sizeof(int)), *sy = sx+pcnt+4;
+    int k;
+
+    MMSumDeltas(mm,instance,gid,sx,sy);
+    for ( k=0; k<pcnt; ++k ) {
+	dx[k] = sx[k] - sx[pcnt];
+	dy[k] = sy[k] - sy[pcnt+2];
+    }
+    dx[pcnt] = dy[pcnt] = 0;
+    dx[pcnt+1] = sx[pcnt+1]; dy[pcnt+1] = 0;
+    dx[pcnt+2] = dy[pcnt+2] = 0;
+    dx[pcnt+3] = 0; dy[pcnt+3] = sy[pcnt+3];
+    free(sx);
+}
+
+static int SCMatchesBase(SplineChar *sc, struct mmglyphbase *base, int pcnt) {
+    SplineSet *ss;
+    SplinePoint *sp;
+    RefChar *r;
+    int k, last;
+
+    if ( sc->width!=base->width || sc->vwidth!=base->vwidth )
+return( false );
+    if ( base->refs!=NULL ) {
+	if ( sc->layers[ly_fore].splines!=NULL || base->refcnt!=pcnt )
+return( false );
+	for ( k=0, r=sc->layers[ly_fore].refs; r!=NULL; ++k, r=r->next ) {
+	    if ( k>=base->refcnt || r->sc->orig_pos!=base->refs[k].gid ||
+		    memcmp(r->transform,base->refs[k].transform,sizeof(r->transform))!=0 )
+return( false );
+	}
+return( k==base->refcnt );
+    }
+    if ( sc->layers[ly_fore].refs!=NULL )
+return( false );
+    for ( k=0, ss=sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
+	last = -1;
+	for ( sp=ss->first; ; ) {
+	    if ( sp->ttfindex!=0xffff ) {
+		if ( sp->ttfindex>=pcnt || !base->flags[sp->ttfindex] ||
+			sp->me.x!=base->xy[2*sp->ttfindex] ||
+			sp->me.y!=base->xy[2*sp->ttfindex+1] )
+return( false );
+		if ( sp->ttfindex>last ) last = sp->ttfindex;
+	    }
+	    if ( sp->nextcpindex!=0xffff ) {
+		if ( sp->nextcpindex>=pcnt || base->flags[sp->nextcpindex] ||
+			sp->nextcp.x!=base->xy[2*sp->nextcpindex] ||
+			sp->nextcp.y!=base->xy[2*sp->nextcpindex+1] )
+return( false );
+		if ( sp->nextcpindex>last ) last = sp->nextcpindex;
+	    }
+	    if ( sp->next==NULL )
+	break;
+	    sp = sp->next->to;
+	    if ( sp==ss->first )
+	break;
+	}
+	if ( last==-1 )
+    continue;
+	if ( k>=base->path_cnt || base->endpt[k]!=last )
+return( false );
+	++k;
+    }
+return( k==base->path_cnt && (k==0 ? pcnt==0 : base->endpt[k-1]==pcnt-1) );
+}
+
+int MMGlyphStillDeltas(MMSet *mm, int gid) {
+    /* True if no instance of this glyph has been made and the default glyph */
+    /*  is as it was read, so the deltas we were given still describe the */
+    /*  instances. Otherwise makes sure every instance glyph exists */
+    struct mmdeltas *md = mm->deltas;
+    int i, pending = 0;
+
+    if ( md==NULL || gid>=md->gcnt )
+return( false );
+    for ( i=0; i<mm->instance_count; ++i )
+	if ( MMGlyphPending(mm,i,gid) )
+	    ++pending;
+    if ( pending==0 )
+return( false );
+    if ( pending==mm->instance_count &&
+	    SCMatchesBase(mm->normal->glyphs[gid],md->base[gid],md->pcnt[gid]) )
+return( true );
+    for ( i=0; i<mm->instance_count; ++i )
+	MMInstanceGlyph(mm,i,gid);
+return( false );
+}
+
+void SFMaterializeMM(SplineFont *sf) {
+    /* Make every glyph in an instance font */
+    MMSet *mm = sf->mm;
+    int i, gid;
+
+    if ( mm==NULL || mm->deltas==NULL )
+return;
+    for ( i=0; i<mm->instance_count; ++i ) if ( mm->instances[i]==sf ) {
+	for ( gid=0; gid<sf->glyphcnt; ++gid )
+	    MMInstanceGlyph(mm,i,gid);
+    }
+}
+
+void MMMaterialize(MMSet *mm) {
+    int i;
+
+    if ( mm==NULL || mm->deltas==NULL )
+return;
+    for ( i=0; i<mm->instance_count; ++i )
+	SFMaterializeMM(mm->instances[i]);
+    /* Nothing left that needs the deltas */
+    MMDeltasFree(mm->deltas);
+    mm->deltas = NULL;
+}
@@ -35,6 +35,47 @@
 extern "C" {
 #endif
 
+/* The masters of a font read from a 'gvar' table are kept as the deltas */
+/*  each tuple applies to the default outlines, and are only made into real */
+/*  glyphs when something asks for one */
+struct mmbaseref {
+    int gid;
+    real transform[6];
+    unsigned int use_my_metrics: 1;
+    unsigned int round_translation_to_grid: 1;
+    unsigned int point_match: 1;
+    uint16_t match_pt_base, match_pt_ref;
+};
+
+struct mmglyphbase {		/* The default glyph as it was read, in glyf terms */
+    int path_cnt;
+    uint16_t *endpt;
+    char *flags;
+    int16_t *xy;		/* a coordinate pair for each numbered point */
+    int refcnt;
+    struct mmbaseref *refs;
+    int16_t width, vwidth;
+};
+
+struct mmdeltas {
+    int gcnt;
+    int tuple_count, axis_count;
+    real *coords;		/* [tuple][axis] peak of each tuple */
+    int *pcnt;			/* [gid] numbered points (or references), no phantoms */
+    struct mmglyphbase **base;	/* [gid], NULL if there is no such glyph */
+    int16_t ***deltas;		/* [tuple][gid] pcnt+4 x deltas then as many y */
+				/*  NULL if the glyph isn't moved by the tuple */
+};
+
+extern struct mmdeltas *MMDeltasNew(int gcnt, int tuple_count, int axis_count);
+extern void MMDeltasSnapshot(struct mmdeltas *md, SplineChar **glyphs, int gcnt);
+extern void MMDeltasFree(struct mmdeltas *md);
+extern SplineChar *MMInstanceGlyph(MMSet *mm, int instance, int gid);
+extern int MMGlyphStillDeltas(MMSet *mm, int gid);
+extern void MMInstanceDeltas(MMSet *mm, int instance, int gid, int16_t *dx, int16_t *dy);
+extern void SFMaterializeMM(SplineFont *sf);
+extern void MMMaterialize(MMSet *mm);
+
 extern void MMWeightsUnMap(real weights[MmMax], real axiscoords[4],
 	int axis_count);
 extern bigreal MMAxisUnmap(MMSet *mm,int axis,bigreal ncv);
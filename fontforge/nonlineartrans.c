@@ -31,6 +31,7 @@
 
 #include "cvundoes.h"
 #include "fontforgevw.h"
+#include "parallel.h"
 #include "splinefit.h"
 #include "splineutil.h"
 #include "splineutil2.h"
@@ -239,7 +240,7 @@ return( ret );
 return( gete0(c));
       case op_sub: case op_not:
 	ret = calloc(1,sizeof(struct expr));
-	ret->op = op;
+	ret->op = op==op_sub ? op_negate : op;
 	ret->op1 = gete0(c);
 return( ret );
       default:
@@ -478,12 +479,12 @@ return( evaluate_expr(c,e->op1) > evaluate_expr(c,e->op2) );
 	val1 = evaluate_expr(c,e->op1);
 	if ( val1==0 )
 return( 0 );
-return( evaluate_expr(c,e->op1)!=0 );
+return( evaluate_expr(c,e->op2)!=0 );
       case op_or:
 	val1 = evaluate_expr(c,e->op1);
 	if ( val1!=0 )
 return( 1 );
-return( evaluate_expr(c,e->op1)!=0 );
+return( evaluate_expr(c,e->op2)!=0 );
       case op_if:
 	val1 = evaluate_expr(c,e->op1);
 	if ( val1!=0 )
@@ -497,8 +498,7 @@ return( 0 );
     }
 }
 
-static real NL_expr(struct expr_context *c, struct expr *e) {
-    real val = evaluate_expr(c,e);
+static real NL_clamp(real val) {
     if ( isnan(val))
 return( 0 );
     if ( val>=32768 )
@@ -509,64 +509,393 @@ return( -32768 );
 return( val );
 }
 
-static void NLTransPoint(SplinePoint *sp, struct expr_context *c) {
-    BasePoint old, off, delta;
-    int fixup = true;
+static real NL_expr(struct expr_context *c, struct expr *e) {
+return( NL_clamp(evaluate_expr(c,e)) );
+}
 
-    old = sp->me;
+/* Walking the expression tree for every coordinate of every glyph spends */
+/*  most of its time in the walk. Instead flatten the tree once into a list */
+/*  of instructions over a register file where each register holds a batch */
+/*  of values, and run each instruction over the whole batch. Registers 0 */
+/*  and 1 hold x and y, then come the constants (including any subtrees */
+/*  which don't depend on x or y, folded at compile time), then temporaries */
+/*  allocated by depth. */
+/* Both arms of a conditional are computed, so errors (log of a negative */
+/*  number, division by zero) can't be reported from the batch: lanes */
+/*  which might have hit one are flagged, and evaluate_expr recomputes them */
+/*  one at a time, producing exactly the same values and messages as */
+/*  before (an error in an arm that wasn't taken flags the lane needlessly */
+/*  but costs nothing else). */
+#define NLT_BATCH	64
+#define NLT_X		0
+#define NLT_Y		1
+#define NLT_TEMP(t)	(-1-(t))	/* Until we know how many constants */
+
+struct nlt_compiler {
+    struct nlt_program *prog;
+    int imax, cmax;
+    int tcnt;
+};
+
+static int nlt_usesxy(struct expr *e) {
+    if ( e==NULL )
+return( false );
+    if ( e->op==op_x || e->op==op_y )
+return( true );
+return( nlt_usesxy(e->op1) || nlt_usesxy(e->op2) || nlt_usesxy(e->op3) );
+}
+
+static int nlt_fallible(struct expr *e) {
+    if ( e==NULL )
+return( false );
+    if ( e->op==op_log || e->op==op_sqrt || e->op==op_div || e->op==op_mod )
+return( true );
+return( nlt_fallible(e->op1) || nlt_fallible(e->op2) || nlt_fallible(e->op3) );
+}
+
+static int nlt_const(struct nlt_compiler *cc, real val) {
+    struct nlt_program *prog = cc->prog;
+
+    if ( prog->ccnt>=cc->cmax ) {
+	cc->cmax = 2*cc->cmax+8;
+	prog->consts = realloc(prog->consts,cc->cmax*sizeof(real));
+    }
+    prog->consts[prog->ccnt] = val;
+return( 2+prog->ccnt++ );
+}
+
+static void nlt_insn(struct nlt_compiler *cc, int op, int temp,
+	int src1, int src2, int src3) {
+    struct nlt_program *prog = cc->prog;
+    struct nlt_insn *in;
+
+    if ( prog->icnt>=cc->imax ) {
+	cc->imax = 2*cc->imax+8;
+	prog->insns = realloc(prog->insns,cc->imax*sizeof(struct nlt_insn));
+    }
+    in = &prog->insns[prog->icnt++];
+    in->op = op;
+    in->dst = NLT_TEMP(temp);
+    in->src1 = src1; in->src2 = src2; in->src3 = src3;
+    if ( temp>=cc->tcnt )
+	cc->tcnt = temp+1;
+}
+
+/* Returns the register which will hold the value of e, using temporaries */
+/*  numbered temp and up for the intermediate results */
+static int nlt_emit(struct nlt_compiler *cc, struct expr *e, int temp) {
+    struct expr_context dummy;
+    int src1, src2, src3, next;
+
+    if ( e->op==op_x )
+return( NLT_X );
+    else if ( e->op==op_y )
+return( NLT_Y );
+    else if ( e->op==op_value )
+return( nlt_const(cc,e->value) );
+    else if ( !nlt_usesxy(e) && !nlt_fallible(e) ) {
+	memset(&dummy,0,sizeof(dummy));
+return( nlt_const(cc,evaluate_expr(&dummy,e)) );
+    }
+
+    next = temp;
+    src1 = nlt_emit(cc,e->op1,next);
+    if ( src1==NLT_TEMP(next) ) ++next;
+    src2 = src3 = src1;
+    if ( e->op2!=NULL ) {
+	src2 = nlt_emit(cc,e->op2,next);
+	if ( src2==NLT_TEMP(next) ) ++next;
+    }
+    if ( e->op3!=NULL )
+	src3 = nlt_emit(cc,e->op3,next);
+    nlt_insn(cc,e->op,temp,src1,src2,src3);
+return( NLT_TEMP(temp) );
+}
+
+struct nlt_program *nlt_compile(struct expr *e) {
+    struct nlt_compiler cc;
+    struct nlt_program *prog;
+    int i;
+
+    if ( e==NULL )
+return( NULL );
+    memset(&cc,0,sizeof(cc));
+    cc.prog = prog = calloc(1,sizeof(struct nlt_program));
+    prog->result = nlt_emit(&cc,e,0);
+    prog->fallible = nlt_fallible(e);
+    prog->rcnt = 2+prog->ccnt+cc.tcnt;
+
+#define NLT_FIXREG(r) ((r)<0 ? 2+prog->ccnt-1-(r) : (r))
+    prog->result = NLT_FIXREG(prog->result);
+    for ( i=0; i<prog->icnt; ++i ) {
+	prog->insns[i].dst = NLT_FIXREG(prog->insns[i].dst);
+	prog->insns[i].src1 = NLT_FIXREG(prog->insns[i].src1);
+	prog->insns[i].src2 = NLT_FIXREG(prog->insns[i].src2);
+	prog->insns[i].src3 = NLT_FIXREG(prog->insns[i].src3);
+    }
+#undef NLT_FIXREG
+return( prog );
+}
+
+void nlt_programfree(struct nlt_program *prog) {
+    if ( prog==NULL )
+return;
+    free(prog->insns);
+    free(prog->consts);
+    free(prog);
+}
+
+/* Sets up the register file for prog, with x and y read from xs and ys */
+/*  (free the result when done) */
+static real **nlt_regs(struct nlt_program *prog, real *xs, real *ys) {
+    real *store, **regs;
+    int i, k;
+
+    regs = malloc(prog->rcnt*sizeof(real *) +
+	    (prog->rcnt-2)*NLT_BATCH*sizeof(real));
+    store = (real *) (regs + prog->rcnt);
+    regs[NLT_X] = xs;
+    regs[NLT_Y] = ys;
+    for ( i=2; i<prog->rcnt; ++i )
+	regs[i] = store + (i-2)*NLT_BATCH;
+    for ( i=0; i<prog->ccnt; ++i )
+	for ( k=0; k<NLT_BATCH; ++k )
+	    regs[2+i][k] = prog->consts[i];
+return( regs );
+}
+
+static void nlt_run(struct nlt_program *prog, real **regs, int n,
+	uint8_t *err) {
+    struct nlt_insn *in;
+    real *d, *a, *b, *c;
+    int i, k;
+
+    for ( i=0; i<prog->icnt; ++i ) {
+	in = &prog->insns[i];
+	d = regs[in->dst];
+	a = regs[in->src1]; b = regs[in->src2]; c = regs[in->src3];
+	switch ( in->op ) {
+	  case op_negate:
+	    for ( k=0; k<n; ++k ) d[k] = -a[k];
+	  break;
+	  case op_not:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]==0;
+	  break;
+	  case op_log:
+	    for ( k=0; k<n; ++k ) { real v = a[k]; err[k] |= v<=0; d[k] = log(v); }
+	  break;
+	  case op_sqrt:
+	    for ( k=0; k<n; ++k ) { real v = a[k]; err[k] |= v<0; d[k] = sqrt(v); }
+	  break;
+	  case op_exp:
+	    for ( k=0; k<n; ++k ) d[k] = exp(a[k]);
+	  break;
+	  case op_sin:
+	    for ( k=0; k<n; ++k ) d[k] = sin(a[k]);
+	  break;
+	  case op_cos:
+	    for ( k=0; k<n; ++k ) d[k] = cos(a[k]);
+	  break;
+	  case op_tan:
+	    for ( k=0; k<n; ++k ) d[k] = tan(a[k]);
+	  break;
+	  case op_abs:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]<0 ? -a[k] : a[k];
+	  break;
+	  case op_rint:
+	    for ( k=0; k<n; ++k ) d[k] = rint(a[k]);
+	  break;
+	  case op_floor:
+	    for ( k=0; k<n; ++k ) d[k] = floor(a[k]);
+	  break;
+	  case op_ceil:
+	    for ( k=0; k<n; ++k ) d[k] = ceil(a[k]);
+	  break;
+	  case op_pow:
+	    for ( k=0; k<n; ++k ) d[k] = pow(a[k],b[k]);
+	  break;
+	  case op_atan2:
+	    for ( k=0; k<n; ++k ) d[k] = atan2(a[k],b[k]);
+	  break;
+	  case op_times:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]*b[k];
+	  break;
+	  case op_div:
+	    for ( k=0; k<n; ++k ) { real v = b[k]; err[k] |= v==0; d[k] = a[k]/v; }
+	  break;
+	  case op_mod:
+	    for ( k=0; k<n; ++k ) { real v = b[k]; err[k] |= v==0; d[k] = fmod(a[k],v); }
+	  break;
+	  case op_add:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]+b[k];
+	  break;
+	  case op_sub:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]-b[k];
+	  break;
+	  case op_eq:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]==b[k];
+	  break;
+	  case op_ne:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]!=b[k];
+	  break;
+	  case op_le:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]<=b[k];
+	  break;
+	  case op_lt:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]<b[k];
+	  break;
+	  case op_ge:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]>=b[k];
+	  break;
+	  case op_gt:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]>b[k];
+	  break;
+	  case op_and:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]!=0 && b[k]!=0;
+	  break;
+	  case op_or:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]!=0 || b[k]!=0;
+	  break;
+	  case op_if:
+	    for ( k=0; k<n; ++k ) d[k] = a[k]!=0 ? b[k] : c[k];
+	  break;
+	  default:
+	    /* evaluate_expr will complain about it */
+	    for ( k=0; k<n; ++k ) err[k] = true;
+	  break;
+	}
+    }
+}
+
+/* Transforms each of the cnt points in pts, in order */
+static void NLTransPoints(struct expr_context *c, BasePoint *pts, int cnt) {
+    real xs[NLT_BATCH], ys[NLT_BATCH], **xregs, **yregs, *xres, *yres;
+    uint8_t xerr[NLT_BATCH], yerr[NLT_BATCH];
+    int i, k, n;
 
     if ( c->pov_func!=NULL ) {
-	(c->pov_func)(&sp->me,c->pov);
-	if (( sp->next!=NULL && sp->next->order2 ) || (sp->prev!=NULL && sp->prev->order2 )) {
-	    (c->pov_func)(&sp->prevcp,c->pov);
-	    (c->pov_func)(&sp->nextcp,c->pov);
-	    fixup = false;
-	} else {
-	    off.x = old.x+1; off.y = old.y+1;
-	    (c->pov_func)(&off,c->pov);
-	    delta.x = off.x - sp->me.x;
-	    delta.y = off.y - sp->me.y;
+	for ( i=0; i<cnt; ++i )
+	    (c->pov_func)(&pts[i],c->pov);
+return;
+    } else if ( c->x_prog==NULL || c->y_prog==NULL ) {
+	for ( i=0; i<cnt; ++i ) {
+	    c->x = pts[i].x; c->y = pts[i].y;
+	    pts[i].x = NL_expr(c,c->x_expr);
+	    pts[i].y = NL_expr(c,c->y_expr);
 	}
-    } else {
-	c->x = sp->me.x; c->y = sp->me.y;
-	sp->me.x = NL_expr(c,c->x_expr);
-	sp->me.y = NL_expr(c,c->y_expr);
-	if (( sp->next!=NULL && sp->next->order2 ) || (sp->prev!=NULL && sp->prev->order2 )) {
-	    c->x = sp->prevcp.x; c->y = sp->prevcp.y;
-	    sp->prevcp.x = NL_expr(c,c->x_expr);
-	    sp->prevcp.y = NL_expr(c,c->y_expr);
-	    c->x = sp->nextcp.x; c->y = sp->nextcp.y;
-	    sp->nextcp.x = NL_expr(c,c->x_expr);
-	    sp->nextcp.y = NL_expr(c,c->y_expr);
-	    fixup = false;
-	} else {
-	    /* The slope is important, the control points are a way of expressing */
-	    /*  the slope. With a linear transform, transforming the cp would */
-	    /*  give us the correct transformation of the slope. Not so here */
-	    /*  Instead we want to figure out the transform around sp->me, and */
-	    /*  apply that to the slope. Pretend it is linear */
-	    ++c->x; ++c->y;
-	    delta.x = NL_expr(c,c->x_expr) - sp->me.x;
-	    delta.y = NL_expr(c,c->y_expr) - sp->me.y;
+return;
+    }
+
+    xregs = nlt_regs(c->x_prog,xs,ys);
+    yregs = nlt_regs(c->y_prog,xs,ys);
+    xres = xregs[c->x_prog->result];
+    yres = yregs[c->y_prog->result];
+    memset(xerr,0,sizeof(xerr));
+    memset(yerr,0,sizeof(yerr));
+    for ( i=0; i<cnt; i+=NLT_BATCH ) {
+	n = cnt-i<NLT_BATCH ? cnt-i : NLT_BATCH;
+	for ( k=0; k<n; ++k ) {
+	    xs[k] = pts[i+k].x;
+	    ys[k] = pts[i+k].y;
 	}
+	nlt_run(c->x_prog,xregs,n,xerr);
+	nlt_run(c->y_prog,yregs,n,yerr);
+	for ( k=0; k<n; ++k ) {
+	    if ( xerr[k] || yerr[k] ) {
+		c->x = xs[k]; c->y = ys[k];
+		pts[i+k].x = xerr[k] ? NL_expr(c,c->x_expr) : NL_clamp(xres[k]);
+		pts[i+k].y = yerr[k] ? NL_expr(c,c->y_expr) : NL_clamp(yres[k]);
+		xerr[k] = yerr[k] = false;
+	    } else {
+		pts[i+k].x = NL_clamp(xres[k]);
+		pts[i+k].y = NL_clamp(yres[k]);
+	    }
+	}
+    }
+    free(xregs);
+    free(yregs);
+}
+
+struct nlt_coords {
+    BasePoint *pts;
+    int cnt, max;
+};
+
+static BasePoint *NLTCoordsAdd(struct nlt_coords *co, int cnt) {
+    if ( co->cnt+cnt>co->max ) {
+	co->max = 2*co->max+cnt+64;
+	co->pts = realloc(co->pts,co->max*sizeof(BasePoint));
     }
-    if ( fixup ) {
-	/* A one unit change in x is transformed into delta.x */
-	sp->prevcp.x = (sp->prevcp.x-old.x)*delta.x + sp->me.x;
-	sp->prevcp.y = (sp->prevcp.y-old.y)*delta.y + sp->me.y;
-	sp->nextcp.x = (sp->nextcp.x-old.x)*delta.x + sp->me.x;
-	sp->nextcp.y = (sp->nextcp.y-old.y)*delta.y + sp->me.y;
+    co->cnt += cnt;
+return( co->pts+co->cnt-cnt );
+}
+
+static int NLTPointIsQuad(SplinePoint *sp) {
+return( (sp->next!=NULL && sp->next->order2) || (sp->prev!=NULL && sp->prev->order2) );
+}
+
+/* Quadratic control points are transformed along with the point. Cubic */
+/*  ones get the transform's local scaling instead, found by transforming */
+/*  a point one unit off in each direction */
+static void NLTGatherPoint(struct nlt_coords *co, SplinePoint *sp, int quad) {
+    BasePoint *in = NLTCoordsAdd(co,quad ? 3 : 2);
+
+    in[0] = sp->me;
+    if ( quad ) {
+	in[1] = sp->prevcp;
+	in[2] = sp->nextcp;
+    } else {
+	in[1].x = sp->me.x+1;
+	in[1].y = sp->me.y+1;
+    }
+}
+
+static BasePoint *NLTApplyPoint(SplinePoint *sp, int quad, BasePoint *out) {
+    BasePoint old, delta;
+
+    old = sp->me;
+    sp->me = out[0];
+    if ( quad ) {
+	sp->prevcp = out[1];
+	sp->nextcp = out[2];
+return( out+3 );
+    }
+    /* The slope is important, the control points are a way of expressing */
+    /*  the slope. With a linear transform, transforming the cp would */
+    /*  give us the correct transformation of the slope. Not so here */
+    /*  Instead we want to figure out the transform around sp->me, and */
+    /*  apply that to the slope. Pretend it is linear */
+    /* A one unit change in x is transformed into delta.x */
+    delta.x = out[1].x - sp->me.x;
+    delta.y = out[1].y - sp->me.y;
+    sp->prevcp.x = (sp->prevcp.x-old.x)*delta.x + sp->me.x;
+    sp->prevcp.y = (sp->prevcp.y-old.y)*delta.y + sp->me.y;
+    sp->nextcp.x = (sp->nextcp.x-old.x)*delta.x + sp->me.x;
+    sp->nextcp.y = (sp->nextcp.y-old.y)*delta.y + sp->me.y;
+return( out+2 );
+}
+
+static void NLTGatherMids(struct nlt_coords *co, Spline *s) {
+    BasePoint *in = NLTCoordsAdd(co,20);
+    Spline1D *xsp = &s->splines[0], *ysp = &s->splines[1];
+    bigreal t;
+    int i;
+
+    for ( i=0; i<20; ++i ) {
+	t = (i+1)/21.0;
+	in[i].x = ((xsp->a*t+xsp->b)*t+xsp->c)*t + xsp->d;
+	in[i].y = ((ysp->a*t+ysp->b)*t+ysp->c)*t + ysp->d;
     }
 }
 
 static void SplineSetNLTrans(SplineSet *ss, struct expr_context *c,
 	int everything) {
     SplinePoint *first, *last, *next;
-    SplinePoint *sp;
+    SplinePoint *sp, *prev;
     FitPoint mids[20];
-    bigreal t;
+    struct nlt_coords co;
+    BasePoint *out;
     int i;
-    Spline1D *xsp, *ysp;
     /* When doing a linear transform, all we need to do is transform the */
     /*  end and control points and figure the new spline and it works. A */
     /*  non-linear transform is harder, we must transform each point along */
@@ -575,12 +904,34 @@ static void SplineSetNLTrans(SplineSet *ss, struct expr_context *c,
     /*  curves, curves may become higher order curves (which we still approx */
     /*  imate with cubics) */
 
+    /* First collect every coordinate we will need, in the order we will */
+    /*  need them, and transform them all in one go */
+    memset(&co,0,sizeof(co));
+    if ( everything || ss->first->selected )
+	NLTGatherPoint(&co,ss->first,false);
+    if ( ss->first->next!=NULL ) {
+	for ( prev=ss->first, sp=ss->first->next->to; sp!=NULL; ) {
+	    if ( everything || sp->selected )
+		NLTGatherPoint(&co,sp,NLTPointIsQuad(sp));
+	    if ( everything || (sp->selected && prev->selected) )
+		NLTGatherMids(&co,sp->prev);
+	    if ( sp==ss->first )
+	break;
+	    if ( sp->next==NULL )
+	break;
+	    prev = sp;
+	    sp = sp->next->to;
+	}
+    }
+    NLTransPoints(c,co.pts,co.cnt);
+    out = co.pts;
+
     first = last = chunkalloc(sizeof(SplinePoint));
     *first = *ss->first;
     first->hintmask = NULL;
     first->next = first->prev = NULL;
     if ( everything || first->selected )
-	NLTransPoint(first,c);
+	out = NLTApplyPoint(first,false,out);
 
     if ( ss->first->next!=NULL ) {
 	for ( sp=ss->first->next->to; sp!=NULL; ) {
@@ -588,26 +939,14 @@ static void SplineSetNLTrans(SplineSet *ss, struct expr_context *c,
 	    *next = *sp;
 	    next->hintmask = NULL;
 	    if ( everything || next->selected )
-		NLTransPoint(next,c);
+		out = NLTApplyPoint(next,NLTPointIsQuad(sp),out);
 	    next->next = next->prev = NULL;
 	    if ( everything || (next->selected && last->selected) ) {
-		xsp = &sp->prev->splines[0]; ysp = &sp->prev->splines[1];
 		for ( i=0; i<20; ++i ) {
-		    t = (i+1)/21.0;
-		    c->x = ((xsp->a*t+xsp->b)*t+xsp->c)*t + xsp->d;
-		    c->y = ((ysp->a*t+ysp->b)*t+ysp->c)*t + ysp->d;
-		    mids[i].t = t;
-		    if ( c->pov_func==NULL ) {
-			mids[i].p.x = NL_expr(c,c->x_expr);
-			mids[i].p.y = NL_expr(c,c->y_expr);
-		    } else {
-			BasePoint temp;
-			temp.x = c->x;
-			temp.y = c->y;
-			(c->pov_func)(&temp,c->pov);
-			mids[i].p.x = temp.x; mids[i].p.y = temp.y;
-		    }
+		    mids[i].t = (i+1)/21.0;
+		    mids[i].p = out[i];
 		}
+		out += 20;
 		if ( sp->prev->order2 )	/* Can't be order2 */
 		    ApproximateSplineFromPoints(last,next,mids,20,false);
 		else
@@ -642,6 +981,7 @@ static void SplineSetNLTrans(SplineSet *ss, struct expr_context *c,
 	break;
 	}
     }
+    free(co.pts);
     SplineSetBeziersClear(ss);
     SplineSetSpirosClear(ss);
     ss->first = first;
@@ -661,24 +1001,49 @@ static void SCNLTransAnchors(SplineChar *sc, struct expr_context *c, int everyth
     }
 }
 
-static void _SCNLTrans(SplineChar *sc, struct expr_context *c, int layer) {
-    SplineSet *ss;
-    RefChar *ref;
-    int i, last, first;
+/* Compiles the expressions in c unless that has already been done, returns */
+/*  whether the caller should free them again with NLTRelease */
+static int NLTCompile(struct expr_context *c) {
+    if ( c->pov_func!=NULL || c->x_prog!=NULL || c->y_prog!=NULL )
+return( false );
+    c->x_prog = nlt_compile(c->x_expr);
+    c->y_prog = nlt_compile(c->y_expr);
+return( true );
+}
+
+static void NLTRelease(struct expr_context *c, int compiled) {
+    if ( !compiled )
+return;
+    nlt_programfree(c->x_prog);
+    nlt_programfree(c->y_prog);
+    c->x_prog = c->y_prog = NULL;
+}
 
+/* Returns false if there is nothing in sc to transform */
+static int SCNLTransPreserve(SplineChar *sc, int layer) {
     if ( sc->layer_cnt==ly_fore+1 &&
 	    sc->layers[ly_fore].splines==NULL && sc->layers[ly_fore].refs==NULL )
-return;
+return( false );
+
+    if ( sc->parent->multilayer )
+	SCPreserveState(sc,false);
+    else
+	SCPreserveLayer(sc,layer,false);
+return( true );
+}
+
+/* Doesn't touch anything outside of sc, so may run on several glyphs at once */
+static void SCNLTransLayers(SplineChar *sc, struct expr_context *c, int layer) {
+    SplineSet *ss;
+    RefChar *ref;
+    int i, last, first;
 
     c->sc = sc;
     if ( sc->parent->multilayer ) {
 	first = ly_fore;
 	last = sc->layer_cnt-1;
-	SCPreserveState(sc,false);
-    } else {
+    } else
 	first = last = layer;
-	SCPreserveLayer(sc,layer,false);
-    }
     for ( i=first; i<=last; ++i ) {
 	for ( ss=sc->layers[i].splines; ss!=NULL; ss=ss->next )
 	    SplineSetNLTrans(ss,c,true);
@@ -688,24 +1053,53 @@ return;
 	    ref->transform[5] = NL_expr(c,c->y_expr);
 	    /* we'll fix up the splines after all characters have been transformed*/
 	}
-    SCNLTransAnchors(sc,c,true);
     }
+    SCNLTransAnchors(sc,c,true);
+}
+
+static void _SCNLTrans(SplineChar *sc, struct expr_context *c, int layer) {
+    if ( SCNLTransPreserve(sc,layer) )
+	SCNLTransLayers(sc,c,layer);
+}
+
+struct nlt_glyphs {
+    SplineChar **glyphs;
+    struct expr_context *c;
+    int layer;
+};
+
+static void NLTransGlyphs(void *data, int start, int end) {
+    struct nlt_glyphs *ng = data;
+    struct expr_context c = *ng->c;	/* x, y & sc change as we go */
+    int i;
+
+    for ( i=start; i<end; ++i )
+	SCNLTransLayers(ng->glyphs[i],&c,ng->layer);
 }
 
 void _SFNLTrans(FontViewBase *fv, struct expr_context *c) {
     SplineChar *sc;
     RefChar *ref;
-    int i, gid;
+    int i, gid, cnt, compiled;
     int layer = fv->active_layer;
+    struct nlt_glyphs ng;
 
+    compiled = NLTCompile(c);
     SFUntickAll(fv->sf);
 
-    for ( i=0; i<fv->map->enccount; ++i )
+    ng.glyphs = malloc(fv->map->enccount*sizeof(SplineChar *));
+    ng.c = c;
+    ng.layer = layer;
+    for ( i=cnt=0; i<fv->map->enccount; ++i )
 	if ( fv->selected[i] && (gid=fv->map->map[i])!=-1 &&
 		(sc = fv->sf->glyphs[gid])!=NULL && !sc->ticked ) {
-	    _SCNLTrans(sc,c,fv->active_layer);
+	    if ( SCNLTransPreserve(sc,layer) )
+		ng.glyphs[cnt++] = sc;
 	    sc->ticked = true;
 	}
+    ParallelFor(cnt,NLTransGlyphs,&ng);
+    free(ng.glyphs);
+
     for ( i=0; i<fv->map->enccount; ++i )
 	if ( fv->selected[i] && (gid=fv->map->map[i])!=-1 &&
 		(sc=fv->sf->glyphs[gid])!=NULL &&
@@ -716,6 +1110,7 @@ void _SFNLTrans(FontViewBase *fv, struct expr_context *c) {
 		SCReinstanciateRefChar(sc,ref,layer);
 	    SCCharChangedUpdate(sc,fv->active_layer);
 	}
+    NLTRelease(c,compiled);
 }
 
 int SFNLTrans(FontViewBase *fv,char *x_expr,char *y_expr) {
@@ -738,6 +1133,7 @@ return( true );
 
 int SSNLTrans(SplineSet *ss,char *x_expr,char *y_expr) {
     struct expr_context c;
+    int compiled;
 
     memset(&c,0,sizeof(c));
     if ( (c.x_expr = nlt_parseexpr(&c,x_expr))==NULL )
@@ -747,10 +1143,12 @@ return( false );
 return( false );
     }
 
+    compiled = NLTCompile(&c);
     while ( ss!=NULL ) {
 	SplineSetNLTrans(ss,&c,false);
 	ss = ss->next;
     }
+    NLTRelease(&c,compiled);
 
     nlt_exprfree(c.x_expr);
     nlt_exprfree(c.y_expr);
@@ -759,6 +1157,7 @@ return( true );
 
 int SCNLTrans(SplineChar *sc, int layer,char *x_expr,char *y_expr) {
     struct expr_context c;
+    int compiled;
 
     memset(&c,0,sizeof(c));
     if ( (c.x_expr = nlt_parseexpr(&c,x_expr))==NULL )
@@ -768,7 +1167,9 @@ return( false );
 return( false );
     }
 
+    compiled = NLTCompile(&c);
     _SCNLTrans(sc,&c,layer);
+    NLTRelease(&c,compiled);
 
     nlt_exprfree(c.x_expr);
     nlt_exprfree(c.y_expr);
@@ -778,15 +1179,17 @@ return( true );
 void CVNLTrans(CharViewBase *cv, struct expr_context *c) {
     SplineSet *ss;
     RefChar *ref;
-    int layer = CVLayer(cv);
+    int layer = CVLayer(cv), compiled;
 
     if ( cv->layerheads[cv->drawmode]->splines==NULL && (cv->drawmode!=dm_fore || cv->sc->layers[layer].refs==NULL ))
 return;
 
     CVPreserveState(cv);
     c->sc = cv->sc;
+    compiled = NLTCompile(c);
     for ( ss=cv->layerheads[cv->drawmode]->splines; ss!=NULL; ss=ss->next )
 	SplineSetNLTrans(ss,c,false);
+    NLTRelease(c,compiled);
     for ( ref=cv->layerheads[cv->drawmode]->refs; ref!=NULL; ref=ref->next ) {
 	c->x = ref->transform[4]; c->y = ref->transform[5];
 	ref->transform[4] = NL_expr(c,c->x_expr);
@@ -859,10 +1262,34 @@ static void SCFindCenter(SplineChar *sc,BasePoint *center) {
     center->y = (db.miny+db.maxy)/2;
 }
 
+struct pov_glyphs {
+    SplineChar **glyphs;
+    struct pov_data *povs;		/* Each glyph gets its own origin */
+    int layer;
+};
+
+static void PoVGlyphs(void *data, int start, int end) {
+    struct pov_glyphs *pg = data;
+    SplineChar *sc;
+    int i, layer, first, last;
+
+    for ( i=start; i<end; ++i ) {
+	sc = pg->glyphs[i];
+	if ( sc->parent->multilayer ) {
+	    first = ly_fore;
+	    last = sc->layer_cnt-1;
+	} else
+	    first = last = pg->layer;
+	for ( layer = first; layer<=last; ++layer )
+	    SPLPoV(sc->layers[layer].splines,&pg->povs[i],false);
+    }
+}
+
 void FVPointOfView(FontViewBase *fv,struct pov_data *pov) {
-    int i, cnt=0, layer, last, first, gid;
+    int i, cnt=0, gid;
     BasePoint origin;
     SplineChar *sc;
+    struct pov_glyphs pg;
 
     for ( i=0; i<fv->map->enccount; ++i )
 	if ( (gid=fv->map->map[i])!=-1 && fv->sf->glyphs[gid]!=NULL &&
@@ -870,12 +1297,18 @@ void FVPointOfView(FontViewBase *fv,struct pov_data *pov) {
 	++cnt;
     ff_progress_start_indicator(10,_("Projecting..."),_("Projecting..."),0,cnt,1);
 
+    pg.glyphs = malloc(cnt*sizeof(SplineChar *));
+    pg.povs = malloc(cnt*sizeof(struct pov_data));
+    pg.layer = fv->active_layer;
     SFUntickAll(fv->sf);
-    for ( i=0; i<fv->map->enccount; ++i ) {
+    for ( i=cnt=0; i<fv->map->enccount; ++i ) {
 	if ( (gid = fv->map->map[i])!=-1 && fv->selected[i] &&
 		(sc = fv->sf->glyphs[gid])!=NULL && !sc->ticked ) {
 	    sc->ticked = true;
-	    SCPreserveLayer(sc,layer,false);
+	    if ( sc->parent->multilayer )
+		SCPreserveState(sc,false);
+	    else
+		SCPreserveLayer(sc,fv->active_layer,false);
 
 	    origin.x = origin.y = 0;
 	    if ( pov->xorigin==or_center || pov->yorigin==or_center )
@@ -886,16 +1319,20 @@ void FVPointOfView(FontViewBase *fv,struct pov_data *pov) {
 		pov->y = origin.y;
 
 	    MinimumDistancesFree(sc->md); sc->md = NULL;
-	    if ( sc->parent->multilayer ) {
-		first = ly_fore;
-		last = sc->layer_cnt-1;
-	    } else
-		first = last = fv->active_layer;
-	    for ( layer = first; layer<=last; ++layer )
-		SPLPoV(sc->layers[layer].splines,pov,false);
-	    SCCharChangedUpdate(sc,layer);
+	    pg.glyphs[cnt] = sc;
+	    pg.povs[cnt++] = *pov;
 	}
     }
+    ParallelFor(cnt,PoVGlyphs,&pg);
+
+    for ( i=0; i<cnt; ++i ) {
+	sc = pg.glyphs[i];
+	SCCharChangedUpdate(sc,sc->parent->multilayer ? ly_all : fv->active_layer);
+	ff_progress_next();
+    }
+    free(pg.glyphs);
+    free(pg.povs);
+    ff_progress_end_indicator();
 }
 
 struct vanishing_point {
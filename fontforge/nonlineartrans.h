@@ -66,6 +66,21 @@ struct expr {
     real value;
 };
 
+/* An expression flattened into straight-line code over a register file, */
+/*  so it can be run over a whole array of coordinates at once */
+struct nlt_insn {
+    short op;
+    short dst, src1, src2, src3;
+};
+
+struct nlt_program {
+    int icnt, ccnt, rcnt;		/* instructions, constants, registers */
+    int result;				/* register holding the final value */
+    unsigned int fallible: 1;		/* Contains log, sqrt, / or % */
+    struct nlt_insn *insns;
+    real *consts;
+};
+
 struct expr_context {
     char *start, *cur;
     unsigned int had_error: 1;
@@ -74,6 +89,7 @@ struct expr_context {
 
     real x, y;
     struct expr *x_expr, *y_expr;
+    struct nlt_program *x_prog, *y_prog;	/* Compiled from x_expr, y_expr */
     SplineChar *sc;
     void *pov;
     void (*pov_func)(BasePoint *me,void *);
@@ -82,6 +98,8 @@ struct expr_context {
 extern void _SFNLTrans(FontViewBase *fv, struct expr_context *c);
 extern struct expr *nlt_parseexpr(struct expr_context *c, char *str);
 extern void nlt_exprfree(struct expr *e);
+extern struct nlt_program *nlt_compile(struct expr *e);
+extern void nlt_programfree(struct nlt_program *prog);
 extern void CVNLTrans(CharViewBase *cv,struct expr_context *c);
 extern void SPLPoV(SplineSet *spl,struct pov_data *pov, int only_selected);
 
@@ -0,0 +1,243 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parallel.h"
+
+#include "uiinterface.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 0 means "not yet determined"
+std::atomic<int> thread_cnt{0};
+
+// Set inside worker threads, so that nested ParallelFor() calls don't
+// oversubscribe the machine.
+thread_local bool in_worker = false;
+
+int default_thread_count() {
+    const char* env = getenv("FONTFORGE_THREADS");
+    if (env != nullptr && *env != '\0') {
+        int cnt = atoi(env);
+        if (cnt > 0) {
+            return cnt;
+        }
+    }
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : (int)hw;
+}
+
+// While workers run, ui_interface points at a proxy which queues messages
+// instead of touching the (single threaded) UI. They are replayed on the
+// calling thread afterwards, ordered by the chunk which produced them, so
+// the log reads as if the loop had run serially.
+enum class MsgKind { ierror, logwarning, post_error, post_warning };
+
+struct DeferredMsg {
+    int order;
+    MsgKind kind;
+    std::string title, text;
+};
+
+std::mutex msg_mutex;
+std::vector<DeferredMsg> deferred;
+thread_local int cur_chunk = 0;
+
+std::string vformat(const char* fmt, va_list ap) {
+    va_list ap2;
+    va_copy(ap2, ap);
+    int len = vsnprintf(nullptr, 0, fmt, ap2);
+    va_end(ap2);
+    if (len <= 0) {
+        return std::string();
+    }
+    std::string text(len, '\0');
+    vsnprintf(&text[0], len + 1, fmt, ap);
+    return text;
+}
+
+void defer(MsgKind kind, const char* title, std::string text) {
+    std::lock_guard<std::mutex> lock(msg_mutex);
+    deferred.push_back({cur_chunk, kind, title ? title : "", std::move(text)});
+}
+
+void proxy_ierror(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    defer(MsgKind::ierror, nullptr, vformat(fmt, ap));
+    va_end(ap);
+}
+
+void proxy_logwarning(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    defer(MsgKind::logwarning, nullptr, vformat(fmt, ap));
+    va_end(ap);
+}
+
+void proxy_post_error(const char* title, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    defer(MsgKind::post_error, title, vformat(fmt, ap));
+    va_end(ap);
+}
+
+void proxy_post_warning(const char* title, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    defer(MsgKind::post_warning, title, vformat(fmt, ap));
+    va_end(ap);
+}
+
+void proxy_void_noop() {}
+int proxy_int_true() { return true; }
+int proxy_int_int_true(int) { return true; }
+void proxy_void_int_noop(int) {}
+void proxy_void_str_noop(const char*) {}
+
+struct ui_interface make_proxy(const struct ui_interface* orig) {
+    struct ui_interface proxy = *orig;
+    proxy.ierror = proxy_ierror;
+    proxy.logwarning = proxy_logwarning;
+    proxy.post_error = proxy_post_error;
+    proxy.post_warning = proxy_post_warning;
+    // Progress reporting belongs to the caller, which knows how much of the
+    // work has been done once the workers are joined.
+    proxy.progress_show = proxy_void_noop;
+    proxy.progress_enable_stop = proxy_void_int_noop;
+    proxy.progress_next = proxy_int_true;
+    proxy.progress_next_stage = proxy_int_true;
+    proxy.progress_increment = proxy_int_int_true;
+    proxy.progress_change_line1 = proxy_void_str_noop;
+    proxy.progress_change_line2 = proxy_void_str_noop;
+    proxy.progress_pause = proxy_void_noop;
+    proxy.progress_resume = proxy_void_noop;
+    proxy.progress_change_stages = proxy_void_int_noop;
+    proxy.progress_change_total = proxy_void_int_noop;
+    proxy.allow_events = proxy_void_noop;
+    return proxy;
+}
+
+void replay_deferred(const struct ui_interface* orig) {
+    std::stable_sort(deferred.begin(), deferred.end(),
+                     [](const DeferredMsg& a, const DeferredMsg& b) {
+                         return a.order < b.order;
+                     });
+    for (const DeferredMsg& msg : deferred) {
+        switch (msg.kind) {
+            case MsgKind::ierror:
+                orig->ierror("%s", msg.text.c_str());
+                break;
+            case MsgKind::logwarning:
+                orig->logwarning("%s", msg.text.c_str());
+                break;
+            case MsgKind::post_error:
+                orig->post_error(msg.title.c_str(), "%s", msg.text.c_str());
+                break;
+            case MsgKind::post_warning:
+                orig->post_warning(msg.title.c_str(), "%s", msg.text.c_str());
+                break;
+        }
+    }
+    deferred.clear();
+}
+
+}  // namespace
+
+extern "C" int ParallelThreadCount(void) {
+    int cnt = thread_cnt.load(std::memory_order_relaxed);
+    if (cnt == 0) {
+        cnt = default_thread_count();
+        thread_cnt.store(cnt, std::memory_order_relaxed);
+    }
+    return cnt;
+}
+
+extern "C" void ParallelSetThreadCount(int cnt) {
+    thread_cnt.store(cnt > 0 ? cnt : 0, std::memory_order_relaxed);
+}
+
+extern "C" void ParallelFor(int cnt, ParallelFunc func, void* data) {
+    if (cnt <= 0) {
+        return;
+    }
+
+    int threads = in_worker ? 1 : std::min(ParallelThreadCount(), cnt);
+    if (threads <= 1) {
+        func(data, 0, cnt);
+        return;
+    }
+
+    // Several chunks per thread keep the load balanced when the cost of
+    // individual indices varies (glyphs of very different complexity).
+    int chunk = std::max(1, cnt / (threads * 8));
+    std::atomic<int> next{0};
+
+    auto worker = [&]() {
+        in_worker = true;
+        for (;;) {
+            int start = next.fetch_add(chunk);
+            if (start >= cnt) {
+                break;
+            }
+            cur_chunk = start;
+            func(data, start, std::min(start + chunk, cnt));
+        }
+        in_worker = false;
+    };
+
+    struct ui_interface* orig_ui = ui_interface;
+    struct ui_interface proxy_ui = make_proxy(orig_ui);
+    ui_interface = &proxy_ui;
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    try {
+        for (int i = 1; i < threads; ++i) {
+            pool.emplace_back(worker);
+        }
+    } catch (const std::system_error&) {
+        // Couldn't spawn more threads, carry on with the ones we have
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    ui_interface = orig_ui;
+    replay_deferred(orig_ui);
+}
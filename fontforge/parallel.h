@@ -0,0 +1,65 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FONTFORGE_PARALLEL_H
+#define FONTFORGE_PARALLEL_H
+
+/*
+ * Minimal data-parallel helper for the core library.
+ *
+ * ParallelFor() splits the index range [0,cnt) into chunks and hands them
+ * to a pool of short-lived worker threads. The callback must only touch
+ * state owned by its own indices: most of libfontforge (undoes, Python
+ * hooks, glyph change notifications) is not thread safe, so callers
+ * compute into private per-index slots and merge serially afterwards.
+ *
+ * Errors and warnings posted through the ui_interface (IError, LogError,
+ * ff_post_error, ff_post_notice) from inside the callback are queued and
+ * reported on the calling thread once all workers are done, in index
+ * order. Progress indicator calls made by workers are ignored; the caller
+ * should update the indicator itself.
+ *
+ * The number of threads defaults to the hardware concurrency and can be
+ * overridden with the FONTFORGE_THREADS environment variable (1 disables
+ * threading). Nested calls from inside a worker run serially.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*ParallelFunc)(void *data, int start, int end);
+
+extern int ParallelThreadCount(void);
+extern void ParallelSetThreadCount(int cnt);
+extern void ParallelFor(int cnt, ParallelFunc func, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FONTFORGE_PARALLEL_H */
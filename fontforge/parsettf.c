@@ -1858,7 +1858,7 @@ static void FigureControls(SplinePoint *from, SplinePoint *to, BasePoint *cp,
     }
 }
 
-static SplineSet *ttfbuildcontours(int path_cnt,uint16_t *endpt, char *flags,
+SplineSet *ttfbuildcontours(int path_cnt,uint16_t *endpt, char *flags,
 	BasePoint *pts, int is_order2) {
     SplineSet *head=NULL, *last=NULL, *cur;
     int i, path, start, last_off;
@@ -5850,8 +5850,6 @@ return( NULL );
 static SplineFont *SFFromTuple(SplineFont *basesf,struct variations *v,int tuple,
 	MMSet *mm, struct ttfinfo *info) {
     SplineFont *sf;
-    int i;
-    RefChar *r;
 
     sf = SplineFontEmpty();
     sf->display_size = basesf->display_size;
@@ -5873,29 +5871,44 @@ static SplineFont *SFFromTuple(SplineFont *basesf,struct variations *v,int tuple
     sf->map = basesf->map;
     sf->mm = mm;
     sf->glyphmax = sf->glyphcnt = basesf->glyphcnt;
-    sf->glyphs = v->tuples[tuple].chars;
+    /* The glyphs themselves are made from mm->deltas as they are needed */
+    sf->glyphs = calloc(sf->glyphmax,sizeof(SplineChar *));
     sf->layers[ly_fore].order2 = sf->layers[ly_back].order2 = true;
-    for ( i=0; i<sf->glyphcnt; ++i ) if ( basesf->glyphs[i]!=NULL && sf->glyphs[i]!=NULL ) {
-	SplineChar *sc = sf->glyphs[i];
-	sc->orig_pos = i;
-	sc->parent = sf;
-	sc->layers[ly_fore].order2 = sc->layers[ly_back].order2 = true;
-    }
     sf->grid.order2 = true;
-    for ( i=0; i<sf->glyphcnt; ++i ) if ( sf->glyphs[i]!=NULL ) {
-	for ( r=sf->glyphs[i]->layers[ly_fore].refs; r!=NULL; r=r->next )
-	    SCReinstanciateRefChar(sf->glyphs[i],r,ly_fore);
-    }
 
     sf->ttf_tables = v->tuples[tuple].cvt;
 
-    v->tuples[tuple].chars = NULL;
     v->tuples[tuple].khead = NULL;
     v->tuples[tuple].vkhead = NULL;
     v->tuples[tuple].cvt = NULL;
 return( sf );
 }
 
+static void MMAttachKerns(MMSet *mm,int instance,int gid,KernPair **kps,int isv) {
+    /* Kern pairs which only apply to one tuple need real instance glyphs */
+    KernPair *kp, *next;
+    SplineChar *left = NULL;
+
+    if ( *kps!=NULL )
+	left = MMInstanceGlyph(mm,instance,gid);
+    for ( kp = *kps; kp!=NULL; kp = next ) {
+	next = kp->next;
+	kp->sc = left==NULL ? NULL : MMInstanceGlyph(mm,instance,kp->sc->orig_pos);
+	if ( kp->sc==NULL ) {
+	    chunkfree(kp,sizeof(KernPair));
+    continue;
+	}
+	if ( isv ) {
+	    kp->next = left->vkerns;
+	    left->vkerns = kp;
+	} else {
+	    kp->next = left->kerns;
+	    left->kerns = kp;
+	}
+    }
+    *kps = NULL;
+}
+
 static void MMFillFromVAR(SplineFont *sf, struct ttfinfo *info) {
     MMSet *mm = chunkalloc(sizeof(MMSet));
     struct variations *v = info->variations;
@@ -5948,8 +5961,17 @@ static void MMFillFromVAR(SplineFont *sf, struct ttfinfo *info) {
 	v->instances[i].coords = NULL;
 	mm->named_instances[i].names = MacNameCopy(FindMacName(info, v->instances[i].nameid));
     }
+    mm->deltas = v->deltas;
+    v->deltas = NULL;
+    MMDeltasSnapshot(mm->deltas,sf->glyphs,sf->glyphcnt);
     for ( i=0; i<mm->instance_count; ++i )
 	mm->instances[i] = SFFromTuple(sf,v,i,mm,info);
+    for ( i=0; i<mm->instance_count; ++i ) if ( v->tuples[i].kerns!=NULL ) {
+	for ( j=0; j<info->glyph_cnt; ++j ) {
+	    MMAttachKerns(mm,i,j,&v->tuples[i].kerns[j],false);
+	    MMAttachKerns(mm,i,j,&v->tuples[i].vkerns[j],true);
+	}
+    }
     VariationFree(info);
 }
 
@@ -16,6 +16,7 @@ extern char *TTFGetFontName(FILE *ttf, int32_t offset, int32_t off2);
 extern int MSLanguageFromLocale(void);
 extern int ttfFindPointInSC(SplineChar *sc, int layer, int pnum, BasePoint *pos, RefChar *bound);
 extern int ttfFixupRef(SplineChar **chars, int i);
+extern SplineSet *ttfbuildcontours(int path_cnt, uint16_t *endpt, char *flags, BasePoint *pts, int is_order2);
 extern SplineFont *CFFParse(char *filename);
 extern SplineFont *_CFFParse(FILE *temp, int len, char *fontsetname);
 extern SplineFont *SFReadTTF(char *filename, int flags, enum openflags openflags);
@@ -4850,11 +4850,13 @@ return;
 	if (info->variations) {
 	    int ctup;
 	    for (ctup = 0; ctup < info->variations->tuple_count; ctup++) {
-		SplineChar ** tscs = info->variations->tuples[ctup].chars;
-		info->variations->tuples[ctup].chars = calloc(info->glyph_cnt, sizeof(SplineChar *));
-		memcpy(info->variations->tuples[ctup].chars, tscs, oldgc * sizeof(SplineChar *));
-		free(tscs);
-		tscs = NULL;
+		struct tuples *tup = &info->variations->tuples[ctup];
+		if (tup->kerns == NULL)
+		    continue;
+		tup->kerns = realloc(tup->kerns, info->glyph_cnt * sizeof(KernPair *));
+		tup->vkerns = realloc(tup->vkerns, info->glyph_cnt * sizeof(KernPair *));
+		memset(tup->kerns + oldgc, 0, info->badgid_cnt * sizeof(KernPair *));
+		memset(tup->vkerns + oldgc, 0, info->badgid_cnt * sizeof(KernPair *));
 	    }
 	}
     }
@@ -4887,6 +4889,7 @@ void readttfkerns(FILE *ttf,struct ttfinfo *info) {
     int tupleIndex;
     int isv;
     SplineChar **chars;
+    KernPair **kerns, **vkerns;
     OTLookup *otl;
 
     fseek(ttf,info->kern_start,SEEK_SET);
@@ -4945,7 +4948,19 @@ return;
 	}
 	if ( flags_good && format==0 ) {
 	    /* format 0, horizontal kerning data (as pairs) not perpendicular */
-	    chars = tupleIndex==-1 ? info->chars : info->variations->tuples[tupleIndex].chars;
+	    chars = info->chars;
+	    kerns = vkerns = NULL;
+	    if ( tupleIndex!=-1 ) {
+		/* The instance glyphs don't exist yet. Hold on to the pairs */
+		/*  until they do */
+		struct tuples *tup = &info->variations->tuples[tupleIndex];
+		if ( tup->kerns==NULL ) {
+		    tup->kerns = calloc(info->glyph_cnt,sizeof(KernPair *));
+		    tup->vkerns = calloc(info->glyph_cnt,sizeof(KernPair *));
+		}
+		kerns = tup->kerns;
+		vkerns = tup->vkerns;
+	    }
 	    npairs = getushort(ttf);
 	    if ( version==0 && (len-14 != 6*npairs || npairs>10920 )) {
 		LogError( _("In the 'kern' table, a subtable's length does not match the number of kerning pairs.") );
@@ -4982,11 +4997,13 @@ return;
 		    FListsAppendScriptLang(otl->features,SCScriptFromUnicode(chars[left]),
 			    DEFAULT_LANG);
 		    if ( isv ) {
-			kp->next = chars[left]->vkerns;
-			chars[left]->vkerns = kp;
+			KernPair **head = vkerns!=NULL ? &vkerns[left] : &chars[left]->vkerns;
+			kp->next = *head;
+			*head = kp;
 		    } else {
-			kp->next = chars[left]->kerns;
-			chars[left]->kerns = kp;
+			KernPair **head = kerns!=NULL ? &kerns[left] : &chars[left]->kerns;
+			kp->next = *head;
+			*head = kp;
 		    }
 		}
 	    }
@@ -33,6 +33,7 @@
 #include "fvfonts.h"
 #include "gwidget.h"
 #include "mem.h"
+#include "mm.h"
 #include "parsettf.h"
 #include "splineutil.h"
 #include "ttf.h"
@@ -82,15 +83,19 @@ return;
     if ( variation->tuples!=NULL ) {
 	for ( i=0; i<variation->tuple_count; ++i ) {
 	    free(variation->tuples[i].coords);
-	    if ( variation->tuples[i].chars!=NULL )
-		for ( j=0; j<info->glyph_cnt; ++j )
-		    SplineCharFree(variation->tuples[i].chars[j]);
-	    free(variation->tuples[i].chars);
+	    if ( variation->tuples[i].kerns!=NULL )
+		for ( j=0; j<info->glyph_cnt; ++j ) {
+		    KernPairsFree(variation->tuples[i].kerns[j]);
+		    KernPairsFree(variation->tuples[i].vkerns[j]);
+		}
+	    free(variation->tuples[i].kerns);
+	    free(variation->tuples[i].vkerns);
 	    KernClassListFree(variation->tuples[i].khead);
 	    KernClassListFree(variation->tuples[i].vkhead);
 	}
 	free(variation->tuples);
     }
+    MMDeltasFree(variation->deltas);
     free(variation);
     info->variations = NULL;
 }
@@ -195,31 +200,6 @@ return;
     }
 }
 
-static SplineChar **InfoCopyGlyphs(struct ttfinfo *info) {
-    SplineChar **chars = malloc(info->glyph_cnt*sizeof(SplineChar *));
-    int i;
-    RefChar *r;
-
-    for ( i=0; i<info->glyph_cnt; ++i ) {
-	if ( info->chars[i]==NULL )
-	    chars[i] = NULL;
-	else {
-	    chars[i] = SplineCharCopy(info->chars[i],NULL,NULL);
-	    free(chars[i]->ttf_instrs); chars[i]->ttf_instrs = NULL;
-	    chars[i]->ttf_instrs_len = 0;
-	    PSTFree(chars[i]->possub); chars[i]->possub = NULL;
-	    for ( r=chars[i]->layers[ly_fore].refs; r!=NULL; r=r->next )
-		r->sc = NULL;
-	    chars[i]->changed = false;
-	    chars[i]->ticked = false;
-	}
-    }
-
-    for ( i=0; i<info->glyph_cnt; ++i )
-	ttfFixupRef(chars,i);
-return( chars );
-}
-
 #define BAD_DELTA	0x10001
 static int *readpackeddeltas(FILE *ttf,int n) {
     int *deltas;
@@ -267,18 +247,18 @@ static int *readpackedpoints(FILE *ttf) {
     if ( n==0 )
 	points[0] = ALL_POINTS;
     else {
-	i = 0;
+	/* Each point number is a difference from the previous one, and the */
+	/*  running total carries on from one run to the next */
+	i = 0; first = 0;
 	while ( i<n ) {
 	    runcnt = getc(ttf);
 	    if ( runcnt&0x80 ) {
 		runcnt = (runcnt&0x7f);
-		points[i++] = first = getushort(ttf);
 		/* first point not included in runcount */
-		for ( j=0; j<runcnt && i<n; ++j )
+		for ( j=0; j<=runcnt && i<n; ++j )
 		    points[i++] = (first += getushort(ttf));
 	    } else {
-		points[i++] = first = getc(ttf);
-		for ( j=0; j<runcnt && i<n; ++j )
+		for ( j=0; j<=runcnt && i<n; ++j )
 		    points[i++] = (first += getc(ttf));
 	    }
 	}
@@ -333,162 +313,106 @@ static int PointCount(SplineChar *sc) {
 return( i );
 }
 
-static void SCShiftAllBy(SplineChar *sc,int xd, int yd) {
-    /* If they change the left/right side-bearing, I think that means everything */
-    /*  should be shifted over */
+static int *DefaultCoords(SplineChar *sc,int pcnt,int **_ends,int *_ccnt) {
+    /* Coordinates of each numbered point in the unvaried glyph, x then y, */
+    /*  and the number of the last point in each contour */
+    int *coords = calloc(2*pcnt,sizeof(int)), *ends;
+    int ccnt, last;
     SplineSet *ss;
     SplinePoint *sp;
-    RefChar *ref;
 
-    if ( xd==0 && yd==0 )
-return;
-
-    for ( ss = sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
+    for ( ccnt=0, ss = sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next, ++ccnt );
+    ends = malloc((ccnt+1)*sizeof(int));
+    for ( ccnt=0, ss = sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
+	last = -1;
 	for ( sp=ss->first; sp!=NULL ; ) {
-	    if ( sp->ttfindex!=0xffff && sp->ttfindex!=0xfffe ) {
-		sp->me.x += xd;
-		sp->me.y += yd;
+	    if ( sp->ttfindex<pcnt ) {
+		coords[2*sp->ttfindex] = rint(sp->me.x);
+		coords[2*sp->ttfindex+1] = rint(sp->me.y);
+		if ( sp->ttfindex>last ) last = sp->ttfindex;
 	    }
-	    if ( sp->nextcpindex!=0xffff && sp->nextcpindex!=0xfffe ) {
-		sp->nextcp.x += xd;
-		sp->nextcp.y += yd;
-		if ( sp->next!=NULL )
-		    sp->next->to->prevcp = sp->nextcp;
+	    if ( sp->nextcpindex<pcnt ) {
+		coords[2*sp->nextcpindex] = rint(sp->nextcp.x);
+		coords[2*sp->nextcpindex+1] = rint(sp->nextcp.y);
+		if ( sp->nextcpindex>last ) last = sp->nextcpindex;
 	    }
 	    if ( sp->next==NULL )
 	break;
 	    sp = sp->next->to;
-	    if ( sp == ss->first )
+	    if ( sp==ss->first )
 	break;
 	}
+	if ( last!=-1 )
+	    ends[ccnt++] = last;
     }
-    for ( ref=sc->layers[ly_fore].refs; ref!=NULL; ref=ref->next ) {
-	ref->transform[4] += xd;
-	ref->transform[5] += yd;
-	SCReinstanciateRefChar(sc,ref,ly_fore);
-    }
+    *_ends = ends;
+    *_ccnt = ccnt;
+return( coords );
 }
 
-static void VaryGlyph(SplineChar *sc,int *points, int *xdeltas, int *ydeltas,
-	int pcnt) {
-    /* A character contains either composites or contours */
-    int i,j;
-    RefChar *ref;
-    SplineSet *ss;
-    SplinePoint *sp;
-    Spline *s, *first;
+static int IUPDelta(int c,int c1,int d1,int c2,int d2) {
+    /* Infer the delta of an untouched point from the touched points on */
+    /*  either side of it */
+    if ( c1==c2 )
+return( d1==d2 ? d1 : 0 );
+    if ( c1>c2 ) {
+	int t;
+	t = c1; c1 = c2; c2 = t;
+	t = d1; d1 = d2; d2 = t;
+    }
+    if ( c<=c1 )
+return( d1 );
+    if ( c>=c2 )
+return( d2 );
+return( rint(d1 + (c-c1)*(double) (d2-d1)/(c2-c1)) );
+}
 
-    if ( points[0]==ALL_POINTS ) {
-	if ( sc->layers[ly_fore].refs!=NULL ) {
-	    for ( i=0, ref=sc->layers[ly_fore].refs; ref!=NULL; ++i, ref=ref->next ) {
-		if ( xdeltas[i]!=0 || ydeltas[i]!=0 ) {
-		    ref->transform[4] += xdeltas[i];
-		    ref->transform[5] += ydeltas[i];
-		    SCReinstanciateRefChar(sc,ref,ly_fore);
-		}
-	    }
-	} else {
-	    for ( ss = sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
-		for ( sp=ss->first; sp!=NULL ; ) {
-		    if ( sp->ttfindex!=0xffff && sp->ttfindex!=0xfffe ) {
-			sp->me.x += xdeltas[sp->ttfindex];
-			sp->me.y += ydeltas[sp->ttfindex];
-		    }
-		    if ( sp->nextcpindex!=0xffff && sp->nextcpindex!=0xfffe ) {
-			sp->nextcp.x += xdeltas[sp->nextcpindex];
-			sp->nextcp.y += ydeltas[sp->nextcpindex];
-			if ( sp->next!=NULL )
-			    sp->next->to->prevcp = sp->nextcp;
-		    }
-		    if ( sp->next==NULL )
-		break;
-		    sp = sp->next->to;
-		    if ( sp == ss->first )
-		break;
-		}
-	    }
+static void IUPContour(int *coords,uint8_t *touched,int *xd,int *yd,
+	int start,int end) {
+    int i, p, n, first=-1, prev;
+
+    for ( i=start; i<=end; ++i ) if ( touched[i] ) {
+	first = i;
+    break;
+    }
+    if ( first==-1 )
+return;				/* Nothing moves */
+    prev = first;
+    for ( n=1; n<=end-start+1; ++n ) {
+	i = start + (first-start+n)%(end-start+1);
+	if ( !touched[i] )
+    continue;
+	/* Points strictly between prev and i (cyclically) are untouched */
+	for ( p = prev==end ? start : prev+1; p!=i; p = p==end ? start : p+1 ) {
+	    xd[p] = IUPDelta(coords[2*p],coords[2*prev],xd[prev],coords[2*i],xd[i]);
+	    yd[p] = IUPDelta(coords[2*p+1],coords[2*prev+1],yd[prev],coords[2*i+1],yd[i]);
 	}
-	SCShiftAllBy(sc,-xdeltas[pcnt-4],0);
-	SCShiftAllBy(sc,0,-ydeltas[pcnt-2]);
-	sc->width += xdeltas[pcnt-3];
-	sc->vwidth += ydeltas[pcnt-1];
-    } else {
-	j = 0;
-	if ( sc->layers[ly_fore].refs!=NULL ) {
-	    for ( i=0, ref=sc->layers[ly_fore].refs; ref!=NULL; ++i, ref=ref->next ) {
-		if ( points[j]==i ) {
-		    if ( xdeltas[j]!=0 || ydeltas[j]!=0 ) {
-			ref->transform[4] += xdeltas[j];
-			ref->transform[5] += ydeltas[j];
-			SCReinstanciateRefChar(sc,ref,ly_fore);
-		    }
-		    ++j;
-		}
-	    }
-	} else {
-	    for ( i=0, ss = sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
-		if ( ss->first->prev!=NULL && ss->first->prev->from->nextcpindex==points[j] ) {
-		    ss->first->prevcp.x += xdeltas[j];
-		    ss->first->prevcp.y += ydeltas[j];
-		    ss->first->prev->from->nextcp = ss->first->prevcp;
-		    ++j;
-		}
-		for ( sp=ss->first; sp!=NULL ; ++i ) {
-		    if ( sp->ttfindex!=0xffff && sp->ttfindex!=0xfffe )
-			++i;
-		    if ( sp->ttfindex==points[j] ) {
-			sp->me.x += xdeltas[j];
-			sp->me.y += ydeltas[j++];
-		    }
-		    if ( sp->nextcpindex!=0xffff && sp->nextcpindex!=0xfffe )
-			++i;
-		    if ( sp->nextcpindex==points[j] ) {
-			sp->nextcp.x += xdeltas[j];
-			sp->nextcp.y += ydeltas[j++];
-			if ( sp->next!=NULL )
-			    sp->next->to->prevcp = sp->nextcp;
-		    } else if ( sp->nonextcp ) {
-			sp->nextcp = sp->me;
-		    }
-		    if ( sp->next==NULL )
-		break;
-		    sp = sp->next->to;
-		    if ( sp == ss->first )
-		break;
-		}
-		first = NULL;
-	    }
-	}
-	if ( points[j]==i )
-	    SCShiftAllBy(sc,-xdeltas[j++],0);
-	if ( points[j]==i+1 )
-	    sc->width += xdeltas[j++];
-	if ( points[j]==i+2 )
-	    SCShiftAllBy(sc,0,-ydeltas[j++]);
-	if ( points[j]==i+3 )
-	    sc->vwidth += ydeltas[j++];
+	prev = i;
     }
-    if ( sc->layers[ly_fore].refs==NULL ) {
-	for ( ss = sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
-	    for ( sp=ss->first; sp!=NULL ; ++i ) {
-		if ( sp->ttfindex==0xffff ) {
-		    sp->me.x = ( sp->nextcp.x + sp->prevcp.x )/2;
-		    sp->me.y = ( sp->nextcp.y + sp->prevcp.y )/2;
-		}
-		if ( sp->next==NULL )
-	    break;
-		sp = sp->next->to;
-		if ( sp == ss->first )
-	    break;
-	    }
+}
 
-	    first = NULL;
-	    for ( s=ss->first->next; s!=NULL && s!=first; s=s->to->next ) {
-		SplineRefigure(s);
-		if ( first==NULL ) first = s;
-	    }
-	}
+static void ExpandDeltas(SplineChar *sc,int *points,int *xdeltas,int *ydeltas,
+	int *xd, int *yd, int pcnt) {
+    /* Turn a list of deltas for some of the points into deltas for all */
+    /*  pcnt of them (phantom points included). Points of a contour that */
+    /*  were not mentioned get deltas interpolated from their neighbours, */
+    /*  anything else which was left out doesn't move */
+    uint8_t *touched = calloc(pcnt,1);
+    int *coords, *ends, ccnt, i, j;
+
+    for ( j=0; points[j]!=END_OF_POINTS; ++j ) if ( points[j]<pcnt ) {
+	xd[points[j]] = xdeltas[j];
+	yd[points[j]] = ydeltas[j];
+	touched[points[j]] = true;
+    }
+    if ( sc->layers[ly_fore].refs==NULL ) {
+	coords = DefaultCoords(sc,pcnt-4,&ends,&ccnt);
+	for ( i=0; i<ccnt; ++i )
+	    IUPContour(coords,touched,xd,yd,i==0?0:ends[i-1]+1,ends[i]);
+	free(coords);
+	free(ends);
     }
+    free(touched);
 }
 
 static void VaryGlyphs(struct ttfinfo *info,int tupleIndex,int gnum,
@@ -496,9 +420,12 @@ static void VaryGlyphs(struct ttfinfo *info,int tupleIndex,int gnum,
     /* one annoying thing about gvar, is that the variations do not describe */
     /*  designs. well variations for [0,1] describes that design, but the */
     /*  design for [1,1] includes the variations [0,1], [1,0], and [1,1] */
-    int pcnt, tc;
+    /* So we just remember what each tuple does, and leave it to the MM code */
+    /*  to add them up when it wants an instance glyph */
+    int pcnt, dcnt, k;
     int *xdeltas, *ydeltas;
-    struct variations *v = info->variations;
+    struct mmdeltas *md = info->variations->deltas;
+    int16_t *d;
 
     if ( info->chars[gnum]==NULL )	/* Apple doesn't support ttc so this */
 return;					/*  can't happen */
@@ -506,19 +433,31 @@ return;					/*  can't happen */
 	LogError( _("Mismatched local and shared tuple flags.") );
 return;
     }
+    if ( tupleIndex>=md->tuple_count )
+return;
 
+    pcnt = md->pcnt[gnum]+4;
     if ( points[0]==ALL_POINTS )
-	pcnt = PointCount(info->chars[gnum])+4;
+	dcnt = pcnt;
     else {
-	for ( pcnt=0; points[pcnt]!=END_OF_POINTS; ++pcnt );
-    }
-    xdeltas = readpackeddeltas(ttf,pcnt);
-    ydeltas = readpackeddeltas(ttf,pcnt);
-    if ( xdeltas[0]!=BAD_DELTA && ydeltas[0]!=BAD_DELTA )
-	for ( tc = 0; tc<v->tuple_count; ++tc ) {
-	    if ( TuplesMatch(v,tc,tupleIndex))
-		VaryGlyph(v->tuples[tc].chars[gnum],points,xdeltas,ydeltas,pcnt);
-    } else {
+	for ( dcnt=0; points[dcnt]!=END_OF_POINTS; ++dcnt );
+    }
+    xdeltas = readpackeddeltas(ttf,dcnt);
+    ydeltas = readpackeddeltas(ttf,dcnt);
+    if ( dcnt>0 && xdeltas[0]!=BAD_DELTA && ydeltas[0]!=BAD_DELTA ) {
+	if ( points[0]!=ALL_POINTS ) {
+	    int *xd = calloc(pcnt,sizeof(int)), *yd = calloc(pcnt,sizeof(int));
+	    ExpandDeltas(info->chars[gnum],points,xdeltas,ydeltas,xd,yd,pcnt);
+	    free(xdeltas); xdeltas = xd;
+	    free(ydeltas); ydeltas = yd;
+	}
+	if ( (d = md->deltas[tupleIndex][gnum])==NULL )
+	    d = md->deltas[tupleIndex][gnum] = calloc(2*pcnt,sizeof(int16_t));
+	for ( k=0; k<pcnt; ++k ) {
+	    d[k] += xdeltas[k];
+	    d[pcnt+k] += ydeltas[k];
+	}
+    } else if ( dcnt>0 ) {
 	static int warned = false;
 	if ( !warned )
 	    LogError( _("Incorrect number of deltas in glyph %d (%s)"), gnum,
@@ -577,13 +516,16 @@ return;
 
     v->tuple_count = globaltc;
     v->tuples = calloc(globaltc,sizeof(struct tuples));
+    v->deltas = MMDeltasNew(info->glyph_cnt,globaltc,axiscount);
     fseek(ttf,tupoff,SEEK_SET);
     for ( i=0; i<globaltc; ++i ) {
 	v->tuples[i].coords = malloc(axiscount*sizeof(real));
 	for ( j=0; j<axiscount; ++j )
-	    v->tuples[i].coords[j] = ((short) getushort(ttf))/16384.0;
-	v->tuples[i].chars = InfoCopyGlyphs(info);
+	    v->deltas->coords[i*axiscount+j] = v->tuples[i].coords[j] =
+		    ((short) getushort(ttf))/16384.0;
     }
+    for ( g=0; g<info->glyph_cnt; ++g ) if ( info->chars[g]!=NULL )
+	v->deltas->pcnt[g] = PointCount(info->chars[g]);
 
     for ( g=0; g<gc; ++g ) if ( gvars[g]!=gvars[g+1] ) {
 	int tc;
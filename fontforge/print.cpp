@@ -30,6 +30,7 @@
 
 #include "print.h"
 
+#include "autohint.h"
 #include "cvexport.h"
 #include "dumppfa.h"
 #include "ffglib_compat.h"
@@ -51,6 +52,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <time.h>
+#include <zlib.h>
 #include "ffunistd.h"
 #if !defined(__MINGW32__) && !defined(_MSC_VER)
 #include <sys/wait.h>
@@ -73,6 +75,8 @@ struct printdefaults pdefs[] = {
 /* ***************************** Printing Stuff ***************************** */
 /* ************************************************************************** */
 
+#define PDF_CHUNK	(64*1024)
+
 static int pdf_addobject(PI *pi) {
     if ( pi->next_object==0 ) {
 	pi->max_object = 100;
@@ -87,6 +91,53 @@ static int pdf_addobject(PI *pi) {
 return( pi->next_object-1 );
 }
 
+/* Deflate the first len bytes of from onto the end of the output */
+static long pdf_deflate(PI *pi, FILE *from, long len) {
+    char in[PDF_CHUNK], out[PDF_CHUNK];
+    z_stream strm;
+    long total = 0;
+    int flush;
+
+    memset(&strm,0,sizeof(strm));
+    if ( deflateInit(&strm,Z_DEFAULT_COMPRESSION)!=Z_OK )
+return( 0 );
+    rewind(from);
+    do {
+	strm.avail_in = fread(in,1,len<PDF_CHUNK ? len : PDF_CHUNK,from);
+	strm.next_in = (Bytef *) in;
+	len -= strm.avail_in;
+	flush = len<=0 || strm.avail_in==0 ? Z_FINISH : Z_NO_FLUSH;
+	do {
+	    strm.avail_out = PDF_CHUNK;
+	    strm.next_out = (Bytef *) out;
+	    deflate(&strm,flush);
+	    fwrite(out,1,PDF_CHUNK-strm.avail_out,pi->out);
+	    total += PDF_CHUNK-strm.avail_out;
+	} while ( strm.avail_out==0 );
+    } while ( flush!=Z_FINISH );
+    deflateEnd(&strm);
+return( total );
+}
+
+/* Writes the first len bytes of from as a compressed stream. We don't know */
+/*  how long it will be until we're done, so the length is another object */
+static int pdf_streamobject(PI *pi, FILE *from, long len, const char *dict) {
+    int ret = pi->next_object;
+    long streamlength;
+
+    pdf_addobject(pi);
+    fprintf( pi->out, "<< /Length %d 0 R /Filter /FlateDecode%s >>\n", pi->next_object, dict );
+    fprintf( pi->out, "stream\n" );
+    streamlength = pdf_deflate(pi,from,len);
+    fprintf( pi->out, "\nendstream\n" );
+    fprintf( pi->out, "endobj\n" );
+
+    pdf_addobject(pi);
+    fprintf( pi->out, " %ld\n", streamlength );
+    fprintf( pi->out, "endobj\n\n" );
+return( ret );
+}
+
 static void pdf_addpage(PI *pi) {
     if ( pi->next_page==0 ) {
 	pi->max_page = 100;
@@ -104,58 +155,105 @@ static void pdf_addpage(PI *pi) {
     fprintf( pi->out, "  /Contents %d 0 R\n", pi->next_object );
     fprintf( pi->out, ">>\n" );
     fprintf( pi->out, "endobj\n" );
-	/* Each page has its own content stream */
-    pdf_addobject(pi);
-    fprintf( pi->out, "<< /Length %d 0 R >>\n", pi->next_object );
-    fprintf( pi->out, "stream\n" );
-    pi->start_cur_page = ftell( pi->out );
+	/* Each page has its own content stream, which is the next object. */
+	/* We collect it in the scratch file, and compress it when the page */
+	/* is done, so no page is ever in memory */
+    rewind(pi->pagestream);
+    pi->out = pi->pagestream;
 }
 
 static void pdf_finishpage(PI *pi) {
-    long streamlength;
-
-    if ( pi->pt!=pt_fontsample )
+    if ( pi->pt!=pt_fontsample && pi->pt!=pt_chars )
 	fprintf( pi->out, "Q\n" );
-    streamlength = ftell(pi->out)-pi->start_cur_page;
-    fprintf( pi->out, "\nendstream\n" );
-    fprintf( pi->out, "endobj\n" );
+    pi->out = pi->pdfout;
+    pdf_streamobject(pi,pi->pagestream,ftell(pi->pagestream),"");
+}
 
-    pdf_addobject(pi);
-    fprintf( pi->out, " %ld\n", streamlength );
-    fprintf( pi->out, "endobj\n\n" );
+/* Remember that a page drew sc, and the glyphs it refers to */
+static void pdf_markused(struct sfbits *sfbit, SplineChar *sc) {
+    RefChar *ref;
+    int layer;
+
+    if ( sfbit->used==NULL || sc->orig_pos>=sfbit->usedcnt || sfbit->used[sc->orig_pos] )
+return;
+    sfbit->used[sc->orig_pos] = true;
+    for ( layer=ly_fore; layer<sc->layer_cnt; ++layer )
+	for ( ref=sc->layers[layer].refs; ref!=NULL; ref=ref->next )
+	    pdf_markused(sfbit,ref->sc);
 }
 
-static int pfb_getsectionlength(FILE *pfb,int sec_type,int skip_sec) {
-    int len=0, sublen, ch;
+static SplineChar *pdf_usedglyph(struct sfbits *sfbit, int enc) {
+    int gid = sfbit->map->map[enc];
 
-    for (;;) {
-	ch = getc(pfb);
-	if ( ch!=0x80 ) {
-	    ungetc(ch,pfb);
-	    if ( len!=0 )
-return( len );
-return( -1 );
-	}
-	ch = getc(pfb);
-	if ( ch!=sec_type ) {
-	    fseek(pfb,-2,SEEK_CUR);
-	    if ( len!=0 )
-return( len );
-return( -1 );
-	}
-	ch = getc(pfb);
-	sublen = ch;
-	ch = getc(pfb);
-	sublen += (ch<<8);
-	ch = getc(pfb);
-	sublen += (ch<<16);
-	ch = getc(pfb);
-	sublen += (ch<<24);
-	if ( !skip_sec )
-return( sublen );
-	len += sublen;
-	fseek(pfb,sublen,SEEK_CUR);
+    if ( gid==-1 || gid>=sfbit->usedcnt || !sfbit->used[gid] )
+return( NULL );
+return( sfbit->sf->glyphs[gid] );
+}
+
+/* A subset font needs a tag of six capital letters before its name. Base */
+/*  it on the glyphs used, so the same subset always gets the same name */
+static void pdf_subsettag(struct sfbits *sfbit) {
+    uint32_t hash = 2166136261u;
+    const char *pt;
+    int i;
+
+    for ( pt=sfbit->sf->fontname; *pt; ++pt )
+	hash = (hash^(uint8_t) *pt)*16777619u;
+    for ( i=0; i<sfbit->usedcnt; ++i ) if ( sfbit->used[i] )
+	hash = (hash^i)*16777619u;
+    for ( i=0; i<6; ++i ) {
+	sfbit->subsettag[i] = 'A' + hash%26;
+	hash /= 26;
     }
+    sfbit->subsettag[6] = '+';
+    sfbit->subsettag[7] = '\0';
+}
+
+/* Generate a font containing just the glyphs we used (and .notdef) into */
+/*  fontfile. As in __FreeTypeFontContext we do that by temporarily giving */
+/*  the font (or each subfont of a cid font) a glyph list with nothing else */
+/*  in it. Glyphs keep their orig_pos, so the encoding still works */
+static int pdf_writesubset(struct sfbits *sfbit, enum fontformat format, int flags) {
+    SplineFont *sf = sfbit->sf, *sub;
+    int cnt = sf->subfontcnt==0 ? 1 : sf->subfontcnt;
+    SplineChar ***old = (SplineChar ***)malloc(cnt*sizeof(SplineChar **));
+    SplineChar *sc;
+    int i, k, notdefpos, ret;
+    BlueData bd;
+
+    for ( k=0; k<cnt; ++k ) {
+	sub = sf->subfontcnt==0 ? sf : sf->subfonts[k];
+	/* Autohinting may cause views to remetric glyphs, so do it while */
+	/*  they can still see the whole font */
+	if ( format!=ff_type42cid && autohint_before_generate ) {
+	    QuickBlues(sub,ly_fore,&bd);
+	    for ( i=0; i<sub->glyphcnt && i<sfbit->usedcnt; ++i )
+		if ( sfbit->used[i] && (sc=sub->glyphs[i])!=NULL &&
+			sc->changedsincelasthinted && !sc->manualhints )
+		    SplineCharAutoHint(sc,ly_fore,&bd);
+	}
+	notdefpos = sf->subfontcnt==0 ? SFFindNotdef(sub,-2) : 0;
+	old[k] = sub->glyphs;
+	sub->glyphs = (SplineChar **)calloc(sub->glyphmax,sizeof(SplineChar *));
+	for ( i=0; i<sub->glyphcnt; ++i )
+	    if ( i==notdefpos || (i<sfbit->usedcnt && sfbit->used[i]) )
+		sub->glyphs[i] = old[k][i];
+    }
+    sf->internal_temp = true;
+    rewind(sfbit->fontfile);
+    ret = _WriteTTFFont(sfbit->fontfile,sf,format,NULL,bf_none,flags,sfbit->map,ly_fore);
+    sf->internal_temp = false;
+    for ( k=0; k<cnt; ++k ) {
+	sub = sf->subfontcnt==0 ? sf : sf->subfonts[k];
+	free(sub->glyphs);
+	sub->glyphs = old[k];
+	GlyphHashFree(sub);
+    }
+    free(old);
+    fseek(sfbit->fontfile,0,SEEK_END);
+    if ( !ret )
+	LogError(_("Failed to generate the font %s for the pdf file"), sf->fontname );
+return( ret );
 }
 
 struct fontdesc {
@@ -281,7 +379,7 @@ static int figure_fontdesc(PI *pi, int sfid, struct fontdesc *fd, int fonttype,
     pdf_addobject(pi);
     fprintf( pi->out, "  <<\n" );
     fprintf( pi->out, "    /Type /FontDescriptor\n" );
-    fprintf( pi->out, "    /FontName /%s\n", sf->fontname );
+    fprintf( pi->out, "    /FontName /%s%s\n", pi->sfbits[sfid].subsettag, sf->fontname );
     fprintf( pi->out, "    /Flags %d\n", fd->flags );
     fprintf( pi->out, "    /FontBBox [%g %g %g %g]\n",
 	    (double) fd->bb.minx, (double) fd->bb.miny, (double) fd->bb.maxx, (double) fd->bb.maxy );
@@ -313,29 +411,28 @@ static int figure_fontdesc(PI *pi, int sfid, struct fontdesc *fd, int fonttype,
 return( fd_num );
 }
 
-static void dump_pfb_encoding(PI *pi,int sfid, int base,int font_d_ref) {
-    int i, first=-1, last, gid;
+static void dump_type1_encoding(PI *pi,int sfid, int base,int font_d_ref) {
+    int i, first=-1, last;
     struct sfbits *sfbit = &pi->sfbits[sfid];
     SplineFont *sf = sfbit->sf;
     EncMap *map = sfbit->map;
+    SplineChar *sc;
 
     for ( i=base; i<base+256 && i<map->enccount; ++i ) {
-	gid = map->map[i];
-	if ( gid!=-1 && SCWorthOutputting(sf->glyphs[gid])) {
+	if ( pdf_usedglyph(sfbit,i)!=NULL ) {
 	    if ( first==-1 ) first = i-base;
 	    last = i-base;
 	}
     }
     if ( first==-1 )
 return;			/* Nothing in this range */
-    sfbit->our_font_objs[sfbit->next_font] = pi->next_object;
-    sfbit->fonts[base/256] = sfbit->next_font++;
+    sfbit->our_font_objs[base/256] = pi->next_object;
 
     pdf_addobject(pi);
     fprintf( pi->out, "  <<\n" );
     fprintf( pi->out, "    /Type /Font\n" );
     fprintf( pi->out, "    /Subtype /Type1\n" );
-    fprintf( pi->out, "    /BaseFont /%s\n", sf->fontname );
+    fprintf( pi->out, "    /BaseFont /%s%s\n", sfbit->subsettag, sf->fontname );
     fprintf( pi->out, "    /FirstChar %d\n", first );
     fprintf( pi->out, "    /LastChar %d\n", last );
     fprintf( pi->out, "    /Widths %d 0 R\n", pi->next_object );
@@ -350,8 +447,8 @@ return;			/* Nothing in this range */
     /* The width vector is normalized to 1000 unit em from whatever the font really uses */
     pdf_addobject(pi);
     fprintf( pi->out, "  [\n" );
-    for ( i=base+first; i<=base+last; ++i ) if ( (gid=map->map[i])!=-1 && SCWorthOutputting(sf->glyphs[gid]))
-	fprintf( pi->out, "    %g\n", sf->glyphs[gid]->width*1000.0/(sf->ascent+sf->descent) );
+    for ( i=base+first; i<=base+last; ++i ) if ( (sc=pdf_usedglyph(sfbit,i))!=NULL )
+	fprintf( pi->out, "    %g\n", sc->width*1000.0/(sf->ascent+sf->descent) );
     else
 	fprintf( pi->out, "    0\n" );
     fprintf( pi->out, "  ]\n" );
@@ -362,8 +459,8 @@ return;			/* Nothing in this range */
 	fprintf( pi->out, "    /Type /Encoding\n" );
 	fprintf( pi->out, "    /Differences [ %d\n", first );
 	for ( i=base+first; i<=base+last; ++i )
-	    if ( (gid=map->map[i])!=-1 && SCWorthOutputting( sf->glyphs[gid] ))
-		fprintf( pi->out, "\t/%s\n", sf->glyphs[gid]->name );
+	    if ( (sc=pdf_usedglyph(sfbit,i))!=NULL )
+		fprintf( pi->out, "\t/%s\n", sc->name );
 	    else
 		fprintf( pi->out, "\t/.notdef\n" );
 	fprintf( pi->out, "    ]\n" );
@@ -372,50 +469,21 @@ return;			/* Nothing in this range */
     }
 }
 
-static void pdf_dump_type1(PI *pi,int sfid) {
+/* Non-cid postscript fonts are embedded as bare CFF, which is smaller */
+/*  than type1 and lets us subset them with the otf code */
+static void pdf_dump_type1c(PI *pi,int sfid) {
     struct sfbits *sfbit = &pi->sfbits[sfid];
-    int font_stream = pi->next_object;
-    int fd_obj;
-    int length1, length2, length3;
+    int font_stream, fd_obj;
     int i;
     struct fontdesc fd;
 
-    length1 = pfb_getsectionlength(sfbit->fontfile,1,true);
-    length2 = pfb_getsectionlength(sfbit->fontfile,2,true);
-    length3 = pfb_getsectionlength(sfbit->fontfile,1,true);
-    pdf_addobject(pi);
-    fprintf( pi->out, "<< /Length %d /Length1 %d /Length2 %d /Length3 %d>>\n",
-	    length1+length2+length3, length1, length2, length3 );
-    fprintf( pi->out, "stream\n" );
-    rewind(sfbit->fontfile);
-    length1 = pfb_getsectionlength(sfbit->fontfile,1,false);
-    for ( i=0; i<length1; ++i ) {
-	int ch = getc(sfbit->fontfile);
-	putc(ch,pi->out);
-    }
-    while ( (length2 = pfb_getsectionlength(sfbit->fontfile,2,false))!= -1 ) {
-	for ( i=0; i<length2; ++i ) {
-	    int ch = getc(sfbit->fontfile);
-	    putc(ch,pi->out);
-	}
-    }
-    length3 = pfb_getsectionlength(sfbit->fontfile,1,false);
-    for ( i=0; i<length3; ++i ) {
-	int ch = getc(sfbit->fontfile);
-	putc(ch,pi->out);
-    }
-    fprintf( pi->out, "\nendstream\n" );
-    fprintf( pi->out, "endobj\n\n" );
-
-    fd_obj = figure_fontdesc(pi, sfid, &fd,1,font_stream);
+    if ( !pdf_writesubset(sfbit,ff_cff,ps_flag_nocffsugar) )
+return;
+    font_stream = pdf_streamobject(pi,sfbit->fontfile,ftell(sfbit->fontfile)," /Subtype /Type1C");
+    fd_obj = figure_fontdesc(pi, sfid, &fd,3,font_stream);
 
-    sfbit->our_font_objs = (int *)malloc((sfbit->map->enccount/256+1)*sizeof(int));
-    sfbit->fonts = (int *)malloc((sfbit->map->enccount/256+1)*sizeof(int));
-    for ( i=0; i<sfbit->map->enccount; i += 256 ) {
-	sfbit->fonts[i/256] = -1;
-	dump_pfb_encoding(pi,sfid,i,fd_obj);
-    }
-    sfbit->twobyte = false;
+    for ( i=0; i<sfbit->map->enccount; i += 256 )
+	dump_type1_encoding(pi,sfid,i,fd_obj);
 }
 
 struct opac_state {
@@ -762,7 +830,8 @@ int PdfDumpGlyphResources(PI *pi,SplineChar *sc) {
 return( resobj );
 }
 
-static int PdfDumpSFResources(PI *pi,SplineFont *sf) {
+static int PdfDumpSFResources(PI *pi,struct sfbits *sfbit,int notdefpos) {
+    SplineFont *sf = sfbit->sf;
     int resobj;
     struct glyph_res gr = GLYPH_RES_EMPTY;
     int i;
@@ -770,7 +839,9 @@ static int PdfDumpSFResources(PI *pi,SplineFont *sf) {
     SplineChar *sc;
     RefChar *ref;
 
-    for ( gid=0; gid<sf->glyphcnt; ++gid) if ( (sc=sf->glyphs[gid])!=NULL ) {
+    /* Only the glyphs in the subset need their images and patterns */
+    for ( gid=0; gid<sf->glyphcnt && gid<sfbit->usedcnt; ++gid)
+	    if ( (sc=sf->glyphs[gid])!=NULL && (sfbit->used[gid] || gid==notdefpos) ) {
 	for ( layer=ly_fore; layer<sc->layer_cnt; ++layer ) {
 	    if ( sc->layers[layer].dofill )
 		pdf_BrushCheck(pi,&gr,&sc->layers[layer].fill_brush,true,layer,sc,NULL);
@@ -783,7 +854,7 @@ static int PdfDumpSFResources(PI *pi,SplineFont *sf) {
 			pdf_BrushCheck(pi,&gr,&ref->layers[i].fill_brush,true,i,ref->sc,ref);
 		    if ( ref->layers[i].dostroke )
 			pdf_BrushCheck(pi,&gr,&ref->layers[i].stroke_pen.brush,false,i,ref->sc,ref);
-		    pdf_ImageCheck(pi,&gr,ref->layers[layer].images,i,ref->sc);
+		    pdf_ImageCheck(pi,&gr,ref->layers[i].images,i,ref->sc);
 		}
 	    }
 	}
@@ -823,20 +894,88 @@ static int PdfDumpSFResources(PI *pi,SplineFont *sf) {
 return( resobj );
 }
 
+/* Compressed type3 charprocs, keyed by their contents. Printing the same */
+/*  glyphs again, in this document or a later one, reuses them rather than */
+/*  compressing them again. The uncompressed bytes are kept too, so that a */
+/*  hash collision can't put another glyph's drawing in the document */
+struct charproc {
+    uint64_t hash;
+    long len;
+    Bytef *raw;
+    uLongf clen;
+    Bytef *data;
+    struct charproc *next;
+};
+
+#define CHARPROC_HASH		1021
+#define CHARPROC_MAXBYTES	(8*1024*1024)
+
+static struct charproc *charprocs[CHARPROC_HASH];
+static long charproc_bytes;
+
+static void CharProcsFree(void) {
+    struct charproc *cp, *next;
+    int i;
+
+    for ( i=0; i<CHARPROC_HASH; ++i ) {
+	for ( cp=charprocs[i]; cp!=NULL; cp=next ) {
+	    next = cp->next;
+	    free(cp->raw);
+	    free(cp->data);
+	    free(cp);
+	}
+	charprocs[i] = NULL;
+    }
+    charproc_bytes = 0;
+}
+
+static struct charproc *CharProcFind(FILE *from, long len) {
+    Bytef *buf = (Bytef *)malloc(len>0 ? len : 1);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    struct charproc *cp;
+    long i;
+
+    rewind(from);
+    len = fread(buf,1,len,from);
+    for ( i=0; i<len; ++i )
+	hash = (hash^buf[i])*0x100000001b3ULL;
+    for ( cp=charprocs[hash%CHARPROC_HASH]; cp!=NULL; cp=cp->next )
+	if ( cp->hash==hash && cp->len==len && memcmp(cp->raw,buf,len)==0 ) {
+	    free(buf);
+return( cp );
+	}
+
+    cp = (struct charproc *)calloc(1,sizeof(struct charproc));
+    cp->hash = hash;
+    cp->len = len;
+    cp->clen = compressBound(len);
+    cp->data = (Bytef *)malloc(cp->clen);
+    if ( compress(cp->data,&cp->clen,buf,len)!=Z_OK ) {
+	free(cp->data); free(cp); free(buf);
+return( NULL );
+    }
+    cp->raw = buf;
+    if ( charproc_bytes+cp->len+cp->clen>CHARPROC_MAXBYTES )
+	CharProcsFree();
+    charproc_bytes += cp->len+cp->clen;
+    cp->next = charprocs[hash%CHARPROC_HASH];
+    charprocs[hash%CHARPROC_HASH] = cp;
+return( cp );
+}
+
 static int pdf_charproc(PI *pi, SplineChar *sc) {
-    int ret = pi->next_object;
-    long streamstart, streamlength;
+    int ret;
+    long streamlength;
     int i,last;
+    struct charproc *cp;
 
-    pdf_addobject(pi);
     /* Now page 96 of the PDFReference.pdf manual claims that Resource dicas */
     /*  for type3 fonts should reside in the content stream dictionary. This */
     /*  isn't very meaningful because type3 fonts are not content streams. I */
     /*  assumed it meant in the stream dictionary for each glyph (which is a */
     /*  content stream) but that is not the case. It's in the font dictionary*/
-    fprintf( pi->out, "<< /Length %d 0 R >>", pi->next_object );
-    fprintf( pi->out, "stream\n" );
-    streamstart = ftell(pi->out);
+    rewind(pi->pagestream);
+    pi->out = pi->pagestream;
 
     /* In addition to drawing the glyph, we must provide some metrics */
     last = ly_fore;
@@ -884,26 +1023,30 @@ static int pdf_charproc(PI *pi, SplineChar *sc) {
 
     SC_PSDump((void (*)(int,void *)) fputc,pi->out,sc,true,true,ly_fore);
 
-    streamlength = ftell(pi->out)-streamstart;
+    streamlength = ftell(pi->out);
+    pi->out = pi->pdfout;
+    if ( (cp = CharProcFind(pi->pagestream,streamlength))==NULL )
+return( pdf_streamobject(pi,pi->pagestream,streamlength,""));
+    ret = pdf_addobject(pi);
+    fprintf( pi->out, "<< /Length %ld /Filter /FlateDecode >>\n", (long) cp->clen );
+    fprintf( pi->out, "stream\n" );
+    fwrite(cp->data,1,cp->clen,pi->out);
     fprintf( pi->out, "\nendstream\n" );
-    fprintf( pi->out, "endobj\n" );
-
-    pdf_addobject(pi);
-    fprintf( pi->out, " %ld\n", streamlength );
     fprintf( pi->out, "endobj\n\n" );
 return( ret );
 }
 
-static void dump_pdf3_encoding(PI *pi,int sfid, int base,DBounds *bb, int notdefproc) {
-    int i, first=-1, last, gid;
+static void dump_pdf3_encoding(PI *pi,int sfid, int base,DBounds *bb,
+	int notdefproc, int resobj) {
+    int i, first=-1, last;
     int charprocs[256];
     struct sfbits *sfbit = &pi->sfbits[sfid];
     SplineFont *sf = sfbit->sf;
     EncMap *map = sfbit->map;
-    int respos, resobj;
+    SplineChar *sc;
 
-    for ( i=base; i<base+256 && i<map->enccount; ++i ) if ( (gid=map->map[i])!=-1 ) {
-	if ( SCWorthOutputting(sf->glyphs[gid]) && strcmp(sf->glyphs[gid]->name,".notdef")!=0 ) {
+    for ( i=base; i<base+256 && i<map->enccount; ++i ) {
+	if ( (sc=pdf_usedglyph(sfbit,i))!=NULL && strcmp(sc->name,".notdef")!=0 ) {
 	    if ( first==-1 ) first = i-base;
 	    last = i-base;
 	}
@@ -912,13 +1055,12 @@ static void dump_pdf3_encoding(PI *pi,int sfid, int base,DBounds *bb, int notdef
 return;			/* Nothing in this range */
 
     memset(charprocs,0,sizeof(charprocs));
-    for ( i=base; i<base+256 && i<map->enccount; ++i ) if ( (gid=map->map[i])!=-1 ) {
-	if ( SCWorthOutputting(sf->glyphs[gid]) && strcmp(sf->glyphs[gid]->name,".notdef")!=0 )
-	    charprocs[i-base] = pdf_charproc(pi,sf->glyphs[gid]);
+    for ( i=base; i<base+256 && i<map->enccount; ++i ) {
+	if ( (sc=pdf_usedglyph(sfbit,i))!=NULL && strcmp(sc->name,".notdef")!=0 )
+	    charprocs[i-base] = pdf_charproc(pi,sc);
     }
 
-    sfbit->our_font_objs[sfbit->next_font] = pi->next_object;
-    sfbit->fonts[base/256] = sfbit->next_font++;
+    sfbit->our_font_objs[base/256] = pi->next_object;
 
     pdf_addobject(pi);
     fprintf( pi->out, "  <<\n" );
@@ -934,9 +1076,7 @@ return;			/* Nothing in this range */
     fprintf( pi->out, "    /Widths %d 0 R\n", pi->next_object );
     fprintf( pi->out, "    /Encoding %d 0 R\n", pi->next_object+1 );
     fprintf( pi->out, "    /CharProcs %d 0 R\n", pi->next_object+2 );
-    fprintf( pi->out, "    /Resources " );
-    respos = ftell(pi->out);
-    fprintf( pi->out, "000000 0 R\n" );
+    fprintf( pi->out, "    /Resources %d 0 R\n", resobj );
     fprintf( pi->out, "  >>\n" );
     fprintf( pi->out, "endobj\n" );
 
@@ -944,8 +1084,8 @@ return;			/* Nothing in this range */
     pdf_addobject(pi);
     fprintf( pi->out, "  [\n" );
     for ( i=base+first; i<=base+last; ++i )
-	if ( (gid=map->map[i])!=-1 && SCWorthOutputting(sf->glyphs[gid]))
-	    fprintf( pi->out, "    %d\n", sf->glyphs[gid]->width );
+	if ( charprocs[i-base]!=0 )
+	    fprintf( pi->out, "    %d\n", pdf_usedglyph(sfbit,i)->width );
 	else
 	    fprintf( pi->out, "    0\n" );
     fprintf( pi->out, "  ]\n" );
@@ -957,8 +1097,8 @@ return;			/* Nothing in this range */
     fprintf( pi->out, "    /Type /Encoding\n" );
     fprintf( pi->out, "    /Differences [ %d\n", first );
     for ( i=base+first; i<=base+last; ++i )
-	if ( (gid=map->map[i])!=-1 && SCWorthOutputting(sf->glyphs[gid]))
-	    fprintf( pi->out, "\t/%s\n", sf->glyphs[gid]->name );
+	if ( charprocs[i-base]!=0 )
+	    fprintf( pi->out, "\t/%s\n", pdf_usedglyph(sfbit,i)->name );
 	else
 	    fprintf( pi->out, "\t/.notdef\n" );
     fprintf( pi->out, "    ]\n" );
@@ -970,20 +1110,14 @@ return;			/* Nothing in this range */
     fprintf( pi->out, "  <<\n" );
     fprintf( pi->out, "\t/.notdef %d 0 R\n", notdefproc );
     for ( i=base+first; i<=base+last; ++i )
-	if ( (gid=map->map[i])!=-1 && SCWorthOutputting(sf->glyphs[gid]))
-	    fprintf( pi->out, "\t/%s %d 0 R\n", sf->glyphs[gid]->name, charprocs[i-base] );
+	if ( charprocs[i-base]!=0 )
+	    fprintf( pi->out, "\t/%s %d 0 R\n", pdf_usedglyph(sfbit,i)->name, charprocs[i-base] );
     fprintf( pi->out, "  >>\n" );
     fprintf( pi->out, "endobj\n" );
-
-
-    resobj = PdfDumpSFResources(pi,sf);
-    fseek(pi->out,respos,SEEK_SET);
-    fprintf(pi->out,"%06d", resobj );
-    fseek(pi->out,0,SEEK_END);
 }
 
 static void pdf_gen_type3(PI *pi,int sfid) {
-    int i, notdefproc;
+    int i, notdefproc, resobj;
     DBounds bb;
     SplineChar sc;
     Layer layers[2];
@@ -1006,41 +1140,52 @@ static void pdf_gen_type3(PI *pi,int sfid) {
     }
 
     SplineFontFindBounds(sf,&bb);
-    sfbit->our_font_objs = (int *)malloc((map->enccount/256+1)*sizeof(int *));
-    sfbit->fonts = (int *)malloc((map->enccount/256+1)*sizeof(int *));
-    for ( i=0; i<map->enccount; i += 256 ) {
-	sfbit->fonts[i/256] = -1;
-	dump_pdf3_encoding(pi,sfid,i,&bb,notdefproc);
-    }
-    sfbit->twobyte = false;
+    resobj = PdfDumpSFResources(pi,sfbit,notdefpos);
+    for ( i=0; i<map->enccount; i += 256 )
+	dump_pdf3_encoding(pi,sfid,i,&bb,notdefproc,resobj);
 }
 
 static void pdf_build_type0(PI *pi, int sfid) {
-    int cidfont_ref, fd_obj, font_stream = pi->next_object;
+    int cidfont_ref, fd_obj, font_stream, cidtogid = 0;
     long len;
-    int ch, cidmax, i,j;
+    int cidmax, i,j;
     struct fontdesc fd;
     struct sfbits *sfbit = &pi->sfbits[sfid];
     SplineFont *sf = sfbit->sf;
     SplineFont *cidmaster = sf->cidmaster!=NULL?sf->cidmaster:sf;
     uint16_t *widths;
-    int defwidth = sf->ascent+sf->descent;
-
-    fseek( sfbit->fontfile,0,SEEK_END);
-    len = ftell(sfbit->fontfile );
+    int defwidth = 1000;	/* Glyph space of a CIDFont is always 1000 units */
+    char dict[40];
 
-    pdf_addobject(pi);
-    fprintf( pi->out, "<< /Length %ld ", len );
+    if ( !pdf_writesubset(sfbit,sfbit->istype42cid?ff_type42cid:ff_cffcid,ps_flag_nocffsugar) )
+return;
+    len = ftell(sfbit->fontfile);
     if ( sfbit->istype42cid )
-	fprintf( pi->out, "/Length1 %ld>>\n", len );
+	sprintf( dict, " /Length1 %ld", len );
     else
-	fprintf( pi->out, "/Subtype /CIDFontType0C>>\n" );
-    fprintf( pi->out, "stream\n" );
-    rewind(sfbit->fontfile);
-    while ( (ch=getc(sfbit->fontfile))!=EOF )
-	putc(ch,pi->out);
-    fprintf( pi->out, "\nendstream\n" );
-    fprintf( pi->out, "endobj\n\n" );
+	strcpy( dict, " /Subtype /CIDFontType0C" );
+    font_stream = pdf_streamobject(pi,sfbit->fontfile,len,dict);
+
+    cidmax = 0;
+    if ( cidmaster->subfonts!=0 ) {
+	for ( i=0; i<cidmaster->subfontcnt; ++i )
+	    if ( cidmax<cidmaster->subfonts[i]->glyphcnt )
+		cidmax = cidmaster->subfonts[i]->glyphcnt;
+    } else
+	cidmax = cidmaster->glyphcnt;
+
+    if ( sfbit->istype42cid ) {
+	/* The pages call glyphs by their orig_pos, which we must map to */
+	/*  wherever they ended up in the subset font */
+	rewind(pi->pagestream);
+	for ( i=0; i<cidmax; ++i ) {
+	    int gid = i<sfbit->usedcnt && sfbit->used[i] && cidmaster->glyphs[i]!=NULL &&
+		    cidmaster->glyphs[i]->ttf_glyph>0 ? cidmaster->glyphs[i]->ttf_glyph : 0;
+	    putc(gid>>8,pi->pagestream);
+	    putc(gid&0xff,pi->pagestream);
+	}
+	cidtogid = pdf_streamobject(pi,pi->pagestream,ftell(pi->pagestream),"");
+    }
 
     fd_obj = figure_fontdesc(pi, sfid, &fd,sfbit->istype42cid?2:3,font_stream);
 
@@ -1049,7 +1194,7 @@ static void pdf_build_type0(PI *pi, int sfid) {
     fprintf( pi->out, "  <<\n" );
     fprintf( pi->out, "    /Type /Font\n" );
     fprintf( pi->out, "    /Subtype /CIDFontType%d\n", sfbit->istype42cid?2:0 );
-    fprintf( pi->out, "    /BaseFont /%s\n", cidmaster->fontname);
+    fprintf( pi->out, "    /BaseFont /%s%s\n", sfbit->subsettag, cidmaster->fontname);
     if ( cidmaster->cidregistry!=NULL && strmatch(cidmaster->cidregistry,"Adobe")==0 )
 	fprintf( pi->out, "    /CIDSystemInfo << /Registry (%s) /Ordering (%s) /Supplement %d >>\n",
 		cidmaster->cidregistry, cidmaster->ordering, cidmaster->supplement );
@@ -1059,33 +1204,27 @@ static void pdf_build_type0(PI *pi, int sfid) {
     fprintf( pi->out, "    /W %d 0 R\n", pi->next_object );
     fprintf( pi->out, "    /FontDescriptor %d 0 R\n", fd_obj );
     if ( sfbit->istype42cid )
-	fprintf( pi->out, "    /CIDToGIDMap /Identity\n" );
+	fprintf( pi->out, "    /CIDToGIDMap %d 0 R\n", cidtogid );
     fprintf( pi->out, "  >>\n" );
     fprintf( pi->out, "endobj\n" );
 
-    cidmax = 0;
-    if ( cidmaster->subfonts!=0 ) {
-	for ( i=0; i<cidmaster->subfontcnt; ++i )
-	    if ( cidmax<cidmaster->subfonts[i]->glyphcnt )
-		cidmax = cidmaster->subfonts[i]->glyphcnt;
-    } else
-	cidmax = cidmaster->glyphcnt + 2;	/* two extra useless glyphs in ttf */
-
     widths = (uint16_t *)malloc(cidmax*sizeof(uint16_t));
 
     for ( i=0; i<cidmax; ++i ) {
 	SplineChar *sc = NULL;
-	if ( cidmaster->subfonts!=0 ) {
+	if ( i>=sfbit->usedcnt || !sfbit->used[i] )
+	    sc = NULL;
+	else if ( cidmaster->subfonts!=0 ) {
 	    for ( j=0; j<cidmaster->subfontcnt; ++j )
 		if ( i<cidmaster->subfonts[j]->glyphcnt &&
 			SCWorthOutputting(cidmaster->subfonts[j]->glyphs[i]) ) {
 		    sc = cidmaster->subfonts[j]->glyphs[i];
 	    break;
 		}
-	} else if ( i<cidmaster->glyphcnt )
+	} else
 	    sc = cidmaster->glyphs[i];
 	if ( sc!=NULL )
-	    widths[i] = sc->width;
+	    widths[i] = rint(sc->width*1000.0/(sf->ascent+sf->descent));
 	else
 	    widths[i] = defwidth;
     }
@@ -1121,17 +1260,15 @@ static void pdf_build_type0(PI *pi, int sfid) {
     fprintf( pi->out, "\n" );
 
     /* OK, now we've dumped up the CID part, we need to create a Type0 Font */
-    sfbit->our_font_objs = (int *)malloc(sizeof(int));
     sfbit->our_font_objs[0] = pi->next_object;
-    sfbit->next_font = 1;
     pdf_addobject(pi);
     fprintf( pi->out, "  <<\n" );
     fprintf( pi->out, "    /Type /Font\n" );
     fprintf( pi->out, "    /Subtype /Type0\n" );
     if ( sfbit->istype42cid )
-	fprintf( pi->out, "    /BaseFont /%s\n", sfbit->sf->fontname );
+	fprintf( pi->out, "    /BaseFont /%s%s\n", sfbit->subsettag, sfbit->sf->fontname );
     else
-	fprintf( pi->out, "    /BaseFont /%s-Identity-H\n", cidmaster->fontname);
+	fprintf( pi->out, "    /BaseFont /%s%s-Identity-H\n", sfbit->subsettag, cidmaster->fontname);
     fprintf( pi->out, "    /Encoding /Identity-H\n" );
     fprintf( pi->out, "    /DescendantFonts [%d 0 R]\n", cidfont_ref);
     fprintf( pi->out, "  >>\n" );
@@ -1144,7 +1281,7 @@ static void dump_pdfprologue(PI *pi) {
     struct tm tm_buf;
     long zoffset;
     const char *author = GetAuthor();
-    int sfid;
+    int sfid, i;
 
     fprintf( pi->out, "%%PDF-1.4\n%%\201\342\202\203\n" );	/* Header comment + binary comment */
 
@@ -1203,9 +1340,37 @@ static void dump_pdfprologue(PI *pi) {
     fprintf( pi->out, ">>\n" );
     fprintf( pi->out, "endobj\n\n" );
 
+    /* The fonts come after the pages, once we know what glyphs they use. */
+    /*  But the pages need to know what they will be called. A cid font is */
+    /*  one font, anything else gets one for each block of 256 encodings */
+    for ( sfid=0; sfid<pi->sfcnt; ++sfid ) {
+	struct sfbits *sfbit = &pi->sfbits[sfid];
+	if ( sfbit->fontfile==NULL )
+    continue;
+	if ( sfbit->iscid && !sfbit->sf->multilayer ) {
+	    sfbit->next_font = 1;
+	    sfbit->our_font_objs = (int *)malloc(sizeof(int));
+	    sfbit->our_font_objs[0] = -1;
+	} else {
+	    sfbit->next_font = sfbit->map->enccount/256+1;
+	    sfbit->our_font_objs = (int *)malloc(sfbit->next_font*sizeof(int));
+	    sfbit->fonts = (int *)malloc(sfbit->next_font*sizeof(int));
+	    for ( i=0; i<sfbit->next_font; ++i ) {
+		sfbit->fonts[i] = i;
+		sfbit->our_font_objs[i] = -1;
+	    }
+	    sfbit->twobyte = false;
+	}
+    }
+}
+
+static void dump_pdffonts(PI *pi) {
+    int sfid;
+
     for ( sfid=0; sfid<pi->sfcnt; ++sfid ) {
 	struct sfbits *sfbit = &pi->sfbits[sfid];
 	if ( sfbit->fontfile!=NULL ) {
+	    pdf_subsettag(sfbit);
 	    if ( sfbit->sf->multilayer )
 		/* We can't use a postscript type3 font, we have to build up a  */
 		/* pdf font out of pdf graphics. Should be a one to one mapping */
@@ -1215,7 +1380,7 @@ static void dump_pdfprologue(PI *pi) {
 	    else if ( sfbit->iscid )
 		pdf_build_type0(pi,sfid);
 	    else
-		pdf_dump_type1(pi,sfid);
+		pdf_dump_type1c(pi,sfid);
 	}
     }
 }
@@ -1225,6 +1390,8 @@ static void dump_pdftrailer(PI *pi) {
     int xrefloc;
     int sfid;
 
+    dump_pdffonts(pi);
+
     /* Fix up the document catalog to point to the Pages dictionary */
     /*  which we will now create */
     /* Document catalog is object 2 */
@@ -1256,7 +1423,7 @@ static void dump_pdftrailer(PI *pi) {
     fprintf( pi->out, "      /FTB %d 0 R\n", pi->next_object );
     for ( sfid=0; sfid<pi->sfcnt; ++sfid ) {
 	struct sfbits *sfbit = &pi->sfbits[sfid];
-	for ( i=0; i<sfbit->next_font; ++i )
+	for ( i=0; i<sfbit->next_font; ++i ) if ( sfbit->our_font_objs[i]!=-1 )
 	    fprintf( pi->out, "      /F%d-%d %d 0 R\n", sfid, i, sfbit->our_font_objs[i] );
     }
     fprintf( pi->out, "    >>\n" );
@@ -1507,7 +1674,7 @@ return;
 
 static int PIDownloadFont(PI *pi, SplineFont *sf, EncMap *map) {
     int is_mm = sf->mm!=NULL && MMValid(sf->mm,false);
-    int error = false;
+    int error = false, i;
     struct sfbits *sfbit = &pi->sfbits[pi->sfid];
 
     if ( sf->cidmaster!=NULL ) sf = sf->cidmaster;
@@ -1527,6 +1694,17 @@ static int PIDownloadFont(PI *pi, SplineFont *sf, EncMap *map) {
     if ( sfbit->fontfile==NULL ) {
 	ff_post_error(_("Failed to open temporary output file"),_("Failed to open temporary output file"));
 return(false);
+    }
+    if ( pi->printtype==pt_pdf ) {
+	/* pdf fonts are generated after the pages, with just the glyphs */
+	/*  those pages used. Until then fontfile is only a flag */
+	sfbit->usedcnt = sf->glyphcnt;
+	for ( i=0; i<sf->subfontcnt; ++i )
+	    if ( sfbit->usedcnt<sf->subfonts[i]->glyphcnt )
+		sfbit->usedcnt = sf->subfonts[i]->glyphcnt;
+	sfbit->used = (uint8_t *)calloc(sfbit->usedcnt+1,sizeof(uint8_t));
+	++ pi->sfcnt;
+return( true );
     }
     if ( pi->sfid==0 )
 	ff_progress_start_indicator(10,_("Printing Font"),_("Printing Font"),
@@ -1534,16 +1712,7 @@ return(false);
     else
 	ff_progress_reset();
     ff_progress_enable_stop(false);
-    if ( pi->printtype==pt_pdf && sf->multilayer ) {
-	/* These need to be done in line as pdf objects */
-	/* I leave fontfile open as a flag, even though we don't use it */
-    } else if ( pi->printtype==pt_pdf && sfbit->iscid ) {
-	if ( !_WriteTTFFont(sfbit->fontfile,sf,
-		sfbit->istype42cid?ff_type42cid:ff_cffcid,NULL,bf_none,
-		ps_flag_nocffsugar,map,ly_fore))
-	    error = true;
-    } else if ( !_WritePSFont(sfbit->fontfile,sf,
-		pi->printtype==pt_pdf ? ff_pfb :
+    if ( !_WritePSFont(sfbit->fontfile,sf,
 		sf->multilayer?ff_ptype3:
 		is_mm?ff_mma:
 		sfbit->istype42cid?ff_type42cid:
@@ -1704,7 +1873,7 @@ return(0);
 	}
 	fprintf(pi->out, "BT\n  %d %d Td\n", 58-(pi->pointsize+pi->extrahspace), pi->ypos );
 	if ( sfbit->iscid )
-	    fprintf(pi->out, "  /F0 %d Tf\n", pi->pointsize );
+	    fprintf(pi->out, "  /F%d-0 %d Tf\n", pi->sfid, pi->pointsize );
 	for ( i=0; i<pi->max ; ++i ) {
 	    fprintf( pi->out, "  %d 0 TD\n", pi->pointsize+pi->extrahspace );
 	    if ( i+pi->chline<sfbit->cidcnt &&
@@ -1716,14 +1885,19 @@ return(0);
 		    lastfont = (i+pi->chline)/256;
 		    fprintf(pi->out, "  /F%d-%d %d Tf\n", pi->sfid, sfbit->fonts[lastfont], pi->pointsize );
 		}
-		if ( sfbit->istype42cid ) {
-		    int gid = sfbit->map->map[pi->chline+i];
-		    SplineChar *sc = gid==-1? NULL : sfbit->sf->glyphs[gid];
-		    fprintf( pi->out, "  <%04x> Tj\n", sc==NULL ? 0 : sc->ttf_glyph );
-		} else if ( sfbit->iscid )
+		if ( sfbit->iscid && !sfbit->istype42cid ) {
+		    int k = CIDWorthOutputting(sfbit->sf,pi->chline+i);
+		    pdf_markused(sfbit,sfbit->sf->subfonts[k]->glyphs[pi->chline+i]);
 		    fprintf( pi->out, "  <%04x> Tj\n", pi->chline+i );
-		else
-		    fprintf( pi->out, "  <%02x> Tj\n", (pi->chline+i)%256 );
+		} else {
+		    SplineChar *sc = sfbit->sf->glyphs[sfbit->map->map[pi->chline+i]];
+		    pdf_markused(sfbit,sc);
+		    /* The CIDToGIDMap finds it in the subset font */
+		    if ( sfbit->istype42cid )
+			fprintf( pi->out, "  <%04x> Tj\n", sc->orig_pos );
+		    else
+			fprintf( pi->out, "  <%02x> Tj\n", (pi->chline+i)%256 );
+		}
 	    }
 	}
 	fprintf(pi->out, "ET\n" );
@@ -1817,10 +1991,10 @@ static void SCPrintPage(PI *pi,SplineChar *sc) {
     DBounds b, page;
     real scalex, scaley;
 
-    if ( pi->page!=0 )
-	endpage(pi);
-    ++pi->page;
     if ( pi->printtype!=pt_pdf ) {
+	if ( pi->page!=0 )
+	    endpage(pi);
+	++pi->page;
 	fprintf(pi->out,"%%%%Page: %d %d\n", pi->page, pi->page );
 	fprintf(pi->out,"%%%%PageResources: font Times-Bold\n" );
 	fprintf(pi->out,"save mark\n" );
@@ -1965,9 +2139,11 @@ static void outputchar(PI *pi, int sfid, SplineChar *sc) {
 
     if ( sc==NULL )
 return;
-    /* type42cid output uses a CIDMap indexed by GID */
+    pdf_markused(&pi->sfbits[sfid],sc);
+    /* type42cid output uses a CIDMap indexed by GID. In pdf the map is */
+    /*  from orig_pos, so we don't care where the glyph lands in the subset */
     if ( pi->sfbits[sfid].istype42cid ) {
- 	fprintf( pi->out, "%04X", sc->ttf_glyph );
+ 	fprintf( pi->out, "%04X", pi->printtype==pt_pdf ? sc->orig_pos : sc->ttf_glyph );
     } else {
 	enc = pi->sfbits[sfid].map->backmap[sc->orig_pos];
 	if ( enc==-1 )
@@ -2942,13 +3118,22 @@ static void QueueIt(PI *pi) {
 }
 
 void DoPrinting(PI *pi,char *filename) {
-    int sfmax=1;
+    int sfmax=1, i;
 
     if ( pi->pt==pt_fontsample ) {
 	struct sfmaps *sfmap;
 	for ( sfmap=pi->sample->sfmaps, sfmax=0; sfmap!=NULL; sfmap=sfmap->next, ++sfmax );
 	if ( sfmax==0 ) sfmax=1;
     }
+    if ( pi->printtype==pt_pdf ) {
+	pi->pdfout = pi->out;
+	pi->pagestream = GFileTmpfile();
+	if ( pi->pagestream==NULL ) {
+	    ff_post_error(_("Failed to open temporary output file"),_("Failed to open temporary output file"));
+	    fclose(pi->out);
+return;
+	}
+    }
     pi->sfmax = sfmax;
     pi->sfbits = (struct sfbits *)calloc(sfmax,sizeof(struct sfbits));
     pi->sfcnt = 0;
@@ -2970,6 +3155,13 @@ void DoPrinting(PI *pi,char *filename) {
     if ( fclose(pi->out)!=0 )
 	ff_post_error(_("Print Failed"),_("Failed to generate postscript in file %s"),
 		filename==NULL?"temporary":filename );
+    for ( i=0; i<pi->sfcnt; ++i ) {
+	if ( pi->sfbits[i].fontfile!=NULL )
+	    fclose(pi->sfbits[i].fontfile);
+	free(pi->sfbits[i].used);
+    }
+    if ( pi->pagestream!=NULL )
+	fclose(pi->pagestream);
     free(pi->sfbits);
 }
 
@@ -68,6 +68,11 @@ struct sfbits {
     unsigned int isunicode: 1;
     unsigned int isunicodefull: 1;
     struct sfmaps *sfmap;
+    /* pdf fonts are written after the pages and contain only the glyphs */
+    /*  the pages used (indexed by orig_pos, which is the cid in a cid font) */
+    uint8_t *used;
+    int usedcnt;
+    char subsettag[8];
 };
 
 typedef struct printinfo {
@@ -104,7 +109,8 @@ typedef struct printinfo {
     /*  be represented by many actual fonts to encode all our glyphs */
     int sfcnt, sfmax, sfid;
     struct sfbits *sfbits;
-    long start_cur_page;
+    FILE *pdfout, *pagestream;	/* pdf page contents go to pagestream and */
+				/*  are compressed into pdfout at the end of the page */
     int lastfont, intext;
     struct layoutinfo *sample;
     int wassfid, wasfn, wasps;
@@ -45,6 +45,7 @@
 #include "ffpython.h"
 #include "flaglist.h"
 #include "fontforgevw.h"
+#include "fontmemory.h"
 #include "fvcomposite.h"
 #include "fvfonts.h"
 #include "fvimportbdf.h"
@@ -79,6 +80,7 @@
 #include "svg.h"
 #include "tottf.h"
 #include "tottfgpos.h"
+#include "trace.h"
 #include "ttf.h"
 #include "ttfinstrs.h"
 #include "uiinterface.h"
@@ -540,7 +542,7 @@ static PyObject *PyFF_SetPrefs(PyObject *UNUSED(self), PyObject *args) {
 	    val.type = v_str;
 	else {
 	    PyErr_Clear();
-	    if ( PyArg_ParseTuple(args,"sd",&d) ) {
+	    if ( PyArg_ParseTuple(args,"sd",&prefname,&d) ) {
 		val.u.fval = d;
 		val.type = v_real;
 	    } else
@@ -1202,6 +1204,45 @@ static PyObject *PyFF_SpiroVersion(PyObject *UNUSED(self), PyObject *UNUSED(args
     return( ret );
 }
 
+static PyObject *PyFF_UndoMemory(PyObject *UNUSED(self), PyObject *UNUSED(args)) {
+return( PyLong_FromSize_t(UndoMemory()));
+}
+
+static PyObject *PyFF_TraceStart(PyObject *UNUSED(self), PyObject *args) {
+    const char *filename;
+
+    if ( !PyArg_ParseTuple(args,"s", &filename) )
+return( NULL );
+    if ( !TraceStart(filename) ) {
+	PyErr_Format(PyExc_EnvironmentError, "Could not write a trace to %s", filename);
+return( NULL );
+    }
+Py_RETURN_NONE;
+}
+
+static PyObject *PyFF_TraceStop(PyObject *UNUSED(self), PyObject *UNUSED(args)) {
+    if ( !TraceStop() ) {
+	PyErr_Format(PyExc_EnvironmentError, "Could not write the trace");
+return( NULL );
+    }
+Py_RETURN_NONE;
+}
+
+static PyObject *PyFF_ValidationTimes(PyObject *UNUSED(self), PyObject *UNUSED(args)) {
+    double times[vc_max];
+    PyObject *dict, *item;
+    int i;
+
+    SFValidationTimes(times);
+    dict = PyDict_New();
+    for ( i=0; i<vc_max; ++i ) {
+	item = PyFloat_FromDouble(times[i]);
+	PyDict_SetItemString(dict,validate_check_names[i],item);
+	Py_DECREF(item);
+    }
+return( dict );
+}
+
 static std::vector<PyObject*> closingFunctionList;
 
 static PyObject *PyFF_onAppClosing(PyObject *self, PyObject *args) {
@@ -14727,6 +14768,7 @@ static int PyFF_Font_set_mark_classes(PyFF_Font *self,PyObject *value, void *UNU
     if ( cnt==-1 )
         return (-1);
 
+    SFClearLookupClasses(sf);
     MarkClassFree(sf->mark_class_cnt,sf->mark_classes,sf->mark_class_names);
     sf->mark_class_cnt = cnt;
     sf->mark_classes = classes;
@@ -14759,6 +14801,7 @@ static int PyFF_Font_set_mark_sets(PyFF_Font *self,PyObject *value, void *UNUSED
     if ( cnt==-1 )
         return (-1);
 
+    SFClearLookupClasses(sf);
     MarkSetFree(sf->mark_set_cnt,sf->mark_sets,sf->mark_set_names);
     sf->mark_set_cnt = cnt;
     sf->mark_sets = sets;
@@ -17886,6 +17929,9 @@ struct flaglist gen_flags[] = {
     { "round", fm_flag_round },
     { "composites-in-afm", fm_flag_afmwithmarks },
     { "no-mac-names", fm_flag_nomacnames },
+    { "woff-fast", fm_flag_woff_fast },
+    { "woff-best", fm_flag_woff_best },
+    { "woff-exhaustive", fm_flag_woff_fast|fm_flag_woff_best },
     FLAGLIST_EMPTY /* Sentinel */
 };
 /* Generate TrueType Collection flags: see 'enum ttc_flags' in splinefont.h */
@@ -17896,6 +17942,7 @@ struct flaglist genttc_flags[] = {
 };
 
 static PyObject *PyFFFont_Generate(PyFF_Font *self, PyObject *args, PyObject *keywds) {
+    PyObject *filenameobj;
     char *filename;
     char *locfilename = NULL;
     FontViewBase *fv;
@@ -17912,12 +17959,12 @@ static PyObject *PyFFFont_Generate(PyFF_Font *self, PyObject *args, PyObject *ke
 return (NULL);
     fv = self->fv;
     layer = fv->active_layer;
-    if ( !PyArg_ParseTupleAndKeywords(args, keywds, "s|sOissi", (char **)gen_keywords,
-	    &filename, &bitmaptype, &flags, &resolution, &subfontdirectory,
+    if ( !PyArg_ParseTupleAndKeywords(args, keywds, "O|sOissi", (char **)gen_keywords,
+	    &filenameobj, &bitmaptype, &flags, &resolution, &subfontdirectory,
 	    &namelist, &layer) ) {
 	PyErr_Clear();
-	if ( !PyArg_ParseTupleAndKeywords(args, keywds, "s|sOisss", (char **)gen_keywords,
-		&filename, &bitmaptype, &flags, &resolution, &subfontdirectory,
+	if ( !PyArg_ParseTupleAndKeywords(args, keywds, "O|sOisss", (char **)gen_keywords,
+		&filenameobj, &bitmaptype, &flags, &resolution, &subfontdirectory,
 		&namelist, &layer_str) )
 return( NULL );
 	layer = SFFindLayerIndexByName(fv->sf,layer_str);
@@ -17952,6 +17999,43 @@ return( NULL );
 return( NULL );
 	}
     }
+    if ( !PyUnicode_Check(filenameobj) ) {
+	/* Several files, in whatever formats their extensions say */
+	PyObject *seq = PySequence_Fast(filenameobj, "Filename must be a string or a sequence of strings");
+	int i, cnt, ret;
+	char **filenames;
+	if ( seq==NULL )
+return( NULL );
+	if ( subfontdirectory!=NULL ) {
+	    Py_DECREF(seq);
+	    PyErr_Format(PyExc_ValueError, "A subfont_directory can only be used with one filename");
+return( NULL );
+	}
+	cnt = PySequence_Fast_GET_SIZE(seq);
+	filenames = (char **) calloc(cnt+1,sizeof(char *));
+	for ( i=0; i<cnt; ++i ) {
+	    filename = (char *) PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq,i));
+	    if ( filename==NULL )
+	break;
+	    filenames[i] = utf82def_copy(filename);
+	}
+	Py_DECREF(seq);
+	ret = i==cnt && GenerateScriptTargets(fv->sf,filenames,bitmaptype,iflags,resolution,
+		fv->normal==NULL?fv->map:fv->normal,rename_to,layer);
+	for ( i=0; i<cnt; ++i )
+	    free(filenames[i]);
+	free(filenames);
+	if ( PyErr_Occurred() )
+return( NULL );
+	if ( !ret ) {
+	    PyErr_Format(PyExc_EnvironmentError, "Font generation failed");
+return( NULL );
+	}
+Py_RETURN( self );
+    }
+    filename = (char *) PyUnicode_AsUTF8(filenameobj);
+    if ( filename==NULL )
+return( NULL );
     locfilename = utf82def_copy(filename);
     if ( !GenerateScript(fv->sf,locfilename,bitmaptype,iflags,resolution,subfontdirectory,
 	    NULL,fv->normal==NULL?fv->map:fv->normal,rename_to,layer) ) {
@@ -19398,18 +19482,98 @@ static PyObject *PyFFFont_correctReferences(PyFF_Font *self, PyObject *UNUSED(ar
 Py_RETURN( self );
 }
 
-static PyObject *PyFFFont_validate(PyFF_Font *self, PyObject *args) {
+static const char *validate_keywords[] = { "force", "cache", NULL };
+
+static PyObject *PyFFFont_validate(PyFF_Font *self, PyObject *args, PyObject *keywds) {
     FontViewBase *fv;
     SplineFont *sf;
     int force=false;
+    char *cache=NULL;
 
     if ( CheckIfFontClosed(self) )
 return (NULL);
     fv = self->fv;
     sf = fv->sf;
-    if ( !PyArg_ParseTuple(args,"|i",&force) )
+    if ( !PyArg_ParseTupleAndKeywords(args,keywds,"|iz",(char **)validate_keywords,&force,&cache) )
 return( NULL );
-return( Py_BuildValue("i", SFValidate(sf,fv->active_layer,force)));
+return( Py_BuildValue("i", SFValidateCached(sf,fv->active_layer,force,cache)));
+}
+
+static PyObject *PyFFFont_memoryUsage(PyFF_Font *self, PyObject *UNUSED(args)) {
+    struct fontmemory fm;
+    PyObject *dict, *item;
+    int i;
+
+    if ( CheckIfFontClosed(self) )
+return (NULL);
+    SFMemoryUsage(self->fv->sf,&fm);
+    if ( (dict = PyDict_New())==NULL )
+return( NULL );
+    for ( i=0; i<fm_max; ++i ) {
+	item = Py_BuildValue("(nn)",(Py_ssize_t) fm.bytes[i],(Py_ssize_t) fm.count[i]);
+	if ( item==NULL || PyDict_SetItemString(dict,fontmemory_names[i],item)!=0 ) {
+	    Py_XDECREF(item);
+	    Py_DECREF(dict);
+return( NULL );
+	}
+	Py_DECREF(item);
+    }
+return( dict );
+}
+
+static const char *convertToQuadratic_keywords[] = { "tolerance", "masters", NULL };
+
+static PyObject *PyFFFont_convertToQuadratic(PyFF_Font *self, PyObject *args, PyObject *keywds) {
+    double tol = -1;
+    PyObject *masters = NULL, *item;
+    SplineFont **sfs;
+    int i, cnt;
+
+    if ( CheckIfFontClosed(self) )
+return (NULL);
+    if ( !PyArg_ParseTupleAndKeywords(args,keywds,"|dO",(char **)convertToQuadratic_keywords,&tol,&masters) )
+return( NULL );
+    cnt = 1;
+    if ( masters!=NULL && masters!=Py_None ) {
+	if ( !PySequence_Check(masters) ) {
+	    PyErr_Format(PyExc_TypeError,"masters must be a sequence of fonts");
+return( NULL );
+	}
+	cnt += PySequence_Size(masters);
+    }
+    sfs = (SplineFont **) malloc(cnt*sizeof(SplineFont *));
+    sfs[0] = self->fv->sf;
+    for ( i=1; i<cnt; ++i ) {
+	item = PySequence_GetItem(masters,i-1);
+	if ( item==NULL || !PyType_IsSubtype(&PyFF_FontType, Py_TYPE(item)) ) {
+	    Py_XDECREF(item);
+	    free(sfs);
+	    PyErr_Format(PyExc_TypeError,"masters must be a sequence of fonts");
+return( NULL );
+	}
+	Py_DECREF(item);
+	if ( CheckIfFontClosed((PyFF_Font *) item) ) {
+	    free(sfs);
+return( NULL );
+	}
+	sfs[i] = ((PyFF_Font *) item)->fv->sf;
+    }
+    for ( i=0; i<cnt; ++i ) {
+	if ( sfs[i]->subfontcnt!=0 || sfs[i]->cidmaster!=NULL ) {
+	    free(sfs);
+	    PyErr_Format(PyExc_TypeError,"convertToQuadratic doesn't handle CID-keyed fonts, set is_quadratic instead");
+return( NULL );
+	}
+    }
+    if ( tol<0 )
+	tol = QuadraticTolerance;
+    if ( cnt>1 && tol<=0 )
+	tol = 1;		/* The older conversion can't keep masters compatible */
+    for ( i=0; i<cnt; ++i )
+	SFCloseAllInstrs(sfs[i]);
+    SFsConvertToOrder2(sfs,cnt,tol);
+    free(sfs);
+Py_RETURN( self );
 }
 
 static PyObject *PyFFFont_reencode(PyFF_Font *self, PyObject *args) {
@@ -19446,6 +19610,7 @@ PyMethodDef PyFF_Font_methods[] = {
     { "appendSFNTName", (PyCFunction) PyFFFont_appendSFNTName, METH_VARARGS, "Adds or replaces a name in the sfnt 'name' table. Takes three arguments, a language, a string id, and the string value" },
     { "close", (PyCFunction) PyFFFont_close, METH_NOARGS, "Frees up memory for the current font. Any python pointers to it will become invalid." },
     { "compareFonts", (PyCFunction) PyFFFont_compareFonts, METH_VARARGS, "Compares two fonts and stores the result into a file"},
+    { "convertToQuadratic", (PyCFunction) PyFFFont_convertToQuadratic, METH_VARARGS | METH_KEYWORDS, "Converts the font, and optionally other masters of the same design, to quadratic splines within a tolerance"},
     { "save", (PyCFunction) PyFFFont_Save, METH_VARARGS, "Save the current font to a sfd file" },
     { "generate", (PyCFunction) PyFFFont_Generate, METH_VARARGS | METH_KEYWORDS, "Save the current font to a standard font file" },
     { "generateTtc", (PyCFunction) PyFFFont_GenerateTTC, METH_VARARGS | METH_KEYWORDS, "Save the current font and some others into a truetype collection file" },
@@ -19538,7 +19703,8 @@ PyMethodDef PyFF_Font_methods[] = {
     { "stroke", (PyCFunction)PyFFFont_Stroke, METH_VARARGS | METH_KEYWORDS, "Strokes the contours in a glyph"},
     { "transform", (PyCFunction)PyFFFont_Transform, METH_VARARGS, "Transform a font by a 6 element matrix." },
     { "nltransform", (PyCFunction)PyFFFont_NLTransform, METH_VARARGS, "Transform a font by non-linear expressions for x and y." },
-    { "validate", (PyCFunction)PyFFFont_validate, METH_VARARGS, "Check whether a font is valid and return True if it is." },
+    { "validate", (PyCFunction)PyFFFont_validate, METH_VARARGS | METH_KEYWORDS, "Check whether a font is valid and return True if it is." },
+    { "memoryUsage", (PyCFunction)PyFFFont_memoryUsage, METH_NOARGS, "Returns a dictionary of roughly how many bytes, and how many things, each part of the font takes" },
     { "reencode", (PyCFunction)PyFFFont_reencode, METH_VARARGS, "Reencodes the current font into the given encoding." },
     { "clearSpecialData", (PyCFunction)PyFFFont_clearSpecialData, METH_NOARGS, "Clear special data not accessible in FontForge." },
     { "__enter__", (PyCFunction) PyFFFont_enter, METH_NOARGS, "Empty function declaring the entry into context statement." },
@@ -20177,6 +20343,10 @@ PyMethodDef module_fontforge_methods[] = {
     { "loadPrefs", PyFF_LoadPrefs, METH_NOARGS, "Load FontForge preference items" },
     { "hasSpiro", PyFF_hasSpiro, METH_NOARGS, "Returns whether this fontforge has access to Raph Levien's spiro package"},
     { "SpiroVersion", PyFF_SpiroVersion, METH_NOARGS, "Return Spiro Library Version" },
+    { "undoMemory", PyFF_UndoMemory, METH_NOARGS, "Returns roughly how many bytes the undoes of all glyphs take" },
+    { "traceStart", PyFF_TraceStart, METH_VARARGS, "Starts recording how long each stage of generating fonts takes, to be written to a file in Chrome's trace format" },
+    { "traceStop", PyFF_TraceStop, METH_NOARGS, "Stops recording and writes the trace" },
+    { "validationTimes", PyFF_ValidationTimes, METH_NOARGS, "Returns a dictionary of how long each check took in the last font validation" },
     { "onAppClosing", PyFF_onAppClosing, METH_VARARGS, "add a python function which is called when fontforge is closing down"},
     { "defaultOtherSubrs", PyFF_DefaultOtherSubrs, METH_NOARGS, "Use FontForge's default \"othersubrs\" functions for Type1 fonts" },
     { "readOtherSubrsFile", PyFF_ReadOtherSubrsFile, METH_VARARGS, "Read from a file, \"othersubrs\" functions for Type1 fonts" },
@@ -20853,6 +21023,50 @@ void FontForge_InitializeEmbeddedPython() {
 
 static wchar_t ** copy_argv(char *arg0, int argc ,char **argv);
 
+/* Run a script in an interpreter which is already going (and which has */
+/*  already run the init files), as a script server's workers do. Sets up */
+/*  sys.argv and sys.path[0] as "python script args" or "python -c command */
+/*  args" would have */
+static void PyFF_RunInitialized(int argc,char **argv) {
+    PyObject *args, *path;
+    char *dir, *abs;
+    FILE *fp;
+    int i, is_cmd, rc;
+
+    if ( argc<1 ) {
+	PyFF_Stdin(false,false);
+	return;
+    }
+    is_cmd = strcmp(argv[0],"-c")==0 && argc>=2;
+    args = PyList_New(0);
+    PyList_Append(args,PyUnicode_DecodeFSDefault(argv[0]));
+    for ( i=is_cmd ? 2 : 1; i<argc; ++i )
+	PyList_Append(args,PyUnicode_DecodeFSDefault(argv[i]));
+    PySys_SetObject("argv",args);
+    Py_DECREF(args);
+
+    if ( is_cmd )
+	rc = PyRun_SimpleString(argv[1]);
+    else {
+	fp = fopen(argv[0],"rb");
+	if ( fp==NULL ) {
+	    fprintf(stderr,"fontforge: can't open file '%s': %s\n", argv[0], strerror(errno));
+	    exit(2);
+	}
+	abs = GFileGetAbsoluteName(argv[0]);
+	dir = GFileDirName(abs);
+	if ( strlen(dir)>1 )
+	    dir[strlen(dir)-1] = '\0';
+	path = PySys_GetObject("path");
+	if ( path!=NULL )
+	    PyList_Insert(path,0,PyUnicode_DecodeFSDefault(dir));
+	free(dir); free(abs);
+	rc = PyRun_SimpleFileExFlags(fp,argv[0],1,NULL);
+    }
+    FontForge_FinalizeEmbeddedPython();
+    exit(rc==0 ? 0 : 1);
+}
+
 /* PyFF_Main() -- This is called to run a script as the main task, by
  * running the command:   fontforge -script somescript.py arg1 arg2 ...
  *
@@ -20877,6 +21091,9 @@ void PyFF_Main(int argc,char **argv,int start, int do_inits,
     if ( strcmp(arg,"-script")==0 )
 	++start;
 
+    if ( python_initialized )
+	PyFF_RunInitialized(argc-start,&argv[start]);
+
     /* Make new argv array */
     newargc = argc - start + 1;
     newargv = copy_argv(argv[0], newargc-1, &argv[start] );
@@ -20958,6 +21175,23 @@ static void AddSpiroConstants( PyObject *module ) {
 }
 
 
+#if !defined(__MINGW32__) && !defined(_MSC_VER)
+/* Fork, leaving the interpreter usable in both processes */
+int PyFF_Fork(void) {
+    pid_t pid;
+
+    if ( !python_initialized )
+	return fork();
+    PyOS_BeforeFork();
+    pid = fork();
+    if ( pid==0 )
+	PyOS_AfterFork_Child();
+    else
+	PyOS_AfterFork_Parent();
+    return pid;
+}
+#endif
+
 void PyFF_Stdin(int do_inits, int do_plugins) {
     no_windowing_ui = running_script = true;
 
@@ -21039,6 +21273,46 @@ extern void PyFF_FreePythonPersistent(void *python_persistent) {
     Py_XDECREF((PyObject *)python_persistent);
 }
 
+/* sys.getsizeof of an object, and of what it holds if it is a dictionary, */
+/*  list or tuple (which is all pickled persistent data usually is) */
+static size_t PyFF_ObjectBytes(PyObject *obj, PyObject *getsizeof, int depth) {
+    PyObject *size, *key, *value, *seq;
+    Py_ssize_t pos = 0, i;
+    size_t bytes = 0;
+
+    if ( (size = PyObject_CallFunctionObjArgs(getsizeof,obj,NULL))!=NULL ) {
+	bytes = PyLong_AsSize_t(size);
+	Py_DECREF(size);
+    }
+    if ( PyErr_Occurred() ) {
+	PyErr_Clear();
+	bytes = 0;
+    }
+    if ( depth>=32 )		/* Anything this deep is probably a loop */
+return( bytes );
+    if ( PyDict_Check(obj) ) {
+	while ( PyDict_Next(obj,&pos,&key,&value) )
+	    bytes += PyFF_ObjectBytes(key,getsizeof,depth+1) +
+		    PyFF_ObjectBytes(value,getsizeof,depth+1);
+    } else if ( PyList_Check(obj) || PyTuple_Check(obj) ) {
+	seq = PySequence_Fast(obj,"");
+	for ( i=0; seq!=NULL && i<PySequence_Fast_GET_SIZE(seq); ++i )
+	    bytes += PyFF_ObjectBytes(PySequence_Fast_GET_ITEM(seq,i),getsizeof,depth+1);
+	Py_XDECREF(seq);
+    }
+return( bytes );
+}
+
+size_t PyFF_PersistentBytes(void *python_persistent) {
+    PyObject *getsizeof;
+
+    if ( !Py_IsInitialized() || python_persistent==NULL )
+return( 0 );
+    if ( (getsizeof = PySys_GetObject("getsizeof"))==NULL )	/* Borrowed */
+return( 0 );
+return( PyFF_ObjectBytes((PyObject *) python_persistent,getsizeof,0) );
+}
+
 static void LoadFilesInPythonInitDir(char *dir) {
     FF_Dir *diro;
     FF_DirEntry *ent;
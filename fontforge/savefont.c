@@ -46,6 +46,7 @@
 #include "splineutil.h"
 #include "svg.h"
 #include "tottf.h"
+#include "trace.h"
 #include "ustring.h"
 #include "utype.h"
 #include "winfonts.h"
@@ -810,6 +811,7 @@ return( WriteMultiplePSFont(sf,newname,sizes,subfontdefinition,map,layer));
     if ( oldformatstate<=ff_cffcid && oldbitmapstate==bf_otb )
 	flags = old_psotb_flags;
 
+    TRACE_BEGIN("DoSave");
     path = def2utf8_copy(newname);
     ff_progress_start_indicator(10,_("Saving font"),
 		oldformatstate==ff_ttf || oldformatstate==ff_ttfsym ||
@@ -835,8 +837,10 @@ return( WriteMultiplePSFont(sf,newname,sizes,subfontdefinition,map,layer));
 	  case ff_pfa: case ff_pfb: case ff_ptype3: case ff_ptype0:
 	  case ff_cid:
 	  case ff_type42: case ff_type42cid:
-	    if ( sf->multilayer && CheckIfTransparent(sf))
+	    if ( sf->multilayer && CheckIfTransparent(sf)) {
+		TRACE_END("DoSave");
 return( true );
+	    }
 	    oerr = !WritePSFont(newname,sf,oldformatstate,flags,map,NULL,layer);
 	  break;
 	  case ff_ttf: case ff_ttfsym: case ff_otf: case ff_otfcid:
@@ -962,6 +966,7 @@ return( true );
     ff_progress_end_indicator();
     if ( !err )
 	SavePrefs(true);
+    TRACE_END("DoSave");
 return( err );
 }
 
@@ -1084,19 +1089,16 @@ int fmflag2ttfflag(int fmflags, bool is_postscript_or_cff) {
     if ( fmflags&fm_flag_nomacnames ) ttfflags |= ttf_flag_nomacnames;
     return ttfflags;
 }
-int GenerateScript(SplineFont *sf,char *filename,const char *bitmaptype, int fmflags,
-	int res, char *subfontdefinition, struct sflist *sfs,EncMap *map,
-	NameList *rename_to,int layer) {
+/* Works out the format (and flags) a file should be generated in from its */
+/*  name and the flags given, setting oldformatstate and friends. Returns */
+/*  the name to use, which will be in *freeme if it had to be changed */
+static char *GenerateFormatState(SplineFont *sf,char *filename,const char *bitmaptype,
+	int fmflags,char **freeme) {
     int i;
     static const char *bitmaps[] = {"bdf", "ttf", "dfont", "ttf", "otb", "bin", "fon", "fnt", "pdb", "pt3", NULL };
-    int32_t *sizes=NULL;
     char *end = filename+strlen(filename);
-    struct sflist *sfi;
-    char *freeme = NULL;
-    int ret;
-    struct sflist *sfl;
-    char **former;
 
+    *freeme = NULL;
     if ( sf->bitmaps==NULL ) i = bf_none;
     else if ( strmatch(bitmaptype,"otf")==0 ) i = bf_ttf;
     else if ( strmatch(bitmaptype,"ms")==0 ) i = bf_ttf;
@@ -1165,17 +1167,17 @@ int GenerateScript(SplineFont *sf,char *filename,const char *bitmaptype, int fmf
 
     if ( oldformatstate==ff_none && end[-1]=='.' &&
 	    (oldbitmapstate==bf_ttf || oldbitmapstate==bf_sfnt_dfont || oldbitmapstate==bf_otb)) {
-	freeme = malloc(strlen(filename)+8);
-	strcpy(freeme,filename);
+	*freeme = malloc(strlen(filename)+8);
+	strcpy(*freeme,filename);
 	if ( strmatch(bitmaptype,"otf")==0 )
-	    strcat(freeme,"otf");
+	    strcat(*freeme,"otf");
 	else if ( oldbitmapstate==bf_otb )
-	    strcat(freeme,"otb");
+	    strcat(*freeme,"otb");
 	else if ( oldbitmapstate==bf_sfnt_dfont )
-	    strcat(freeme,"dfont");
+	    strcat(*freeme,"dfont");
 	else
-	    strcat(freeme,"ttf");
-	filename = freeme;
+	    strcat(*freeme,"ttf");
+	filename = *freeme;
     } else if ( sf->onlybitmaps && sf->bitmaps!=NULL &&
 	    (oldformatstate==ff_ttf || oldformatstate==ff_otf) &&
 	    (oldbitmapstate == bf_none || oldbitmapstate==bf_ttf ||
@@ -1208,8 +1210,29 @@ int GenerateScript(SplineFont *sf,char *filename,const char *bitmaptype, int fmf
 	} else {
 	    old_sfnt_flags = fmflag2ttfflag(fmflags, false);
 	}
+	switch ( fmflags&(fm_flag_woff_fast|fm_flag_woff_best) ) {
+	  case fm_flag_woff_fast: woff_effort = woff_effort_fast; break;
+	  case fm_flag_woff_best: woff_effort = woff_effort_best; break;
+	  case fm_flag_woff_fast|fm_flag_woff_best: woff_effort = woff_effort_exhaustive; break;
+	  default: woff_effort = woff_effort_default; break;
+	}
     }
 
+return( filename );
+}
+
+int GenerateScript(SplineFont *sf,char *filename,const char *bitmaptype, int fmflags,
+	int res, char *subfontdefinition, struct sflist *sfs,EncMap *map,
+	NameList *rename_to,int layer) {
+    int32_t *sizes=NULL;
+    struct sflist *sfi;
+    char *freeme = NULL;
+    int ret;
+    struct sflist *sfl;
+    char **former;
+
+    filename = GenerateFormatState(sf,filename,bitmaptype,fmflags,&freeme);
+
     if ( oldbitmapstate!=bf_none ) {
 	if ( sfs!=NULL ) {
 	    for ( sfi=sfs; sfi!=NULL; sfi=sfi->next )
@@ -1241,7 +1264,6 @@ int GenerateScript(SplineFont *sf,char *filename,const char *bitmaptype, int fmf
     } else {
 	ret = !_DoSave(sf,filename,sizes,res,map,subfontdefinition,layer);
     }
-    free(freeme);
 
     if ( sfs!=NULL ) {
 	for ( sfl=sfs; sfl!=NULL; sfl=sfl->next ) {
@@ -1261,5 +1283,40 @@ int GenerateScript(SplineFont *sf,char *filename,const char *bitmaptype, int fmf
 		free(sfi->sizes);
 	}
     }
+    free(freeme);
+return( ret );
+}
+
+/* Generates the font in each of the (NULL terminated) filenames, choosing */
+/*  formats from their extensions as GenerateScript does. Glyphs are only */
+/*  unlinked, have their overlap removed and are renamed once, and each */
+/*  flavour of sfnt is only compiled once however many of the ttf/otf/woff/ */
+/*  woff2 files want it */
+int GenerateScriptTargets(SplineFont *sf,char **filenames,const char *bitmaptype,
+	int fmflags, int res, EncMap *map, NameList *rename_to,int layer) {
+    int32_t *sizes;
+    char *freeme, *filename;
+    char **former = NULL;
+    int i, ret = true;
+
+    if ( filenames[0]==NULL )
+return( true );
+
+    PrepareUnlinkRmOvrlp(sf,filenames[0],layer);
+    if ( rename_to!=NULL )
+	former = SFTemporaryRenameGlyphsToNamelist(sf,rename_to);
+    SFNTCacheBegin();
+
+    for ( i=0; ret && filenames[i]!=NULL; ++i ) {
+	filename = GenerateFormatState(sf,filenames[i],bitmaptype,fmflags,&freeme);
+	sizes = oldbitmapstate!=bf_none ? AllBitmapSizes(sf) : NULL;
+	ret = !_DoSave(sf,filename,sizes,res,map,NULL,layer);	/* Frees sizes */
+	free(freeme);
+    }
+
+    SFNTCacheEnd();
+    RestoreUnlinkRmOvrlp(sf,filenames[0],layer);
+    if ( rename_to!=NULL )
+	SFTemporaryRestoreGlyphNames(sf,former);
 return( ret );
 }
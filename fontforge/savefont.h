@@ -64,6 +64,8 @@ enum fm_flags { fm_flag_afm = 0x1,
                 fm_flag_pfed_layers = 0x2000000,
                 fm_flag_winkern = 0x4000000,
                 fm_flag_nomacnames = 0x8000000,
+                fm_flag_woff_fast = 0x10000000,
+                fm_flag_woff_best = 0x20000000,	/* Both: woff_effort_exhaustive */
               };
 
 extern const char (*savefont_extensions[]), (*bitmapextensions[]);
@@ -77,6 +79,7 @@ int CheckIfTransparent(SplineFont *sf);
 
 int fmflag2ttfflag(int fmflags, bool is_postscript_or_cff);
 extern int GenerateScript(SplineFont *sf, char *filename, const char *bitmaptype, int fmflags, int res, char *subfontdirectory, struct sflist *sfs, EncMap *map, NameList *rename_to, int layer);
+extern int GenerateScriptTargets(SplineFont *sf, char **filenames, const char *bitmaptype, int fmflags, int res, EncMap *map, NameList *rename_to, int layer);
 
 #ifdef FONTFORGE_CONFIG_WRITE_PFM
 extern int WritePfmFile(char *filename, SplineFont *sf, EncMap *map, int layer);
@@ -47,6 +47,7 @@
 #include "ffglib_compat.h"
 #include "flaglist.h"
 #include "fontforge.h"
+#include "fontmemory.h"
 #include "fvcomposite.h"
 #include "fvfonts.h"
 #include "fvimportbdf.h"
@@ -67,6 +68,7 @@
 #include "print.h"
 #include "savefont.h"
 #include "scriptfuncs.h"
+#include "scriptserver.h"
 #include "scstyles.h"
 #include "search.h"
 #include "sfd.h"
@@ -85,6 +87,7 @@
 #include "ustring.h"
 #include "utype.h"
 
+#include <limits.h>
 #include <locale.h>
 #include <math.h>
 #include <setjmp.h>
@@ -6534,6 +6537,7 @@ static void bMMChangeInstance(Context *c) {
 	}
     } else
 	ScriptError( c, "Bad argument" );
+    SFMaterializeMM(c->curfv->sf);
 }
 
 static void Reblend(Context *c, int tonew) {
@@ -7778,7 +7782,7 @@ return;
 		    c->return_val.u.ival = kp->off;
 		else {
 		    for ( kc = sf->kerns; kc!=NULL; kc=kc->next ) {
-			if (( c->return_val.u.ival = KernClassContains(kc,sc->name,sf->glyphs[gid2]->name,true))!=0 )
+			if (( c->return_val.u.ival = KernClassPairOffset(sf,kc,sc,sf->glyphs[gid2]))!=0 )
 		    break;
 		    }
 		}
@@ -7791,7 +7795,7 @@ return;
 		    c->return_val.u.ival = kp->off;
 		else {
 		    for ( kc = sf->vkerns; kc!=NULL; kc=kc->next ) {
-			if (( c->return_val.u.ival = KernClassContains(kc,sc->name,sf->glyphs[gid2]->name,true))!=0 )
+			if (( c->return_val.u.ival = KernClassPairOffset(sf,kc,sc,sf->glyphs[gid2]))!=0 )
 		    break;
 		    }
 		}
@@ -8285,19 +8289,55 @@ static void bCompareFonts(Context *c) {
 
 static void bValidate(Context *c) {
     int force = false;
+    char *t, *cache = NULL;
 
-    if ( c->a.argc>2 ) {
+    if ( c->a.argc>3 ) {
 	c->error = ce_wrongnumarg;
 	return;
     }
-    if ( c->a.argc==2 ) {
+    if ( c->a.argc>=2 ) {
 	if ( c->a.vals[1].type!=v_int )
 	    ScriptError( c, "Bad type for argument");
 	force = c->a.vals[1].u.ival;
     }
+    if ( c->a.argc==3 ) {
+	if ( c->a.vals[2].type!=v_str )
+	    ScriptError( c, "Bad type for argument");
+	t = script2utf8_copy(c->a.vals[2].u.sval);
+	cache = utf82def_copy(t);
+	free(t);
+    }
 
     c->return_val.type = v_int;
-    c->return_val.u.ival = SFValidate(c->curfv->sf, ly_fore, force );
+    c->return_val.u.ival = SFValidateCached(c->curfv->sf, ly_fore, force, cache );
+    free(cache);
+}
+
+static void bMemoryUsage(Context *c) {
+    struct fontmemory fm;
+    Array *ret, *temp;
+    int i;
+
+    SFMemoryUsage(c->curfv->sf,&fm);
+    ret = arraynew(fm_max);
+    for ( i=0; i<fm_max; ++i ) {
+	ret->vals[i].type = v_arr;
+	ret->vals[i].u.aval = temp = arraynew(3);
+	temp->vals[0].type = v_str;
+	temp->vals[0].u.sval = copy(fontmemory_names[i]);
+	/* Fonts can take more than 2G, then the bytes are a real */
+	if ( fm.bytes[i]<=INT_MAX ) {
+	    temp->vals[1].type = v_int;
+	    temp->vals[1].u.ival = fm.bytes[i];
+	} else {
+	    temp->vals[1].type = v_real;
+	    temp->vals[1].u.fval = fm.bytes[i];
+	}
+	temp->vals[2].type = v_int;
+	temp->vals[2].u.ival = fm.count[i];
+    }
+    c->return_val.type = v_arrfree;
+    c->return_val.u.aval = ret;
 }
 
 /* #define _DEBUGCRASHFONTFORGE 1 */
@@ -8698,6 +8738,7 @@ static struct builtins {
     { "CompareGlyphs", bCompareGlyphs, 0,0,0 },
     { "CompareFonts", bCompareFonts, 0,4,0 },
     { "Validate", bValidate, 0,0,0 },
+    { "MemoryUsage", bMemoryUsage, 0,1,0 },
     { "DebugCrashFontForge", bDebugCrashFontForge, 1,0,0 },
     { "ClearSpecialData", bclearSpecialData, 0,1,0 },
     { NULL, 0, 0,0,0 }
@@ -10454,11 +10495,14 @@ static void _CheckIsScript(int argc, char *argv[]) {
 
     if ( argc==1 )
 return;
+    ScriptServerForward(argc,argv);	/* Exits if a server ran the script */
     for ( i=1; i<argc; ++i ) {
 	pt = argv[i];
 	if ( *pt=='-' && pt[1]=='-' && pt[2]!='\0' ) ++pt;
 	if ( strcmp(pt,"-nosplash")==0 || strcmp(pt,"-quiet")==0 )
 	    /* Skip it */;
+	else if ( strcmp(pt,"-server")==0 && i+1<argc )
+	    ScriptServerRun(argv[i+1],run_python_init_files,import_python_plugins);
 	else if ( strcmp(pt,"-SkipPythonInitFiles")==0 || strcmp(pt,"-skippyfile")==0 )
 	    run_python_init_files = false;
 	else if ( strcmp(pt,"-skippyplug")==0 )
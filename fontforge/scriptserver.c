@@ -0,0 +1,755 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE		/* For struct ucred */
+#endif
+
+#include <fontforge-config.h>
+
+#include "scriptserver.h"
+
+#include "fontforge.h"
+#include "scripting.h"
+#include "splinefont.h"
+#include "splineutil.h"
+#include "ustring.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if !defined(__MINGW32__) && !defined(_MSC_VER)
+# include <arpa/inet.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <pthread.h>
+# include <signal.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <sys/wait.h>
+# include <unistd.h>
+
+/* A font the server has read for its scripts. It is only handed out if */
+/*  the file still looks the same (same modification time and size) as */
+/*  when it was read */
+struct servedfont {
+    char *path;
+    int openflags;
+    struct stat stamp;
+    SplineFont *sf;
+    unsigned int used;		/* For dropping the least recently used */
+};
+
+/* A script being run in a fork of the server */
+struct worker {
+    pid_t pid;
+    int client;		/* Waits for the exit status */
+    int report;		/* The worker writes the names of the fonts it opens here */
+    char *opened;
+    int olen, omax;
+};
+
+/* A font a script opened, waiting for the loader thread to read it */
+struct pendingfont {
+    char *path;
+    int openflags;
+};
+
+/* The server's own thread only forks workers, it never reads fonts, so */
+/*  that it is always ready to accept. Fonts are read by a loader thread */
+/*  which only changes served[] with served_lock held. The lock is also */
+/*  held across fork, so a worker never sees served[] half changed */
+static struct servedfont *served;
+static int served_cnt, served_max;
+static unsigned int served_clock;
+static struct pendingfont *pending;
+static int pending_cnt, pending_max;
+static int loader_stop = false;
+static pthread_mutex_t served_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t loader_wake = PTHREAD_COND_INITIALIZER;
+static int in_server = false;		/* Don't forward scripts to ourselves */
+static int report_fd = -1;		/* Only set in a worker */
+static volatile sig_atomic_t server_stop = false;
+static int child_pipe[2] = { -1, -1 };	/* Wakes the server when a worker exits */
+
+static int SameStamp(struct stat *a, struct stat *b) {
+#ifdef __APPLE__
+    if ( a->st_mtimespec.tv_nsec!=b->st_mtimespec.tv_nsec )
+return( false );
+#else
+    if ( a->st_mtim.tv_nsec!=b->st_mtim.tv_nsec )
+return( false );
+#endif
+return( a->st_mtime==b->st_mtime && a->st_size==b->st_size &&
+	a->st_ino==b->st_ino && a->st_dev==b->st_dev );
+}
+
+static int WriteAll(int fd, const void *buf, size_t len) {
+    const char *pt = buf;
+    ssize_t n;
+
+    while ( len>0 ) {
+	n = write(fd,pt,len);
+	if ( n<0 && errno==EINTR )
+    continue;
+	if ( n<=0 )
+return( false );
+	pt += n; len -= n;
+    }
+return( true );
+}
+
+static int ReadAll(int fd, void *buf, size_t len) {
+    char *pt = buf;
+    ssize_t n;
+
+    while ( len>0 ) {
+	n = read(fd,pt,len);
+	if ( n<0 && errno==EINTR )
+    continue;
+	if ( n<=0 )
+return( false );
+	pt += n; len -= n;
+    }
+return( true );
+}
+
+SplineFont *ScriptServerFont(const char *filename, enum openflags openflags) {
+    struct stat st;
+    SplineFont *sf;
+    char *line;
+    int i;
+
+    if ( report_fd<0 || strchr(filename,'\n')!=NULL )
+return( NULL );
+    /* Whether we have it or not, the server should keep it for next time */
+    line = smprintf("%d %s\n", (int) openflags, filename);
+    WriteAll(report_fd,line,strlen(line));
+    free(line);
+
+    if ( stat(filename,&st)!=0 )
+return( NULL );
+    for ( i=0; i<served_cnt; ++i ) {
+	if ( served[i].sf!=NULL && served[i].openflags==(int) openflags &&
+		strcmp(served[i].path,filename)==0 &&
+		SameStamp(&served[i].stamp,&st) ) {
+	    /* The script owns it now, it may change it or close it. It is */
+	    /*  our own copy of the server's font, so that's fine */
+	    sf = served[i].sf;
+	    served[i].sf = NULL;
+return( sf );
+	}
+    }
+return( NULL );
+}
+
+static void ServedFree(struct servedfont *sv) {
+    if ( sv->sf!=NULL )
+	SplineFontFree(sv->sf);
+    free(sv->path);
+    memset(sv,0,sizeof(*sv));
+}
+
+/* Runs on the loader thread */
+static void ServerKeepFont(const char *path, int openflags) {
+    struct stat st;
+    struct servedfont *sv;
+    SplineFont *sf;
+    int i, lru;
+
+    if ( stat(path,&st)!=0 )
+return;
+    /* Only this thread changes served[], so i stays good while unlocked */
+    pthread_mutex_lock(&served_lock);
+    for ( i=0; i<served_cnt; ++i )
+	if ( served[i].openflags==openflags && strcmp(served[i].path,path)==0 )
+    break;
+    if ( i<served_cnt ) {
+	served[i].used = ++served_clock;
+	if ( served[i].sf!=NULL && SameStamp(&served[i].stamp,&st) ) {
+	    pthread_mutex_unlock(&served_lock);
+return;
+	}
+    }
+    pthread_mutex_unlock(&served_lock);
+
+    sf = ReadSplineFont(path,openflags);
+
+    pthread_mutex_lock(&served_lock);
+    if ( i<served_cnt ) {
+	sv = &served[i];
+	if ( sv->sf!=NULL )
+	    SplineFontFree(sv->sf);
+	sv->sf = NULL;
+    } else if ( sf==NULL ) {
+	pthread_mutex_unlock(&served_lock);
+return;
+    } else {
+	if ( served_cnt<served_max )
+	    sv = &served[served_cnt++];
+	else {
+	    for ( i=lru=0; i<served_cnt; ++i )
+		if ( served[i].used<served[lru].used )
+		    lru = i;
+	    sv = &served[lru];
+	    ServedFree(sv);
+	}
+	sv->path = copy(path);
+	sv->openflags = openflags;
+	sv->used = ++served_clock;
+    }
+    /* Stat'ed before reading, so if the file changed meanwhile this copy */
+    /*  won't be handed out */
+    sv->stamp = st;
+    sv->sf = sf;
+    if ( sv->sf==NULL ) {
+	ServedFree(sv);
+	*sv = served[--served_cnt];
+	memset(&served[served_cnt],0,sizeof(served[0]));
+    }
+    pthread_mutex_unlock(&served_lock);
+}
+
+static void *ServerLoader(void *unused) {
+    struct pendingfont pf;
+
+    (void) unused;
+    pthread_mutex_lock(&served_lock);
+    for (;;) {
+	while ( pending_cnt==0 && !loader_stop )
+	    pthread_cond_wait(&loader_wake,&served_lock);
+	if ( loader_stop )
+    break;
+	pf = pending[0];
+	memmove(pending,pending+1,(--pending_cnt)*sizeof(struct pendingfont));
+	pthread_mutex_unlock(&served_lock);
+	ServerKeepFont(pf.path,pf.openflags);
+	free(pf.path);
+	pthread_mutex_lock(&served_lock);
+    }
+    pthread_mutex_unlock(&served_lock);
+return( NULL );
+}
+
+/* Runs on the server's thread */
+static void ServerQueueFont(const char *path, int openflags) {
+    int i;
+
+    pthread_mutex_lock(&served_lock);
+    for ( i=0; i<pending_cnt; ++i )
+	if ( pending[i].openflags==openflags && strcmp(pending[i].path,path)==0 )
+    break;
+    if ( i==pending_cnt ) {
+	if ( pending_cnt>=pending_max )
+	    pending = realloc(pending,(pending_max += 16)*sizeof(struct pendingfont));
+	pending[pending_cnt].path = copy(path);
+	pending[pending_cnt++].openflags = openflags;
+	pthread_cond_signal(&loader_wake);
+    }
+    pthread_mutex_unlock(&served_lock);
+}
+
+static void ServerLockFonts(void) {
+    pthread_mutex_lock(&served_lock);
+}
+
+static void ServerUnlockFonts(void) {
+    pthread_mutex_unlock(&served_lock);
+}
+
+static void ServerStop(int sig) {
+    (void) sig;
+    server_stop = true;
+}
+
+static void ServerChild(int sig) {
+    int err = errno;
+    (void) sig;
+    if ( write(child_pipe[1],"",1)<0 )
+	/* Full, so the server will wake anyway */;
+    errno = err;
+}
+
+/* A request is a 4 byte length (sent along with the client's stdin, stdout */
+/*  and stderr) followed by that many bytes: the client's working directory */
+/*  and then its arguments, each ending in a NUL */
+static char *RecvRequest(int sock, int fds[3], int *len) {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+	struct cmsghdr align;
+	char buf[CMSG_SPACE(3*sizeof(int))];
+    } control;
+    uint32_t size;
+    char *request;
+    int got = false;
+
+    memset(&msg,0,sizeof(msg));
+    iov.iov_base = &size;
+    iov.iov_len = sizeof(size);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if ( recvmsg(sock,&msg,0)!=sizeof(size) )
+return( NULL );
+    for ( cmsg=CMSG_FIRSTHDR(&msg); cmsg!=NULL; cmsg=CMSG_NXTHDR(&msg,cmsg) ) {
+	if ( cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_RIGHTS &&
+		cmsg->cmsg_len==CMSG_LEN(3*sizeof(int)) ) {
+	    memcpy(fds,CMSG_DATA(cmsg),3*sizeof(int));
+	    got = true;
+	}
+    }
+    if ( !got )
+return( NULL );
+    size = ntohl(size);
+    request = size<(1<<24) ? malloc(size+1) : NULL;
+    if ( request==NULL || !ReadAll(sock,request,size) ) {
+	free(request);
+	close(fds[0]); close(fds[1]); close(fds[2]);
+return( NULL );
+    }
+    request[size] = '\0';
+    *len = size;
+return( request );
+}
+
+static void ServerWorker(char *request, int len, int fds[3], int report) {
+    char **argv, *pt, *end = request+len;
+    int argc, i;
+
+    signal(SIGINT,SIG_DFL);
+    signal(SIGTERM,SIG_DFL);
+    signal(SIGPIPE,SIG_DFL);
+    signal(SIGCHLD,SIG_DFL);
+    close(child_pipe[0]);
+    close(child_pipe[1]);
+    for ( i=0; i<3; ++i ) {
+	dup2(fds[i],i);
+	if ( fds[i]>2 )
+	    close(fds[i]);
+    }
+    report_fd = report;
+    fcntl(report_fd,F_SETFD,FD_CLOEXEC);
+
+    if ( chdir(request)!=0 ) {
+	fprintf(stderr,"Can't change to %s: %s\n", request, strerror(errno));
+	exit(1);
+    }
+    for ( argc=0, pt=request+strlen(request)+1; pt<end; pt+=strlen(pt)+1 )
+	++argc;
+    argv = calloc(argc+1,sizeof(char *));
+    for ( argc=0, pt=request+strlen(request)+1; pt<end; pt+=strlen(pt)+1 )
+	argv[argc++] = pt;
+
+    CheckIsScript(argc,argv);		/* Exits when done */
+    fprintf(stderr,"The script server was given no script to run\n");
+    exit(1);
+}
+
+/* Scripts run as the server's user, so only that user may send them */
+static int ServerPeerIsUs(int client) {
+#ifdef __linux__
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if ( getsockopt(client,SOL_SOCKET,SO_PEERCRED,&cred,&len)!=0 )
+return( false );
+return( cred.uid==geteuid() );
+#else
+    uid_t uid;
+    gid_t gid;
+
+    if ( getpeereid(client,&uid,&gid)!=0 )
+return( false );
+return( uid==geteuid() );
+#endif
+}
+
+static void ServerAccept(int listener, struct worker **workers, int *wcnt, int *wmax) {
+    int client, fds[3], report[2], len, i;
+    struct worker *w;
+    char *request;
+    pid_t pid;
+
+    client = accept(listener,NULL,NULL);
+    if ( client<0 )
+return;
+    if ( !ServerPeerIsUs(client) ) {
+	close(client);
+return;
+    }
+    if ( (request = RecvRequest(client,fds,&len))==NULL ) {
+	close(client);
+return;
+    }
+    if ( pipe(report)!=0 ) {
+	close(client);
+	close(fds[0]); close(fds[1]); close(fds[2]);
+	free(request);
+return;
+    }
+    fflush(stdout);
+    fflush(stderr);
+#if !defined(_NO_PYTHON)
+    pid = PyFF_Fork();
+#else
+    pid = fork();
+#endif
+    if ( pid==0 ) {
+	close(listener);
+	close(client);
+	close(report[0]);
+	for ( i=0; i<*wcnt; ++i ) {
+	    close((*workers)[i].client);
+	    if ( (*workers)[i].report>=0 )
+		close((*workers)[i].report);
+	}
+	ServerWorker(request,len,fds,report[1]);
+    }
+    close(fds[0]); close(fds[1]); close(fds[2]);
+    close(report[1]);
+    free(request);
+    if ( pid<0 ) {
+	close(client);
+	close(report[0]);
+return;
+    }
+    fcntl(report[0],F_SETFL,O_NONBLOCK);
+    if ( *wcnt>=*wmax )
+	*workers = realloc(*workers,(*wmax += 8)*sizeof(struct worker));
+    w = &(*workers)[(*wcnt)++];
+    memset(w,0,sizeof(*w));
+    w->pid = pid;
+    w->client = client;
+    w->report = report[0];
+}
+
+static void WorkerRead(struct worker *w) {
+    ssize_t n;
+
+    while ( w->report>=0 ) {
+	if ( w->olen+1024>w->omax )
+	    w->opened = realloc(w->opened,w->omax += 4096);
+	n = read(w->report,w->opened+w->olen,w->omax-w->olen-1);
+	if ( n<0 && errno==EINTR )
+    continue;
+	if ( n<0 && errno==EAGAIN )
+    break;
+	if ( n<=0 ) {
+	    close(w->report);
+	    w->report = -1;
+	} else
+	    w->olen += n;
+    }
+}
+
+static void WorkerDone(struct worker *w, int status) {
+    uint32_t code;
+    char *pt, *nl, *space;
+
+    WorkerRead(w);
+    if ( w->report>=0 )
+	close(w->report);
+    code = WIFEXITED(status) ? WEXITSTATUS(status) :
+	    WIFSIGNALED(status) ? 128+WTERMSIG(status) : 1;
+    code = htonl(code);
+    WriteAll(w->client,&code,sizeof(code));
+    close(w->client);
+
+    /* Now that the client has its answer, have the fonts this script */
+    /*  opened read so the next one won't have to */
+    if ( w->opened!=NULL ) {
+	w->opened[w->olen] = '\0';
+	for ( pt=w->opened; (nl=strchr(pt,'\n'))!=NULL; pt=nl+1 ) {
+	    *nl = '\0';
+	    if ( (space=strchr(pt,' '))!=NULL )
+		ServerQueueFont(space+1,strtol(pt,NULL,10));
+	}
+	free(w->opened);
+    }
+}
+
+/* Only a socket no server answers on may be replaced. Anything else at */
+/*  socketname is left alone and the server refuses to start */
+static int ServerClaimSocket(const char *socketname, struct sockaddr_un *addr) {
+    struct stat st;
+    int sock, ret;
+
+    if ( lstat(socketname,&st)!=0 )
+return( errno==ENOENT );
+    if ( !S_ISSOCK(st.st_mode) ) {
+	fprintf(stderr,"Can't listen on %s: it exists and is not a socket\n", socketname);
+return( false );
+    }
+    if ( (sock = socket(AF_UNIX,SOCK_STREAM,0))<0 )
+return( false );
+    ret = connect(sock,(struct sockaddr *) addr,sizeof(*addr));
+    close(sock);
+    if ( ret==0 ) {
+	fprintf(stderr,"Can't listen on %s: a server is already running there\n", socketname);
+return( false );
+    }
+    unlink(socketname);		/* Left over from a server which was killed */
+return( true );
+}
+
+void ScriptServerRun(const char *socketname, int do_inits, int do_plugins) {
+    struct sockaddr_un addr;
+    struct stat st, bound;
+    struct worker *workers = NULL;
+    struct pollfd *pfds = NULL;
+    int wcnt = 0, wmax = 0, pmax = 0;
+    int listener, cnt, i, status;
+    char *pt, buffer[64];
+    pid_t pid;
+    mode_t oldmask;
+    pthread_t loader;
+    sigset_t block, oldset;
+
+    no_windowing_ui = running_script = true;
+    in_server = true;
+    served_max = 16;
+    if ( (pt = getenv("FONTFORGE_SERVER_FONTS"))!=NULL )
+	served_max = strtol(pt,NULL,10);
+    if ( served_max<1 )
+	served_max = 1;
+    served = calloc(served_max,sizeof(struct servedfont));
+
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ( strlen(socketname)>=sizeof(addr.sun_path) ) {
+	fprintf(stderr,"Socket name too long: %s\n", socketname);
+	exit(1);
+    }
+    strcpy(addr.sun_path,socketname);
+
+#if !defined(_NO_PYTHON)
+    /* Everything a python script needs before it starts, done once */
+    FontForge_InitializeEmbeddedPython();
+    PyFF_ProcessInitFiles(do_inits,do_plugins);
+#else
+    (void) do_inits; (void) do_plugins;
+#endif
+
+    if ( !ServerClaimSocket(socketname,&addr) )
+	exit(1);
+    listener = socket(AF_UNIX,SOCK_STREAM,0);
+    /* No one else may connect, not even before the peer check */
+    oldmask = umask(077);
+    if ( listener<0 || bind(listener,(struct sockaddr *) &addr,sizeof(addr))!=0 ||
+	    listen(listener,64)!=0 || lstat(socketname,&bound)!=0 ) {
+	fprintf(stderr,"Can't listen on %s: %s\n", socketname, strerror(errno));
+	exit(1);
+    }
+    umask(oldmask);
+    fcntl(listener,F_SETFD,FD_CLOEXEC);
+    if ( pipe(child_pipe)!=0 ) {
+	fprintf(stderr,"Can't make a pipe: %s\n", strerror(errno));
+	exit(1);
+    }
+    for ( i=0; i<2; ++i ) {
+	fcntl(child_pipe[i],F_SETFL,O_NONBLOCK);
+	fcntl(child_pipe[i],F_SETFD,FD_CLOEXEC);
+    }
+    signal(SIGCHLD,ServerChild);
+    signal(SIGINT,ServerStop);
+    signal(SIGTERM,ServerStop);
+    signal(SIGPIPE,SIG_IGN);
+
+    /* The signals must wake poll() on this thread, not the loader */
+    pthread_atfork(ServerLockFonts,ServerUnlockFonts,ServerUnlockFonts);
+    sigfillset(&block);
+    pthread_sigmask(SIG_BLOCK,&block,&oldset);
+    if ( pthread_create(&loader,NULL,ServerLoader,NULL)!=0 ) {
+	fprintf(stderr,"Can't start a thread to read fonts\n");
+	exit(1);
+    }
+    pthread_sigmask(SIG_SETMASK,&oldset,NULL);
+
+    while ( !server_stop ) {
+	if ( wcnt+2>pmax )
+	    pfds = realloc(pfds,(pmax = wcnt+8)*sizeof(struct pollfd));
+	pfds[0].fd = listener;
+	pfds[0].events = POLLIN;
+	pfds[1].fd = child_pipe[0];
+	pfds[1].events = POLLIN;
+	for ( i=0, cnt=2; i<wcnt; ++i ) if ( workers[i].report>=0 ) {
+	    pfds[cnt].fd = workers[i].report;
+	    pfds[cnt++].events = POLLIN;
+	}
+	if ( poll(pfds,cnt,-1)<0 ) {
+	    if ( errno!=EINTR )
+    break;
+	    pfds[0].revents = 0;
+	}
+	while ( read(child_pipe[0],buffer,sizeof(buffer))>0 );
+	if ( pfds[0].revents&POLLIN )
+	    ServerAccept(listener,&workers,&wcnt,&wmax);
+	for ( i=0; i<wcnt; ++i )
+	    WorkerRead(&workers[i]);
+	while ( (pid = waitpid(-1,&status,WNOHANG))>0 ) {
+	    for ( i=0; i<wcnt && workers[i].pid!=pid; ++i );
+	    if ( i<wcnt ) {
+		struct worker w = workers[i];
+		workers[i] = workers[--wcnt];
+		WorkerDone(&w,status);
+	    }
+	}
+    }
+    close(listener);
+    pthread_mutex_lock(&served_lock);
+    loader_stop = true;
+    pthread_cond_signal(&loader_wake);
+    pthread_mutex_unlock(&served_lock);
+    pthread_join(loader,NULL);
+    /* Unless something else has been put there since */
+    if ( lstat(socketname,&st)==0 && st.st_dev==bound.st_dev && st.st_ino==bound.st_ino )
+	unlink(socketname);
+    exit(0);
+}
+
+/* Hand the script to a server if there is one */
+void ScriptServerForward(int argc, char *argv[]) {
+    const char *socketname = getenv("FONTFORGE_SERVER");
+    struct sockaddr_un addr;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+	struct cmsghdr align;
+	char buf[CMSG_SPACE(3*sizeof(int))];
+    } control;
+    int fds[3] = { 0, 1, 2 };
+    char *request, *cwd = NULL, *pt, buffer[3];
+    size_t cwdmax = 256;
+    uint32_t size, code;
+    int sock, i, len;
+    FILE *temp;
+
+    if ( in_server || socketname==NULL || *socketname=='\0' ||
+	    strlen(socketname)>=sizeof(addr.sun_path) )
+return;
+    /* The same things CheckIsScript would take for a script */
+    for ( i=1; i<argc; ++i ) {
+	pt = argv[i];
+	if ( *pt=='-' && pt[1]=='-' && pt[2]!='\0' ) ++pt;
+	if ( strcmp(pt,"-script")==0 || strcmp(pt,"-dry")==0 ||
+		strcmp(argv[i],"-c")==0 || strcmp(argv[i],"-")==0 )
+    break;
+	if ( *pt!='-' ) {
+	    if ( (temp = fopen(argv[i],"rb"))==NULL )
+return;
+	    buffer[0] = '\0';
+	    fgets(buffer,sizeof(buffer),temp);
+	    fclose(temp);
+	    if ( buffer[0]=='#' && buffer[1]=='!' )
+    break;
+return;
+	}
+    }
+    if ( i>=argc )
+return;
+
+    do {
+	free(cwd);
+	cwd = malloc(cwdmax *= 2);
+    } while ( getcwd(cwd,cwdmax)==NULL && errno==ERANGE );
+    len = strlen(cwd)+1;
+    for ( i=0; i<argc; ++i )
+	len += strlen(argv[i])+1;
+    request = malloc(len);
+    strcpy(request,cwd);
+    pt = request+strlen(cwd)+1;
+    for ( i=0; i<argc; ++i ) {
+	strcpy(pt,argv[i]);
+	pt += strlen(pt)+1;
+    }
+    free(cwd);
+
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path,socketname);
+    sock = socket(AF_UNIX,SOCK_STREAM,0);
+    if ( sock<0 || connect(sock,(struct sockaddr *) &addr,sizeof(addr))!=0 ) {
+	/* No server, run it ourselves */
+	if ( sock>=0 )
+	    close(sock);
+	free(request);
+return;
+    }
+
+    size = htonl(len);
+    memset(&msg,0,sizeof(msg));
+    memset(&control,0,sizeof(control));
+    iov.iov_base = &size;
+    iov.iov_len = sizeof(size);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg),fds,sizeof(fds));
+    signal(SIGPIPE,SIG_IGN);
+    if ( sendmsg(sock,&msg,0)!=sizeof(size) ) {
+	close(sock);
+	free(request);
+return;
+    }
+    if ( !WriteAll(sock,request,len) || !ReadAll(sock,&code,sizeof(code)) ) {
+	fprintf(stderr,"Lost the script server at %s\n", socketname);
+	exit(1);
+    }
+    exit(ntohl(code));
+}
+
+#else
+
+void ScriptServerRun(const char *socketname, int do_inits, int do_plugins) {
+    (void) do_inits; (void) do_plugins;
+    fprintf(stderr,"Can't listen on %s: no script server on this system\n", socketname);
+    exit(1);
+}
+
+void ScriptServerForward(int argc, char *argv[]) {
+    (void) argc; (void) argv;
+}
+
+SplineFont *ScriptServerFont(const char *filename, enum openflags openflags) {
+    (void) filename; (void) openflags;
+return( NULL );
+}
+#endif
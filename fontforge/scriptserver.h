@@ -0,0 +1,65 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FONTFORGE_SCRIPTSERVER_H
+#define FONTFORGE_SCRIPTSERVER_H
+
+#include "splinefont.h"
+
+/*
+ * A script server saves build systems which run many small scripts the
+ * cost of starting fontforge (and python, its init files and plugins) and
+ * of parsing the same fonts over and over again.
+ *
+ * "fontforge -server socket" listens on a unix domain socket. Any later
+ * "fontforge -script ..." (or -c, or a #! script, or "-") run with
+ * FONTFORGE_SERVER set to that socket hands its arguments, its working
+ * directory and its standard input, output and error to the server and
+ * waits for the exit status. If there is no server listening the script is
+ * run as usual.
+ *
+ * The server runs each script in a fork of itself, so scripts can't see
+ * each other's changes to fonts or to the interpreter. Fonts the scripts
+ * open are read again by the server afterwards and kept (the least
+ * recently used are dropped after FONTFORGE_SERVER_FONTS, default 16), so
+ * that the next script which opens the same file gets a copy without
+ * parsing it. Files which have changed since are read again.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void ScriptServerRun(const char *socketname, int do_inits, int do_plugins);
+extern void ScriptServerForward(int argc, char *argv[]);
+extern SplineFont *ScriptServerFont(const char *filename, enum openflags openflags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FONTFORGE_SCRIPTSERVER_H */
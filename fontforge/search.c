@@ -32,6 +32,7 @@
 #include "cvundoes.h"
 #include "fontforgevw.h"
 #include "fvfonts.h"
+#include "parallel.h"
 #include "splineutil.h"
 #include "splineutil2.h"
 #include "ustring.h"
@@ -1006,6 +1007,110 @@ static void DoReplaceFull(SplineChar *sc,SearchData *s) {
 
 /* ************************************************************************** */
 
+#define OS_CLOSED	0x80000000
+#define OS_OPEN		0x40000000
+#define OS_REF		0xc0000000
+#define OS_COUNT	0x3fffffff
+
+static void OutlineSigAdd(OutlineSig *sig,uint32_t key) {
+    if ( sig->cnt>=sig->max ) {
+	sig->max += 16;
+	sig->keys = realloc(sig->keys,sig->max*sizeof(uint32_t));
+    }
+    sig->keys[sig->cnt++] = key;
+    sig->mask |= ((uint64_t) 1)<<(((uint32_t) (key*0x9e3779b1))>>26);
+}
+
+static int key_cmp(const void *_k1, const void *_k2) {
+    uint32_t k1 = *(const uint32_t *) _k1, k2 = *(const uint32_t *) _k2;
+
+return( k1<k2 ? -1 : k1>k2 );
+}
+
+static void OutlineSigFill(OutlineSig *sig,SplineSet *spl,RefChar *refs) {
+    SplinePoint *sp;
+    uint32_t cnt, type;
+
+    sig->cnt = 0;
+    sig->mask = 0;
+    for ( ; spl!=NULL; spl=spl->next ) {
+	type = OS_OPEN;
+	for ( sp=spl->first, cnt=1; sp->next!=NULL; ++cnt ) {
+	    sp = sp->next->to;
+	    if ( sp==spl->first ) {
+		type = OS_CLOSED;
+	break;
+	    }
+	}
+	OutlineSigAdd(sig,type|(cnt>OS_COUNT ? OS_COUNT : cnt));
+    }
+    for ( ; refs!=NULL; refs=refs->next )
+	OutlineSigAdd(sig,OS_REF|(refs->sc->orig_pos&OS_COUNT));
+    qsort(sig->keys,sig->cnt,sizeof(uint32_t),key_cmp);
+    sig->valid = true;
+}
+
+static void OutlineSigFree(OutlineSig *sig) {
+    free(sig->keys);
+    memset(sig,0,sizeof(OutlineSig));
+}
+
+static void SDFreeIndex(SearchData *sv) {
+    int gid;
+
+    for ( gid=0; gid<sv->sigcnt; ++gid )
+	free(sv->sigs[gid].keys);
+    free(sv->sigs);
+    sv->sigs = NULL;
+    sv->sigcnt = 0;
+}
+
+/* Signatures are filled in as glyphs are searched, and must be refilled */
+/*  if a glyph changes */
+static void SDStartIndex(SearchData *sv) {
+    SDFreeIndex(sv);
+    sv->sigcnt = sv->fv->sf->glyphcnt;
+    sv->sigs = calloc(sv->sigcnt,sizeof(OutlineSig));
+}
+
+/* False if the glyph can't match the search pattern however it is */
+/*  transformed. A full search matches each contour of the pattern with a */
+/*  contour of the glyph with the same number of points, and each reference */
+/*  with one to the same glyph. A sub pattern search matches an open contour */
+/*  with part of an open contour at least as long, or with any closed one */
+static int SDMayMatch(SearchData *sv,int gid) {
+    SplineChar *sc = sv->fv->sf->glyphs[gid];
+    int layer = sv->fv->active_layer;
+    OutlineSig *sig, *pat = &sv->pattern;
+    int i, j;
+
+    if ( !pat->valid )
+return( true );
+    sig = gid<sv->sigcnt ? &sv->sigs[gid] : &sv->scratch;
+    if ( sig==&sv->scratch || !sig->valid )
+	OutlineSigFill(sig,sc->layers[layer].splines,sc->layers[layer].refs);
+    if ( sv->subpatternsearch ) {
+	for ( i=0; i<sig->cnt; ++i ) {
+	    if ( (sig->keys[i]&OS_REF)==OS_CLOSED ||
+		    ((sig->keys[i]&OS_REF)==OS_OPEN && (sig->keys[i]&OS_COUNT)>=(uint32_t) sv->pointcnt) )
+return( true );
+	}
+return( false );
+    } else if ( sv->endpoints ) {
+	/* Open contours may match longer ones, don't bother */
+return( true );
+    }
+    if ( pat->mask&~sig->mask )
+return( false );
+    for ( i=j=0; i<pat->cnt; ++i, ++j ) {
+	while ( j<sig->cnt && sig->keys[j]<pat->keys[i] )
+	    ++j;
+	if ( j>=sig->cnt || sig->keys[j]!=pat->keys[i] )
+return( false );
+    }
+return( true );
+}
+
 void SVResetPaths(SearchData *sv) {
     SplineSet *spl;
 
@@ -1057,6 +1162,7 @@ void SVResetPaths(SearchData *sv) {
 	    sv->rpointcnt = i;
 	}
     }
+    OutlineSigFill(&sv->pattern,sv->path,sv->sc_srch.layers[ly_fore].refs);
 }
 
 static void SplinePointsUntick(SplineSet *spl) {
@@ -1090,6 +1196,8 @@ int SearchChar(SearchData *sv, int gid,int startafter) {
     sv->matched_refs = sv->matched_ss = 0;
     sv->matched_x = sv->matched_y = 0;
 
+    if ( !startafter && !SDMayMatch(sv,gid) )
+return( false );
     if ( sv->subpatternsearch )
 return( SCMatchesIncomplete(sv->curchar,sv,startafter));
     else
@@ -1115,19 +1223,59 @@ return(false);
 	DoReplaceIncomplete(sv->curchar,sv);
     else
 	DoReplaceFull(sv->curchar,sv);
+    if ( sv->curchar->orig_pos<sv->sigcnt )
+	sv->sigs[sv->curchar->orig_pos].valid = false;
     SCCharChangedUpdate(sv->curchar,layer);
 return( true );
 }
 
+struct findwork {
+    SearchData *sv;
+    uint8_t *want, *found;
+};
+
+static void FindRange(void *data,int start,int end) {
+    struct findwork *fw = data;
+    SearchData s = *fw->sv;	/* Each chunk has its own matched_* */
+    int gid;
+
+    memset(&s.scratch,0,sizeof(s.scratch));
+    for ( gid=start; gid<end; ++gid ) if ( fw->want[gid] ) {
+	SCSplinePointsUntick(s.fv->sf->glyphs[gid],s.fv->active_layer);
+	fw->found[gid] = SearchChar(&s,gid,false);
+    }
+    OutlineSigFree(&s.scratch);
+}
+
 int _DoFindAll(SearchData *sv) {
-    int i, any=0, gid;
+    int i, any=0, gid, own_index = sv->sigs==NULL;
     SplineChar *startcur = sv->curchar;
+    SplineFont *sf = sv->fv->sf;
+    struct findwork fw;
+
+    /* Find which glyphs match on several threads first. A glyph only */
+    /*  changes when it is replaced in, so those which don't match now */
+    /*  won't later, and only those which do need to be searched again to */
+    /*  replace them */
+    if ( own_index )
+	SDStartIndex(sv);
+    fw.sv = sv;
+    fw.want = calloc(sf->glyphcnt,1);
+    fw.found = calloc(sf->glyphcnt,1);
+    for ( i=0; i<sv->fv->map->enccount; ++i )
+	if (( !sv->onlyselected || sv->fv->selected[i]) && (gid=sv->fv->map->map[i])!=-1 &&
+		sf->glyphs[gid]!=NULL )
+	    fw.want[gid] = true;
+    ParallelFor(sf->glyphcnt,FindRange,&fw);
 
     for ( i=0; i<sv->fv->map->enccount; ++i ) {
 	if (( !sv->onlyselected || sv->fv->selected[i]) && (gid=sv->fv->map->map[i])!=-1 &&
-		sv->fv->sf->glyphs[gid]!=NULL ) {
-	    SCSplinePointsUntick(sv->fv->sf->glyphs[gid],sv->fv->active_layer);
-	    if ( (sv->fv->selected[i] = SearchChar(sv,gid,false)) ) {
+		sf->glyphs[gid]!=NULL ) {
+	    if ( fw.found[gid] && sv->replaceall ) {
+		SCSplinePointsUntick(sf->glyphs[gid],sv->fv->active_layer);
+		fw.found[gid] = SearchChar(sv,gid,false);
+	    }
+	    if ( (sv->fv->selected[i] = fw.found[gid]) ) {
 		any = true;
 		if ( sv->replaceall ) {
 		    do {
@@ -1141,6 +1289,10 @@ int _DoFindAll(SearchData *sv) {
 	    sv->fv->selected[i] = false;
     }
     sv->curchar = startcur;
+    free(fw.want);
+    free(fw.found);
+    if ( own_index )
+	SDFreeIndex(sv);
 return( any );
 }
 
@@ -1159,6 +1311,9 @@ return;
     free(sv->sc_srch.layers);
     free(sv->sc_rpl.layers);
     SplinePointListsFree(sv->revpath);
+    OutlineSigFree(&sv->pattern);
+    OutlineSigFree(&sv->scratch);
+    SDFreeIndex(sv);
 }
 
 SearchData *SDFillup(SearchData *sv, FontViewBase *fv) {
@@ -1214,7 +1369,7 @@ static void SDCopyToSC(SplineChar *checksc,SplineChar *into,enum fvcopy_type ful
     }
     if ( full==ct_fullcopy ) {
 	into->layers[ly_fore].splines = SplinePointListCopy(checksc->layers[ly_fore].splines);
-	into->layers[ly_fore].refs    = RefCharsCopyState(checksc,ly_fore);
+	into->layers[ly_fore].refs    = RefCharsCopyState(checksc,ly_fore,true);
     } else {
 	into->layers[ly_fore].refs = ref = RefCharCreate();
 	ref->unicode_enc = checksc->unicodeenc;
@@ -1251,6 +1406,8 @@ void FVBReplaceOutlineWithReference( FontViewBase *fv, double fudge ) {
 	++selcnt;
     ff_progress_start_indicator(10,_("Replace with Reference"),
 	    _("Replace Outline with Reference"),0,selcnt,1);
+    /* Each glyph is searched for in the whole font, keep what we learn */
+    SDStartIndex(sv);
 
     for ( i=0; i<fv->map->enccount; ++i ) if ( selected[i] && (gid=fv->map->map[i])!=-1 &&
 	    (checksc=sf->glyphs[gid])!=NULL ) {
@@ -1336,7 +1493,7 @@ SplineChar *SDFindNext(SearchData *sd) {
 return( NULL );
     fv = sd->fv;
 
-    for ( gid=sd->last_gid+1; gid<fv->sf->glyphcnt; ++gid ) {
+    for ( gid=sd->last_gid+1; gid<fv->sf->glyphcnt; ++gid ) if ( fv->sf->glyphs[gid]!=NULL ) {
 	SCSplinePointsUntick(fv->sf->glyphs[gid],fv->active_layer);
 	if ( SearchChar(sd,gid,false) ) {
 	    sd->last_gid = gid;
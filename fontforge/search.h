@@ -35,6 +35,16 @@
 extern "C" {
 #endif
 
+/* What can't change about a layer's outlines when they are matched (the */
+/*  number of points on each contour and whether it is closed, the glyphs */
+/*  referred to), so that most glyphs can be ruled out without matching */
+typedef struct outlinesig {
+	uint64_t mask;                       /* A bit for each key, hashed */
+	uint32_t *keys;                      /* Sorted */
+	int cnt, max;
+	unsigned int valid: 1;
+} OutlineSig;
+
 typedef struct searchdata {
 	SplineChar sc_srch, sc_rpl;
 	SplineSet *path, *revpath, *replacepath, *revreplace;
@@ -68,6 +78,10 @@ typedef struct searchdata {
 	FontViewBase *fv;
 	SplineChar *curchar;
 	int last_gid;
+	OutlineSig pattern;                  /* What the search pattern needs a glyph to have */
+	OutlineSig scratch;                  /* The glyph being searched, when there is no index */
+	OutlineSig *sigs;                    /* Index of the font's glyphs, while searching all of them */
+	int sigcnt;
 } SearchData;
 
 extern void SDDestroy(SearchData *sd);
@@ -45,6 +45,7 @@
 #include "gwidget.h"
 #include "lookups.h"
 #include "mem.h"
+#include "mm.h"
 #include "namelist.h"
 #include "parsettf.h"
 #include "psread.h"
@@ -2881,6 +2882,8 @@ static int SFD_MMDump(FILE *sfd,SplineFont *sf,EncMap *map,EncMap *normal,
     int max, i, j;
     int err = false;
 
+    /* An sfd file has no way to say what the deltas were */
+    MMMaterialize(mm);
     fprintf( sfd, "MMCounts: %d %d %d %d\n", mm->instance_count, mm->axis_count,
 	    mm->apple, mm->named_instance_count );
     fprintf( sfd, "MMAxis:" );
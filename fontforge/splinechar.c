@@ -35,6 +35,7 @@
 #include "fvfonts.h"
 #include "lookups.h"
 #include "mem.h"
+#include "parallel.h"
 #include "parsettf.h"
 #include "spiro.h"
 #include "splineorder2.h"
@@ -47,8 +48,10 @@
 #include "utanvec.h"
 #include "utype.h"
 
+#include <inttypes.h>
 #include <locale.h>
 #include <math.h>
+#include <time.h>
 
 #ifdef HAVE_IEEEFP_H
 # include <ieeefp.h>		/* Solaris defines isnan in ieeefp rather than math.h */
@@ -535,10 +538,10 @@ void SCCopyLayerToLayer(SplineChar *sc, int from, int to,int doclear) {
     }
 
     if ( sc->layers[to].refs==NULL )
-	sc->layers[to].refs = ref = RefCharsCopyState(sc,from);
+	sc->layers[to].refs = ref = RefCharsCopyState(sc,from,true);
     else {
 	for ( oldref = sc->layers[to].refs; oldref->next!=NULL; oldref=oldref->next );
-	oldref->next = ref = RefCharsCopyState(sc,from);
+	oldref->next = ref = RefCharsCopyState(sc,from,true);
     }
     for ( ; ref!=NULL; ref=ref->next ) {
 	SCReinstanciateRefChar(sc,ref,to);
@@ -1606,7 +1609,47 @@ return( h1 );
 return( NULL );
 }
 
-int SCValidate(SplineChar *sc, int layer, int force) {
+const char *validate_check_names[vc_max] = { "glyphname", "lookups", "opencontour",
+	"selfintersects", "direction", "references", "hints", "points", "extrema",
+	"maxp", "duplicates", "anchors" };
+static double validate_times[vc_max];
+
+#define VALIDATE_CACHE_VERSION	1
+#define VALIDATE_BATCH		256
+
+/* Adds the time since the last mark to the check which just finished */
+struct vtimer {
+    double *times;
+    double last;
+};
+
+static double VTimeNow(void) {
+    struct timespec ts;
+
+    timespec_get(&ts,TIME_UTC);
+return( ts.tv_sec + ts.tv_nsec/1e9 );
+}
+
+static void VTimerStart(struct vtimer *vt, double *times) {
+    vt->times = times;
+    vt->last = times!=NULL ? VTimeNow() : 0;
+}
+
+static void VTimerMark(struct vtimer *vt, enum validate_check check) {
+    double now;
+
+    if ( vt->times==NULL )
+return;
+    now = VTimeNow();
+    vt->times[check] += now-vt->last;
+    vt->last = now;
+}
+
+/* The checks which only look at the glyph itself (and at a few font wide */
+/*  settings). They don't touch anything shared, so several glyphs may be */
+/*  checked at once, and their result depends on nothing SCValidateHash */
+/*  doesn't look at */
+static int SCValidateOutlines(SplineChar *sc, int layer, double *times) {
     SplineSet *ss;
     Spline *s1, *s2, *s, *first;
     SplinePoint *sp;
@@ -1617,26 +1660,18 @@ int SCValidate(SplineChar *sc, int layer, int force) {
     SplineSet *base;
     bigreal len2, bound2, x, y;
     extended extrema[4];
-    PST *pst;
     struct ttf_table *tab;
-    extern int allow_utf8_glyphnames;
     RefChar *r;
     BasePoint lastpt;
-    int gid, k;
-    SplineFont *cid, *sf;
-    SplineChar *othersc;
-    struct altuni *alt;
-
-    if ( (sc->layers[layer].validation_state&vs_known) && !force )
-  goto end;
-
-    sc->layers[layer].validation_state = 0;
+    int state = 0;
+    struct vtimer vt;
 
+    VTimerStart(&vt,times);
     base = LayerAllSplines(&sc->layers[layer]);
 
     if ( !allow_utf8_glyphnames ) {
 	if ( strlen(sc->name)>31 )
-	    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
+	    state |= vs_badglyphname;
 	else {
 	    char *pt;
 	    for ( pt = sc->name; *pt; ++pt ) {
@@ -1646,92 +1681,58 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 			*pt == '.' || *pt == '_' )
 		    /* That's ok */;
 		else {
-		    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
+		    state |= vs_badglyphname;
 	    break;
 		}
 	    }
 	}
     }
-
-    for ( pst=sc->possub; pst!=NULL; pst=pst->next ) {
-	if ( pst->type==pst_substitution &&
-		!SCWorthOutputting(SFGetChar(sc->parent,-1,pst->u.subs.variant))) {
-	    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-    break;
-	} else if ( pst->type==pst_pair &&
-		!SCWorthOutputting(SFGetChar(sc->parent,-1,pst->u.pair.paired))) {
-	    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-    break;
-	} else if ( (pst->type==pst_alternate || pst->type==pst_multiple || pst->type==pst_ligature) &&
-		!SFValidNameList(sc->parent,pst->u.mult.components)) {
-	    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-    break;
-	}
-    }
-    if ( sc->vert_variants!=NULL && sc->vert_variants->variants != NULL &&
-	    !SFValidNameList(sc->parent,sc->vert_variants->variants) )
-	sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-    else if ( sc->horiz_variants!=NULL && sc->horiz_variants->variants != NULL &&
-	    !SFValidNameList(sc->parent,sc->horiz_variants->variants) )
-	sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-    else {
-	int i;
-	if ( sc->vert_variants!=NULL ) {
-	    for ( i=0; i<sc->vert_variants->part_cnt; ++i ) {
-		if ( !SCWorthOutputting(SFGetChar(sc->parent,-1,sc->vert_variants->parts[i].component)))
-		    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-	    break;
-	    }
-	}
-	if ( sc->horiz_variants!=NULL ) {
-	    for ( i=0; i<sc->horiz_variants->part_cnt; ++i ) {
-		if ( !SCWorthOutputting(SFGetChar(sc->parent,-1,sc->horiz_variants->parts[i].component)))
-		    sc->layers[layer].validation_state |= vs_badglyphname|vs_known;
-	    break;
-	    }
-	}
-    }
+    VTimerMark(&vt,vc_glyphname);
 
     for ( ss=sc->layers[layer].splines; ss!=NULL; ss=ss->next ) {
 	/* TrueType uses single points to move things around so ignore them */
 	if ( ss->first->next==NULL )
 	    /* Do Nothing */;
 	else if ( ss->first->prev==NULL ) {
-	    sc->layers[layer].validation_state |= vs_opencontour|vs_known;
+	    state |= vs_opencontour;
     break;
 	}
     }
+    VTimerMark(&vt,vc_opencontour);
 
     /* If there's an open contour we can't really tell whether it self-intersects */
-    if ( sc->layers[layer].validation_state & vs_opencontour )
-	/* sc->layers[layer].validation_state |= vs_selfintersects*/;
+    if ( state & vs_opencontour )
+	/* state |= vs_selfintersects*/;
     else {
 	if ( SplineSetIntersect(base,&s1,&s2) )
-	    sc->layers[layer].validation_state |= vs_selfintersects|vs_known;
+	    state |= vs_selfintersects;
     }
+    VTimerMark(&vt,vc_selfintersects);
 
     /* If there's a self-intersection we are guaranteed that both the self- */
     /*  intersecting contours will be in the wrong direction at some point */
-    if ( sc->layers[layer].validation_state & vs_selfintersects )
-	/*sc->layers[layer].validation_state |= vs_wrongdirection*/;
+    if ( state & vs_selfintersects )
+	/*state |= vs_wrongdirection*/;
     else {
 	if ( SplineSetsDetectDir(&base,&lastscan)!=NULL )
-	    sc->layers[layer].validation_state |= vs_wrongdirection|vs_known;
+	    state |= vs_wrongdirection;
     }
+    VTimerMark(&vt,vc_direction);
 
     /* Different kind of "wrong direction" */
     for ( ref=sc->layers[layer].refs; ref!=NULL; ref=ref->next ) {
 	if ( ref->transform[0]*ref->transform[3]<0 ||
 		(ref->transform[0]==0 && ref->transform[1]*ref->transform[2]>0)) {
-	    sc->layers[layer].validation_state |= vs_flippedreferences|vs_known;
+	    state |= vs_flippedreferences;
     break;
 	}
     }
+    VTimerMark(&vt,vc_references);
 
     for ( h=sc->hstem, cnt=0; h!=NULL; h=h->next, ++cnt );
     for ( h=sc->vstem       ; h!=NULL; h=h->next, ++cnt );
     if ( cnt>=96 )
-	sc->layers[layer].validation_state |= vs_toomanyhints|vs_known;
+	state |= vs_toomanyhints;
 
     if ( sc->layers[layer].splines!=NULL ) {
 	int anyhm=0;
@@ -1753,8 +1754,9 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	if ( !anyhm )
 	    h = SCHintOverlapInMask(sc,NULL);
 	if ( h!=NULL )
-	    sc->layers[layer].validation_state |= vs_overlappedhints|vs_known;
+	    state |= vs_overlappedhints;
     }
+    VTimerMark(&vt,vc_hints);
 
     memset(&lastpt,0,sizeof(lastpt));
     for ( ss=sc->layers[layer].splines, pt_cnt=path_cnt=0; ss!=NULL; ss=ss->next, ++path_cnt ) {
@@ -1764,11 +1766,11 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	    if ( (!SPInterpolate(sp) && (sp->me.x != rint(sp->me.x) || sp->me.y != rint(sp->me.y))) ||
 		    sp->nextcp.x != rint(sp->nextcp.x) || sp->nextcp.y != rint(sp->nextcp.y) ||
 		    sp->prevcp.x != rint(sp->prevcp.x) || sp->prevcp.y != rint(sp->prevcp.y))
-		sc->layers[layer].validation_state |= vs_nonintegral|vs_known;
+		state |= vs_nonintegral;
 	    if ( BPTooFar(&lastpt,&sp->prevcp) ||
 		    BPTooFar(&sp->prevcp,&sp->me) ||
 		    BPTooFar(&sp->me,&sp->nextcp))
-		sc->layers[layer].validation_state |= vs_pointstoofarapart|vs_known;
+		state |= vs_pointstoofarapart;
 	    memcpy(&lastpt,&sp->nextcp,sizeof(lastpt));
 	    ++pt_cnt;
 	    if ( sp->next==NULL )
@@ -1787,9 +1789,10 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	}
     }
     if ( pt_cnt>1500 )
-	sc->layers[layer].validation_state |= vs_toomanypoints|vs_known;
+	state |= vs_toomanypoints;
 
     LayerUnAllSplines(&sc->layers[layer]);
+    VTimerMark(&vt,vc_points);
 
     /* Only check the splines in the glyph, not those in refs */
     bound2 = sc->parent->extrema_bound;
@@ -1809,12 +1812,13 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	    len2 = x*x + y*y;
 	    /* short splines (serifs) are not required to have points at their extrema */
 	    if ( len2>bound2 && Spline2DFindExtrema(s,extrema)>0 ) {
-		sc->layers[layer].validation_state |= vs_missingextrema|vs_known;
+		state |= vs_missingextrema;
     goto break_2_loops;
 	    }
 	}
     }
     break_2_loops:;
+    VTimerMark(&vt,vc_extrema);
 
     if ( (tab = SFFindTable(sc->parent,CHR('m','a','x','p')))!=NULL && tab->len>=32 ) {
 	/* If we have a maxp table then do some truetype checks */
@@ -1832,9 +1836,9 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	/* Already figured out two of these */
 	if ( sc->layers[layer].splines==NULL ) {
 	    if ( pt_cnt>composit_pt_max )
-		sc->layers[layer].validation_state |= vs_maxp_toomanycomppoints|vs_known;
+		state |= vs_maxp_toomanycomppoints;
 	    if ( path_cnt>composit_path_max )
-		sc->layers[layer].validation_state |= vs_maxp_toomanycomppaths|vs_known;
+		state |= vs_maxp_toomanycomppaths;
 	}
 
 	for ( ss=sc->layers[layer].splines, pt_cnt=path_cnt=0; ss!=NULL; ss=ss->next, ++path_cnt ) {
@@ -1848,12 +1852,12 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	    }
 	}
 	if ( pt_cnt>pt_max )
-	    sc->layers[layer].validation_state |= vs_maxp_toomanypoints|vs_known;
+	    state |= vs_maxp_toomanypoints;
 	if ( path_cnt>path_max )
-	    sc->layers[layer].validation_state |= vs_maxp_toomanypaths|vs_known;
+	    state |= vs_maxp_toomanypaths;
 
 	if ( sc->ttf_instrs_len>instr_len_max )
-	    sc->layers[layer].validation_state |= vs_maxp_instrtoolong|vs_known;
+	    state |= vs_maxp_instrtoolong;
 
 	rd = 0;
 	for ( r=sc->layers[layer].refs, cnt=0; r!=NULL; r=r->next, ++cnt ) {
@@ -1862,10 +1866,61 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 		rd = rdtest;
 	}
 	if ( cnt>num_comp_max )
-	    sc->layers[layer].validation_state |= vs_maxp_toomanyrefs|vs_known;
+	    state |= vs_maxp_toomanyrefs;
 	if ( rd>comp_depth_max )
-	    sc->layers[layer].validation_state |= vs_maxp_refstoodeep|vs_known;
+	    state |= vs_maxp_refstoodeep;
     }
+    VTimerMark(&vt,vc_maxp);
+return( state );
+}
+
+/* Glyph names used by the glyph's lookups, and its math variants, must */
+/*  exist. This looks the names up in the font, so is done one glyph at a */
+/*  time */
+static int SCValidateLookups(SplineChar *sc) {
+    PST *pst;
+    int i;
+
+    for ( pst=sc->possub; pst!=NULL; pst=pst->next ) {
+	if ( pst->type==pst_substitution &&
+		!SCWorthOutputting(SFGetChar(sc->parent,-1,pst->u.subs.variant)))
+return( vs_badglyphname );
+	else if ( pst->type==pst_pair &&
+		!SCWorthOutputting(SFGetChar(sc->parent,-1,pst->u.pair.paired)))
+return( vs_badglyphname );
+	else if ( (pst->type==pst_alternate || pst->type==pst_multiple || pst->type==pst_ligature) &&
+		!SFValidNameList(sc->parent,pst->u.mult.components))
+return( vs_badglyphname );
+    }
+    if ( sc->vert_variants!=NULL && sc->vert_variants->variants != NULL &&
+	    !SFValidNameList(sc->parent,sc->vert_variants->variants) )
+return( vs_badglyphname );
+    else if ( sc->horiz_variants!=NULL && sc->horiz_variants->variants != NULL &&
+	    !SFValidNameList(sc->parent,sc->horiz_variants->variants) )
+return( vs_badglyphname );
+    if ( sc->vert_variants!=NULL ) {
+	for ( i=0; i<sc->vert_variants->part_cnt; ++i ) {
+	    if ( !SCWorthOutputting(SFGetChar(sc->parent,-1,sc->vert_variants->parts[i].component)))
+return( vs_badglyphname );
+	break;
+	}
+    }
+    if ( sc->horiz_variants!=NULL ) {
+	for ( i=0; i<sc->horiz_variants->part_cnt; ++i ) {
+	    if ( !SCWorthOutputting(SFGetChar(sc->parent,-1,sc->horiz_variants->parts[i].component)))
+return( vs_badglyphname );
+	break;
+	}
+    }
+return( 0 );
+}
+
+static int SCValidateDups(SplineChar *sc) {
+    int gid, k;
+    SplineFont *cid, *sf;
+    SplineChar *othersc;
+    struct altuni *alt;
+    int state = 0;
 
     k=0;
     cid = sc->parent;
@@ -1877,21 +1932,24 @@ int SCValidate(SplineChar *sc, int layer, int force) {
 	    if ( othersc==sc )
 	continue;
 	    if ( strcmp(sc->name,othersc->name)==0 )
-		sc->layers[layer].validation_state |= vs_dupname|vs_known;
+		state |= vs_dupname;
 	    if ( sc->unicodeenc!=-1 && UniMatch(-1,sc->unicodeenc,othersc) )
-		sc->layers[layer].validation_state |= vs_dupunicode|vs_known;
+		state |= vs_dupunicode;
 	    for ( alt=sc->altuni; alt!=NULL; alt=alt->next )
 		if ( UniMatch(alt->vs,alt->unienc,othersc) )
-		    sc->layers[layer].validation_state |= vs_dupunicode|vs_known;
+		    state |= vs_dupunicode;
 	}
 	++k;
     } while ( k<cid->subfontcnt );
+return( state );
+}
 
-  end:;
+static int SCValidateDone(SplineChar *sc, int layer, struct vtimer *vt) {
     /* This test is intentionally here and should be done even if the glyph */
     /*  hasn't changed. If the lookup changed it could make the glyph invalid */
     if ( SCValidateAnchors(sc)!=NULL )
 	sc->layers[layer].validation_state |= vs_missinganchor;
+    VTimerMark(vt,vc_anchors);
 
     sc->layers[layer].validation_state |= vs_known;
     if ( sc->unlink_rm_ovrlp_save_undo )
@@ -1900,56 +1958,410 @@ return( sc->layers[layer].validation_state&~(vs_known|vs_selfintersects) );
 return( sc->layers[layer].validation_state&~vs_known );
 }
 
-int SFValidate(SplineFont *sf, int layer, int force) {
-    int k, gid;
+int SCValidate(SplineChar *sc, int layer, int force) {
+    struct vtimer vt;
+
+    VTimerStart(&vt,NULL);
+    if ( !(sc->layers[layer].validation_state&vs_known) || force )
+	sc->layers[layer].validation_state = SCValidateOutlines(sc,layer,NULL) |
+		SCValidateLookups(sc) | SCValidateDups(sc);
+return( SCValidateDone(sc,layer,&vt) );
+}
+
+/* A hash of everything SCValidateOutlines looks at. Glyphs with the same */
+/*  hash get the same result, so that can be remembered from one run to */
+/*  the next */
+static uint64_t ValidateHashBytes(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *pt = data;
+
+    while ( len-->0 ) {
+	hash ^= *pt++;
+	hash *= UINT64_C(0x100000001b3);
+    }
+return( hash );
+}
+
+static uint64_t ValidateHashInt(uint64_t hash, int val) {
+return( ValidateHashBytes(hash,&val,sizeof(val)) );
+}
+
+static uint64_t ValidateHashReal(uint64_t hash, bigreal val) {
+return( ValidateHashBytes(hash,&val,sizeof(val)) );
+}
+
+static uint64_t ValidateHashSplines(uint64_t hash, SplineSet *ss) {
+    SplinePoint *sp;
+    Spline *s;
+
+    for ( ; ss!=NULL; ss=ss->next ) {
+	hash = ValidateHashInt(hash,'c');
+	for ( sp=ss->first; ; ) {
+	    hash = ValidateHashReal(hash,sp->me.x);
+	    hash = ValidateHashReal(hash,sp->me.y);
+	    hash = ValidateHashReal(hash,sp->nextcp.x);
+	    hash = ValidateHashReal(hash,sp->nextcp.y);
+	    hash = ValidateHashReal(hash,sp->prevcp.x);
+	    hash = ValidateHashReal(hash,sp->prevcp.y);
+	    hash = ValidateHashInt(hash,SPInterpolate(sp));
+	    if ( sp->hintmask!=NULL )
+		hash = ValidateHashBytes(hash,*sp->hintmask,sizeof(HintMask));
+	    else
+		hash = ValidateHashInt(hash,'n');
+	    if ( (s = sp->next)==NULL ) {
+		hash = ValidateHashInt(hash,'o');
+	break;
+	    }
+	    hash = ValidateHashInt(hash,s->order2 | (s->knownlinear<<1) | (s->acceptableextrema<<2));
+	    sp = s->to;
+	    if ( sp==ss->first )
+	break;
+	}
+    }
+return( ValidateHashInt(hash,'e') );
+}
+
+static uint64_t SCValidateHash(SplineChar *sc, int layer) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    SplineFont *sf = sc->parent;
+    struct ttf_table *tab;
+    StemInfo *h;
+    RefChar *r;
+    int i;
+
+    hash = ValidateHashInt(hash,VALIDATE_CACHE_VERSION);
+    hash = ValidateHashBytes(hash,sc->name,strlen(sc->name)+1);
+    hash = ValidateHashInt(hash,allow_utf8_glyphnames);
+    hash = ValidateHashInt(hash,sf->ascent+sf->descent);
+    hash = ValidateHashReal(hash,sf->extrema_bound);
+    if ( (tab = SFFindTable(sf,CHR('m','a','x','p')))!=NULL && tab->len>=32 ) {
+	hash = ValidateHashBytes(hash,tab->data,tab->len);
+	hash = ValidateHashInt(hash,sc->ttf_instrs_len);
+    } else
+	tab = NULL;
+    hash = ValidateHashSplines(hash,sc->layers[layer].splines);
+    for ( r=sc->layers[layer].refs; r!=NULL; r=r->next ) {
+	for ( i=0; i<6; ++i )
+	    hash = ValidateHashReal(hash,r->transform[i]);
+	hash = ValidateHashSplines(hash,r->layers[0].splines);
+	if ( tab!=NULL )
+	    hash = ValidateHashInt(hash,RefDepth(r,layer));
+    }
+    for ( h=sc->hstem; h!=NULL; h=h->next ) {
+	hash = ValidateHashReal(hash,h->start);
+	hash = ValidateHashReal(hash,h->width);
+    }
+    hash = ValidateHashInt(hash,'h');
+    for ( h=sc->vstem; h!=NULL; h=h->next ) {
+	hash = ValidateHashReal(hash,h->start);
+	hash = ValidateHashReal(hash,h->width);
+    }
+return( hash );
+}
+
+/* Results of SCValidateOutlines by glyph hash, sorted by hash */
+struct validatecache {
+    uint64_t *hashes;
+    uint32_t *states;
+    int cnt;
+};
+
+static void ValidateCacheLoad(struct validatecache *cache, const char *filename) {
+    FILE *file = fopen(filename,"r");
+    uint64_t hash;
+    uint32_t state;
+    int version, max = 0;
+
+    memset(cache,0,sizeof(*cache));
+    if ( file==NULL )
+return;
+    if ( fscanf(file,"FontForge validation cache %d",&version)==1 &&
+	    version==VALIDATE_CACHE_VERSION ) {
+	while ( fscanf(file,"%" SCNx64 " %" SCNx32,&hash,&state)==2 ) {
+	    if ( cache->cnt>0 && hash<=cache->hashes[cache->cnt-1] )
+	break;			/* Not written by us */
+	    if ( cache->cnt>=max ) {
+		max += 1024;
+		cache->hashes = realloc(cache->hashes,max*sizeof(uint64_t));
+		cache->states = realloc(cache->states,max*sizeof(uint32_t));
+	    }
+	    cache->hashes[cache->cnt] = hash;
+	    cache->states[cache->cnt++] = state;
+	}
+    }
+    fclose(file);
+}
+
+static int ValidateCacheFind(struct validatecache *cache, uint64_t hash) {
+    int low = 0, high = cache->cnt-1, mid;
+
+    while ( low<=high ) {
+	mid = (low+high)/2;
+	if ( cache->hashes[mid]==hash )
+return( mid );
+	else if ( cache->hashes[mid]<hash )
+	    low = mid+1;
+	else
+	    high = mid-1;
+    }
+return( -1 );
+}
+
+struct validatejob {
+    SplineChar *sc;
+    uint64_t hash;
+    int state;
+    unsigned int validate: 1;	/* Needs validating */
+    unsigned int cached: 1;	/* The cache knows its hash */
+};
+
+struct validatework {
+    struct validatejob *jobs;
+    int layer;
+    struct validatecache *cache;	/* NULL if there is no cache */
+    int force;			/* Only refresh the cache, don't use it */
+    int base;
+    double *times;		/* vc_max for each job of the batch */
+};
+
+static void ValidateRange(void *data, int start, int end) {
+    struct validatework *vw = data;
+    struct validatejob *job;
+    int i, pos;
+
+    for ( i=start; i<end; ++i ) {
+	job = &vw->jobs[vw->base+i];
+	if ( vw->cache!=NULL ) {
+	    job->hash = SCValidateHash(job->sc,vw->layer);
+	    if ( !vw->force && (pos = ValidateCacheFind(vw->cache,job->hash))!=-1 ) {
+		job->state = (int) vw->cache->states[pos];
+		job->cached = true;
+	continue;
+	    }
+	}
+	if ( job->validate )
+	    job->state = SCValidateOutlines(job->sc,vw->layer,vw->times+i*vc_max);
+    }
+}
+
+static int jobhashcmp(const void *_j1, const void *_j2) {
+    const struct validatejob *j1 = _j1, *j2 = _j2;
+
+    if ( j1->hash!=j2->hash )
+return( j1->hash<j2->hash ? -1 : 1 );
+return( 0 );
+}
+
+/* Remembers the glyphs validated now, and those which were already cached */
+/*  and are still in the font. Only writes the file if that has changed */
+static void ValidateCacheSave(struct validatecache *cache, const char *filename,
+	struct validatejob *jobs, int cnt) {
+    struct validatejob *keep = malloc((cnt+1)*sizeof(struct validatejob));
+    int i, kcnt = 0, same;
+    FILE *file;
+
+    for ( i=0; i<cnt; ++i )
+	if ( jobs[i].validate || jobs[i].cached )
+	    keep[kcnt++] = jobs[i];
+    qsort(keep,kcnt,sizeof(struct validatejob),jobhashcmp);
+    for ( i=1, same=kcnt>0; i<kcnt; ++i )
+	if ( keep[i].hash!=keep[same-1].hash )
+	    keep[same++] = keep[i];
+    kcnt = same;
+
+    same = kcnt==cache->cnt;
+    for ( i=0; i<kcnt && same; ++i )
+	same = keep[i].hash==cache->hashes[i] && (uint32_t) keep[i].state==cache->states[i];
+    if ( !same && (file = fopen(filename,"w"))!=NULL ) {
+	fprintf(file,"FontForge validation cache %d\n",VALIDATE_CACHE_VERSION);
+	for ( i=0; i<kcnt; ++i )
+	    fprintf(file,"%016" PRIx64 " %" PRIx32 "\n",keep[i].hash,(uint32_t) keep[i].state);
+	if ( fclose(file)!=0 )
+	    LogError(_("Could not write the validation cache %s"),filename);
+    } else if ( !same )
+	LogError(_("Could not write the validation cache %s"),filename);
+    free(keep);
+}
+
+struct dupkey {
+    const char *name;
+    int uni, vs;
+    int index;
+};
+
+static int dupnamecmp(const void *_k1, const void *_k2) {
+    const struct dupkey *k1 = _k1, *k2 = _k2;
+return( strcmp(k1->name,k2->name) );
+}
+
+static int dupunicmp(const void *_k1, const void *_k2) {
+    const struct dupkey *k1 = _k1, *k2 = _k2;
+
+    if ( k1->uni!=k2->uni )
+return( k1->uni<k2->uni ? -1 : 1 );
+    if ( k1->vs!=k2->vs )
+return( k1->vs<k2->vs ? -1 : 1 );
+return( 0 );
+}
+
+/* Marks every key which another glyph shares */
+static void DupMark(struct dupkey *keys, int cnt, int (*cmp)(const void *,const void *),
+	int *dups, int flag) {
+    int i, j, k;
+
+    qsort(keys,cnt,sizeof(struct dupkey),cmp);
+    for ( i=0; i<cnt; i=j ) {
+	for ( j=i+1; j<cnt && cmp(&keys[i],&keys[j])==0; ++j );
+	for ( k=i+1; k<j && keys[k].index==keys[i].index; ++k );
+	if ( k<j )
+	    for ( k=i; k<j; ++k )
+		dups[keys[k].index] |= flag;
+    }
+}
+
+static void DupAddKey(struct dupkey **keys, int *cnt, int *max, int uni, int vs, int index) {
+    if ( *cnt>=*max )
+	*keys = realloc(*keys,(*max += 1000)*sizeof(struct dupkey));
+    (*keys)[*cnt].uni = uni;
+    (*keys)[*cnt].vs = vs;
+    (*keys)[(*cnt)++].index = index;
+}
+
+/* The same as SCValidateDups on every glyph, but by sorting rather than */
+/*  comparing each glyph with all the others */
+static int *SFValidateDups(struct validatejob *jobs, int cnt) {
+    int *dups = calloc(cnt,sizeof(int));
+    struct dupkey *keys;
+    struct altuni *alt;
+    SplineChar *sc;
+    int i, kcnt, max = cnt;
+
+    keys = malloc(cnt*sizeof(struct dupkey));
+    for ( i=0; i<cnt; ++i ) {
+	keys[i].name = jobs[i].sc->name;
+	keys[i].index = i;
+    }
+    DupMark(keys,cnt,dupnamecmp,dups,vs_dupname);
+
+    for ( i=kcnt=0; i<cnt; ++i ) {
+	sc = jobs[i].sc;
+	if ( sc->unicodeenc!=-1 )
+	    DupAddKey(&keys,&kcnt,&max,sc->unicodeenc,-1,i);
+	for ( alt=sc->altuni; alt!=NULL; alt=alt->next )
+	    DupAddKey(&keys,&kcnt,&max,alt->unienc,alt->vs,i);
+    }
+    DupMark(keys,kcnt,dupunicmp,dups,vs_dupunicode);
+    free(keys);
+return( dups );
+}
+
+int SFValidateCached(SplineFont *sf, int layer, int force, const char *cachefile) {
+    int k, gid, i, bcnt;
     SplineFont *sub;
     int any = 0;
     SplineChar *sc;
-    int cnt=0;
+    int cnt=0, jcnt, *dups;
+    struct validatejob *jobs;
+    struct validatecache cache;
+    struct validatework vw;
+    struct vtimer vt;
 
     if ( sf->cidmaster )
 	sf = sf->cidmaster;
 
-    if ( !no_windowing_ui ) {
-	cnt = 0;
-	k = 0;
-	do {
-	    sub = sf->subfontcnt==0 ? sf : sf->subfonts[k];
-	    for ( gid=0; gid<sub->glyphcnt; ++gid ) if ( (sc=sub->glyphs[gid])!=NULL ) {
-		if ( force || !(sc->layers[layer].validation_state&vs_known) )
-		    ++cnt;
-	    }
-	    ++k;
-	} while ( k<sf->subfontcnt );
-	if ( cnt!=0 )
-	    ff_progress_start_indicator(10,_("Validating..."),_("Validating..."),0,cnt,1);
+    memset(validate_times,0,sizeof(validate_times));
+    for ( k=jcnt=0; k==0 || k<sf->subfontcnt; ++k ) {
+	sub = sf->subfontcnt==0 ? sf : sf->subfonts[k];
+	for ( gid=0; gid<sub->glyphcnt; ++gid ) if ( sub->glyphs[gid]!=NULL )
+	    ++jcnt;
     }
-
-    k = 0;
-    do {
+    jobs = calloc(jcnt,sizeof(struct validatejob));
+    for ( k=jcnt=0; k==0 || k<sf->subfontcnt; ++k ) {
 	sub = sf->subfontcnt==0 ? sf : sf->subfonts[k];
 	for ( gid=0; gid<sub->glyphcnt; ++gid ) if ( (sc=sub->glyphs[gid])!=NULL ) {
+	    jobs[jcnt].sc = sc;
 	    if ( force || !(sc->layers[layer].validation_state&vs_known) ) {
-		SCValidate(sc,layer,true);
-		if ( !ff_progress_next())
+		jobs[jcnt].validate = true;
+		++cnt;
+	    }
+	    ++jcnt;
+	}
+    }
+    if ( !no_windowing_ui && cnt!=0 )
+	ff_progress_start_indicator(10,_("Validating..."),_("Validating..."),0,cnt,1);
+
+    if ( cachefile!=NULL )
+	ValidateCacheLoad(&cache,cachefile);
+    VTimerStart(&vt,validate_times);
+    dups = cnt!=0 ? SFValidateDups(jobs,jcnt) : NULL;
+    VTimerMark(&vt,vc_duplicates);
+
+    vw.jobs = jobs;
+    vw.layer = layer;
+    vw.cache = cachefile!=NULL ? &cache : NULL;
+    vw.force = force;
+    vw.times = malloc(VALIDATE_BATCH*vc_max*sizeof(double));
+    for ( vw.base=0; vw.base<jcnt; vw.base += VALIDATE_BATCH ) {
+	bcnt = jcnt-vw.base<VALIDATE_BATCH ? jcnt-vw.base : VALIDATE_BATCH;
+	memset(vw.times,0,bcnt*vc_max*sizeof(double));
+	ParallelFor(bcnt,ValidateRange,&vw);
+	for ( i=0; i<bcnt*vc_max; ++i )
+	    validate_times[i%vc_max] += vw.times[i];
+
+	VTimerStart(&vt,validate_times);
+	for ( i=vw.base; i<vw.base+bcnt; ++i ) {
+	    sc = jobs[i].sc;
+	    if ( jobs[i].validate ) {
+		sc->layers[layer].validation_state = jobs[i].state | dups[i];
+		VTimerMark(&vt,vc_duplicates);
+		sc->layers[layer].validation_state |= SCValidateLookups(sc);
+		VTimerMark(&vt,vc_lookups);
+		SCValidateDone(sc,layer,&vt);
+		if ( !ff_progress_next()) {
+		    free(vw.times);
+		    free(dups);
+		    free(jobs);
+		    if ( cachefile!=NULL ) {
+			free(cache.hashes);
+			free(cache.states);
+		    }
 return( -1 );
-	    } else if ( SCValidateAnchors(sc)!=NULL )
-		sc->layers[layer].validation_state |= vs_missinganchor;
+		}
+	    } else {
+		if ( SCValidateAnchors(sc)!=NULL )
+		    sc->layers[layer].validation_state |= vs_missinganchor;
+		VTimerMark(&vt,vc_anchors);
+	    }
 
 	    if ( sc->unlink_rm_ovrlp_save_undo )
 		any |= sc->layers[layer].validation_state&~vs_selfintersects;
 	    else
 		any |= sc->layers[layer].validation_state;
 	}
-	++k;
-    } while ( k<sf->subfontcnt );
+    }
     ff_progress_end_indicator();
 
+    if ( cachefile!=NULL ) {
+	ValidateCacheSave(&cache,cachefile,jobs,jcnt);
+	free(cache.hashes);
+	free(cache.states);
+    }
+    free(vw.times);
+    free(dups);
+    free(jobs);
+
     /* a lot of asian ttf files have a bad postscript fontname stored in the */
     /*  name table */
 return( any&~vs_known );
 }
 
+int SFValidate(SplineFont *sf, int layer, int force) {
+return( SFValidateCached(sf,layer,force,NULL) );
+}
+
+void SFValidationTimes(double times[vc_max]) {
+    memcpy(times,validate_times,sizeof(validate_times));
+}
+
 void SCTickValidationState(SplineChar *sc,int layer) {
     struct splinecharlist *dlist;
 
@@ -409,6 +409,8 @@ typedef struct undoes {
         uint8_t* bitmap;
     } u;
     struct splinefont* copied_from;
+    size_t bytes;        /* Counted in UndoMemory(), if on an undo list */
+    unsigned int serial; /* Undoes with lower serials were made earlier */
 } Undoes;
 
 typedef struct layer /* : reflayer */ {
@@ -41,6 +41,7 @@
 #include "gutils.h"
 #include "ikarus.h"
 #include "macbinary.h"
+#include "mm.h"
 #include "namelist.h"
 #include "palmfonts.h"
 #include "parsepdf.h"
@@ -48,6 +49,7 @@
 #include "parsettf.h"
 #include "psfont.h"
 #include "pua.h"
+#include "scriptserver.h"
 #include "sfd.h"
 #include "splinefill.h"
 #include "splinesaveafm.h"
@@ -236,6 +238,13 @@ return( NULL );
 	gid = -1;
     else
 	gid = map->map[enc];
+    if ( sf->mm!=NULL && gid!=-1 && sf->glyphs[gid]==NULL ) {
+	/* It may be an instance glyph we haven't made yet */
+	int j;
+	for ( j=0; j<sf->mm->instance_count; ++j )
+	    if ( sf->mm->instances[j]==sf )
+		MMInstanceGlyph(sf->mm,j,gid);
+    }
     if ( sf->mm!=NULL && (gid==-1 || sf->glyphs[gid]==NULL) ) {
 	int j;
 	_SFMakeChar(sf->mm->normal,map,enc);
@@ -1327,6 +1336,8 @@ return( NULL );
     sf = FontWithThisFilename(fname);
     if ( sf==NULL && *fname!='/' )
 	fname = tobefreed2 = GFileGetAbsoluteName(fname);
+    if ( sf==NULL )
+	sf = ScriptServerFont(fname,openflags);
     if ( sf==NULL )
 	sf = ReadSplineFont(fname,openflags);
 
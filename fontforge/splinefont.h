@@ -499,6 +499,7 @@ typedef struct kernclass {
     DeviceTable *adjusts;		/* array of first_cnt*second_cnt entries representing resolution-specific adjustments */
     struct kernclass *next;		// Note that, in most cases, a typeface needs only one struct kernclass since it can contain all classes.
     int feature; // This indicates whether the kerning class came from a feature file. This is important during export.
+    struct kernclassmap *map;		/* Glyph ids to classes, built when needed */
 } KernClass;
 
 typedef struct generic_pst {
@@ -932,6 +933,12 @@ enum validation_state { vs_unknown = 0,
 	vs_maskfindproblems = 0x1be | vs_pointstoofarapart | vs_nonintegral | vs_missinganchor | vs_overlappedhints
 	};
 
+/* The checks validation makes, SFValidationTimes says how long each took */
+enum validate_check { vc_glyphname, vc_lookups, vc_opencontour, vc_selfintersects,
+	vc_direction, vc_references, vc_hints, vc_points, vc_extrema, vc_maxp,
+	vc_duplicates, vc_anchors, vc_max };
+extern const char *validate_check_names[vc_max];
+
 struct splinecharlist { struct splinechar *sc; struct splinecharlist *next;};
 
 struct altuni { struct altuni *next; int32_t unienc, vs; uint32_t fid; };
@@ -1349,6 +1356,8 @@ typedef struct splinefont {
 	    /* ufo_descent is negative */
     struct sfundoes *undoes;
     int preferred_kerning; // 1 for U. F. O. native, 2 for feature file, 0 undefined. Input functions shall flag 2, I think. This is now in S. F. D. in order to round-trip U. F. O. consistently.
+    struct lookup_classes *lookup_classes;	/* Compiled glyph classes for applying lookups */
+    struct ttf_approx_cache *ttf_approx;	/* Quadratic outlines from the last truetype output, for reuse */
 } SplineFont;
 
 struct axismap {
@@ -1383,6 +1392,8 @@ typedef struct mmset {
     char *cdv, *ndv;	/* for adobe */
     int named_instance_count;
     struct named_instance *named_instances;
+    struct gvar_cache *gvar_cache;	/* gvar data from the last output, for reuse */
+    struct mmdeltas *deltas;	/* Unmade instance glyphs of a font read from gvar */
     unsigned int changed: 1;
     unsigned int apple: 1;
 } MMSet;
@@ -1711,6 +1722,7 @@ extern void *FreeTypeFontContext(SplineFont *sf,SplineChar *sc,struct fontviewba
 extern BDFFont *SplineFontFreeTypeRasterize(void *freetypecontext,int pixelsize,int depth);
 extern BDFChar *SplineCharFreeTypeRasterize(void *freetypecontext,int gid,
 	int ptsize, int dpi,int depth);
+extern void *FreeTypeThreadContext(void *shared_ftc);
 extern void FreeTypeFreeContext(void *freetypecontext);
 extern SplineSet *FreeType_GridFitChar(void *single_glyph_context,
 	int enc, real ptsizey, real ptsizex, int dpi, uint16_t *width,
@@ -1798,6 +1810,7 @@ extern void PyFF_ErrorString(const char *msg,const char *str);
 extern void PyFF_ErrorF3(const char *frmt, const char *str, int size, int depth);
 extern void PyFF_Stdin(int no_inits, int no_plugins);
 extern void PyFF_Main(int argc,char **argv,int start, int no_init, int no_plugins);
+extern int PyFF_Fork(void);
 extern void PyFF_ScriptFile(struct fontviewbase *fv,SplineChar *sc,char *filename);
 extern void PyFF_ScriptString(struct fontviewbase *fv,SplineChar *sc,int layer,char *str);
 extern void PyFF_FreeFV(struct fontviewbase *fv);
@@ -1805,6 +1818,7 @@ extern void PyFF_FreeSC(SplineChar *sc);
 void PyFF_FreeSCLayer(SplineChar *sc, int layer);
 extern void PyFF_FreeSF(SplineFont *sf);
 extern void PyFF_FreePythonPersistent(void *python_persistent);
+extern size_t PyFF_PersistentBytes(void *python_persistent);
 extern void PyFF_ProcessInitFiles(int no_inits, int no_plugins);
 extern char *PyFF_PickleMeToString(void *pydata);
 extern void *PyFF_UnPickleMeToObjects(char *str);
@@ -1836,6 +1850,8 @@ extern AnchorClass *SCValidateAnchors(SplineChar *sc);
 extern void SCTickValidationState(SplineChar *sc,int layer);
 extern int ValidatePrivate(SplineFont *sf);
 extern int SFValidate(SplineFont *sf, int layer, int force);
+extern int SFValidateCached(SplineFont *sf, int layer, int force, const char *cachefile);
+extern void SFValidationTimes(double times[vc_max]);
 extern enum validation_state VSMaskFromFormat(SplineFont *sf, int layer, enum fontformat format);
 
 extern char *RandomParaFromScript(uint32_t script, uint32_t *lang, SplineFont *sf);
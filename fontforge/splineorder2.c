@@ -30,6 +30,8 @@
 #include "splineorder2.h"
 
 #include "fontforge.h"
+#include "fvfonts.h"
+#include "parallel.h"
 #include "splinerefigure.h"
 #include "splineutil.h"
 #include "splineutil2.h"
@@ -718,7 +720,253 @@ return( sp );
 return( NULL );
 }
 
-static SplinePoint *ttfApprox(Spline *ps, SplinePoint *start) {
+/* ************************************************************************** */
+/* The conversion above hunts for a good approximation to a cubic. When the */
+/*  QuadraticTolerance preference is set we use a different approach which */
+/*  knows how close it will be. A cubic is replaced by n quadratics whose */
+/*  on curve points lie half way between successive control points, so */
+/*  (as truetype allows) they are implied and only the n control points */
+/*  matter. We look for the smallest n whose quadratics stay within the */
+/*  tolerance of the cubic. The error is found by writing the difference */
+/*  of a cubic and a (degree raised) quadratic as a cubic, and cutting that */
+/*  in half until its control points are all within the tolerance of zero */
+/*  or some point on it is not. */
+/* The same thing works for several masters of a design at once, we just */
+/*  want the smallest n that works for all of them so they stay compatible */
+/* ************************************************************************** */
+
+float QuadraticTolerance = 0;
+
+#define QUAD_MAX_N	100
+
+typedef struct qpt {
+    bigreal x, y;
+} QPt;
+
+static int QErrorInside(QPt p0, QPt p1, QPt p2, QPt p3, bigreal tol, int depth) {
+    QPt mid, d3, a, b;
+
+    if ( hypot(p1.x,p1.y)<=tol && hypot(p2.x,p2.y)<=tol )
+return( true );
+    mid.x = (p0.x+3*(p1.x+p2.x)+p3.x)/8;
+    mid.y = (p0.y+3*(p1.y+p2.y)+p3.y)/8;
+    if ( hypot(mid.x,mid.y)>tol || depth>=12 )
+return( false );
+    d3.x = (p3.x+p2.x-p1.x-p0.x)/8;
+    d3.y = (p3.y+p2.y-p1.y-p0.y)/8;
+    a.x = (p0.x+p1.x)/2; a.y = (p0.y+p1.y)/2;
+    b.x = mid.x-d3.x; b.y = mid.y-d3.y;
+    if ( !QErrorInside(p0,a,b,mid,tol,depth+1) )
+return( false );
+    a.x = mid.x+d3.x; a.y = mid.y+d3.y;
+    b.x = (p2.x+p3.x)/2; b.y = (p2.y+p3.y)/2;
+return( QErrorInside(mid,a,b,p3,tol,depth+1) );
+}
+
+/* Does the quadratic q0,q1,q2 lie within tol of the cubic c? */
+static int QFitsCubic(const QPt *c, QPt q0, QPt q1, QPt q2, bigreal tol) {
+    QPt d0, d1, d2, d3;
+
+    d0.x = q0.x-c[0].x; d0.y = q0.y-c[0].y;
+    d1.x = q0.x+(q1.x-q0.x)*2/3-c[1].x; d1.y = q0.y+(q1.y-q0.y)*2/3-c[1].y;
+    d2.x = q2.x+(q1.x-q2.x)*2/3-c[2].x; d2.y = q2.y+(q1.y-q2.y)*2/3-c[2].y;
+    d3.x = q2.x-c[3].x; d3.y = q2.y-c[3].y;
+    if ( hypot(d3.x,d3.y)>tol )
+return( false );
+return( QErrorInside(d0,d1,d2,d3,tol,0) );
+}
+
+static void SplineControlPoints(Spline *ps, QPt c[4]) {
+    c[0].x = ps->from->me.x;	c[0].y = ps->from->me.y;
+    c[1].x = ps->from->nextcp.x;	c[1].y = ps->from->nextcp.y;
+    c[2].x = ps->to->prevcp.x;	c[2].y = ps->to->prevcp.y;
+    c[3].x = ps->to->me.x;	c[3].y = ps->to->me.y;
+}
+
+/* The control points of the piece of cubic c between t0 and t1 */
+static void CubicPiece(const QPt *c, bigreal t0, bigreal t1, QPt *p) {
+    bigreal ax = c[3].x-c[0].x+3*(c[1].x-c[2].x), ay = c[3].y-c[0].y+3*(c[1].y-c[2].y);
+    bigreal bx = 3*(c[0].x-2*c[1].x+c[2].x), by = 3*(c[0].y-2*c[1].y+c[2].y);
+    bigreal cx = 3*(c[1].x-c[0].x), cy = 3*(c[1].y-c[0].y);
+    bigreal dt = (t1-t0)/3;
+
+    p[0].x = ((ax*t0+bx)*t0+cx)*t0+c[0].x;
+    p[0].y = ((ay*t0+by)*t0+cy)*t0+c[0].y;
+    p[3].x = ((ax*t1+bx)*t1+cx)*t1+c[0].x;
+    p[3].y = ((ay*t1+by)*t1+cy)*t1+c[0].y;
+    p[1].x = p[0].x + dt*((3*ax*t0+2*bx)*t0+cx);
+    p[1].y = p[0].y + dt*((3*ay*t0+2*by)*t0+cy);
+    p[2].x = p[3].x - dt*((3*ax*t1+2*bx)*t1+cx);
+    p[2].y = p[3].y - dt*((3*ay*t1+2*by)*t1+cy);
+}
+
+/* A quadratic control point for the cubic piece p. The tangents at either */
+/*  end can't both be matched by the pieces we join, so we slide from */
+/*  matching the start tangent at the start of the cubic to matching the */
+/*  end tangent at its end */
+static QPt QControl(const QPt *p, bigreal t) {
+    QPt p1, p2, q;
+
+    p1.x = p[0].x+(p[1].x-p[0].x)*1.5; p1.y = p[0].y+(p[1].y-p[0].y)*1.5;
+    p2.x = p[3].x+(p[2].x-p[3].x)*1.5; p2.y = p[3].y+(p[2].y-p[3].y)*1.5;
+    q.x = p1.x+(p2.x-p1.x)*t; q.y = p1.y+(p2.y-p1.y)*t;
+return( q );
+}
+
+/* Fill in the n control points of quadratics approximating the cubic c */
+/*  within tol, if that can be done */
+static int QApprox(const QPt *c, int n, bigreal tol, QPt *q) {
+    QPt p[4], q0, q2;
+    bigreal ax, ay, bx, by, denom, h;
+    int i;
+
+    if ( n==1 ) {
+	/* Where the tangents meet, or if they don't, the best guess at it */
+	ax = c[1].x-c[0].x; ay = c[1].y-c[0].y;
+	bx = c[3].x-c[2].x; by = c[3].y-c[2].y;
+	denom = ax*by-ay*bx;
+	if ( denom!=0 && (ax!=0 || ay!=0) && (bx!=0 || by!=0) ) {
+	    h = (bx*(c[0].y-c[2].y)-by*(c[0].x-c[2].x))/denom;
+	    q[0].x = c[0].x+ax*h; q[0].y = c[0].y+ay*h;
+	} else {
+	    q[0].x = (3*(c[1].x+c[2].x)-c[0].x-c[3].x)/4;
+	    q[0].y = (3*(c[1].y+c[2].y)-c[0].y-c[3].y)/4;
+	}
+return( QFitsCubic(c,c[0],q[0],c[3],tol));
+    }
+
+    /* A retracted handle gives no direction at that end, so there use the */
+    /*  direction of the other end of the piece */
+    for ( i=0; i<n; ++i ) {
+	CubicPiece(c,i/(bigreal) n,(i+1)/(bigreal) n,p);
+	q[i] = QControl(p,i/(bigreal) (n-1));
+	if ( i==0 && q[i].x==c[0].x && q[i].y==c[0].y )
+	    q[i] = QControl(p,1);
+	else if ( i==n-1 && q[i].x==c[3].x && q[i].y==c[3].y )
+	    q[i] = QControl(p,0);
+    }
+    q2 = c[0];
+    for ( i=0; i<n; ++i ) {
+	CubicPiece(c,i/(bigreal) n,(i+1)/(bigreal) n,p);
+	q0 = q2;
+	if ( i<n-1 ) {
+	    q2.x = (q[i].x+q[i+1].x)/2; q2.y = (q[i].y+q[i+1].y)/2;
+	} else
+	    q2 = c[3];
+	if ( !QFitsCubic(p,q0,q[i],q2,tol) )
+return( false );
+    }
+return( true );
+}
+
+/* Are the control points on the line between the end points? */
+static int QIsLinear(const QPt *c) {
+    bigreal dx = c[3].x-c[0].x, dy = c[3].y-c[0].y, len = dx*dx+dy*dy, t;
+    int i;
+
+    if ( len==0 )
+return( false );
+    for ( i=1; i<3; ++i ) {
+	if ( fabs((c[i].x-c[0].x)*dy-(c[i].y-c[0].y)*dx)>.001*sqrt(len) )
+return( false );
+	t = ((c[i].x-c[0].x)*dx+(c[i].y-c[0].y)*dy)/len;
+	if ( t<0 || t>1 )
+return( false );
+    }
+return( true );
+}
+
+/* A line needs no approximating, but when masters must match it may have */
+/*  to be cut into n pieces too */
+static void QLinear(const QPt *c, int n, QPt *q) {
+    int i;
+
+    for ( i=0; i<n; ++i ) {
+	q[i].x = c[0].x+(c[3].x-c[0].x)*(2*i+1)/(2*n);
+	q[i].y = c[0].y+(c[3].y-c[0].y)*(2*i+1)/(2*n);
+    }
+}
+
+static SplinePoint *QuadsToSplines(Spline *ps, SplinePoint *start, QPt *q, int n) {
+    SplinePoint *end;
+    int i;
+
+    for ( i=0; i<n; ++i ) {
+	if ( i==n-1 ) {
+	    end = SplinePointCreate(ps->to->me.x,ps->to->me.y);
+	    end->roundx = ps->to->roundx; end->roundy = ps->to->roundy;
+	    end->dontinterpolate = ps->to->dontinterpolate;
+	} else
+	    end = SplinePointCreate((q[i].x+q[i+1].x)/2,(q[i].y+q[i+1].y)/2);
+	start->nextcp.x = end->prevcp.x = q[i].x;
+	start->nextcp.y = end->prevcp.y = q[i].y;
+	start->nonextcp = end->noprevcp = false;
+	SplineMake2(start,end);
+	start = end;
+    }
+return( start );
+}
+
+static SplinePoint *ToleranceApprox(Spline *ps, SplinePoint *start, bigreal tol) {
+    QPt c[4], q[QUAD_MAX_N];
+    int n;
+
+    SplineControlPoints(ps,c);
+    if ( ps->knownlinear || QIsLinear(c) )
+return( LinearSpline(ps,start,1));
+    for ( n=1; n<=QUAD_MAX_N; ++n )
+	if ( QApprox(c,n,tol,q) )
+return( QuadsToSplines(ps,start,q,n));
+return( NULL );
+}
+
+/* Approximates corresponding splines of cnt masters with the same number */
+/*  of quadratics. Returns false if it couldn't, leaving starts alone */
+static int ToleranceApproxCompatible(Spline **pss, SplinePoint **starts,
+	int cnt, bigreal tol) {
+    QPt (*c)[4] = malloc(cnt*sizeof(QPt [4]));
+    QPt *q = malloc(cnt*QUAD_MAX_N*sizeof(QPt));
+    uint8_t *linear = malloc(cnt);
+    int i, last, n, alllinear = true;
+
+    for ( i=0; i<cnt; ++i ) {
+	SplineControlPoints(pss[i],c[i]);
+	linear[i] = pss[i]->knownlinear || QIsLinear(c[i]);
+	if ( !linear[i] )
+	    alllinear = false;
+    }
+    if ( alllinear ) {
+	for ( i=0; i<cnt; ++i )
+	    starts[i] = LinearSpline(pss[i],starts[i],1);
+	free(c); free(q); free(linear);
+return( true );
+    }
+    /* Go round the masters increasing n until it works for all of them */
+    n = 1;
+    i = last = 0;
+    for (;;) {
+	if ( linear[i] )
+	    QLinear(c[i],n,q+i*QUAD_MAX_N);
+	else if ( !QApprox(c[i],n,tol,q+i*QUAD_MAX_N) ) {
+	    if ( n==QUAD_MAX_N ) {
+		free(c); free(q); free(linear);
+return( false );
+	    }
+	    ++n;
+	    last = i;
+    continue;
+	}
+	i = (i+1)%cnt;
+	if ( i==last )
+    break;
+    }
+    for ( i=0; i<cnt; ++i )
+	starts[i] = QuadsToSplines(pss[i],starts[i],q+i*QUAD_MAX_N,n);
+    free(c); free(q); free(linear);
+return( true );
+}
+
+static SplinePoint *ttfApprox(Spline *ps, SplinePoint *start, bigreal tol) {
 #if !defined(FONTFORGE_CONFIG_NON_SYMMETRIC_QUADRATIC_CONVERSION)
     extended magicpoints[6], last;
     int cnt, i, j, qcnt, test_level;
@@ -757,6 +1005,8 @@ static SplinePoint *ttfApprox(Spline *ps, SplinePoint *start) {
 
     if (( ret = AlreadyQuadraticCheck(ps,start))!=NULL )
 return( ret );
+    if ( tol>0 && (ret = ToleranceApprox(ps,start,tol))!=NULL )
+return( ret );
 
 #if !defined(FONTFORGE_CONFIG_NON_SYMMETRIC_QUADRATIC_CONVERSION)
     qcnt = 1;
@@ -851,34 +1101,34 @@ SplinePoint *SplineTtfApprox(Spline *ps) {
     from = chunkalloc(sizeof(SplinePoint));
     *from = *ps->from;
     from->hintmask = NULL;
-    ttfApprox(ps,from);
+    ttfApprox(ps,from,QuadraticTolerance);
 return( from );
 }
 
-SplineSet *SSttfApprox(SplineSet *ss) {
-    SplineSet *ret = chunkalloc(sizeof(SplineSet));
-    Spline *spline, *first;
+static SplinePoint *SPApproxStart(SplinePoint *sp) {
+    SplinePoint *ret = chunkalloc(sizeof(SplinePoint));
 
-    ret->first = chunkalloc(sizeof(SplinePoint));
-    *ret->first = *ss->first;
-    if ( ret->first->hintmask != NULL ) {
-	ret->first->hintmask = chunkalloc(sizeof(HintMask));
-	memcpy(ret->first->hintmask,ss->first->hintmask,sizeof(HintMask));
+    *ret = *sp;
+    ret->next = ret->prev = NULL;
+    ret->name = copy(sp->name);
+    if ( ret->hintmask != NULL ) {
+	ret->hintmask = chunkalloc(sizeof(HintMask));
+	memcpy(ret->hintmask,sp->hintmask,sizeof(HintMask));
     }
-    ret->last = ret->first;
+return( ret );
+}
 
-    first = NULL;
-    for ( spline=ss->first->next; spline!=NULL && spline!=first; spline=spline->to->next ) {
-	ret->last = ttfApprox(spline,ret->last);
-	ret->last->ptindex = spline->to->ptindex;
-	ret->last->ttfindex = spline->to->ttfindex;
-	ret->last->nextcpindex = spline->to->nextcpindex;
-	if ( spline->to->hintmask != NULL ) {
-	    ret->last->hintmask = chunkalloc(sizeof(HintMask));
-	    memcpy(ret->last->hintmask,spline->to->hintmask,sizeof(HintMask));
-	}
-	if ( first==NULL ) first = spline;
+static void SPApproxEnd(SplinePoint *to, SplinePoint *from) {
+    to->ptindex = from->ptindex;
+    to->ttfindex = from->ttfindex;
+    to->nextcpindex = from->nextcpindex;
+    if ( from->hintmask != NULL ) {
+	to->hintmask = chunkalloc(sizeof(HintMask));
+	memcpy(to->hintmask,from->hintmask,sizeof(HintMask));
     }
+}
+
+static void SSApproxClose(SplineSet *ss, SplineSet *ret) {
     if ( ss->first==ss->last ) {
 	if ( ret->last!=ret->first ) {
 	    ret->first->prevcp = ret->last->prevcp;
@@ -889,16 +1139,36 @@ SplineSet *SSttfApprox(SplineSet *ss) {
 	    ret->last = ret->first;
 	}
     }
+}
+
+static SplineSet *_SSttfApprox(SplineSet *ss, bigreal tol) {
+    SplineSet *ret = chunkalloc(sizeof(SplineSet));
+    Spline *spline, *first;
+
+    ret->first = SPApproxStart(ss->first);
+    ret->last = ret->first;
+
+    first = NULL;
+    for ( spline=ss->first->next; spline!=NULL && spline!=first; spline=spline->to->next ) {
+	ret->last = ttfApprox(spline,ret->last,tol);
+	SPApproxEnd(ret->last,spline->to);
+	if ( first==NULL ) first = spline;
+    }
+    SSApproxClose(ss,ret);
     ttfCleanup(ret->first);
     SPLCategorizePoints(ret);
 return( ret );
 }
 
-SplineSet *SplineSetsTTFApprox(SplineSet *ss) {
+SplineSet *SSttfApprox(SplineSet *ss) {
+return( _SSttfApprox(ss,QuadraticTolerance));
+}
+
+static SplineSet *_SplineSetsTTFApprox(SplineSet *ss, bigreal tol) {
     SplineSet *head=NULL, *last, *cur;
 
     while ( ss!=NULL ) {
-	cur = SSttfApprox(ss);
+	cur = _SSttfApprox(ss,tol);
 	if ( head==NULL )
 	    head = cur;
 	else
@@ -909,6 +1179,96 @@ SplineSet *SplineSetsTTFApprox(SplineSet *ss) {
 return( head );
 }
 
+SplineSet *SplineSetsTTFApprox(SplineSet *ss) {
+return( _SplineSetsTTFApprox(ss,QuadraticTolerance));
+}
+
+static int SSSplineCnt(SplineSet *ss) {
+    Spline *s, *first = NULL;
+    int cnt = 0;
+
+    for ( s=ss->first->next; s!=NULL && s!=first; s=s->to->next ) {
+	if ( first==NULL ) first = s;
+	++cnt;
+    }
+return( cnt );
+}
+
+/* Do the contours of all the masters have the same number of splines? */
+/*  (though not the same kinds, one master may have a line where another */
+/*  has a curve) */
+static int SSsMatch(SplineSet **sss, int cnt) {
+    SplineSet *ss0, *ss;
+    int i;
+
+    for ( i=1; i<cnt; ++i ) {
+	for ( ss0=sss[0], ss=sss[i]; ss0!=NULL && ss!=NULL; ss0=ss0->next, ss=ss->next ) {
+	    if ( (ss0->first==ss0->last) != (ss->first==ss->last) ||
+		    SSSplineCnt(ss0)!=SSSplineCnt(ss) )
+return( false );
+	}
+	if ( ss0!=NULL || ss!=NULL )
+return( false );
+    }
+return( true );
+}
+
+/* Converts the same contours of cnt masters so that each master gets the */
+/*  same points. Returns false if the contours don't match up, or if some */
+/*  spline can't be approximated, and then converts nothing */
+int SplineSetsTTFApproxCompatible(SplineSet **sss, SplineSet **rets, int cnt, bigreal tol) {
+    SplineSet **ss = malloc(cnt*sizeof(SplineSet *)), **last = calloc(cnt,sizeof(SplineSet *));
+    SplineSet *cur;
+    Spline **pss = malloc(cnt*sizeof(Spline *)), *first;
+    SplinePoint **ends = malloc(cnt*sizeof(SplinePoint *));
+    int i, ok = SSsMatch(sss,cnt);
+
+    for ( i=0; i<cnt; ++i ) {
+	ss[i] = sss[i];
+	rets[i] = NULL;
+    }
+    while ( ok && ss[0]!=NULL ) {
+	for ( i=0; i<cnt; ++i ) {
+	    cur = chunkalloc(sizeof(SplineSet));
+	    cur->first = cur->last = ends[i] = SPApproxStart(ss[i]->first);
+	    if ( last[i]==NULL )
+		rets[i] = cur;
+	    else
+		last[i]->next = cur;
+	    last[i] = cur;
+	    pss[i] = ss[i]->first->next;
+	}
+	first = NULL;
+	while ( pss[0]!=NULL && pss[0]!=first ) {
+	    if ( first==NULL ) first = pss[0];
+	    if ( !(ok = ToleranceApproxCompatible(pss,ends,cnt,tol)) )
+	break;
+	    for ( i=0; i<cnt; ++i ) {
+		SPApproxEnd(ends[i],pss[i]->to);
+		last[i]->last = ends[i];
+		pss[i] = pss[i]->to->next;
+	    }
+	}
+	for ( i=0; i<cnt; ++i ) {
+	    if ( ok ) {
+		/* Points too close together are left alone, removing them */
+		/*  would make the masters differ */
+		SSApproxClose(ss[i],last[i]);
+		SPLCategorizePoints(last[i]);
+	    }
+	    ss[i] = ss[i]->next;
+	}
+    }
+    if ( !ok ) {
+	for ( i=0; i<cnt; ++i ) {
+	    SplinePointListsFree(rets[i]);
+	    rets[i] = NULL;
+	}
+    }
+    free(ss); free(last); free(pss); free(ends);
+return( ok );
+}
+
 static void ImproveB3CPForQuadratic(real from,real *_ncp,real *_pcp,real to) {
     real ncp = *_ncp, pcp = *_pcp;
     real noff, poff;
@@ -1030,13 +1390,7 @@ SplineSet *SplineSetsConvertOrder(SplineSet *ss, int to_order2) {
 return( new );
 }
 
-void SCConvertLayerToOrder2(SplineChar *sc,int layer) {
-    SplineSet *new;
-
-    if ( sc==NULL )
-return;
-
-    new = SplineSetsTTFApprox(sc->layers[layer].splines);
+static void SCSetLayerOrder2(SplineChar *sc,int layer,SplineSet *new) {
     SplinePointListsFree(sc->layers[layer].splines);
     sc->layers[layer].splines = new;
 
@@ -1049,6 +1403,14 @@ return;
     MinimumDistancesFree(sc->md); sc->md = NULL;
 }
 
+void SCConvertLayerToOrder2(SplineChar *sc,int layer) {
+
+    if ( sc==NULL )
+return;
+
+    SCSetLayerOrder2(sc,layer,SplineSetsTTFApprox(sc->layers[layer].splines));
+}
+
 void SCConvertToOrder2(SplineChar *sc) {
     int layer;
 
@@ -1071,27 +1433,176 @@ static void SCConvertRefs(SplineChar *sc,int layer) {
     }
 }
 
-void SFConvertLayerToOrder2(SplineFont *_sf,int layer) {
-    int i, k;
+/* Each job is one glyph, as found in each of cnt masters */
+struct order2_jobs {
+    int cnt, layer;
+    bigreal tol;
+    SplineChar **scs;		/* [job*cnt+master], NULL if a master lacks the glyph */
+    SplineSet **new;		/* Likewise */
+    uint8_t *incompatible;	/* [job] */
+};
+
+static void ConvertOrder2Jobs(void *data, int start, int end) {
+    struct order2_jobs *jobs = data;
+    int i, j, k, gcnt, classes, cnt = jobs->cnt;
+    SplineSet **in = malloc(cnt*sizeof(SplineSet *)), **gin = malloc(cnt*sizeof(SplineSet *));
+    SplineSet **gout = malloc(cnt*sizeof(SplineSet *)), *pair[2];
+    int *group = malloc(cnt*sizeof(int));
+    uint8_t *done = malloc(cnt);
+
+    for ( i=start; i<end; ++i ) {
+	SplineChar **scs = jobs->scs+i*cnt;
+	SplineSet **new = jobs->new+i*cnt;
+	for ( j=0; j<cnt; ++j ) {
+	    done[j] = scs[j]==NULL;
+	    in[j] = scs[j]==NULL ? NULL : scs[j]->layers[jobs->layer].splines;
+	}
+	/* Masters whose contours match up are converted together */
+	classes = 0;
+	for ( j=0; j<cnt; ++j ) if ( !done[j] ) {
+	    gcnt = 0;
+	    for ( k=j; k<cnt; ++k ) if ( !done[k] ) {
+		pair[0] = in[j]; pair[1] = in[k];
+		if ( k==j || SSsMatch(pair,2) ) {
+		    group[gcnt] = k;
+		    gin[gcnt++] = in[k];
+		    done[k] = true;
+		}
+	    }
+	    if ( gcnt>1 && SplineSetsTTFApproxCompatible(gin,gout,gcnt,jobs->tol) ) {
+		for ( k=0; k<gcnt; ++k )
+		    new[group[k]] = gout[k];
+	    } else {
+		for ( k=0; k<gcnt; ++k )
+		    new[group[k]] = _SplineSetsTTFApprox(gin[k],jobs->tol);
+		if ( gcnt>1 )
+		    ++classes;
+	    }
+	    ++classes;
+	}
+	if ( classes>1 )
+	    jobs->incompatible[i] = true;
+    }
+    free(in); free(gin); free(gout); free(group); free(done);
+}
+
+/* Converts a layer of several fonts at once, glyphs being matched by name. */
+/*  If there are several fonts they are masters of one design and each */
+/*  glyph gets the same points in all of them (when its contours match up) */
+static void SFsConvertLayerToOrder2(SplineFont **sfs,int cnt,int layer,bigreal tol) {
+    struct order2_jobs jobs;
+    SplineChar *sc, *other;
     SplineFont *sf;
+    int i, j, k, n, max;
 
-    if ( _sf->cidmaster!=NULL ) _sf=_sf->cidmaster;
-    k = 0;
-    do {
-	sf = _sf->subfonts==NULL ? _sf : _sf->subfonts[k];
-	for ( i=0; i<sf->glyphcnt; ++i ) if ( sf->glyphs[i]!=NULL ) {
-	    SCConvertLayerToOrder2(sf->glyphs[i],layer);
-	    sf->glyphs[i]->ticked = false;
-	    sf->glyphs[i]->changedsincelasthinted = false;
+    max = 0;
+    for ( k=0; k<cnt; ++k ) {
+	max += sfs[k]->glyphcnt;
+	for ( i=0; i<sfs[k]->glyphcnt; ++i ) if ( sfs[k]->glyphs[i]!=NULL )
+	    sfs[k]->glyphs[i]->ticked = false;
+    }
+    jobs.cnt = cnt; jobs.layer = layer; jobs.tol = tol;
+    jobs.scs = calloc(max*cnt,sizeof(SplineChar *));
+    jobs.new = calloc(max*cnt,sizeof(SplineSet *));
+    jobs.incompatible = calloc(max,sizeof(uint8_t));
+    n = 0;
+    for ( k=0; k<cnt; ++k ) for ( i=0; i<sfs[k]->glyphcnt; ++i ) {
+	if ( (sc=sfs[k]->glyphs[i])==NULL || sc->ticked )
+    continue;
+	for ( j=k; j<cnt; ++j ) {
+	    other = j==k ? sc : SFGetChar(sfs[j],-1,sc->name);
+	    if ( other!=NULL && !other->ticked ) {
+		jobs.scs[n*cnt+j] = other;
+		other->ticked = true;
+	    }
 	}
+	++n;
+    }
+
+    ParallelFor(n,ConvertOrder2Jobs,&jobs);
+
+    for ( i=0; i<n; ++i ) {
+	for ( j=0; j<cnt; ++j ) if ( (sc=jobs.scs[i*cnt+j])!=NULL ) {
+	    SCSetLayerOrder2(sc,layer,jobs.new[i*cnt+j]);
+	    sc->ticked = false;
+	    sc->changedsincelasthinted = false;
+	}
+	if ( jobs.incompatible[i] ) {
+	    for ( j=0; jobs.scs[i*cnt+j]==NULL; ++j );
+	    LogError(_("The outlines of %s don't match between masters, so its points will differ between them\n"),
+		    jobs.scs[i*cnt+j]->name);
+	}
+    }
+    free(jobs.scs); free(jobs.new); free(jobs.incompatible);
+
+    for ( k=0; k<cnt; ++k ) {
+	sf = sfs[k];
 	for ( i=0; i<sf->glyphcnt; ++i ) if ( sf->glyphs[i]!=NULL && !sf->glyphs[i]->ticked )
 	    SCConvertRefs(sf->glyphs[i],layer);
 
 	if ( layer!=ly_back )
 	    for ( i=0; i<sf->glyphcnt; ++i ) if ( sf->glyphs[i]!=NULL )
 		SCNumberPoints(sf->glyphs[i],layer);
-	++k;
-    } while ( k<_sf->subfontcnt );
+    }
+}
+
+void SFsConvertToOrder2(SplineFont **sfs,int cnt,bigreal tol) {
+    SplineFont **todo = malloc(cnt*sizeof(SplineFont *));
+    int k, layer, tcnt, max = 0;
+
+    for ( k=0; k<cnt; ++k )
+	if ( sfs[k]->layer_cnt>max ) max = sfs[k]->layer_cnt;
+    for ( layer=0; layer<max; ++layer ) {
+	tcnt = 0;
+	for ( k=0; k<cnt; ++k )
+	    if ( layer<sfs[k]->layer_cnt && !sfs[k]->layers[layer].order2 )
+		todo[tcnt++] = sfs[k];
+	if ( tcnt==0 )
+    continue;
+	SFsConvertLayerToOrder2(todo,tcnt,layer,tol);
+	for ( k=0; k<tcnt; ++k )
+	    todo[k]->layers[layer].order2 = true;
+    }
+    for ( k=0; k<cnt; ++k )
+	if ( !sfs[k]->grid.order2 )
+	    SFConvertGridToOrder2(sfs[k]);
+    free(todo);
+}
+
+/* The masters of a multiple master font are converted together. The older */
+/*  conversion can't keep them compatible, so they always get a tolerance */
+static SplineFont **MMFonts(MMSet *mm,int *cnt) {
+    SplineFont **sfs = malloc((mm->instance_count+1)*sizeof(SplineFont *));
+
+    sfs[0] = mm->normal;
+    memcpy(sfs+1,mm->instances,mm->instance_count*sizeof(SplineFont *));
+    *cnt = mm->instance_count+1;
+return( sfs );
+}
+
+void SFConvertLayerToOrder2(SplineFont *_sf,int layer) {
+    int k, cnt;
+    SplineFont *sf, **sfs;
+
+    if ( _sf->cidmaster!=NULL ) _sf=_sf->cidmaster;
+    if ( _sf->mm!=NULL ) {
+	sfs = MMFonts(_sf->mm,&cnt);
+	for ( k=0; k<cnt; ++k )
+	    if ( layer>=sfs[k]->layer_cnt || sfs[k]->layers[layer].order2 )
+		sfs[k--] = sfs[--cnt];
+	if ( cnt>0 )
+	    SFsConvertLayerToOrder2(sfs,cnt,layer,QuadraticTolerance>0 ? QuadraticTolerance : 1);
+	for ( k=0; k<cnt; ++k )
+	    sfs[k]->layers[layer].order2 = true;
+	free(sfs);
+    } else {
+	k = 0;
+	do {
+	    sf = _sf->subfonts==NULL ? _sf : _sf->subfonts[k];
+	    SFsConvertLayerToOrder2(&sf,1,layer,QuadraticTolerance);
+	    ++k;
+	} while ( k<_sf->subfontcnt );
+    }
     _sf->layers[layer].order2 = true;
 }
 
@@ -1118,8 +1629,15 @@ void SFConvertGridToOrder2(SplineFont *_sf) {
 }
 
 void SFConvertToOrder2(SplineFont *_sf) {
-    int layer;
+    int layer, cnt;
+    SplineFont **sfs;
 
+    if ( _sf->mm!=NULL ) {
+	sfs = MMFonts(_sf->mm,&cnt);
+	SFsConvertToOrder2(sfs,cnt,QuadraticTolerance>0 ? QuadraticTolerance : 1);
+	free(sfs);
+return;
+    }
     for ( layer=0; layer<_sf->layer_cnt; ++layer )
 	SFConvertLayerToOrder2(_sf,layer);
     SFConvertGridToOrder2(_sf);
@@ -7,10 +7,13 @@
 extern "C" {
 #endif
 
+extern float QuadraticTolerance;
+
 extern SplinePoint *SplineTtfApprox(Spline *ps);
 extern SplineSet *SplineSetsConvertOrder(SplineSet *ss, int to_order2);
 extern SplineSet *SplineSetsPSApprox(SplineSet *ss);
 extern SplineSet *SplineSetsTTFApprox(SplineSet *ss);
+extern int SplineSetsTTFApproxCompatible(SplineSet **sss, SplineSet **rets, int cnt, bigreal tol);
 extern SplineSet *SSPSApprox(SplineSet *ss);
 extern SplineSet *SSttfApprox(SplineSet *ss);
 extern Spline *SplineMake2(SplinePoint *from, SplinePoint *to);
@@ -25,6 +28,7 @@ extern void SFConvertLayerToOrder2(SplineFont *_sf, int layer);
 extern void SFConvertLayerToOrder3(SplineFont *_sf, int layer);
 extern void SFConvertToOrder2(SplineFont *_sf);
 extern void SFConvertToOrder3(SplineFont *_sf);
+extern void SFsConvertToOrder2(SplineFont **sfs, int cnt, bigreal tol);
 extern void SplinePointNextCPChanged2(SplinePoint *sp);
 extern void SplinePointPrevCPChanged2(SplinePoint *sp);
 extern void SplineRefigure2(Spline *spline);
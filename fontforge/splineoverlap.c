@@ -90,7 +90,7 @@
 // (The pointers tend to clutter the diff a bit.)
 // #define FF_OVERLAP_VERBOSE
 
-static char *glyphname=NULL;
+static _Thread_local char *glyphname=NULL;
 
 static void SOError(const char *format,...) {
     va_list ap;
@@ -41,6 +41,7 @@
 #include "splinesaveafm.h"
 #include "splineutil.h"
 #include "splineutil2.h"
+#include "trace.h"
 #include "ustring.h"
 #include "utype.h"
 
@@ -3219,6 +3220,7 @@ struct pschars *SplineFont2ChrsSubrs2(SplineFont *sf, int nomwid, int defwid,
     GlyphInfo gi;
     SplineChar dummynotdef;
 
+    TRACE_BEGIN("PS hinting");
     if ( !autohint_before_generate && !(flags&ps_flag_nohints))
 	SplineFontAutoHintRefs(sf,layer);
 
@@ -3256,16 +3258,23 @@ struct pschars *SplineFont2ChrsSubrs2(SplineFont *sf, int nomwid, int defwid,
 	    SplineCharAutoHint(sc,layer,NULL);
 	sc->lsidebearing = 0x7fff;
     }
+    TRACE_END("PS hinting");
+    TRACE_BEGIN("CFF subroutines");
     MarkTranslationRefs(sf,layer);
     SplineFont2FullSubrs2(flags,&gi);
+    TRACE_END("CFF subroutines");
 
-    for ( i=0; i<cnt; ++i ) {
+    TRACE_BEGIN("CFF charstrings");
+    for ( i=scnt=0; i<cnt; ++i ) {
 	if ( (sc = gi.gb[i].sc)==NULL )
     continue;
 	gi.active = &gi.gb[i];
 	SplineChar2PS2(sc,NULL,nomwid,defwid,NULL,flags,&gi);
 	ff_progress_next();
+	++scnt;
     }
+    TRACE_COUNT("charstrings",scnt);
+    TRACE_END("CFF charstrings");
 
     for ( i=scnt=0; i<gi.pcnt; ++i ) {
 	/* A subroutine call takes somewhere between 2 and 4 bytes itself. */
@@ -3453,6 +3462,7 @@ struct pschars *CID2ChrsSubrs2(SplineFont *cidmaster,struct fd2data *fds,
     gi.psubrs = malloc(gi.pmax*sizeof(struct potentialsubrs));
     gi.layer = layer;
 
+    TRACE_BEGIN("CFF charstrings");
     for ( cid = cnt = 0; cid<max; ++cid ) {
 	sf = NULL;
 	for ( i=0; i<cidmaster->subfontcnt; ++i ) {
@@ -3489,6 +3499,8 @@ struct pschars *CID2ChrsSubrs2(SplineFont *cidmaster,struct fd2data *fds,
 	}
 	ff_progress_next();
     }
+    TRACE_COUNT("charstrings",cnt);
+    TRACE_END("CFF charstrings");
 
     scnts = calloc( cidmaster->subfontcnt+1,sizeof(int));
     for ( i=0; i<gi.pcnt; ++i ) {
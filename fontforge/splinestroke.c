@@ -32,6 +32,7 @@
 #include "baseviews.h"
 #include "cvundoes.h"
 #include "fontforge.h"
+#include "parallel.h"
 #include "splinefit.h"
 #include "splinefont.h"
 #include "splineorder2.h"
@@ -58,6 +59,11 @@
 // About .25 degrees
 #define COS_MARGIN (1.5e-5)
 #define MIN_ACCURACY (1e-5)
+// Bounds, angular density and tangent probes for adaptive trace sampling
+#define TRACE_MIN_POINTS 5
+#define TRACE_PROBES 4
+#define TRACE_MAX_POINTS 17
+#define TRACE_STEP_ANGLE (FF_PI/12)
 
 static inline bigreal NormAngle(bigreal a) {
     if ( a > FF_PI )
@@ -1161,7 +1167,7 @@ static bigreal SplineFindCuspSing(StrokeContext *c, Spline *s, bigreal t_fm,
     assert( t_fm < t_to );
     assert( OffsetOnCuspAt(c, s, t_fm, NULL, is_right, is_ccw) == on_cusp );
     assert( OffsetOnCuspAt(c, s, t_to, NULL, is_right, is_ccw) != on_cusp );
-    while ( t_fm-t_to > margin ) {
+    while ( t_to-t_fm > margin ) {
 	t_mid = (t_fm+t_to)/2;
 	cusp_mid = OffsetOnCuspAt(c, s, t_mid, NULL, is_right, is_ccw);
 	if ( cusp_mid==on_cusp )
@@ -1177,45 +1183,74 @@ typedef struct stroketraceinfo {
     Spline *s;
     bigreal cusp_trans;
     int nci_hint;
-    int num_points;
+    int num_points;		/* 0 to choose per interval */
     unsigned int is_right: 1;
     unsigned int starts_on_cusp: 1;
     unsigned int first_pass: 1;
     unsigned int found_trans: 1;
 } StrokeTraceInfo;
 
+/* The offset curve turns exactly as much as the source spline does (the
+ * nib point only changes with the tangent angle), and it is the turning
+ * that a single cubic has trouble following. So rather than sampling every
+ * interval at a fixed density, take a few points on nearly straight
+ * stretches and more where the tangent swings around.
+ */
+static int StrokeTraceSampleCount(Spline *s, bigreal t_fm, bigreal t_to) {
+    bigreal t[TRACE_PROBES+1], turn = 0;
+    BasePoint ut[TRACE_PROBES+1];
+    int i, cnt;
+
+    for ( i=0; i<TRACE_PROBES; ++i )
+	t[i] = t_fm + i*(t_to-t_fm)/TRACE_PROBES;
+    t[TRACE_PROBES] = t_to;
+    SplineUTanVecsAt(s, t, TRACE_PROBES+1, NULL, ut);
+    for ( i=0; i<TRACE_PROBES; ++i )
+	turn += fabs(atan2(BPCross(ut[i], ut[i+1]), BPDot(ut[i], ut[i+1])));
+    cnt = TRACE_MIN_POINTS + (int) ceil(turn/TRACE_STEP_ANGLE);
+    return cnt > TRACE_MAX_POINTS ? TRACE_MAX_POINTS : cnt;
+}
+
 int GenStrokeTracePoints(void *vinfo, bigreal t_fm, bigreal t_to,
                          FitPoint **fpp) {
     StrokeTraceInfo *stip = (StrokeTraceInfo *)vinfo;
-    int i, nib_ccw, on_cusp;
+    int i, nib_ccw, on_cusp, num_points;
     NibOffset no;
     FitPoint *fp;
-    bigreal nidiff, t;
-    BasePoint xy;
+    bigreal nidiff, t[TRACE_MAX_POINTS > 10 ? TRACE_MAX_POINTS : 10];
+    BasePoint xy[sizeof(t)/sizeof(t[0])], ut[sizeof(t)/sizeof(t[0])];
 
     *fpp = NULL;
-    fp = calloc(stip->num_points, sizeof(FitPoint));
-    nidiff = (t_to - t_fm) / (stip->num_points-1);
+    num_points = stip->num_points;
+    if ( num_points<=0 )
+	num_points = StrokeTraceSampleCount(stip->s, t_fm, t_to);
+    assert( num_points>=2 && num_points<=(int)(sizeof(t)/sizeof(t[0])) );
+    fp = calloc(num_points, sizeof(FitPoint));
+    nidiff = (t_to - t_fm) / (num_points-1);
+
+    // Evaluate the spline positions and tangents in one pass, the nib
+    // offsets have to be found in order because each uses the last as a hint
+    for ( i=0; i<num_points-1; ++i )
+	t[i] = t_fm + i*nidiff;
+    t[num_points-1] = t_to; // side-step nidiff rounding errors
+    SplineUTanVecsAt(stip->s, t, num_points, xy, ut);
 
     nib_ccw = SplineTurningCCWAt(stip->s, t_fm);
     no.nci[0] = no.nci[1] = stip->nci_hint;
-    for ( i=0, t=t_fm; i<stip->num_points; ++i, t+=nidiff ) {
-	if ( i==(stip->num_points-1) ) {
+    for ( i=0; i<num_points; ++i ) {
+	if ( i==(num_points-1) )
 	    nib_ccw = !nib_ccw; // Stop at the closer corner
-	    t = t_to; // side-step nidiff rounding errors
-	}
-	xy = SPLINEPVAL(stip->s, t);
-	fp[i].ut = SplineUTanVecAt(stip->s, t);
+	fp[i].ut = ut[i];
 	CalcNibOffset(stip->c, fp[i].ut, stip->is_right, &no, no.nci[nib_ccw]);
-	fp[i].p = BPAdd(xy, no.off[nib_ccw]);
-	fp[i].t = t;
+	fp[i].p = BPAdd(xy[i], no.off[nib_ccw]);
+	fp[i].t = t[i];
 	if ( stip->first_pass ) {
-	    on_cusp = OffsetOnCuspAt(stip->c, stip->s, t, &no,
+	    on_cusp = OffsetOnCuspAt(stip->c, stip->s, t[i], &no,
 	                             stip->is_right, nib_ccw);
 	    if ( on_cusp!=stip->starts_on_cusp ) {
 		stip->found_trans = true;
 		stip->cusp_trans = SplineFindCuspSing(stip->c, stip->s,
-		                                      t-nidiff, t,
+		                                      t[i]-nidiff, t[i],
 		                                      stip->is_right,
 		                                      nib_ccw, CUSPD_MARGIN,
 						      stip->starts_on_cusp);
@@ -1234,7 +1269,7 @@ int GenStrokeTracePoints(void *vinfo, bigreal t_fm, bigreal t_to,
     }
     *fpp = fp;
     stip->first_pass = false;
-    return stip->num_points;
+    return num_points;
 }
 
 #define TRACE_CUSPS false
@@ -1249,7 +1284,7 @@ SplinePoint *TraceAndFitSpline(StrokeContext *c, Spline *s, bigreal t_fm,
     sti.c = c;
     sti.s = s;
     sti.nci_hint = nci_hint;
-    sti.num_points = 10;
+    sti.num_points = 0;
     sti.is_right = is_right;
     sti.first_pass = true;
     sti.starts_on_cusp = on_cusp;
@@ -2654,41 +2689,99 @@ SplineSet *SplineSetStroke(SplineSet *ss,StrokeInfo *si, int order2) {
     return( first );
 }
 
+struct stroke_job {
+    SplineChar *sc;
+    SplineSet *result;
+    int layer;
+};
+
+struct stroke_batch {
+    struct stroke_job *jobs;
+    StrokeInfo *si;
+};
+
+static void StrokeJobs(void *data, int start, int end) {
+    struct stroke_batch *sb = data;
+    struct stroke_job *job;
+    int i;
+
+    for ( i=start; i<end; ++i ) {
+	job = &sb->jobs[i];
+	job->result = SplineSetStroke(job->sc->layers[job->layer].splines,
+	                              sb->si,
+	                              job->sc->layers[job->layer].order2);
+    }
+}
+
 void FVStrokeItScript(void *_fv, StrokeInfo *si,
                       int UNUSED(pointless_argument)) {
     FontViewBase *fv = _fv;
     int layer = fv->active_layer;
-    SplineSet *temp;
-    int i, cnt=0, gid;
-    SplineChar *sc;
+    int i, j, k, cnt=0, gid, scnt, jcnt, jmax, batch, cancelled = false;
+    SplineChar *sc, **scs;
+    struct stroke_batch sb;
 
     for ( i=0; i<fv->map->enccount; ++i ) if ( (gid=fv->map->map[i])!=-1 && fv->sf->glyphs[gid]!=NULL && fv->selected[i] )
 	++cnt;
     ff_progress_start_indicator(10,_("Stroking..."),_("Stroking..."),0,cnt,1);
 
     SFUntickAll(fv->sf);
-    for ( i=0; i<fv->map->enccount; ++i ) {
+    scs = malloc((cnt+1)*sizeof(SplineChar *));
+    for ( i=scnt=0; i<fv->map->enccount; ++i ) {
 	if ( (gid=fv->map->map[i])!=-1 && (sc = fv->sf->glyphs[gid])!=NULL &&
 		!sc->ticked && fv->selected[i] ) {
 	    sc->ticked = true;
+	    scs[scnt++] = sc;
+	}
+    }
+
+    /* Glyphs don't share anything while being stroked, so stroke a batch
+     * of them at a time in parallel and then install the results (with
+     * undoes and change notifications) in order. Batches keep the progress
+     * bar moving and let a cancel take effect part way through. */
+    batch = ParallelThreadCount()*4;
+    sb.si = si;
+    jmax = batch;
+    sb.jobs = malloc(jmax*sizeof(struct stroke_job));
+    for ( i=0; i<scnt && !cancelled; i=j ) {
+	jcnt = 0;
+	for ( j=i; j<scnt && j<i+batch; ++j ) {
+	    sc = scs[j];
+	    if ( jcnt+sc->layer_cnt>jmax ) {
+		jmax = jcnt+sc->layer_cnt+batch;
+		sb.jobs = realloc(sb.jobs,jmax*sizeof(struct stroke_job));
+	    }
 	    if ( sc->parent->multilayer ) {
-		SCPreserveState(sc,false);
-		for ( layer = ly_fore; layer<sc->layer_cnt; ++layer ) {
-		    temp = SplineSetStroke(sc->layers[layer].splines,si,sc->layers[layer].order2);
-		    SplinePointListsFree( sc->layers[layer].splines );
-		    sc->layers[layer].splines = temp;
+		for ( k = ly_fore; k<sc->layer_cnt; ++k ) {
+		    sb.jobs[jcnt].sc = sc;
+		    sb.jobs[jcnt++].layer = k;
 		}
-		SCCharChangedUpdate(sc,ly_all);
 	    } else {
+		sb.jobs[jcnt].sc = sc;
+		sb.jobs[jcnt++].layer = layer;
+	    }
+	}
+	ParallelFor(jcnt,StrokeJobs,&sb);
+	for ( k=0; k<jcnt; ) {
+	    sc = sb.jobs[k].sc;
+	    if ( cancelled ) {
+		SplinePointListsFree(sb.jobs[k++].result);
+	continue;
+	    }
+	    if ( sc->parent->multilayer )
+		SCPreserveState(sc,false);
+	    else
 		SCPreserveLayer(sc,layer,false);
-		temp = SplineSetStroke(sc->layers[layer].splines,si,sc->layers[layer].order2);
-		SplinePointListsFree( sc->layers[layer].splines );
-		sc->layers[layer].splines = temp;
-		SCCharChangedUpdate(sc,layer);
+	    for ( ; k<jcnt && sb.jobs[k].sc==sc; ++k ) {
+		SplinePointListsFree( sc->layers[sb.jobs[k].layer].splines );
+		sc->layers[sb.jobs[k].layer].splines = sb.jobs[k].result;
 	    }
+	    SCCharChangedUpdate(sc,sc->parent->multilayer ? ly_all : layer);
 	    if ( !ff_progress_next())
-    break;
+		cancelled = true;
 	}
     }
+    free(sb.jobs);
+    free(scs);
     ff_progress_end_indicator();
 }
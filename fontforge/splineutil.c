@@ -37,6 +37,7 @@
 #include "fvfonts.h"
 #include "fvimportbdf.h"
 #include "glif_name_hash.h"
+#include "lookups.h"
 #include "mm.h"
 #include "namelist.h"
 #include "parsepfa.h"
@@ -51,6 +52,7 @@
 #include "splineutil.h"
 #include "splineutil2.h"
 #include "tottf.h"
+#include "tottfvar.h"
 #include "ustring.h"
 #include "utype.h"
 #include "baseviews.h"		/* for FindSel structure */
@@ -6150,11 +6152,13 @@ return( NULL );
 
 
     new->next = NULL;
+    new->map = NULL;
 return( new );
 }
 
 void KernClassFreeContents(KernClass *kc) {
     int i;
+    KernClassMapFree(kc);
     for ( i=1; i<kc->first_cnt; ++i )
 	free(kc->firsts[i]);
     for ( i=1; i<kc->second_cnt; ++i )
@@ -6613,6 +6617,9 @@ return;
     OtfFeatNameListFree(sf->feat_names);
     MarkClassFree(sf->mark_class_cnt,sf->mark_classes,sf->mark_class_names);
     MarkSetFree(sf->mark_set_cnt,sf->mark_sets,sf->mark_set_names);
+    if ( sf->cidmaster==NULL )
+	SFClearLookupClasses(sf);
+    TTFApproxCacheFree(sf->ttf_approx);
     GlyphGroupsFree(sf->groups);
     GlyphGroupKernsFree(sf->groupkerns);
     GlyphGroupKernsFree(sf->groupvkerns);
@@ -6972,6 +6979,10 @@ void MMSetFreeContents(MMSet *mm) {
 	MacNameListFree(mm->named_instances[i].names);
     }
     free(mm->named_instances);
+    GvarCacheFree(mm->gvar_cache);
+    mm->gvar_cache = NULL;
+    MMDeltasFree(mm->deltas);
+    mm->deltas = NULL;
 }
 
 void MMSetFree(MMSet *mm) {
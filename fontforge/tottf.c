@@ -44,6 +44,7 @@
 #include "mem.h"
 #include "mm.h"
 #include "parsepfa.h"
+#include "parallel.h"
 #include "parsettfbmf.h"
 #include "splinefill.h"
 #include "splineorder2.h"
@@ -54,6 +55,7 @@
 #include "tottfaat.h"
 #include "tottfgpos.h"
 #include "tottfvar.h"
+#include "trace.h"
 #include "ttf.h"
 #include "ttfspecial.h"
 #include "ustring.h"
@@ -1230,7 +1232,11 @@ return;
 	IError("max glyph count wrong in ttf output");
     gi->loca[gi->next_glyph] = ftell(gi->glyphs);
 
-    ttfss = SCttfApprox(sc,gi->layer);
+    if ( gi->ttfss!=NULL && gi->ttfss[sc->ttf_glyph]!=NULL ) {
+	ttfss = gi->ttfss[sc->ttf_glyph];
+	gi->ttfss[sc->ttf_glyph] = NULL;
+    } else
+	ttfss = SCttfApprox(sc,gi->layer);
     ptcnt = SSTtfNumberPoints(ttfss);
     for ( ss=ttfss, contourcnt=0; ss!=NULL; ss=ss->next ) {
 	++contourcnt;
@@ -1409,6 +1415,200 @@ static int AssignTTFBitGlyph(struct glyphinfo *gi,SplineFont *sf,EncMap *map,int
 return j;
 }
 
+/* Converting cubic outlines is much of the work of generating a truetype */
+/*  font from a PostScript one. So glyphs are converted ahead of time, in */
+/*  parallel, and the results kept on the font keyed by a hash of what they */
+/*  were made from. Generating the font again then only converts the glyphs */
+/*  which have changed. Entries not used by the latest output are dropped */
+#define TTF_APPROX_HASH	257
+
+struct ttf_approx {
+    uint64_t hash;
+    int generation;
+    SplineSet *ss;
+    struct ttf_approx *next;
+};
+
+struct ttf_approx_cache {
+    int generation;
+    struct ttf_approx *table[TTF_APPROX_HASH];
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *pt = data;
+
+    /* FNV-1a */
+    while ( len-->0 ) {
+	hash ^= *pt++;
+	hash *= 0x100000001b3ULL;
+    }
+return( hash );
+}
+
+static uint64_t hash_splines(uint64_t hash, SplineSet *ss) {
+    SplinePoint *sp;
+    int flags;
+
+    for ( ; ss!=NULL; ss=ss->next ) {
+	hash = hash_bytes(hash,"c",1);
+	for ( sp=ss->first; ; ) {
+	    hash = hash_bytes(hash,&sp->me,sizeof(BasePoint));
+	    hash = hash_bytes(hash,&sp->nextcp,sizeof(BasePoint));
+	    hash = hash_bytes(hash,&sp->prevcp,sizeof(BasePoint));
+	    flags = sp->nonextcp | (sp->noprevcp<<1) | (sp->roundx<<2) | (sp->roundy<<3) |
+		    (sp->dontinterpolate<<4) | (sp->hintmask!=NULL)<<5 |
+		    (sp->next!=NULL && sp->next->knownlinear)<<6;
+	    hash = hash_bytes(hash,&flags,sizeof(flags));
+	    hash = hash_bytes(hash,&sp->ptindex,sizeof(sp->ptindex));
+	    hash = hash_bytes(hash,&sp->ttfindex,sizeof(sp->ttfindex));
+	    hash = hash_bytes(hash,&sp->nextcpindex,sizeof(sp->nextcpindex));
+	    if ( sp->hintmask!=NULL )
+		hash = hash_bytes(hash,*sp->hintmask,sizeof(HintMask));
+	    if ( sp->next==NULL )
+	break;
+	    sp = sp->next->to;
+	    if ( sp==ss->first )
+	break;
+	}
+    }
+return( hash_bytes(hash,"e",1) );
+}
+
+static uint64_t SCttfApproxHash(SplineChar *sc,int layer) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    RefChar *ref;
+
+    hash = hash_bytes(hash,&QuadraticTolerance,sizeof(QuadraticTolerance));
+    hash = hash_splines(hash,sc->layers[layer].splines);
+    for ( ref=sc->layers[layer].refs; ref!=NULL; ref=ref->next )
+	hash = hash_splines(hash,ref->layers[0].splines);
+return( hash );
+}
+
+void TTFApproxCacheFree(struct ttf_approx_cache *cache) {
+    struct ttf_approx *e, *next;
+    int i;
+
+    if ( cache==NULL )
+return;
+    for ( i=0; i<TTF_APPROX_HASH; ++i ) {
+	for ( e=cache->table[i]; e!=NULL; e=next ) {
+	    next = e->next;
+	    SplinePointListsFree(e->ss);
+	    free(e);
+	}
+    }
+    free(cache);
+}
+
+struct ttf_approx_job {
+    SplineChar *sc;
+    uint64_t hash;
+    struct ttf_approx *found;
+    SplineSet *ss;
+};
+
+struct ttf_approx_jobs {
+    struct ttf_approx_job *jobs;
+    struct ttf_approx_cache *cache;
+    int layer;
+};
+
+static void TTFApproxJobs(void *data, int start, int end) {
+    struct ttf_approx_jobs *jobs = data;
+    struct ttf_approx_job *job;
+    struct ttf_approx *e;
+    int i;
+
+    /* The cache is only read here, new entries are added afterwards */
+    TRACE_BEGIN("SCttfApprox");
+    for ( i=start; i<end; ++i ) {
+	job = &jobs->jobs[i];
+	job->hash = SCttfApproxHash(job->sc,jobs->layer);
+	for ( e=jobs->cache->table[job->hash%TTF_APPROX_HASH]; e!=NULL && e->hash!=job->hash; e=e->next );
+	job->found = e;
+	job->ss = e!=NULL ? SplinePointListCopy(e->ss) : SCttfApprox(job->sc,jobs->layer);
+    }
+    TRACE_END("SCttfApprox");
+}
+
+static void TTFApproxGlyphs(SplineFont *sf,struct glyphinfo *gi) {
+    SplineFont *master = sf->cidmaster!=NULL ? sf->cidmaster : sf;
+    struct ttf_approx_cache *cache;
+    struct ttf_approx_jobs jobs;
+    struct ttf_approx **pt, *e;
+    SplineChar *sc;
+    int i, cnt, missed = 0;
+
+    if ( gi->onlybitmaps || sf->layers[gi->layer].order2 )
+return;
+    if ( (cache = master->ttf_approx)==NULL )
+	cache = master->ttf_approx = calloc(1,sizeof(struct ttf_approx_cache));
+    ++cache->generation;
+
+    jobs.jobs = malloc(gi->gcnt*sizeof(struct ttf_approx_job));
+    jobs.cache = cache;
+    jobs.layer = gi->layer;
+    for ( i=cnt=0; i<gi->gcnt; ++i ) {
+	if ( gi->bygid[i]==-1 || (sc = sf->glyphs[gi->bygid[i]])==NULL )
+    continue;
+	if ( (sc->layers[gi->layer].splines==NULL && sc->layers[gi->layer].refs==NULL) ||
+		(i!=0 && sc->ttf_glyph<=0) || (i!=0 && IsTTFRefable(sc,gi->layer)) )
+    continue;
+	jobs.jobs[cnt++].sc = sc;
+    }
+
+    ParallelFor(cnt,TTFApproxJobs,&jobs);
+    TRACE_COUNT("glyphs approximated",cnt);
+
+    gi->ttfss = calloc(gi->gcnt,sizeof(SplineSet *));
+    for ( i=0; i<cnt; ++i ) {
+	struct ttf_approx_job *job = &jobs.jobs[i];
+	if ( job->found==NULL ) {
+	    ++missed;
+	    /* Glyphs with the same outlines may both have missed */
+	    for ( e=cache->table[job->hash%TTF_APPROX_HASH]; e!=NULL && e->hash!=job->hash; e=e->next );
+	    if ( e==NULL ) {
+		e = calloc(1,sizeof(struct ttf_approx));
+		e->hash = job->hash;
+		e->ss = SplinePointListCopy(job->ss);
+		e->next = cache->table[job->hash%TTF_APPROX_HASH];
+		cache->table[job->hash%TTF_APPROX_HASH] = e;
+	    }
+	    job->found = e;
+	}
+	job->found->generation = cache->generation;
+	if ( job->sc->ttf_glyph>=0 && job->sc->ttf_glyph<gi->gcnt )
+	    gi->ttfss[job->sc->ttf_glyph] = job->ss;
+	else
+	    SplinePointListsFree(job->ss);
+    }
+    free(jobs.jobs);
+    TRACE_COUNT("approximations not cached",missed);
+
+    for ( i=0; i<TTF_APPROX_HASH; ++i ) {
+	for ( pt=&cache->table[i]; (e=*pt)!=NULL; ) {
+	    if ( e->generation!=cache->generation ) {
+		*pt = e->next;
+		SplinePointListsFree(e->ss);
+		free(e);
+	    } else
+		pt = &e->next;
+	}
+    }
+}
+
+static void TTFApproxGlyphsFree(struct glyphinfo *gi) {
+    int i;
+
+    if ( gi->ttfss==NULL )
+return;
+    for ( i=0; i<gi->gcnt; ++i )
+	SplinePointListsFree(gi->ttfss[i]);
+    free(gi->ttfss);
+    gi->ttfss = NULL;
+}
+
 static int dumpglyphs(SplineFont *sf,struct glyphinfo *gi) {
     int i;
     int fixed = gi->fixed_width;
@@ -1462,6 +1662,10 @@ static int dumpglyphs(SplineFont *sf,struct glyphinfo *gi) {
     if ( fixed>0 ) {
 	gi->hfullcnt = 3;
     }
+    TRACE_BEGIN("quadratic outlines");
+    TTFApproxGlyphs(sf,gi);
+    TRACE_END("quadratic outlines");
+    TRACE_BEGIN("glyf");
     for ( i=0; i<gi->gcnt; ++i ) {
 	if ( i==0 ) {
 	    if ( gi->bygid[0]!=-1 && (fixed<=0 || sf->glyphs[gi->bygid[0]]->width==fixed))
@@ -1489,9 +1693,15 @@ static int dumpglyphs(SplineFont *sf,struct glyphinfo *gi) {
 	    if ( ftell(gi->glyphs)&2 )
 		putshort(gi->glyphs,0);
 	}
-	if ( !ff_progress_next())
+	if ( !ff_progress_next()) {
+	    TTFApproxGlyphsFree(gi);
+	    TRACE_END("glyf");
 return( false );
+	}
     }
+    TTFApproxGlyphsFree(gi);
+    TRACE_COUNT("glyphs written",gi->gcnt);
+    TRACE_END("glyf");
 
     /* extra location entry points to end of last glyph */
     gi->loca[gi->next_glyph] = ftell(gi->glyphs);
@@ -5784,6 +5994,7 @@ return( false );
 
 
     ATmaxpInit(at,sf,format);
+    TRACE_BEGIN("glyphs");
     if ( format==ff_otf )
 	aborted = !dumptype2glyphs(sf,at);
     else if ( format==ff_otfcid )
@@ -5806,6 +6017,7 @@ return( false );
 	if ( bsizes!=NULL && format==ff_none && at->msbitmaps )
 	    ttfdumpbitmapscaling(sf,at,bsizes);
     }
+    TRACE_END("glyphs");
     if ( aborted ) {
 	AbortTTF(at,sf);
 return( false );
@@ -5829,7 +6041,9 @@ return( false );
 	    ttf_fftm_dump(sf,at);
 
     if ( format!=ff_type42 && format!=ff_type42cid && !sf->internal_temp ) {
+	TRACE_BEGIN("layout tables");
 	initATTables(at, sf, format);
+	TRACE_END("layout tables");
     }
     redomaxp(at,format);
     if ( format!=ff_otf && format!=ff_otfcid && format!=ff_none ) {
@@ -5856,6 +6070,7 @@ return( false );
     free( at->gi.bygid );
     at->gi.gcnt = 0;
 
+    TRACE_BEGIN("table assembly");
     buildtablestructures(at,sf,format,flags);
     for ( i=0; i<at->tabdir.numtab; ++i ) {
 	struct taboff *tab = &at->tabdir.tabs[i];
@@ -5928,6 +6143,7 @@ return( false );
 	at->tabdir.ordered[i]->offset = tab->offset;
 	at->tabdir.ordered[i]->checksum = tab->checksum;
     }
+    TRACE_END("table assembly");
 
     tab = SFFindTable(sf,CHR('c','v','t',' '));
     if ( tab!=NULL ) {
@@ -5990,6 +6206,7 @@ static void dumpttf(FILE *ttf,struct alltabs *at) {
 		at->tabdir.ordered[i]->offset,Tag2String(at->tabdir.ordered[i]->tag)))
 	    at->error = true;
     }
+    TRACE_COUNT("bytes written",ftell(ttf));
 
     if ( head_index!=-1 ) {
 	checksum = filechecksum(ttf);
@@ -6193,15 +6410,20 @@ int _WriteTTFFont(FILE *ttf,SplineFont *sf,enum fontformat format,
     for ( i=0; i<sf->glyphcnt; ++i ) if ( sf->glyphs[i]!=NULL )
 	sf->glyphs[i]->ttf_glyph = -1;
 
+    TRACE_BEGIN("WriteTTFFont");
     memset(&at,'\0',sizeof(struct alltabs));
     ATinit(&at,sf,map,flags,layer,format,bf,bsizes);
 
     if ( format==ff_cff || format==ff_cffcid ) {
 	dumpcff(&at,sf,format,ttf);
     } else {
-	if ( initTables(&at,sf,format,flags,bsizes,bf))
+	if ( initTables(&at,sf,format,flags,bsizes,bf)) {
+	    TRACE_BEGIN("write sfnt");
 	    dumpttf(ttf,&at);
+	    TRACE_END("write sfnt");
+	}
     }
+    TRACE_END("WriteTTFFont");
 
     switch_to_old_locale(&tmplocale, &oldlocale); // Switch to the cached locale.
     SubtableMap_delete(&at.subtable_map);
@@ -6222,11 +6444,132 @@ return( 0 );
 return( 1 );
 }
 
+/* While several formats are generated from one font, the sfnt for each */
+/*  flavour is compiled once and kept here. The .ttf/.otf files are copies */
+/*  of it and woff/woff2 wrap it without compiling the font again */
+struct sfntcache {
+    SplineFont *sf;
+    EncMap *map;
+    enum fontformat format;
+    enum bitmapformat bf;
+    int flags, layer;
+    int32_t *bsizes;
+    uint8_t *data;
+    size_t len;
+    struct sfntcache *next;
+};
+static struct sfntcache *sfntcache;
+static int sfntcache_active;
+
+void SFNTCacheBegin(void) {
+    sfntcache_active = true;
+}
+
+void SFNTCacheEnd(void) {
+    struct sfntcache *sc, *next;
+
+    for ( sc=sfntcache; sc!=NULL; sc=next ) {
+	next = sc->next;
+	free(sc->bsizes);
+	free(sc->data);
+	free(sc);
+    }
+    sfntcache = NULL;
+    sfntcache_active = false;
+}
+
+static int SizesMatch(int32_t *s1,int32_t *s2) {
+    if ( s1==NULL || s2==NULL )
+return( (s1==NULL || *s1==0) && (s2==NULL || *s2==0) );
+    while ( *s1!=0 && *s1==*s2 ) {
+	++s1; ++s2;
+    }
+return( *s1==*s2 );
+}
+
+static struct sfntcache *SFNTCacheFind(SplineFont *sf,enum fontformat format,
+	int32_t *bsizes, enum bitmapformat bf,int flags,EncMap *map, int layer) {
+    struct sfntcache *sc;
+
+    for ( sc=sfntcache; sc!=NULL; sc=sc->next )
+	if ( sc->sf==sf && sc->map==map && sc->format==format && sc->bf==bf &&
+		sc->flags==flags && sc->layer==layer && SizesMatch(sc->bsizes,bsizes) )
+return( sc );
+return( NULL );
+}
+
+/* Returns the sfnt in a buffer the caller frees, or NULL on error */
+uint8_t *WriteTTFFontToBuffer(SplineFont *sf,enum fontformat format,
+	int32_t *bsizes, enum bitmapformat bf,int flags,EncMap *map, int layer,
+	size_t *len) {
+    struct sfntcache *sc = sfntcache_active ?
+	    SFNTCacheFind(sf,format,bsizes,bf,flags,map,layer) : NULL;
+    uint8_t *data;
+    FILE *ttf;
+    long end;
+    int i;
+
+    if ( sc==NULL ) {
+	if ( (ttf=GFileTmpfile())==NULL )
+return( NULL );
+	if ( !_WriteTTFFont(ttf,sf,format,bsizes,bf,flags,map,layer) ||
+		fseek(ttf,0,SEEK_END)!=0 || (end=ftell(ttf))<=0 ||
+		(data=malloc(end))==NULL ) {
+	    fclose(ttf);
+return( NULL );
+	}
+	rewind(ttf);
+	if ( fread(data,1,end,ttf)!=(size_t) end ) {
+	    free(data);
+	    fclose(ttf);
+return( NULL );
+	}
+	fclose(ttf);
+	if ( !sfntcache_active ) {
+	    *len = end;
+return( data );
+	}
+	sc = calloc(1,sizeof(struct sfntcache));
+	sc->sf = sf; sc->map = map; sc->format = format; sc->bf = bf;
+	sc->flags = flags; sc->layer = layer;
+	if ( bsizes!=NULL ) {
+	    for ( i=0; bsizes[i]!=0; ++i );
+	    sc->bsizes = malloc((i+1)*sizeof(int32_t));
+	    memcpy(sc->bsizes,bsizes,(i+1)*sizeof(int32_t));
+	}
+	sc->data = data;
+	sc->len = end;
+	sc->next = sfntcache;
+	sfntcache = sc;
+    }
+    if ( (data=malloc(sc->len))==NULL )
+return( NULL );
+    memcpy(data,sc->data,sc->len);
+    *len = sc->len;
+return( data );
+}
+
 int WriteTTFFont(char *fontname,SplineFont *sf,enum fontformat format,
 	int32_t *bsizes, enum bitmapformat bf,int flags,EncMap *map, int layer) {
     FILE *ttf;
     int ret;
 
+    if ( sfntcache_active && (format==ff_ttf || format==ff_otf || format==ff_otfcid) ) {
+	size_t len;
+	uint8_t *data = WriteTTFFontToBuffer(sf,format,bsizes,bf,flags,map,layer,&len);
+	if ( data==NULL || ( ttf=fopen(fontname,"wb"))==NULL ) {
+	    free(data);
+return( 0 );
+	}
+	ret = fwrite(data,1,len,ttf)==len;
+	free(data);
+	if ( ret && (flags&ttf_flag_glyphmap) )
+	    DumpGlyphToNameMap(fontname,sf);
+	if ( fclose(ttf)==-1 )
+return( 0 );
+return( ret );
+    }
+
     if (( ttf=fopen(fontname,"wb+"))==NULL )
 return( 0 );
     ret = _WriteTTFFont(ttf,sf,format,bsizes,bf,flags,map,layer);
@@ -21,6 +21,9 @@ extern int ttfcopyfile(FILE *ttf, FILE *other, int pos, const char *tab_name);
 extern int WriteTTC(const char *filename, struct sflist *sfs, enum fontformat format, enum bitmapformat bf, int flags, int layer, enum ttc_flags ttcflags);
 extern int WriteTTFFont(char *fontname, SplineFont *sf, enum fontformat format, int32_t *bsizes, enum bitmapformat bf, int flags, EncMap *enc, int layer);
 extern int _WriteTTFFont(FILE *ttf, SplineFont *sf, enum fontformat format, int32_t *bsizes, enum bitmapformat bf, int flags, EncMap *enc, int layer);
+extern uint8_t *WriteTTFFontToBuffer(SplineFont *sf, enum fontformat format, int32_t *bsizes, enum bitmapformat bf, int flags, EncMap *enc, int layer, size_t *len);
+extern void SFNTCacheBegin(void);
+extern void SFNTCacheEnd(void);
 extern SplineCharTTFMap* WriteTTFFontForShaper(FILE *ttf, SplineFont *sf);
 extern int _WriteType42SFNTS(FILE *type42, SplineFont *sf, enum fontformat format, int flags, EncMap *enc, int layer);
 extern void cvt_unix_to_1904(long long time, int32_t result[2]);
@@ -31,6 +34,7 @@ extern void SFDefaultOS2Info(struct pfminfo *pfminfo, SplineFont *sf, char *font
 extern void SFDefaultOS2Simple(struct pfminfo *pfminfo, SplineFont *sf);
 extern void SFDefaultOS2SubSuper(struct pfminfo *pfminfo, int emsize, double italic_angle);
 extern void SFDummyUpCIDs(struct glyphinfo *gi, SplineFont *sf);
+extern void TTFApproxCacheFree(struct ttf_approx_cache *cache);
 
 extern void putfixed(FILE *file, real dval);
 extern void putlong(FILE *file, int val);
@@ -98,7 +98,8 @@ static int CountKerns(struct alltabs *at, SplineFont *sf, struct kerncounts *kcn
     ASM *sm;
 
     cnt = mh = vcnt = mv = 0;
-    for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 ) {
+    for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 &&
+	    sf->glyphs[at->gi.bygid[i]]!=NULL ) {
 	j = 0;
 	for ( kp = sf->glyphs[at->gi.bygid[i]]->kerns; kp!=NULL; kp=kp->next )
 	    if ( kp->off!=0 && kp->sc->ttf_glyph!=-1 &&
@@ -126,7 +127,8 @@ static int CountKerns(struct alltabs *at, SplineFont *sf, struct kerncounts *kcn
 	int b=0;
 	kcnt->hbreaks = malloc((at->gi.gcnt+1)*sizeof(int));
 	cnt = 0;
-	for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 ) {
+	for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 &&
+		sf->glyphs[at->gi.bygid[i]]!=NULL ) {
 	    j = 0;
 	    for ( kp = sf->glyphs[at->gi.bygid[i]]->kerns; kp!=NULL; kp=kp->next )
 		if ( kp->off!=0 && LookupHasDefault(kp->subtable->lookup ))
@@ -147,7 +149,8 @@ static int CountKerns(struct alltabs *at, SplineFont *sf, struct kerncounts *kcn
 	int b=0;
 	kcnt->vbreaks = malloc((at->gi.gcnt+1)*sizeof(int));
 	vcnt = 0;
-	for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 ) {
+	for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 &&
+		sf->glyphs[at->gi.bygid[i]]!=NULL ) {
 	    j = 0;
 	    for ( kp = sf->glyphs[at->gi.bygid[i]]->vkerns; kp!=NULL; kp=kp->next )
 		if ( kp->off!=0 && LookupHasDefault(kp->subtable->lookup))
@@ -218,6 +221,8 @@ return;
 
 		for ( tot = 0; gid<at->gi.gcnt && tot<c; ++gid ) if ( at->gi.bygid[gid]!=-1 ) {
 		    SplineChar *sc = sf->glyphs[at->gi.bygid[gid]];
+		    if ( sc==NULL )	/* An instance glyph nobody has made */
+	    continue;
 		    // if requested, omit kern pairs with unmapped glyphs
 		    // (required for compatibility with non-OpenType-aware Windows applications)
 		    if( (at->gi.flags&ttf_flag_oldkernmappedonly) && (unsigned)(sc->unicodeenc)>0xFFFF ) continue;
@@ -320,7 +325,7 @@ return;
 	    fseek(at->kern,len_pos+10,SEEK_SET);
 	    putshort(at->kern,pos-len_pos);
 	    fseek(at->kern,pos,SEEK_SET);
-	    class1 = ClassesFromNames(sf,kc->firsts,kc->first_cnt,at->maxp.numGlyphs,NULL,true);
+	    class1 = KernClassClasses(sf,kc,true,at->maxp.numGlyphs,NULL,true);
 	    DumpKernClass(at->kern,class1,at->maxp.numGlyphs,16,sizeof(uint16_t)*kc->second_cnt);
 	    free(class1);
 
@@ -328,7 +333,7 @@ return;
 	    fseek(at->kern,len_pos+12,SEEK_SET);
 	    putshort(at->kern,pos-len_pos);
 	    fseek(at->kern,pos,SEEK_SET);
-	    class2 = ClassesFromNames(sf,kc->seconds,kc->second_cnt,at->maxp.numGlyphs,NULL,true);
+	    class2 = KernClassClasses(sf,kc,false,at->maxp.numGlyphs,NULL,true);
 	    DumpKernClass(at->kern,class2,at->maxp.numGlyphs,0,sizeof(uint16_t));
 	    free(class2);
 
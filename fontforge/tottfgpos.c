@@ -40,9 +40,11 @@
 #include "splinesaveafm.h"
 #include "splineutil.h"
 #include "tottf.h"
+#include "trace.h"
 #include "ustring.h"
 #include "utype.h"
 
+#include <limits.h>
 #include <stdbool.h>
 
 int coverageformatsallowed=3;
@@ -715,8 +717,248 @@ static void AnchorGuessContext(SplineFont *sf,struct alltabs *at) {
 	at->os2.maxContext=2;
 }
 
-static void dumpcoveragetable(FILE *gpos,SplineChar **glyphs) {
-    int i, last = -2, range_cnt=0, start, r;
+/* Coverage and ClassDef tables aren't written in the middle of the */
+/*  subtables which use them. They are collected while a lookup (or GDEF, */
+/*  MATH) is written and put after it, so that subtables which want the same */
+/*  table share one copy. Their offsets are 16 bits and may only point */
+/*  forward, so whenever a subtable is finished we check that everything */
+/*  still waiting can be reached from the subtables which want it. If not, */
+/*  what the earlier subtables want is written in front of the new one */
+#define OTL_HASH_SIZE	257
+
+struct otlobject {
+    uint16_t *data;
+    int len;			/* in shorts */
+    uint32_t hash;
+    int next;			/* next object in the same hash bucket */
+    uint32_t minbase;		/* first subtable which wants it */
+    uint32_t pos;		/* where it is going in the file */
+};
+
+struct otlref {
+    uint32_t field;		/* where the offset goes */
+    uint32_t base;		/* and what it is relative to */
+    int obj;
+    int is_long;
+};
+
+struct otlobjects {
+    int ocnt, omax;
+    struct otlobject *objs;
+    int rcnt, rmax;
+    struct otlref *refs;
+    int buckets[OTL_HASH_SIZE];
+};
+
+static struct otlobjects *OTLObjectsNew(void) {
+    struct otlobjects *ob = calloc(1,sizeof(struct otlobjects));
+
+    memset(ob->buckets,-1,sizeof(ob->buckets));
+return( ob );
+}
+
+static void OTLObjectsFree(struct otlobjects *ob) {
+    int i;
+
+    if ( ob==NULL )
+return;
+    for ( i=0; i<ob->ocnt; ++i )
+	free(ob->objs[i].data);
+    free(ob->objs);
+    free(ob->refs);
+    free(ob);
+}
+
+static int OTLObjectAdd(struct otlobjects *ob,uint16_t *data,int len) {
+    uint32_t hash = len;
+    int i, b;
+
+    for ( i=0; i<len; ++i )
+	hash = hash*31 + data[i];
+    b = hash%OTL_HASH_SIZE;
+    for ( i=ob->buckets[b]; i!=-1; i=ob->objs[i].next ) {
+	if ( ob->objs[i].hash==hash && ob->objs[i].len==len &&
+		memcmp(ob->objs[i].data,data,len*sizeof(uint16_t))==0 ) {
+	    free(data);
+return( i );
+	}
+    }
+    if ( ob->ocnt>=ob->omax )
+	ob->objs = realloc(ob->objs,(ob->omax += 64)*sizeof(struct otlobject));
+    i = ob->ocnt++;
+    ob->objs[i].data = data;
+    ob->objs[i].len = len;
+    ob->objs[i].hash = hash;
+    ob->objs[i].next = ob->buckets[b];
+    ob->buckets[b] = i;
+return( i );
+}
+
+static void OTLObjectRef(struct otlobjects *ob,uint32_t field,uint32_t base,
+	int obj,int is_long) {
+    if ( ob->rcnt>=ob->rmax )
+	ob->refs = realloc(ob->refs,(ob->rmax += 64)*sizeof(struct otlref));
+    ob->refs[ob->rcnt].field = field;
+    ob->refs[ob->rcnt].base = base;
+    ob->refs[ob->rcnt].obj = obj;
+    ob->refs[ob->rcnt++].is_long = is_long;
+}
+
+static int otlobj_order(const void *_o1, const void *_o2) {
+    const struct otlobject *o1 = *(const struct otlobject **) _o1, *o2 = *(const struct otlobject **) _o2;
+
+    if ( o1->minbase!=o2->minbase )
+return( o1->minbase<o2->minbase ? -1 : 1 );
+return( o1<o2 ? -1 : o1>o2 );
+}
+
+/* Decide where the objects wanted from before "before" go if we start */
+/*  writing them at pos. Those wanted by the earliest subtables are furthest */
+/*  away, so they go first. Returns whether all their offsets fit */
+static int OTLObjectsPlace(struct otlobjects *ob,uint32_t pos,uint32_t before,
+	struct otlobject **order,int *_cnt) {
+    int i, cnt;
+    struct otlref *ref;
+
+    for ( i=0; i<ob->ocnt; ++i )
+	ob->objs[i].minbase = UINT32_MAX;
+    for ( i=0; i<ob->rcnt; ++i ) {
+	ref = &ob->refs[i];
+	if ( ref->base<before && ref->base<ob->objs[ref->obj].minbase )
+	    ob->objs[ref->obj].minbase = ref->base;
+    }
+    for ( i=cnt=0; i<ob->ocnt; ++i )
+	if ( ob->objs[i].minbase!=UINT32_MAX )
+	    order[cnt++] = &ob->objs[i];
+    qsort(order,cnt,sizeof(struct otlobject *),otlobj_order);
+    for ( i=0; i<cnt; ++i ) {
+	order[i]->pos = pos;
+	pos += 2*order[i]->len;
+    }
+    if ( _cnt!=NULL )
+	*_cnt = cnt;
+    for ( i=0; i<ob->rcnt; ++i ) {
+	ref = &ob->refs[i];
+	if ( ref->base<before && !ref->is_long && ob->objs[ref->obj].pos-ref->base>65535 )
+return( false );
+    }
+return( true );
+}
+
+static int OTLObjectsFitAt(struct otlobjects *ob,uint32_t pos) {
+    struct otlobject **order;
+    int ret;
+
+    if ( ob->rcnt==0 )
+return( true );
+    order = malloc(ob->ocnt*sizeof(struct otlobject *));
+    ret = OTLObjectsPlace(ob,pos,UINT32_MAX,order,NULL);
+    free(order);
+return( ret );
+}
+
+/* Write the objects wanted from before "before" at the end of the file and */
+/*  fill in the offsets to them. Objects also wanted by later subtables stay */
+/*  waiting for them */
+static void OTLObjectsWrite(FILE *f,struct otlobjects *ob,uint32_t before) {
+    struct otlobject **order;
+    struct otlref *ref;
+    int i, j, cnt;
+    uint32_t end;
+
+    if ( ob->rcnt==0 )
+return;
+    order = malloc(ob->ocnt*sizeof(struct otlobject *));
+    OTLObjectsPlace(ob,ftell(f),before,order,&cnt);
+    for ( i=0; i<cnt; ++i )
+	for ( j=0; j<order[i]->len; ++j )
+	    putshort(f,order[i]->data[j]);
+    free(order);
+    end = ftell(f);
+    for ( i=j=0; i<ob->rcnt; ++i ) {
+	ref = &ob->refs[i];
+	if ( ref->base>=before ) {
+	    ob->refs[j++] = *ref;
+    continue;
+	}
+	fseek(f,ref->field,SEEK_SET);
+	if ( ref->is_long )
+	    putlong(f,ob->objs[ref->obj].pos-ref->base);
+	else {
+	    if ( ob->objs[ref->obj].pos-ref->base>65535 )
+		IError("Offset to a coverage or class definition table is too big");
+	    putshort(f,ob->objs[ref->obj].pos-ref->base);
+	}
+    }
+    ob->rcnt = j;
+    fseek(f,end,SEEK_SET);
+
+    /* Forget the objects nothing else wants, they can't be shared with */
+    /*  anything which comes later */
+    for ( i=0; i<ob->ocnt; ++i )
+	ob->objs[i].minbase = UINT32_MAX;
+    for ( i=0; i<ob->rcnt; ++i )
+	ob->objs[ob->refs[i].obj].minbase = 0;
+    memset(ob->buckets,-1,sizeof(ob->buckets));
+    for ( i=0; i<ob->ocnt; ++i ) {
+	if ( ob->objs[i].minbase==UINT32_MAX ) {
+	    free(ob->objs[i].data);
+	    ob->objs[i].data = NULL;
+	} else {
+	    ob->objs[i].next = ob->buckets[ob->objs[i].hash%OTL_HASH_SIZE];
+	    ob->buckets[ob->objs[i].hash%OTL_HASH_SIZE] = i;
+	}
+    }
+    if ( ob->rcnt==0 )
+	ob->ocnt = 0;
+}
+
+static void OTLObjectsFlush(FILE *f,struct otlobjects *ob) {
+    OTLObjectsWrite(f,ob,UINT32_MAX);
+}
+
+/* Called when a subtable starting at start has been written. Returns where */
+/*  it starts now */
+static uint32_t OTLObjectsFit(FILE *f,struct otlobjects *ob,uint32_t start,
+	struct lookup_subtable *sub) {
+    uint32_t end = ftell(f), len, delta;
+    char *body;
+    int i;
+
+    if ( OTLObjectsFitAt(ob,end) )
+return( start );
+
+    len = end-start;
+    body = malloc(len);
+    fseek(f,start,SEEK_SET);
+    if ( fread(body,1,len,f)!=len )
+	IError("Could not read back a subtable");
+    fseek(f,start,SEEK_SET);
+    OTLObjectsWrite(f,ob,start);
+    delta = ftell(f)-start;
+    fwrite(body,1,len,f);
+    free(body);
+    for ( i=0; i<ob->rcnt; ++i ) {
+	ob->refs[i].field += delta;
+	ob->refs[i].base += delta;
+    }
+    if ( sub!=NULL ) {
+	if ( sub->subtable_offset>=(int32_t) start )
+	    sub->subtable_offset += delta;
+	if ( sub->extra_subtables!=NULL )
+	    for ( i=0; sub->extra_subtables[i]!=-1; ++i )
+		if ( sub->extra_subtables[i]>=(int32_t) start )
+		    sub->extra_subtables[i] += delta;
+    }
+    /* If it can't reach its own tables even so they go right after it */
+    if ( !OTLObjectsFitAt(ob,ftell(f)) )
+	OTLObjectsFlush(f,ob);
+return( start+delta );
+}
+
+static uint16_t *CoverageData(SplineChar **glyphs,int *_len) {
+    int i, last = -2, range_cnt=0, start, r, len;
+    uint16_t *data;
     /* the glyph list should already be sorted */
     /* figure out whether it is better (smaller) to use an array of glyph ids */
     /*  or a set of glyph id ranges */
@@ -740,29 +982,30 @@ static void dumpcoveragetable(FILE *gpos,SplineChar **glyphs) {
     /* I think Windows will only accept format 2 coverage tables? */
     if ( !(coverageformatsallowed&2) || ((coverageformatsallowed&1) && i<=3*range_cnt )) {
 	/* We use less space with a list of glyphs than with a set of ranges */
-	putshort(gpos,1);		/* Coverage format=1 => glyph list */
-	putshort(gpos,i);		/* count of glyphs */
+	data = malloc((2+i)*sizeof(uint16_t));
+	data[0] = 1;			/* Coverage format=1 => glyph list */
+	data[1] = i;			/* count of glyphs */
 	for ( i=0; glyphs[i]!=NULL; ++i )
-	    putshort(gpos,glyphs[i]->ttf_glyph);	/* array of glyph IDs */
+	    data[2+i] = glyphs[i]->ttf_glyph;	/* array of glyph IDs */
+	len = 2+i;
     } else {
-	putshort(gpos,2);		/* Coverage format=2 => range list */
-	putshort(gpos,range_cnt);	/* count of ranges */
+	data = malloc((2+3*range_cnt)*sizeof(uint16_t));
+	data[0] = 2;			/* Coverage format=2 => range list */
+	data[1] = range_cnt;		/* count of ranges */
+	len = 2;
 	last = -2; start = -2;		/* start is a index in our glyph array, last is ttf_glyph */
 	// start is the index in the glyph array of the starting glyph. last is the ttf_glyph of the ending glyph.
 	r = 0; // r keeps count of the emitted ranges.
 	// We follow the chain of glyphs, ending and emitting a range whenever there is a discontinuity.
 	for (i=0; glyphs[i]!=NULL; i++) {
-		if (i > 0 && glyphs[i]->ttf_glyph <= glyphs[i-1]->ttf_glyph) {
-			// LogError(_("Glyphs must be ordered when creating coverage table"));
-		}
 		if (glyphs[i]->ttf_glyph < 0) {
 			// LogError(_("-1 glyph index in dumpcoveragetable."));
 		} else {
 			// At the start of any discontinuity, dump the previous range.
 			if (r > 0 && glyphs[i]->ttf_glyph > last + 1) {
-				putshort(gpos,glyphs[start]->ttf_glyph);	/* start glyph ID */
-				putshort(gpos,last);			/* end glyph ID */
-				putshort(gpos,start);			/* coverage index of start glyph */
+				data[len++] = glyphs[start]->ttf_glyph;	/* start glyph ID */
+				data[len++] = last;			/* end glyph ID */
+				data[len++] = start;			/* coverage index of start glyph */
 			}
 			// On the first validly TrueType-indexed glyph or at the start of any discontinuity, start a new range.
 			if (r == 0 || glyphs[i]->ttf_glyph > last + 1) {
@@ -774,13 +1017,76 @@ static void dumpcoveragetable(FILE *gpos,SplineChar **glyphs) {
 	}
 	// If there were any valid glyphs, there will be one more range to be emitted.
 	if (r > 0) {
-		putshort(gpos,glyphs[start]->ttf_glyph);	/* start glyph ID */
-		putshort(gpos,last);			/* end glyph ID */
-		putshort(gpos,start);			/* coverage index of start glyph */
+		data[len++] = glyphs[start]->ttf_glyph;	/* start glyph ID */
+		data[len++] = last;			/* end glyph ID */
+		data[len++] = start;			/* coverage index of start glyph */
 	}
 	if ( r!=range_cnt )
 	    IError("Miscounted ranges in format 2 coverage table output");
     }
+    *_len = len;
+return( data );
+}
+
+static uint16_t *ClassDefData(uint16_t *class,int numGlyphs,int ranges_only,int *_len) {
+    int ranges, i, cur, first= -1, last=-1, istart, len;
+    uint16_t *data;
+
+    for ( i=ranges=0; i<numGlyphs; ) {
+	istart = i;
+	cur = class[i];
+	while ( i<numGlyphs && class[i]==cur )
+	    ++i;
+	if ( cur!=0 ) {
+	    ++ranges;
+	    if ( first==-1 ) first = istart;
+	    last = i-1;
+	}
+    }
+    /* Whichever format is smaller, an empty range list if nothing has */
+    /*  a class */
+    if ( !ranges_only && first!=-1 && ranges*3+1>last-first+1+2 ) {
+	data = malloc((3+last-first+1)*sizeof(uint16_t));
+	data[0] = 1;			/* Format 1, list of all possibilities */
+	data[1] = first;
+	data[2] = last-first+1;
+	for ( i=first, len=3; i<=last ; ++i )
+	    data[len++] = class[i];
+    } else {
+	data = malloc((2+3*ranges)*sizeof(uint16_t));
+	data[0] = 2;			/* Format 2, series of ranges */
+	data[1] = ranges;
+	for ( i=0, len=2; i<numGlyphs; ) {
+	    istart = i;
+	    cur = class[i];
+	    while ( i<numGlyphs && class[i]==cur )
+		++i;
+	    if ( cur!=0 ) {
+		data[len++] = istart;
+		data[len++] = i-1;
+		data[len++] = cur;
+	    }
+	}
+    }
+    *_len = len;
+return( data );
+}
+
+/* The offset at field (relative to base) will point to a coverage table */
+static void OTLCoverage(struct otlobjects *ob,uint32_t field,uint32_t base,
+	SplineChar **glyphs) {
+    int len;
+    uint16_t *data = CoverageData(glyphs,&len);
+
+    OTLObjectRef(ob,field,base,OTLObjectAdd(ob,data,len),false);
+}
+
+static void OTLClassDef(struct otlobjects *ob,uint32_t field,uint32_t base,
+	uint16_t *class,int numGlyphs,int ranges_only) {
+    int len;
+    uint16_t *data = ClassDefData(class,numGlyphs,ranges_only,&len);
+
+    OTLObjectRef(ob,field,base,OTLObjectAdd(ob,data,len),false);
 }
 
 static int sc_ttf_order( const void *_sc1, const void *_sc2) {
@@ -1115,7 +1421,7 @@ return( DevTabsSame(&vdt1->xadjust,&vdt2->xadjust) &&
 
 static void dumpGPOSsimplepos(FILE *gpos,SplineFont *sf,struct lookup_subtable *sub, struct alltabs *at ) {
     int cnt, cnt2;
-    int32_t coverage_pos, end;
+    int32_t coverage_pos;
     PST *pst, *first=NULL;
     int bits = 0, same=true;
     SplineChar **glyphs;
@@ -1212,12 +1518,7 @@ static void dumpGPOSsimplepos(FILE *gpos,SplineFont *sf,struct lookup_subtable *
 	if ( next_dev_tab!=ftell(gpos)-coverage_pos+2 )
 	    IError( "Device Table offsets wrong in simple positioning 2");
     }
-    end = ftell(gpos);
-    fseek(gpos,coverage_pos,SEEK_SET);
-    putshort(gpos,end-coverage_pos+2);
-    fseek(gpos,end,SEEK_SET);
-    dumpcoveragetable(gpos,glyphs);
-    fseek(gpos,0,SEEK_END);
+    OTLCoverage(at->otlobjects,coverage_pos,coverage_pos-2,glyphs);
     free(glyphs);
 }
 
@@ -1499,14 +1800,13 @@ static void dumpGPOSpairpos(FILE *gpos,SplineFont *sf,struct lookup_subtable *su
 	    }
 	}
 	end = ftell(gpos);
-	fseek(gpos,coverage_pos,SEEK_SET);
 	if ( end-start>65535 )
 	    IError(_("I miscalculated the size of subtable %s, this means the kerning output is wrong."), sub->subtable_name );
-	putshort(gpos,end-start);
-	fseek(gpos,end,SEEK_SET);
 	gtemp = glyphs[end_cnt]; glyphs[end_cnt] = NULL;
-	dumpcoveragetable(gpos,glyphs+start_cnt);
+	OTLCoverage(at->otlobjects,coverage_pos,start,glyphs+start_cnt);
 	glyphs[end_cnt] = gtemp;
+	if ( sub->extra_subtables!=NULL )
+	    OTLObjectsFit(gpos,at->otlobjects,start,sub);
     }
     for ( i=0; i<cnt; ++i )
 	free(seconds[i]);
@@ -1551,19 +1851,28 @@ uint16_t *ClassesFromNames(SplineFont *sf,char **classnames,int class_cnt,
 return( class );
 }
 
-static SplineChar **GlyphsFromClasses(SplineChar **gs, int numGlyphs) {
-    int i, cnt;
-    SplineChar **glyphs;
+/* The same thing for a kerning class, but taken from its map of glyph ids */
+/*  rather than by looking up all the names again */
+uint16_t *KernClassClasses(SplineFont *sf,KernClass *kc,int isfirst,
+	int numGlyphs, SplineChar ***glyphs, int apple_kc) {
+    struct kernclassmap *map = KernClassMapVerified(sf,kc);
+    uint16_t *class, *mclass = isfirst ? map->first : map->second;
+    char **classnames = isfirst ? kc->firsts : kc->seconds;
+    SplineChar *sc, **gs=NULL;
+    int offset = (apple_kc && classnames[0]!=NULL);
+    int i;
 
-    for ( i=cnt=0; i<numGlyphs; ++i )
-	if ( gs[i]!=NULL ) ++cnt;
-    glyphs = malloc((cnt+1)*sizeof(SplineChar *));
-    for ( i=cnt=0; i<numGlyphs; ++i )
-	if ( gs[i]!=NULL )
-	    glyphs[cnt++] = gs[i];
-    glyphs[cnt++] = NULL;
-    free(gs);
-return( glyphs );
+    class = calloc(numGlyphs,sizeof(uint16_t));
+    if ( glyphs ) *glyphs = gs = calloc(numGlyphs,sizeof(SplineChar *));
+    for ( i=0; i<map->glyphcnt; ++i ) {
+	sc = map->glyphs[i];
+	if ( mclass[i]!=KC_NO_CLASS && sc!=NULL && sc->ttf_glyph!=-1 ) {
+	    class[sc->ttf_glyph] = mclass[i]+offset;
+	    if ( gs!=NULL )
+		gs[sc->ttf_glyph] = sc;
+	}
+    }
+return( class );
 }
 
 static SplineChar **GlyphsFromInitialClasses(SplineChar **gs, int numGlyphs, uint16_t *classes, uint16_t *initial) {
@@ -1588,118 +1897,453 @@ static SplineChar **GlyphsFromInitialClasses(SplineChar **gs, int numGlyphs, uin
 return( glyphs );
 }
 
-static void DumpClass(FILE *gpos,uint16_t *class,int numGlyphs) {
-    int ranges, i, cur, first= -1, last=-1, istart;
+/* A class kerning matrix is written as one or more PairPos subtables. Each */
+/*  subtable takes some of the first classes (rows), and only needs those */
+/*  second classes (columns) where one of its rows has a value different */
+/*  from the "everything else" column, the rest can be left in class 0. So */
+/*  a sparse matrix is often smaller when its rows are split among several */
+/*  subtables, and a big one must be split so the offsets fit in 16 bits. */
+/*  We start with rows which use the same columns in the same subtable, and */
+/*  then keep merging the pair of subtables which saves the most bytes. */
+/*  Then each subtable is written as class pairs (format 2) or, if that is */
+/*  smaller and means the same, as glyph pairs (format 1) */
+#define KC_MAX_SPLITS	256
+
+struct kcsplit {
+    int rcnt, *rows;		/* First classes in this subtable */
+    uint32_t *cols;		/* Second classes which it needs */
+    int m;			/* Number of those */
+    int g1, g2;			/* Glyphs in the rows, and in the columns */
+    int devtabs;		/* Bytes of device tables (as an upper bound) */
+};
 
-    for ( i=ranges=0; i<numGlyphs; ) {
-	istart = i;
-	cur = class[i];
-	while ( i<numGlyphs && class[i]==cur )
-	    ++i;
-	if ( cur!=0 ) {
-	    ++ranges;
-	    if ( first==-1 ) first = istart;
-	    last = i-1;
+struct kcdata {
+    KernClass *kc;
+    int words;			/* Size of a column set */
+    int rec;			/* Bytes for a value record */
+    int numGlyphs;
+    int *g1, *g2;		/* Number of glyphs in each first/second class */
+    uint32_t **rowcols;		/* Columns each row needs */
+    int *rowdevtabs;
+};
+
+static int KCCellsSame(KernClass *kc,int a,int b) {
+return( kc->offsets[a]==kc->offsets[b] && DevTabsSame(&kc->adjusts[a],&kc->adjusts[b]) );
+}
+
+static int KCSplitSize(struct kcdata *kd,int rcnt,int m,int g1,int g2) {
+    /* header + records + coverage + two class defs (format 1 estimates) */
+return( 16 + rcnt*(m+1)*kd->rec + (4+2*g1) + (6+2*g1) + (6+2*g2) );
+}
+
+/* The coverage table comes last, and its offset must fit in 16 bits. A */
+/*  class def is at worst a range for each glyph, or a list of all glyphs */
+static int KCClassDefMax(struct kcdata *kd,int g) {
+return( 4+6*g < 6+2*kd->numGlyphs ? 4+6*g : 6+2*kd->numGlyphs );
+}
+
+static int KCSplitFits(struct kcdata *kd,int rcnt,int m,int g1,int g2,int devtabs) {
+return( 16 + rcnt*(m+1)*kd->rec + devtabs + KCClassDefMax(kd,g1) + KCClassDefMax(kd,g2) <= 65535 );
+}
+
+static void KCSplitMerged(struct kcdata *kd,struct kcsplit *a,struct kcsplit *b,
+	uint32_t *cols, int *m, int *g2) {
+    int i;
+
+    *m = *g2 = 0;
+    for ( i=0; i<kd->words*32 && i<kd->kc->second_cnt; ++i ) {
+	if ( i%32==0 )
+	    cols[i/32] = a->cols[i/32] | b->cols[i/32];
+	if ( cols[i/32]&(1u<<(i%32)) ) {
+	    ++*m;
+	    *g2 += kd->g2[i];
 	}
     }
-    if ( ranges*3+1>last-first+1+2 || first==-1 ) {
-	if ( first==-1 ) first = last = 0;
-	putshort(gpos,1);		/* Format 1, list of all possibilities */
-	putshort(gpos,first);
-	putshort(gpos,last-first+1);
-	for ( i=first; i<=last ; ++i )
-	    putshort(gpos,class[i]);
-    } else {
-	putshort(gpos,2);		/* Format 2, series of ranges */
-	putshort(gpos,ranges);
-	for ( i=0; i<numGlyphs; ) {
-	    istart = i;
-	    cur = class[i];
-	    while ( i<numGlyphs && class[i]==cur )
-		++i;
-	    if ( cur!=0 ) {
-		putshort(gpos,istart);
-		putshort(gpos,i-1);
-		putshort(gpos,cur);
+}
+
+/* How many bytes do we save by putting a and b in one subtable? */
+static int KCSplitSaving(struct kcdata *kd,struct kcsplit *a,struct kcsplit *b,uint32_t *cols) {
+    int m, g2;
+
+    KCSplitMerged(kd,a,b,cols,&m,&g2);
+    if ( !KCSplitFits(kd,a->rcnt+b->rcnt,m,a->g1+b->g1,g2,a->devtabs+b->devtabs) )
+return( INT_MIN );
+return( KCSplitSize(kd,a->rcnt,a->m,a->g1,a->g2) + KCSplitSize(kd,b->rcnt,b->m,b->g1,b->g2) -
+	KCSplitSize(kd,a->rcnt+b->rcnt,m,a->g1+b->g1,g2) );
+}
+
+static void KCSplitJoin(struct kcdata *kd,struct kcsplit *a,struct kcsplit *b) {
+    uint32_t *cols = malloc(kd->words*sizeof(uint32_t));
+
+    KCSplitMerged(kd,a,b,cols,&a->m,&a->g2);
+    free(a->cols);
+    a->cols = cols;
+    a->rows = realloc(a->rows,(a->rcnt+b->rcnt)*sizeof(int));
+    memcpy(a->rows+a->rcnt,b->rows,b->rcnt*sizeof(int));
+    a->rcnt += b->rcnt;
+    a->g1 += b->g1;
+    a->devtabs += b->devtabs;
+    free(b->rows); free(b->cols);
+    b->rows = NULL; b->cols = NULL;
+    b->rcnt = 0;
+}
+
+static struct kcsplit *KCSplitRows(struct kcdata *kd,int *_scnt) {
+    KernClass *kc = kd->kc;
+    struct kcsplit *splits;
+    int scnt, i, j, k, best, bi, bj;
+    int *saving;
+    uint32_t *cols = malloc(kd->words*sizeof(uint32_t));
+
+    /* Rows which need the same columns go together */
+    splits = calloc(kc->first_cnt,sizeof(struct kcsplit));
+    for ( i=scnt=0; i<kc->first_cnt; ++i ) {
+	if ( kd->g1[i]==0 )
+    continue;
+	for ( j=0; j<scnt; ++j )
+	    if ( memcmp(splits[j].cols,kd->rowcols[i],kd->words*sizeof(uint32_t))==0 &&
+		    KCSplitFits(kd,splits[j].rcnt+1,splits[j].m,splits[j].g1+kd->g1[i],
+			    splits[j].g2,splits[j].devtabs+kd->rowdevtabs[i]) )
+	break;
+	if ( j==scnt ) {
+	    splits[j].cols = malloc(kd->words*sizeof(uint32_t));
+	    memcpy(splits[j].cols,kd->rowcols[i],kd->words*sizeof(uint32_t));
+	    for ( k=0; k<kc->second_cnt; ++k )
+		if ( kd->rowcols[i][k/32]&(1u<<(k%32)) ) {
+		    ++splits[j].m;
+		    splits[j].g2 += kd->g2[k];
+		}
+	    ++scnt;
+	}
+	splits[j].rows = realloc(splits[j].rows,(splits[j].rcnt+1)*sizeof(int));
+	splits[j].rows[splits[j].rcnt++] = i;
+	splits[j].g1 += kd->g1[i];
+	splits[j].devtabs += kd->rowdevtabs[i];
+    }
+    if ( scnt==0 ) {
+	/* No glyphs at all, an empty subtable will do */
+	splits[0].rows = calloc(1,sizeof(int));
+	splits[0].cols = calloc(kd->words,sizeof(uint32_t));
+	splits[0].rcnt = scnt = 1;
+    }
+
+    if ( scnt>KC_MAX_SPLITS ) {
+	/* Too many to compare each pair, just fill each subtable in order */
+	for ( i=0, j=1; j<scnt; ++j ) {
+	    if ( KCSplitSaving(kd,&splits[i],&splits[j],cols)!=INT_MIN )
+		KCSplitJoin(kd,&splits[i],&splits[j]);
+	    else
+		i = j;
+	}
+    } else if ( scnt>1 ) {
+	saving = malloc(scnt*scnt*sizeof(int));
+	for ( i=0; i<scnt; ++i )
+	    for ( j=i+1; j<scnt; ++j )
+		saving[i*scnt+j] = KCSplitSaving(kd,&splits[i],&splits[j],cols);
+	for (;;) {
+	    best = 0; bi = bj = -1;
+	    for ( i=0; i<scnt; ++i ) if ( splits[i].rcnt!=0 )
+		for ( j=i+1; j<scnt; ++j ) if ( splits[j].rcnt!=0 )
+		    if ( saving[i*scnt+j]>best ) {
+			best = saving[i*scnt+j];
+			bi = i; bj = j;
+		    }
+	    if ( bi==-1 )
+	break;
+	    KCSplitJoin(kd,&splits[bi],&splits[bj]);
+	    for ( k=0; k<scnt; ++k ) if ( k!=bi && splits[k].rcnt!=0 ) {
+		if ( k<bi )
+		    saving[k*scnt+bi] = KCSplitSaving(kd,&splits[k],&splits[bi],cols);
+		else
+		    saving[bi*scnt+k] = KCSplitSaving(kd,&splits[bi],&splits[k],cols);
 	    }
 	}
+	free(saving);
+    }
+    /* Squeeze out the ones we merged */
+    for ( i=j=0; i<scnt; ++i )
+	if ( splits[i].rcnt!=0 )
+	    splits[j++] = splits[i];
+    free(cols);
+    *_scnt = j;
+return( splits );
+}
+
+struct kcdevtabs {
+    int cnt, max;
+    DeviceTable **dts;
+    int *offsets;
+};
+
+/* Identical device tables are only written once in a subtable */
+static int KCDevTabOffset(struct kcdevtabs *kdt,DeviceTable *dt,int *next_devtab) {
+    int i;
+
+    if ( dt->corrections==NULL )
+return( 0 );
+    for ( i=0; i<kdt->cnt; ++i )
+	if ( DevTabsSame(kdt->dts[i],dt) )
+return( kdt->offsets[i] );
+    if ( kdt->cnt>=kdt->max ) {
+	kdt->dts = realloc(kdt->dts,(kdt->max+=32)*sizeof(DeviceTable *));
+	kdt->offsets = realloc(kdt->offsets,kdt->max*sizeof(int));
+    }
+    kdt->dts[kdt->cnt] = dt;
+    kdt->offsets[kdt->cnt++] = *next_devtab;
+    *next_devtab += DevTabLen(dt);
+return( kdt->offsets[kdt->cnt-1] );
+}
+
+static int KCRowOf(struct kcsplit *split,int class) {
+    int k;
+
+    for ( k=0; k<split->rcnt; ++k )
+	if ( split->rows[k]==class )
+return( k );
+return( -1 );
+}
+
+static int KCSplitHasDevTabs(KernClass *kc,struct kcsplit *split) {
+    int k, j;
+
+    for ( k=0; k<split->rcnt; ++k )
+	for ( j=0; j<kc->second_cnt; ++j )
+	    if ( kc->adjusts[split->rows[k]*kc->second_cnt+j].corrections!=NULL &&
+		    (j==0 || (split->cols[j/32]&(1u<<(j%32)))) )
+return( true );
+return( false );
+}
+
+/* Glyph pairs mean the same as class pairs only if the "everything else" */
+/*  column is empty, and no later subtable could see the pairs we leave out*/
+static int KCFormat1Size(struct kcdata *kd,struct kcsplit *split,int allowed) {
+    KernClass *kc = kd->kc;
+    int k, j, r, size;
+
+    if ( !allowed )
+return( INT_MAX );
+    size = 10 + (4+2*split->g1) + 2*split->g1 + split->devtabs;
+    for ( k=0; k<split->rcnt; ++k ) {
+	r = split->rows[k];
+	if ( kc->offsets[r*kc->second_cnt]!=0 || kc->adjusts[r*kc->second_cnt].corrections!=NULL )
+return( INT_MAX );
+	size += 2;
+	for ( j=1; j<kc->second_cnt; ++j )
+	    if ( kd->rowcols[r][j/32]&(1u<<(j%32)) )
+		size += kd->g2[j]*(2+kd->rec);
+    }
+return( size>65535 ? INT_MAX : size );
+}
+
+static void dumpgposkernclasspairs(FILE *gpos,struct otlobjects *ob,
+	struct kcdata *kd,struct kcsplit *split,int vf1,uint16_t *class1,uint16_t *class2,SplineChar **gs2,int numGlyphs,
+	SplineChar **glyphs) {
+    KernClass *kc = kd->kc;
+    uint32_t start = ftell(gpos), pos;
+    int k, j, r, i, cnt, gid, next_devtab;
+    int *setoffs = malloc(split->rcnt*sizeof(int));
+    struct kcdevtabs kdt;
+
+    memset(&kdt,0,sizeof(kdt));
+    putshort(gpos,1);		/* format 1 of the pair adjustment subtable */
+    putshort(gpos,0);		/* offset to coverage table */
+    putshort(gpos,vf1);
+    putshort(gpos,0x0000);
+    putshort(gpos,split->g1);
+    for ( i=0; i<split->g1; ++i )
+	putshort(gpos,0);	/* offsets to pair sets, fill in later */
+    /* Device tables first, so we know where they are when we get to the */
+    /*  pairs */
+    next_devtab = ftell(gpos)-start;
+    if ( vf1&0xf0 ) {
+	for ( k=0; k<split->rcnt; ++k )
+	    for ( j=1; j<kc->second_cnt; ++j )
+		KCDevTabOffset(&kdt,&kc->adjusts[split->rows[k]*kc->second_cnt+j],&next_devtab);
+	for ( i=0; i<kdt.cnt; ++i )
+	    dumpgposdevicetable(gpos,kdt.dts[i]);
+    }
+    for ( k=0; k<split->rcnt; ++k ) {
+	r = split->rows[k];
+	setoffs[k] = ftell(gpos)-start;
+	for ( cnt=gid=0; gid<numGlyphs; ++gid )
+	    if ( gs2[gid]!=NULL && (kd->rowcols[r][class2[gid]/32]&(1u<<(class2[gid]%32))) )
+		++cnt;
+	putshort(gpos,cnt);
+	for ( gid=0; gid<numGlyphs; ++gid ) {
+	    if ( gs2[gid]==NULL || !(kd->rowcols[r][class2[gid]/32]&(1u<<(class2[gid]%32))) )
+	continue;
+	    i = r*kc->second_cnt+class2[gid];
+	    putshort(gpos,gid);
+	    putshort(gpos,kc->offsets[i]);
+	    if ( vf1&0xf0 )	/* Finds the ones we wrote above */
+		putshort(gpos,KCDevTabOffset(&kdt,&kc->adjusts[i],&next_devtab));
+	}
+    }
+    free(kdt.dts); free(kdt.offsets);
+    pos = ftell(gpos);
+    for ( i=0; glyphs[i]!=NULL; ++i ) {
+	fseek(gpos,start+10+2*i,SEEK_SET);
+	putshort(gpos,setoffs[KCRowOf(split,class1[glyphs[i]->ttf_glyph])]);
+    }
+    fseek(gpos,pos,SEEK_SET);
+    OTLCoverage(ob,start+2,start,glyphs);
+    free(setoffs);
+}
+
+static void dumpgposkernclasssplit(FILE *gpos,struct otlobjects *ob,
+	struct kcdata *kd,struct kcsplit *split,int vf1,uint16_t *class1,uint16_t *class2,int numGlyphs,SplineChar **glyphs) {
+    KernClass *kc = kd->kc;
+    uint32_t start = ftell(gpos);
+    uint16_t *sclass, *colclass;
+    int k, j, c, i, gid, next_devtab, rec = (vf1&0xf0) ? 4 : 2;
+    int *cols = malloc((split->m+1)*sizeof(int));
+    struct kcdevtabs kdt;
+
+    /* Column 0 is everything else, then the ones this subtable needs */
+    cols[0] = 0;
+    colclass = calloc(kc->second_cnt,sizeof(uint16_t));
+    for ( j=1, c=1; j<kc->second_cnt; ++j )
+	if ( split->cols[j/32]&(1u<<(j%32)) ) {
+	    colclass[j] = c;
+	    cols[c++] = j;
+	}
+
+    putshort(gpos,2);		/* format 2 of the pair adjustment subtable */
+    putshort(gpos,0);		/* offset to coverage table */
+    putshort(gpos,vf1);
+    putshort(gpos,0x0000);	/* leave second char alone */
+    putshort(gpos,0);		/* offset to first glyph classes */
+    putshort(gpos,0);		/* offset to second glyph classes */
+    putshort(gpos,split->rcnt);
+    putshort(gpos,split->m+1);
+    memset(&kdt,0,sizeof(kdt));
+    next_devtab = 16 + split->rcnt*(split->m+1)*rec;
+    for ( k=0; k<split->rcnt; ++k ) {
+	for ( c=0; c<=split->m; ++c ) {
+	    i = split->rows[k]*kc->second_cnt+cols[c];
+	    putshort(gpos,kc->offsets[i]);
+	    if ( vf1&0xf0 )
+		putshort(gpos,KCDevTabOffset(&kdt,&kc->adjusts[i],&next_devtab));
+	}
     }
+    for ( i=0; i<kdt.cnt; ++i )
+	dumpgposdevicetable(gpos,kdt.dts[i]);
+    free(kdt.dts); free(kdt.offsets);
+    if ( next_devtab!=ftell(gpos)-start )
+	IError("Device table offsets screwed up in kerning class");
+
+    /* The first row is class 0, all glyphs in the coverage table which */
+    /*  aren't given a class */
+    sclass = calloc(numGlyphs,sizeof(uint16_t));
+    for ( i=0; glyphs[i]!=NULL; ++i ) {
+	gid = glyphs[i]->ttf_glyph;
+	sclass[gid] = KCRowOf(split,class1[gid]);
+    }
+    OTLClassDef(ob,start+8,start,sclass,numGlyphs,false);
+
+    for ( gid=0; gid<numGlyphs; ++gid )
+	sclass[gid] = colclass[class2[gid]];
+    OTLClassDef(ob,start+10,start,sclass,numGlyphs,false);
+
+    OTLCoverage(ob,start+2,start,glyphs);
+    if ( ftell(gpos)-start>65535 )
+	IError(_("I miscalculated the size of subtable %s, this means the kerning output is wrong."), kc->subtable->subtable_name );
+    free(sclass); free(colclass); free(cols);
 }
 
 static void dumpgposkernclass(FILE *gpos,SplineFont *sf,
 	struct lookup_subtable *sub, struct alltabs *at) {
-    uint32_t begin_off = ftell(gpos), pos;
-    uint16_t *class1, *class2;
     KernClass *kc = sub->kc, *test;
-    SplineChar **glyphs;
-    int i, isv;
-    int anydevtab = false;
-    int next_devtab;
+    uint16_t *class1, *class2;
+    SplineChar **gs1, **gs2, **glyphs;
+    struct kcdata kd;
+    struct kcsplit *splits;
+    struct lookup_subtable *later;
+    int numGlyphs = at->maxp.numGlyphs;
+    int i, j, k, r, gid, isv, scnt, cnt, vf1, anydevtab = false, last;
+    uint32_t start;
 
-    putshort(gpos,2);		/* format 2 of the pair adjustment subtable */
-    putshort(gpos,0);		/* offset to coverage table */
     for ( i=0; i<kc->first_cnt*kc->second_cnt; ++i ) {
 	if ( kc->adjusts[i].corrections!=NULL ) {
 	    anydevtab = true;
     break;
 	}
     }
-
     for ( test=sf->vkerns; test!=NULL && test!=kc; test=test->next );
     isv = test==kc;
-
-    if ( isv ) {
-	/* As far as I know there is no "bottom to top" writing direction */
-	/*  Oh. There is. Ogham, Runic */
-	putshort(gpos,anydevtab?0x0088:0x0008);	/* Alter YAdvance of first character */
-	putshort(gpos,0x0000);			/* leave second char alone */
-    } else {
-	putshort(gpos,anydevtab?0x0044:0x0004);	/* Alter XAdvance of first character */
-	putshort(gpos,0x0000);			/* leave second char alone */
-    }
-    class1 = ClassesFromNames(sf,kc->firsts,kc->first_cnt,at->maxp.numGlyphs,&glyphs,false);
-    glyphs = GlyphsFromClasses(glyphs,at->maxp.numGlyphs);
-    class2 = ClassesFromNames(sf,kc->seconds,kc->second_cnt,at->maxp.numGlyphs,NULL,false);
-    putshort(gpos,0);		/* offset to first glyph classes */
-    putshort(gpos,0);		/* offset to second glyph classes */
-    putshort(gpos,kc->first_cnt);
-    putshort(gpos,kc->second_cnt);
-    next_devtab = ftell(gpos)-begin_off + kc->first_cnt*kc->second_cnt*2*sizeof(uint16_t);
-    for ( i=0; i<kc->first_cnt*kc->second_cnt; ++i ) {
-	putshort(gpos,kc->offsets[i]);
-	if ( anydevtab && kc->adjusts[i].corrections!=NULL ) {
-	    putshort(gpos,next_devtab);
-	    next_devtab += DevTabLen(&kc->adjusts[i]);
-	} else if ( anydevtab )
-	    putshort(gpos,0);
-    }
-    if ( anydevtab ) {
-	for ( i=0; i<kc->first_cnt*kc->second_cnt; ++i ) {
-	    if ( kc->adjusts[i].corrections!=NULL )
-		dumpgposdevicetable(gpos,&kc->adjusts[i]);
+    /* Glyph pairs leave out the pairs which aren't kerned, and a later */
+    /*  subtable in the lookup might then kern them */
+    for ( later=sub->next; later!=NULL && later->unused; later=later->next );
+    last = later==NULL;
+
+    class1 = KernClassClasses(sf,kc,true,numGlyphs,&gs1,false);
+    class2 = KernClassClasses(sf,kc,false,numGlyphs,&gs2,false);
+
+    memset(&kd,0,sizeof(kd));
+    kd.kc = kc;
+    kd.words = (kc->second_cnt+31)/32;
+    kd.rec = anydevtab ? 4 : 2;
+    kd.numGlyphs = numGlyphs;
+    kd.g1 = calloc(kc->first_cnt,sizeof(int));
+    kd.g2 = calloc(kc->second_cnt,sizeof(int));
+    for ( gid=0; gid<numGlyphs; ++gid ) {
+	if ( gs1[gid]!=NULL ) ++kd.g1[class1[gid]];
+	if ( gs2[gid]!=NULL ) ++kd.g2[class2[gid]];
+    }
+    kd.rowcols = malloc(kc->first_cnt*sizeof(uint32_t *));
+    kd.rowdevtabs = calloc(kc->first_cnt,sizeof(int));
+    for ( r=0; r<kc->first_cnt; ++r ) {
+	kd.rowcols[r] = calloc(kd.words,sizeof(uint32_t));
+	for ( j=0; j<kc->second_cnt; ++j ) {
+	    kd.rowdevtabs[r] += DevTabLen(&kc->adjusts[r*kc->second_cnt+j]);
+	    if ( j!=0 && !KCCellsSame(kc,r*kc->second_cnt+j,r*kc->second_cnt) )
+		kd.rowcols[r][j/32] |= 1u<<(j%32);
 	}
-	if ( next_devtab!=ftell(gpos)-begin_off )
-	    IError("Device table offsets screwed up in kerning class");
     }
-    pos = ftell(gpos);
-    fseek(gpos,begin_off+4*sizeof(uint16_t),SEEK_SET);
-    putshort(gpos,pos-begin_off);
-    fseek(gpos,pos,SEEK_SET);
-    DumpClass(gpos,class1,at->maxp.numGlyphs);
 
-    pos = ftell(gpos);
-    fseek(gpos,begin_off+5*sizeof(uint16_t),SEEK_SET);
-    putshort(gpos,pos-begin_off);
-    fseek(gpos,pos,SEEK_SET);
-    DumpClass(gpos,class2,at->maxp.numGlyphs);
+    splits = KCSplitRows(&kd,&scnt);
+    if ( scnt>1 ) {
+	sub->extra_subtables = malloc((scnt+1)*sizeof(int32_t));
+	sub->extra_subtables[scnt] = -1;
+    }
+    glyphs = malloc((numGlyphs+1)*sizeof(SplineChar *));
+    for ( k=0; k<scnt; ++k ) {
+	struct kcsplit *split = &splits[k];
+	int most = 0;
+	/* Put the row with the most glyphs first, it gets class 0 so its */
+	/*  glyphs needn't be listed */
+	for ( i=1; i<split->rcnt; ++i )
+	    if ( kd.g1[split->rows[i]]>kd.g1[split->rows[most]] )
+		most = i;
+	r = split->rows[most]; split->rows[most] = split->rows[0]; split->rows[0] = r;
+	for ( gid=cnt=0; gid<numGlyphs; ++gid )
+	    if ( gs1[gid]!=NULL && KCRowOf(split,class1[gid])!=-1 )
+		glyphs[cnt++] = gs1[gid];
+	glyphs[cnt] = NULL;
 
-    pos = ftell(gpos);
-    fseek(gpos,begin_off+sizeof(uint16_t),SEEK_SET);
-    putshort(gpos,pos-begin_off);
-    fseek(gpos,pos,SEEK_SET);
-    dumpcoveragetable(gpos,glyphs);
+	vf1 = isv ? 0x0008 : 0x0004;	/* Alter the advance of the first glyph */
+	if ( KCSplitHasDevTabs(kc,split) )
+	    vf1 |= vf1<<4;
+	start = ftell(gpos);
+	if ( scnt>1 )
+	    sub->extra_subtables[k] = start;
+	if ( KCFormat1Size(&kd,split,last) <
+		KCSplitSize(&kd,split->rcnt,split->m,split->g1,split->g2)+split->devtabs )
+	    dumpgposkernclasspairs(gpos,at->otlobjects,&kd,split,vf1,class1,class2,gs2,numGlyphs,glyphs);
+	else
+	    dumpgposkernclasssplit(gpos,at->otlobjects,&kd,split,vf1,class1,class2,numGlyphs,glyphs);
+	if ( scnt>1 )
+	    OTLObjectsFit(gpos,at->otlobjects,start,sub);
+	free(split->rows); free(split->cols);
+    }
 
+    for ( r=0; r<kc->first_cnt; ++r )
+	free(kd.rowcols[r]);
+    free(kd.rowcols); free(kd.rowdevtabs);
+    free(kd.g1); free(kd.g2);
+    free(splits);
     free(glyphs);
+    free(gs1); free(gs2);
     free(class1);
     free(class2);
 }
@@ -1729,12 +2373,12 @@ static void dumpanchor(FILE *gpos,AnchorPoint *ap, int is_ttf ) {
 }
 
 static void dumpgposCursiveAttach(FILE *gpos, SplineFont *sf,
-	struct lookup_subtable *sub,struct glyphinfo *gi) {
+	struct lookup_subtable *sub,struct glyphinfo *gi,struct otlobjects *ob) {
     AnchorClass *ac, *testac;
     SplineChar **entryexit;
     int cnt, offset,j;
     AnchorPoint *ap, *entry, *exit;
-    uint32_t coverage_offset, start;
+    uint32_t start;
 
     ac = NULL;
     for ( testac=sf->anchor; testac!=NULL; testac = testac->next ) {
@@ -1801,11 +2445,7 @@ return;
 	if ( exit!=NULL )
 	    dumpanchor(gpos,exit,gi->is_ttf);
     }
-    coverage_offset = ftell(gpos);
-    dumpcoveragetable(gpos,entryexit);
-    fseek(gpos,start+2,SEEK_SET);
-    putshort(gpos,coverage_offset-start);
-    fseek(gpos,0,SEEK_END);
+    OTLCoverage(ob,start+2,start,entryexit);
 
     free(entryexit);
 }
@@ -1844,10 +2484,10 @@ static SplineChar **allmarkglyphs(SplineChar ***glyphlist, int classcnt) {
 static void dumpgposAnchorData(FILE *gpos,AnchorClass *_ac,
 	enum anchor_type at,
 	SplineChar ***marks,SplineChar **base,
-	int classcnt, struct glyphinfo *gi) {
+	int classcnt, struct glyphinfo *gi, struct otlobjects *ob) {
     AnchorClass *ac=NULL;
     int j,cnt,k,l, pos, offset, tot, max;
-    uint32_t coverage_offset, markarray_offset, subtable_start;
+    uint32_t markarray_offset, subtable_start;
     AnchorPoint *ap, **aps;
     SplineChar **markglyphs;
 
@@ -1962,17 +2602,12 @@ static void dumpgposAnchorData(FILE *gpos,AnchorClass *_ac,
 	}
 	free(aps); aps = NULL;
     }
-    coverage_offset = ftell(gpos);
-    fseek(gpos,subtable_start+4,SEEK_SET);
-    putshort(gpos,coverage_offset-subtable_start);
-    fseek(gpos,0,SEEK_END);
-    dumpcoveragetable(gpos,base);
+    OTLCoverage(ob,subtable_start+4,subtable_start,base);
 
-    /* We tried sharing the mark table, (among all these sub-tables) but */
-    /*  that doesn't work because we need to be able to reorder the sub-tables */
+    /* The subtables of a lookup are often for the same marks, they can */
+    /*  share a mark coverage table */
     markglyphs = allmarkglyphs(marks,classcnt);
-    coverage_offset = ftell(gpos);
-    dumpcoveragetable(gpos,markglyphs);
+    OTLCoverage(ob,subtable_start+2,subtable_start,markglyphs);
     markarray_offset = ftell(gpos);
     for ( cnt=0; markglyphs[cnt]!=NULL; ++cnt );
     putshort(gpos,cnt);
@@ -2016,9 +2651,10 @@ static void dumpgposAnchorData(FILE *gpos,AnchorClass *_ac,
     if ( markglyphs!=marks[0] )
 	free(markglyphs);
 
-    fseek(gpos,subtable_start+2,SEEK_SET);	/* mark coverage table offset */
-    putshort(gpos,coverage_offset-subtable_start);
-    fseek(gpos,4,SEEK_CUR);
+    /* A big base array may leave the coverage tables out of reach if they */
+    /*  come after the mark array, then they go in front of it */
+    markarray_offset = OTLObjectsFit(gpos,ob,markarray_offset,NULL);
+    fseek(gpos,subtable_start+8,SEEK_SET);	/* mark array offset */
     putshort(gpos,markarray_offset-subtable_start);
 
     fseek(gpos,0,SEEK_END);
@@ -2026,7 +2662,7 @@ static void dumpgposAnchorData(FILE *gpos,AnchorClass *_ac,
 
 static void dumpGSUBsimplesubs(FILE *gsub,SplineFont *sf,struct lookup_subtable *sub, struct alltabs *at) {
     int cnt, diff, ok = true;
-    int32_t coverage_pos, end;
+    int32_t coverage_pos;
     SplineChar **glyphs, ***maps;
 
     glyphs = SFOrderedGlyphsWithPSTinSubtable(sf,sub,at->subtable_map);
@@ -2049,11 +2685,7 @@ static void dumpGSUBsimplesubs(FILE *gsub,SplineFont *sf,struct lookup_subtable
 	for ( cnt = 0; glyphs[cnt]!=NULL; ++cnt )
 	    putshort(gsub,(*maps[cnt])->ttf_glyph);
     }
-    end = ftell(gsub);
-    fseek(gsub,coverage_pos,SEEK_SET);
-    putshort(gsub,end-coverage_pos+2);
-    fseek(gsub,end,SEEK_SET);
-    dumpcoveragetable(gsub,glyphs);
+    OTLCoverage(at->otlobjects,coverage_pos,coverage_pos-2,glyphs);
 
     free(glyphs);
     GlyphMapFree(maps);
@@ -2061,7 +2693,7 @@ static void dumpGSUBsimplesubs(FILE *gsub,SplineFont *sf,struct lookup_subtable
 
 static void dumpGSUBmultiplesubs(FILE *gsub,SplineFont *sf,struct lookup_subtable *sub, struct alltabs *at) {
     int cnt, offset;
-    int32_t coverage_pos, end;
+    int32_t coverage_pos;
     int gc;
     SplineChar **glyphs, ***maps;
 
@@ -2093,11 +2725,7 @@ static void dumpGSUBmultiplesubs(FILE *gsub,SplineFont *sf,struct lookup_subtabl
 	for ( gc=0; maps[cnt][gc]!=NULL; ++gc )
 	    putshort(gsub,maps[cnt][gc]->ttf_glyph);
     }
-    end = ftell(gsub);
-    fseek(gsub,coverage_pos,SEEK_SET);
-    putshort(gsub,end-coverage_pos+2);
-    fseek(gsub,end,SEEK_SET);
-    dumpcoveragetable(gsub,glyphs);
+    OTLCoverage(at->otlobjects,coverage_pos,coverage_pos-2,glyphs);
 
     free(glyphs);
     GlyphMapFree(maps);
@@ -2171,13 +2799,11 @@ static void dumpGSUBligdata(FILE *gsub,SplineFont *sf,
     free(ligoffsets);
     if ( glyphs!=NULL ) {
 	here = ftell(gsub);
-	fseek(gsub,coverage_pos,SEEK_SET);
-	putshort(gsub,here-coverage_pos+2);
 	fseek(gsub,next_val_pos,SEEK_SET);
 	for ( i=0; i<cnt; ++i )
 	    putshort(gsub,offsets[i]);
 	fseek(gsub,here,SEEK_SET);
-	dumpcoveragetable(gsub,glyphs);
+	OTLCoverage(at->otlobjects,coverage_pos,coverage_pos-2,glyphs);
 	free(glyphs);
 	free(offsets);
     }
@@ -2309,11 +2935,11 @@ static void dumpg___ContextChainGlyphs(FILE *lfile,SplineFont *sf,
     for ( cnt=0; glyphs[cnt]!=NULL; ++cnt );
 
     putshort(lfile,1);		/* Sub format 1 => glyph lists */
-    putshort(lfile,(3+cnt)*sizeof(short));	/* offset to coverage */
+    putshort(lfile,0);		/* offset to coverage */
     putshort(lfile,cnt);
     for ( i=0; i<cnt; ++i )
 	putshort(lfile,0);	/* Offset to rule */
-    dumpcoveragetable(lfile,glyphs);
+    OTLCoverage(at->otlobjects,base+2,base,glyphs);
 
     maxcontext = 0;
 
@@ -2389,7 +3015,7 @@ static void dumpg___ContextChainClass(FILE *lfile,SplineFont *sf,
 	struct lookup_subtable *sub, struct alltabs *at) {
     FPST *fpst = sub->fpst;
     int iscontext = fpst->type==pst_contextpos || fpst->type==pst_contextsub;
-    uint32_t base = ftell(lfile), rulebase, pos, subpos, npos;
+    uint32_t base = ftell(lfile), rulebase, pos, subpos;
     uint16_t *initialclasses, *iclass, *bclass, *lclass;
     SplineChar **iglyphs, **bglyphs, **lglyphs, **glyphs;
     int i,ii,cnt, subcnt, j,k,l , maxcontext,curcontext;
@@ -2416,55 +3042,19 @@ static void dumpg___ContextChainClass(FILE *lfile,SplineFont *sf,
 	bclass = ClassesFromNames(sf,fpst->bclass,fpst->bccnt,at->maxp.numGlyphs,&bglyphs,false);
 	lclass = ClassesFromNames(sf,fpst->fclass,fpst->fccnt,at->maxp.numGlyphs,&lglyphs,false);
     }
-    pos = ftell(lfile);
-    fseek(lfile,base+sizeof(uint16_t),SEEK_SET);
-    putshort(lfile,pos-base);
-    fseek(lfile,pos,SEEK_SET);
     glyphs = GlyphsFromInitialClasses(iglyphs,at->maxp.numGlyphs,iclass,initialclasses);
-    dumpcoveragetable(lfile,glyphs);
+    OTLCoverage(at->otlobjects,base+2,base,glyphs);
     free(glyphs);
     free(iglyphs); free(bglyphs); free(lglyphs);
 
+    /* Identical class definitions will be shared */
     if ( iscontext ) {
-	pos = ftell(lfile);
-	fseek(lfile,base+2*sizeof(uint16_t),SEEK_SET);
-	putshort(lfile,pos-base);
-	fseek(lfile,pos,SEEK_SET);
-	DumpClass(lfile,iclass,at->maxp.numGlyphs);
+	OTLClassDef(at->otlobjects,base+4,base,iclass,at->maxp.numGlyphs,false);
 	free(iclass);
     } else {
-	pos = ftell(lfile);
-	fseek(lfile,base+2*sizeof(uint16_t),SEEK_SET);
-	putshort(lfile,pos-base);
-	fseek(lfile,pos,SEEK_SET);
-	DumpClass(lfile,bclass,at->maxp.numGlyphs);
-	if ( ClassesMatch(fpst->bccnt,fpst->bclass,fpst->nccnt,fpst->nclass)) {
-	    npos = pos;
-	    fseek(lfile,base+3*sizeof(uint16_t),SEEK_SET);
-	    putshort(lfile,npos-base);
-	    fseek(lfile,0,SEEK_END);
-	} else {
-	    npos = ftell(lfile);
-	    fseek(lfile,base+3*sizeof(uint16_t),SEEK_SET);
-	    putshort(lfile,npos-base);
-	    fseek(lfile,npos,SEEK_SET);
-	    DumpClass(lfile,iclass,at->maxp.numGlyphs);
-	}
-	if ( ClassesMatch(fpst->fccnt,fpst->fclass,fpst->bccnt,fpst->bclass)) {
-	    fseek(lfile,base+4*sizeof(uint16_t),SEEK_SET);
-	    putshort(lfile,pos-base);
-	    fseek(lfile,0,SEEK_END);
-	} else if ( ClassesMatch(fpst->fccnt,fpst->fclass,fpst->nccnt,fpst->nclass)) {
-	    fseek(lfile,base+4*sizeof(uint16_t),SEEK_SET);
-	    putshort(lfile,npos-base);
-	    fseek(lfile,0,SEEK_END);
-	} else {
-	    pos = ftell(lfile);
-	    fseek(lfile,base+4*sizeof(uint16_t),SEEK_SET);
-	    putshort(lfile,pos-base);
-	    fseek(lfile,pos,SEEK_SET);
-	    DumpClass(lfile,lclass,at->maxp.numGlyphs);
-	}
+	OTLClassDef(at->otlobjects,base+4,base,bclass,at->maxp.numGlyphs,false);
+	OTLClassDef(at->otlobjects,base+6,base,iclass,at->maxp.numGlyphs,false);
+	OTLClassDef(at->otlobjects,base+8,base,lclass,at->maxp.numGlyphs,false);
 	free(iclass); free(bclass); free(lclass);
     }
 
@@ -2532,7 +3122,7 @@ static void dumpg___ContextChainCoverage(FILE *lfile,SplineFont *sf,
 	struct lookup_subtable *sub, struct alltabs *at) {
     FPST *fpst = sub->fpst;
     int iscontext = fpst->type==pst_contextpos || fpst->type==pst_contextsub;
-    uint32_t base = ftell(lfile), ibase, lbase, bbase;
+    uint32_t base = ftell(lfile), ibase = 0, lbase, bbase;
     int i, l;
     SplineChar **glyphs;
     int curcontext;
@@ -2561,12 +3151,8 @@ static void dumpg___ContextChainCoverage(FILE *lfile,SplineFont *sf,
 		putshort(lfile,fpst->rules[0].lookups[i].lookup->lookup_index);
 	    }
 	for ( i=0; i<fpst->rules[0].u.coverage.ncnt; ++i ) {
-	    uint32_t pos = ftell(lfile);
-	    fseek(lfile,base+6+2*i,SEEK_SET);
-	    putshort(lfile,pos-base);
-	    fseek(lfile,pos,SEEK_SET);
 	    glyphs = OrderedGlyphsFromNames(sf,fpst->rules[0].u.coverage.ncovers[i]);
-	    dumpcoveragetable(lfile,glyphs);
+	    OTLCoverage(at->otlobjects,base+6+2*i,base,glyphs);
 	    free(glyphs);
 	}
     } else {
@@ -2606,30 +3192,18 @@ static void dumpg___ContextChainCoverage(FILE *lfile,SplineFont *sf,
 	    free(glyphs);
 	}
 	for ( i=0; i<fpst->rules[0].u.coverage.ncnt; ++i ) {
-	    uint32_t pos = ftell(lfile);
-	    fseek(lfile,ibase+2*i,SEEK_SET);
-	    putshort(lfile,pos-base);
-	    fseek(lfile,pos,SEEK_SET);
 	    glyphs = OrderedGlyphsFromNames(sf,fpst->rules[0].u.coverage.ncovers[i]);
-	    dumpcoveragetable(lfile,glyphs);
+	    OTLCoverage(at->otlobjects,ibase+2*i,base,glyphs);
 	    free(glyphs);
 	}
 	for ( i=0; i<fpst->rules[0].u.coverage.bcnt; ++i ) {
-	    uint32_t pos = ftell(lfile);
-	    fseek(lfile,bbase+2*i,SEEK_SET);
-	    putshort(lfile,pos-base);
-	    fseek(lfile,pos,SEEK_SET);
 	    glyphs = OrderedGlyphsFromNames(sf,fpst->rules[0].u.coverage.bcovers[i]);
-	    dumpcoveragetable(lfile,glyphs);
+	    OTLCoverage(at->otlobjects,bbase+2*i,base,glyphs);
 	    free(glyphs);
 	}
 	for ( i=0; i<fpst->rules[0].u.coverage.fcnt; ++i ) {
-	    uint32_t pos = ftell(lfile);
-	    fseek(lfile,lbase+2*i,SEEK_SET);
-	    putshort(lfile,pos-base);
-	    fseek(lfile,pos,SEEK_SET);
 	    glyphs = OrderedGlyphsFromNames(sf,fpst->rules[0].u.coverage.fcovers[i]);
-	    dumpcoveragetable(lfile,glyphs);
+	    OTLCoverage(at->otlobjects,lbase+2*i,base,glyphs);
 	    free(glyphs);
 	}
     }
@@ -2661,7 +3235,7 @@ static void dumpg___ContextChain(FILE *lfile,SplineFont *sf,
 }
 
 static void AnchorsAway(FILE *lfile,SplineFont *sf,
-	struct lookup_subtable *sub, struct glyphinfo *gi ) {
+	struct lookup_subtable *sub, struct glyphinfo *gi, struct otlobjects *ob ) {
     SplineChar **base, **lig, **mkmk;
     AnchorClass *ac, *acfirst;
     SplineChar ***marks;
@@ -2695,15 +3269,15 @@ static void AnchorsAway(FILE *lfile,SplineFont *sf,
     switch ( sub->lookup->lookup_type ) {
       case gpos_mark2base:
 	if ( marks[0]!=NULL && base!=NULL )
-	    dumpgposAnchorData(lfile,acfirst,at_basechar,marks,base,classcnt,gi);
+	    dumpgposAnchorData(lfile,acfirst,at_basechar,marks,base,classcnt,gi,ob);
       break;
       case gpos_mark2ligature:
 	if ( marks[0]!=NULL && lig!=NULL )
-	    dumpgposAnchorData(lfile,acfirst,at_baselig,marks,lig,classcnt,gi);
+	    dumpgposAnchorData(lfile,acfirst,at_baselig,marks,lig,classcnt,gi,ob);
       break;
       case gpos_mark2mark:
 	if ( marks[0]!=NULL && mkmk!=NULL )
-	    dumpgposAnchorData(lfile,acfirst,at_basemark,marks,mkmk,classcnt,gi);
+	    dumpgposAnchorData(lfile,acfirst,at_basemark,marks,mkmk,classcnt,gi,ob);
       break;
       default: break;
     }
@@ -2794,6 +3368,7 @@ static void otf_dumpALookup(FILE *lfile, OTLookup *otl, SplineFont *sf,
     int lookup_sub_table_contains_no_data_count = 0;
     int lookup_sub_table_is_too_big_count = 0;
 
+    at->otlobjects = OTLObjectsNew();
     otl->lookup_offset = ftell(lfile);
     for ( sub = otl->subtables; sub!=NULL; sub=sub->next ) {
 	sub->extra_subtables = NULL;
@@ -2817,13 +3392,13 @@ static void otf_dumpALookup(FILE *lfile, OTLookup *otl, SplineFont *sf,
 	      break;
 
 	      case gpos_cursive:
-		dumpgposCursiveAttach(lfile,sf,sub,&at->gi);
+		dumpgposCursiveAttach(lfile,sf,sub,&at->gi,at->otlobjects);
 	      break;
 
 	      case gpos_mark2base:
 	      case gpos_mark2ligature:
 	      case gpos_mark2mark:
-		AnchorsAway(lfile,sf,sub,&at->gi);
+		AnchorsAway(lfile,sf,sub,&at->gi,at->otlobjects);
 	      break;
 
 	      case gpos_contextchain:
@@ -2867,8 +3442,14 @@ static void otf_dumpALookup(FILE *lfile, OTLookup *otl, SplineFont *sf,
 		  	sub->subtable_name, sub->lookup->lookup_name );
 		  lookup_sub_table_is_too_big_count ++;
 		}
+	    if ( !sub->unused )
+		OTLObjectsFit(lfile,at->otlobjects,sub->subtable_offset,sub);
 	}
     }
+    /* The coverage and class tables go after all the subtables */
+    OTLObjectsFlush(lfile,at->otlobjects);
+    OTLObjectsFree(at->otlobjects);
+    at->otlobjects = NULL;
     otl->lookup_length = ftell(lfile)-otl->lookup_offset;
 }
 
@@ -3529,6 +4110,7 @@ void otf_dumpgpos(struct alltabs *at, SplineFont *sf) {
     /*  be consistent. It stores it in the much more complicated gpos table */
     AnchorClass *ac;
 
+    TRACE_BEGIN("GPOS");
     for ( ac=sf->anchor; ac!=NULL; ac=ac->next )
 	ac->processed = false;
 
@@ -3538,11 +4120,13 @@ void otf_dumpgpos(struct alltabs *at, SplineFont *sf) {
 	if ( at->gposlen&1 ) putc('\0',at->gpos);
 	if ( (at->gposlen+1)&2 ) putshort(at->gpos,0);
     }
+    TRACE_END("GPOS");
 }
 
 void otf_dumpgsub(struct alltabs *at, SplineFont *sf) {
     /* substitutions such as: Ligatures, cjk vertical rotation replacement, */
     /*  arabic forms, small caps, ... */
+    TRACE_BEGIN("GSUB");
     SFLigaturePrepare(sf);
     at->gsub = dumpg___info(at, sf, false);
     if ( at->gsub!=NULL ) {
@@ -3551,6 +4135,7 @@ void otf_dumpgsub(struct alltabs *at, SplineFont *sf) {
 	if ( (at->gsublen+1)&2 ) putshort(at->gsub,0);
     }
     SFLigatureCleanup(sf);
+    TRACE_END("GSUB");
 }
 
 int LigCaretCnt(SplineChar *sc) {
@@ -3716,10 +4301,10 @@ void otf_dumpgdef(struct alltabs *at, SplineFont *sf) {
     /*  control of lookup flags */
     /* All my example fonts contain a ligature caret list subtable, which is */
     /*  empty. Odd, but perhaps important */
-    int i,j,k, lcnt, needsclass;
+    int i,k, lcnt, needsclass;
     int pos, offset;
-    int cnt, start, last, lastval;
     SplineChar **glyphs, *sc;
+    struct otlobjects *ob;
 
     /* Don't look in the cidmaster if we are only dumping one subfont */
     if ( sf->cidmaster && sf->cidmaster->glyphs!=NULL ) sf = sf->cidmaster;
@@ -3751,11 +4336,10 @@ return;					/* No anchor positioning, no ligature carets */
     at->gdef = GFileTmpfile();
     if ( sf->mark_set_cnt==0 ) {
 	putlong(at->gdef,0x00010000);		/* Version */
-        putshort(at->gdef, needsclass ? 12 : 0 ); /* glyph class defn table */
     } else {
 	putlong(at->gdef,0x00010002);		/* Version with mark sets */
-        putshort(at->gdef, needsclass ? 14 : 0 ); /* glyph class defn table */
     }
+    putshort(at->gdef, 0 );			/* glyph class defn table (fix up later) */
     putshort(at->gdef, 0 );			/* attachment list table */
     putshort(at->gdef, 0 );			/* ligature caret table (come back and fix up later) */
     putshort(at->gdef, 0 );			/* mark attachment class table */
@@ -3763,43 +4347,33 @@ return;					/* No anchor positioning, no ligature carets */
         putshort(at->gdef, 0 );                 /* mark attachment set table only meaningful if version is 0x10002*/
     }
 
+    ob = OTLObjectsNew();
+
 	/* Glyph class subtable */
     if ( needsclass ) {
 	/* Mark shouldn't conflict with anything */
 	/* Ligature is more important than Base */
 	/* Component is not used */
-        /* ttx can't seem to support class format type 1 so let's output type 2 */
-	for ( j=0; j<2; ++j ) {
-	    cnt = 0;
-	    for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 ) {
-		sc = sf->glyphs[at->gi.bygid[i]];
-		if ( sc!=NULL && sc->ttf_glyph!=-1 ) {
-		    lastval = gdefclass(sc);
-		    start = last = i;
-		    for ( ; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 ) {
-			sc = sf->glyphs[at->gi.bygid[i]];
-			if ( gdefclass(sc)!=lastval )
-		    break;
-			last = i;
-		    }
-		    --i;
-		    if ( lastval!=0 ) {
-			if ( j==1 ) {
-			    putshort(at->gdef,start);
-			    putshort(at->gdef,last);
-			    putshort(at->gdef,lastval);
-			}
-			++cnt;
-		    }
-		}
-	    }
-	    if ( j==0 ) {
-		putshort(at->gdef,2);	/* class format 2, range list by class */
-		putshort(at->gdef,cnt);
-	    }
+	uint16_t *gclasses = calloc(at->maxp.numGlyphs,sizeof(uint16_t));
+	for ( i=0; i<at->gi.gcnt && i<at->maxp.numGlyphs; ++i ) if ( at->gi.bygid[i]!=-1 ) {
+	    sc = sf->glyphs[at->gi.bygid[i]];
+	    if ( sc!=NULL && sc->ttf_glyph!=-1 )
+		gclasses[i] = gdefclass(sc);
 	}
+	/* ttx can't seem to support class format type 1 so let's output type 2 */
+	OTLClassDef(ob,4,0,gclasses,at->maxp.numGlyphs,true);
+	free(gclasses);
     }
 
+	/* Mark Attachment Class Subtable */
+    if ( sf->mark_class_cnt>0 ) {
+	uint16_t *mclasses = ClassesFromNames(sf,sf->mark_classes,sf->mark_class_cnt,at->maxp.numGlyphs,NULL,false);
+	OTLClassDef(ob,10,0,mclasses,at->maxp.numGlyphs,false);
+	free(mclasses);
+    }
+    /* Offsets from the header are short, so put these right after it */
+    OTLObjectsFlush(at->gdef,ob);
+
 	/* Ligature caret subtable. Always include this if we have a GDEF */
     pos = ftell(at->gdef);
     fseek(at->gdef,8,SEEK_SET);			/* location of lig caret table offset */
@@ -3822,25 +4396,11 @@ return;					/* No anchor positioning, no ligature carets */
 	}
 	for ( i=0; i<lcnt; ++i )
 	    DumpLigCarets(at->gdef,glyphs[i]);
-	offset = ftell(at->gdef);
-	fseek(at->gdef,pos,SEEK_SET);
-	putshort(at->gdef,offset-pos);
-	fseek(at->gdef,0,SEEK_END);
-	dumpcoveragetable(at->gdef,glyphs);
-    }
-
-	/* Mark Attachment Class Subtable */
-    if ( sf->mark_class_cnt>0 ) {
-	uint16_t *mclasses = ClassesFromNames(sf,sf->mark_classes,sf->mark_class_cnt,at->maxp.numGlyphs,NULL,false);
-	pos = ftell(at->gdef);
-	fseek(at->gdef,10,SEEK_SET);		/* location of mark attach table offset */
-	putshort(at->gdef,pos);
-	fseek(at->gdef,0,SEEK_END);
-	DumpClass(at->gdef,mclasses,at->maxp.numGlyphs);
-	free(mclasses);
+	OTLCoverage(ob,pos,pos,glyphs);
+	free(glyphs);
     }
 
-	/* Mark Attachment Class Subtable */
+	/* Mark Glyph Sets */
     if ( sf->mark_set_cnt>0 ) {
 	pos = ftell(at->gdef);
 	fseek(at->gdef,12,SEEK_SET);		/* location of mark attach table offset */
@@ -3851,15 +4411,16 @@ return;					/* No anchor positioning, no ligature carets */
 	for ( i=0; i<sf->mark_set_cnt; ++i )
 	    putlong(at->gdef,0);
 	for ( i=0; i<sf->mark_set_cnt; ++i ) {
-	    int here = ftell(at->gdef);
-	    fseek(at->gdef,pos+4+4*i,SEEK_SET);
-	    putlong(at->gdef,here-pos);
-	    fseek(at->gdef,0,SEEK_END);
+	    int len;
+	    uint16_t *data;
 	    glyphs = OrderedGlyphsFromNames(sf,sf->mark_sets[i]);
-	    dumpcoveragetable(at->gdef,glyphs);
+	    data = CoverageData(glyphs,&len);
+	    OTLObjectRef(ob,pos+4+4*i,pos,OTLObjectAdd(ob,data,len),true);
 	    free(glyphs);
 	}
     }
+    OTLObjectsFlush(at->gdef,ob);
+    OTLObjectsFree(ob);
 
     at->gdeflen = ftell(at->gdef);
     if ( at->gdeflen&1 ) putc('\0',at->gdef);
@@ -3907,7 +4468,7 @@ return( ret );
 static void ttf_math_dump_italic_top(FILE *mathf,struct alltabs *at, SplineFont *sf, int is_italic) {
     int i, gid, len;
     SplineChar *sc, **glyphs;
-    uint32_t coverage_pos, coverage_table;
+    uint32_t coverage_pos;
     uint32_t devtab_offset;
     DeviceTable *devtab;
 
@@ -3944,15 +4505,12 @@ static void ttf_math_dump_italic_top(FILE *mathf,struct alltabs *at, SplineFont
     if ( devtab_offset!=ftell(mathf)-coverage_pos )
 	IError("Actual end did not match expected end in %s table, expected=%d, actual=%d",
 		is_italic ? "italic" : "top accent", devtab_offset, ftell(mathf)-coverage_pos );
-    coverage_table = ftell(mathf);
-    fseek( mathf, coverage_pos, SEEK_SET);
-    putshort(mathf,coverage_table-coverage_pos);
-    fseek(mathf,coverage_table,SEEK_SET);
-    dumpcoveragetable(mathf,glyphs);
+    OTLCoverage(at->otlobjects,coverage_pos,coverage_pos,glyphs);
     free(glyphs);
 }
 
-static void ttf_math_dump_extended(FILE *mathf,struct alltabs *at, SplineFont *sf) {
+static void ttf_math_dump_extended(FILE *mathf,struct alltabs *at, SplineFont *sf,
+	uint32_t gi_start) {
     int i, gid, len;
     SplineChar *sc, **glyphs;
 
@@ -3966,7 +4524,8 @@ static void ttf_math_dump_extended(FILE *mathf,struct alltabs *at, SplineFont *s
 	    if ( sc->is_extended_shape )
 		glyphs[len++] = sc;
     glyphs[len] = NULL;
-    dumpcoveragetable(mathf,glyphs);
+    /* The extended shape table is just a coverage table */
+    OTLCoverage(at->otlobjects,gi_start+4,gi_start,glyphs);
     free(glyphs);
 }
 
@@ -4014,7 +4573,7 @@ static void ttf_math_dump_mathkerndevtab(FILE *mathf,struct mathkernvertex *mkv)
 static void ttf_math_dump_mathkern(FILE *mathf,struct alltabs *at, SplineFont *sf) {
     int i, gid, len;
     SplineChar *sc, **glyphs;
-    uint32_t coverage_pos, coverage_table, kr_pos, midpos2;
+    uint32_t coverage_pos, kr_pos, midpos2;
 
     /* Figure out our glyph list (and count) */
     for ( i=len=0; i<at->gi.gcnt; ++i )
@@ -4094,11 +4653,7 @@ static void ttf_math_dump_mathkern(FILE *mathf,struct alltabs *at, SplineFont *s
 	IError("Actual end did not match expected end in mathkern table, expected=%d, actual=%d",
 		kr_pos, ftell(mathf) );
 
-    coverage_table = ftell(mathf);
-    fseek( mathf, coverage_pos, SEEK_SET);
-    putshort(mathf,coverage_table-coverage_pos);
-    fseek(mathf,coverage_table,SEEK_SET);
-    dumpcoveragetable(mathf,glyphs);
+    OTLCoverage(at->otlobjects,coverage_pos,coverage_pos,glyphs);
     free(glyphs);
 }
 
@@ -4216,7 +4771,7 @@ return(devtab_pos);
 static void ttf_math_dump_glyphvariant(FILE *mathf,struct alltabs *at, SplineFont *sf) {
     int i, gid, vlen, hlen;
     SplineChar *sc, **vglyphs, **hglyphs;
-    uint32_t coverage_pos, coverage_table, offset, pos, assembly_pos;
+    uint32_t coverage_pos, offset, pos, assembly_pos;
 
     /* Figure out our glyph list (and count) */
     for ( i=vlen=hlen=0; i<at->gi.gcnt; ++i )
@@ -4286,21 +4841,11 @@ static void ttf_math_dump_glyphvariant(FILE *mathf,struct alltabs *at, SplineFon
 	if ( hglyphs[i]->horiz_variants->part_cnt!=0 &&
 		hglyphs[i]->horiz_variants->italic_adjusts!=NULL )
 	    dumpgposdevicetable(mathf,hglyphs[i]->horiz_variants->italic_adjusts);
-    if ( vlen!=0 ) {
-	coverage_table = ftell(mathf);
-	fseek( mathf, coverage_pos, SEEK_SET);
-	putshort(mathf,coverage_table-(coverage_pos-2));
-	fseek(mathf,coverage_table,SEEK_SET);
-	dumpcoveragetable(mathf,vglyphs);
-    }
+    if ( vlen!=0 )
+	OTLCoverage(at->otlobjects,coverage_pos,coverage_pos-2,vglyphs);
     free(vglyphs);
-    if ( hlen!=0 ) {
-	coverage_table = ftell(mathf);
-	fseek( mathf, coverage_pos+2, SEEK_SET);
-	putshort(mathf,coverage_table-(coverage_pos-2));
-	fseek(mathf,coverage_table,SEEK_SET);
-	dumpcoveragetable(mathf,hglyphs);
-    }
+    if ( hlen!=0 )
+	OTLCoverage(at->otlobjects,coverage_pos+2,coverage_pos-2,hglyphs);
     free(hglyphs);
 }
 
@@ -4319,6 +4864,7 @@ void otf_dump_math(struct alltabs *at, SplineFont *sf) {
 	return;
 
     at->math = mathf = GFileTmpfile();
+    at->otlobjects = OTLObjectsNew();
 
     putlong(mathf,  0x00010000 );		/* Version 1 */
     putshort(mathf, 10);			/* Offset to constants */
@@ -4364,41 +4910,38 @@ void otf_dump_math(struct alltabs *at, SplineFont *sf) {
 	putshort(mathf,0);		/* is extended shape */
 	putshort(mathf,0);		/* math kern info */
 
+	/* Each table's coverage goes after the last of them, unless */
+	/*  that's too far away */
 	if ( bits&mb_italic ) {
 	    v_start = ftell(mathf);
+	    ttf_math_dump_italic_top(mathf,at,sf,true);
+	    v_start = OTLObjectsFit(mathf,at->otlobjects,v_start,NULL);
 	    fseek(mathf,gi_start,SEEK_SET);
 	    putshort(mathf,v_start-gi_start);
-	    fseek(mathf,v_start,SEEK_SET);
-
-	    ttf_math_dump_italic_top(mathf,at,sf,true);
+	    fseek(mathf,0,SEEK_END);
 	}
 
 	if ( bits&mb_topaccent ) {
 	    v_start = ftell(mathf);
+	    ttf_math_dump_italic_top(mathf,at,sf,false);
+	    v_start = OTLObjectsFit(mathf,at->otlobjects,v_start,NULL);
 	    fseek(mathf,gi_start+2,SEEK_SET);
 	    putshort(mathf,v_start-gi_start);
-	    fseek(mathf,v_start,SEEK_SET);
-
-	    ttf_math_dump_italic_top(mathf,at,sf,false);
+	    fseek(mathf,0,SEEK_END);
 	}
 
-	if ( bits&mb_extended ) {
-	    v_start = ftell(mathf);
-	    fseek(mathf,gi_start+4,SEEK_SET);
-	    putshort(mathf,v_start-gi_start);
-	    fseek(mathf,v_start,SEEK_SET);
-
-	    ttf_math_dump_extended(mathf,at,sf);
-	}
+	if ( bits&mb_extended )
+	    ttf_math_dump_extended(mathf,at,sf,gi_start);
 
 	if ( bits&mb_mathkern ) {
 	    v_start = ftell(mathf);
+	    ttf_math_dump_mathkern(mathf,at,sf);
+	    v_start = OTLObjectsFit(mathf,at->otlobjects,v_start,NULL);
 	    fseek(mathf,gi_start+6,SEEK_SET);
 	    putshort(mathf,v_start-gi_start);
-	    fseek(mathf,v_start,SEEK_SET);
-
-	    ttf_math_dump_mathkern(mathf,at,sf);
+	    fseek(mathf,0,SEEK_END);
 	}
+	OTLObjectsFlush(mathf,at->otlobjects);
     }
 
     /* The spec does not say this can be NULL */
@@ -4409,7 +4952,10 @@ void otf_dump_math(struct alltabs *at, SplineFont *sf) {
 	fseek(mathf,v_start,SEEK_SET);
 
 	ttf_math_dump_glyphvariant(mathf,at,sf);
+	OTLObjectsFlush(mathf,at->otlobjects);
     }
+    OTLObjectsFree(at->otlobjects);
+    at->otlobjects = NULL;
 
     at->mathlen = ftell(mathf);
     if ( ftell(mathf)&1 )
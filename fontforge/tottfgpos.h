@@ -30,6 +30,7 @@ extern void SFBaseSort(SplineFont *sf);
 /* Used by both otf and apple */
 extern int LigCaretCnt(SplineChar *sc);
 extern uint16_t *ClassesFromNames(SplineFont *sf, char **classnames, int class_cnt, int numGlyphs, SplineChar ***glyphs, int apple_kc);
+extern uint16_t *KernClassClasses(SplineFont *sf, KernClass *kc, int isfirst, int numGlyphs, SplineChar ***glyphs, int apple_kc);
 extern SplineChar **SFGlyphsFromNames(SplineFont *sf, char *names);
 
 /* The MATH table */
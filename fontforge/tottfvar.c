@@ -32,6 +32,8 @@
 #include "fontforge.h"
 #include "gfile.h"
 #include "mem.h"
+#include "mm.h"
+#include "parallel.h"
 #include "splinesaveafm.h"
 #include "tottf.h"
 #include "ttf.h"
@@ -65,7 +67,7 @@ static int AssignPtNumbers(MMSet *mm,int gid) {
     ss = malloc((mm->instance_count+1)*sizeof(SplineSet *));
     sp = malloc((mm->instance_count+1)*sizeof(SplinePoint *));
     for ( i=0; i<mm->instance_count; ++i )
-	ss[i] = mm->instances[i]->glyphs[gid]->layers[ly_fore].splines;
+	ss[i] = MMInstanceGlyph(mm,i,gid)->layers[ly_fore].splines;
     ss[i] = mm->normal->glyphs[gid]->layers[ly_fore].splines;
 
     if ( ss[0]==NULL ) {
@@ -264,7 +266,7 @@ return( false );
 	for ( i=0; i<mm->instance_count; ++i ) {
 	    if ( gid>=mm->instances[i]->glyphcnt )
 return( false );
-	    if ( SCWorthOutputting(mm->instances[i]->glyphs[gid]))
+	    if ( SCWorthOutputting(MMInstanceGlyph(mm,i,gid)))
 return( false );
 	}
 return( true );		/* None is not worth outputting, and that's ok, they match */
@@ -272,7 +274,7 @@ return( true );		/* None is not worth outputting, and that's ok, they match */
 	for ( i=0; i<mm->instance_count; ++i ) {
 	    if ( gid>=mm->instances[i]->glyphcnt )
 return( false );
-	    if ( !SCWorthOutputting(mm->instances[i]->glyphs[gid]))
+	    if ( !SCWorthOutputting(MMInstanceGlyph(mm,i,gid)))
 return( false );
 	}
 	    /* All are worth outputting */
@@ -331,16 +333,29 @@ static int SCPointCount(SplineChar *sc) {
 return( ptcnt );
 }
 
+static int GlyphStillDeltas(MMSet *mm, int gid) {
+    /* Can we take this glyph's deltas from the ones we read in? Our own */
+    /*  point numbering must agree with what the font had */
+    if ( !MMGlyphStillDeltas(mm,gid) )
+return( false );
+    if ( !SCWorthOutputting(mm->normal->glyphs[gid]))
+return( true );
+    SCPointCount(mm->normal->glyphs[gid]);
+return( MMGlyphStillDeltas(mm,gid) );
+}
+
 int16_t **SCFindDeltas(MMSet *mm, int gid, int *_ptcnt) {
     /* When figuring out the deltas the first thing we must do is figure */
     /*  out each point's number */
-    int i, j, k, l, cnt, ptcnt;
+    int i, j, k, l, cnt, ptcnt, still;
     int16_t **deltas;
     SplineSet *ss1, *ss2;
     SplinePoint *sp1, *sp2;
     RefChar *r1, *r2;
+    SplineChar *isc;
 
-    if ( !ContourPtNumMatch(mm,gid))
+    still = GlyphStillDeltas(mm,gid);
+    if ( !still && !ContourPtNumMatch(mm,gid))
 return( NULL );
     if ( !SCWorthOutputting(mm->normal->glyphs[gid]))
 return( NULL );
@@ -350,8 +365,14 @@ return( NULL );
     for ( i=0; i<2*mm->instance_count; ++i )
 	deltas[i] = calloc(ptcnt,sizeof(int16_t));
     for ( i=0; i<mm->instance_count; ++i ) {
+	if ( still ) {
+	    /* No instance glyph has been made, the default is unchanged */
+	    MMInstanceDeltas(mm,i,gid,deltas[2*i],deltas[2*i+1]);
+    continue;
+	}
+	isc = MMInstanceGlyph(mm,i,gid);
 	for ( ss1=mm->normal->glyphs[gid]->layers[ly_fore].splines,
-		  ss2=mm->instances[i]->glyphs[gid]->layers[ly_fore].splines;
+		  ss2=isc->layers[ly_fore].splines;
 		ss1!=NULL && ss2!=NULL ;
 		ss1 = ss1->next, ss2=ss2->next ) {
 	    for ( sp1=ss1->first, sp2=ss2->first; ; ) {
@@ -372,7 +393,7 @@ return( NULL );
 	}
 	for ( cnt=0,
 		r1=mm->normal->glyphs[gid]->layers[ly_fore].refs,
-		r2=mm->instances[i]->glyphs[gid]->layers[ly_fore].refs;
+		r2=isc->layers[ly_fore].refs;
 		r1!=NULL && r2!=NULL;
 		r1=r1->next, r2=r2->next, ++cnt ) {
 	    deltas[2*i][cnt] = r2->transform[4]-r1->transform[4];
@@ -380,11 +401,11 @@ return( NULL );
 	}
 	/* Phantom points */
 	deltas[2*i][ptcnt-4] = 0; deltas[2*i+1][ptcnt-4] = 0;	/* lbearing */
-	deltas[2*i][ptcnt-3] = mm->instances[i]->glyphs[gid]->width -mm->normal->glyphs[gid]->width;
+	deltas[2*i][ptcnt-3] = isc->width -mm->normal->glyphs[gid]->width;
 		deltas[2*i+1][ptcnt-3] = 0;			/* horizontal advance */
 	deltas[2*i][ptcnt-2] = 0; deltas[2*i+1][ptcnt-2] = 0;	/* top bearing */
 	deltas[2*i][ptcnt-1] = 0;				/* vertical advance */
-		deltas[2*i+1][ptcnt-1] = mm->instances[i]->glyphs[gid]->vwidth -mm->normal->glyphs[gid]->vwidth;	/* horizontal advance */
+		deltas[2*i+1][ptcnt-1] = isc->vwidth -mm->normal->glyphs[gid]->vwidth;	/* horizontal advance */
     }
 
     /* Ok, each delta now contains the difference between the instance[i] points */
@@ -415,16 +436,16 @@ return( NULL );
 
     /* If all variants of the glyph are the same, no point in having a gvar */
     /*  entry for it */
-    for ( i=0 ; i<mm->instance_count; ++i ) {
+    for ( i=0 ; i<2*mm->instance_count; ++i ) {
 	for ( j=0; j<ptcnt; ++j )
 	    if ( deltas[i][j]!=0 )
 	break;
 	if ( j!=ptcnt )
     break;
     }
-    if ( i==mm->instance_count ) {
+    if ( i==2*mm->instance_count ) {
 	/* All zeros */
-	for ( i=0 ; i<mm->instance_count; ++i )
+	for ( i=0 ; i<2*mm->instance_count; ++i )
 	    free(deltas[i]);
 	free(deltas);
 return( NULL );
@@ -505,13 +526,94 @@ return( NULL );
 return( deltas );
 }
 
+/* Variation data is built up in memory (so several glyphs can be worked */
+/*  on at once) and copied into the table afterwards */
+struct varbuf {
+    uint8_t *data;
+    int len, max;
+};
+
+static void vb_byte(struct varbuf *vb, int val) {
+    if ( vb->len>=vb->max ) {
+	vb->max = 2*vb->max+256;
+	vb->data = realloc(vb->data,vb->max);
+    }
+    vb->data[vb->len++] = val;
+}
+
+static void vb_short(struct varbuf *vb, int val) {
+    vb_byte(vb,(val>>8)&0xff);
+    vb_byte(vb,val&0xff);
+}
+
+/* Packed point numbers: a count, then runs of (byte or word) differences */
+/*  from the previous point number. A count of 0 means all points */
+static void vb_points(struct varbuf *vb, uint16_t *pts, int cnt, int ptcnt) {
+    int j, rj, big, last;
+
+    if ( cnt==ptcnt ) {
+	vb_byte(vb,0);
+return;
+    }
+    if ( cnt>0x7f ) {
+	vb_byte(vb,0x80|(cnt>>8));
+	vb_byte(vb,cnt&0xff);
+    } else
+	vb_byte(vb,cnt);
+    for ( j=0, last=0; j<cnt; ) {
+	big = pts[j]-last>0xff;
+	for ( rj=j+1 ; rj<j+0x80 && rj<cnt; ++rj ) {
+	    if ( (pts[rj]-pts[rj-1]>0xff)!=big )
+	break;
+	}
+	vb_byte(vb,(rj-j-1)|(big ? 0x80 : 0));
+	for ( ; j<rj; ++j ) {
+	    if ( big )
+		vb_short(vb,pts[j]-last);
+	    else
+		vb_byte(vb,pts[j]-last);
+	    last = pts[j];
+	}
+    }
+}
+
+/* Packed deltas: runs of zeros, of values which fit in a byte and of words */
+static void vb_deltas(struct varbuf *vb, int16_t *deltas, int cnt) {
+    int j, rj;
+
+#define ISBYTE(v)	((v)>=-128 && (v)<=127)
+    for ( j=0; j<cnt; j=rj ) {
+	if ( deltas[j]==0 ) {
+	    for ( rj=j+1; rj<cnt && rj<j+0x40 && deltas[rj]==0; ++rj );
+	    vb_byte(vb,(rj-j-1)|0x80);
+	} else if ( ISBYTE(deltas[j]) ) {
+	    /* Stop for a pair of zeros, a single one is cheaper left in */
+	    for ( rj=j+1; rj<cnt && rj<j+0x40 && ISBYTE(deltas[rj]) &&
+		    !(deltas[rj]==0 && (rj+1==cnt || deltas[rj+1]==0)); ++rj );
+	    vb_byte(vb,rj-j-1);
+	    for ( ; j<rj; ++j )
+		vb_byte(vb,deltas[j]&0xff);
+	} else {
+	    /* Stop for a zero or a pair of bytes */
+	    for ( rj=j+1; rj<cnt && rj<j+0x40 && deltas[rj]!=0 &&
+		    !(ISBYTE(deltas[rj]) && rj+1<cnt && ISBYTE(deltas[rj+1])); ++rj );
+	    vb_byte(vb,(rj-j-1)|0x40);
+	    for ( ; j<rj; ++j )
+		vb_short(vb,deltas[j]);
+	}
+    }
+#undef ISBYTE
+}
+
 static void ttf_dumpcvar(struct alltabs *at, MMSet *mm) {
     int16_t **deltas;
     int ptcnt, cnt, pcnt;
-    int i,j,rj,big;
+    int i,j;
     int tuple_size;
     uint32_t start, end;
     uint16_t *pts;
+    int16_t *vals;
+    struct varbuf vb;
 
     deltas = CvtFindDeltas(mm,&ptcnt);
     if ( deltas == NULL ) return;
@@ -524,6 +626,7 @@ return;
     }
 
     tuple_size = 4+2*mm->axis_count;
+    memset(&vb,0,sizeof(vb));
     at->cvar = GFileTmpfile();
     putlong( at->cvar, 0x00010000 );	/* Format */
     putshort( at->cvar, cnt );		/* Number of instances with cvt tables (tuple count of interesting tuples) */
@@ -548,37 +651,15 @@ return;
 	    if ( deltas[i][j]!=0 )
 		pts[pcnt++]=j;
 
-	if ( pcnt>0x7f ) {
-	    putc(0x80|(pcnt>>8), at->cvar );
-	    putc(pcnt&0xff, at->cvar);
-	} else
-	    putc(pcnt, at->cvar);
-	for ( j=0; j<pcnt; ) {
-	    big = pts[j]>=0x80 ? 0x80 : 0;
-	    for ( rj=j+1 ; rj<j+0x80 && rj<pcnt && !big; ++rj )
-		if ( pts[rj]-pts[rj-1]>=0x80 )
-		    big = 0x80;
-	    
-	    putc((rj-j-1)|big,at->cvar);
-	    if ( big ) {
-		putshort(at->cvar,pts[j]);
-		for ( ++j; j<rj; ++j )
-		    putshort(at->cvar,pts[j]-pts[j-1]);
-	    } else {
-		putc(pts[j],at->cvar);
-		for ( ++j; j<rj; ++j )
-		    putc(pts[j]-pts[j-1],at->cvar);
-	    }
-	}
+	vb.len = 0;
+	vb_points(&vb,pts,pcnt,ptcnt);
 	/* Now output the corresponding deltas for those points */
-	for ( j=0; j<pcnt; ) {
-		for ( rj=j+1; rj<j+0x40 && rj<pcnt; ++rj ) {
-		    ;
-		}
-		putc( (rj-j-1)|0x40,at->cvar );
-		for ( ; j<rj ; ++j )
-		    putshort( at->cvar, deltas[i][pts[j]] );
-	}
+	vals = malloc(pcnt*sizeof(int16_t));
+	for ( j=0; j<pcnt; ++j )
+	    vals[j] = deltas[i][pts[j]];
+	vb_deltas(&vb,vals,pcnt);
+	fwrite(vb.data,1,vb.len,at->cvar);
+	free(vals);
 	free(pts);
 	end = ftell(at->cvar);
 	fseek(at->cvar, 8+cnt*tuple_size, SEEK_SET);
@@ -590,6 +671,7 @@ return;
     for ( i=0; i<mm->instance_count; ++i )
 	free( deltas[i] );
     free(deltas);
+    free(vb.data);
 
     at->cvarlen = ftell(at->cvar);
     if ( at->cvarlen&1 )
@@ -598,30 +680,341 @@ return;
 	putshort(at->cvar,0);
 }
 
-static void dumpdeltas(struct alltabs *at,int16_t *deltas,int ptcnt) {
-    int j,rj;
+/* gvar data for one glyph, and a hash of everything it was built from. */
+/*  Kept in the MMSet so the next output can reuse the data for glyphs */
+/*  which haven't changed */
+struct gvar_glyph {
+    uint64_t hash;
+    uint8_t *data;
+    int len;
+    unsigned int valid: 1;
+};
+
+struct gvar_cache {
+    int gcnt;
+    struct gvar_glyph *glyphs;	/* Indexed by gid */
+};
+
+void GvarCacheFree(struct gvar_cache *cache) {
+    int i;
+
+    if ( cache==NULL )
+return;
+    for ( i=0; i<cache->gcnt; ++i )
+	free(cache->glyphs[i].data);
+    free(cache->glyphs);
+    free(cache);
+}
+
+static uint64_t hash_int(uint64_t hash, int val) {
+    int i;
 
-    for ( j=0; j<ptcnt; ) {
-	for ( rj=j; rj<ptcnt && rj<j+0x40 && deltas[rj]==0; ++rj );
-	if ( rj!=j ) {
-	    putc((rj-j-1)|0x80,at->gvar);
-	    j = rj;
+    /* FNV-1a */
+    for ( i=0; i<4; ++i ) {
+	hash ^= (val>>(8*i))&0xff;
+	hash *= 0x100000001b3ULL;
+    }
+return( hash );
+}
+
+static uint64_t GvarGlyphHash(MMSet *mm, int gid, int still) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    SplineChar *sc;
+    SplineSet *ss;
+    SplinePoint *sp;
+    RefChar *r;
+    int i, k, pcnt;
+    int16_t *dx;
+
+    hash = hash_int(hash,mm->instance_count);
+    hash = hash_int(hash,mm->axis_count);
+    for ( i=0; i<mm->instance_count*mm->axis_count; ++i )
+	hash = hash_int(hash,rint(16384*mm->positions[i]));
+    for ( i=-1; i<mm->instance_count; ++i ) {
+	if ( i!=-1 && still ) {
+	    /* No instance glyph, its deltas will do */
+	    pcnt = mm->deltas->pcnt[gid]+4;
+	    dx = malloc(2*pcnt*sizeof(int16_t));
+	    MMInstanceDeltas(mm,i,gid,dx,dx+pcnt);
+	    for ( k=0; k<2*pcnt; ++k )
+		hash = hash_int(hash,dx[k]);
+	    free(dx);
+	    hash = hash_int(hash,-3);
     continue;
 	}
-	    for ( rj=j+1; rj<j+0x40 && rj<ptcnt; ++rj ) {
-		;
+	sc = i==-1 ? mm->normal->glyphs[gid] : mm->instances[i]->glyphs[gid];
+	hash = hash_int(hash,sc->width);
+	hash = hash_int(hash,sc->vwidth);
+	for ( ss=sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
+	    hash = hash_int(hash,-1);
+	    for ( sp=ss->first; ; ) {
+		hash = hash_int(hash,sp->ttfindex);
+		hash = hash_int(hash,sp->nextcpindex);
+		hash = hash_int(hash,rint(sp->me.x));
+		hash = hash_int(hash,rint(sp->me.y));
+		hash = hash_int(hash,rint(sp->nextcp.x));
+		hash = hash_int(hash,rint(sp->nextcp.y));
+		if ( sp->next==NULL )
+	    break;
+		sp = sp->next->to;
+		if ( sp==ss->first )
+	    break;
+	    }
+	}
+	for ( r=sc->layers[ly_fore].refs; r!=NULL; r=r->next ) {
+	    hash = hash_int(hash,(int16_t) r->transform[4]);
+	    hash = hash_int(hash,(int16_t) r->transform[5]);
+	}
+	hash = hash_int(hash,-2);
+    }
+return( hash );
+}
+
+/* Interpolate Untouched Points: a point left out of a tuple's point list */
+/*  gets its delta inferred from the nearest listed points before and after */
+/*  it in its contour, the same way for x and for y. Leaving out any point */
+/*  whose delta is inferred exactly shrinks the table. The inferred delta is */
+/*  rounded just as IUPDelta in parsettfvar.c rounds it when reading (an */
+/*  interpolation landing on a half unit goes to the even neighbour), so */
+/*  anything we leave out reads back as the delta we had */
+static int IUPInfer(int c, int c1, int d1, int c2, int d2) {
+    if ( c1==c2 )
+return( d1==d2 ? d1 : 0 );
+    if ( c1>c2 ) {
+	int t = c1; c1 = c2; c2 = t;
+	t = d1; d1 = d2; d2 = t;
+    }
+    if ( c<=c1 )
+return( d1 );
+    else if ( c>=c2 )
+return( d2 );
+return( rint(d1 + (c-c1)*(double) (d2-d1)/(c2-c1)) );
+}
+
+/* Are the points strictly between a and b (going forward round the */
+/*  contour [start,end]) inferred exactly from a and b? */
+static int IUPGapOk(int *xs, int *ys, int16_t *dx, int16_t *dy,
+	int start, int end, int a, int b) {
+    int p;
+
+    for ( p = a==end ? start : a+1; p!=b; p = p==end ? start : p+1 ) {
+	if ( IUPInfer(xs[p],xs[a],dx[a],xs[b],dx[b])!=dx[p] ||
+		IUPInfer(ys[p],ys[a],dy[a],ys[b],dy[b])!=dy[p] )
+return( false );
+    }
+return( true );
+}
+
+static void IUPContour(int *xs, int *ys, int16_t *dx, int16_t *dy,
+	int start, int end, uint8_t *keep) {
+    int p, a, b, kcnt, allsame = true, allzero = true;
+
+    for ( p=start; p<=end; ++p ) {
+	if ( dx[p]!=0 || dy[p]!=0 )
+	    allzero = false;
+	if ( dx[p]!=dx[start] || dy[p]!=dy[start] )
+	    allsame = false;
+    }
+    if ( allzero )
+return;				/* An untouched contour doesn't move */
+    if ( allsame ) {
+	keep[start] = true;	/* Nor does one touched point, it shifts the rest */
+return;
+    }
+
+    for ( p=start; p<=end; ++p )
+	keep[p] = true;
+    kcnt = end-start+1;
+    for ( p=start; p<=end && kcnt>2; ++p ) {
+	for ( a = p==start ? end : p-1; !keep[a]; a = a==start ? end : a-1 );
+	for ( b = p==end ? start : p+1; !keep[b]; b = b==end ? start : b+1 );
+	keep[p] = false;
+	if ( IUPGapOk(xs,ys,dx,dy,start,end,a,b) )
+	    --kcnt;
+	else
+	    keep[p] = true;
+    }
+}
+
+struct gvar_tuple {
+    int instance;
+    int pcnt;
+    uint16_t *pts;
+};
+
+static void GvarGlyphBuild(MMSet *mm, int gid, struct gvar_glyph *gg) {
+    int16_t **deltas, *vals;
+    int ptcnt, i, j, k, tcnt, shared, start, end;
+    int *xs, *ys;
+    uint8_t *keep;
+    struct gvar_tuple *tuples;
+    struct varbuf vb;
+    SplineChar *sc = mm->normal->glyphs[gid];
+    SplineSet *ss;
+    SplinePoint *sp;
+
+    deltas = SCFindDeltas(mm,gid,&ptcnt);
+    if ( deltas==NULL )
+return;
+
+    /* Point positions in the default outline, for IUP */
+    xs = calloc(ptcnt,sizeof(int));
+    ys = calloc(ptcnt,sizeof(int));
+    for ( ss=sc->layers[ly_fore].splines; ss!=NULL; ss=ss->next ) {
+	for ( sp=ss->first; ; ) {
+	    if ( sp->ttfindex!=0xffff && sp->ttfindex<ptcnt ) {
+		xs[sp->ttfindex] = rint(sp->me.x);
+		ys[sp->ttfindex] = rint(sp->me.y);
+	    }
+	    if ( sp->nextcpindex!=0xffff && sp->nextcpindex<ptcnt ) {
+		xs[sp->nextcpindex] = rint(sp->nextcp.x);
+		ys[sp->nextcpindex] = rint(sp->nextcp.y);
+	    }
+	    if ( sp->next==NULL )
+	break;
+	    sp = sp->next->to;
+	    if ( sp==ss->first )
+	break;
+	}
+    }
+
+    keep = malloc(ptcnt);
+    vals = malloc(ptcnt*sizeof(int16_t));
+    tuples = calloc(mm->instance_count,sizeof(struct gvar_tuple));
+    for ( i=tcnt=0; i<mm->instance_count; ++i ) {
+	int16_t *dx = deltas[2*i], *dy = deltas[2*i+1];
+	memset(keep,0,ptcnt);
+	/* Components and phantom points aren't interpolated, an unlisted */
+	/*  one doesn't move */
+	for ( j=0; j<ptcnt; ++j )
+	    keep[j] = dx[j]!=0 || dy[j]!=0;
+	if ( sc->layers[ly_fore].splines!=NULL ) {
+	    for ( ss=sc->layers[ly_fore].splines, start=0; ss!=NULL; ss=ss->next ) {
+		end = start-1;
+		for ( sp=ss->first; ; ) {
+		    if ( sp->ttfindex!=0xffff && sp->ttfindex>end )
+			end = sp->ttfindex;
+		    if ( sp->nextcpindex!=0xffff && sp->nextcpindex>end )
+			end = sp->nextcpindex;
+		    if ( sp->next==NULL )
+		break;
+		    sp = sp->next->to;
+		    if ( sp==ss->first )
+		break;
+		}
+		if ( end>=ptcnt-4 )
+	    break;			/* Shouldn't happen */
+		if ( end>=start ) {
+		    memset(keep+start,0,end-start+1);
+		    IUPContour(xs,ys,dx,dy,start,end,keep);
+		}
+		start = end+1;
 	    }
-	    putc( (rj-j-1)|0x40,at->gvar );
-	    for ( ; j<rj ; ++j )
-		putshort( at->gvar, deltas[j] );
+	}
+	for ( j=k=0; j<ptcnt; ++j )
+	    if ( keep[j] )
+		++k;
+	if ( k==0 )
+    continue;			/* This instance doesn't change the glyph */
+	tuples[tcnt].instance = i;
+	tuples[tcnt].pcnt = k;
+	tuples[tcnt].pts = malloc(k*sizeof(uint16_t));
+	for ( j=k=0; j<ptcnt; ++j )
+	    if ( keep[j] )
+		tuples[tcnt].pts[k++] = j;
+	++tcnt;
+    }
+
+    shared = tcnt>1;
+    for ( i=1; i<tcnt && shared; ++i )
+	if ( tuples[i].pcnt!=tuples[0].pcnt ||
+		memcmp(tuples[i].pts,tuples[0].pts,tuples[0].pcnt*sizeof(uint16_t))!=0 )
+	    shared = false;
+
+    memset(&vb,0,sizeof(vb));
+    if ( tcnt!=0 ) {
+	vb_short(&vb,tcnt|(shared ? 0x8000 : 0));
+	vb_short(&vb,4+4*tcnt);			/* offset to data */
+	for ( i=0; i<tcnt; ++i ) {
+	    vb_short(&vb,0);			/* tuple data size, fix later */
+	    vb_short(&vb,(shared ? 0 : 0x2000)|tuples[i].instance);
+	}
+	if ( shared )
+	    vb_points(&vb,tuples[0].pts,tuples[0].pcnt,ptcnt);
+	for ( i=0; i<tcnt; ++i ) {
+	    start = vb.len;
+	    if ( !shared )
+		vb_points(&vb,tuples[i].pts,tuples[i].pcnt,ptcnt);
+	    for ( k=0; k<2; ++k ) {
+		for ( j=0; j<tuples[i].pcnt; ++j )
+		    vals[j] = deltas[2*tuples[i].instance+k][tuples[i].pts[j]];
+		vb_deltas(&vb,vals,tuples[i].pcnt);
+	    }
+	    vb.data[4+4*i] = (vb.len-start)>>8;
+	    vb.data[4+4*i+1] = (vb.len-start)&0xff;
+	}
+    }
+    gg->data = vb.data;
+    gg->len = vb.len;
+
+    for ( i=0; i<tcnt; ++i )
+	free(tuples[i].pts);
+    free(tuples);
+    free(vals);
+    free(keep);
+    free(xs); free(ys);
+    for ( i=0; i<2*mm->instance_count; ++i )
+	free(deltas[i]);
+    free(deltas);
+}
+
+struct gvar_work {
+    MMSet *mm;
+    int *bygid;
+    struct gvar_glyph *glyphs;	/* By output glyph index */
+};
+
+static void GvarGlyphs(void *data, int start, int end) {
+    struct gvar_work *gw = data;
+    struct gvar_cache *cache = gw->mm->gvar_cache;
+    struct gvar_glyph *gg, *cached;
+    int i, gid, still;
+
+    for ( i=start; i<end; ++i ) if ( (gid=gw->bygid[i])!=-1 ) {
+	gg = &gw->glyphs[i];
+	still = MMGlyphStillDeltas(gw->mm,gid);
+	if ( (!still && !ContourPtNumMatch(gw->mm,gid)) ||
+		!SCWorthOutputting(gw->mm->normal->glyphs[gid]))
+    continue;
+	gg->hash = GvarGlyphHash(gw->mm,gid,still);
+	gg->valid = true;
+	cached = cache!=NULL && gid<cache->gcnt ? &cache->glyphs[gid] : NULL;
+	if ( cached!=NULL && cached->valid && cached->hash==gg->hash ) {
+	    gg->len = cached->len;
+	    gg->data = cached->len==0 ? NULL : malloc(cached->len);
+	    if ( gg->data!=NULL )
+		memcpy(gg->data,cached->data,cached->len);
+	} else
+	    GvarGlyphBuild(gw->mm,gid,gg);
     }
 }
 
 static void ttf_dumpgvar(struct alltabs *at, MMSet *mm) {
-    int i,j, last;
-    uint32_t gcoordoff, glyphoffs, start, here, tupledataend, tupledatastart;
-    int16_t **deltas;
-    int ptcnt;
+    int i,j, gid;
+    uint32_t gcoordoff, here;
+    struct gvar_work gw;
+    struct gvar_cache *cache;
+
+    /* Work out each glyph's data, in parallel and reusing what we can from */
+    /*  last time */
+    gw.mm = mm;
+    gw.bygid = at->gi.bygid;
+    gw.glyphs = calloc(at->gi.gcnt,sizeof(struct gvar_glyph));
+    /* Any instance glyphs we are going to need must be made up front, */
+    /*  the workers may only look at them */
+    for ( i=0; i<at->gi.gcnt; ++i ) if ( (gid=gw.bygid[i])!=-1 )
+	GlyphStillDeltas(mm,gid);
+    ParallelFor(at->gi.gcnt,GvarGlyphs,&gw);
 
     at->gvar = GFileTmpfile();
     putlong( at->gvar, 0x00010000 );	/* Format */
@@ -632,44 +1025,16 @@ static void ttf_dumpgvar(struct alltabs *at, MMSet *mm) {
     putshort( at->gvar,at->maxp.numGlyphs );
     putshort( at->gvar, 1 );		/* always output 32bit offsets */
     putlong( at->gvar, ftell(at->gvar)+4 + (at->maxp.numGlyphs+1)*4);
-    glyphoffs = ftell(at->gvar);
-    for ( i=0; i<=at->maxp.numGlyphs; ++i )
-	putlong( at->gvar,0 );
-
-    start = ftell( at->gvar );
-    last = -1;
-    for ( i=0; i<at->gi.gcnt; ++i ) if ( at->gi.bygid[i]!=-1 ) {
-	deltas = SCFindDeltas(mm,at->gi.bygid[i],&ptcnt);
-	if ( deltas==NULL )
-    continue;
-	here = ftell(at->gvar);
-	fseek(at->gvar,glyphoffs+(last+1)*4,SEEK_SET);
-	for ( ; last< i; ++last )
-	    putlong(at->gvar,here-start);
-	fseek(at->gvar,here,SEEK_SET);
-	putshort(at->gvar,mm->instance_count);
-	putshort(at->gvar,4+4*mm->instance_count);	/* offset to data */
-	for ( j=0; j<mm->instance_count; ++j ) {
-	    putshort(at->gvar,0);			/* tuple data size, fix later */
-	    putshort(at->gvar,0x2000|j);		/* private points, tuple i */
-	}
-	for ( j=0; j<mm->instance_count; ++j ) {
-	    tupledatastart = ftell(at->gvar);
-	    putc('\0',at->gvar);			/* Point list, all points */
-	    dumpdeltas(at,deltas[2*j],ptcnt);
-	    dumpdeltas(at,deltas[2*j+1],ptcnt);
-	    tupledataend = ftell(at->gvar);
-	    fseek(at->gvar,here+4+4*j,SEEK_SET);
-	    putshort( at->gvar,tupledataend-tupledatastart);
-	    fseek(at->gvar,tupledataend,SEEK_SET);
-	    free(deltas[2*j]); free(deltas[2*j+1]);
-	}
-	free(deltas);
+    here = 0;
+    for ( i=0; i<=at->maxp.numGlyphs; ++i ) {
+	putlong( at->gvar,here );
+	if ( i<at->gi.gcnt && i<at->maxp.numGlyphs )
+	    here += gw.glyphs[i].len;
     }
+    for ( i=0; i<at->gi.gcnt && i<at->maxp.numGlyphs; ++i )
+	if ( gw.glyphs[i].len!=0 )
+	    fwrite(gw.glyphs[i].data,1,gw.glyphs[i].len,at->gvar);
     here = ftell(at->gvar);
-    fseek(at->gvar,glyphoffs+(last+1)*4,SEEK_SET);
-    for ( ; last< at->maxp.numGlyphs; ++last )
-	putlong(at->gvar,here-start);
     fseek(at->gvar,gcoordoff,SEEK_SET);
     putlong(at->gvar,here);
     fseek(at->gvar,here,SEEK_SET);
@@ -678,6 +1043,23 @@ static void ttf_dumpgvar(struct alltabs *at, MMSet *mm) {
 	    putshort(at->gvar,rint(16384*mm->positions[j*mm->axis_count+i]));
     }
 
+    /* Replace the cache with what we just output */
+    cache = calloc(1,sizeof(struct gvar_cache));
+    cache->gcnt = mm->normal->glyphcnt;
+    cache->glyphs = calloc(cache->gcnt,sizeof(struct gvar_glyph));
+    for ( i=0; i<at->gi.gcnt; ++i ) {
+	gid = at->gi.bygid[i];
+	if ( gid!=-1 && gid<cache->gcnt && gw.glyphs[i].valid &&
+		!cache->glyphs[gid].valid ) {
+	    cache->glyphs[gid] = gw.glyphs[i];
+	    gw.glyphs[i].data = NULL;
+	}
+	free(gw.glyphs[i].data);
+    }
+    free(gw.glyphs);
+    GvarCacheFree(mm->gvar_cache);
+    mm->gvar_cache = cache;
+
     at->gvarlen = ftell(at->gvar);
     if ( at->gvarlen&1 )
 	putc('\0',at->gvar );
@@ -12,6 +12,7 @@ extern int ContourPtNumMatch(MMSet *mm, int gid);
 extern int16_t **SCFindDeltas(MMSet *mm, int gid, int *_ptcnt);
 extern int16_t **CvtFindDeltas(MMSet *mm, int *_ptcnt);
 extern void ttf_dumpvariations(struct alltabs *at, SplineFont *sf);
+extern void GvarCacheFree(struct gvar_cache *cache);
 
 #ifdef __cplusplus
 }
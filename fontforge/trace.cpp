@@ -0,0 +1,214 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define TRACE_HEAP 1
+#endif
+
+std::atomic<int> trace_enabled{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    char phase;  // 'B'egin, 'E'nd or 'C'ounter
+    int tid;
+    double ts;  // microseconds since the trace started
+    int64_t value;
+};
+
+std::mutex trace_mutex;
+std::vector<TraceEvent> events;
+std::map<std::string, int64_t> totals;
+std::string trace_file;
+std::chrono::steady_clock::time_point trace_start;
+int generation = 0;
+int next_tid = 0;
+
+// Spans still open on this thread in the current trace. Ends without a
+// begin (tracing was started inside a span) are dropped.
+thread_local int tid = -1;
+thread_local int depth = 0;
+thread_local int depth_generation = -1;
+
+double now() {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - trace_start)
+        .count();
+}
+
+// Both need trace_mutex held
+int thread_id() {
+    if (tid < 0) {
+        tid = next_tid++;
+    }
+    if (depth_generation != generation) {
+        depth_generation = generation;
+        depth = 0;
+    }
+    return tid;
+}
+
+void write_name(FILE* out, const char* name) {
+    putc('"', out);
+    for (const char* pt = name; *pt; ++pt) {
+        if (*pt == '"' || *pt == '\\') {
+            putc('\\', out);
+        }
+        if ((unsigned char)*pt >= ' ') {
+            putc(*pt, out);
+        }
+    }
+    putc('"', out);
+}
+
+bool write_trace() {
+    FILE* out = fopen(trace_file.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+                 "\"args\":{\"name\":\"fontforge\"}}");
+    for (const TraceEvent& ev : events) {
+        fprintf(out, ",\n{\"name\":");
+        write_name(out, ev.name);
+        fprintf(out, ",\"cat\":\"fontforge\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,"
+                     "\"ts\":%.3f",
+                ev.phase, ev.tid, ev.ts);
+        if (ev.phase == 'C') {
+            fprintf(out, ",\"args\":{\"value\":%lld}", (long long)ev.value);
+        }
+        putc('}', out);
+    }
+    fprintf(out, "\n]}\n");
+    return fclose(out) == 0;
+}
+
+void trace_at_exit() {
+    TraceStop();
+}
+
+// FONTFORGE_TRACE starts tracing before anything else runs
+struct TraceFromEnvironment {
+    TraceFromEnvironment() {
+        const char* file = getenv("FONTFORGE_TRACE");
+        if (file != nullptr && *file != '\0') {
+            TraceStart(file);
+        }
+    }
+} trace_from_environment;
+
+}  // namespace
+
+extern "C" int TraceStart(const char* filename) {
+    static bool registered = false;
+
+    if (trace_enabled && !TraceStop()) {
+        return false;
+    }
+    // Find out now rather than after the work has been done
+    FILE* test = fopen(filename, "w");
+    if (test == nullptr) {
+        return false;
+    }
+    fclose(test);
+
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_file = filename;
+    events.clear();
+    totals.clear();
+    ++generation;
+    trace_start = std::chrono::steady_clock::now();
+    if (!registered) {
+        registered = true;
+        atexit(trace_at_exit);
+    }
+    trace_enabled = true;
+    return true;
+}
+
+extern "C" int TraceStop(void) {
+    if (!trace_enabled) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_enabled = false;
+    bool ok = write_trace();
+    events.clear();
+    events.shrink_to_fit();
+    totals.clear();
+    return ok;
+}
+
+extern "C" void TraceBegin(const char* name) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_enabled) {
+        return;
+    }
+    int id = thread_id();
+    ++depth;
+    events.push_back({name, 'B', id, now(), 0});
+}
+
+extern "C" void TraceEnd(const char* name) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_enabled) {
+        return;
+    }
+    int id = thread_id();
+    if (depth == 0) {
+        return;
+    }
+    --depth;
+    double ts = now();
+    events.push_back({name, 'E', id, ts, 0});
+#ifdef TRACE_HEAP
+    events.push_back({"heap in use", 'C', id, ts, (int64_t)mallinfo2().uordblks});
+#endif
+}
+
+extern "C" void TraceCount(const char* name, int64_t delta) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_enabled) {
+        return;
+    }
+    int64_t& total = totals[name];
+    total += delta;
+    events.push_back({name, 'C', thread_id(), now(), total});
+}
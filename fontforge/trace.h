@@ -0,0 +1,89 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FONTFORGE_TRACE_H
+#define FONTFORGE_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <atomic>
+#else
+#include <stdatomic.h>
+#endif
+
+/*
+ * Timing spans and counters, to see where the time goes when a font is
+ * generated.
+ *
+ * Tracing is started by setting FONTFORGE_TRACE to a file name before
+ * fontforge starts, or with TraceStart() (fontforge.traceStart() in
+ * python). When it is stopped, or when fontforge exits, everything
+ * recorded is written to the file in the Chrome trace event format, which
+ * chrome://tracing and https://ui.perfetto.dev can show.
+ *
+ * TRACE_BEGIN and TRACE_END mark a span and must pair up on the same
+ * thread, so spans nest. TRACE_COUNT adds to a named counter (glyphs
+ * processed, bytes written...) and records its new total; on glibc the
+ * heap in use is recorded at the end of each span. Names must be string
+ * constants, only the pointer is kept.
+ *
+ * While tracing is off each macro is a single relaxed load of
+ * trace_enabled, which TraceStart() and TraceStop() change under their lock;
+ * the functions check it again once they hold that lock. They are thread
+ * safe, and spans from ParallelFor() workers show up on threads of their
+ * own.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* std::atomic<int> and C11's atomic_int share their representation */
+#ifdef __cplusplus
+extern std::atomic<int> trace_enabled;
+#define TRACE_ENABLED()	trace_enabled.load(std::memory_order_relaxed)
+#else
+extern atomic_int trace_enabled;
+#define TRACE_ENABLED()	atomic_load_explicit(&trace_enabled, memory_order_relaxed)
+#endif
+
+extern int TraceStart(const char *filename);
+extern int TraceStop(void);
+extern void TraceBegin(const char *name);
+extern void TraceEnd(const char *name);
+extern void TraceCount(const char *name, int64_t delta);
+
+#define TRACE_BEGIN(name)	do { if ( TRACE_ENABLED() ) TraceBegin(name); } while ( 0 )
+#define TRACE_END(name)		do { if ( TRACE_ENABLED() ) TraceEnd(name); } while ( 0 )
+#define TRACE_COUNT(name,delta)	do { if ( TRACE_ENABLED() ) TraceCount(name,delta); } while ( 0 )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FONTFORGE_TRACE_H */
@@ -61,7 +61,8 @@ struct tinstance {
 
 struct tuples {
     real *coords;	/* Location along axes array[axis_count] */
-    SplineChar **chars;	/* Varied glyphs, array parallels one in info */
+    KernPair **kerns, **vkerns;	/* Varied kern pairs, by left glyph */
+				/*  (the right glyph is the default one) */
     struct ttf_table *cvt;
     KernClass *khead, *klast, *vkhead, *vklast; /* Varied kern classes */
 };
@@ -73,6 +74,7 @@ struct variations {
     struct tinstance *instances;
     int tuple_count;
     struct tuples *tuples;
+    struct mmdeltas *deltas;	/* What each tuple does to each glyph */
 };
 
 enum gsub_inusetype { git_normal, git_justinuse, git_findnames };
@@ -586,6 +588,7 @@ struct glyphinfo {
     int *bygid;			/* glyph list */
     int gcnt;
     int layer;
+    SplineSet **ttfss;		/* Quadratic outlines made ahead of time, by glyph id */
 };
 
 struct vorg {
@@ -740,6 +743,7 @@ struct alltabs {
     struct ttf_table *oldcvt;
     unsigned oldcvtlen;
     cpp_SubtableMap* subtable_map;
+    struct otlobjects *otlobjects;	/* Coverage & class tables waiting to be written */
 };
 
 struct subhead { uint16_t first, cnt, delta, rangeoff; };	/* a sub header in 8/16 cmap table */
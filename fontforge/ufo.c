@@ -32,11 +32,13 @@
 #include "autohint.h"
 #include "dumppfa.h"
 #include "featurefile.h"
+#include "ffdir.h"
 #include "fontforgevw.h"
 #include "fvfonts.h"
 #include "gfile.h"
 #include "glif_name_hash.h"
 #include "lookups.h"
+#include "parallel.h"
 #include "splinesave.h"
 #include "splinesaveafm.h"
 #include "splineutil.h"
@@ -318,23 +320,6 @@ static xmlNodePtr xmlNewChildPrintf(xmlNodePtr parent, xmlNsPtr ns, const xmlCha
   va_end(arguments);
   return output;
 }
-static void xmlSetPropVPrintf(xmlNodePtr target, const xmlChar * name, char * format, va_list arguments) {
-  char * valtmp = vsmprintf(format, arguments);
-  // Generate the value.
-  if (valtmp == NULL) {
-    return;
-  }
-  xmlSetProp(target, name, BAD_CAST valtmp); // Set the property.
-  free(valtmp); valtmp = NULL; // Free the temporary text store.
-  return;
-}
-static void xmlSetPropPrintf(xmlNodePtr target, const xmlChar * name, char * format, ...) {
-  va_list arguments;
-  va_start(arguments, format);
-  xmlSetPropVPrintf(target, name, format, arguments);
-  va_end(arguments);
-  return;
-}
 
 /* ************************************************************************** */
 /* ****************************    PList Output    ************************** */
@@ -789,7 +774,143 @@ xmlNodePtr PythonDictToXML(PyObject *dict, xmlNodePtr target, const char **exclu
 /* ****************************   GLIF Output    **************************** */
 /* ************************************************************************** */
 
-xmlNodePtr _GlifToXML(const SplineChar *sc, int layer, int version) {
+// Glif files are written straight into a buffer, laid out exactly as xmlSaveFormatFile
+// lays out the equivalent tree, so that they can be made for many glyphs at once.
+// Only the lib, which may need python, is still made as a tree (ahead of time).
+
+struct glifwriter {
+    GrowBuf gb;
+    int depth;			// Elements open, including one whose start tag is unfinished.
+    int open;			// The last start tag still lacks its '>'.
+};
+
+static void GlifOutWrite(struct glifwriter *gw, const char *str, size_t len) {
+    if ( gw->gb.base==NULL || gw->gb.pt+len>=gw->gb.end ) {
+	size_t off = gw->gb.pt-gw->gb.base, size = 2*(gw->gb.end-gw->gb.base)+len+256;
+	gw->gb.base = realloc(gw->gb.base,size);
+	gw->gb.pt = gw->gb.base+off;
+	gw->gb.end = gw->gb.base+size;
+    }
+    memcpy(gw->gb.pt,str,len);
+    gw->gb.pt += len;
+}
+
+static void GlifOutEscaped(struct glifwriter *gw, const char *str, int inattr) {
+    // The escapes libxml2 uses for attribute values and for text in a UTF-8 document.
+    const char *start, *esc;
+
+    for ( start=str; *str!='\0'; ++str ) {
+	switch ( *str ) {
+	  case '<': esc = "&lt;"; break;
+	  case '>': esc = "&gt;"; break;
+	  case '&': esc = "&amp;"; break;
+	  case '\r': esc = "&#13;"; break;
+	  case '"': esc = inattr ? "&quot;" : NULL; break;
+	  case '\n': esc = inattr ? "&#10;" : NULL; break;
+	  case '\t': esc = inattr ? "&#9;" : NULL; break;
+	  default: esc = NULL; break;
+	}
+	if ( esc!=NULL ) {
+	    GlifOutWrite(gw,start,str-start);
+	    GlifOutWrite(gw,esc,strlen(esc));
+	    start = str+1;
+	}
+    }
+    GlifOutWrite(gw,start,str-start);
+}
+
+static void GlifOutIndent(struct glifwriter *gw) {
+    int i;
+
+    if ( gw->open ) {
+	GlifOutWrite(gw,">\n",2);
+	gw->open = false;
+    }
+    for ( i=0; i<gw->depth; ++i )
+	GlifOutWrite(gw,"  ",2);
+}
+
+static void GlifOutStart(struct glifwriter *gw, const char *name) {
+    GlifOutIndent(gw);
+    GlifOutWrite(gw,"<",1);
+    GlifOutWrite(gw,name,strlen(name));
+    gw->open = true;
+    ++gw->depth;
+}
+
+static void GlifOutAttr(struct glifwriter *gw, const char *name, const char *format, ...) {
+    char buffer[100], *value = buffer;
+    va_list arguments;
+    int len;
+
+    va_start(arguments, format);
+    len = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    if ( len>=(int) sizeof(buffer) ) {
+	value = malloc(len+1);
+	va_start(arguments, format);
+	vsnprintf(value, len+1, format, arguments);
+	va_end(arguments);
+    }
+    GlifOutWrite(gw," ",1);
+    GlifOutWrite(gw,name,strlen(name));
+    GlifOutWrite(gw,"=\"",2);
+    GlifOutEscaped(gw,value,true);
+    GlifOutWrite(gw,"\"",1);
+    if ( value!=buffer )
+	free(value);
+}
+
+static void GlifOutEnd(struct glifwriter *gw, const char *name) {
+    --gw->depth;
+    if ( gw->open ) {
+	GlifOutWrite(gw,"/>\n",3);
+	gw->open = false;
+    } else {
+	GlifOutIndent(gw);
+	GlifOutWrite(gw,"</",2);
+	GlifOutWrite(gw,name,strlen(name));
+	GlifOutWrite(gw,">\n",2);
+    }
+}
+
+static void GlifOutPoint(struct glifwriter *gw, double x, double y) {
+    GlifOutStart(gw,"point");
+    GlifOutAttr(gw,"x","%g",x);
+    GlifOutAttr(gw,"y","%g",y);
+    GlifOutEnd(gw,"point");
+}
+
+static void GlifOutAnchorName(struct glifwriter *gw, const AnchorPoint *ap) {
+    int ismark = (ap->type==at_mark || ap->type==at_centry);
+    GlifOutAttr(gw,"name","%s%s",ismark ? "_" : "",ap->anchor->name);
+}
+
+static char *GlifLibToString(const SplineChar *sc, int layer) {
+    // The <lib> element as it appears (one level in) in the glif file, or NULL if there is none.
+    xmlDocPtr doc;
+    xmlNodePtr libxml;
+    xmlBufferPtr buf;
+    char *ret;
+
+    if ( layer>=sc->layer_cnt ||
+	    (sc->layers[layer].python_persistent == NULL && !(layer == ly_fore && (sc->hstem!=NULL || sc->vstem!=NULL ))) )
+return( NULL );
+    // If the layer has lib data or if this is the foreground and the glyph has hints, we output lib data.
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    doc->encoding = xmlStrdup(BAD_CAST "UTF-8");
+    libxml = xmlNewDocNode(doc, NULL, BAD_CAST "lib", NULL);
+    xmlDocSetRootElement(doc, libxml);
+    xmlAddChild(libxml, PythonLibToXML(sc->layers[layer].python_persistent, (layer == ly_fore ? sc : NULL), sc->layers[layer].python_persistent_has_lists));
+    buf = xmlBufferCreate();
+    xmlNodeDump(buf, doc, libxml, 1, 1);
+    ret = copy((const char *) xmlBufferContent(buf));
+    xmlBufferFree(buf);
+    xmlFreeDoc(doc);
+return( ret );
+}
+
+static char *GlifToBuffer(const SplineChar *sc, int layer, int version, const char *lib, size_t *len) {
     if (layer > sc->layer_cnt) return NULL;
     const struct altuni *altuni;
     int isquad = sc->layers[layer].order2;
@@ -797,246 +918,182 @@ xmlNodePtr _GlifToXML(const SplineChar *sc, int layer, int version) {
     const SplinePoint *sp;
     const AnchorPoint *ap;
     const RefChar *ref;
-    char * stringtmp = NULL;
-    char numstring[32];
-    memset(numstring, 0, sizeof(numstring));
+    struct glifwriter gw;
 
-    // "<?xml version=\"1.0\" encoding=\"UTF-8\""
+    memset(&gw, 0, sizeof(gw));
     /* No DTD for these guys??? */
     // Is there a DTD for glif data? (asks Frank)
     // Perhaps we need to make one.
+    GlifOutWrite(&gw, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n", 39);
 
-    xmlNodePtr topglyphxml = xmlNewNode(NULL, BAD_CAST "glyph"); // Create the glyph node.
-    xmlSetProp(topglyphxml, BAD_CAST "name", BAD_CAST sc->name); // Set the name for the glyph.
-    char *formatString = "1";
+    GlifOutStart(&gw, "glyph");
+    GlifOutAttr(&gw, "name", "%s", sc->name);
     // If UFO is version 1 or 2, use "1" for format. Otherwise, use "2".
-    if (version >= 3) formatString = "2";
-    xmlSetProp(topglyphxml, BAD_CAST "format", BAD_CAST formatString); // Set the format of the glyph.
-    // "<glyph name=\"%s\" format=\"1\">" sc->name
-
-    xmlNodePtr tmpxml2 = xmlNewChild(topglyphxml, NULL, BAD_CAST "advance", NULL); // Create the advance node.
-    xmlSetPropPrintf(tmpxml2, BAD_CAST "width", "%d", sc->width);
-    if ( sc->parent->hasvmetrics ) {
-      stringtmp = smprintf("%d", sc->width);
-      if (stringtmp != NULL) {
-        xmlSetProp(tmpxml2, BAD_CAST "height", BAD_CAST stringtmp);
-        free(stringtmp); stringtmp = NULL;
-      }
-    }
-    // "<advance width=\"%d\" height=\"%d\"/>" sc->width sc->vwidth
+    GlifOutAttr(&gw, "format", "%s", version >= 3 ? "2" : "1");
+
+    GlifOutStart(&gw, "advance");
+    GlifOutAttr(&gw, "width", "%d", sc->width);
+    if ( sc->parent->hasvmetrics )
+	GlifOutAttr(&gw, "height", "%d", sc->width);
+    GlifOutEnd(&gw, "advance");
 
     if ( sc->unicodeenc!=-1 ) {
-      xmlNodePtr unicodexml = xmlNewChild(topglyphxml, NULL, BAD_CAST "unicode", NULL);
-      xmlSetPropPrintf(unicodexml, BAD_CAST "hex", "%04X", sc->unicodeenc);
+	GlifOutStart(&gw, "unicode");
+	GlifOutAttr(&gw, "hex", "%04X", sc->unicodeenc);
+	GlifOutEnd(&gw, "unicode");
     }
-    // "<unicode hex=\"%04X\"/>\n" sc->unicodeenc
-
     for ( altuni = sc->altuni; altuni!=NULL; altuni = altuni->next )
 	if ( altuni->vs==-1 && altuni->fid==0 ) {
-          xmlNodePtr unicodexml = xmlNewChild(topglyphxml, NULL, BAD_CAST "unicode", NULL);
-          xmlSetPropPrintf(unicodexml, BAD_CAST "hex", "%04X", altuni->unienc);
-        }
-        // "<unicode hex=\"%04X\"/>" altuni->unienc
+	    GlifOutStart(&gw, "unicode");
+	    GlifOutAttr(&gw, "hex", "%04X", altuni->unienc);
+	    GlifOutEnd(&gw, "unicode");
+	}
 
 	if (version >= 3) {
 		// Handle the guidelines.
 		GuidelineSet *gl;
 		for ( gl=sc->layers[layer].guidelines; gl != NULL; gl = gl->next ) {
-		    xmlNodePtr guidelinexml = xmlNewChild(topglyphxml, NULL, BAD_CAST "guideline", NULL);
+		    GlifOutStart(&gw, "guideline");
 		    // gl->flags & 0x10 indicates whether to use the abbreviated format in the UFO specification if possible.
 		    if (fmod(gl->angle, 180) || !(gl->flags & 0x10))
-		        xmlSetPropPrintf(guidelinexml, BAD_CAST "x", "%g", gl->point.x);
+		        GlifOutAttr(&gw, "x", "%g", gl->point.x);
 		    if (fmod(gl->angle + 90, 180) || !(gl->flags & 0x10))
-		        xmlSetPropPrintf(guidelinexml, BAD_CAST "y", "%g", gl->point.y);
+		        GlifOutAttr(&gw, "y", "%g", gl->point.y);
 		    if (fmod(gl->angle, 90) || !(gl->flags & 0x10))
-		        xmlSetPropPrintf(guidelinexml, BAD_CAST "angle", "%g", fmod(gl->angle + 360, 360));
+		        GlifOutAttr(&gw, "angle", "%g", fmod(gl->angle + 360, 360));
 		    if (gl->name != NULL)
-		        xmlSetPropPrintf(guidelinexml, BAD_CAST "name", "%s", gl->name);
+		        GlifOutAttr(&gw, "name", "%s", gl->name);
 		    if (gl->flags & 0x20) // color is set. Repack RGBA from a uint32_t to a string with 0-1 scaled values comma-joined.
-		        xmlSetPropPrintf(guidelinexml, BAD_CAST "color", "%g,%g,%g,%g",
+		        GlifOutAttr(&gw, "color", "%g,%g,%g,%g",
 		        (((double)((gl->color >> 24) & 0xFF)) / 255),
 		        (((double)((gl->color >> 16) & 0xFF)) / 255),
 		        (((double)((gl->color >> 8) & 0xFF)) / 255),
 		        (((double)((gl->color >> 0) & 0xFF)) / 255)
 		        );
 		    if (gl->identifier != NULL)
-		        xmlSetPropPrintf(guidelinexml, BAD_CAST "identifier", "%s", gl->identifier);
-		    // "<guideline/>\n"
-
+		        GlifOutAttr(&gw, "identifier", "%s", gl->identifier);
+		    GlifOutEnd(&gw, "guideline");
 		}
 		// Handle the anchors. Put global anchors only in the foreground layer.
 		if (layer == ly_fore)
 			for ( ap=sc->anchor; ap!=NULL; ap=ap->next ) {
-			    int ismark = (ap->type==at_mark || ap->type==at_centry);
-			    xmlNodePtr anchorxml = xmlNewChild(topglyphxml, NULL, BAD_CAST "anchor", NULL);
-			    xmlSetPropPrintf(anchorxml, BAD_CAST "x", "%g", ap->me.x);
-			    xmlSetPropPrintf(anchorxml, BAD_CAST "y", "%g", ap->me.y);
-			    xmlSetPropPrintf(anchorxml, BAD_CAST "name", "%s%s", ismark ? "_" : "", ap->anchor->name);
-			    // "<anchor x=\"%g\" y=\"%g\" name=\"%s%s\"/>" ap->me.x ap->me.y ap->anchor->name
+			    GlifOutStart(&gw, "anchor");
+			    GlifOutAttr(&gw, "x", "%g", ap->me.x);
+			    GlifOutAttr(&gw, "y", "%g", ap->me.y);
+			    GlifOutAnchorName(&gw, ap);
+			    GlifOutEnd(&gw, "anchor");
 			}
 	}
-    if (sc->comment)
-	xmlNewChild(topglyphxml, NULL, BAD_CAST "note", BAD_CAST sc->comment);
+    if (sc->comment) {
+	GlifOutStart(&gw, "note");
+	if (*sc->comment != '\0') {
+	    // Text content keeps the element on one line.
+	    GlifOutWrite(&gw, ">", 1);
+	    gw.open = false;
+	    GlifOutEscaped(&gw, sc->comment, false);
+	    GlifOutWrite(&gw, "</note>\n", 8);
+	    --gw.depth;
+	} else
+	    GlifOutEnd(&gw, "note");
+    }
     if ( sc->layers[layer].refs!=NULL || sc->layers[layer].splines!=NULL ) {
-      xmlNodePtr outlinexml = xmlNewChild(topglyphxml, NULL, BAD_CAST "outline", NULL);
-	// "<outline>"
+	GlifOutStart(&gw, "outline");
 	// Distinguish UFO 3 from UFO 2.
 	if (version < 3) {
 		if (layer == ly_fore)
 			for ( ap=sc->anchor; ap!=NULL; ap=ap->next ) {
-			    int ismark = (ap->type==at_mark || ap->type==at_centry);
-			    xmlNodePtr contourxml = xmlNewChild(outlinexml, NULL, BAD_CAST "contour", NULL);
-			    // "<contour>"
-			    xmlNodePtr pointxml = xmlNewChild(contourxml, NULL, BAD_CAST "point", NULL);
-			    xmlSetPropPrintf(pointxml, BAD_CAST "x", "%g", ap->me.x);
-			    xmlSetPropPrintf(pointxml, BAD_CAST "y", "%g", ap->me.y);
-			    xmlSetPropPrintf(pointxml, BAD_CAST "type", "move");
-			    xmlSetPropPrintf(pointxml, BAD_CAST "name", "%s%s", ismark ? "_" : "", ap->anchor->name);
-			    // "<point x=\"%g\" y=\"%g\" type=\"move\" name=\"%s%s\"/>" ap->me.x ap->me.y (ismark ? "_" : "") ap->anchor->name
-			    // "</contour>"
+			    GlifOutStart(&gw, "contour");
+			    GlifOutStart(&gw, "point");
+			    GlifOutAttr(&gw, "x", "%g", ap->me.x);
+			    GlifOutAttr(&gw, "y", "%g", ap->me.y);
+			    GlifOutAttr(&gw, "type", "move");
+			    GlifOutAnchorName(&gw, ap);
+			    GlifOutEnd(&gw, "point");
+			    GlifOutEnd(&gw, "contour");
 			}
 	}
 	for ( spl=sc->layers[layer].splines; spl!=NULL; spl=spl->next ) {
-            xmlNodePtr contourxml = xmlNewChild(outlinexml, NULL, BAD_CAST "contour", NULL);
-	    // "<contour>"
+	    GlifOutStart(&gw, "contour");
 	    // We write any leading control points.
 	    if (spl->start_offset == -2) {
-		if (spl->first && spl->first->prev && spl->first->prev->from && !spl->first->prev->from->nonextcp && !spl->first->prev->order2) {
-                          xmlNodePtr pointxml = xmlNewChild(contourxml, NULL, BAD_CAST "point", NULL);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "x", "%g", (double)spl->first->prev->from->nextcp.x);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "y", "%g", (double)spl->first->prev->from->nextcp.y);
-                          // "<point x=\"%g\" y=\"%g\"/>\n" (double)sp->prevcp.x (double)sp->prevcp.y
-		}
+		if (spl->first && spl->first->prev && spl->first->prev->from && !spl->first->prev->from->nonextcp && !spl->first->prev->order2)
+		    GlifOutPoint(&gw, (double)spl->first->prev->from->nextcp.x, (double)spl->first->prev->from->nextcp.y);
 	    }
 	    if (spl->start_offset <= -1) {
-		if (spl->first && !spl->first->noprevcp) {
-                          xmlNodePtr pointxml = xmlNewChild(contourxml, NULL, BAD_CAST "point", NULL);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "x", "%g", (double)spl->first->prevcp.x);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "y", "%g", (double)spl->first->prevcp.y);
-                          // "<point x=\"%g\" y=\"%g\"/>\n" (double)sp->prevcp.x (double)sp->prevcp.y
-		}
+		if (spl->first && !spl->first->noprevcp)
+		    GlifOutPoint(&gw, (double)spl->first->prevcp.x, (double)spl->first->prevcp.y);
 	    }
 	    for ( sp=spl->first; sp!=NULL; ) {
 		/* Undocumented fact: If a contour contains a series of off-curve points with no on-curve then treat as quadratic even if no qcurve */
 		// We write the next on-curve point.
 		if (!isquad || sp->ttfindex != 0xffff || !SPInterpolate(sp) || sp->pointtype!=pt_curve || sp->name != NULL) {
-		  xmlNodePtr pointxml = xmlNewChild(contourxml, NULL, BAD_CAST "point", NULL);
-		  xmlSetPropPrintf(pointxml, BAD_CAST "x", "%g", (double)sp->me.x);
-		  xmlSetPropPrintf(pointxml, BAD_CAST "y", "%g", (double)sp->me.y);
-		  xmlSetPropPrintf(pointxml, BAD_CAST "type", (
+		  GlifOutStart(&gw, "point");
+		  GlifOutAttr(&gw, "x", "%g", (double)sp->me.x);
+		  GlifOutAttr(&gw, "y", "%g", (double)sp->me.y);
+		  GlifOutAttr(&gw, "type", "%s", (
 		  sp->prev==NULL        ? "move"   :
 					sp->noprevcp ? "line"   :
 					isquad 		      ? "qcurve" :
 					"curve"));
-		  if (sp->pointtype != pt_corner) xmlSetProp(pointxml, BAD_CAST "smooth", BAD_CAST "yes");
-		  if (sp->name !=NULL) xmlSetProp(pointxml, BAD_CAST "name", BAD_CAST sp->name);
-                  // "<point x=\"%g\" y=\"%g\" type=\"%s\"%s%s%s%s/>\n" (double)sp->me.x (double)sp->me.y
-		  // (sp->prev==NULL ? "move" : sp->prev->knownlinear ? "line" : isquad ? "qcurve" : "curve")
-		  // (sp->pointtype!=pt_corner?" smooth=\"yes\"":"")
-		  // (sp->name?" name=\"":"") (sp->name?sp->name:"") (sp->name?"\"":"")
+		  if (sp->pointtype != pt_corner) GlifOutAttr(&gw, "smooth", "yes");
+		  if (sp->name !=NULL) GlifOutAttr(&gw, "name", "%s", sp->name);
+		  GlifOutEnd(&gw, "point");
 		}
 		if ( sp->next==NULL )
 	    	  break;
 		// We write control points.
 		// The conditionals regarding the start offset avoid duplicating points previously written.
-		if (sp && !sp->nonextcp && sp->next && (sp->next->to != spl->first || spl->start_offset > -2) && sp->next && !sp->next->order2) {
-                          xmlNodePtr pointxml = xmlNewChild(contourxml, NULL, BAD_CAST "point", NULL);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "x", "%g", (double)sp->nextcp.x);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "y", "%g", (double)sp->nextcp.y);
-		    	  // "<point x=\"%g\" y=\"%g\"/>\n" (double)sp->nextcp.x (double)sp->nextcp.y
-		}
+		if (sp && !sp->nonextcp && sp->next && (sp->next->to != spl->first || spl->start_offset > -2) && sp->next && !sp->next->order2)
+		    GlifOutPoint(&gw, (double)sp->nextcp.x, (double)sp->nextcp.y);
 		sp = sp->next->to;
-		if (sp && !sp->noprevcp && (sp != spl->first || spl->start_offset > -1)) {
-                          xmlNodePtr pointxml = xmlNewChild(contourxml, NULL, BAD_CAST "point", NULL);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "x", "%g", (double)sp->prevcp.x);
-                          xmlSetPropPrintf(pointxml, BAD_CAST "y", "%g", (double)sp->prevcp.y);
-                          // "<point x=\"%g\" y=\"%g\"/>\n" (double)sp->prevcp.x (double)sp->prevcp.y
-		}
+		if (sp && !sp->noprevcp && (sp != spl->first || spl->start_offset > -1))
+		    GlifOutPoint(&gw, (double)sp->prevcp.x, (double)sp->prevcp.y);
 		if ( sp==spl->first )
 	    		break;
 	    }
-	    // "</contour>"
+	    GlifOutEnd(&gw, "contour");
 	}
 	/* RoboFab outputs components in alphabetic (case sensitive) order. */
 	/* Somebody asked George to do that too (as in the disabled code below). */
 	/* But it seems important to leave the ordering as it is. */
 	/* And David Raymond advises that tampering with the ordering can break things. */
-	if ( sc->layers[layer].refs!=NULL ) {
-	    const RefChar **refs;
-	    int i, cnt;
-	    for ( cnt=0, ref = sc->layers[layer].refs; ref!=NULL; ref=ref->next ) if ((SCWorthOutputting(ref->sc) || SCHasData(ref->sc) || ref->sc->glif_name != NULL))
-		++cnt;
-	    refs = malloc(cnt*sizeof(RefChar *));
-	    for ( cnt=0, ref = sc->layers[layer].refs; ref!=NULL; ref=ref->next ) if ((SCWorthOutputting(ref->sc) || SCHasData(ref->sc) || ref->sc->glif_name != NULL))
-		refs[cnt++] = ref;
-	    for ( i=0; i<cnt; ++i ) {
-		ref = refs[i];
-    xmlNodePtr componentxml = xmlNewChild(outlinexml, NULL, BAD_CAST "component", NULL);
-    xmlSetPropPrintf(componentxml, BAD_CAST "base", "%s", ref->sc->name);
-		// "<component base=\"%s\"" ref->sc->name
-		if ( ref->transform[0]!=1 ) {
-                  xmlSetPropPrintf(componentxml, BAD_CAST "xScale", "%g", (double) ref->transform[0]);
-		    // "xScale=\"%g\"" (double)ref->transform[0]
-                }
-		if ( ref->transform[3]!=1 ) {
-                  xmlSetPropPrintf(componentxml, BAD_CAST "yScale", "%g", (double) ref->transform[3]);
-		    // "yScale=\"%g\"" (double)ref->transform[3]
-                }
-		if ( ref->transform[1]!=0 ) {
-                  xmlSetPropPrintf(componentxml, BAD_CAST "xyScale", "%g", (double) ref->transform[1]);
-		    // "xyScale=\"%g\"" (double)ref->transform[1]
-                }
-		if ( ref->transform[2]!=0 ) {
-                  xmlSetPropPrintf(componentxml, BAD_CAST "yxScale", "%g", (double) ref->transform[2]);
-		    // "yxScale=\"%g\"" (double)ref->transform[2]
-                }
-		if ( ref->transform[4]!=0 ) {
-                  xmlSetPropPrintf(componentxml, BAD_CAST "xOffset", "%g", (double) ref->transform[4]);
-		    // "xOffset=\"%g\"" (double)ref->transform[4]
-                }
-		if ( ref->transform[5]!=0 ) {
-                  xmlSetPropPrintf(componentxml, BAD_CAST "yOffset", "%g", (double) ref->transform[5]);
-		    // "yOffset=\"%g\"" (double)ref->transform[5]
-                }
-		// "/>"
-	    }
-	    free(refs);
+	for ( ref = sc->layers[layer].refs; ref!=NULL; ref=ref->next ) if ((SCWorthOutputting(ref->sc) || SCHasData(ref->sc) || ref->sc->glif_name != NULL)) {
+		GlifOutStart(&gw, "component");
+		GlifOutAttr(&gw, "base", "%s", ref->sc->name);
+		if ( ref->transform[0]!=1 )
+		    GlifOutAttr(&gw, "xScale", "%g", (double) ref->transform[0]);
+		if ( ref->transform[3]!=1 )
+		    GlifOutAttr(&gw, "yScale", "%g", (double) ref->transform[3]);
+		if ( ref->transform[1]!=0 )
+		    GlifOutAttr(&gw, "xyScale", "%g", (double) ref->transform[1]);
+		if ( ref->transform[2]!=0 )
+		    GlifOutAttr(&gw, "yxScale", "%g", (double) ref->transform[2]);
+		if ( ref->transform[4]!=0 )
+		    GlifOutAttr(&gw, "xOffset", "%g", (double) ref->transform[4]);
+		if ( ref->transform[5]!=0 )
+		    GlifOutAttr(&gw, "yOffset", "%g", (double) ref->transform[5]);
+		GlifOutEnd(&gw, "component");
 	}
-
-	// "</outline>"
+	GlifOutEnd(&gw, "outline");
     }
-    if (sc->layers[layer].python_persistent != NULL || (layer == ly_fore && (sc->hstem!=NULL || sc->vstem!=NULL ))) {
-      // If the layer has lib data or if this is the foreground and the glyph has hints, we output lib data.
-      xmlNodePtr libxml = xmlNewChild(topglyphxml, NULL, BAD_CAST "lib", NULL);
-      xmlNodePtr pythonblob = PythonLibToXML(sc->layers[layer].python_persistent, (layer == ly_fore ? sc : NULL), sc->layers[layer].python_persistent_has_lists);
-      xmlAddChild(libxml, pythonblob);
+    if (lib != NULL) {
+	GlifOutIndent(&gw);
+	GlifOutWrite(&gw, lib, strlen(lib));
+	GlifOutWrite(&gw, "\n", 1);
     }
-    return topglyphxml;
-}
-
-static int GlifDump(const char *glyphdir, const char *gfname, const SplineChar *sc, int layer, int version) {
-    char *gn = buildname(glyphdir,gfname);
-    xmlDocPtr doc = xmlNewDoc(BAD_CAST "1.0");
-    if (doc == NULL) {
-        free(gn);
-        return 0;
-    }
-    xmlNodePtr root_node = _GlifToXML(sc, layer, version);
-    if (root_node == NULL) {xmlFreeDoc(doc); doc = NULL; free(gn); return 0;}
-    xmlDocSetRootElement(doc, root_node);
-    int ret = (xmlSaveFormatFileEnc(gn, doc, "UTF-8", 1) != -1);
-    xmlFreeDoc(doc); doc = NULL;
-    free(gn);
-    return ret;
+    GlifOutEnd(&gw, "glyph");
+    *len = gw.gb.pt-gw.gb.base;
+    return (char *) gw.gb.base;
 }
 
 int _ExportGlif(FILE *glif,SplineChar *sc, int layer, int version) {
-    xmlDocPtr doc = xmlNewDoc(BAD_CAST "1.0");
-    xmlNodePtr root_node = _GlifToXML(sc, layer, version);
-    xmlDocSetRootElement(doc, root_node);
-    int output_status = xmlDocFormatDump(glif, doc, 1);
-    xmlFreeDoc(doc); doc = NULL;
-    return ( output_status != -1 );
+    char *lib = GlifLibToString(sc, layer);
+    size_t len;
+    char *data = GlifToBuffer(sc, layer, version, lib, &len);
+    int ret = data != NULL && fwrite(data, 1, len, glif) == len;
+    free(data);
+    free(lib);
+    return ret;
 }
 
 /* ************************************************************************** */
@@ -1880,54 +1937,333 @@ return( false );
 return( !err );
 }
 
-int WriteUFOLayer(const char * glyphdir, SplineFont * sf, int layer, int version) {
+/* Glif files which already hold what we would write are left alone, so that */
+/*  exporting after an edit only touches the files of the glyphs edited. To  */
+/*  avoid reading every file back, GLIF_MANIFEST keeps the hash, size and    */
+/*  modification time of each glif file as we last saw it. It is only a      */
+/*  cache: if it is missing or out of date the files are compared instead.   */
+#define GLIF_MANIFEST	"data/org.fontforge.glifhashes"
+
+struct glifhash {
+    char *path;			// Relative to the UFO directory.
+    uint64_t hash;
+    long long size, mtime;
+};
+
+struct glifmanifest {
+    struct glifhash *entries;
+    int cnt, max;
+    time_t written;		// Files modified since may not match their entries.
+};
+
+struct glifjob {
+    const SplineChar *sc;
+    int layer, version;
+    char *lib;			// The <lib>, made ahead of time since it may need python.
+    char *path;
+    const struct glifhash *old;
+    time_t trusted;
+    struct glifhash new;
+    int err;
+};
+
+static uint64_t GlifHash(const char *data, size_t len) {
+    // 64 bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for ( i=0; i<len; ++i ) {
+	hash ^= (uint8_t) data[i];
+	hash *= 0x100000001b3ULL;
+    }
+return( hash );
+}
+
+static int GlifHashComp(const void *_h1, const void *_h2) {
+    const struct glifhash *h1 = _h1, *h2 = _h2;
+return( strcmp(h1->path,h2->path) );
+}
+
+static void GlifManifestAdd(struct glifmanifest *man, char *path, uint64_t hash, long long size, long long mtime) {
+    if ( man->cnt>=man->max )
+	man->entries = realloc(man->entries,(man->max += 256)*sizeof(struct glifhash));
+    man->entries[man->cnt].path = path;
+    man->entries[man->cnt].hash = hash;
+    man->entries[man->cnt].size = size;
+    man->entries[man->cnt++].mtime = mtime;
+}
+
+static void GlifManifestFree(struct glifmanifest *man) {
+    int i;
+
+    for ( i=0; i<man->cnt; ++i )
+	free(man->entries[i].path);
+    free(man->entries);
+    memset(man,0,sizeof(*man));
+}
+
+static void GlifManifestLoad(const char *basedir, struct glifmanifest *man) {
+    char *fname = buildname(basedir,GLIF_MANIFEST);
+    FILE *file = fopen(fname,"r");
+    char buffer[1200], *pt, *end;
+    uint64_t hash;
+    long long size, mtime;
+
+    memset(man,0,sizeof(*man));
+    if ( file!=NULL ) {
+	man->written = GFileGetMTime(fname);
+	while ( fgets(buffer,sizeof(buffer),file)!=NULL ) {
+	    hash = strtoull(buffer,&pt,16);
+	    size = strtoll(pt,&pt,10);
+	    mtime = strtoll(pt,&pt,10);
+	    if ( *pt!=' ' || (end=strchr(pt,'\n'))==NULL )
+	continue;
+	    *end = '\0';
+	    GlifManifestAdd(man,copy(pt+1),hash,size,mtime);
+	}
+	fclose(file);
+	qsort(man->entries,man->cnt,sizeof(struct glifhash),GlifHashComp);
+    }
+    free(fname);
+}
+
+static const struct glifhash *GlifManifestFind(const struct glifmanifest *man, const char *path) {
+    struct glifhash key;
+
+    if ( man->cnt==0 )
+return( NULL );
+    key.path = (char *) path;
+return( bsearch(&key,man->entries,man->cnt,sizeof(struct glifhash),GlifHashComp) );
+}
+
+static int UFOFileMatches(const char *fname, const char *data, size_t len) {
+    FILE *file = fopen(fname,"rb");
+    char buffer[8192];
+    size_t got, off = 0;
+    int same = file!=NULL;
+
+    while ( same && (got = fread(buffer,1,sizeof(buffer),file))>0 ) {
+	same = off+got<=len && memcmp(buffer,data+off,got)==0;
+	off += got;
+    }
+    if ( file!=NULL )
+	fclose(file);
+return( same && off==len );
+}
+
+static int UFOWriteFile(const char *fname, const char *data, size_t len) {
+    FILE *file = fopen(fname,"wb");
+    int ok;
+
+    if ( file==NULL )
+return( false );
+    ok = fwrite(data,1,len,file)==len;
+    ok &= (fclose(file)==0);
+return( ok );
+}
+
+static int UFOWriteIfChanged(const char *fname, const char *data, size_t len) {
+    if ( GFileGetSize((char *) fname)==(off_t) len && UFOFileMatches(fname,data,len) )
+return( true );
+return( UFOWriteFile(fname,data,len) );
+}
+
+static void GlifWriteJob(struct glifjob *job) {
+    struct stat st;
+    size_t len;
+    char *data = GlifToBuffer(job->sc,job->layer,job->version,job->lib,&len);
+    int same;
+
+    if ( data==NULL ) {
+	job->err = true;
+return;
+    }
+    job->new.hash = GlifHash(data,len);
+    job->new.size = len;
+    same = stat(job->path,&st)==0 && st.st_size==(off_t) len;
+    // Trust the manifest only for files it saw and that have not been touched
+    // since, otherwise read the file back.
+    if ( same && !(job->old!=NULL && job->old->hash==job->new.hash &&
+	    job->old->size==(long long) len && job->old->mtime==(long long) st.st_mtime &&
+	    st.st_mtime<job->trusted) )
+	same = UFOFileMatches(job->path,data,len);
+    if ( !same && (!UFOWriteFile(job->path,data,len) || stat(job->path,&st)!=0) )
+	job->err = true;
+    else
+	job->new.mtime = st.st_mtime;
+    free(data);
+}
+
+static void GlifWriteRange(void *data, int start, int end) {
+    struct glifjob *jobs = data;
+    locale_t tmplocale; locale_t oldlocale; // Declare temporary locale storage.
+    int i;
+
+    // The locale switch only applies to this thread.
+    switch_to_c_locale(&tmplocale, &oldlocale);
+    for ( i=start; i<end; ++i )
+	GlifWriteJob(&jobs[i]);
+    switch_to_old_locale(&tmplocale, &oldlocale);
+}
+
+static int strpcmp(const void *_s1, const void *_s2) {
+return( strcmp(*(const char **) _s1,*(const char **) _s2) );
+}
+
+static void UFOPruneDir(const char *dirname, const char *prefix, char **keep, int cnt) {
+    // Removes everything in the directory starting with prefix (if given) and
+    // not named in keep, which must be sorted.
+    FF_Dir *dir = ff_opendir(dirname);
+    FF_DirEntry *ent;
+    const char *name;
+    char *fname;
+
+    if ( dir==NULL )
+return;
+    while ( (ent = ff_readdir(dir))!=NULL ) {
+	if ( strcmp(ent->name,".")==0 || strcmp(ent->name,"..")==0 )
+    continue;
+	name = ent->name;
+	if ( (prefix!=NULL && strncmp(name,prefix,strlen(prefix))!=0) ||
+		bsearch(&name,keep,cnt,sizeof(char *),strpcmp)!=NULL )
+    continue;
+	fname = buildname(dirname,ent->name);
+	GFileRemove(fname,true);
+	free(fname);
+    }
+    ff_closedir(dir);
+}
+
+static int WriteUFOLayer(const char *basedir, const char *layerdir, SplineFont *sf, int layer, int version,
+	const struct glifmanifest *oldman, struct glifmanifest *newman) {
     xmlDocPtr plistdoc = PlistInit(); if (plistdoc == NULL) return false; // Make the document.
     xmlNodePtr rootnode = xmlDocGetRootElement(plistdoc); if (rootnode == NULL) { xmlFreeDoc(plistdoc); return false; } // Find the root node.
     xmlNodePtr dictnode = xmlNewChild(rootnode, NULL, BAD_CAST "dict", NULL); if (dictnode == NULL) { xmlFreeDoc(plistdoc); return false; } // Make the dict.
 
+    char *glyphdir = buildname(basedir, layerdir);
     GFileMkDir( glyphdir, 0755 );
-    int i;
+    int i, cnt = 0;
     SplineChar * sc;
     int err = 0;
+    struct glifjob *jobs = calloc(sf->glyphcnt+1, sizeof(struct glifjob));
+    char **names = malloc((sf->glyphcnt+1)*sizeof(char *));
+    // The lib (and so python) and the table of contents are done here, the glif files in parallel.
     for ( i=0; i<sf->glyphcnt; ++i ) if ( SCLWorthOutputtingOrHasData(sc=sf->glyphs[i], layer) ||
       ( layer == ly_fore && (SCWorthOutputting(sc) || SCHasData(sc) || (sc != NULL && sc->glif_name != NULL)) ) ) {
-        // TODO: Optionally skip rewriting an untouched glyph.
-        // Do we track modified glyphs carefully enough for this?
         char * final_name = smprintf("%s%s%s", "", sc->glif_name, ".glif");
         if (final_name != NULL) { // Generate the final name with prefix and suffix.
 		PListAddString(dictnode,sc->name,final_name); // Add the glyph to the table of contents.
-		err |= !GlifDump(glyphdir,final_name,sc,layer,version);
-        	free(final_name); final_name = NULL;
+		struct glifjob *job = &jobs[cnt];
+		job->sc = sc;
+		job->layer = layer;
+		job->version = version;
+		job->lib = GlifLibToString(sc, layer);
+		job->path = buildname(glyphdir, final_name);
+		job->new.path = smprintf("%s/%s", layerdir, final_name);
+		job->old = GlifManifestFind(oldman, job->new.path);
+		job->trusted = oldman->written;
+		names[cnt++] = final_name;
 	} else {
 		err |= 1;
 	}
     }
+    ParallelFor(cnt, GlifWriteRange, jobs);
+    for ( i=0; i<cnt; ++i ) {
+	if ( jobs[i].err ) {
+	    err |= 1;
+	    free(jobs[i].new.path);
+	} else
+	    GlifManifestAdd(newman, jobs[i].new.path, jobs[i].new.hash, jobs[i].new.size, jobs[i].new.mtime);
+	free(jobs[i].lib);
+	free(jobs[i].path);
+    }
+    free(jobs);
 
+    xmlChar *contents = NULL; int len = 0;
+    xmlDocDumpFormatMemoryEnc(plistdoc, &contents, &len, "UTF-8", 1); // Store the document.
     char *fname = buildname(glyphdir, "contents.plist"); // Build the file name for the contents.
-    xmlSaveFormatFileEnc(fname, plistdoc, "UTF-8", 1); // Store the document.
+    if (contents == NULL || !UFOWriteIfChanged(fname, (char *) contents, len))
+	err |= 1;
     free(fname); fname = NULL;
+    xmlFree(contents);
     xmlFreeDoc(plistdoc); // Free the memory.
     xmlCleanupParser();
+
+    // Remove the files of glyphs no longer in the layer.
+    names[cnt++] = copy("contents.plist");
+    qsort(names, cnt, sizeof(char *), strpcmp);
+    UFOPruneDir(glyphdir, NULL, names, cnt);
+    for ( i=0; i<cnt; ++i )
+	free(names[i]);
+    free(names);
+    free(glyphdir);
     if (err) {
 	LogError(_("Error in WriteUFOLayer."));
     }
     return err;
 }
 
+static void UFOClean(const char *basedir) {
+    // Unlike everything else, the glyph directories and the manifest are not
+    // removed; their files are only replaced when they change.
+    FF_Dir *dir;
+    FF_DirEntry *ent;
+    char *fname;
+    char *manifest = strrchr(GLIF_MANIFEST,'/')+1;
+
+    ff_unlink(basedir);		/* In case it's a normal file */
+    dir = ff_opendir(basedir);
+    if ( dir==NULL )
+return;
+    while ( (ent = ff_readdir(dir))!=NULL ) {
+	if ( strcmp(ent->name,".")==0 || strcmp(ent->name,"..")==0 )
+    continue;
+	fname = buildname(basedir,ent->name);
+	if ( strcmp(ent->name,"data")==0 && GFileIsDir(fname) )
+	    UFOPruneDir(fname,NULL,&manifest,1);
+	else if ( strncmp(ent->name,"glyphs",6)!=0 || !GFileIsDir(fname) ) {
+	    if ( !GFileRemove(fname,true) )
+		LogError(_("Error clearing %s."), fname);
+	}
+	free(fname);
+    }
+    ff_closedir(dir);
+}
+
+static int GlifManifestSave(const char *basedir, struct glifmanifest *man) {
+    char *dataname = buildname(basedir,"data");
+    char *fname = buildname(basedir,GLIF_MANIFEST);
+    char *data, *pt;
+    size_t len = 0;
+    int i, ret;
+
+    qsort(man->entries,man->cnt,sizeof(struct glifhash),GlifHashComp);
+    for ( i=0; i<man->cnt; ++i )
+	len += strlen(man->entries[i].path)+3*24;
+    pt = data = malloc(len+1);
+    for ( i=0; i<man->cnt; ++i )
+	pt += sprintf(pt,"%016llx %lld %lld %s\n",(unsigned long long) man->entries[i].hash,
+		man->entries[i].size,man->entries[i].mtime,man->entries[i].path);
+    if ( !GFileIsDir(dataname) )
+	GFileMkDir(dataname,0755);
+    ret = UFOWriteIfChanged(fname,data,pt-data);
+    free(data);
+    free(fname);
+    free(dataname);
+return( ret );
+}
+
 int WriteUFOFontFlex(const char *basedir, SplineFont *sf, enum fontformat ff, int flags,
 	const EncMap *map, int layer, int all_layers, int version) {
-    char *glyphdir;
     int err;
     int i;
     SplineChar *sc;
 
     /* Clean it out, if it exists */
-    if (!GFileRemove(basedir, true)) {
-        LogError(_("Error clearing %s."), basedir);
-    }
+    UFOClean(basedir);
 
     /* Create it */
-    if (GFileMkDir( basedir, 0755 ) == -1) return false;
+    if (!GFileIsDir(basedir) && GFileMkDir( basedir, 0755 ) == -1) return false;
 
     locale_t tmplocale; locale_t oldlocale; // Declare temporary locale storage.
     switch_to_c_locale(&tmplocale, &oldlocale); // Switch to the C locale temporarily and cache the old locale.
@@ -1972,6 +2308,12 @@ int WriteUFOFontFlex(const char *basedir, SplineFont *sf, enum fontformat ff, in
     }
     glif_name_index_destroy(glif_name_hash); // Close the hash table.
 
+    struct glifmanifest oldman, newman;
+    GlifManifestLoad(basedir, &oldman);
+    memset(&newman, 0, sizeof(newman));
+    char **layerdirs = malloc((sf->layer_cnt+1)*sizeof(char *));
+    int layerdircnt = 0;
+
     struct glif_name_index * layer_name_hash = glif_name_index_new(); // Open the hash table.
     struct glif_name_index * layer_path_hash = glif_name_index_new(); // Open the hash table.
 
@@ -2017,15 +2359,22 @@ int WriteUFOFontFlex(const char *basedir, SplineFont *sf, enum fontformat ff, in
         // We write to the layer contents.
         xmlNewTextChild(layernode, NULL, BAD_CAST "string", BAD_CAST numberedlayername);
         xmlNewTextChild(layernode, NULL, BAD_CAST "string", BAD_CAST numberedlayerpathwithglyphs);
-        glyphdir = buildname(basedir, numberedlayerpathwithglyphs);
         // We write the glyph directory.
-        err |= WriteUFOLayer(glyphdir, sf, layer_pos, version);
+        err |= WriteUFOLayer(basedir, numberedlayerpathwithglyphs, sf, layer_pos, version, &oldman, &newman);
+        layerdirs[layerdircnt++] = numberedlayerpathwithglyphs; numberedlayerpathwithglyphs = NULL;
       }
       free(numberedlayername); numberedlayername = NULL;
       free(numberedlayerpath); numberedlayerpath = NULL;
       free(numberedlayerpathwithglyphs); numberedlayerpathwithglyphs = NULL;
-      free(glyphdir); glyphdir = NULL;
     }
+    // Remove the glyph directories of layers no longer in the font.
+    qsort(layerdirs, layerdircnt, sizeof(char *), strpcmp);
+    UFOPruneDir(basedir, "glyphs", layerdirs, layerdircnt);
+    for (i = 0; i < layerdircnt; i++) free(layerdirs[i]);
+    free(layerdirs);
+    err |= !GlifManifestSave(basedir, &newman);
+    GlifManifestFree(&oldman);
+    GlifManifestFree(&newman);
     char *fname = buildname(basedir, "layercontents.plist"); // Build the file name for the contents.
     if (version >= 3)
       xmlSaveFormatFileEnc(fname, plistdoc, "UTF-8", 1); // Store the document.
@@ -2540,44 +2889,521 @@ static void UFOLoadGuidelines(SplineFont *sf, SplineChar *sc, int layer, xmlDocP
 	}
 }
 
-static SplineChar *_UFOLoadGlyph(SplineFont *sf, xmlDocPtr doc, char *glifname, char* glyphname, SplineChar* existingglyph, int layerdest) {
-    xmlNodePtr glyph, kids, contour, points;
+// A glif file is read in two steps. GlifParse streams it through a SAX parser into a
+// glifdata holding the outlines, references, advance and code points, none of which
+// depend on the font, so any number of files may be parsed at once. The rest (notes,
+// anchors, guidelines and the lib) needs the font or python, so it is kept as a small
+// tree of its own in document order, and GlifCommit applies everything to a glyph.
+
+enum glifpointtype { gpt_offcurve, gpt_move, gpt_line, gpt_curve, gpt_qcurve };
+
+struct glifpoint {
+    double x, y;
+    char *name;
+    uint8_t type;
+    uint8_t smooth;
+    uint8_t hasxy;
+};
+
+enum glifstatus { glif_ok, glif_notxml, glif_badformat };
+
+struct glifdata {
+    char *filename;
+    enum glifstatus status;
+    char *name;			// From the <glyph> element.
+    int depth;			// Of the element being parsed, the <glyph> is 1.
+    int inoutline, incontour;
+    int advance, haswidth, hasheight;
+    int width, height;
+    int *unicodes;
+    int ucnt, umax;
+    SplineSet *splines, *lastss;
+    RefChar *refs, *lastref;
+    struct glifpoint *pts;	// The points of the current contour.
+    int pcnt, pmax;
+    xmlDocPtr extras;		// Everything which must wait for GlifCommit.
+    xmlNodePtr cur;		// The element of extras being filled in.
+};
+
+static char *GlifAttr(int nb, const xmlChar **attrs, const char *name, char *buf, int bufsize) {
+	// SAX2 gives five pointers per attribute: name, prefix, URI, value and value end.
+	// We copy the value into buf (or allocate it if buf is NULL).
+	int i, len;
+	for (i = 0; i < nb; ++i) {
+		if (attrs[5*i+1] == NULL && xmlStrcmp(attrs[5*i], (const xmlChar *) name) == 0) {
+			len = attrs[5*i+4] - attrs[5*i+3];
+			if (buf == NULL)
+				return (char *) xmlStrndup(attrs[5*i+3], len);
+			if (len >= bufsize) len = bufsize-1;
+			memcpy(buf, attrs[5*i+3], len);
+			buf[len] = '\0';
+			return buf;
+		}
+	}
+	return NULL;
+}
+
+static SplineSet *GlifContourToSplineSet(struct glifpoint *pts, int cnt) {
+	SplineSet *ss;
+	SplinePoint *sp;
+	SplinePoint *sp2;
+	BasePoint pre[2], init[4];
+	int precnt=0, initcnt=0, open=0;
+	int i;
+	// precnt seems to count control points leading into the next on-curve point. pre stores those points.
+	// initcnt counts the control points that appear before the first on-curve point. This can get updated at the beginning and/or the end of the list.
+	// This is important for determining the order of the closing curve.
+	// A further improvement would be to prefetch the entire list so as to know the declared order of a curve before processing the point.
+
+	int wasquad = -1; // This tracks whether we identified the previous curve as quadratic. (-1 means undefined.)
+	int firstpointsaidquad = -1; // This tracks the declared order of the curve leading into the first on-curve point.
+
+	ss = chunkalloc(sizeof(SplineSet));
+	ss->first = NULL;
+
+	for ( i=0; i<cnt; ++i ) {
+		double x = pts[i].x, y = pts[i].y;
+		char *pname = pts[i].name;
+		int type = pts[i].type;
+		if ( !pts[i].hasxy )
+	continue;
+		if ( type!=gpt_offcurve ) {
+			// This handles only actual points.
+			// We create and label the point.
+		    sp = SplinePointCreate(x,y);
+			sp->dontinterpolate = 1;
+			if (pname != NULL) {
+				sp->name = copy(pname);
+			}
+			if (pts[i].smooth) sp->pointtype = pt_curve;
+			else sp->pointtype = pt_corner;
+
+		    if ( ss->first==NULL ) {
+		        // So this is the first real point!
+		        ss->first = ss->last = sp;
+		        // We move the lead-in points to the init buffer as we may need them for the final curve.
+		        memcpy(init,pre,sizeof(pre));
+		        initcnt = precnt;
+		        if ( type==gpt_move ) {
+		          open = true;
+		          if (initcnt != 0) LogError(_("We cannot have lead-in points for an open curve."));
+		        }
+		    }
+
+		    if ( type==gpt_move ) {
+		        if (ss->first != sp) {
+		          LogError(_("The move point must be at the beginning of the contour."));
+		          SplinePointFree(sp); sp = NULL;
+		        }
+		    } else if ( type==gpt_line ) {
+			SplineMake(ss->last,sp,false);
+		        ss->last = sp;
+		    } else if ( type==gpt_curve ) {
+			wasquad = false;
+			if (ss->first == sp) {
+			  firstpointsaidquad = false;
+			}
+			if ( precnt==2 && ss->first != sp ) {
+			    ss->last->nextcp = pre[0];
+			    sp->prevcp = pre[1];
+			    SplineMake(ss->last,sp,false);
+			}
+		        ss->last = sp;
+		    } else {
+				wasquad = true;
+			if (ss->first == sp) {
+			  firstpointsaidquad = true;
+			} else {
+				if ( precnt>0 && precnt<=2 ) {
+					if ( precnt==2 ) {
+						// If we have two cached control points and the end point is quadratic, we need an implied point between the two control points.
+						sp2 = SplinePointCreate((pre[1].x+pre[0].x)/2,(pre[1].y+pre[0].y)/2);
+						sp2->prevcp = ss->last->nextcp = pre[0];
+						sp2->ttfindex = 0xffff;
+						SplineMake(ss->last,sp2,true);
+						ss->last = sp2;
+					}
+					// Now we connect the real point.
+					sp->prevcp = ss->last->nextcp = pre[precnt-1];
+				}
+				SplineMake(ss->last,sp,true);
+				ss->last = sp;
+			}
+		    }
+		    precnt = 0;
+		} else {
+			// This handles off-curve points (control points).
+		    if ((wasquad == true || wasquad==-1) && precnt==2 ) {
+			// We don't know whether the current curve is quadratic or cubic, but, if we're hitting three off-curve points in a row, something is off.
+			// As mentioned below, we assume in this case that we're dealing with a quadratic TrueType curve that needs implied points.
+			// We create those points since they are adjustable in Fontforge.
+			// There is not a valid case as far as Frank knows in which a cubic curve would have implied points.
+			/* Undocumented fact: If there are no on-curve points (and therefore no indication of quadratic/cubic), assume truetype implied points */
+				// We make the point between the two already cached control points.
+				sp = SplinePointCreate((pre[1].x+pre[0].x)/2,(pre[1].y+pre[0].y)/2);
+				sp->ttfindex = 0xffff;
+				if (pname != NULL) {
+					sp->name = copy(pname);
+				}
+		        sp->nextcp = pre[1];
+		        if ( ss->first==NULL ) {
+			    // This is indeed possible if the first three points are control points.
+			    ss->first = sp;
+			    memcpy(init,pre,sizeof(pre));
+			    initcnt = 1;
+			} else {
+			    ss->last->nextcp = sp->prevcp = pre[0];
+			    initcnt = 0;
+			    SplineMake(ss->last,sp,true);
+			}
+		        ss->last = sp;
+		        // We make the point between the previously cached control point and the new control point.
+		        // We have decided that the curve is quadratic, so we can make the next implied point as well.
+		        sp = SplinePointCreate((x+pre[1].x)/2,(y+pre[1].y)/2);
+		        sp->prevcp = pre[1];
+				sp->ttfindex = 0xffff;
+		        SplineMake(ss->last,sp,true);
+		        ss->last = sp;
+		        pre[0].x = x; pre[0].y = y;
+		        precnt = 1;
+				wasquad = true;
+		    } else if ( wasquad==true && precnt==1) {
+				// Frank thinks that this might generate false positives for qcurves.
+				// This seems not to be the best way to handle it, but mixed-order spline sets are rare.
+				sp = SplinePointCreate((x+pre[0].x)/2,(y+pre[0].y)/2);
+				if (pname != NULL) {
+					sp->name = copy(pname);
+				}
+		        sp->prevcp = pre[0];
+				sp->ttfindex = 0xffff;
+		        if ( ss->first==NULL ) {
+			    	ss->first = sp;
+		            memcpy(init,pre,sizeof(pre));
+		            initcnt = 1;
+				} else {
+				    ss->last->nextcp = sp->prevcp;
+				    SplineMake(ss->last,sp,true);
+				}
+				ss->last = sp;
+		        pre[0].x = x; pre[0].y = y;
+		    } else if ( precnt<2 ) {
+				pre[precnt].x = x;
+		        pre[precnt].y = y;
+		        ++precnt;
+		    }
+		}
+	}
+	// We are finished looping, so it's time to close the curve if it is to be closed.
+	if ( !open && ss->first != NULL ) {
+		ss->start_offset = -initcnt;
+		// init has a list of control points leading into the first point. pre has a list of control points trailing the last processed on-curve point.
+		// We merge pre into init and use init as the list of control points between the last processed on-curve point and the first on-curve point.
+		if ( precnt!=0 ) {
+		    BasePoint temp[2];
+		    memcpy(temp,init,sizeof(temp));
+		    memcpy(init,pre,sizeof(pre));
+		    memcpy(init+precnt,temp,sizeof(temp));
+		    initcnt += precnt;
+		}
+		if ( ((firstpointsaidquad==true || (firstpointsaidquad == -1 && wasquad == true)) && initcnt>0) || initcnt==1 ) {
+			// If the final curve is declared quadratic or is assumed to be by control point count, we proceed accordingly.
+		    for ( i=0; i<initcnt-1; ++i ) {
+				// If the final curve is declared quadratic but has more than one control point, we add implied points.
+				sp = SplinePointCreate((init[i+1].x+init[i].x)/2,(init[i+1].y+init[i].y)/2);
+		        sp->prevcp = ss->last->nextcp = init[i];
+				sp->ttfindex = 0xffff;
+		        SplineMake(ss->last,sp,true);
+		        ss->last = sp;
+		    }
+		    ss->last->nextcp = ss->first->prevcp = init[initcnt-1];
+		    wasquad = true;
+		} else if ( initcnt==2 ) {
+		    ss->last->nextcp = init[0];
+		    ss->first->prevcp = init[1];
+			wasquad = false;
+		}
+		SplineMake(ss->last, ss->first, (firstpointsaidquad==true || (firstpointsaidquad == -1 && wasquad == true)));
+		ss->last = ss->first;
+	}
+	if (ss->first == NULL) {
+		LogError(_("This spline set has no points."));
+		SplinePointListFree(ss); ss = NULL;
+	}
+	return ss;
+}
+
+static xmlNodePtr GlifExtra(struct glifdata *gd, const xmlChar *name) {
+	if (gd->extras == NULL) {
+		gd->extras = xmlNewDoc((const xmlChar *) "1.0");
+		xmlDocSetRootElement(gd->extras, xmlNewDocNode(gd->extras, NULL, (const xmlChar *) "glyph", NULL));
+	}
+	return xmlNewChild(xmlDocGetRootElement(gd->extras), NULL, name, NULL);
+}
+
+static void GlifContourEnd(struct glifdata *gd) {
+	SplineSet *ss;
+	int i;
+
+	if (gd->pcnt == 0) {
+		// The UFO3 specification allows empty contours, we just drop them.
+	} else if (gd->pcnt == 1 && gd->pts[0].name != NULL) {
+		// A contour of a single named point is an anchor point.
+		char buf[40];
+		xmlNodePtr point = GlifExtra(gd, (const xmlChar *) "point");
+		xmlSetProp(point, (const xmlChar *) "name", (xmlChar *) gd->pts[0].name);
+		if (gd->pts[0].hasxy) {
+			sprintf(buf, "%.17g", gd->pts[0].x);
+			xmlSetProp(point, (const xmlChar *) "x", (xmlChar *) buf);
+			sprintf(buf, "%.17g", gd->pts[0].y);
+			xmlSetProp(point, (const xmlChar *) "y", (xmlChar *) buf);
+		}
+	} else if ((ss = GlifContourToSplineSet(gd->pts, gd->pcnt)) != NULL) {
+		if (gd->lastss == NULL) gd->splines = ss;
+		else gd->lastss->next = ss;
+		gd->lastss = ss;
+	}
+	for (i = 0; i < gd->pcnt; ++i)
+		free(gd->pts[i].name);
+	gd->pcnt = 0;
+}
+
+static void GlifComponent(struct glifdata *gd, int nb, const xmlChar **attrs) {
+	char *base = GlifAttr(nb, attrs, "base", NULL, 0);
+	char buf[64];
+	RefChar *r;
+
+	if ( base==NULL || strcmp(base,"") == 0 ) {
+		LogError(_("component with no base glyph"));
+		free(base);
+		return;
+	}
+	// We have a reference. The glyph it refers to is only a placeholder with the right name until UFORefFixup.
+	r = RefCharCreate();
+	r->sc = SplineCharCreate(0);
+	r->sc->name = base;
+	r->transform[0] = r->transform[3] = 1;
+	if ( GlifAttr(nb, attrs, "xScale", buf, sizeof(buf))!=NULL )
+		r->transform[0] = strtod(buf,NULL);
+	if ( GlifAttr(nb, attrs, "yScale", buf, sizeof(buf))!=NULL )
+		r->transform[3] = strtod(buf,NULL);
+	if ( GlifAttr(nb, attrs, "xyScale", buf, sizeof(buf))!=NULL )
+		r->transform[1] = strtod(buf,NULL);
+	if ( GlifAttr(nb, attrs, "yxScale", buf, sizeof(buf))!=NULL )
+		r->transform[2] = strtod(buf,NULL);
+	if ( GlifAttr(nb, attrs, "xOffset", buf, sizeof(buf))!=NULL )
+		r->transform[4] = strtod(buf,NULL);
+	if ( GlifAttr(nb, attrs, "yOffset", buf, sizeof(buf))!=NULL )
+		r->transform[5] = strtod(buf,NULL);
+	if (gd->lastref == NULL) gd->refs = r;
+	else gd->lastref->next = r;
+	gd->lastref = r;
+}
+
+static void GlifPoint(struct glifdata *gd, int nb, const xmlChar **attrs) {
+	struct glifpoint *pt;
+	char xs[64], ys[64], buf[16];
+
+	if (gd->pcnt >= gd->pmax)
+		gd->pts = realloc(gd->pts, (gd->pmax += 32)*sizeof(struct glifpoint));
+	pt = &gd->pts[gd->pcnt++];
+	memset(pt, 0, sizeof(*pt));
+	pt->name = GlifAttr(nb, attrs, "name", NULL, 0);
+	if (GlifAttr(nb, attrs, "x", xs, sizeof(xs)) != NULL && GlifAttr(nb, attrs, "y", ys, sizeof(ys)) != NULL) {
+		pt->x = strtod(xs,NULL); pt->y = strtod(ys,NULL);
+		pt->hasxy = true;
+	}
+	if (GlifAttr(nb, attrs, "smooth", buf, sizeof(buf)) != NULL && strcmp(buf, "yes") == 0)
+		pt->smooth = true;
+	if (GlifAttr(nb, attrs, "type", buf, sizeof(buf)) != NULL) {
+		if (strcmp(buf, "move") == 0) pt->type = gpt_move;
+		else if (strcmp(buf, "line") == 0) pt->type = gpt_line;
+		else if (strcmp(buf, "curve") == 0) pt->type = gpt_curve;
+		else if (strcmp(buf, "qcurve") == 0) pt->type = gpt_qcurve;
+	}
+}
+
+static void GlifStartElement(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI,
+		int nb_namespaces, const xmlChar **namespaces, int nb_attributes, int nb_defaulted, const xmlChar **attrs) {
+	struct glifdata *gd = ctx;
+	char buf[64];
+	int i;
+
+	++gd->depth;
+	if (gd->status != glif_ok)
+		return;
+	if (gd->cur != NULL) {
+		// Inside something we keep for later, copy it whole.
+		gd->cur = xmlNewChild(gd->cur, NULL, localname, NULL);
+		for (i = 0; i < nb_attributes; ++i) {
+			xmlChar *val = xmlStrndup(attrs[5*i+3], attrs[5*i+4]-attrs[5*i+3]);
+			xmlSetProp(gd->cur, attrs[5*i], val);
+			xmlFree(val);
+		}
+	} else if (gd->depth == 1) {
+		char *format = GlifAttr(nb_attributes, attrs, "format", buf, sizeof(buf));
+		if (xmlStrcmp(localname, (const xmlChar *) "glyph") != 0 ||
+				(format != NULL && strcmp(format, "1") != 0 && strcmp(format, "2") != 0))
+			gd->status = glif_badformat;
+		else
+			gd->name = GlifAttr(nb_attributes, attrs, "name", NULL, 0);
+	} else if (gd->depth == 2) {
+		if (xmlStrcmp(localname, (const xmlChar *) "advance") == 0) {
+			if (GlifAttr(nb_attributes, attrs, "width", buf, sizeof(buf)) != NULL) {
+				gd->width = strtol(buf,NULL,10);
+				gd->haswidth = true;
+			}
+			if (GlifAttr(nb_attributes, attrs, "height", buf, sizeof(buf)) != NULL) {
+				gd->height = strtol(buf,NULL,10);
+				gd->hasheight = true;
+			}
+			gd->advance = true;
+		} else if (xmlStrcmp(localname, (const xmlChar *) "unicode") == 0) {
+			if (GlifAttr(nb_attributes, attrs, "hex", buf, sizeof(buf)) != NULL) {
+				if (gd->ucnt >= gd->umax)
+					gd->unicodes = realloc(gd->unicodes, (gd->umax += 4)*sizeof(int));
+				gd->unicodes[gd->ucnt++] = strtol(buf,NULL,16);
+			}
+		} else if (xmlStrcmp(localname, (const xmlChar *) "outline") == 0) {
+			gd->inoutline = true;
+		} else if (xmlStrcmp(localname, (const xmlChar *) "note") == 0 ||
+				xmlStrcmp(localname, (const xmlChar *) "anchor") == 0 ||
+				xmlStrcmp(localname, (const xmlChar *) "guideline") == 0 ||
+				xmlStrcmp(localname, (const xmlChar *) "lib") == 0) {
+			gd->cur = GlifExtra(gd, localname);
+			for (i = 0; i < nb_attributes; ++i) {
+				xmlChar *val = xmlStrndup(attrs[5*i+3], attrs[5*i+4]-attrs[5*i+3]);
+				xmlSetProp(gd->cur, attrs[5*i], val);
+				xmlFree(val);
+			}
+		}
+	} else if (gd->depth == 3 && gd->inoutline) {
+		if (xmlStrcmp(localname, (const xmlChar *) "component") == 0)
+			GlifComponent(gd, nb_attributes, attrs);
+		else if (xmlStrcmp(localname, (const xmlChar *) "contour") == 0)
+			gd->incontour = true;
+	} else if (gd->depth == 4 && gd->incontour) {
+		if (xmlStrcmp(localname, (const xmlChar *) "point") == 0)
+			GlifPoint(gd, nb_attributes, attrs);
+	}
+}
+
+static void GlifEndElement(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI) {
+	struct glifdata *gd = ctx;
+
+	--gd->depth;
+	if (gd->status != glif_ok)
+		return;
+	if (gd->cur != NULL) {
+		gd->cur = gd->cur->parent;
+		if (gd->cur == xmlDocGetRootElement(gd->extras))
+			gd->cur = NULL;
+	} else if (gd->depth == 1) {
+		gd->inoutline = false;
+	} else if (gd->depth == 2 && gd->incontour) {
+		GlifContourEnd(gd);
+		gd->incontour = false;
+	}
+}
+
+static void GlifCharacters(void *ctx, const xmlChar *ch, int len) {
+	struct glifdata *gd = ctx;
+
+	if (gd->status == glif_ok && gd->cur != NULL)
+		xmlAddChild(gd->cur, xmlNewDocTextLen(gd->extras, ch, len));
+}
+
+static void GlifCData(void *ctx, const xmlChar *ch, int len) {
+	struct glifdata *gd = ctx;
+
+	if (gd->status == glif_ok && gd->cur != NULL)
+		xmlAddChild(gd->cur, xmlNewCDataBlock(gd->extras, ch, len));
+}
+
+static void GlifDataFree(struct glifdata *gd) {
+	int i;
+
+	for (i = 0; i < gd->pcnt; ++i)
+		free(gd->pts[i].name);
+	free(gd->pts);
+	free(gd->name);
+	free(gd->unicodes);
+	SplinePointListsFree(gd->splines);
+	while (gd->refs != NULL) {
+		RefChar *r = gd->refs->next;
+		SplineCharFree(gd->refs->sc);
+		gd->refs->sc = NULL;
+		RefCharFree(gd->refs);
+		gd->refs = r;
+	}
+	if (gd->extras != NULL)
+		xmlFreeDoc(gd->extras);
+	memset(gd, 0, sizeof(*gd));
+}
+
+static void GlifParse(struct glifdata *gd, char *memory, int memlen) {
+	// Parses gd->filename, or memory if that is NULL. Must be called in the C locale.
+	xmlSAXHandler sax;
+	int ret;
+
+	memset(&sax, 0, sizeof(sax));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = GlifStartElement;
+	sax.endElementNs = GlifEndElement;
+	sax.characters = sax.ignorableWhitespace = GlifCharacters;
+	sax.cdataBlock = GlifCData;
+	if (gd->filename != NULL)
+		ret = xmlSAXUserParseFile(&sax, gd, gd->filename);
+	else
+		ret = xmlSAXUserParseMemory(&sax, gd, memory, memlen);
+	if (ret != 0 && gd->status == glif_ok)
+		gd->status = glif_notxml;
+	if (gd->pcnt != 0) {
+		// An unfinished contour in a broken file.
+		int i;
+		for (i = 0; i < gd->pcnt; ++i)
+			free(gd->pts[i].name);
+		gd->pcnt = 0;
+	}
+	gd->cur = NULL;
+}
+
+static void GlifParseRange(void *data, int start, int end) {
+	struct glifdata *gds = data;
+	locale_t tmplocale; locale_t oldlocale; // Declare temporary locale storage.
+	int i;
+
+	// The locale switch only applies to this thread.
+	switch_to_c_locale(&tmplocale, &oldlocale);
+	for (i = start; i < end; ++i)
+		GlifParse(&gds[i], NULL, 0);
+	switch_to_old_locale(&tmplocale, &oldlocale);
+}
+
+static SplineChar *GlifCommit(SplineFont *sf, struct glifdata *gd, char* glyphname, SplineChar* existingglyph, int layerdest) {
+    xmlNodePtr kids;
     SplineChar *sc;
-    xmlChar *format, *width, *height, *u;
-    char *name, *tmpname;
-    int uni;
-    char *cpt;
+    char *name, *cpt;
+    int i;
     int newsc = 0;
 
-    glyph = xmlDocGetRootElement(doc);
-    format = xmlGetProp(glyph,(xmlChar *) "format");
-    if ( xmlStrcmp(glyph->name,(const xmlChar *) "glyph")!=0 ||
-	    (format!=NULL && xmlStrcmp(format,(xmlChar *) "1")!=0 && xmlStrcmp(format,(xmlChar *) "2")!=0)) {
+    if ( gd->status==glif_badformat ) {
 		LogError(_("Expected glyph file with format==1 or 2"));
-		xmlFreeDoc(doc);
-		free(format);
+		return( NULL );
+    } else if ( gd->status==glif_notxml ) {
+		if ( gd->filename!=NULL )
+			LogError(_("Bad glif file %s"), gd->filename);
 		return( NULL );
     }
-	free(format);
-	tmpname = (char *) xmlGetProp(glyph,(xmlChar *) "name");
 	if (glyphname != NULL) {
 		// We use the provided name from the glyph listing since the specification says to trust that one more.
 		name = copy(glyphname);
-		// But we still fetch the internally listed name for verification and fail on a mismatch.
-		if ((name == NULL) || ((name != NULL) && (tmpname != NULL) && (strcmp(glyphname, name) != 0))) {
-			LogError(_("Bad glyph name."));
-			if ( tmpname != NULL ) { free(tmpname); tmpname = NULL; }
-			if ( name != NULL ) { free(name); name = NULL; }
-			xmlFreeDoc(doc);
-			return NULL;
-		}
-		if ( tmpname != NULL ) { free(tmpname); tmpname = NULL; }
 	} else {
-		name = tmpname;
+		name = gd->name;
+		gd->name = NULL;
 	}
-    if ( name==NULL && glifname!=NULL ) {
-		char *pt = strrchr(glifname,'/');
-		name = copy(pt+1);
+    if ( name==NULL && gd->filename!=NULL ) {
+		char *pt = strrchr(gd->filename,'/');
+		name = copy(pt!=NULL ? pt+1 : gd->filename);
 		for ( pt=cpt=name; *cpt!='\0'; ++cpt ) {
 			if ( *cpt!='_' )
 			*pt++ = *cpt;
@@ -2597,10 +3423,6 @@ static SplineChar *_UFOLoadGlyph(SplineFont *sf, xmlDocPtr doc, char *glifname,
     	sc->name = name;
 		newsc = 1;
 	}
-	if (sc == NULL) {
-		xmlFreeDoc(doc);
-		return NULL;
-	}
 
 	// Check layer availability here.
 	if ( layerdest>=sc->layer_cnt ) {
@@ -2608,362 +3430,63 @@ static SplineChar *_UFOLoadGlyph(SplineFont *sf, xmlDocPtr doc, char *glifname,
 		memset(sc->layers+sc->layer_cnt,0,(layerdest+1-sc->layer_cnt)*sizeof(Layer));
 		sc->layer_cnt = layerdest + 1;
 	}
-	if (sc->layers == NULL) {
-		if ((newsc == 1) && (sc != NULL)) {
-			SplineCharFree(sc);
+
+	// The outlines and references go at the end of whatever the layer already has.
+	if (gd->splines != NULL) {
+		SplineSet *last = sc->layers[layerdest].splines;
+		while (last != NULL && last->next != NULL) last = last->next;
+		if (last == NULL) sc->layers[layerdest].splines = gd->splines;
+		else last->next = gd->splines;
+		gd->splines = gd->lastss = NULL;
+	}
+	if (gd->refs != NULL) {
+		RefChar *lastref = sc->layers[layerdest].refs;
+		while (lastref != NULL && lastref->next != NULL) lastref = lastref->next;
+		if (lastref == NULL) sc->layers[layerdest].refs = gd->refs;
+		else lastref->next = gd->refs;
+		gd->refs = gd->lastref = NULL;
+	}
+	if ((layerdest == ly_fore) || newsc) {
+		if ( gd->haswidth )
+			sc->width = gd->width;
+		if ( gd->hasheight )
+			sc->vwidth = gd->height;
+		if ( gd->advance )
+			sc->widthset = true;
+		for ( i=0; i<gd->ucnt; ++i ) {
+			if ( sc->unicodeenc == -1 )
+			sc->unicodeenc = gd->unicodes[i];
+			else
+			AltUniAdd(sc,gd->unicodes[i]);
 		}
-		xmlFreeDoc(doc);
-		return NULL;
 	}
 
-    // We track the last splineset so that we can add to the end of the chain.
-    SplineSet *last = sc->layers[layerdest].splines;
-    while (last != NULL && last->next != NULL) last = last->next;
     // We track the last anchor point.
     AnchorPoint *lastap = sc->anchor;
     while (lastap != NULL && lastap->next != NULL) lastap = lastap->next;
     // We track the last guideline.
     GuidelineSet *lastgl = sc->layers[layerdest].guidelines;
     while (lastgl != NULL && lastgl->next != NULL) lastgl = lastgl->next;
-    // We track the last reference.
-    RefChar *lastref = sc->layers[layerdest].refs;
-    while (lastref != NULL && lastref->next != NULL) lastref = lastref->next;
-    for ( kids = glyph->children; kids!=NULL; kids=kids->next ) {
-	if ( xmlStrcmp(kids->name,(const xmlChar *) "advance")==0 ) {
-		if ((layerdest == ly_fore) || newsc) {
-			width = xmlGetProp(kids,(xmlChar *) "width");
-			height = xmlGetProp(kids,(xmlChar *) "height");
-			if ( width!=NULL )
-			sc->width = strtol((char *) width,NULL,10);
-			if ( height!=NULL )
-			sc->vwidth = strtol((char *) height,NULL,10);
-			sc->widthset = true;
-			free(width); free(height);
-		}
-	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "unicode")==0 ) {
-		if ((layerdest == ly_fore) || newsc) {
-			u = xmlGetProp(kids,(xmlChar *) "hex");
-			uni = strtol((char *) u,NULL,16);
-			if ( sc->unicodeenc == -1 )
-			sc->unicodeenc = uni;
-			else
-			AltUniAdd(sc,uni);
-			free(u);
-		}
-	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "note")==0 ) {
-		char *tval = (char*) xmlNodeListGetString(doc, kids->children, true);
+    kids = gd->extras==NULL ? NULL : xmlDocGetRootElement(gd->extras)->children;
+    for ( ; kids!=NULL; kids=kids->next ) {
+	if ( xmlStrcmp(kids->name,(const xmlChar *) "note")==0 ) {
+		char *tval = (char*) xmlNodeListGetString(gd->extras, kids->children, true);
 		if (tval != NULL) {
 			sc->comment = copy(tval);
 			free(tval);
 			tval = NULL;
 		}
-	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "anchor")==0 ){
-		if (UFOLoadAnchor(sf, sc, kids, &lastap))
-			continue;
+	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "anchor")==0 ||
+			xmlStrcmp(kids->name,(const xmlChar *) "point")==0 ){
+		UFOLoadAnchor(sf, sc, kids, &lastap);
 	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "guideline")==0 ){
-		if (UFOLoadGuideline(sf, sc, layerdest, doc, kids, &lastgl, NULL))
-			continue;
-	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "outline")==0 ) {
-	    for ( contour = kids->children; contour!=NULL; contour=contour->next ) {
-		if ( xmlStrcmp(contour->name,(const xmlChar *) "component")==0 ) {
-		    // We have a reference.
-		    char *base = (char *) xmlGetProp(contour,(xmlChar *) "base"),
-			*xs = (char *) xmlGetProp(contour,(xmlChar *) "xScale"),
-			*ys = (char *) xmlGetProp(contour,(xmlChar *) "yScale"),
-			*xys = (char *) xmlGetProp(contour,(xmlChar *) "xyScale"),
-			*yxs = (char *) xmlGetProp(contour,(xmlChar *) "yxScale"),
-			*xo = (char *) xmlGetProp(contour,(xmlChar *) "xOffset"),
-			*yo = (char *) xmlGetProp(contour,(xmlChar *) "yOffset");
-		    RefChar *r;
-		    if ( base==NULL || strcmp(base,"") == 0 )
-				LogError(_("component with no base glyph"));
-		    else {
-				r = RefCharCreate();
-				r->sc = SplineCharCreate(0);
-				r->sc->name = base;
-				r->transform[0] = r->transform[3] = 1;
-				if ( xs!=NULL )
-					r->transform[0] = strtod(xs,NULL);
-				if ( ys!=NULL )
-					r->transform[3] = strtod(ys,NULL);
-				if ( xys!=NULL )
-					r->transform[1] = strtod(xys,NULL);
-				if ( yxs!=NULL )
-					r->transform[2] = strtod(yxs,NULL);
-				if ( xo!=NULL )
-					r->transform[4] = strtod(xo,NULL);
-				if ( yo!=NULL )
-					r->transform[5] = strtod(yo,NULL);
-
-				if ( lastref==NULL ) {
-				  // If there are no existing references, we point the main spline reference to this one.
-				  sc->layers[layerdest].refs = r;
-				} else {
-				  // If there are existing references, we attach to the last one.
-				  lastref->next = r;
-				}
-				lastref = r;
-		    }
-		    if (xs) free(xs); if (ys) free(ys); if (xys) free(xys); if (yxs) free(yxs); if (xo) free(xo); if (yo) free(yo);
-		} else if ( xmlStrcmp(contour->name,(const xmlChar *) "contour")==0 ) {
-		    xmlNodePtr npoints;
-
-			// We now look for anchor points.
-
-            for ( points=contour->children; points!=NULL; points=points->next )
-                if ( xmlStrcmp(points->name,(const xmlChar *) "point")==0 )
-            break;
-            if (points == NULL) {
-                // The UFO3 specification allows empty contours, we just drop them.
-                continue;
-            }
-            for ( npoints=points->next; npoints!=NULL; npoints=npoints->next )
-                if ( xmlStrcmp(npoints->name,(const xmlChar *) "point")==0 )
-            break;
-			// If the contour has a single point without another point after it, we assume it to be an anchor point.
-            if ( points!=NULL && npoints==NULL ) {
-              if (UFOLoadAnchor(sf, sc, points, &lastap))
-                continue; // We stop processing the contour at this point.
-            }
-
-			// If we have not identified the contour as holding an anchor point, we continue processing it as a rendered shape.
-			SplineSet *ss;
-			SplinePoint *sp;
-			SplinePoint *sp2;
-			BasePoint pre[2], init[4];
-			int precnt=0, initcnt=0, open=0;
-			// precnt seems to count control points leading into the next on-curve point. pre stores those points.
-			// initcnt counts the control points that appear before the first on-curve point. This can get updated at the beginning and/or the end of the list.
-			// This is important for determining the order of the closing curve.
-			// A further improvement would be to prefetch the entire list so as to know the declared order of a curve before processing the point.
-
-			int wasquad = -1; // This tracks whether we identified the previous curve as quadratic. (-1 means undefined.)
-			int firstpointsaidquad = -1; // This tracks the declared order of the curve leading into the first on-curve point.
-
-		    ss = chunkalloc(sizeof(SplineSet));
-			ss->first = NULL;
-
-		    for ( points = contour->children; points!=NULL; points=points->next ) {
-			char *xs, *ys, *type, *pname, *smooths;
-			double x,y;
-			int smooth = 0;
-			// We discard any entities in the splineset that are not points.
-			if ( xmlStrcmp(points->name,(const xmlChar *) "point")!=0 )
-		    continue;
-			// Read as strings from xml.
-			xs = (char *) xmlGetProp(points,(xmlChar *) "x");
-			ys = (char *) xmlGetProp(points,(xmlChar *) "y");
-			type = (char *) xmlGetProp(points,(xmlChar *) "type");
-			pname = (char *) xmlGetProp(points,(xmlChar *) "name");
-			smooths = (char *) xmlGetProp(points,(xmlChar *) "smooth");
-			if (smooths != NULL) {
-				if (strcmp(smooths,"yes") == 0) smooth = 1;
-				free(smooths); smooths=NULL;
-			}
-			if ( xs==NULL || ys == NULL ) {
-				if (xs != NULL) { free(xs); xs = NULL; }
-				if (ys != NULL) { free(ys); ys = NULL; }
-				if (type != NULL) { free(type); type = NULL; }
-				if (pname != NULL) { free(pname); pname = NULL; }
-		    	continue;
-			}
-			x = strtod(xs,NULL); y = strtod(ys,NULL);
-			if ( type!=NULL && (strcmp(type,"move")==0 ||
-					    strcmp(type,"line")==0 ||
-					    strcmp(type,"curve")==0 ||
-					    strcmp(type,"qcurve")==0 )) {
-				// This handles only actual points.
-				// We create and label the point.
-			    sp = SplinePointCreate(x,y);
-				sp->dontinterpolate = 1;
-				if (pname != NULL) {
-					sp->name = copy(pname);
-				}
-				if (smooth == 1) sp->pointtype = pt_curve;
-				else sp->pointtype = pt_corner;
-
-			    if ( ss->first==NULL ) {
-			        // So this is the first real point!
-			        ss->first = ss->last = sp;
-			        // We move the lead-in points to the init buffer as we may need them for the final curve.
-			        memcpy(init,pre,sizeof(pre));
-			        initcnt = precnt;
-			        if ( strcmp(type,"move")==0 ) {
-			          open = true;
-			          if (initcnt != 0) LogError(_("We cannot have lead-in points for an open curve."));
-			        }
-			    }
-
-			    if ( strcmp(type,"move")==0 ) {
-			        if (ss->first != sp) {
-			          LogError(_("The move point must be at the beginning of the contour."));
-			          SplinePointFree(sp); sp = NULL;
-			        }
-			    } else if ( strcmp(type,"line")==0 ) {
-				SplineMake(ss->last,sp,false);
-			        ss->last = sp;
-			    } else if ( strcmp(type,"curve")==0 ) {
-				wasquad = false;
-				if (ss->first == sp) {
-				  firstpointsaidquad = false;
-				}
-				if ( precnt==2 && ss->first != sp ) {
-				    ss->last->nextcp = pre[0];
-				    sp->prevcp = pre[1];
-				    SplineMake(ss->last,sp,false);
-				}
-			        ss->last = sp;
-			    } else if ( strcmp(type,"qcurve")==0 ) {
-					wasquad = true;
-				if (ss->first == sp) {
-				  firstpointsaidquad = true;
-				} else {
-					if ( precnt>0 && precnt<=2 ) {
-						if ( precnt==2 ) {
-							// If we have two cached control points and the end point is quadratic, we need an implied point between the two control points.
-							sp2 = SplinePointCreate((pre[1].x+pre[0].x)/2,(pre[1].y+pre[0].y)/2);
-							sp2->prevcp = ss->last->nextcp = pre[0];
-							sp2->ttfindex = 0xffff;
-							SplineMake(ss->last,sp2,true);
-							ss->last = sp2;
-						}
-						// Now we connect the real point.
-						sp->prevcp = ss->last->nextcp = pre[precnt-1];
-					}
-					SplineMake(ss->last,sp,true);
-					ss->last = sp;
-				}
-			    } else {
-			        SplinePointFree(sp); sp = NULL;
-			    }
-			    precnt = 0;
-			} else {
-				// This handles off-curve points (control points).
-			    if ((wasquad == true || wasquad==-1) && precnt==2 ) {
-				// We don't know whether the current curve is quadratic or cubic, but, if we're hitting three off-curve points in a row, something is off.
-				// As mentioned below, we assume in this case that we're dealing with a quadratic TrueType curve that needs implied points.
-				// We create those points since they are adjustable in Fontforge.
-				// There is not a valid case as far as Frank knows in which a cubic curve would have implied points.
-				/* Undocumented fact: If there are no on-curve points (and therefore no indication of quadratic/cubic), assume truetype implied points */
-					// We make the point between the two already cached control points.
-					sp = SplinePointCreate((pre[1].x+pre[0].x)/2,(pre[1].y+pre[0].y)/2);
-					sp->ttfindex = 0xffff;
-					if (pname != NULL) {
-						sp->name = copy(pname);
-					}
-			        sp->nextcp = pre[1];
-			        if ( ss->first==NULL ) {
-				    // This is indeed possible if the first three points are control points.
-				    ss->first = sp;
-				    memcpy(init,pre,sizeof(pre));
-				    initcnt = 1;
-				} else {
-				    ss->last->nextcp = sp->prevcp = pre[0];
-				    initcnt = 0;
-				    SplineMake(ss->last,sp,true);
-				}
-			        ss->last = sp;
-#if 1
-			        // We make the point between the previously cached control point and the new control point.
-			        // We have decided that the curve is quadratic, so we can make the next implied point as well.
-			        sp = SplinePointCreate((x+pre[1].x)/2,(y+pre[1].y)/2);
-			        sp->prevcp = pre[1];
-					sp->ttfindex = 0xffff;
-			        SplineMake(ss->last,sp,true);
-			        ss->last = sp;
-			        pre[0].x = x; pre[0].y = y;
-			        precnt = 1;
-#else
-			        // Let us instead save the second implied point for later.
-			        pre[0].x = pre[1].x; pre[0].y = pre[1].y;
-			        pre[1].x = x; pre[1].y = y;
-			        precnt = 2;
-#endif
-					wasquad = true;
-			    } else if ( wasquad==true && precnt==1) {
-					// Frank thinks that this might generate false positives for qcurves.
-					// This seems not to be the best way to handle it, but mixed-order spline sets are rare.
-					sp = SplinePointCreate((x+pre[0].x)/2,(y+pre[0].y)/2);
-					if (pname != NULL) {
-						sp->name = copy(pname);
-					}
-			        sp->prevcp = pre[0];
-					sp->ttfindex = 0xffff;
-			        if ( ss->first==NULL ) {
-				    	ss->first = sp;
-			            memcpy(init,pre,sizeof(pre));
-			            initcnt = 1;
-					} else {
-					    ss->last->nextcp = sp->prevcp;
-					    SplineMake(ss->last,sp,true);
-					}
-					ss->last = sp;
-			        pre[0].x = x; pre[0].y = y;
-			    } else if ( precnt<2 ) {
-					pre[precnt].x = x;
-			        pre[precnt].y = y;
-			        ++precnt;
-			    }
-			}
-                        if (xs != NULL) { free(xs); xs = NULL; }
-                        if (ys != NULL) { free(ys); ys = NULL; }
-                        if (type != NULL) { free(type); type = NULL; }
-                        if (pname != NULL) { free(pname); pname = NULL; }
-		    }
-		    // We are finished looping, so it's time to close the curve if it is to be closed.
-		    if ( !open && ss->first != NULL ) {
-			ss->start_offset = -initcnt;
-			// init has a list of control points leading into the first point. pre has a list of control points trailing the last processed on-curve point.
-			// We merge pre into init and use init as the list of control points between the last processed on-curve point and the first on-curve point.
-			if ( precnt!=0 ) {
-			    BasePoint temp[2];
-			    memcpy(temp,init,sizeof(temp));
-			    memcpy(init,pre,sizeof(pre));
-			    memcpy(init+precnt,temp,sizeof(temp));
-			    initcnt += precnt;
-			}
-			if ( ((firstpointsaidquad==true || (firstpointsaidquad == -1 && wasquad == true)) && initcnt>0) || initcnt==1 ) {
-				// If the final curve is declared quadratic or is assumed to be by control point count, we proceed accordingly.
-			    int i;
-			    for ( i=0; i<initcnt-1; ++i ) {
-					// If the final curve is declared quadratic but has more than one control point, we add implied points.
-					sp = SplinePointCreate((init[i+1].x+init[i].x)/2,(init[i+1].y+init[i].y)/2);
-			        sp->prevcp = ss->last->nextcp = init[i];
-					sp->ttfindex = 0xffff;
-			        SplineMake(ss->last,sp,true);
-			        ss->last = sp;
-			    }
-			    ss->last->nextcp = ss->first->prevcp = init[initcnt-1];
-			    wasquad = true;
-			} else if ( initcnt==2 ) {
-			    ss->last->nextcp = init[0];
-			    ss->first->prevcp = init[1];
-				wasquad = false;
-			}
-			SplineMake(ss->last, ss->first, (firstpointsaidquad==true || (firstpointsaidquad == -1 && wasquad == true)));
-			ss->last = ss->first;
-		    }
-		    if (ss->first == NULL) {
-				LogError(_("This spline set has no points."));
-				SplinePointListFree(ss); ss = NULL;
-		    } else {
-		        if ( last==NULL ) {
-				// If there are no existing spline sets, we point the main spline reference to this set.
-				sc->layers[layerdest].splines = ss;
-		        } else {
-				// If there are existing spline sets, we attach to the last one.
-				last->next = ss;
-		        }
-				last = ss;
-		    }
-		    }
-	    }
+		UFOLoadGuideline(sf, sc, layerdest, gd->extras, kids, &lastgl, NULL);
 	} else if ( xmlStrcmp(kids->name,(const xmlChar *) "lib")==0 ) {
 	    xmlNodePtr keys, temp, dict = FindNode(kids->children,"dict");
 	    if ( dict!=NULL ) {
 		for ( keys=dict->children; keys!=NULL; keys=keys->next ) {
 		    if ( xmlStrcmp(keys->name,(const xmlChar *) "key")== 0 ) {
-				char *keyname = (char *) xmlNodeListGetString(doc, keys->children, true);
+				char *keyname = (char *) xmlNodeListGetString(gd->extras, keys->children, true);
 				if ( strcmp(keyname,"com.fontlab.hintData")==0 ) {
 			    	for ( temp=keys->next; temp!=NULL; temp=temp->next ) {
 						if ( xmlStrcmp(temp->name,(const xmlChar *) "dict")==0 )
@@ -2972,11 +3495,11 @@ static SplineChar *_UFOLoadGlyph(SplineFont *sf, xmlDocPtr doc, char *glifname,
 			    	if ( temp!=NULL ) {
 						if (layerdest == ly_fore) {
 							if (sc->hstem == NULL) {
-								sc->hstem = GlifParseHints(doc,temp,"hhints");
+								sc->hstem = GlifParseHints(gd->extras,temp,"hhints");
 								SCGuessHHintInstancesList(sc,ly_fore);
 							}
 							if (sc->vstem == NULL) {
-								sc->vstem = GlifParseHints(doc,temp,"vhints");
+								sc->vstem = GlifParseHints(gd->extras,temp,"vhints");
 			        			SCGuessVHintInstancesList(sc,ly_fore);
 			        		}
 						}
@@ -2988,30 +3511,17 @@ static SplineChar *_UFOLoadGlyph(SplineFont *sf, xmlDocPtr doc, char *glifname,
 		}
 #ifndef _NO_PYTHON
 		if (sc->layers[layerdest].python_persistent == NULL) {
-		  sc->layers[layerdest].python_persistent = LibToPython(doc,dict,1);
+		  sc->layers[layerdest].python_persistent = LibToPython(gd->extras,dict,1);
 		  sc->layers[layerdest].python_persistent_has_lists = 1;
 		} else LogError(_("Duplicate lib data."));
 #endif
 	    }
 	}
     }
-    xmlFreeDoc(doc);
     _SPLCategorizePoints(sc->layers[layerdest].splines, pconvert_flag_smooth|pconvert_flag_by_geom);
 return( sc );
 }
 
-static SplineChar *UFOLoadGlyph(SplineFont *sf,char *glifname, char* glyphname, SplineChar* existingglyph, int layerdest) {
-    xmlDocPtr doc;
-
-    doc = xmlParseFile(glifname);
-    if ( doc==NULL ) {
-	LogError(_("Bad glif file %s"), glifname);
-return( NULL );
-    }
-return( _UFOLoadGlyph(sf,doc,glifname,glyphname,existingglyph,layerdest));
-}
-
-
 static void UFORefFixup(SplineFont *sf, SplineChar *sc, int layer ) {
     RefChar *r, *prev;
     SplineChar *rsc;
@@ -3047,10 +3557,8 @@ static void UFORefFixup(SplineFont *sf, SplineChar *sc, int layer ) {
 			if ( prev==NULL ) r = sc->layers[layer].refs;
 			else r = prev->next;
 		} else {
+			// The glyph referred to must have its own references in place first.
 			UFORefFixup(sf,rsc, layer);
-			if (r->sc->layer_cnt > 0) {
-			  fprintf(stderr, "Danger!\n");
-			}
 			SplineCharFree(r->sc);
 			r->sc = rsc;
 			SCReinstanciateRefChar(sc,r,layer);
@@ -3063,10 +3571,12 @@ static void UFOLoadGlyphs(SplineFont *sf,char *glyphdir, int layerdest) {
     char *glyphlist = buildname(glyphdir,"contents.plist");
     xmlDocPtr doc;
     xmlNodePtr plist, dict, keys, value;
-    char *valname, *glyphfname;
-    int i;
+    char *valname;
+    int i, cnt;
     SplineChar *sc;
     int tot;
+    char **glyphnames, **glifnames;
+    struct glifdata *gds;
 
     doc = xmlParseFile(glyphlist);
     free(glyphlist);
@@ -3081,50 +3591,70 @@ return;
 	xmlFreeDoc(doc);
 return;
     }
-	// Count glyphs for the benefit of measuring progress.
+	// Count glyphs for the benefit of measuring progress and sizing the glyph list.
     for ( tot=0, keys=dict->children; keys!=NULL; keys=keys->next ) {
 		if ( xmlStrcmp(keys->name,(const xmlChar *) "key")==0 )
 		    ++tot;
     }
     ff_progress_change_total(tot);
+    glyphnames = malloc(tot*sizeof(char *));
+    glifnames = malloc(tot*sizeof(char *));
+    gds = calloc(tot,sizeof(struct glifdata));
 	// Start reading in glyph name to file name mappings.
-    for ( keys=dict->children; keys!=NULL; keys=keys->next ) {
+    for ( cnt=0, keys=dict->children; keys!=NULL; keys=keys->next ) {
 		for ( value = keys->next; value!=NULL && xmlStrcmp(value->name,(const xmlChar *) "text")==0;
 			value = value->next );
 		if ( value==NULL )
 			break;
 		if ( xmlStrcmp(keys->name,(const xmlChar *) "key")==0 ) {
 			char * glyphname = (char *) xmlNodeListGetString(doc, keys->children, true);
-			int newsc = 0;
-			SplineChar* existingglyph = NULL;
 			if (glyphname != NULL) {
-				existingglyph = SFGetChar(sf,-1,glyphname);
-				if (existingglyph == NULL) newsc = 1;
-				valname = (char *) xmlNodeListGetString(doc, value->children, true);
-				glyphfname = buildname(glyphdir,valname);
-				sc = UFOLoadGlyph(sf, glyphfname, glyphname, existingglyph, layerdest);
-				// We want to stash the glif name (minus the extension) for future use.
-				if (sc != NULL && sc->glif_name == NULL && valname != NULL) {
-				  char * tmppos = strrchr(valname, '.'); if (tmppos) *tmppos = '\0';
-				  sc->glif_name = copy(valname);
-				  if (tmppos) *tmppos = '.';
-				}
-				free(valname);
-				if ( ( sc!=NULL ) && newsc ) {
-					sc->parent = sf;
-					if ( sf->glyphcnt>=sf->glyphmax )
-						sf->glyphs = realloc(sf->glyphs,(sf->glyphmax+=100)*sizeof(SplineChar *));
-					sc->orig_pos = sf->glyphcnt;
-					sf->glyphs[sf->glyphcnt++] = sc;
-				}
+				glyphnames[cnt] = glyphname;
+				glifnames[cnt] = valname = (char *) xmlNodeListGetString(doc, value->children, true);
+				gds[cnt].filename = buildname(glyphdir,valname);
+				++cnt;
 			}
 			keys = value;
-			ff_progress_next();
 		}
     }
     xmlFreeDoc(doc);
 
+	// The glif files are independent of one another, so parse them all at once.
+    xmlInitParser();
+    ParallelFor(cnt,GlifParseRange,gds);
+
+    if ( sf->glyphcnt+cnt>sf->glyphmax )
+		sf->glyphs = realloc(sf->glyphs,(sf->glyphmax=sf->glyphcnt+cnt)*sizeof(SplineChar *));
+	// Then add them to the font in the order contents.plist gives.
+    for ( i=0; i<cnt; ++i ) {
+		SplineChar* existingglyph = SFGetChar(sf,-1,glyphnames[i]);
+		sc = GlifCommit(sf, &gds[i], glyphnames[i], existingglyph, layerdest);
+		valname = glifnames[i];
+		// We want to stash the glif name (minus the extension) for future use.
+		if (sc != NULL && sc->glif_name == NULL && valname != NULL) {
+		  char * tmppos = strrchr(valname, '.'); if (tmppos) *tmppos = '\0';
+		  sc->glif_name = copy(valname);
+		  if (tmppos) *tmppos = '.';
+		}
+		if ( ( sc!=NULL ) && existingglyph==NULL ) {
+			sc->parent = sf;
+			sc->orig_pos = sf->glyphcnt;
+			sf->glyphs[sf->glyphcnt++] = sc;
+		}
+		free(gds[i].filename);
+		GlifDataFree(&gds[i]);
+		free(glyphnames[i]);
+		free(valname);
+		ff_progress_next();
+    }
+    free(gds);
+    free(glyphnames);
+    free(glifnames);
+
+	// Every reference is looked up by name once, in a name hash of the finished glyph list.
+	// Glyphs may have been ticked by the fixup of an earlier layer.
     GlyphHashFree(sf);
+    SFUntickAll(sf);
     for ( i=0; i<sf->glyphcnt; ++i )
 	UFORefFixup(sf,sf->glyphs[i], layerdest);
 }
@@ -4349,22 +4879,18 @@ return( sf );
 
 SplineSet *SplinePointListInterpretGlif(SplineFont *sf,char *filename,char *memory, int memlen,
 	int em_size,int ascent,int is_stroked) {
-    xmlDocPtr doc;
+    struct glifdata gd;
     SplineChar *sc;
     SplineSet *ss;
 
-    if ( filename!=NULL )
-	doc = xmlParseFile(filename);
-    else
-	doc = xmlParseMemory(memory,memlen);
-    if ( doc==NULL )
-return( NULL );
-
+    memset(&gd,0,sizeof(gd));
+    gd.filename = filename;
     locale_t tmplocale; locale_t oldlocale; // Declare temporary locale storage.
     switch_to_c_locale(&tmplocale, &oldlocale); // Switch to the C locale temporarily and cache the old locale.
-    setlocale(LC_NUMERIC,"C");
-    sc = _UFOLoadGlyph(sf,doc,filename,NULL,NULL,ly_fore);
+    GlifParse(&gd,memory,memlen);
+    sc = gd.status==glif_notxml ? NULL : GlifCommit(sf,&gd,NULL,NULL,ly_fore);
     switch_to_old_locale(&tmplocale, &oldlocale); // Switch to the cached locale.
+    GlifDataFree(&gd);
 
     if ( sc==NULL )
 return( NULL );
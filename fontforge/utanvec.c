@@ -109,10 +109,10 @@ int JointBendsCW(BasePoint ut_ref, BasePoint ut_vec) {
     return r > 0;
 }
 
-BasePoint SplineUTanVecAt(Spline *s, bigreal t) {
+static BasePoint _SplineUTanVecAt(Spline *s, bigreal t, int linearish) {
     BasePoint raw;
 
-    if ( SplineIsLinearish(s) ) {
+    if ( linearish ) {
 	raw.x = s->to->me.x - s->from->me.x;
 	raw.y = s->to->me.y - s->from->me.y;
     } else {
@@ -133,6 +133,29 @@ BasePoint SplineUTanVecAt(Spline *s, bigreal t) {
     return MakeUTanVec(raw.x, raw.y);
 }
 
+BasePoint SplineUTanVecAt(Spline *s, bigreal t) {
+    return _SplineUTanVecAt(s, t, SplineIsLinearish(s));
+}
+
+/* Batched form of SPLINEPVAL() and SplineUTanVecAt() over an array of t
+ * values. The per-spline classification is only done once, and the position
+ * loop is simple enough for the compiler to vectorize. xy may be NULL.
+ */
+void SplineUTanVecsAt(Spline *s, const bigreal *t, int cnt, BasePoint *xy,
+                      BasePoint *ut) {
+    int i, linearish = SplineIsLinearish(s);
+    const Spline1D *sx = &s->splines[0], *sy = &s->splines[1];
+
+    if ( xy!=NULL ) {
+	for ( i=0; i<cnt; ++i ) {
+	    xy[i].x = SPLINE1DPVAL(sx, t[i]);
+	    xy[i].y = SPLINE1DPVAL(sy, t[i]);
+	}
+    }
+    for ( i=0; i<cnt; ++i )
+	ut[i] = _SplineUTanVecAt(s, t[i], linearish);
+}
+
 /* Return the lowest t value greater than min_t such that the
  * tangent at the point is parallel to ut, or -1 if the tangent
  * never has that slope.
@@ -36,7 +36,9 @@
 #include "fontforge.h"
 #include "gfile.h"
 #include "mem.h"
+#include "parallel.h"
 #include "parsettf.h"
+#include "trace.h"
 #include "tottf.h"
 
 #include <ctype.h>
@@ -114,80 +116,129 @@ return( true );
 return( false );
 }
 
-static int compressOrNot(FILE *to,int off_to, FILE *from,int off_from,
-	int len, int forcecompress ) {
-    char in[CHUNK];
-    char out[CHUNK];
-    z_stream strm;
-    int ret, err=0;
-    int amount;
-    FILE *tmp;
-    int uncompLen = len;
+int woff_effort = woff_effort_default;
+
+/* The deflate settings tried for each effort level. zlib has no equivalent */
+/*  of zopfli's iterated search, so the exhaustive level tries the settings */
+/*  which most often win (neither the higher level nor the bigger hash always */
+/*  does) and keeps whichever comes out smallest for each table */
+static const struct deflateparams {
+    int level, memlevel, strategy;
+} effort_fast[] = {
+    { 1, 8, Z_DEFAULT_STRATEGY }
+}, effort_default[] = {
+    { Z_DEFAULT_COMPRESSION, 8, Z_DEFAULT_STRATEGY }
+}, effort_best[] = {
+    { Z_BEST_COMPRESSION, 8, Z_DEFAULT_STRATEGY }
+}, effort_exhaustive[] = {
+    { Z_BEST_COMPRESSION, 8, Z_DEFAULT_STRATEGY },
+    { Z_BEST_COMPRESSION, 9, Z_DEFAULT_STRATEGY },
+    { Z_BEST_COMPRESSION, 8, Z_FILTERED },
+    { Z_BEST_COMPRESSION, 9, Z_FILTERED },
+    { Z_DEFAULT_COMPRESSION, 8, Z_DEFAULT_STRATEGY }
+};
+
+static const struct deflateparams *EffortParams(int effort,int *cnt) {
+    switch ( effort ) {
+      case woff_effort_fast:
+	*cnt = sizeof(effort_fast)/sizeof(effort_fast[0]);
+return( effort_fast );
+      case woff_effort_best:
+	*cnt = sizeof(effort_best)/sizeof(effort_best[0]);
+return( effort_best );
+      case woff_effort_exhaustive:
+	*cnt = sizeof(effort_exhaustive)/sizeof(effort_exhaustive[0]);
+return( effort_exhaustive );
+      default:
+	*cnt = sizeof(effort_default)/sizeof(effort_default[0]);
+return( effort_default );
+    }
+}
 
-    /* Empty table, nothing to do */
-    if ( len==0 )
-return(0);
+/* One table compressed with one set of deflate parameters */
+struct woffjob {
+    const uint8_t *data;
+    uint32_t len;
+    const struct deflateparams *params;
+    uint8_t *out;		/* NULL if compression failed */
+    uLong outlen;
+};
+
+static void CompressJobs(void *_jobs,int start,int end) {
+    struct woffjob *jobs = _jobs;
+    z_stream strm;
+    int i;
 
-    fseek(from,off_from,SEEK_SET);
-    memset(&strm,0,sizeof(strm));
-    ret = deflateInit(&strm,Z_DEFAULT_COMPRESSION);
-    if ( ret!=Z_OK ) {
-	fprintf( stderr,"Compression initialization failed.\n" );
-return(0);
-    }
-    tmp = GFileTmpfile();
+    TRACE_BEGIN("deflate");
+    for ( i=start; i<end; ++i ) {
+	struct woffjob *job = &jobs[i];
+	memset(&strm,0,sizeof(strm));
+	if ( deflateInit2(&strm,job->params->level,Z_DEFLATED,MAX_WBITS,
+		job->params->memlevel,job->params->strategy)!=Z_OK )
+    continue;
+	job->outlen = deflateBound(&strm,job->len);
+	job->out = malloc(job->outlen);
+	strm.next_in = (Bytef *) job->data;
+	strm.avail_in = job->len;
+	strm.next_out = job->out;
+	strm.avail_out = job->outlen;
+	if ( job->out==NULL || deflate(&strm,Z_FINISH)!=Z_STREAM_END ) {
+	    free(job->out);
+	    job->out = NULL;
+	} else
+	    job->outlen = strm.total_out;
+	(void)deflateEnd(&strm);
+    }
+    TRACE_END("deflate");
+}
 
-    do {
-	if ( len<=0 ) {
-            (void)deflateEnd(&strm);
-    break;
-        }
-	amount = len;
-	if ( amount>CHUNK )
-	    amount = CHUNK;
-        strm.avail_in = fread(in, 1, amount, from);
-	len -= strm.avail_in;
-        if (ferror(from)) {
-            (void)deflateEnd(&strm);
-	    fprintf( stderr, "IO error.\n" );
-    break;
-        }
-        if (strm.avail_in == 0)
-    break;
-        strm.next_in = (Bytef *)in;
-        do {
-            strm.avail_out = CHUNK;
-            strm.next_out = (Bytef *)out;
-            ret = deflate(&strm, len==0 ? Z_FINISH : Z_NO_FLUSH);
-	    if ( ret==Z_STREAM_ERROR ) {
-		(void)deflateEnd(&strm);
-		fprintf( stderr, "Compression failed somehow.\n");
-		err = 1;
-	break;
-	    }
-	    amount = CHUNK - strm.avail_out;
-	    if ( fwrite(out,1,amount,tmp)!= amount || ferror(tmp) ) {
-		(void)deflateEnd(&strm);
-		fprintf( stderr, "IO Error.\n");
-		err=1;
-	break;
-	    }
-	} while ( strm.avail_out==0 );
-	if ( err )
-    break;
-    } while ( ret!=Z_STREAM_END );
-    (void)deflateEnd(&strm);
-
-    if ( strm.total_out>=uncompLen ) {
-	/* Didn't actually make the data smaller, so store uncompressed */
-	fclose(tmp);
-	copydata(to,off_to,from,off_from,uncompLen);
-return( uncompLen );
-    } else {
-	copydata(to,off_to,tmp,0,strm.total_out);
-	fclose(tmp);
-return( strm.total_out );
+/* Compress each of the cnt blocks with every set of parameters the effort */
+/*  asks for, all at once. Each of out/outlen gets the smallest result. If */
+/*  that is no smaller than the block itself out is NULL and the block should */
+/*  be stored as it is (unless it's forced, as woff metadata must be). If */
+/*  nothing could be compressed all blocks are left to be stored as they are */
+static int CompressBlocks(const uint8_t **data,uint32_t *len,int cnt,int effort,
+	int forcecompress, uint8_t **out,uint32_t *outlen) {
+    int pcnt, i, j, best, err = false;
+    const struct deflateparams *params = EffortParams(effort,&pcnt);
+    struct woffjob *jobs = calloc(cnt*pcnt,sizeof(struct woffjob));
+
+    for ( i=0; i<cnt; ++i ) {
+	out[i] = NULL;
+	outlen[i] = len[i];
+    }
+    if ( jobs==NULL )
+return( forcecompress );
+    for ( i=0; i<cnt; ++i ) for ( j=0; j<pcnt; ++j ) {
+	jobs[i*pcnt+j].data = data[i];
+	jobs[i*pcnt+j].len = len[i];
+	jobs[i*pcnt+j].params = &params[j];
+    }
+    TRACE_BEGIN("WOFF compression");
+    ParallelFor(cnt*pcnt,CompressJobs,jobs);
+    TRACE_END("WOFF compression");
+
+    for ( i=0; i<cnt; ++i ) {
+	best = -1;
+	for ( j=0; j<pcnt; ++j ) {
+	    struct woffjob *job = &jobs[i*pcnt+j];
+	    if ( job->out!=NULL && (best==-1 || job->outlen<jobs[best].outlen) )
+		best = i*pcnt+j;
+	}
+	if ( best==-1 ) {
+	    if ( forcecompress )
+		err = true;
+	} else if ( forcecompress || jobs[best].outlen<len[i] ) {
+	    /* Otherwise it didn't actually make the data smaller, so store it */
+	    out[i] = jobs[best].out;
+	    outlen[i] = jobs[best].outlen;
+	    jobs[best].out = NULL;
+	}
+	for ( j=0; j<pcnt; ++j )
+	    free(jobs[i*pcnt+j].out);
     }
+    free(jobs);
+return( err );
 }
 
 SplineFont *_SFReadWOFF(FILE *woff,int flags,enum openflags openflags, char *filename,char *chosenname,struct fontdict *fd) {
@@ -387,31 +438,25 @@ compareOffsets(const void * lhs, const void * rhs)
            0;
 }
 
-static FILE* WriteSfnt(SplineFont *sf, enum fontformat format,
-	int32_t *bsizes, enum bitmapformat bf,int flags,EncMap *enc,int layer) {
-    FILE *sfnt = GFileTmpfile();
-    if (!sfnt) {
-        return NULL;
-    }
+/* The sfnt which a woff or woff2 file wraps */
+static uint8_t *SfntBuffer(SplineFont *sf, enum fontformat format,
+	int32_t *bsizes, enum bitmapformat bf,int flags,EncMap *enc,int layer,size_t *len) {
     enum fontformat inner_format = (isttflike_ff(format)) ? ff_ttf :
                                    (sf->subfonts!=NULL) ? ff_otfcid : ff_otf;
-    bool ret = _WriteTTFFont(sfnt, sf, inner_format, bsizes, bf, flags, enc, layer);
-    if (!ret) {
-        fclose(sfnt);
-        return NULL;
-    }
-    return sfnt;
+    return WriteTTFFontToBuffer(sf, inner_format, bsizes, bf, flags, enc, layer, len);
 }
 
 int _WriteWOFFFont(FILE *woff,SplineFont *sf, enum fontformat format,
 	int32_t *bsizes, enum bitmapformat bf,int flags,EncMap *enc,int layer) {
-    FILE *sfnt;
+    uint8_t *data, **comp;
+    const uint8_t **tables;
+    size_t filelen;
     int major=sf->woffMajor, minor=sf->woffMinor;
     int flavour, num_tabs;
-    int filelen, len;
-    int i;
-    int compLen, uncompLen, newoffset;
-    int tag, checksum, offset;
+    int len;
+    int i, index;
+    uint32_t *uncompLen, *compLen;
+    int newoffset, offset;
     int tab_start;
     tableOrderRec *tableOrder = NULL;
 
@@ -439,23 +484,23 @@ int _WriteWOFFFont(FILE *woff,SplineFont *sf, enum fontformat format,
 	}
     }
 
-    sfnt = WriteSfnt(sf,format,bsizes,bf,flags,enc,layer);
-    if ( !sfnt ) {
-        return false ;
+    /* Compress the tables from memory rather than going through a file */
+    /*  again for each one */
+    data = SfntBuffer(sf,format,bsizes,bf,flags,enc,layer,&filelen);
+    if ( data==NULL || filelen<12 ) {
+	free(data);
+        return false;
     }
 
-    fseek(sfnt,0,SEEK_END);
-    filelen = ftell(sfnt);
-    rewind(sfnt);
-
-    flavour = getlong(sfnt);
+    flavour = memlong(data,filelen,0);
     /* The woff standard says we should accept all flavours of sfnt, so can't */
     /*  test flavour to make sure we've got a valid sfnt */
     /* But we can test the rest of the header for consistency */
-    num_tabs = getushort(sfnt);
-    (void) getushort(sfnt);
-    (void) getushort(sfnt);
-    (void) getushort(sfnt);
+    num_tabs = memushort(data,filelen,4);
+    if ( (size_t) (12+16*num_tabs)>filelen ) {
+	free(data);
+        return false;
+    }
 
     /*
      * At this point _WriteTTFFont should have generated an sfnt file with
@@ -468,17 +513,28 @@ int _WriteWOFFFont(FILE *woff,SplineFont *sf, enum fontformat format,
      * See https://github.com/fontforge/fontforge/issues/926
      */
     tableOrder = (tableOrderRec *) malloc(num_tabs * sizeof(tableOrderRec));
-    if (!tableOrder) {
-        fclose(sfnt);
+    tables = malloc(num_tabs * sizeof(uint8_t *));
+    comp = malloc(num_tabs * sizeof(uint8_t *));
+    uncompLen = malloc(num_tabs * sizeof(uint32_t));
+    compLen = malloc(num_tabs * sizeof(uint32_t));
+    if (!tableOrder || !tables || !comp || !uncompLen || !compLen) {
+	free(tableOrder); free(tables); free(comp); free(uncompLen); free(compLen);
+	free(data);
         return false;
     }
     for ( i=0; i<num_tabs; ++i ) {
-        fseek(sfnt,(3 + 4*i + 2)*sizeof(int32_t),SEEK_SET);
         tableOrder[i].index = i;
-        tableOrder[i].offset = getlong(sfnt);
+        tableOrder[i].offset = offset = memlong(data,filelen,12+16*i+8);
+	uncompLen[i] = memlong(data,filelen,12+16*i+12);
+	if ( offset<0 || (size_t) offset>filelen || uncompLen[i]>filelen-offset )
+	    uncompLen[i] = 0;
+	tables[i] = data+offset;
     }
     qsort(tableOrder, num_tabs, sizeof(tableOrderRec), compareOffsets);
 
+    /* All tables are compressed at once. Any which can't be are stored */
+    (void) CompressBlocks(tables,uncompLen,num_tabs,woff_effort,false,comp,compLen);
+
     /* Now generate the WOFF file */
     rewind(woff);
     putlong(woff,CHR('w','O','F','F'));
@@ -500,13 +556,10 @@ int _WriteWOFFFont(FILE *woff,SplineFont *sf, enum fontformat format,
 	putlong(woff,0);
 
     for ( i=0; i<num_tabs; ++i ) {
-	fseek(sfnt,(3 + 4*tableOrder[i].index)*sizeof(int32_t),SEEK_SET);
-	tag = getlong(sfnt);
-	checksum = getlong(sfnt);
-	offset = getlong(sfnt);
-	uncompLen = getlong(sfnt);
+	index = tableOrder[i].index;
 	newoffset = ftell(woff);
-	compLen = compressOrNot(woff,newoffset,sfnt,offset,uncompLen,false);
+	fwrite(comp[index]!=NULL ? comp[index] : tables[index],1,compLen[index],woff);
+	free(comp[index]);
 	if ( (ftell(woff)&3)!=0 ) {
 	    /* Pad to a 4 byte boundary */
 	    if ( ftell(woff)&1 )
@@ -514,35 +567,37 @@ int _WriteWOFFFont(FILE *woff,SplineFont *sf, enum fontformat format,
 	    if ( ftell(woff)&2 )
 		putshort(woff,0);
 	}
-	fseek(woff,tab_start+(5*tableOrder[i].index)*sizeof(int32_t),SEEK_SET);
-	putlong(woff,tag);
+	fseek(woff,tab_start+(5*index)*sizeof(int32_t),SEEK_SET);
+	putlong(woff,memlong(data,filelen,12+16*index));	/* tag */
 	putlong(woff,newoffset);
-	putlong(woff,compLen);
-	putlong(woff,uncompLen);
-	putlong(woff,checksum);
+	putlong(woff,compLen[index]);
+	putlong(woff,uncompLen[index]);
+	putlong(woff,memlong(data,filelen,12+16*index+4));	/* checksum */
 	fseek(woff,0,SEEK_END);
     }
-    fclose(sfnt);
+    free(tables); free(comp); free(uncompLen); free(compLen);
+    free(data);
 
     if ( sf->woffMetadata!= NULL ) {
-	int uncomplen = strlen(sf->woffMetadata);
-	uLongf complen = 2*uncomplen;
-	unsigned char *temp=malloc(complen+1);
-	newoffset = ftell(woff);
-	compress(temp,&complen,(unsigned char *)sf->woffMetadata,uncomplen);
-	fwrite(temp,1,complen,woff);
-	free(temp);
-	if ( (ftell(woff)&3)!=0 ) {
-	    /* Pad to a 4 byte boundary */
-	    if ( ftell(woff)&1 )
-		putc('\0',woff);
-	    if ( ftell(woff)&2 )
-		putshort(woff,0);
+	const uint8_t *meta = (const uint8_t *) sf->woffMetadata;
+	uint32_t uncomplen = strlen(sf->woffMetadata), complen;
+	uint8_t *temp;
+	if ( !CompressBlocks(&meta,&uncomplen,1,woff_effort,true,&temp,&complen) ) {
+	    newoffset = ftell(woff);
+	    fwrite(temp,1,complen,woff);
+	    free(temp);
+	    if ( (ftell(woff)&3)!=0 ) {
+		/* Pad to a 4 byte boundary */
+		if ( ftell(woff)&1 )
+		    putc('\0',woff);
+		if ( ftell(woff)&2 )
+		    putshort(woff,0);
+	    }
+	    fseek(woff,24,SEEK_SET);
+	    putlong(woff,newoffset);
+	    putlong(woff,complen);
+	    putlong(woff,uncomplen);
 	}
-	fseek(woff,24,SEEK_SET);
-	putlong(woff,newoffset);
-	putlong(woff,complen);
-	putlong(woff,uncomplen);
 	fseek(woff,0,SEEK_END);
     }
 
@@ -640,20 +695,16 @@ int WriteWOFF2Font(char *fontname, SplineFont *sf, enum fontformat format, int32
 
 int _WriteWOFF2Font(FILE *fp, SplineFont *sf, enum fontformat format, int32_t *bsizes, enum bitmapformat bf, int flags, EncMap *enc, int layer)
 {
-    FILE* sfnt = WriteSfnt(sf,format,bsizes,bf,flags,enc,layer);
-    if ( !sfnt ) {
-        return false ;
-    }
-
     size_t raw_input_length = 0, comp_size;
-    uint8_t *raw_input = ReadFileToBuffer(sfnt, &raw_input_length);
-    fclose(sfnt);
+    uint8_t *raw_input = SfntBuffer(sf,format,bsizes,bf,flags,enc,layer,&raw_input_length);
     if (!raw_input) {
         return 0;
     }
 
     uint8_t *comp_buffer;
+    TRACE_BEGIN("WOFF2 compression");
     int ret = woff2_convert_ttf_to_woff2(raw_input, raw_input_length, &comp_buffer, &comp_size);
+    TRACE_END("WOFF2 compression");
     free(raw_input);
     if (!ret) {
         free(comp_buffer);
@@ -9,6 +9,10 @@
 extern "C" {
 #endif
 
+/* How hard to try when compressing woff tables */
+enum woff_effort { woff_effort_default, woff_effort_fast, woff_effort_best, woff_effort_exhaustive };
+extern int woff_effort;
+
 extern int WriteWOFFFont(char *fontname, SplineFont *sf, enum fontformat format, int32_t *bsizes, enum bitmapformat bf, int flags, EncMap *enc, int layer);
 extern int _WriteWOFFFont(FILE *woff, SplineFont *sf, enum fontformat format, int32_t *bsizes, enum bitmapformat bf, int flags, EncMap *enc, int layer);
 extern SplineFont *_SFReadWOFF(FILE *woff, int flags, enum openflags openflags, char *filename, char *chosenname, struct fontdict *fd);
@@ -2092,15 +2092,31 @@ static void DrawSelImageList(CharView *cv,GWindow pixmap,ImageList *images) {
 }
 
 static void DrawOldState(CharView *cv, GWindow pixmap, Undoes *undo, DRect *clip) {
-    RefChar *refs;
+    RefChar *refs, *temp;
+    int j;
 
     if ( undo==NULL )
 return;
 
     CVDrawSplineSet(cv,pixmap,undo->u.state.splines,oldoutlinecol,false,clip);
-    for ( refs=undo->u.state.refs; refs!=NULL; refs=refs->next )
+    for ( refs=undo->u.state.refs; refs!=NULL; refs=refs->next ) {
 	if ( refs->layers[0].splines!=NULL )
 	    CVDrawSplineSet(cv,pixmap,refs->layers[0].splines,oldoutlinecol,false,clip);
+	else if ( refs->sc!=NULL ) {
+	    /* Undoes made by _SCPreserveLayer keep references without their */
+	    /*  outlines. Build them to draw, but leave the undo as it is */
+	    temp = RefCharCreate();
+	    free(temp->layers);
+	    *temp = *refs;
+	    temp->layers = NULL;
+	    temp->layer_cnt = 0;
+	    temp->next = NULL;
+	    SCReinstanciateRefChar(cv->b.sc,temp,CVLayer(&cv->b));
+	    for ( j=0; j<temp->layer_cnt; ++j )
+		CVDrawSplineSet(cv,pixmap,temp->layers[j].splines,oldoutlinecol,false,clip);
+	    RefCharFree(temp);
+	}
+    }
     /* Don't do images... */
 }
 
@@ -2154,7 +2170,8 @@ return;
 	sc = NULL;
 	if ( cv->b.sc->parent!=sub && (cv->mmvisible & (1<<j)) &&
 		cv->b.sc->orig_pos<sub->glyphcnt )
-	    sc = sub->glyphs[cv->b.sc->orig_pos];
+	    sc = j==0 ? sub->glyphs[cv->b.sc->orig_pos] :
+		    MMInstanceGlyph(mm,j-1,cv->b.sc->orig_pos);
 	if ( sc!=NULL ) {
 	    for ( rf=sc->layers[ly_fore].refs; rf!=NULL; rf = rf->next )
 		CVDrawSplineSet(cv,pixmap,rf->layers[0].splines,backoutlinecol,false,clip);
@@ -10399,7 +10416,7 @@ static void cv_ellistcheck(CharView *cv, struct gmenuitem *mi) {
 		    CVLayer((CharViewBase *) cv),false);
 	  break;
 	  case CV_MID_Autotrace:
-	    mi->ti.disabled = FindAutoTraceName()==NULL || cv->b.sc->layers[ly_back].images==NULL;
+	    mi->ti.disabled = cv->b.sc->layers[ly_back].images==NULL;
 	  break;
 	  case CV_MID_Align:
 	    mi->ti.disabled = cv->b.sc->inspiro && hasspiro();
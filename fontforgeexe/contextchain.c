@@ -1280,6 +1280,7 @@ return;
 	IError("The OK button should not be enabled here");
 return;
     }
+    SFClearLookupClasses(ccd->sf);
     if ( ccd->isnew )
 	GFI_FinishContextNew(ccd->gfi,ccd->fpst,true);
     ccd->done = true;
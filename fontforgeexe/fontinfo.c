@@ -4658,6 +4658,7 @@ return(true);
 	last_aspect = d->old_aspect;
 
 	/* Class 0 is unused */
+	SFClearLookupClasses(sf);
 	MarkClassFree(sf->mark_class_cnt,sf->mark_classes,sf->mark_class_names);
 	sf->mark_class_cnt = mc_rows + 1;
 	sf->mark_classes     = malloc((mc_rows+1)*sizeof(char *));
@@ -3661,6 +3661,7 @@ static void FontViewSetTitles(SplineFont *sf) {
 static void FVMenuShowSubFont(GWindow gw, struct gmenuitem *mi, GEvent *UNUSED(e)) {
     FontView *fv = (FontView *) GDrawGetUserData(gw);
     SplineFont *new = mi->ti.userdata;
+    SFMaterializeMM(new);
     FVShowSubFont(fv,new);
 }
 
@@ -4280,7 +4281,7 @@ static void ellistcheck(GWindow gw, struct gmenuitem *mi, GEvent *UNUSED(e)) {
 	  break;
 	  case FV_MID_Autotrace:
 	    anytraceable = false;
-	    if ( FindAutoTraceName()!=NULL && anychars!=-1 ) {
+	    if ( anychars!=-1 ) {
 		int i;
 		for ( i=0; i<fv->b.map->enccount; ++i )
 		    if ( fv->b.selected[i] && (gid = fv->b.map->map[i])!=-1 &&
@@ -1247,6 +1247,7 @@ return( true );
 	kc->subtable->onlyCloser = onlyCloser;
 	kc->subtable->dontautokern = !autokern;
 
+	KernClassMapFree(kc);
 	kc->first_cnt = kcd->first_cnt;
 	kc->second_cnt = kcd->second_cnt;
 	kc->firsts = malloc(kc->first_cnt*sizeof(char *));
@@ -3557,8 +3558,8 @@ KernClass *SFFindKernClass(SplineFont *sf,SplineChar *first,SplineChar *last,
     for ( i=0; i<=pcnt; ++i ) {
 	for ( kc=sf->kerns; kc!=NULL; kc=kc->next ) {
 	    uint8_t kspecd = kc->firsts[0] != NULL;
-	    f = KCFindName(first->name,kc->firsts ,kc->first_cnt ,i % 2);
-	    l = KCFindName(last->name ,kc->seconds,kc->second_cnt,i % 2);
+	    f = KCFindGlyph(sf,kc,first,true ,i % 2);
+	    l = KCFindGlyph(sf,kc,last ,false,i % 2);
 	    if ( f!=-1 && l!=-1 && ( kspecd || f!=0 || l!=0 )  ) {
 		if ( i > 1 || kc->offsets[f*kc->second_cnt+l]!=0 ) {
 		    *index = f*kc->second_cnt+l;
@@ -3579,8 +3580,8 @@ KernClass *SFFindVKernClass(SplineFont *sf,SplineChar *first,SplineChar *last,
     for ( i=0; i<=pcnt; ++i ) {
 	for ( kc=sf->vkerns; kc!=NULL; kc=kc->next ) {
 	    uint8_t kspecd = kc->firsts[0] != NULL;
-	    f = KCFindName(first->name,kc->firsts ,kc->first_cnt ,i % 2);
-	    l = KCFindName(last->name ,kc->seconds,kc->second_cnt,i % 2);
+	    f = KCFindGlyph(sf,kc,first,true ,i % 2);
+	    l = KCFindGlyph(sf,kc,last ,false,i % 2);
 	    if ( f!=-1 && l!=-1 && ( kspecd || f!=0 || l!=0 ) ) {
 		if ( i > 1 || kc->offsets[f*kc->second_cnt+l]!=0 ) {
 		    *index = f*kc->second_cnt+l;
@@ -1467,8 +1467,8 @@ return( false );
     {
 	// cache the cell in the kernclass that we are editing for quick comparison
 	// in the loop
-	int pscidx = KernClassFindIndexContaining( kc->firsts,  kc->first_cnt,  psc->name );
-	int  scidx = KernClassFindIndexContaining( kc->seconds, kc->second_cnt,  sc->name );
+	int pscidx = KCFindGlyph( mv->sf, kc, psc, true,  false );
+	int  scidx = KCFindGlyph( mv->sf, kc,  sc, false, false );
 
 	if( pscidx > 0 && scidx > 0 )
 	{
@@ -1481,17 +1481,13 @@ return( false );
 		/* printf("mv->glyphs[i-1].sc.name:%s\n", mv->glyphs[i-1].sc->name ); */
 		/* printf("mv->glyphs[i  ].sc.name:%s\n", mv->glyphs[i  ].sc->name ); */
 
-		int pidx = KernClassFindIndexContaining( kc->firsts,
-							 kc->first_cnt,
-							 mv->glyphs[i-1].sc->name );
+		int pidx = KCFindGlyph( mv->sf, kc, mv->glyphs[i-1].sc, true, false );
 		/*
 		 * Same value for firsts in the kernclass matrix
 		 */
 		if( pidx == pscidx )
 		{
-		    int idx = KernClassFindIndexContaining( kc->seconds,
-							    kc->second_cnt,
-							    mv->glyphs[ i ].sc->name );
+		    int idx = KCFindGlyph( mv->sf, kc, mv->glyphs[i].sc, false, false );
 
 		    /*
 		     * First and Second match, we have the same cell
@@ -3842,8 +3838,7 @@ static void ellistcheck(GWindow gw, struct gmenuitem *mi, GEvent *UNUSED(e)) {
 	    mi->ti.disabled = !anybuildable;
 	  break;
 	  case MV_MID_Autotrace:
-	    mi->ti.disabled = !(FindAutoTraceName()!=NULL && sc!=NULL &&
-		    sc->layers[ly_back].images!=NULL );
+	    mi->ti.disabled = !(sc!=NULL && sc->layers[ly_back].images!=NULL );
 	  break;
 	}
     }
@@ -2519,6 +2519,8 @@ void MMWizard(MMSet *mm) {
     memset(&mmw,0,sizeof(mmw));
     mmw.old = mm;
     if ( mm!=NULL ) {
+	/* The dialog works on real instance fonts */
+	MMMaterialize(mm);
 	mmw.mm = MMCopy(mm);
 	mmw.axis_count = mm->axis_count;
 	mmw.instance_count = mm->instance_count;
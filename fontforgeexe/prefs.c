@@ -104,6 +104,7 @@ extern int save_to_dir;			/* in fontview, use sfdir rather than sfd */
 extern int palettes_docked;		/* in cvpalettes */
 extern int cvvisible[2], bvvisible[3];	/* in cvpalettes.c */
 extern int maxundoes;			/* in cvundoes */
+extern int maxundomemory;		/* in cvundoes */
 extern int pref_mv_shift_and_arrow_skip;         /* in metricsview.c */
 extern int pref_mv_control_shift_and_arrow_skip; /* in metricsview.c */
 extern int mv_type;                              /* in metricsview.c */
@@ -194,6 +195,7 @@ extern int prefs_cv_outline_thickness; /* from charview.c */
 
 extern float OpenTypeLoadHintEqualityTolerance;  /* autohint.c */
 extern float GenerateHintWidthEqualityTolerance; /* splinesave.c */
+extern float QuadraticTolerance; /* splineorder2.c */
 extern int warn_script_unsaved; /* fontview.c */
 extern NameList *force_names_when_opening;
 extern NameList *force_names_when_saving;
@@ -348,6 +350,7 @@ static struct prefs_list {
 	{ N_("JoinSnap"), pr_real, &joinsnap, NULL, NULL, '\0', NULL, 0, N_("The Edit->Join command will join points which are this close together\nA value of 0 means they must be coincident") },
 	{ N_("CopyMetaData"), pr_bool, &copymetadata, NULL, NULL, '\0', NULL, 0, N_("When copying glyphs from the font view, also copy the\nglyphs' metadata (name, encoding, comment, etc).") },
 	{ N_("UndoDepth"), pr_int, &maxundoes, NULL, NULL, '\0', NULL, 0, N_("The maximum number of Undoes/Redoes stored in a glyph. Use -1 for infinite Undoes\n(but watch RAM consumption and use the Edit menu's Remove Undoes as needed)") },
+	{ N_("UndoMemory"), pr_int, &maxundomemory, NULL, NULL, '\0', NULL, 0, N_("The number of megabytes all Undoes together may use.\nWhen they use more the oldest are removed, whichever\nglyphs they belong to, though the last change made to\neach glyph may always be undone. Use 0 for no limit") },
 	{ N_("UpdateFlex"), pr_bool, &updateflex, NULL, NULL, '\0', NULL, 0, N_("Figure out flex hints after every change") },
 	{ N_("AutoKernDialog"), pr_bool, &default_autokern_dlg, NULL, NULL, '\0', NULL, 0, N_("Open AutoKern dialog for new kerning subtables") },
 	{ N_("MetricsShiftSkip"), pr_int, &pref_mv_shift_and_arrow_skip, NULL, NULL, '\0', NULL, 0, N_("Number of units to increment/decrement a table value by in the metrics window when shift is held") },
@@ -410,6 +413,7 @@ static struct prefs_list {
 #endif
 
 	{ N_("GenerateHintWidthEqualityTolerance"), pr_real, &GenerateHintWidthEqualityTolerance, NULL, NULL, '\0', NULL, 0, N_( "When generating a font, ignore slight rounding errors for hints that should be at the top or bottom of the glyph. For example, you might like to set this to 0.02 so that 19.999 will be considered 20. But only for the hint width value.") },
+	{ N_("QuadraticTolerance"), pr_real, &QuadraticTolerance, NULL, NULL, '\0', NULL, 0, N_("The largest distance, in em units, a quadratic spline may stray from the cubic it replaces when FontForge converts to TrueType outlines. FontForge then uses as few quadratic splines as it can. 0 uses the older conversion, which puts points at extrema and points of inflection.") },
 
 	PREFS_LIST_EMPTY
 },
@@ -53,6 +53,7 @@ static void _doscriptusage(void) {
     printf( "\t-c script-string\t (executes the argument as scripting cmds)\n" );
     printf( "\t-skippyfile\t\t (do not execute python init scripts)\n" );
     printf( "\t-skippyplug\t\t (do not load python plugins)\n" );
+    printf( "\t-server socket\t\t (runs the scripts of any fontforge started with\n\t\t\t\t  FONTFORGE_SERVER set to socket)\n" );
     printf( "\n" );
     printf( "If no scriptfile/string is given (or if it's \"-\") FontForge will read stdin\n" );
     printf( "FontForge will read postscript (pfa, pfb, ps, cid), opentype (otf),\n" );
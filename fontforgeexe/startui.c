@@ -113,6 +113,7 @@ static void _dousage(void) {
     printf( "\t\tmust be the first option. All others passed to the script.\n" );
     printf( "\t-skippyfile\t\t (do not execute python init scripts)\n" );
     printf( "\t-skippyplug\t\t (do not load python plugins)\n" );
+    printf( "\t-server socket\t\t (runs the scripts of any fontforge started with\n\t\t\t\t  FONTFORGE_SERVER set to socket)\n" );
     printf( "\n" );
     printf( "FontForge will read postscript (pfa, pfb, ps, cid), opentype (otf),\n" );
     printf( "\ttruetype (ttf,ttc), macintosh resource fonts (dfont,bin,hqx),\n" );
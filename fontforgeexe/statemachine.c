@@ -859,6 +859,7 @@ static int SMD_Ok(GGadget *g, GEvent *e) {
 	sm->flags = (sm->flags & ~0xc000) |
 		(GGadgetIsChecked(GWidgetGetControl(smd->gw,CID_RightToLeft))?0x4000:0) |
 		(GGadgetIsChecked(GWidgetGetControl(smd->gw,CID_VertOnly))?0x8000:0);
+	SFClearLookupClasses(smd->sf);
 	_SMD_Finish(smd,true);
     }
 return( true );
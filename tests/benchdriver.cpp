@@ -0,0 +1,419 @@
+/* Copyright (C) 2026 by FontForge Authors */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * A benchmark driver for FontForge.
+ * Runs a fixed set of workloads over the fonts in tests/fonts, each in its
+ * own fontforge process, and reports how long they took as JSON.
+ *
+ * Each workload is timed inside fontforge, so that starting python and
+ * reading the font being worked on are not counted. It is first run a few
+ * times to warm up, and then repeatedly, with the setup (usually reopening
+ * the font) and teardown of each repetition left out of the times.
+ *
+ * Like systestdriver this has no FontForge library dependencies.
+ */
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/* Each step is python run in one namespace, in which `fontforge`, `source`
+ * (the font from tests/fonts) and `work` (a scratch directory) are defined.
+ * prepare runs once, the others for every repetition and only run is timed.
+ * A workload which can't run in this build exits 77 from prepare.
+ * Generating keeps some results on the font for the next generation (the
+ * quadratic conversions for truetype, for one), so the generate workloads
+ * reopen the font for each repetition to time a cold generation */
+struct Workload {
+    const char* name;
+    const char* font;
+    const char* prepare;
+    const char* setup;
+    const char* run;
+    const char* teardown;
+};
+
+const Workload workloads[] = {
+    {"open_sfd", "DejaVuSerif.sfd", "",
+     "", "f = fontforge.open(source)", "f.close()"},
+    {"open_otf", "Ambrosia.sfd",
+     "g = fontforge.open(source); g.generate(work + '/bench.otf'); g.close()",
+     "", "f = fontforge.open(work + '/bench.otf')", "f.close()"},
+    {"open_ttf", "NotoSerifTibetan-Regular.ttf", "",
+     "", "f = fontforge.open(source)", "f.close()"},
+    {"open_ufo", "DejaVuSerif.sfd",
+     "g = fontforge.open(source); g.generate(work + '/bench.ufo'); g.close()",
+     "", "f = fontforge.open(work + '/bench.ufo')", "f.close()"},
+    {"save_sfd", "DejaVuSerif.sfd", "f = fontforge.open(source)",
+     "", "f.save(work + '/bench.sfd')", ""},
+    {"generate_otf", "Ambrosia.sfd", "",
+     "f = fontforge.open(source)", "f.generate(work + '/bench.otf')",
+     "f.close()"},
+    {"generate_ttf", "DejaVuSerif.sfd", "",
+     "f = fontforge.open(source)", "f.generate(work + '/bench.ttf')",
+     "f.close()"},
+    {"generate_woff2", "DejaVuSerif.sfd",
+     "g = fontforge.open(source)\n"
+     "g.generate(work + '/bench.woff2')\n"
+     "g.close()\n"
+     "if open(work + '/bench.woff2', 'rb').read(4) != b'wOF2':\n"
+     "    sys.exit(77)",
+     "f = fontforge.open(source)", "f.generate(work + '/bench.woff2')",
+     "f.close()"},
+    {"remove_overlap", "Ambrosia.sfd", "",
+     "f = fontforge.open(source); f.selection.all()",
+     "f.removeOverlap()", "f.close()"},
+    {"simplify", "DejaVuSerif.sfd", "",
+     "f = fontforge.open(source); f.selection.all()",
+     "f.simplify()", "f.close()"},
+    {"autohint", "Ambrosia.sfd", "",
+     "f = fontforge.open(source); f.selection.all()",
+     "f.autoHint()", "f.close()"},
+    {"autoinstr", "DejaVuSerif.sfd", "",
+     "f = fontforge.open(source); f.selection.all(); f.autoHint()",
+     "f.autoInstr()", "f.close()"},
+    {"validate", "Ambrosia.sfd", "",
+     "f = fontforge.open(source)", "f.validate(True)", "f.close()"},
+    {"kerning", "Ambrosia.sfd", "",
+     "f = fontforge.open(source)\n"
+     "f.addLookup('kern', 'gpos_pair', None, (('kern', (('latn', ('dflt',)),)),))\n"
+     "f.addLookupSubtable('kern', 'kern-1')\n"
+     "letters = [g.glyphname for g in f.glyphs() if 0 < g.unicode < 128 and chr(g.unicode).isalpha()]",
+     "f.autoKern('kern-1', 150, letters, letters)", "f.close()"},
+};
+
+/* Times are written one to a line, in nanoseconds, to the file named by
+ * the third argument */
+const char script_template[] = R"(import fontforge, gc, sys, time
+source, work, out = sys.argv[1:4]
+warmup, repeat = int(sys.argv[4]), int(sys.argv[5])
+ns = {"fontforge": fontforge, "sys": sys, "source": source, "work": work}
+steps = {}
+for name, code in (("prepare", PREPARE), ("setup", SETUP), ("run", RUN),
+                   ("teardown", TEARDOWN)):
+    steps[name] = compile(code, name, "exec")
+
+exec(steps["prepare"], ns)
+with open(out, "w") as times:
+    for i in range(warmup + repeat):
+        exec(steps["setup"], ns)
+        gc.collect()
+        start = time.perf_counter_ns()
+        exec(steps["run"], ns)
+        end = time.perf_counter_ns()
+        exec(steps["teardown"], ns)
+        if i >= warmup:
+            times.write("%d\n" % (end - start))
+)";
+
+struct Options {
+    std::string binary;
+    fs::path fonts;
+    fs::path workdir;
+    std::string output;
+    std::string filter;
+    std::string threads;
+    int warmup = 2;
+    int repeat = 10;
+};
+
+struct Result {
+    const Workload* workload;
+    bool skipped = false;
+    bool failed = false;
+    std::vector<double> ms;
+};
+
+/* A python string literal holding code. The code in the table above has no
+ * backslashes or triple quotes, so raw triple quotes do */
+std::string py_literal(const char* code) {
+    return std::string("r'''") + code + "'''";
+}
+
+void replace(std::string& s, const std::string& what, const std::string& with) {
+    size_t pos = s.find(what);
+    if (pos != std::string::npos)
+        s.replace(pos, what.size(), with);
+}
+
+bool write_script(const Workload& w, const fs::path& path) {
+    std::string script = script_template;
+    /* Last first, so no code put in is searched */
+    replace(script, "TEARDOWN", py_literal(w.teardown));
+    replace(script, "RUN", py_literal(w.run));
+    replace(script, "SETUP", py_literal(w.setup));
+    replace(script, "PREPARE", py_literal(w.prepare));
+    std::ofstream out(path);
+    out << script;
+    return static_cast<bool>(out);
+}
+
+/* Runs argv in workdir with its output going to log, returns its exit code */
+int run_process(const fs::path& workdir, const fs::path& log,
+                const std::vector<std::string>& argv_vec) {
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        fprintf(stderr, "fork failed\n");
+        return 1;
+    }
+
+    if (pid == 0) {
+        int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || chdir(workdir.c_str()) != 0)
+            _exit(127);
+        dup2(fd, 1);
+        dup2(fd, 2);
+        close(fd);
+
+        std::vector<char*> argv;
+        for (const auto& s : argv_vec)
+            argv.push_back(const_cast<char*>(s.c_str()));
+        argv.push_back(nullptr);
+
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+/* The p-th percentile of sorted samples, interpolating between neighbours */
+double percentile(const std::vector<double>& sorted, double p) {
+    double pos = (sorted.size() - 1) * p / 100;
+    size_t lo = static_cast<size_t>(pos);
+    if (lo + 1 >= sorted.size())
+        return sorted.back();
+    return sorted[lo] + (sorted[lo + 1] - sorted[lo]) * (pos - lo);
+}
+
+Result run_workload(const Options& opts, const Workload& w) {
+    Result res;
+    res.workload = &w;
+
+    fs::path dir = opts.workdir / w.name;
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    fs::path script = dir / "bench.py", times = dir / "times", log = dir / "log";
+    if (ec || !write_script(w, script)) {
+        fprintf(stderr, "%s: could not set up %s\n", w.name, dir.c_str());
+        res.failed = true;
+        return res;
+    }
+
+    fprintf(stderr, "%-16s", w.name);
+    fflush(stderr);
+    int ret = run_process(dir, log, {opts.binary, "-quiet", "-skippyfile",
+        "-skippyplug", "-lang=py", "-script", script.string(),
+        (opts.fonts / w.font).string(), dir.string(), times.string(),
+        std::to_string(opts.warmup), std::to_string(opts.repeat)});
+    if (ret == 77) {
+        fprintf(stderr, "skipped\n");
+        res.skipped = true;
+        return res;
+    }
+
+    std::ifstream in(times);
+    long long ns;
+    while (in >> ns)
+        res.ms.push_back(ns / 1e6);
+    if (ret != 0 || static_cast<int>(res.ms.size()) != opts.repeat) {
+        fprintf(stderr, "failed with exit code %d, see %s\n", ret, log.c_str());
+        res.failed = true;
+        return res;
+    }
+
+    std::sort(res.ms.begin(), res.ms.end());
+    fprintf(stderr, "%10.3f ms\n", percentile(res.ms, 50));
+    return res;
+}
+
+std::string report(const Options& opts, const std::vector<Result>& results) {
+    std::ostringstream out;
+    char buf[64];
+    auto num = [&](double v) {
+        snprintf(buf, sizeof(buf), "%.3f", v);
+        return std::string(buf);
+    };
+
+    out << "{\n  \"unit\": \"ms\",\n  \"warmup\": " << opts.warmup
+        << ",\n  \"repeat\": " << opts.repeat << ",\n  \"threads\": \""
+        << (opts.threads.empty() ? "default" : opts.threads)
+        << "\",\n  \"workloads\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << r.workload->name
+            << "\", \"font\": \"" << r.workload->font << "\", ";
+        if (r.skipped || r.failed) {
+            out << "\"status\": \"" << (r.skipped ? "skipped" : "failed")
+                << "\"}";
+            continue;
+        }
+        double sum = 0;
+        for (double v : r.ms)
+            sum += v;
+        out << "\"status\": \"ok\",\n     \"min\": " << num(r.ms.front())
+            << ", \"median\": " << num(percentile(r.ms, 50))
+            << ", \"p90\": " << num(percentile(r.ms, 90))
+            << ", \"p99\": " << num(percentile(r.ms, 99))
+            << ", \"max\": " << num(r.ms.back())
+            << ", \"mean\": " << num(sum / r.ms.size()) << ",\n     \"samples\": [";
+        for (size_t j = 0; j < r.ms.size(); ++j)
+            out << (j ? ", " : "") << num(r.ms[j]);
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+
+    try {
+        cxxopts::Options options("benchdriver",
+                                 "Benchmark driver for FontForge");
+
+        options.add_options()
+            ("b,binary", "The path to the fontforge executable",
+             cxxopts::value<std::string>())
+            ("f,fonts", "The directory holding the test fonts",
+             cxxopts::value<std::string>())
+            ("w,workdir", "A scratch directory for the workloads",
+             cxxopts::value<std::string>()->default_value("bench"))
+            ("o,output", "Where to write the JSON report (default stdout)",
+             cxxopts::value<std::string>())
+            ("k,filter", "Only run workloads whose names contain this",
+             cxxopts::value<std::string>())
+            ("t,threads", "Set FONTFORGE_THREADS for the workloads",
+             cxxopts::value<std::string>())
+            ("warmup", "Unmeasured runs of each workload",
+             cxxopts::value<int>()->default_value("2"))
+            ("repeat", "Measured runs of each workload",
+             cxxopts::value<int>()->default_value("10"))
+            ("l,list", "List the workloads")
+            ("h,help", "Print usage");
+
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help")) {
+            printf("%s\n", options.help().c_str());
+            return 0;
+        }
+        if (result.count("list")) {
+            for (const auto& w : workloads)
+                printf("%-16s %s\n", w.name, w.font);
+            return 0;
+        }
+
+        if (result.count("binary"))
+            opts.binary = result["binary"].as<std::string>();
+        if (result.count("fonts"))
+            opts.fonts = result["fonts"].as<std::string>();
+        opts.workdir = result["workdir"].as<std::string>();
+        if (result.count("output"))
+            opts.output = result["output"].as<std::string>();
+        if (result.count("filter"))
+            opts.filter = result["filter"].as<std::string>();
+        if (result.count("threads"))
+            opts.threads = result["threads"].as<std::string>();
+        opts.warmup = result["warmup"].as<int>();
+        opts.repeat = result["repeat"].as<int>();
+    } catch (const cxxopts::exceptions::exception& e) {
+        fprintf(stderr, "Error parsing options: %s\n", e.what());
+        return 1;
+    }
+
+    if (opts.binary.empty() || opts.fonts.empty()) {
+        fprintf(stderr, "missing one or more required arguments\n");
+        return 1;
+    }
+    if (opts.warmup < 0 || opts.repeat < 1) {
+        fprintf(stderr, "there must be at least one measured run\n");
+        return 1;
+    }
+
+    opts.fonts = fs::absolute(opts.fonts);
+    opts.workdir = fs::absolute(opts.workdir);
+    if (opts.binary.find('/') != std::string::npos)
+        opts.binary = fs::absolute(opts.binary).string();
+    if (!opts.threads.empty())
+        setenv("FONTFORGE_THREADS", opts.threads.c_str(), 1);
+    else if (const char* env = getenv("FONTFORGE_THREADS"))
+        opts.threads = env;
+    /* Tracing or a script server would change what is measured */
+    unsetenv("FONTFORGE_TRACE");
+    unsetenv("FONTFORGE_SERVER");
+
+    std::vector<Result> results;
+    bool failed = false;
+    for (const auto& w : workloads) {
+        if (opts.filter.empty() ||
+            std::string(w.name).find(opts.filter) != std::string::npos) {
+            results.push_back(run_workload(opts, w));
+            failed |= results.back().failed;
+        }
+    }
+    if (results.empty()) {
+        fprintf(stderr, "no workload matches '%s'\n", opts.filter.c_str());
+        return 1;
+    }
+
+    std::string json = report(opts, results);
+    if (opts.output.empty()) {
+        fputs(json.c_str(), stdout);
+    } else {
+        std::ofstream out(opts.output);
+        out << json;
+        if (!out) {
+            fprintf(stderr, "could not write %s\n", opts.output.c_str());
+            return 1;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
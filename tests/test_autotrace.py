@@ -0,0 +1,41 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Renders some glyphs of Ambrosia as bitmaps, loads them back as background
+# images and traces them, checking that each glyph gets the right number of
+# contours, running in the right directions, within the em and without
+# too many points
+import sys, os, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+font = fontforge.open(sys.argv[1])
+names = ("o", "e", "B", "l", "period", "percent")
+expected = {name: sorted(c.isClockwise() for c in font[name].foreground) for name in names}
+for name in names:
+    g = font[name]
+    bmp = os.path.join(tmp, name + ".bmp")
+    g.export(bmp, 200, 1)
+    for layer in range(0, g.layer_cnt):
+        g.layers[layer] = fontforge.layer()
+    g.importOutlines(bmp)
+    font.selection.select(("more",), name)
+
+font.autoTrace()
+
+em = font.ascent + font.descent
+for name in names:
+    g = font[name]
+    assert sorted(c.isClockwise() for c in g.foreground) == expected[name], name
+    for c in g.foreground:
+        assert c.closed and not c.is_quadratic, name
+    # The image is scaled to fill the em, so the outlines must stay inside it
+    xmin, ymin, xmax, ymax = g.boundingBox()
+    assert xmin >= -em/200 and ymin >= -font.descent - em/200, name
+    assert ymax <= font.ascent + em/200, name
+    assert len(g.foreground) and sum(len(c) for c in g.foreground) < 200, name
+
+# A glyph with no background image is left alone
+font["a"].foreground = fontforge.layer()
+font.selection.select("a")
+font.autoTrace()
+assert len(font["a"].foreground) == 0
+font.close()
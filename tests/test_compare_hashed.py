@@ -0,0 +1,61 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Glyphs which hash the same as their match in the other font are skipped by
+# compareFonts and the rest are compared in parallel. Check that a font
+# compares clean against a copy of itself, and that changes made to a few
+# glyphs of the copy are each reported once, in glyph order
+import os, shutil, sys, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+copy = os.path.join(tmp, "copy.sfd")
+shutil.copyfile(sys.argv[1], copy)
+flags = ("outlines", "hints", "gpos", "gsub")
+
+font = fontforge.open(sys.argv[1])
+other = fontforge.open(copy)
+diffs = os.path.join(tmp, "diffs.txt")
+assert font.compareFonts(other, diffs, flags) == 0
+assert open(diffs).read() == ""
+
+layer = other["A"].foreground
+layer[0][0].x += 5
+other["A"].foreground = layer
+other["b"].width += 10
+other["o"].foreground = fontforge.layer()
+lig = [g for g in other.glyphs() if g.getPosSub("*")][0]
+sub = lig.getPosSub("*")[0]
+lig.addPosSub(sub[0], "A B")
+assert font.compareFonts(other, diffs, flags) == 1
+lines = open(diffs, encoding="utf-8").read().splitlines()
+assert lines[:5] == ["Outline Glyphs", " Glyph Differences",
+                     "  Spline mismatch in glyph “A”",
+                     "  Glyph “b” has advance width %d in %s but %d in %s" %
+                         (font["b"].width, font.path, other["b"].width, other.path),
+                     "  Different number of contours in glyph “o”"], lines
+assert lines[5] == "Glyph Substitution", lines
+assert any("“%s”" % lig.glyphname in l for l in lines[6:]), lines
+
+# add-outlines puts the other font's outlines in the background of the glyphs
+# which differ
+font.compareFonts(other, diffs, flags + ("add-outlines",))
+assert len(font["A"].background) == len(other["A"].foreground)
+assert len(font["o"].background) == 0 and len(font["B"].background) == 0
+other.close()
+font.close()
+
+# Kerning partners are matched to the other font's glyphs by unicode before
+# name, but reported by name. A partner renamed in the other font matches the
+# same glyph there, yet it must still be reported
+def kernfont(partner):
+    f = fontforge.font()
+    f.createChar(0x61, "a").width = 500
+    f.createChar(0x78, partner).width = 500
+    f.addLookup("kern", "gpos_pair", None, (("kern", (("latn", ("dflt",)),)),))
+    f.addLookupSubtable("kern", "kern-1")
+    f["a"].addPosSub("kern-1", partner, -50)
+    return f
+font = kernfont("x")
+other = kernfont("ex")
+assert font.compareFonts(other, diffs, ("gpos",)) == 1
+lines = open(diffs, encoding="utf-8").read().splitlines()
+assert any("“a” and x" in l for l in lines) and any("“a” and ex" in l for l in lines), lines
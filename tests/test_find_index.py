@@ -0,0 +1,78 @@
+# Find, Replace and Replace with Reference first rule out glyphs whose
+# contours have the wrong numbers of points (or which refer to the wrong
+# glyphs), then match the rest on several threads. Check that what they find
+# is still found however it was moved, flipped or reversed, and that glyphs
+# which only look alike in part are not
+import fontforge
+
+def contour(pts, closed=True):
+    c = fontforge.contour()
+    for p in pts:
+        c += fontforge.point(*p)
+    c.closed = closed
+    return c
+
+def square(x, y, size=100):
+    return contour(((x, y), (x, y+size), (x+size, y+size), (x+size, y)))
+
+tri = contour(((0, 0), (50, 80), (100, 0)))
+
+font = fontforge.font()
+font.encoding = "UnicodeFull"
+def glyph(name, *contours):
+    g = font.createChar(-1, name)
+    l = fontforge.layer()
+    for c in contours:
+        l += c
+    g.foreground = l
+    g.width = 500
+    return g
+
+glyph("sq", square(0, 0))
+glyph("moved", square(300, 200))
+glyph("twice", square(0, 0), square(200, 0))
+glyph("reversed", square(40, 40).reverseDirection())
+glyph("flipped", square(0, 0).transform((-1, 0, 0, 1, 0, 0)))
+glyph("five", contour(((0, 0), (0, 100), (50, 100), (100, 100), (100, 0))))
+glyph("open", contour(((0, 0), (0, 100), (100, 100), (100, 0)), False))
+glyph("bigger", square(0, 0, 200))
+glyph("tri", tri)
+glyph("both", square(0, 0), tri.dup().transform((1, 0, 0, 1, 300, 0)))
+font.createChar(-1, "hole")
+font.removeGlyph("hole")
+glyph("last", square(10, 10))
+
+def found(pattern, flags=()):
+    return sorted(g.glyphname for g in font.find(pattern, 0.5, flags))
+
+assert found(square(0, 0)) == ["both", "last", "moved", "sq", "twice"]
+# A square flipped is the same square drawn the other way round
+assert found(square(0, 0), ("reverse",)) == \
+    ["both", "flipped", "last", "moved", "reversed", "sq", "twice"]
+assert found(square(0, 0).transform((-1, 0, 0, 1, 0, 0)), ("flips",)) == \
+    ["both", "flipped", "last", "moved", "reversed", "sq", "twice"]
+assert found(square(0, 0), ("reverse", "scale")) == \
+    ["bigger", "both", "flipped", "last", "moved", "reversed", "sq", "twice"]
+
+# Several contours must each be there
+pattern = fontforge.layer()
+pattern += square(0, 0)
+pattern += tri.dup().transform((1, 0, 0, 1, 300, 0))
+assert found(pattern) == ["both"]
+
+# A single open contour may be part of any contour
+assert "five" in found(contour(((0, 0), (0, 100)), False))
+
+# Replace each glyph found elsewhere with a reference to it
+font.selection.select("sq", "tri")
+font.replaceWithReference()
+assert sorted(r[0] for r in font["both"].references) == ["sq", "tri"]
+assert len(font["both"].foreground) == 0
+assert [r[0] for r in font["twice"].references] == ["sq", "sq"]
+assert [r[0] for r in font["last"].references] == ["sq"]
+for name in ("reversed", "five", "bigger", "open"):
+    assert not font[name].references, name
+
+assert font.replaceAll(font["five"].foreground[0], square(0, 0, 50)) == 1
+assert font["five"].boundingBox() == (0, 0, 50, 50)
+assert font["bigger"].boundingBox() == (0, 0, 200, 200)
@@ -0,0 +1,61 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Generating several files at once compiles each flavour of sfnt only once,
+# so a woff file wraps exactly the sfnt written to the ttf file. Check that,
+# and that the files match ones generated one at a time
+import os, struct, sys, tempfile, zlib, fontforge
+
+tmp = tempfile.mkdtemp()
+
+def sfnt_tables(path):
+    data = open(path, "rb").read()
+    ret = {}
+    for i in range(struct.unpack(">H", data[4:6])[0]):
+        tag, _, offset, length = struct.unpack(">4sLLL", data[12+16*i:28+16*i])
+        ret[tag] = data[offset:offset+length]
+    return ret
+
+def woff_tables(path):
+    data = open(path, "rb").read()
+    ret = {}
+    for i in range(struct.unpack(">H", data[12:14])[0]):
+        tag, offset, comp, orig, _ = struct.unpack(">4sLLLL", data[44+20*i:64+20*i])
+        ret[tag] = data[offset:offset+comp]
+        if comp < orig:
+            ret[tag] = zlib.decompress(ret[tag])
+    return ret
+
+def stable(tables):
+    # Without the times and checksum adjustment, which change between runs
+    tables = {t: d for t, d in tables.items() if t != b"FFTM"}
+    tables[b"head"] = tables[b"head"][:8] + tables[b"head"][12:20] + tables[b"head"][36:]
+    return tables
+
+font = fontforge.open(sys.argv[1])
+names = [g.glyphname for g in font.glyphs()]
+# The first generate hints the glyphs, after which they stay the same
+font.generate(os.path.join(tmp, "hinted.otf"), flags=("opentype",))
+targets = [os.path.join(tmp, "all." + ext) for ext in ("otf", "ttf", "woff", "svg")]
+font.generate(targets, flags=("opentype",))
+for ext in ("otf", "ttf", "woff", "svg"):
+    font.generate(os.path.join(tmp, "one." + ext), flags=("opentype",))
+
+ttf = sfnt_tables(os.path.join(tmp, "all.ttf"))
+assert woff_tables(os.path.join(tmp, "all.woff")) == ttf
+assert stable(ttf) == stable(sfnt_tables(os.path.join(tmp, "one.ttf")))
+assert stable(sfnt_tables(os.path.join(tmp, "all.otf"))) == stable(sfnt_tables(os.path.join(tmp, "one.otf")))
+assert open(os.path.join(tmp, "all.svg")).read() == open(os.path.join(tmp, "one.svg")).read()
+assert b"CFF " in sfnt_tables(os.path.join(tmp, "all.otf")) and b"glyf" in ttf
+
+# Glyphs renamed for the generate are named as they were afterwards
+font.generate([os.path.join(tmp, "renamed." + ext) for ext in ("ttf", "woff")],
+              namelist="AGL with PUA")
+assert [g.glyphname for g in font.glyphs()] == names
+
+try:
+    font.generate([os.path.join(tmp, "ok.ttf"), os.path.join(tmp, "missing", "x.otf")])
+except EnvironmentError:
+    pass
+else:
+    assert False, "generating into a missing directory succeeded"
+font.close()
@@ -0,0 +1,74 @@
+# Class kerning is written as however many PairPos subtables make GPOS
+# smallest, each small enough for its offsets. Check that a dense matrix too
+# big for one subtable still kerns every pair when read back, and that a
+# sparse matrix is written in much less space than a full one would take
+import os, random, struct, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+random.seed(7)
+
+def table_length(path, tag):
+    data = open(path, "rb").read()
+    for i in range(struct.unpack(">H", data[4:6])[0]):
+        t, _, _, length = struct.unpack(">4sLLL", data[12+16*i:28+16*i])
+        if t == tag:
+            return length
+    return 0
+
+def pairs(font):
+    ret = {}
+    for lookup in font.gpos_lookups:
+        for sub in font.getLookupSubtables(lookup):
+            if font.isKerningClass(sub):
+                firsts, seconds, offsets = font.getKerningClass(sub)
+                for i, first in enumerate(firsts):
+                    for j, second in enumerate(seconds):
+                        off = offsets[i*len(seconds) + j]
+                        for l in (first or ()) if off else ():
+                            for r in second or ():
+                                ret.setdefault((l, r), off)
+            else:
+                for g in font.glyphs():
+                    for p in g.getPosSub(sub):
+                        if p[1] == "Pair" and p[5] != 0:
+                            ret.setdefault((g.glyphname, p[2]), p[5])
+    return ret
+
+def kerned(classes, values):
+    font = fontforge.font()
+    font.encoding = "UnicodeFull"
+    for i in range(classes*2):
+        g = font.createChar(0xe000 + i, "g%d" % i)
+        pen = g.glyphPen()
+        pen.moveTo((0, 0)); pen.lineTo((0, 100)); pen.lineTo((100, 0)); pen.closePath()
+        pen = None
+        g.width = 500
+    font.addLookup("kern", "gpos_pair", 0, (("kern", (("latn", ("dflt",)),)),))
+    names = [("g%d" % (2*i), "g%d" % (2*i+1)) for i in range(classes)]
+    offsets, expected = [], {}
+    for i in range(classes+1):
+        for j in range(classes+1):
+            off = values(i, j) if i and j else 0
+            offsets.append(off)
+            if off:
+                for l in names[i-1]:
+                    for r in names[j-1]:
+                        expected[(l, r)] = off
+    font.addKerningClass("kern", "kern-1", [None] + names, [None] + names, offsets)
+    path = os.path.join(tmp, "k%d.ttf" % classes)
+    font.generate(path)
+    font.close()
+    return path, expected
+
+# 201x201 two byte values is more than 64k
+path, expected = kerned(200, lambda i, j: random.choice((0, -10, -20, 15)))
+font = fontforge.open(path)
+assert pairs(font) == expected
+font.close()
+
+# Each class kerns with only one other
+path, expected = kerned(100, lambda i, j: -30 if j == (i*7) % 100 + 1 else 0)
+font = fontforge.open(path)
+assert pairs(font) == expected
+font.close()
+assert table_length(path, b"GPOS") < 101*101*2 / 4
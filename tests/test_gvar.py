@@ -0,0 +1,162 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Builds an Apple distortable font out of Ambrosia with two instances whose
+# outlines are known functions of the default outlines, generates it and
+# reads it back. The gvar output drops deltas which can be interpolated
+# (IUP), so this checks that every point still ends up where it should, and
+# that regenerating from the cached gvar data matches a fresh generation
+import sys, os, math, struct, tempfile, fontforge
+
+def wide(x, y):
+    return round(x*1.1 + y*0.05), y
+
+def wavy(x, y):
+    return x + round(6*math.sin(y/150)), round(y*0.95 + 4*math.cos(x/200))
+
+def transform_font(body, fn, name, wscale):
+    out, inss = [], False
+    for line in body.split("\n"):
+        if line.startswith("FontName:"):
+            line = "FontName: " + name
+        elif line.startswith("Width:"):
+            line = "Width: %d" % round(int(line.split()[1]) * wscale)
+        elif line.startswith("SplineSet"):
+            inss = True
+        elif line.startswith("EndSplineSet"):
+            inss = False
+        elif line.startswith("Refer:"):
+            t = line.split()
+            t[8], t[9] = (str(v) for v in fn(float(t[8]), float(t[9])))
+            line = " ".join(t)
+        elif inss:
+            t = line.split()
+            if len(t) > 2 and t[-2] in ("m", "l", "c"):
+                nums = [float(v) for v in t[:-2]]
+                for i in range(0, len(nums), 2):
+                    nums[i], nums[i+1] = fn(nums[i], nums[i+1])
+                line = " ".join("%g" % v for v in nums) + " " + " ".join(t[-2:])
+        out.append(line)
+    return "\n".join(out)
+
+def font_points(sfd):
+    # {fontname: {glyph: (width, [(ttfindex, x, y)])}} for each font in an sfd
+    fonts, font, glyph = {}, None, None
+    for line in open(sfd):
+        t = line.split()
+        if line.startswith("FontName:"):
+            font = fonts[t[1]] = {}
+        elif line.startswith("StartChar:"):
+            glyph = [0, []]
+            font[t[1]] = glyph
+        elif line.startswith("Width:"):
+            glyph[0] = int(t[1])
+        elif len(t) > 2 and t[-2] in ("m", "l", "c") and glyph is not None:
+            idx = int(t[-1].split(",")[1])
+            if idx >= 0:
+                glyph[1].append((idx, float(t[-4]), float(t[-3])))
+    return fonts
+
+def gvar_table(path):
+    data = open(path, "rb").read()
+    for i in range(struct.unpack(">H", data[4:6])[0]):
+        tag, _, off, length = struct.unpack(">4sLLL", data[12+16*i:28+16*i])
+        if tag == b"gvar":
+            return data[off:off+length]
+    return None
+
+tmp = tempfile.mkdtemp()
+src = os.path.join(tmp, "default.sfd")
+mmsfd = os.path.join(tmp, "gx.sfd")
+
+font = fontforge.open(sys.argv[1])
+font.is_quadratic = True
+for g in font.glyphs():
+    if g.references and g.foreground:
+        g.unlinkRef()
+    g.round()
+# In the wide instance the middle point of the bottom edge moves by 1 while
+# its neighbours move by 0 and 1, so interpolating it gives exactly half a
+# unit, which the reader rounds to 0. It must not be left out
+half = font.createChar(-1, "halfunit")
+pen = half.glyphPen()
+pen.moveTo((0, 0))
+pen.lineTo((0, 100))
+pen.lineTo((10, 100))
+pen.lineTo((10, 0))
+pen.lineTo((5, 0))
+pen.closePath()
+pen = None
+half.width = 200
+font.save(src)
+font.close()
+
+text = open(src).read()
+body = text[text.index("FontName:"):text.index("EndSplineFont")+len("EndSplineFont")]
+with open(mmsfd, "w") as f:
+    f.write("SplineFontDB: 3.2\nMMCounts: 2 1 1 0\nMMAxis: Weight\n"
+            "MMPositions: -1 1\nMMWeights: 0 0\n"
+            "MMAxisMap: 0 3 -1=>100 0=>400 1=>900\n")
+    f.write("BeginMMFonts: 3 %d\n" % body.count("\nStartChar:"))
+    f.write(transform_font(body, wide, "GXWide", 1.1) + "\n")
+    f.write(transform_font(body, wavy, "GXWavy", 1.0) + "\n")
+    f.write(body + "\nEndMMFonts\n")
+
+# Generate, then read the variations back in
+mm = fontforge.open(mmsfd)
+ttf = os.path.join(tmp, "gx.ttf")
+mm.generate(ttf, flags=("apple",))
+first = gvar_table(ttf)
+assert first is not None
+
+# The instances of a font read from gvar stay as deltas until something
+# needs them; writing those straight back out must match writing the glyphs
+# once they have been built
+back = fontforge.open(ttf)
+regen = os.path.join(tmp, "regen.ttf")
+back.generate(regen, flags=("apple",))
+fromdeltas = gvar_table(regen)
+assert fromdeltas is not None
+rtsfd = os.path.join(tmp, "rt.sfd")
+back.save(rtsfd)
+back.generate(regen, flags=("apple",))
+assert gvar_table(regen) == fromdeltas
+back.close()
+fonts = font_points(rtsfd)
+assert len(fonts) == 3
+names = sorted(fonts, key=lambda n: float(n.split("_")[-1][:-2]) if "_" in n else 400)
+light, normal, bold = (fonts[n] for n in names)
+
+worst, count = 0, 0
+for inst, fn, wscale in ((light, wide, 1.1), (bold, wavy, 1.0)):
+    for name, (width, pts) in normal.items():
+        if "\nStartChar: %s\n" % name not in body:
+            continue        # .notdef and friends added on output
+        iwidth, ipts = inst[name]
+        assert iwidth == round(width*wscale), (name, width, iwidth)
+        assert [p[0] for p in pts] == [p[0] for p in ipts], name
+        for (_, x, y), (_, ix, iy) in zip(pts, ipts):
+            ex, ey = fn(x, y)
+            if name == "halfunit":
+                assert (ix, iy) == (ex, ey), (x, y, ix, iy)
+            worst = max(worst, abs(ix-ex), abs(iy-ey))
+            count += 1
+print("%d points, worst deviation %g" % (count, worst))
+assert count > 5000
+assert worst <= 1
+
+# A second generation reuses the cached glyph data and must match
+mm.generate(ttf, flags=("apple",))
+assert gvar_table(ttf) == first
+
+# Changing a glyph must not pick up its stale cached data
+mm["a"].transform((1, 0, 0, 1, 7, 3))
+mm.generate(ttf, flags=("apple",))
+cached = gvar_table(ttf)
+assert cached != first
+changed = os.path.join(tmp, "changed.sfd")
+mm.save(changed)
+mm.close()
+fresh = fontforge.open(changed)
+fresh.generate(ttf, flags=("apple",))
+assert gvar_table(ttf) == cached
+fresh.close()
@@ -0,0 +1,73 @@
+# Kerning classes find glyphs through a map of glyph ids which is built when
+# first wanted. Check that the classes written to GPOS follow changes made
+# after the map was built: renamed glyphs, glyphs added which the classes
+# already named, and classes replaced by alterKerningClass
+import os, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+
+def glyph(font, name, width=500):
+    g = font.createChar(-1, name)
+    pen = g.glyphPen()
+    pen.moveTo((50, 0)); pen.lineTo((50, 500)); pen.lineTo((400, 500)); pen.lineTo((400, 0))
+    pen.closePath()
+    g.width = width
+    return g
+
+def pairs(font):
+    # The kerning each pair of glyphs gets, from classes or from glyph pairs
+    # (which a sparse class may be written as)
+    ret = {}
+    for lookup in font.gpos_lookups:
+        for sub in font.getLookupSubtables(lookup):
+            if not font.isKerningClass(sub):
+                for g in font.glyphs():
+                    for p in g.getPosSub(sub):
+                        if p[1] == "Pair" and p[5] != 0:
+                            ret[(g.glyphname, p[2])] = p[5]
+                continue
+            firsts, seconds, offsets = font.getKerningClass(sub)
+            for i, first in enumerate(firsts):
+                for j, second in enumerate(seconds):
+                    if offsets[i*len(seconds) + j] != 0:
+                        for l in first or ():
+                            for r in second or ():
+                                ret[(l, r)] = offsets[i*len(seconds) + j]
+    return ret
+
+def generated(font, name):
+    path = os.path.join(tmp, name + ".ttf")
+    font.generate(path)
+    f = fontforge.open(path)
+    ret = pairs(f)
+    f.close()
+    return ret
+
+font = fontforge.font()
+font.encoding = "UnicodeFull"
+for n in ("A", "T", "V", "a", "o"):
+    glyph(font, n)
+font.addLookup("kern", "gpos_pair", 0, (("kern", (("latn", ("dflt",)),)),))
+font.addKerningClass("kern", "kern-1", (None, ("A",), ("T", "V")),
+                     (None, ("a", "o", "e"), ("V",)),
+                     (0, 0, 0,  0, 0, -80,  0, -60, 0))
+
+expected = {("A", "V"): -80, ("T", "a"): -60, ("T", "o"): -60,
+            ("V", "a"): -60, ("V", "o"): -60}
+assert generated(font, "first") == expected
+
+# "e" was named in a class before it existed
+glyph(font, "e")
+expected.update({("T", "e"): -60, ("V", "e"): -60})
+assert generated(font, "added") == expected
+
+# Renaming a glyph renames it in the classes too
+font["o"].glyphname = "o.alt"
+expected = {(l, "o.alt" if r == "o" else r): v for (l, r), v in expected.items()}
+assert generated(font, "renamed") == expected
+
+# New classes
+font.alterKerningClass("kern-1", (None, ("A", "V")), (None, ("V", "a")), (0, 0, 0, -30))
+assert generated(font, "altered") == {("A", "V"): -30, ("A", "a"): -30,
+                                     ("V", "V"): -30, ("V", "a"): -30}
+font.close()
@@ -0,0 +1,76 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Runs class based contextual lookups through font.printSample, reads the
+# glyphs that were printed back out of the pdf, and checks that editing the
+# font between prints is seen by the compiled glyph classes the lookups use
+import sys, os, re, zlib, shutil, tempfile, fontforge
+
+def printed_glyphs(pdf):
+    # The glyph names shown on the sample page, one string per line of text
+    data = open(pdf, "rb").read()
+    data = re.sub(rb"stream\r?\n(.*?)endstream",
+                  lambda m: zlib.decompressobj().decompress(m.group(1)), data, flags=re.S)
+    data = data.decode("latin-1")
+    objs = dict(re.findall(r"(\d+) 0 obj(.*?)endobj", data, re.S))
+    fonts = {}
+    for name, num in re.findall(r"/(F\d+-\d+) (\d+) 0 R", data):
+        enc = re.search(r"/Encoding (\d+) 0 R", objs[num]).group(1)
+        diffs = re.search(r"/Differences \[(.*?)\]", objs[enc], re.S).group(1).split()
+        code, names = int(diffs[0]), {}
+        for g in diffs[1:]:
+            names[code] = g[1:]
+            code += 1
+        fonts[name] = names
+    lines, font, y = [], None, None
+    for m in re.finditer(r"/(F\d+-\d+) [\d.]+ Tf|(-?[\d.]+) (-?[\d.]+) Td <([0-9a-f]+)> Tj", data):
+        if m.group(1):
+            font = fonts[m.group(1)]
+            continue
+        if y is None or float(m.group(3)) != 0:
+            lines.append([])
+        y = m.group(3)
+        lines[-1].append(font[int(m.group(4), 16)])
+    return [" ".join(l) for l in lines]
+
+def sample(font, text):
+    pdf = os.path.join(tmp, "sample.pdf")
+    font.printSample("fontsample", 24, text, pdf)
+    return printed_glyphs(pdf)
+
+tmp = tempfile.mkdtemp()
+fontforge.printSetup("pdf-file")
+font = fontforge.open(sys.argv[1])
+
+font.addLookup("alts", "gsub_single", None, ())
+font.addLookupSubtable("alts", "alts-1")
+for g in ("b", "x"):
+    font[g].addPosSub("alts-1", "c")
+font.addLookup("ctx", "gsub_contextchain", None,
+               (("calt", (("latn", ("dflt",)), ("DFLT", ("dflt",)))),))
+# Class 0 of the match classes is everything not in another match class
+font.addContextualSubtable("ctx", "ctx-1", "class", "1 | 0 @<alts> |",
+                           bclasses=(None, "a e o"), mclasses=(None, "b xx"))
+
+text = "ab ax yx"
+assert sample(font, text)[-1] == "a b space a c space y x", sample(font, text)
+
+# Printing twice reuses the compiled classes
+assert sample(font, text)[-1] == "a b space a c space y x"
+
+# Renaming x to a name listed in the match class takes it out of class 0
+font["x"].glyphname = "xx"
+after = sample(font, text)[-1]
+assert after == "a b space a xx space y xx", after
+saved = os.path.join(tmp, "renamed.sfd")
+font.save(saved)
+shutil.copy(saved, saved + ".copy.sfd")
+again = fontforge.open(saved + ".copy.sfd")
+assert sample(again, text)[-1] == after, (after, sample(again, text)[-1])
+again.close()
+
+# Replacing the contextual subtable puts xx back in class 0
+font.removeLookupSubtable("ctx-1")
+font.addContextualSubtable("ctx", "ctx-2", "class", "1 | 0 @<alts> |",
+                           bclasses=(None, "a e o"), mclasses=(None, "b"))
+assert sample(font, text)[-1] == "a b space a c space y xx"
+font.close()
@@ -0,0 +1,41 @@
+# font.memoryUsage() counts what each part of a font takes. Check that every
+# part is there, that it follows what is added to the font and what is taken
+# away again, and that closing and reopening the font gives the same counts
+import sys, fontforge
+
+font = fontforge.open(sys.argv[1])
+before = font.memoryUsage()
+assert sorted(before) == sorted(("glyphs", "splines", "points", "references",
+    "hints", "instructions", "undoes", "bitmaps", "images", "pst", "kerns",
+    "lookups", "ttf_tables", "persistent"))
+for name, (size, count) in before.items():
+    assert size >= 0 and count >= 0, name
+    assert size > 0 or count == 0, name
+assert before["glyphs"][1] >= sum(1 for g in font.glyphs())
+assert before["points"][1] > before["glyphs"][1]
+assert before["references"][1] > 0
+assert before["undoes"] == (0, 0)
+assert before["persistent"] == (0, 0)
+
+glyph = font["A"]
+glyph.preserveLayerAsUndo()
+glyph.transform((1, 0, 0, 1, 10, 0))
+font.persistent = {"notes": "x" * 10000}
+glyph.persistent = list(range(100))
+after = font.memoryUsage()
+assert after["undoes"][1] == 1 and after["undoes"][0] > 0
+assert after["persistent"][1] == 2 and after["persistent"][0] > 10000
+
+glyph.clear()
+font.persistent = None
+glyph.persistent = None
+cleared = font.memoryUsage()
+assert cleared["points"][1] < before["points"][1]
+assert cleared["points"][0] < before["points"][0]
+assert cleared["persistent"] == (0, 0)
+
+font.bitmapSizes = (12,)
+assert font.memoryUsage()["bitmaps"][1] > 0
+
+font.close()
+assert fontforge.open(sys.argv[1]).memoryUsage() == before
@@ -0,0 +1,47 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Checks that font.nltransform moves every on-curve point to exactly where
+# the expressions say, for an assortment of operators
+import sys, math, fontforge
+
+def clamp(v):
+    if math.isnan(v):
+        return 0
+    return 32767 if v >= 32768 else -32768 if v < -32768 else v
+
+cases = [
+    ("x+y/5", "y", lambda x, y: (x + y/5, y)),
+    ("-x", "-(y) + 3", lambda x, y: (-x, -y + 3)),
+    ("x*(1+0.0001*y)", "y+20*sin(x/50)",
+     lambda x, y: (x*(1 + 0.0001*y), y + 20*math.sin(x/50))),
+    ("x + 10*cos(y/100)^2", "atan2(y,x)*10 + y",
+     lambda x, y: (x + 10*math.cos(y/100)**2, math.atan2(y, x)*10 + y)),
+    ("abs(x) + floor(y/7) - ceil(x/9)", "sqrt(abs(y)) + y",
+     lambda x, y: (abs(x) + math.floor(y/7) - math.ceil(x/9),
+                   math.sqrt(abs(y)) + y)),
+    ("x>300 ? x+log(x) : x-10", "y<0 && x>0 ? y*2 : y",
+     lambda x, y: (x + math.log(x) if x > 300 else x - 10,
+                   y*2 if y < 0 and x > 0 else y)),
+    ("y>100 || x<50 ? x*2 : !x", "y == 0 ? 1 : y != 10 ? y : 11",
+     lambda x, y: (x*2 if y > 100 or x < 50 else float(x == 0),
+                   1 if y == 0 else y if y != 10 else 11)),
+]
+
+for xe, ye, ref in cases:
+    font = fontforge.open(sys.argv[1])
+    before = {g.glyphname: [[(p.x, p.y) for p in c if p.on_curve]
+                            for c in g.foreground]
+              for g in font.glyphs()}
+    font.selection.all()
+    font.nltransform(xe, ye)
+    for g in font.glyphs():
+        after = [[(p.x, p.y) for p in c if p.on_curve] for c in g.foreground]
+        assert len(after) == len(before[g.glyphname])
+        for old, new in zip(before[g.glyphname], after):
+            assert len(old) == len(new), (xe, ye, g.glyphname)
+            for (x, y), (nx, ny) in zip(old, new):
+                ex, ey = (clamp(v) for v in ref(x, y))
+                if abs(nx - ex) > 1e-3 or abs(ny - ey) > 1e-3:
+                    raise ValueError("%s | %s: (%g,%g) in %s went to (%g,%g), expected (%g,%g)"
+                                     % (xe, ye, x, y, g.glyphname, nx, ny, ex, ey))
+    font.close()
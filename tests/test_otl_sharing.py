@@ -0,0 +1,137 @@
+# Coverage and class definition tables are collected while OpenType layout
+# tables are written and identical ones are shared. Check that subtables of a
+# lookup (and the parts of GDEF and MATH) point at one copy, that a lookup too
+# big for all its subtables to reach one copy still works, and that all of it
+# reads back as it was
+import os, struct, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+
+def table(path, tag):
+    data = open(path, "rb").read()
+    for i in range(struct.unpack(">H", data[4:6])[0]):
+        t, _, off, length = struct.unpack(">4sLLL", data[12+16*i:28+16*i])
+        if t == tag:
+            return data[off:off+length]
+    return None
+
+def u16(data, pos):
+    return struct.unpack(">H", data[pos:pos+2])[0]
+
+def subtables(data, extension):
+    # The absolute positions of each lookup's subtables
+    ret = []
+    ll = u16(data, 8)
+    for i in range(u16(data, ll)):
+        lookup = ll + u16(data, ll+2+2*i)
+        subs = [lookup + u16(data, lookup+6+2*j) for j in range(u16(data, lookup+4))]
+        if u16(data, lookup) == extension:
+            subs = [s + struct.unpack(">L", data[s+4:s+8])[0] for s in subs]
+        ret.append(subs)
+    return ret
+
+def square(g):
+    pen = g.glyphPen()
+    pen.moveTo((50, 0)); pen.lineTo((50, 500)); pen.lineTo((400, 500)); pen.lineTo((400, 0))
+    pen.closePath()
+    pen = None
+
+font = fontforge.font()
+font.encoding = "UnicodeFull"
+for n in ("a", "b", "c", "d", "e", "f_i", "grave", "acute", "uni0302", "integral"):
+    g = font.createChar(fontforge.unicodeFromName(n), n)
+    square(g)
+    g.width = 500
+    if n in ("grave", "acute", "uni0302"):
+        g.glyphclass = "mark"
+
+# Each subtable of a mark to base lookup wants the same marks
+font.addLookup("mark", "gpos_mark2base", 0, (("mark", (("latn", ("dflt",)),)),))
+for i, base in enumerate(("a", "b", "c")):
+    font.addLookupSubtable("mark", "mark-%d" % i)
+    font.addAnchorClass("mark-%d" % i, "top%d" % i)
+    for m in ("grave", "acute"):
+        font[m].addAnchorPoint("top%d" % i, "mark", 250, 450 + i)
+    font[base].addAnchorPoint("top%d" % i, "base", 250, 700 + i)
+
+# And a chaining lookup with the same glyphs before, in and after the match
+font.addLookup("single", "gsub_single", 0, ())
+font.addLookupSubtable("single", "single-1")
+font["a"].addPosSub("single-1", "b")
+font["d"].addPosSub("single-1", "e")
+font.addLookup("chain", "gsub_contextchain", 0, (("calt", (("latn", ("dflt",)),)),))
+font.addContextualSubtable("chain", "chain-1", "coverage", "[a d] | [a d] @<single> | [a d]")
+
+font.markSets = (("sets", "grave acute"), ("again", "grave acute"))
+font["f_i"].lcarets = (250,)
+for n in ("a", "b", "c"):
+    font[n].italicCorrection = 20
+    font[n].topaccent = 250
+font["integral"].isExtendedShape = True
+font["integral"].verticalVariants = "integral"
+
+path = os.path.join(tmp, "shared.otf")
+font.generate(path)
+font.close()
+
+gpos = table(path, b"GPOS")
+marks = subtables(gpos, 9)[0]
+assert len(marks) == 3
+assert len({s + u16(gpos, s+2) for s in marks}) == 1
+
+gsub = table(path, b"GSUB")
+chain = [subs for subs in subtables(gsub, 7) if u16(gsub, subs[0]) == 3][0][0]
+# ChainContextSubst format 3, one coverage in each of backtrack, input and lookahead
+assert u16(gsub, chain+2) == 1 and u16(gsub, chain+6) == 1 and u16(gsub, chain+10) == 1
+assert chain + u16(gsub, chain+4) == chain + u16(gsub, chain+8) == chain + u16(gsub, chain+12)
+
+gdef = table(path, b"GDEF")
+sets = u16(gdef, 12)
+assert struct.unpack(">LL", gdef[sets+4:sets+12])[0] == struct.unpack(">LL", gdef[sets+4:sets+12])[1]
+
+math = table(path, b"MATH")
+info = u16(math, 6)
+italic, accent = info + u16(math, info), info + u16(math, info+2)
+assert italic + u16(math, italic) == accent + u16(math, accent)
+
+font = fontforge.open(path)
+assert sorted(p[1:] for p in font["grave"].anchorPoints) == [("mark", 250, 450 + i) for i in range(3)]
+assert [p[1:] for p in font["c"].anchorPoints] == [("base", 250, 702)]
+assert font["a"].getPosSub("*")[0][1:] == ("Substitution", "b")
+assert [s[1] for s in font.markSets] == [("grave", "acute")] * 2
+assert font["f_i"].lcarets == (250,)
+assert font["b"].italicCorrection == 20 and font["b"].topaccent == 250
+assert font["integral"].isExtendedShape and not font["a"].isExtendedShape
+font.close()
+
+# Five subtables of 16k bytes can't all reach a coverage table after the
+# last of them, so the first four share one in front of the fifth
+font = fontforge.font()
+font.encoding = "UnicodeFull"
+count = 8000
+for i in range(count):
+    font.createChar(0xf0000 + i, "g%d" % i).width = 500
+font.addLookup("big", "gsub_single", 0, (("ss01", (("latn", ("dflt",)),)),))
+font.addLookupSubtable("big", "big-0")
+for k in range(1, 5):
+    font.addLookupSubtable("big", "big-%d" % k, "big-%d" % (k-1))
+for i in range(count):
+    for k in range(5):
+        font["g%d" % i].addPosSub("big-%d" % k, "g%d" % ((i*(k+3) + 1) % count))
+path = os.path.join(tmp, "big.ttf")
+font.generate(path)
+font.close()
+
+gsub = table(path, b"GSUB")
+subs = [s for lookup in subtables(gsub, 7) for s in lookup]
+assert len(subs) == 5
+coverages = {s + u16(gsub, s+2) for s in subs}
+assert len(coverages) == 2
+for c in coverages:
+    assert u16(gsub, c) in (1, 2)
+
+font = fontforge.open(path)
+for i in (0, 1, 4321, count-1):
+    got = sorted(p[2] for p in font["g%d" % i].getPosSub("*"))
+    assert got == sorted("g%d" % ((i*(k+3) + 1) % count) for k in range(5)), (i, got)
+font.close()
@@ -0,0 +1,72 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Prints Ambrosia to PDF, checking that the streams are compressed, that
+# the font is embedded as a subset of the glyphs printed, and that the
+# same glyphs always give the same subset name
+import sys, os, re, zlib, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+fontforge.printSetup("pdf-file")
+
+def objects(data):
+    ret = {}
+    for m in re.finditer(rb"(\d+) 0 obj", data):
+        ret.setdefault(int(m.group(1)), m.end())
+    return ret
+
+def check(path):
+    data = open(path, "rb").read()
+    objs = objects(data)
+    # Every stream is compressed and its length is right
+    streams = 0
+    for m in re.finditer(rb"<<([^>]*?)>>\s*stream\r?\n", data):
+        length = re.search(rb"/Length (\d+)( 0 R)?", m.group(1))
+        n = int(length.group(1))
+        if length.group(2):
+            n = int(data[objs[n]:data.index(b"endobj", objs[n])])
+        assert b"/FlateDecode" in m.group(1), m.group(1)
+        zlib.decompress(data[m.end():m.end() + n])
+        assert data[m.end() + n:].lstrip().startswith(b"endstream")
+        streams += 1
+    assert streams > 0
+    # The cross reference table points at the objects
+    xref = int(re.search(rb"startxref\s+(\d+)", data).group(1))
+    assert data[xref:].startswith(b"xref")
+    return data
+
+font = fontforge.open(sys.argv[1])
+text = "The quick brown fox jumps over the lazy dog"
+
+sample = os.path.join(tmp, "sample.pdf")
+font.printSample("fontsample", 24, text, sample)
+data = check(sample)
+names = re.findall(rb"/BaseFont /([A-Z]{6})\+Ambrosia\b", data)
+assert names, "no subset font"
+assert b"/FontFile3" in data and b"/Subtype /Type1C" in data
+
+names = fontforge.fontsInFile(sample)
+assert len(names) == 1 and re.match(r"^[A-Z]{6}\+Ambrosia$", names[0]), names
+sub = fontforge.open("%s(%s)" % (sample, names[0]))
+glyphs = [g.glyphname for g in sub.glyphs() if g.glyphname != ".notdef"]
+expected = {font[ord(c)].glyphname for c in text}
+assert set(glyphs) == expected, glyphs
+sub.close()
+
+# The same text gives the same tag, different text a different one
+again = os.path.join(tmp, "again.pdf")
+font.printSample("fontsample", 24, text, again)
+assert fontforge.fontsInFile(again) == fontforge.fontsInFile(sample)
+other = os.path.join(tmp, "other.pdf")
+font.printSample("fontsample", 24, "Sphinx of black quartz", other)
+assert fontforge.fontsInFile(other) != fontforge.fontsInFile(sample)
+
+# The other kinds of output
+font.selection.select("A", "b")
+for kind in ("fontdisplay", "chars", "multisize"):
+    path = os.path.join(tmp, kind + ".pdf")
+    font.printSample(kind, 24, text, path)
+    check(path)
+
+# A line of text doesn't carry the rest of the font with it
+assert os.path.getsize(sample) < os.path.getsize(os.path.join(tmp, "fontdisplay.pdf")) / 2
+font.close()
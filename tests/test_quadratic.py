@@ -0,0 +1,153 @@
+#Needs: fonts/Ambrosia.sfd fonts/CaslonMM.sfd
+
+# Converts cubic fonts to quadratic splines with the QuadraticTolerance
+# preference set, checking that the quadratics stay within the tolerance,
+# that a larger tolerance needs fewer points, that masters converted
+# together get the same points, and that generating a truetype font again
+# (with conversions taken from the cache) gives the same glyphs as a fresh
+# conversion
+import sys, os, math, shutil, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+
+def bezier(pts, t):
+    while len(pts) > 1:
+        pts = [(a[0] + (b[0]-a[0])*t, a[1] + (b[1]-a[1])*t) for a, b in zip(pts, pts[1:])]
+    return pts[0]
+
+def segments(contour):
+    pts = [(p.x, p.y, p.on_curve) for p in contour]
+    start = next(i for i, p in enumerate(pts) if p[2])
+    pts = pts[start:] + pts[:start] + (pts[start:start+1] if contour.closed else [])
+    ret, cur = [], [pts[0][:2]]
+    for p in pts[1:]:
+        cur.append(p[:2])
+        if p[2]:
+            ret.append(cur)
+            cur = [p[:2]]
+    return ret
+
+def distance(p, a, b):
+    dx, dy = b[0]-a[0], b[1]-a[1]
+    l = dx*dx + dy*dy
+    t = 0 if l == 0 else max(0, min(1, ((p[0]-a[0])*dx + (p[1]-a[1])*dy) / l))
+    return math.hypot(p[0]-a[0]-t*dx, p[1]-a[1]-t*dy)
+
+def max_error(cubic, quad):
+    # The end points of the cubics are kept, so each cubic can be compared
+    # with the run of quadratics between the same points
+    worst = 0
+    for cc, qc in zip(cubic.foreground, quad.foreground):
+        quads = segments(qc)
+        qi = 0
+        for seg in segments(cc):
+            while quads[qi][0] != seg[0]:
+                qi += 1
+            poly = []
+            while True:
+                poly += [bezier(quads[qi], i/32) for i in range(33)]
+                qi += 1
+                if quads[qi-1][-1] == seg[-1]:
+                    break
+            for i in range(17):
+                p = bezier(seg, i/16)
+                worst = max(worst, min(distance(p, a, b) for a, b in zip(poly, poly[1:])))
+    return worst
+
+def stored_points(font):
+    return sum(1 for g in font.glyphs() for c in g.foreground for p in c
+               if not p.on_curve or not p.interpolated)
+
+def structure(font):
+    return {g.glyphname: [[p.on_curve for p in c] for c in g.foreground]
+            for g in font.glyphs()}
+
+def copy(src, name):
+    dst = os.path.join(tmp, name)
+    shutil.copy(src, dst)
+    return dst
+
+def quadratic(src, tolerance):
+    fontforge.setPrefs("QuadraticTolerance", tolerance)
+    font = fontforge.open(copy(src, "q%g.sfd" % tolerance))
+    font.is_quadratic = True
+    fontforge.setPrefs("QuadraticTolerance", 0.0)
+    return font
+
+ambrosia, caslon = sys.argv[1], sys.argv[2]
+cubic = fontforge.open(ambrosia)
+letters = [g for g in cubic.glyphs() if len(g.glyphname) == 1 and not g.foreground.isEmpty()]
+
+older = quadratic(ambrosia, 0)
+fine = quadratic(ambrosia, 1)
+coarse = quadratic(ambrosia, 4)
+for g in letters:
+    assert fine[g.glyphname].layers[1].is_quadratic
+    assert max_error(g, fine[g.glyphname]) <= 1.01, g.glyphname
+    assert max_error(g, coarse[g.glyphname]) <= 4.01, g.glyphname
+assert stored_points(coarse) < stored_points(fine)
+# The older conversion strays by about 4 units in places
+assert stored_points(coarse) < stored_points(older)
+for f in (older, fine, coarse):
+    f.close()
+
+# Masters converted together get the same points
+bold = fontforge.open(copy(ambrosia, "bold.sfd"))
+bold.selection.all()
+bold.transform((1.8, 0, 0.3, 1, 0, 0))
+regular = fontforge.open(copy(ambrosia, "regular.sfd"))
+regular.convertToQuadratic(1, (bold,))
+assert regular.layers["Fore"].is_quadratic and bold.layers["Fore"].is_quadratic
+assert structure(regular) == structure(bold)
+for g in letters:
+    assert max_error(g, regular[g.glyphname]) <= 1.01, g.glyphname
+regular.close()
+bold.close()
+
+# And so do the masters of a multiple master font
+mm = fontforge.open(copy(caslon, "CaslonMM.sfd"))
+mm.is_quadratic = True
+saved = os.path.join(tmp, "CaslonMMq.sfd")
+mm.save(saved)
+mm.close()
+fonts = {}
+for line in open(saved):
+    t = line.split()
+    if line.startswith("FontName:"):
+        font = fonts[t[1]] = {}
+    elif line.startswith("Layer: 1 "):
+        assert t[2] == "1", line
+    elif line.startswith("StartChar:"):
+        glyph = font[t[1]] = []
+    elif len(t) > 2 and t[-2] in ("m", "l", "c"):
+        glyph.append(t[-2])
+assert len(fonts["CaslonThin"]) > 200
+assert fonts["CaslonThin"] == fonts["CaslonBlack"]
+
+# Generating again uses the conversions made the first time
+def outlines(path):
+    font = fontforge.open(path)
+    ret = {g.glyphname: [[(p.x, p.y, p.on_curve) for p in c] for c in g.foreground]
+           for g in font.glyphs()}
+    font.close()
+    return ret
+
+fontforge.setPrefs("QuadraticTolerance", 0.5)
+font = fontforge.open(copy(ambrosia, "gen.sfd"))
+first, again, changed = (os.path.join(tmp, n) for n in ("first.ttf", "again.ttf", "changed.ttf"))
+font.generate(first)
+font.generate(again)
+assert outlines(first) == outlines(again)
+font["b"].transform((1, 0, 0, 1, 7, 0))
+font.generate(changed)
+font.close()
+
+fresh = fontforge.open(copy(ambrosia, "fresh.sfd"))
+fresh["b"].transform((1, 0, 0, 1, 7, 0))
+expected = os.path.join(tmp, "fresh.ttf")
+fresh.generate(expected)
+fresh.close()
+got, want = outlines(changed), outlines(expected)
+assert got == want
+assert got["b"] != outlines(first)["b"] and got["a"] == outlines(first)["a"]
+fontforge.setPrefs("QuadraticTolerance", 0.0)
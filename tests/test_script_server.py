@@ -0,0 +1,75 @@
+# A fontforge started with -server runs the scripts of any later fontforge
+# which has FONTFORGE_SERVER set, each in its own fork, and keeps the fonts
+# they open for the next script. Check that scripts get their arguments,
+# input, output and exit status, that they can't see what earlier scripts
+# did to fonts or to python, that fonts changed on disk are read again, that
+# nothing but a stale socket is ever replaced, and that only the server's
+# user may use the socket
+import os, sys, shutil, socket, subprocess, tempfile, time
+
+if not os.path.exists("/proc/self/exe") or not hasattr(socket, "AF_UNIX"):
+    sys.exit(77)
+exe = os.path.realpath("/proc/self/exe")
+if "fontforge" not in os.path.basename(exe):
+    sys.exit(77)		# Run from python, not from fontforge
+
+results = tempfile.mkdtemp('.tmp','fontforge-test-')
+sock = os.path.join(results, "server")
+font = os.path.join(results, "Ambrosia.sfd")
+shutil.copy(sys.argv[1], font)
+
+server = subprocess.Popen([exe, "-quiet", "-server", sock])
+for i in range(300):
+    if os.path.exists(sock):
+        break
+    time.sleep(0.1)
+assert os.path.exists(sock)
+
+env = dict(os.environ, FONTFORGE_SERVER=sock)
+def run(*args, input=None):
+    p = subprocess.run([exe, "-quiet"] + list(args), env=env, cwd=results,
+                       input=input, capture_output=True, text=True, timeout=120)
+    return p.returncode, p.stdout
+
+script = os.path.join(results, "script.py")
+with open(script, "w") as f:
+    f.write("""import sys, fontforge, builtins
+f = fontforge.open(sys.argv[1])
+print(sys.argv[2:], f.fontname, len(f["A"].foreground),
+      hasattr(builtins, "left_behind"))
+f["A"].clear()
+builtins.left_behind = True
+sys.exit(int(sys.argv[2]))
+""")
+try:
+    assert os.stat(sock).st_mode & 0o077 == 0
+
+    for i in range(3):
+        assert run("-script", script, "Ambrosia.sfd", str(i)) == \
+            (i, "['%d'] Ambrosia 3 False\n" % i)
+
+    assert run("-lang=py", "-c", "print(argv[1:], fontforge.open(argv[1]).fontname)",
+               font) == (0, "['%s'] Ambrosia\n" % font)
+    assert run("-lang=py", "-", input="import sys; print(6*7); sys.exit(5)\n") == (5, "42\n")
+
+    native = os.path.join(results, "script.pe")
+    with open(native, "w") as f:
+        f.write('Open($1); Print($fontname, " ", $2); Quit(4)\n')
+    assert run("-lang=ff", "-script", native, "Ambrosia.sfd", "x") == (4, "Ambrosia x\n")
+
+    # Change the file, the server must not hand out its old copy
+    assert run("-lang=py", "-c", "f = fontforge.open(argv[1]); f.fontname = 'Changed'; f.save()",
+               font) == (0, "")
+    assert run("-script", script, font, "0") == (0, "['0'] Changed 3 False\n")
+
+    # Another server can't take over the socket, nor replace a file which
+    # isn't a socket
+    assert subprocess.run([exe, "-quiet", "-server", sock], timeout=120).returncode != 0
+    assert run("-lang=py", "-c", "print(1)") == (0, "1\n")
+    assert subprocess.run([exe, "-quiet", "-server", font], timeout=120).returncode != 0
+    assert open(font).read().startswith("SplineFontDB")
+finally:
+    server.terminate()
+    assert server.wait(60) == 0
+    assert not os.path.exists(sock)
+    shutil.rmtree(results)
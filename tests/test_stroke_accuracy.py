@@ -0,0 +1,101 @@
+#Needs: fonts/StrokeTests.sfd
+
+# Strokes every glyph with a circular nib and measures how far the result
+# strays from the ideal envelope: every point on the outline of a round-
+# capped, round-joined circular stroke lies exactly one radius away from
+# the source path.
+
+import sys, math, time, fontforge
+
+radius = 25
+samples_out = 12
+samples_src = 48
+
+def bezier_points(contour, n):
+    """Samples each segment of a cubic contour n times"""
+    pts = list(contour)
+    if len(pts) < 2:
+        return []
+    res = []
+    on = [i for i, p in enumerate(pts) if p.on_curve]
+    cnt = len(pts)
+    segs = []
+    for k, i in enumerate(on):
+        if k + 1 < len(on):
+            j = on[k + 1]
+        elif contour.closed:
+            j = on[0] + cnt
+        else:
+            break
+        segs.append([pts[m % cnt] for m in range(i, j + 1)])
+    for seg in segs:
+        if len(seg) == 2:
+            p0, p3 = seg
+            p1, p2 = p0, p3
+        else:
+            p0, p1, p2, p3 = seg[0], seg[1], seg[-2], seg[-1]
+        for s in range(n + 1):
+            t = s / n
+            u = 1 - t
+            x = u*u*u*p0.x + 3*u*u*t*p1.x + 3*u*t*t*p2.x + t*t*t*p3.x
+            y = u*u*u*p0.y + 3*u*u*t*p1.y + 3*u*t*t*p2.y + t*t*t*p3.y
+            res.append((x, y))
+    return res
+
+def dist_to_polyline(p, poly, best=float("inf")):
+    """Distance from p to poly, or at least best if it is not closer"""
+    best *= best
+    px, py = p
+    for (ax, ay), (bx, by) in zip(poly, poly[1:]):
+        if (min(abs(px-ax), abs(px-bx))**2 > best and (px-ax)*(px-bx) > 0) \
+                or (min(abs(py-ay), abs(py-by))**2 > best and (py-ay)*(py-by) > 0):
+            continue
+        dx, dy = bx - ax, by - ay
+        ll = dx*dx + dy*dy
+        t = 0 if ll == 0 else max(0, min(1, ((px-ax)*dx + (py-ay)*dy) / ll))
+        qx, qy = ax + t*dx - px, ay + t*dy - py
+        d = qx*qx + qy*qy
+        if d < best:
+            best = d
+    return math.sqrt(best)
+
+font = fontforge.open(sys.argv[1])
+sources = {}
+for g in font.glyphs():
+    if not g.foreground.isEmpty():
+        sources[g.glyphname] = [bezier_points(c, samples_src) for c in g.foreground]
+
+font.selection.all()
+start = time.perf_counter()
+font.stroke("circular", 2*radius, "round", "round")
+elapsed = time.perf_counter() - start
+
+worst, worst_glyph, points, devs = 0.0, None, 0, []
+for name, polys in sources.items():
+    polys = [p for p in polys if len(p) > 1]
+    if not polys:
+        continue
+    for c in font[name].foreground:
+        points += len(c)
+        for p in bezier_points(c, samples_out):
+            d = float("inf")
+            for poly in polys:
+                d = dist_to_polyline(p, poly, d)
+            dev = abs(d - radius)
+            devs.append(dev)
+            if dev > worst:
+                worst, worst_glyph = dev, name
+
+devs.sort()
+p95 = devs[int(0.95 * (len(devs) - 1))]
+print("stroked %d glyphs in %.3fs, %d output points, "
+      "deviation p95 %.3f max %.3f (%s)"
+      % (len(sources), elapsed, points, p95, worst, worst_glyph))
+
+# A few glyphs in this font have spots the overlap removal still gets
+# slightly wrong, so only the typical error is held to the fit accuracy.
+if p95 > 0.5:
+    raise ValueError("95th percentile stroke deviation %.3f too large" % p95)
+if worst > radius / 2:
+    raise ValueError("Stroke of %s strays %.3f from the ideal outline"
+                     % (worst_glyph, worst))
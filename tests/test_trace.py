@@ -0,0 +1,62 @@
+# fontforge.traceStart() records spans for each stage of generating a font,
+# and counters, and traceStop() writes them in Chrome's trace event format.
+# Check that the spans nest properly on each thread, that the stages we
+# expect are there, and that counters only grow
+import os, sys, json, shutil, tempfile, fontforge
+
+results = tempfile.mkdtemp('.tmp','fontforge-test-')
+trace = os.path.join(results, "trace.json")
+font = fontforge.open(sys.argv[1])
+
+try:
+    fontforge.traceStart(os.path.join(results, "no", "such", "dir.json"))
+    assert False
+except EnvironmentError:
+    pass
+
+fontforge.traceStart(trace)
+font.generate(os.path.join(results, "Ambrosia.otf"))
+font.generate(os.path.join(results, "Ambrosia.ttf"))
+font.generate(os.path.join(results, "Ambrosia.woff"))
+fontforge.traceStop()
+fontforge.traceStop()		# Does nothing
+
+with open(trace) as f:
+    events = json.load(f)["traceEvents"]
+
+stacks, names, counters = {}, set(), {}
+last = 0
+for ev in events:
+    if ev["ph"] == "M":
+        continue
+    stack = stacks.setdefault(ev["tid"], [])
+    if ev["ph"] == "B":
+        stack.append(ev["name"])
+        names.add(ev["name"])
+    elif ev["ph"] == "E":
+        assert stack.pop() == ev["name"], ev
+    else:
+        assert ev["ph"] == "C"
+        if ev["name"] != "heap in use":
+            assert ev["args"]["value"] >= counters.get(ev["name"], 0), ev
+        counters[ev["name"]] = ev["args"]["value"]
+    if ev["tid"] == 0:
+        assert ev["ts"] >= last
+        last = ev["ts"]
+assert all(not s for s in stacks.values()), stacks
+
+for name in ("DoSave", "WriteTTFFont", "glyphs", "PS hinting", "CFF charstrings",
+             "quadratic outlines", "SCttfApprox", "glyf", "layout tables",
+             "GPOS", "GSUB", "table assembly", "write sfnt", "WOFF compression"):
+    assert name in names, name
+assert 0 < counters["charstrings"] <= len(font) + 1	# and .notdef
+assert counters["bytes written"] > 0
+assert counters["glyphs approximated"] > 0
+
+# Nothing more is recorded once it stops
+os.remove(trace)
+font.generate(os.path.join(results, "Ambrosia.otf"))
+assert not os.path.exists(trace)
+
+font.close()
+shutil.rmtree(results)
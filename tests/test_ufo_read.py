@@ -0,0 +1,80 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Writes Ambrosia out as a UFO and reads it back, checking that every glyph
+# keeps its outlines, references, anchors, width and code point, and that
+# the glyphs are in the order contents.plist lists them. Then adds a
+# background layer with references to check those are resolved as well
+import sys, os, re, tempfile, fontforge
+
+def glyph_data(g, layer):
+    contours = [[(p.x, p.y, p.on_curve) for p in c] for c in g.layers[layer]]
+    refs = sorted((r[0], tuple(round(v, 4) for v in r[1])) for r in g.layerrefs[layer])
+    return contours, refs
+
+tmp = tempfile.mkdtemp()
+ufo = os.path.join(tmp, "Ambrosia.ufo")
+
+font = fontforge.open(sys.argv[1])
+font.addLookup("mk", "gpos_mark2base", None, (("mark", (("latn", ("dflt",)),)),))
+font.addLookupSubtable("mk", "mk-1")
+font.addAnchorClass("mk-1", "top")
+font["a"].addAnchorPoint("top", "base", 250, 500)
+font["grave"].addAnchorPoint("top", "mark", 100, 400)
+font["a"].comment = "A note"
+font.generate(ufo)
+
+glyphdir = os.path.join(ufo, "glyphs")
+order = re.findall(r"<key>(.*?)</key>", open(os.path.join(glyphdir, "contents.plist")).read())
+
+back = fontforge.open(ufo)
+assert [g.glyphname for g in back.glyphs("encoding")] == order
+for name in order:
+    g, b = font[name], back[name]
+    assert b.width == g.width, name
+    assert b.unicode == g.unicode, name
+    assert glyph_data(b, 1) == glyph_data(g, 1), name
+assert [(a[0], a[1], a[2], a[3]) for a in back["a"].anchorPoints] == [("top", "base", 250, 500)]
+assert [(a[0], a[1]) for a in back["grave"].anchorPoints] == [("top", "mark")]
+assert back["a"].comment == "A note"
+back.close()
+
+# A background layer with a glyph the foreground layer doesn't have, and a
+# reference to it
+bgdir = os.path.join(ufo, "glyphs.public.background")
+os.mkdir(bgdir)
+with open(os.path.join(bgdir, "contents.plist"), "w") as f:
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n<plist version="1.0"><dict>\n'
+            '<key>e</key><string>e.glif</string>\n'
+            '<key>extra</key><string>extra.glif</string>\n'
+            '</dict></plist>\n')
+with open(os.path.join(bgdir, "e.glif"), "w") as f:
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n<glyph name="e" format="2">'
+            '<outline><component base="extra" xOffset="40"/></outline></glyph>\n')
+with open(os.path.join(bgdir, "extra.glif"), "w") as f:
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n<glyph name="extra" format="2">'
+            '<advance width="321"/><unicode hex="E000"/><outline>'
+            '<contour><point x="0" y="0" type="line"/>'
+            '<point x="10" y="0" type="line"/><point x="10" y="10" type="line"/>'
+            '</contour></outline></glyph>\n')
+layers = os.path.join(ufo, "layercontents.plist")
+text = open(layers).read()
+text = text.replace("  </array>\n</plist>",
+                    "    <array><string>public.background</string>"
+                    "<string>glyphs.public.background</string></array>\n  </array>\n</plist>")
+with open(layers, "w") as f:
+    f.write(text)
+
+back = fontforge.open(ufo)
+assert glyph_data(back["e"], 1) == glyph_data(font["e"], 1)
+assert glyph_data(back["e"], 0)[1] == [("extra", (1, 0, 0, 1, 40, 0))]
+extra = back["extra"]
+assert extra.width == 321 and extra.unicode == 0xE000
+assert glyph_data(extra, 0) == ([[(0, 0, True), (10, 0, True), (10, 10, True)]], [])
+# Unlinking the reference gives the outline of extra, which it only does once
+# the reference has been resolved
+e = back["e"]
+e.activeLayer = 0
+e.unlinkRef()
+assert glyph_data(e, 0) == ([[(40, 0, True), (50, 0, True), (50, 10, True)]], [])
+back.close()
+font.close()
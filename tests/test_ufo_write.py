@@ -0,0 +1,62 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Exports Ambrosia as a UFO several times, checking that glif files which
+# would not change are left alone, that the files of edited glyphs are
+# rewritten, and that the files of removed glyphs and layers go away
+import sys, os, time, tempfile, fontforge
+
+def glyph_data(g):
+    return [[(p.x, p.y, p.on_curve) for p in c] for c in g.foreground], g.width, g.comment
+
+def snapshot(ufo):
+    ret = {}
+    for dirpath, dirs, files in os.walk(ufo):
+        for name in files:
+            path = os.path.join(dirpath, name)
+            ret[os.path.relpath(path, ufo)] = os.stat(path).st_mtime_ns
+    return ret
+
+def changed(before, after):
+    return sorted(k for k in after if k.endswith(".glif") and before.get(k) != after[k])
+
+tmp = tempfile.mkdtemp()
+ufo = os.path.join(tmp, "Ambrosia.ufo")
+glyphdir = os.path.join(ufo, "glyphs")
+
+font = fontforge.open(sys.argv[1])
+font["A"].comment = "Ünïcödé <note> & \"quotes\""
+font.generate(ufo)
+time.sleep(1.1)
+first = snapshot(ufo)
+
+font.generate(ufo)
+second = snapshot(ufo)
+assert changed(first, second) == [], changed(first, second)
+
+# zcaron isn't referenced by other glyphs
+time.sleep(1.1)
+font["zcaron"].width += 10
+font.removeGlyph("B")
+with open(os.path.join(glyphdir, "junk.glif"), "w") as f:
+    f.write("junk")
+os.mkdir(os.path.join(ufo, "glyphs.gone"))
+font.generate(ufo)
+third = snapshot(ufo)
+assert changed(second, third) == ["glyphs/zcaron.glif"], changed(second, third)
+assert "glyphs/B_.glif" not in third and "glyphs/junk.glif" not in third
+assert not os.path.exists(os.path.join(ufo, "glyphs.gone"))
+
+# A file changed behind our back is rewritten even when its size is the same
+path = os.path.join(glyphdir, "A_.glif")
+data = open(path, "rb").read()
+with open(path, "wb") as f:
+    f.write(data.replace(b"<advance", b"<advancf"))
+font.generate(ufo)
+assert open(path, "rb").read() == data
+
+back = fontforge.open(ufo)
+assert "B" not in back
+for g in font.glyphs():
+    assert glyph_data(back[g.glyphname]) == glyph_data(g), g.glyphname
+back.close()
+font.close()
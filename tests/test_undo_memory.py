@@ -0,0 +1,44 @@
+# The undoes of all glyphs share one budget of memory, and when they go over
+# it the oldest are removed, whichever glyphs they belong to. Check that the
+# memory they use is counted, that it stays near the budget, that the last
+# undo of every glyph survives, and that references come back right when
+# undone (their outlines aren't kept in the undo)
+import sys, fontforge
+
+font = fontforge.open(sys.argv[1])
+before = fontforge.undoMemory()
+
+ref = font["Aacute"]
+refs, box = ref.references, ref.boundingBox()
+assert refs
+ref.preserveLayerAsUndo()
+ref.clear()
+assert not ref.references
+ref.doUndoLayer()
+assert ref.references == refs
+assert ref.boundingBox() == box
+ref.doUndoLayer("Fore", True)
+assert not ref.references
+ref.doUndoLayer()
+assert ref.boundingBox() == box
+one = fontforge.undoMemory()
+assert one > before
+
+# Every glyph gets several undoes, more than a megabyte in all
+fontforge.setPrefs("UndoMemory", 1)
+glyphs = [g for g in font.glyphs() if len(g.foreground) > 0][:400]
+for rnd in range(8):
+    for g in glyphs:
+        g.preserveLayerAsUndo()
+        g.transform((1, 0, 0, 1, 1, 0))
+    assert fontforge.undoMemory() < 1.25 * 1024 * 1024 + len(glyphs) * 4096
+
+# The last move of each glyph can still be undone
+for g in glyphs:
+    box = g.boundingBox()
+    g.doUndoLayer()
+    assert abs(g.boundingBox()[0] - (box[0] - 1)) < 0.01, g.glyphname
+
+fontforge.setPrefs("UndoMemory", 0)
+font.close()
+assert fontforge.undoMemory() == before
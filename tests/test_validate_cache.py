@@ -0,0 +1,67 @@
+#Needs: fonts/Ambrosia.sfd
+
+# Validates Ambrosia with a cache file, checking that the results are the
+# same as without one, that a later run takes unchanged glyphs from the
+# cache, that changed glyphs are checked again, that duplicate code points
+# are found whatever the cache says, and that forcing ignores the cache but
+# brings it up to date
+import sys, os, tempfile, fontforge
+
+tmp = tempfile.mkdtemp()
+cache = os.path.join(tmp, "Ambrosia.validation")
+
+def states(font):
+    return {g.glyphname: g.validation_state for g in font.glyphs()}
+
+font = fontforge.open(sys.argv[1])
+plain = font.validate(True)
+expected = states(font)
+font.close()
+
+font = fontforge.open(sys.argv[1])
+assert font.validate(True, cache) == plain
+assert states(font) == expected
+times = fontforge.validationTimes()
+assert set(times) == {"glyphname", "lookups", "opencontour", "selfintersects",
+                      "direction", "references", "hints", "points", "extrema",
+                      "maxp", "duplicates", "anchors"}
+assert all(t >= 0 for t in times.values()) and times["direction"] > 0
+font.close()
+
+lines = open(cache).read().splitlines()
+assert lines[0] == "FontForge validation cache 1"
+assert len(lines) > len(expected) / 2
+
+# Claim every glyph has an open contour. Glyphs found in the cache aren't
+# checked again, so they say so too
+with open(cache, "w") as f:
+    f.write(lines[0] + "\n")
+    for line in lines[1:]:
+        h, state = line.split()
+        f.write("%s %x\n" % (h, int(state, 16) | 0x2))
+
+font = fontforge.open(sys.argv[1])
+font["b"].transform((1, 0, 0, 1, 3, 0))
+font["e"].unicode = font["o"].unicode
+font.validate(False, cache)
+got = states(font)
+assert got["a"] & 0x2 and got["o"] & 0x2
+assert not got["b"] & 0x2
+assert got["e"] & 0x400000 and got["o"] & 0x400000
+assert not expected["e"] & 0x400000
+font.close()
+
+# The file was rewritten with the new outline of b
+assert open(cache).read().splitlines() != lines
+
+# Forcing checks every glyph again, whatever the cache claims
+with open(cache, "w") as f:
+    f.write(lines[0] + "\n")
+    for line in lines[1:]:
+        h, state = line.split()
+        f.write("%s %x\n" % (h, int(state, 16) | 0x2))
+font = fontforge.open(sys.argv[1])
+assert font.validate(True, cache) == plain
+assert states(font) == expected
+font.close()
+assert open(cache).read().splitlines() == lines
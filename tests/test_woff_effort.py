@@ -0,0 +1,55 @@
+#Needs: fonts/Ambrosia.sfd
+
+# The tables of a woff file are compressed in parallel, as hard as the
+# woff-fast, woff-best or woff-exhaustive flags ask. Check that each gives a
+# valid file which decompresses to the tables of the sfnt, that trying
+# harder never gives a bigger file, and that the font reads back
+import os, struct, sys, tempfile, zlib, fontforge
+
+tmp = tempfile.mkdtemp()
+
+def checksum(data):
+    data += b"\0" * (-len(data) % 4)
+    return sum(struct.unpack(">%dL" % (len(data)//4), data)) & 0xffffffff
+
+def check(path):
+    data = open(path, "rb").read()
+    sig, _, length, num_tabs, _, sfnt_size = struct.unpack(">4sLLHHL", data[:20])
+    assert sig == b"wOFF" and length == len(data)
+    total = 12 + 16*num_tabs
+    for i in range(num_tabs):
+        tag, offset, comp, orig, orig_sum = struct.unpack(">4sLLLL", data[44+20*i:64+20*i])
+        assert offset % 4 == 0 and comp <= orig
+        table = data[offset:offset+comp]
+        if comp < orig:
+            table = zlib.decompress(table)
+        assert len(table) == orig
+        if tag != b"head":
+            assert checksum(table) == orig_sum, tag
+        total += orig + (-orig % 4)
+    assert total == sfnt_size
+    meta_offset, meta_len, meta_orig = struct.unpack(">LLL", data[24:36])
+    assert zlib.decompress(data[meta_offset:meta_offset+meta_len]).decode() == metadata
+    return len(data)
+
+metadata = "<?xml version='1.0' encoding='UTF-8'?><metadata version='1.0'><uniqueid id='ambrosia'/></metadata>"
+font = fontforge.open(sys.argv[1])
+font.woffMetadata = metadata
+ref = os.path.join(tmp, "ref.ttf")
+font.generate(ref)
+f = fontforge.open(ref)
+names = [g.glyphname for g in f.glyphs()]
+f.close()
+sizes = {}
+for flag in (None, "woff-fast", "woff-best", "woff-exhaustive"):
+    path = os.path.join(tmp, "%s.woff" % flag)
+    font.generate(path, flags=(flag,) if flag else ())
+    sizes[flag] = check(path)
+    f = fontforge.open(path)
+    assert f.woffMetadata == metadata
+    assert [g.glyphname for g in f.glyphs()] == names
+    f.close()
+font.close()
+
+assert sizes["woff-exhaustive"] <= min(sizes[None], sizes["woff-best"])
+assert sizes["woff-fast"] >= sizes["woff-exhaustive"]